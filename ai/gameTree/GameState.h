@@ -4,6 +4,8 @@
 
 #include "minorGems/util/SimpleVector.h"
 
+#include <stdint.h>
+
 
 
 // Interface for game states that can be fed into functions in minMax.h
@@ -27,6 +29,17 @@ class GameState {
         virtual void copyFrom( GameState *inOther ) = 0;
 
         virtual void printState() = 0;
+
+
+        // optional hash of this state for MinMaxSearcher's transposition
+        // table and move ordering, or 0 if not hashed (the default)
+        //
+        // Equal states must hash equally, so the hash must cover
+        // everything that getScore, getGameOver, and getPossibleMoves
+        // depend on.
+        virtual uint64_t getHash() {
+            return 0;
+            }
         
     };
 
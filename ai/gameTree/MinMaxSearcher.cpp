@@ -0,0 +1,683 @@
+#include "MinMaxSearcher.h"
+
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/Time.h"
+#include "minorGems/system/atomicOps.h"
+
+#include <string.h>
+
+
+
+#define BOUND_EXACT 0
+// score is at least the stored score
+#define BOUND_LOWER 1
+// score is at most the stored score
+#define BOUND_UPPER 2
+
+
+// stored for subtrees that were searched to the end of the game, so
+// their scores hold at every depth
+#define RESOLVED_DEPTH 0xFFFF
+
+
+#define MAX_KILLER_PLY 64
+
+#define HISTORY_SIZE 4096
+
+
+
+// read and written without locks by all threads
+//
+// mCheck is the key xor the other two words, so an entry torn by
+// two threads writing at once doesn't match its key
+struct MinMaxTableEntry {
+        volatile uint64_t mCheck;
+        volatile uint64_t mBestChild;
+        // score in the low 32 bits, then depth, then bound
+        volatile uint64_t mData;
+    };
+
+
+
+struct MinMaxThreadContext {
+        // hashes of the two moves that last caused cutoffs at each ply
+        uint64_t mKillers[ MAX_KILLER_PLY ][2];
+
+        // cutoff counts, by move hash, weighted by depth
+        int mHistory[ HISTORY_SIZE ];
+
+        uint64_t mNodes;
+
+        // leaves cut off by the depth limit, rather than by the end of
+        // the game, so a search that adds none has searched the
+        // whole tree
+        uint64_t mDepthCutoffs;
+    };
+
+
+
+class MinMaxSearchThread : public Thread {
+
+    public:
+
+        MinMaxSearchThread( MinMaxSearcher *inSearcher,
+                            MinMaxThreadContext *inContext )
+                : mSearcher( inSearcher ), mContext( inContext ) {
+            }
+
+        virtual void run() {
+            mSearcher->searchRootMoves( mContext );
+            }
+
+    protected:
+        MinMaxSearcher *mSearcher;
+        MinMaxThreadContext *mContext;
+    };
+
+
+
+struct MoveRank {
+        // 1 for killers, 0 for others
+        int mClass;
+        // for the side moving, so higher is better
+        int64_t mScore;
+        int mHistory;
+    };
+
+
+
+static char rankBefore( MoveRank *inA, MoveRank *inB ) {
+    if( inA->mClass != inB->mClass ) {
+        return inA->mClass > inB->mClass;
+        }
+    if( inA->mScore != inB->mScore ) {
+        return inA->mScore > inB->mScore;
+        }
+    return inA->mHistory > inB->mHistory;
+    }
+
+
+
+static MinOrMax switchSide( MinOrMax inSide ) {
+    if( inSide == min ) {
+        return max;
+        }
+    return min;
+    }
+
+
+
+// mixed into keys so that the same state with different sides
+// to move gets different entries
+#define MIN_SIDE_KEY 0x9E3779B97F4A7C15ULL
+
+
+
+MinMaxSearcher::MinMaxSearcher( int inNumThreads, int inTableSize )
+        : mNumThreads( inNumThreads ),
+          mTable( NULL ),
+          mTableMask( 0 ),
+          mNumRootMoves( 0 ),
+          mRootMoves( NULL ),
+          mRootOrder( NULL ),
+          mStopped( false ),
+          mDepthReached( -1 ),
+          mScore( 0 ),
+          mNodesSearched( 0 ) {
+
+    if( mNumThreads < 1 ) {
+        mNumThreads = 1;
+        }
+
+    mContexts = new MinMaxThreadContext[ mNumThreads ];
+
+    if( inTableSize > 0 ) {
+        uint64_t tableSize = 1;
+        while( tableSize * 2 <= (uint64_t)inTableSize ) {
+            tableSize *= 2;
+            }
+        mTableMask = tableSize - 1;
+
+        mTable = new MinMaxTableEntry[ tableSize ];
+        }
+
+    clearTable();
+    }
+
+
+
+MinMaxSearcher::~MinMaxSearcher() {
+    delete [] mContexts;
+
+    if( mTable != NULL ) {
+        delete [] mTable;
+        }
+    }
+
+
+
+void MinMaxSearcher::clearTable() {
+    if( mTable != NULL ) {
+        memset( (void *)mTable, 0,
+                ( mTableMask + 1 ) * sizeof( MinMaxTableEntry ) );
+        }
+
+    memset( (void *)mContexts, 0,
+            mNumThreads * sizeof( MinMaxThreadContext ) );
+    }
+
+
+
+int MinMaxSearcher::getDepthReached() {
+    return mDepthReached;
+    }
+
+
+
+int MinMaxSearcher::getScore() {
+    return mScore;
+    }
+
+
+
+uint64_t MinMaxSearcher::getNodesSearched() {
+    return mNodesSearched;
+    }
+
+
+
+char MinMaxSearcher::probeTable( uint64_t inKey, int *outScore,
+                                 int *outDepth, int *outBound,
+                                 uint64_t *outBestChild ) {
+
+    MinMaxTableEntry *entry = &( mTable[ inKey & mTableMask ] );
+
+    uint64_t check = entry->mCheck;
+    uint64_t bestChild = entry->mBestChild;
+    uint64_t data = entry->mData;
+
+    if( ( check ^ bestChild ^ data ) != inKey ) {
+        return false;
+        }
+
+    *outScore = (int)(uint32_t)( data & 0xFFFFFFFF );
+    *outDepth = (int)( ( data >> 32 ) & 0xFFFF );
+    *outBound = (int)( data >> 48 );
+    *outBestChild = bestChild;
+
+    return true;
+    }
+
+
+
+void MinMaxSearcher::storeTable( uint64_t inKey, int inScore, int inDepth,
+                                 int inBound, uint64_t inBestChild ) {
+
+    MinMaxTableEntry *entry = &( mTable[ inKey & mTableMask ] );
+
+    uint64_t data = (uint64_t)(uint32_t)inScore |
+        ( (uint64_t)inDepth << 32 ) |
+        ( (uint64_t)inBound << 48 );
+
+    // always replace, so the table follows the current search
+    entry->mBestChild = inBestChild;
+    entry->mData = data;
+    entry->mCheck = inKey ^ inBestChild ^ data;
+    }
+
+
+
+int MinMaxSearcher::search( MinMaxThreadContext *inContext,
+                            GameState *inState,
+                            MinOrMax inSide, int inDepth,
+                            int inAlpha, int inBeta, int inPly ) {
+
+    inContext->mNodes++;
+
+    if( mStopTime >= 0 && ( inContext->mNodes & 1023 ) == 0 &&
+        Time::getPreciseTime() > mStopTime ) {
+        atomicStore( &mStopped, (int)true );
+        }
+    if( atomicLoad( &mStopped ) ) {
+        return 0;
+        }
+
+
+    if( inDepth == 0 ) {
+        if( ! inState->getGameOver() ) {
+            inContext->mDepthCutoffs++;
+            }
+        return inState->getScore();
+        }
+
+    if( inState->getGameOver() ) {
+        return inState->getScore();
+        }
+
+
+    uint64_t key = 0;
+    uint64_t tableBestChild = 0;
+
+    if( mTable != NULL ) {
+        key = inState->getHash();
+
+        if( key != 0 ) {
+            if( inSide == min ) {
+                key ^= MIN_SIDE_KEY;
+                }
+
+            int score, depth, bound;
+
+            if( probeTable( key, &score, &depth, &bound,
+                            &tableBestChild ) ) {
+
+                if( depth >= inDepth &&
+                    ( bound == BOUND_EXACT ||
+                      ( bound == BOUND_LOWER && score >= inBeta ) ||
+                      ( bound == BOUND_UPPER && score <= inAlpha ) ) ) {
+
+                    if( depth != RESOLVED_DEPTH ) {
+                        inContext->mDepthCutoffs++;
+                        }
+                    return score;
+                    }
+                }
+            }
+        }
+
+
+    SimpleVector<GameState *> possibleMoves =
+        inState->getPossibleMoves();
+
+    int numMoves = possibleMoves.size();
+
+    if( numMoves == 0 ) {
+        // leaf
+        return inState->getScore();
+        }
+
+    GameState **moves = possibleMoves.getElementArray();
+
+    uint64_t *moveHashes = new uint64_t[ numMoves ];
+    MoveRank *ranks = new MoveRank[ numMoves ];
+    int *order = new int[ numMoves ];
+
+
+    // the table's best move is searched first, before the others are
+    // ranked, since it usually causes a cutoff that makes scoring
+    // them a waste
+    int numOrdered = 0;
+
+    for( int i=0; i<numMoves; i++ ) {
+        moveHashes[i] = moves[i]->getHash();
+
+        if( numOrdered == 0 && tableBestChild != 0 &&
+            moveHashes[i] == tableBestChild ) {
+            order[0] = i;
+            numOrdered = 1;
+            }
+        }
+
+    uint64_t *killers = NULL;
+    if( inPly < MAX_KILLER_PLY ) {
+        killers = inContext->mKillers[ inPly ];
+        }
+
+
+    uint64_t cutoffsBefore = inContext->mDepthCutoffs;
+
+    int alpha = inAlpha;
+    int beta = inBeta;
+
+    int bestScore = 0;
+    uint64_t bestChild = 0;
+
+    for( int k=0; k<numMoves; k++ ) {
+
+        if( k == numOrdered ) {
+            // order the rest:  killers, then by score, then by history
+            int tableMove = -1;
+            if( numOrdered == 1 ) {
+                tableMove = order[0];
+                }
+
+            for( int i=0; i<numMoves; i++ ) {
+                if( i == tableMove ) {
+                    continue;
+                    }
+
+                uint64_t hash = moveHashes[i];
+
+                MoveRank *rank = &( ranks[i] );
+                rank->mClass = 0;
+                rank->mScore = 0;
+                rank->mHistory = 0;
+
+                if( hash != 0 ) {
+                    if( killers != NULL &&
+                        ( hash == killers[0] || hash == killers[1] ) ) {
+                        rank->mClass = 1;
+                        }
+                    rank->mHistory =
+                        inContext->mHistory[ hash % HISTORY_SIZE ];
+                    }
+
+                if( inDepth >= 2 && rank->mClass == 0 ) {
+                    // not worth scoring moves that are about to be
+                    // scored anyway as leaves
+                    rank->mScore = moves[i]->getScore();
+
+                    if( inSide == min ) {
+                        rank->mScore = - rank->mScore;
+                        }
+                    }
+
+                // insertion sort, best first, ties kept in order
+                int j = numOrdered;
+                while( j > k &&
+                       rankBefore( rank, &( ranks[ order[ j - 1 ] ] ) ) ) {
+                    order[j] = order[ j - 1 ];
+                    j--;
+                    }
+                order[j] = i;
+                numOrdered++;
+                }
+            }
+
+        int i = order[k];
+
+        int score = search( inContext, moves[i], switchSide( inSide ),
+                            inDepth - 1, alpha, beta, inPly + 1 );
+
+        if( mStopped ) {
+            break;
+            }
+
+        if( inSide == max ) {
+            if( k == 0 || score > bestScore ) {
+                bestScore = score;
+                bestChild = moveHashes[i];
+                }
+            if( bestScore > alpha ) {
+                alpha = bestScore;
+                }
+            }
+        else {
+            if( k == 0 || score < bestScore ) {
+                bestScore = score;
+                bestChild = moveHashes[i];
+                }
+            if( bestScore < beta ) {
+                beta = bestScore;
+                }
+            }
+
+        if( alpha >= beta ) {
+            // cutoff
+            uint64_t hash = moveHashes[i];
+
+            if( hash != 0 ) {
+                if( killers != NULL && killers[0] != hash ) {
+                    killers[1] = killers[0];
+                    killers[0] = hash;
+                    }
+
+                int *history = &( inContext->mHistory[ hash % HISTORY_SIZE ] );
+                *history += inDepth * inDepth;
+
+                if( *history > 0x20000000 ) {
+                    // keep history below the killer priority
+                    for( int h=0; h<HISTORY_SIZE; h++ ) {
+                        inContext->mHistory[h] /= 2;
+                        }
+                    }
+                }
+            break;
+            }
+        }
+
+
+    for( int i=0; i<numMoves; i++ ) {
+        delete moves[i];
+        }
+    delete [] moves;
+    delete [] moveHashes;
+    delete [] ranks;
+    delete [] order;
+
+    if( mStopped ) {
+        return 0;
+        }
+
+
+    if( key != 0 ) {
+        int bound = BOUND_EXACT;
+
+        if( bestScore <= inAlpha ) {
+            bound = BOUND_UPPER;
+            }
+        else if( bestScore >= inBeta ) {
+            bound = BOUND_LOWER;
+            }
+
+        int depth = inDepth;
+        if( inContext->mDepthCutoffs == cutoffsBefore ) {
+            depth = RESOLVED_DEPTH;
+            }
+        else if( depth >= RESOLVED_DEPTH ) {
+            depth = RESOLVED_DEPTH - 1;
+            }
+
+        storeTable( key, bestScore, depth, bound, bestChild );
+        }
+
+    return bestScore;
+    }
+
+
+
+void MinMaxSearcher::searchRootMoves( MinMaxThreadContext *inContext ) {
+
+    while( true ) {
+        mLock.lock();
+
+        if( mNextRootMove >= mNumRootMoves || mStopped ) {
+            mLock.unlock();
+            return;
+            }
+
+        int i = mRootOrder[ mNextRootMove ];
+        mNextRootMove++;
+
+        int alpha = mAlpha;
+        int beta = mBeta;
+
+        mLock.unlock();
+
+
+        int score = search( inContext, mRootMoves[i], switchSide( mRootSide ),
+                            mIterationDepth, alpha, beta, 1 );
+
+        if( mStopped ) {
+            return;
+            }
+
+
+        mLock.lock();
+
+        // root moves that can't beat the best so far fail low, with
+        // scores that are no better than the best
+        if( mBestMove == -1 ||
+            ( mRootSide == max && score > mBestScore ) ||
+            ( mRootSide == min && score < mBestScore ) ) {
+
+            mBestMove = i;
+            mBestScore = score;
+
+            if( mRootSide == max ) {
+                mAlpha = score;
+                }
+            else {
+                mBeta = score;
+                }
+            }
+
+        mLock.unlock();
+        }
+    }
+
+
+
+GameState *MinMaxSearcher::pickMove( GameState *inCurrentState,
+                                     MinOrMax inSide,
+                                     int inDepthLimit,
+                                     double inTimeLimitSeconds ) {
+
+    double startTime = Time::getPreciseTime();
+
+    mDepthReached = -1;
+    mScore = 0;
+    mNodesSearched = 0;
+
+    for( int t=0; t<mNumThreads; t++ ) {
+        mContexts[t].mNodes = 0;
+        }
+
+
+    SimpleVector<GameState *> possibleMoves =
+        inCurrentState->getPossibleMoves();
+
+    mNumRootMoves = possibleMoves.size();
+
+    if( mNumRootMoves == 0 ) {
+        // no moves left, game over?
+        return NULL;
+        }
+
+    mRootSide = inSide;
+    mRootMoves = possibleMoves.getElementArray();
+    mRootOrder = new int[ mNumRootMoves ];
+
+    for( int i=0; i<mNumRootMoves; i++ ) {
+        mRootOrder[i] = i;
+        }
+
+    mStopped = false;
+
+    // the first depth finishes no matter the time, so there is a move
+    mStopTime = -1;
+
+    int bestMove = mRootOrder[0];
+
+
+    for( int depth = 0;
+         inDepthLimit < 0 || depth <= inDepthLimit;
+         depth++ ) {
+
+        mIterationDepth = depth;
+        mNextRootMove = 0;
+        mAlpha = INT_MIN;
+        mBeta = INT_MAX;
+        mBestMove = -1;
+        mBestScore = 0;
+
+        uint64_t cutoffsBefore = 0;
+        for( int t=0; t<mNumThreads; t++ ) {
+            cutoffsBefore += mContexts[t].mDepthCutoffs;
+            }
+
+
+        // the best move from the last depth is searched alone, to set
+        // a window for the others
+        mNumRootMoves = 1;
+        searchRootMoves( &( mContexts[0] ) );
+        mNumRootMoves = possibleMoves.size();
+
+        if( mNumThreads > 1 && depth > 0 ) {
+            MinMaxSearchThread **threads =
+                new MinMaxSearchThread*[ mNumThreads - 1 ];
+
+            for( int t=1; t<mNumThreads; t++ ) {
+                threads[ t - 1 ] =
+                    new MinMaxSearchThread( this, &( mContexts[t] ) );
+                threads[ t - 1 ]->start();
+                }
+
+            searchRootMoves( &( mContexts[0] ) );
+
+            for( int t=1; t<mNumThreads; t++ ) {
+                threads[ t - 1 ]->join();
+                delete threads[ t - 1 ];
+                }
+            delete [] threads;
+            }
+        else {
+            searchRootMoves( &( mContexts[0] ) );
+            }
+
+
+        if( mStopped ) {
+            // keep the move from the last finished depth
+            break;
+            }
+
+        bestMove = mBestMove;
+        mDepthReached = depth;
+        mScore = mBestScore;
+
+        // search the best move first next time
+        for( int k=0; k<mNumRootMoves; k++ ) {
+            if( mRootOrder[k] == bestMove ) {
+                for( int j=k; j>0; j-- ) {
+                    mRootOrder[j] = mRootOrder[ j - 1 ];
+                    }
+                mRootOrder[0] = bestMove;
+                break;
+                }
+            }
+
+
+        uint64_t cutoffsAfter = 0;
+        for( int t=0; t<mNumThreads; t++ ) {
+            cutoffsAfter += mContexts[t].mDepthCutoffs;
+            }
+
+        if( cutoffsAfter == cutoffsBefore ) {
+            // nothing cut off by depth, so deeper searches would
+            // find the same scores
+            break;
+            }
+
+        if( inTimeLimitSeconds >= 0 ) {
+            double elapsed = Time::getPreciseTime() - startTime;
+
+            if( elapsed > inTimeLimitSeconds / 2 ) {
+                // the next depth takes longer than all of the depths
+                // so far, so it won't finish
+                break;
+                }
+
+            mStopTime = startTime + inTimeLimitSeconds;
+            }
+        }
+
+
+    for( int t=0; t<mNumThreads; t++ ) {
+        mNodesSearched += mContexts[t].mNodes;
+        }
+
+    for( int i=0; i<mNumRootMoves; i++ ) {
+        if( i != bestMove ) {
+            delete mRootMoves[i];
+            }
+        }
+
+    GameState *result = mRootMoves[ bestMove ];
+
+    delete [] mRootMoves;
+    delete [] mRootOrder;
+    mRootMoves = NULL;
+    mRootOrder = NULL;
+
+    return result;
+    }
@@ -0,0 +1,173 @@
+#include "minorGems/common.h"
+
+
+#ifndef MIN_MAX_SEARCHER_INCLUDED
+#define MIN_MAX_SEARCHER_INCLUDED
+
+
+#include "minMax.h"
+#include "GameState.h"
+
+#include "minorGems/system/MutexLock.h"
+
+#include <stdint.h>
+
+
+
+// kept out of this header, see MinMaxSearcher.cpp
+struct MinMaxTableEntry;
+struct MinMaxThreadContext;
+class MinMaxSearchThread;
+
+
+
+/**
+ * Alpha-beta game tree search, like minMaxPickMove, for deeper searches
+ * and games with many repeated positions.
+ *
+ * The search deepens one ply at a time, so it can stop when a time
+ * limit runs out and return the best move from the deepest finished
+ * search.  Root moves are searched best-first, in the order that the
+ * last finished search ranked them.
+ *
+ * Moves below the root are searched in getScore order.  States that
+ * implement GameState::getHash also get a transposition table (shared
+ * between threads and between pickMove calls), and moves that caused
+ * cutoffs before are searched first.
+ *
+ * With more than one thread, the best root move is searched first,
+ * then the other root moves are split between the threads.  Each
+ * thread searches its own states, so states returned by
+ * getPossibleMoves must not share anything that they change.
+ *
+ * Scores match those of minMax for the same depth.
+ */
+class MinMaxSearcher {
+
+    public:
+
+        /**
+         * Constructs a searcher.
+         *
+         * @param inNumThreads the number of threads to search with.
+         *   Defaults to 1.
+         * @param inTableSize the number of transposition table
+         *   entries, rounded down to a power of 2, or 0 for no table.
+         *   Each entry takes 24 bytes.  Defaults to 1048576.
+         */
+        MinMaxSearcher( int inNumThreads = 1, int inTableSize = 1048576 );
+
+        ~MinMaxSearcher();
+
+
+
+        /**
+         * Picks the best move from a state.
+         *
+         * @param inCurrentState the state to move from.
+         *   Must be destroyed by caller.
+         * @param inSide the side moving next from inCurrentState.
+         * @param inDepthLimit the depth to search below each move, as
+         *   for minMaxPickMove, or -1 to search until the time
+         *   runs out or the whole tree has been searched.
+         *   Defaults to -1.
+         * @param inTimeLimitSeconds the time to search for, or -1 to
+         *   finish the search to inDepthLimit.  Defaults to -1.
+         *   At least the moves' own scores are always looked at, even
+         *   if the time runs out before then.
+         *
+         * @return the best move, or NULL if there are no moves.
+         *   Must be destroyed by caller.
+         */
+        GameState *pickMove( GameState *inCurrentState, MinOrMax inSide,
+                             int inDepthLimit = -1,
+                             double inTimeLimitSeconds = -1 );
+
+
+
+        /**
+         * Empties the transposition table and move ordering history,
+         * for example before starting a new game.
+         */
+        void clearTable();
+
+
+
+        // about the last pickMove call
+
+        // the depth of the deepest finished search
+        int getDepthReached();
+
+        // the minMax score of the picked move at that depth
+        int getScore();
+
+        // states visited, including leaves
+        uint64_t getNodesSearched();
+
+
+
+    protected:
+
+        friend class MinMaxSearchThread;
+
+
+        int mNumThreads;
+        MinMaxThreadContext *mContexts;
+
+        MinMaxTableEntry *mTable;
+        uint64_t mTableMask;
+
+
+        // the current search, shared by the threads
+
+        MutexLock mLock;
+
+        MinOrMax mRootSide;
+        int mNumRootMoves;
+        GameState **mRootMoves;
+        // root move indices, best first
+        int *mRootOrder;
+
+        // depth below each root move
+        int mIterationDepth;
+
+        // next position in mRootOrder to search
+        int mNextRootMove;
+
+        // window and results for this depth, under mLock
+        int mAlpha;
+        int mBeta;
+        int mBestMove;
+        int mBestScore;
+
+        // -1 for no time limit
+        double mStopTime;
+        volatile int mStopped;
+
+
+        int mDepthReached;
+        int mScore;
+        uint64_t mNodesSearched;
+
+
+
+        // searches root moves from mRootOrder until they run out
+        void searchRootMoves( MinMaxThreadContext *inContext );
+
+        // fail-soft alpha-beta, returns 0 if the search is stopped
+        int search( MinMaxThreadContext *inContext, GameState *inState,
+                    MinOrMax inSide, int inDepth,
+                    int inAlpha, int inBeta, int inPly );
+
+        // returns true and fills the out values if inKey is in the table
+        char probeTable( uint64_t inKey, int *outScore, int *outDepth,
+                         int *outBound, uint64_t *outBestChild );
+
+        void storeTable( uint64_t inKey, int inScore, int inDepth,
+                         int inBound, uint64_t inBestChild );
+
+    };
+
+
+
+#endif
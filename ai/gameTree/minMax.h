@@ -1,3 +1,6 @@
+#ifndef MIN_MAX_INCLUDED
+#define MIN_MAX_INCLUDED
+
 
 #include "GameState.h"
 
@@ -28,3 +31,5 @@ int minMax( GameState *inCurrentState, MinOrMax inSide,
             int inMin = INT_MIN,
             int inMax = INT_MAX );
 
+
+#endif
@@ -0,0 +1,419 @@
+// Checks MinMaxSearcher's scores against minMax on Connect Four
+// positions, and times both.
+
+
+#include "minMax.h"
+#include "MinMaxSearcher.h"
+
+#include "minorGems/system/Time.h"
+
+#include <stdio.h>
+
+
+
+#define COLUMNS 7
+#define ROWS 6
+// one spare bit on top of each column keeps shifts from wrapping
+#define COLUMN_BITS ( ROWS + 1 )
+
+#define WIN_SCORE 1000000
+
+
+
+static uint64_t zobrist[2][ COLUMNS * COLUMN_BITS ];
+
+// each run of four cells in a line
+static uint64_t windows[ 100 ];
+static int numWindows = 0;
+
+
+
+static int countBits( uint64_t inBits ) {
+    int count = 0;
+    while( inBits != 0 ) {
+        inBits &= inBits - 1;
+        count++;
+        }
+    return count;
+    }
+
+
+
+static char hasFour( uint64_t inBits ) {
+    // vertical, horizontal, and both diagonals
+    int shifts[4] = { 1, COLUMN_BITS, COLUMN_BITS + 1, COLUMN_BITS - 1 };
+
+    for( int s=0; s<4; s++ ) {
+        uint64_t pairs = inBits & ( inBits >> shifts[s] );
+        if( pairs & ( pairs >> ( 2 * shifts[s] ) ) ) {
+            return true;
+            }
+        }
+    return false;
+    }
+
+
+
+static void setupTables() {
+    uint64_t seed = 1;
+
+    for( int p=0; p<2; p++ ) {
+        for( int i=0; i<COLUMNS * COLUMN_BITS; i++ ) {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            zobrist[p][i] = seed ^ ( seed >> 29 );
+            }
+        }
+
+    int directions[4][2] = { { 0, 1 }, { 1, 0 }, { 1, 1 }, { 1, -1 } };
+
+    for( int c=0; c<COLUMNS; c++ ) {
+        for( int r=0; r<ROWS; r++ ) {
+            for( int d=0; d<4; d++ ) {
+                int endC = c + 3 * directions[d][0];
+                int endR = r + 3 * directions[d][1];
+
+                if( endC < 0 || endC >= COLUMNS ||
+                    endR < 0 || endR >= ROWS ) {
+                    continue;
+                    }
+
+                uint64_t window = 0;
+                for( int k=0; k<4; k++ ) {
+                    window |= (uint64_t)1 <<
+                        ( ( c + k * directions[d][0] ) * COLUMN_BITS +
+                          r + k * directions[d][1] );
+                    }
+                windows[ numWindows ] = window;
+                numWindows++;
+                }
+            }
+        }
+    }
+
+
+
+// player 1 (max) moves first
+class ConnectFourState : public GameState {
+
+    public:
+
+        ConnectFourState( char inHashed )
+                : mHashed( inHashed ), mNumPieces( 0 ), mHash( 1 ) {
+            mPieces[0] = 0;
+            mPieces[1] = 0;
+            }
+
+
+        int getScore( char inDebug=false ) {
+            if( hasFour( mPieces[0] ) ) {
+                return WIN_SCORE;
+                }
+            if( hasFour( mPieces[1] ) ) {
+                return -WIN_SCORE;
+                }
+
+            int weights[5] = { 0, 1, 4, 32, 0 };
+            int score = 0;
+
+            for( int w=0; w<numWindows; w++ ) {
+                uint64_t window = windows[w];
+
+                if( ( window & mPieces[1] ) == 0 ) {
+                    score += weights[ countBits( window & mPieces[0] ) ];
+                    }
+                else if( ( window & mPieces[0] ) == 0 ) {
+                    score -= weights[ countBits( window & mPieces[1] ) ];
+                    }
+                }
+            return score;
+            }
+
+
+        char getGameOver() {
+            return mNumPieces == COLUMNS * ROWS ||
+                hasFour( mPieces[0] ) || hasFour( mPieces[1] );
+            }
+
+
+        SimpleVector<GameState *> getPossibleMoves() {
+            SimpleVector<GameState *> moves;
+
+            int player = mNumPieces % 2;
+            uint64_t filled = mPieces[0] | mPieces[1];
+
+            for( int c=0; c<COLUMNS; c++ ) {
+                for( int r=0; r<ROWS; r++ ) {
+                    int bit = c * COLUMN_BITS + r;
+
+                    if( ! ( filled & ( (uint64_t)1 << bit ) ) ) {
+                        ConnectFourState *move =
+                            (ConnectFourState *)copy();
+
+                        move->mPieces[ player ] |= (uint64_t)1 << bit;
+                        move->mNumPieces++;
+                        move->mHash ^= zobrist[ player ][ bit ];
+
+                        moves.push_back( move );
+                        break;
+                        }
+                    }
+                }
+            return moves;
+            }
+
+
+        GameState *copy() {
+            ConnectFourState *state = new ConnectFourState( mHashed );
+            state->copyFrom( this );
+            return state;
+            }
+
+
+        void copyFrom( GameState *inOther ) {
+            ConnectFourState *other = (ConnectFourState *)inOther;
+
+            mHashed = other->mHashed;
+            mPieces[0] = other->mPieces[0];
+            mPieces[1] = other->mPieces[1];
+            mNumPieces = other->mNumPieces;
+            mHash = other->mHash;
+            }
+
+
+        void printState() {
+            for( int r=ROWS - 1; r>=0; r-- ) {
+                for( int c=0; c<COLUMNS; c++ ) {
+                    uint64_t bit = (uint64_t)1 << ( c * COLUMN_BITS + r );
+
+                    if( mPieces[0] & bit ) {
+                        printf( "X" );
+                        }
+                    else if( mPieces[1] & bit ) {
+                        printf( "O" );
+                        }
+                    else {
+                        printf( "." );
+                        }
+                    }
+                printf( "\n" );
+                }
+            }
+
+
+        uint64_t getHash() {
+            if( mHashed ) {
+                return mHash;
+                }
+            return 0;
+            }
+
+
+        MinOrMax getSide() {
+            if( mNumPieces % 2 == 0 ) {
+                return max;
+                }
+            return min;
+            }
+
+
+        char mHashed;
+        uint64_t mPieces[2];
+        int mNumPieces;
+        uint64_t mHash;
+    };
+
+
+
+static MinOrMax switchSide( MinOrMax inSide ) {
+    if( inSide == min ) {
+        return max;
+        }
+    return min;
+    }
+
+
+
+static int numFailed = 0;
+
+
+
+// plays inNumMoves moves picked by inSeed from the empty board
+static ConnectFourState *makePosition( int inNumMoves, unsigned int inSeed,
+                                       char inHashed ) {
+    ConnectFourState *state = new ConnectFourState( inHashed );
+
+    for( int i=0; i<inNumMoves && ! state->getGameOver(); i++ ) {
+        SimpleVector<GameState *> moves = state->getPossibleMoves();
+
+        inSeed = inSeed * 1103515245 + 12345;
+        int pick = ( inSeed >> 16 ) % moves.size();
+
+        for( int m=0; m<moves.size(); m++ ) {
+            if( m != pick ) {
+                delete *( moves.getElement( m ) );
+                }
+            }
+        delete state;
+        state = (ConnectFourState *)( *( moves.getElement( pick ) ) );
+        }
+    return state;
+    }
+
+
+
+static void checkScores() {
+    MinMaxSearcher oneThread( 1 );
+    MinMaxSearcher threeThreads( 3 );
+    MinMaxSearcher noTable( 1, 0 );
+
+    int numChecked = 0;
+
+    for( int p=0; p<12; p++ ) {
+        for( int depth=0; depth<=5; depth++ ) {
+            ConnectFourState *state = makePosition( 4 + p, p + 1, true );
+            ConnectFourState *unhashed = makePosition( 4 + p, p + 1, false );
+
+            if( state->getGameOver() ) {
+                delete state;
+                delete unhashed;
+                continue;
+                }
+
+            MinOrMax side = state->getSide();
+
+            int expected = minMax( state, side, depth + 1 );
+
+            // the last without a hash, so ordered by score
+            MinMaxSearcher *searchers[4] =
+                { &oneThread, &threeThreads, &noTable, &noTable };
+            ConnectFourState *froms[4] =
+                { state, state, state, unhashed };
+
+            for( int s=0; s<4; s++ ) {
+                MinMaxSearcher *searcher = searchers[s];
+                ConnectFourState *from = froms[s];
+
+                GameState *move = searcher->pickMove( from, side, depth );
+
+                int moveScore = minMax( move, switchSide( side ), depth );
+                delete move;
+
+                if( searcher->getScore() != expected ||
+                    moveScore != expected ||
+                    searcher->getDepthReached() > depth ) {
+
+                    printf( "FAILED:  position %d, depth %d, searcher %d:  "
+                            "score %d, move score %d, expected %d\n",
+                            p, depth, s, searcher->getScore(), moveScore,
+                            expected );
+                    numFailed++;
+                    }
+                }
+            numChecked++;
+
+            delete state;
+            delete unhashed;
+            }
+        }
+
+    printf( "checked scores at %d positions and depths\n", numChecked );
+    }
+
+
+
+// fastest of a few runs, each with a new searcher, since one run is
+// too short to time reliably
+// (time-limited searches are run once, since the fastest of those
+//  would just be the one that stopped soonest)
+static void timeSearch( const char *inDescription, int inNumThreads,
+                        int inTableSize, char inHashed, int inDepth,
+                        double inTimeLimit ) {
+
+    double seconds = -1;
+    int depthReached = 0;
+    int score = 0;
+    uint64_t nodes = 0;
+
+    int numRuns = 3;
+    if( inTimeLimit >= 0 ) {
+        numRuns = 1;
+        }
+
+    for( int r=0; r<numRuns; r++ ) {
+        ConnectFourState *state = makePosition( 2, 7, inHashed );
+
+        MinMaxSearcher searcher( inNumThreads, inTableSize );
+
+        double startTime = Time::getPreciseTime();
+
+        GameState *move = searcher.pickMove( state, state->getSide(),
+                                             inDepth, inTimeLimit );
+
+        double runSeconds = Time::getPreciseTime() - startTime;
+
+        if( seconds < 0 || runSeconds < seconds ) {
+            seconds = runSeconds;
+            depthReached = searcher.getDepthReached();
+            score = searcher.getScore();
+            nodes = searcher.getNodesSearched();
+            }
+
+        delete move;
+        delete state;
+        }
+
+    printf( "%-32s depth %2d, score %4d, %6.2f sec, %9llu nodes, "
+            "%8.0f nodes/sec\n",
+            inDescription, depthReached, score, seconds,
+            (unsigned long long)nodes, nodes / seconds );
+    }
+
+
+
+int main() {
+
+    setupTables();
+
+    checkScores();
+
+
+    int depth = 8;
+
+    ConnectFourState *state = makePosition( 2, 7, true );
+
+    double startTime = Time::getPreciseTime();
+
+    GameState *move = minMaxPickMove( state, state->getSide(), depth );
+
+    printf( "%-32s depth %2d,             %6.2f sec\n", "minMaxPickMove",
+            depth, Time::getPreciseTime() - startTime );
+
+    delete move;
+    delete state;
+
+
+    // minMaxPickMove takes minutes at the deeper depth
+    int depths[2] = { depth, depth + 3 };
+
+    for( int d=0; d<2; d++ ) {
+        timeSearch( "no hash, no table", 1, 0, false, depths[d], -1 );
+        timeSearch( "hash, no table", 1, 0, true, depths[d], -1 );
+        timeSearch( "hash and table", 1, 1048576, true, depths[d], -1 );
+        timeSearch( "hash and table, 2 threads", 2, 1048576, true,
+                    depths[d], -1 );
+        timeSearch( "hash and table, 4 threads", 4, 1048576, true,
+                    depths[d], -1 );
+        }
+
+    timeSearch( "1 second", 1, 1048576, true, -1, 1 );
+    timeSearch( "1 second, 4 threads", 4, 1048576, true, -1, 1 );
+
+
+    if( numFailed > 0 ) {
+        printf( "%d checks FAILED\n", numFailed );
+        return 1;
+        }
+
+    printf( "All checks passed\n" );
+    return 0;
+    }
@@ -0,0 +1,128 @@
+#include "ZipInputStream.h"
+
+
+// miniz is compiled into encodingUtils
+#define MINIZ_NO_ZLIB_COMPATIBLE_NAMES
+#include "minorGems/formats/miniz.h"
+
+#include <string.h>
+
+
+
+ZipInputStream::ZipInputStream( InputStream *inStream,
+                                int inBufferSize )
+        : mStream( inStream ),
+          mZStream( new mz_stream ),
+          mBuffer( new unsigned char[ inBufferSize ] ),
+          mBufferSize( inBufferSize ),
+          mFinished( false ), mFailed( false ) {
+
+    memset( mZStream, 0, sizeof( mz_stream ) );
+
+    if( mz_inflateInit( mZStream ) != MZ_OK ) {
+        setNewLastErrorConst( "Zip stream failed to start decompressing." );
+        mFailed = true;
+        }
+    }
+
+
+
+ZipInputStream::~ZipInputStream() {
+    mz_inflateEnd( mZStream );
+
+    delete mZStream;
+    delete [] mBuffer;
+    }
+
+
+
+long ZipInputStream::decompress( unsigned char *inBuffer, long inNumBytes,
+                                 char inWaitForAll ) {
+    if( mFailed ) {
+        return -1;
+        }
+    if( mFinished || inNumBytes == 0 ) {
+        return 0;
+        }
+
+    mZStream->next_out = inBuffer;
+    mZStream->avail_out = inNumBytes;
+
+    long numOut = 0;
+
+    while( true ) {
+        // the inflater may have output left from the last call, so
+        // try it before reading more input
+        int result = mz_inflate( mZStream, MZ_NO_FLUSH );
+
+        numOut = inNumBytes - mZStream->avail_out;
+
+        if( result == MZ_STREAM_END ) {
+            mFinished = true;
+            break;
+            }
+        if( result != MZ_OK && result != MZ_BUF_ERROR ) {
+            setNewLastErrorConst( "Zip stream data corrupt." );
+            mFailed = true;
+            return -1;
+            }
+
+        if( mZStream->avail_out == 0 ) {
+            break;
+            }
+
+        if( result == MZ_BUF_ERROR ) {
+            // no progress without more input
+            if( ! inWaitForAll && numOut > 0 ) {
+                break;
+                }
+
+            long numRead = mStream->readAvailable( mBuffer, mBufferSize );
+
+            if( numRead <= 0 ) {
+                char *error = mStream->getLastError();
+
+                if( numRead == -1 && error != NULL ) {
+                    setNewLastError( error );
+                    }
+                else {
+                    if( error != NULL ) {
+                        delete [] error;
+                        }
+                    setNewLastErrorConst( "Zip stream ended early." );
+                    }
+                mFailed = true;
+
+                // the error shows up on the next read
+                if( numOut > 0 ) {
+                    break;
+                    }
+                return -1;
+                }
+
+            mZStream->next_in = mBuffer;
+            mZStream->avail_in = numRead;
+            }
+        }
+
+    return numOut;
+    }
+
+
+
+long ZipInputStream::read( unsigned char *inBuffer, long inNumBytes ) {
+    return decompress( inBuffer, inNumBytes, true );
+    }
+
+
+
+long ZipInputStream::readAvailable( unsigned char *inBuffer,
+                                    long inNumBytes ) {
+    return decompress( inBuffer, inNumBytes, false );
+    }
+
+
+
+char ZipInputStream::isFinished() {
+    return mFinished;
+    }
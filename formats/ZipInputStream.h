@@ -0,0 +1,86 @@
+#include "minorGems/common.h"
+
+
+#ifndef ZIP_INPUT_STREAM_CLASS_INCLUDED
+#define ZIP_INPUT_STREAM_CLASS_INCLUDED
+
+#include "minorGems/io/InputStream.h"
+
+
+
+// miniz's stream state, kept out of this header along with miniz
+struct mz_stream_s;
+
+
+
+/**
+ * An input stream that decompresses a zlib stream read from another
+ * stream, such as one written by ZipOutputStream or zipCompress.
+ *
+ * Unlike zipDecompress, the size of the result doesn't need to be known
+ * ahead of time, and only a small input buffer and the 32 KiB window
+ * are held in memory.
+ *
+ * read returns fewer bytes than requested only at the end of the
+ * compressed stream, after which it returns 0.  Corrupt or truncated
+ * data is a stream error.
+ */
+class ZipInputStream : public InputStream {
+
+	public:
+
+		/**
+		 * Constructs a decompressing stream.
+		 *
+		 * @param inStream the stream to read compressed data from.
+		 *   inStream is NOT destroyed when this stream is destroyed.
+         *   Bytes after the end of the compressed stream may be read
+         *   from inStream and dropped.
+         * @param inBufferSize the input buffer size in bytes.
+         *   Defaults to 65536.
+		 */
+		ZipInputStream( InputStream *inStream,
+                        int inBufferSize = 65536 );
+
+        ~ZipInputStream();
+
+
+
+        // implements the InputStream interface
+		virtual long read( unsigned char *inBuffer, long inNumBytes );
+
+        // returns as soon as some bytes have been decompressed
+		virtual long readAvailable( unsigned char *inBuffer,
+                                    long inNumBytes );
+
+
+
+        /**
+         * Gets whether the end of the compressed stream has been reached.
+         */
+        char isFinished();
+
+
+
+    protected:
+        InputStream *mStream;
+
+        mz_stream_s *mZStream;
+
+        unsigned char *mBuffer;
+        int mBufferSize;
+
+        char mFinished;
+        char mFailed;
+
+
+        // decompresses into inBuffer until it is full, the compressed
+        // stream ends, or (if inWaitForAll is false) once some bytes
+        // are decompressed and more would have to be read from inStream
+        long decompress( unsigned char *inBuffer, long inNumBytes,
+                         char inWaitForAll );
+    };
+
+
+
+#endif
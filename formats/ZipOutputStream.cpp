@@ -0,0 +1,432 @@
+#include "ZipOutputStream.h"
+
+#include "minorGems/system/Thread.h"
+#include "minorGems/util/SimpleVector.h"
+
+
+// miniz is compiled into encodingUtils
+#define MINIZ_NO_ZLIB_COMPATIBLE_NAMES
+#include "minorGems/formats/miniz.h"
+
+#include <string.h>
+
+
+
+// how far back deflate can reference
+#define WINDOW_BYTES 32768
+
+
+
+struct ZipCompressorState {
+        tdefl_compressor compressor;
+
+        OutputStream *stream;
+    };
+
+
+
+static mz_bool writeToStream( const void *inBuffer, int inLength,
+                              void *inState ) {
+    OutputStream *stream = ( (ZipCompressorState *)inState )->stream;
+
+    return stream->write( (unsigned char *)inBuffer, inLength ) == inLength;
+    }
+
+
+
+static mz_bool appendToVector( const void *inBuffer, int inLength,
+                               void *inVector ) {
+    ( (SimpleVector<unsigned char> *)inVector )->appendArray(
+        (unsigned char *)inBuffer, inLength );
+    return MZ_TRUE;
+    }
+
+
+
+/**
+ * Compresses one block into a raw deflate stream.
+ *
+ * Blocks end on a byte boundary (a sync flush), so their streams can be
+ * joined end-to-end into one deflate stream.  Only the last block ends
+ * the stream.
+ *
+ * The data before the block is compressed first and its output thrown
+ * away, which leaves it in the compressor's window so that the block can
+ * reference it.  A reader decompressing the joined stream has that same
+ * data in its window at that point.
+ */
+class ZipBlockCompressor : public Thread {
+    public:
+        ZipBlockCompressor( unsigned char *inData, int inLength,
+                            unsigned char *inDictionary,
+                            int inDictionaryLength,
+                            int inCompressionLevel, char inFinal )
+                : mData( inData ), mLength( inLength ),
+                  mDictionary( inDictionary ),
+                  mDictionaryLength( inDictionaryLength ),
+                  mCompressionLevel( inCompressionLevel ),
+                  mFinal( inFinal ) {
+            }
+
+
+        // can be called directly, or through start and join
+        virtual void run();
+
+
+        SimpleVector<unsigned char> mCompressed;
+
+    protected:
+        unsigned char *mData;
+        int mLength;
+        unsigned char *mDictionary;
+        int mDictionaryLength;
+        int mCompressionLevel;
+        char mFinal;
+    };
+
+
+
+void ZipBlockCompressor::run() {
+    // tdefl_compressor is too big for the stack
+    tdefl_compressor *compressor = new tdefl_compressor;
+
+    // negative window bits for raw deflate, since the zlib header
+    // and checksum go around the joined blocks
+    mz_uint flags = tdefl_create_comp_flags_from_zip_params(
+        mCompressionLevel, -MZ_DEFAULT_WINDOW_BITS, MZ_DEFAULT_STRATEGY );
+
+    tdefl_init( compressor, appendToVector, &mCompressed, (int)flags );
+
+    if( mDictionaryLength > 0 ) {
+        tdefl_compress_buffer( compressor, mDictionary, mDictionaryLength,
+                               TDEFL_SYNC_FLUSH );
+        mCompressed.deleteAll();
+        }
+
+    mCompressed.reserve( mLength / 2 );
+
+    tdefl_compress_buffer( compressor, mData, mLength,
+                           mFinal ? TDEFL_FINISH : TDEFL_SYNC_FLUSH );
+
+    delete compressor;
+    }
+
+
+
+ZipOutputStream::ZipOutputStream( OutputStream *inStream,
+                                  int inCompressionLevel,
+                                  int inNumThreads,
+                                  int inBlockSize )
+        : mStream( inStream ),
+          mCompressionLevel( inCompressionLevel ),
+          mNumThreads( inNumThreads ),
+          mBlockSize( inBlockSize ),
+          mFinished( false ), mFailed( false ),
+          mCompressor( NULL ),
+          mBuffer( NULL ), mBufferSize( 0 ), mNumBuffered( 0 ),
+          mDictionary( NULL ), mDictionaryLength( 0 ),
+          mHeaderWritten( false ),
+          mAdler( MZ_ADLER32_INIT ) {
+
+    if( mCompressionLevel < 0 ) {
+        mCompressionLevel = 0;
+        }
+    else if( mCompressionLevel > 9 ) {
+        mCompressionLevel = 9;
+        }
+
+    if( mNumThreads < 1 ) {
+        mNumThreads = 1;
+        }
+
+    if( mNumThreads == 1 ) {
+        mCompressor = new ZipCompressorState;
+        mCompressor->stream = mStream;
+
+        // positive window bits for the zlib header and checksum
+        mz_uint flags = tdefl_create_comp_flags_from_zip_params(
+            mCompressionLevel, MZ_DEFAULT_WINDOW_BITS, MZ_DEFAULT_STRATEGY );
+
+        tdefl_init( &( mCompressor->compressor ),
+                    writeToStream, mCompressor, (int)flags );
+        }
+    else {
+        // each block after the first references a full window
+        // before it in mBuffer
+        if( mBlockSize < WINDOW_BYTES ) {
+            mBlockSize = WINDOW_BYTES;
+            }
+
+        mBufferSize = mNumThreads * mBlockSize;
+        mBuffer = new unsigned char[ mBufferSize ];
+        mDictionary = new unsigned char[ WINDOW_BYTES ];
+        }
+    }
+
+
+
+ZipOutputStream::~ZipOutputStream() {
+    if( ! mFinished ) {
+        finish();
+        }
+
+    if( mCompressor != NULL ) {
+        delete mCompressor;
+        }
+    if( mBuffer != NULL ) {
+        delete [] mBuffer;
+        }
+    if( mDictionary != NULL ) {
+        delete [] mDictionary;
+        }
+    }
+
+
+
+void ZipOutputStream::takeStreamError( const char *inDefaultError ) {
+    mFailed = true;
+
+    char *error = mStream->getLastError();
+
+    if( error != NULL ) {
+        setNewLastError( error );
+        }
+    else {
+        setNewLastErrorConst( inDefaultError );
+        }
+    }
+
+
+
+long ZipOutputStream::write( unsigned char *inBuffer, long inNumBytes ) {
+    if( mFinished ) {
+        setNewLastErrorConst( "Zip stream written after finish." );
+        return -1;
+        }
+    if( mFailed ) {
+        return -1;
+        }
+
+
+    if( mCompressor != NULL ) {
+        tdefl_status status =
+            tdefl_compress_buffer( &( mCompressor->compressor ),
+                                   inBuffer, inNumBytes, TDEFL_NO_FLUSH );
+
+        if( status != TDEFL_STATUS_OKAY ) {
+            takeStreamError( "Zip stream failed to write." );
+            return -1;
+            }
+        return inNumBytes;
+        }
+
+
+    long numLeft = inNumBytes;
+
+    while( numLeft > 0 ) {
+        long numToCopy = mBufferSize - mNumBuffered;
+
+        if( numToCopy > numLeft ) {
+            numToCopy = numLeft;
+            }
+
+        memcpy( &( mBuffer[ mNumBuffered ] ),
+                &( inBuffer[ inNumBytes - numLeft ] ), numToCopy );
+
+        mNumBuffered += numToCopy;
+        numLeft -= numToCopy;
+
+        if( mNumBuffered == mBufferSize ) {
+            if( compressBuffered( false ) == -1 ) {
+                return -1;
+                }
+            }
+        }
+
+    return inNumBytes;
+    }
+
+
+
+long ZipOutputStream::compressBuffered( char inFinal ) {
+
+    if( ! mHeaderWritten ) {
+        // zlib header, as in PNGImageConverter
+        // compression method 8 (deflate) with a 32768-byte window
+        unsigned char cmf = 0x78;
+
+        // compression level hint in top 2 bits (0 fastest to 3 best),
+        // no preset dictionary, and check bits making the header
+        // a multiple of 31
+        int levelHint = 2;
+        if( mCompressionLevel < 2 ) {
+            levelHint = 0;
+            }
+        else if( mCompressionLevel < 6 ) {
+            levelHint = 1;
+            }
+        else if( mCompressionLevel > 6 ) {
+            levelHint = 3;
+            }
+        unsigned char flg = (unsigned char)( levelHint << 6 );
+        flg += ( 31 - ( ( cmf * 256 + flg ) % 31 ) ) % 31;
+
+        unsigned char header[2] = { cmf, flg };
+
+        if( mStream->write( header, 2 ) != 2 ) {
+            takeStreamError( "Zip stream failed to write header." );
+            return -1;
+            }
+        mHeaderWritten = true;
+        }
+
+
+    int numBlocks = ( mNumBuffered + mBlockSize - 1 ) / mBlockSize;
+
+    if( numBlocks == 0 && inFinal ) {
+        // an empty block to end the stream
+        numBlocks = 1;
+        }
+
+    ZipBlockCompressor **blocks = new ZipBlockCompressor*[ numBlocks ];
+
+    for( int b=0; b<numBlocks; b++ ) {
+        int start = b * mBlockSize;
+        int length = mBlockSize;
+
+        if( start + length > mNumBuffered ) {
+            length = mNumBuffered - start;
+            }
+
+        unsigned char *dictionary = mDictionary;
+        int dictionaryLength = mDictionaryLength;
+
+        if( b > 0 ) {
+            dictionary = &( mBuffer[ start - WINDOW_BYTES ] );
+            dictionaryLength = WINDOW_BYTES;
+            }
+
+        blocks[b] = new ZipBlockCompressor( &( mBuffer[ start ] ), length,
+                                            dictionary, dictionaryLength,
+                                            mCompressionLevel,
+                                            inFinal && b == numBlocks - 1 );
+        }
+
+    // first block on this thread
+    for( int b=1; b<numBlocks; b++ ) {
+        blocks[b]->start();
+        }
+
+    mAdler = mz_adler32( mAdler, mBuffer, mNumBuffered );
+
+    if( numBlocks > 0 ) {
+        blocks[0]->run();
+        }
+    for( int b=1; b<numBlocks; b++ ) {
+        blocks[b]->join();
+        }
+
+
+    for( int b=0; b<numBlocks; b++ ) {
+        SimpleVector<unsigned char> *data = &( blocks[b]->mCompressed );
+
+        if( ! mFailed && data->size() > 0 ) {
+            if( mStream->write( data->getElementFast( 0 ), data->size() )
+                != data->size() ) {
+                takeStreamError( "Zip stream failed to write." );
+                }
+            }
+        delete blocks[b];
+        }
+    delete [] blocks;
+
+    if( mFailed ) {
+        return -1;
+        }
+
+
+    // keep the last window of data for the next blocks to reference
+    if( mNumBuffered >= WINDOW_BYTES ) {
+        memcpy( mDictionary, &( mBuffer[ mNumBuffered - WINDOW_BYTES ] ),
+                WINDOW_BYTES );
+        mDictionaryLength = WINDOW_BYTES;
+        }
+    else {
+        int numOld = WINDOW_BYTES - mNumBuffered;
+        if( numOld > mDictionaryLength ) {
+            numOld = mDictionaryLength;
+            }
+        memmove( mDictionary,
+                 &( mDictionary[ mDictionaryLength - numOld ] ), numOld );
+        memcpy( &( mDictionary[ numOld ] ), mBuffer, mNumBuffered );
+        mDictionaryLength = numOld + mNumBuffered;
+        }
+
+    mNumBuffered = 0;
+
+
+    if( inFinal ) {
+        // adler32 of all uncompressed data, big-endian
+        unsigned char trailer[4] = {
+            (unsigned char)( ( mAdler >> 24 ) & 0xff ),
+            (unsigned char)( ( mAdler >> 16 ) & 0xff ),
+            (unsigned char)( ( mAdler >> 8 ) & 0xff ),
+            (unsigned char)( mAdler & 0xff ) };
+
+        if( mStream->write( trailer, 4 ) != 4 ) {
+            takeStreamError( "Zip stream failed to write checksum." );
+            return -1;
+            }
+        }
+
+    return 0;
+    }
+
+
+
+long ZipOutputStream::flush() {
+    if( mFinished || mFailed ) {
+        return -1;
+        }
+
+    if( mCompressor != NULL ) {
+        tdefl_status status =
+            tdefl_compress_buffer( &( mCompressor->compressor ),
+                                   NULL, 0, TDEFL_SYNC_FLUSH );
+
+        if( status != TDEFL_STATUS_OKAY ) {
+            takeStreamError( "Zip stream failed to flush." );
+            return -1;
+            }
+        return 0;
+        }
+
+    // blocks always end on a sync flush
+    if( mNumBuffered == 0 ) {
+        return 0;
+        }
+    return compressBuffered( false );
+    }
+
+
+
+long ZipOutputStream::finish() {
+    if( mFinished || mFailed ) {
+        return -1;
+        }
+    mFinished = true;
+
+    if( mCompressor != NULL ) {
+        tdefl_status status =
+            tdefl_compress_buffer( &( mCompressor->compressor ),
+                                   NULL, 0, TDEFL_FINISH );
+
+        if( status != TDEFL_STATUS_DONE ) {
+            takeStreamError( "Zip stream failed to finish." );
+            return -1;
+            }
+        return 0;
+        }
+
+    return compressBuffered( true );
+    }
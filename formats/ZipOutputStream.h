@@ -0,0 +1,130 @@
+#include "minorGems/common.h"
+
+
+#ifndef ZIP_OUTPUT_STREAM_CLASS_INCLUDED
+#define ZIP_OUTPUT_STREAM_CLASS_INCLUDED
+
+#include "minorGems/io/OutputStream.h"
+
+
+
+// compressor state, kept out of this header along with miniz
+struct ZipCompressorState;
+
+
+
+/**
+ * An output stream that zlib-compresses everything written to it and
+ * passes the compressed bytes on to another stream.
+ *
+ * The result is a standard zlib stream, readable by ZipInputStream or
+ * zipDecompress, so data too large to hold in memory can be compressed
+ * as it is produced.
+ *
+ * With more than one thread, data is gathered into blocks that are
+ * compressed in parallel.  Each block still references the end of the
+ * block before it, so the result is only slightly larger than
+ * single-threaded output.
+ *
+ * Memory use is bounded:  about 300 KiB of compressor state with one
+ * thread, and about that plus two blocks per thread otherwise.
+ */
+class ZipOutputStream : public OutputStream {
+
+	public:
+
+		/**
+		 * Constructs a compressing stream.
+		 *
+		 * @param inStream the stream to write compressed data to.
+		 *   inStream is NOT destroyed when this stream is destroyed.
+         * @param inCompressionLevel 0 (store only, fastest) to
+         *   9 (smallest).  Defaults to 6, zlib's default.
+         * @param inNumThreads how many blocks to compress at once.
+         *   Defaults to 1, which compresses on the calling thread with
+         *   no block buffering.
+         * @param inBlockSize bytes per block with more than one thread.
+         *   Defaults to 1 MiB.
+		 */
+		ZipOutputStream( OutputStream *inStream,
+                         int inCompressionLevel = 6,
+                         int inNumThreads = 1,
+                         int inBlockSize = 1048576 );
+
+        // finishes the stream if finish has not been called
+        ~ZipOutputStream();
+
+
+
+        // implements the OutputStream interface
+        // with more than one thread, a failure to write earlier data can
+        // show up as a failure of a later write
+		virtual long write( unsigned char *inBuffer, long inNumBytes );
+
+
+
+        /**
+         * Compresses all data written so far and passes it on, so that a
+         * reader can decompress all of it without waiting for more.
+         *
+         * Costs a little compression each time, so should be called only
+         * when a reader is waiting (at the end of a network message,
+         * for example).
+         *
+         * @return 0 on success, or -1 for a stream error.
+         */
+        long flush();
+
+
+
+        /**
+         * Ends the compressed stream.  Nothing can be written after this.
+         *
+         * @return 0 on success, or -1 for a stream error.
+         */
+        long finish();
+
+
+
+    protected:
+        OutputStream *mStream;
+
+        int mCompressionLevel;
+        int mNumThreads;
+        int mBlockSize;
+
+        char mFinished;
+        char mFailed;
+
+        // for one thread
+        ZipCompressorState *mCompressor;
+
+
+        // for more than one thread
+
+        unsigned char *mBuffer;
+        int mBufferSize;
+        int mNumBuffered;
+
+        // the end of the data before mBuffer, which blocks can reference
+        unsigned char *mDictionary;
+        int mDictionaryLength;
+
+        char mHeaderWritten;
+
+        // of all uncompressed data
+        unsigned long mAdler;
+
+
+        // compresses buffered data in parallel and writes it
+        // inFinal to end the deflate stream
+        long compressBuffered( char inFinal );
+
+
+        // passes errors from mStream on to this stream
+        void takeStreamError( const char *inDefaultError );
+    };
+
+
+
+#endif
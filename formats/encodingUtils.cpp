@@ -455,7 +455,8 @@ unsigned char *base64Decode( char *inBase64String,
 
 
 unsigned char *zipCompress( unsigned char *inData, int inDataLength,
-                            int *outCompressedDataLength ) {
+                            int *outCompressedDataLength,
+                            int inCompressionLevel ) {
     
     int maxCompLength = compressBound( inDataLength );
     
@@ -463,8 +464,8 @@ unsigned char *zipCompress( unsigned char *inData, int inDataLength,
     
     mz_ulong compLength = maxCompLength;
     
-    int cmp_status = compress( compressBuffer, &compLength, 
-                               inData, inDataLength );
+    int cmp_status = compress2( compressBuffer, &compLength, 
+                                inData, inDataLength, inCompressionLevel );
     if( cmp_status != Z_OK ) {
         printf( "zipCompress failed\n" );
         delete [] compressBuffer;
@@ -516,5 +517,71 @@ unsigned char *zipDecompress( unsigned char *inCompressedData,
 
 
 
+unsigned char *zipDecompress( unsigned char *inCompressedData, 
+                              int inCompressedDataLength,
+                              int *outResultDataLength ) {
+
+    mz_stream stream;
+    memset( &stream, 0, sizeof( stream ) );
+
+    if( inflateInit( &stream ) != Z_OK ) {
+        printf( "zipDecompress failed\n" );
+        return NULL;
+        }
+
+    stream.next_in = inCompressedData;
+    stream.avail_in = inCompressedDataLength;
+
+    // compressed data usually expands 2-4x, so rarely grows more than
+    // once or twice
+    int resultSize = 0;
+    int bufferSize = inCompressedDataLength * 4 + 256;
+    unsigned char *dataBuffer = new unsigned char[ bufferSize ];
+
+    while( true ) {
+        stream.next_out = &( dataBuffer[ resultSize ] );
+        stream.avail_out = bufferSize - resultSize;
+
+        int cmp_status = inflate( &stream, Z_NO_FLUSH );
+
+        resultSize = bufferSize - stream.avail_out;
+
+        if( cmp_status == Z_STREAM_END ) {
+            break;
+            }
+        
+        if( ( cmp_status != Z_OK && cmp_status != Z_BUF_ERROR ) ||
+            ( cmp_status == Z_BUF_ERROR && stream.avail_out > 0 ) ) {
+            // corrupt, or out of input before the end
+            printf( "zipDecompress failed\n" );
+            inflateEnd( &stream );
+            delete [] dataBuffer;
+            return NULL;
+            }
+
+        if( stream.avail_out > 0 ) {
+            // inflate can return before filling the buffer
+            continue;
+            }
+
+        int newSize = bufferSize * 2;
+        unsigned char *newBuffer = new unsigned char[ newSize ];
+        memcpy( newBuffer, dataBuffer, resultSize );
+        delete [] dataBuffer;
+
+        dataBuffer = newBuffer;
+        bufferSize = newSize;
+        }
+
+    inflateEnd( &stream );
+
+    *outResultDataLength = resultSize;
+
+    return dataBuffer;
+    }
+
+
+
+
 
  
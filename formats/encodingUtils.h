@@ -92,11 +92,15 @@ unsigned char *base64Decode( char *inBase64String,
 
 
 // implements zlib-compatible compression and decompression
+// see ZipOutputStream and ZipInputStream for data too large to hold
+// in memory all at once
 
 // return NULL on failure, caller destroys result
 
+// inCompressionLevel is 0 (store only, fastest) to 9 (smallest)
 unsigned char *zipCompress( unsigned char *inData, int inDataLength,
-                            int *outCompressedDataLength );
+                            int *outCompressedDataLength,
+                            int inCompressionLevel = 6 );
 
 
 // we must know the size of the result before decompressing, because
@@ -108,6 +112,13 @@ unsigned char *zipDecompress( unsigned char *inCompressedData,
                               int inExpectedResultDataLength );
 
 
+// for data whose size wasn't tracked, at the cost of growing the result
+// as it is decompressed
+unsigned char *zipDecompress( unsigned char *inCompressedData, 
+                              int inCompressedDataLength,
+                              int *outResultDataLength );
+
+
 
 
  
@@ -0,0 +1,287 @@
+// round trips data through ZipOutputStream and ZipInputStream, checks
+// them against zipCompress and zipDecompress, and times compression
+// with different numbers of threads
+
+
+#include "ZipOutputStream.h"
+#include "ZipInputStream.h"
+#include "encodingUtils.h"
+
+#include "minorGems/util/StringBufferOutputStream.h"
+#include "minorGems/util/ByteBufferInputStream.h"
+#include "minorGems/system/Time.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+static int numFailed = 0;
+
+
+static void check( char inCondition, const char *inMessage ) {
+    if( ! inCondition ) {
+        printf( "FAILED:  %s\n", inMessage );
+        numFailed++;
+        }
+    }
+
+
+
+// compressible but not trivially so, like a recording or a bundle
+static unsigned char *makeData( int inLength ) {
+    const char *words[8] = { "frame ", "mouse 102 384 ", "key a ",
+                             "step ", "sound 3 ", "move 17 -4 ",
+                             "12345 ", "\n" };
+
+    unsigned char *data = new unsigned char[ inLength ];
+
+    unsigned int seed = 1;
+    int i = 0;
+
+    while( i < inLength ) {
+        seed = seed * 1103515245 + 12345;
+
+        const char *word = words[ ( seed >> 16 ) % 8 ];
+
+        if( ( seed >> 8 ) % 16 == 0 ) {
+            // some noise
+            data[i] = (unsigned char)( seed >> 24 );
+            i++;
+            continue;
+            }
+
+        for( int j=0; word[j] != '\0' && i < inLength; j++ ) {
+            data[i] = word[j];
+            i++;
+            }
+        }
+
+    return data;
+    }
+
+
+
+// writes inData in uneven pieces, flushing partway if inFlush
+static unsigned char *compressToBuffer( unsigned char *inData, int inLength,
+                                        int inLevel, int inNumThreads,
+                                        int inBlockSize, char inFlush,
+                                        int *outLength ) {
+
+    StringBufferOutputStream buffer;
+
+    ZipOutputStream *zip = new ZipOutputStream( &buffer, inLevel,
+                                                inNumThreads, inBlockSize );
+
+    int pos = 0;
+    int piece = 1;
+
+    while( pos < inLength ) {
+        int length = piece;
+        if( pos + length > inLength ) {
+            length = inLength - pos;
+            }
+
+        check( zip->write( &( inData[ pos ] ), length ) == length,
+               "write" );
+        pos += length;
+
+        piece = piece * 3 + 7;
+
+        if( inFlush && pos > inLength / 2 && pos - length <= inLength / 2 ) {
+            check( zip->flush() == 0, "flush" );
+            }
+        }
+
+    check( zip->finish() == 0, "finish" );
+
+    check( zip->write( inData, 1 ) == -1, "write after finish fails" );
+
+    delete zip;
+
+    return buffer.getBytes( outLength );
+    }
+
+
+
+static void testRoundTrip( int inLength, int inLevel, int inNumThreads,
+                           int inBlockSize, char inFlush ) {
+
+    unsigned char *data = makeData( inLength );
+
+    int compLength;
+    unsigned char *comp = compressToBuffer( data, inLength, inLevel,
+                                            inNumThreads, inBlockSize,
+                                            inFlush, &compLength );
+
+    printf( "%8d bytes, level %d, %d threads, %7d block%s:  %8d bytes\n",
+            inLength, inLevel, inNumThreads, inBlockSize,
+            inFlush ? ", flushed" : "", compLength );
+
+
+    unsigned char *result = zipDecompress( comp, compLength, inLength );
+
+    check( result != NULL && memcmp( result, data, inLength ) == 0,
+           "zipDecompress of stream output" );
+
+    if( result != NULL ) {
+        delete [] result;
+        }
+
+
+    int resultLength;
+    result = zipDecompress( comp, compLength, &resultLength );
+
+    check( result != NULL && resultLength == inLength &&
+           memcmp( result, data, inLength ) == 0,
+           "zipDecompress of unknown size" );
+
+    if( result != NULL ) {
+        delete [] result;
+        }
+
+
+    // read back in uneven pieces through a small buffer
+    ByteBufferInputStream compStream( comp, compLength );
+    ZipInputStream unzip( &compStream, 1000 );
+
+    result = new unsigned char[ inLength + 1 ];
+
+    int pos = 0;
+    int piece = 1;
+    char readFailed = false;
+
+    while( pos < inLength + 1 ) {
+        int length = piece;
+        if( pos + length > inLength + 1 ) {
+            length = inLength + 1 - pos;
+            }
+
+        long numRead = unzip.read( &( result[ pos ] ), length );
+
+        if( numRead == -1 ) {
+            readFailed = true;
+            break;
+            }
+
+        pos += numRead;
+
+        if( numRead < length ) {
+            break;
+            }
+        piece = piece * 2 + 5;
+        }
+
+    check( ! readFailed && pos == inLength &&
+           memcmp( result, data, inLength ) == 0,
+           "ZipInputStream round trip" );
+    check( unzip.isFinished(), "ZipInputStream finished" );
+    check( unzip.read( result, 10 ) == 0, "read after end returns 0" );
+
+    delete [] result;
+    delete [] comp;
+    delete [] data;
+    }
+
+
+
+static void testErrors() {
+    int length = 100000;
+    unsigned char *data = makeData( length );
+
+    int compLength;
+    unsigned char *comp = compressToBuffer( data, length, 6, 2, 32768,
+                                            false, &compLength );
+
+    unsigned char *result = new unsigned char[ length ];
+
+
+    // truncated
+    ByteBufferInputStream shortStream( comp, compLength - 10 );
+    ZipInputStream shortUnzip( &shortStream );
+
+    long numRead = shortUnzip.read( result, length );
+
+    check( numRead < length, "truncated stream reads short" );
+    check( shortUnzip.read( result, length ) == -1,
+           "truncated stream fails" );
+    check( shortUnzip.getLastError() != NULL, "truncated stream error" );
+
+
+    // checksum changed
+    comp[ compLength - 1 ] ^= 1;
+
+    ByteBufferInputStream badStream( comp, compLength );
+    ZipInputStream badUnzip( &badStream );
+
+    check( badUnzip.read( result, length + 1 ) == -1,
+           "bad checksum fails" );
+
+    delete [] result;
+    delete [] comp;
+    delete [] data;
+    }
+
+
+
+static void timeCompression( int inLength, int inLevel ) {
+    unsigned char *data = makeData( inLength );
+
+    int wholeLength;
+    double startTime = Time::getPreciseTime();
+
+    unsigned char *comp = zipCompress( data, inLength, &wholeLength,
+                                       inLevel );
+
+    printf( "level %d zipCompress:  %.3f sec, %d bytes\n", inLevel,
+            Time::getPreciseTime() - startTime, wholeLength );
+    delete [] comp;
+
+    for( int t=1; t<=4; t*=2 ) {
+        int compLength;
+        startTime = Time::getPreciseTime();
+
+        comp = compressToBuffer( data, inLength, inLevel, t, 1048576,
+                                 false, &compLength );
+
+        printf( "level %d, %d threads:  %.3f sec, %d bytes\n", inLevel, t,
+                Time::getPreciseTime() - startTime, compLength );
+        delete [] comp;
+        }
+
+    delete [] data;
+    }
+
+
+
+int main() {
+
+    int levels[4] = { 0, 1, 6, 9 };
+
+    for( int i=0; i<4; i++ ) {
+        testRoundTrip( 0, levels[i], 1, 32768, false );
+        testRoundTrip( 0, levels[i], 3, 32768, false );
+        testRoundTrip( 200000, levels[i], 1, 32768, false );
+        testRoundTrip( 200000, levels[i], 1, 32768, true );
+        testRoundTrip( 200000, levels[i], 3, 32768, false );
+        testRoundTrip( 200000, levels[i], 3, 32768, true );
+        testRoundTrip( 200000, levels[i], 4, 1048576, false );
+        }
+
+    // exact multiple of the buffer
+    testRoundTrip( 2 * 3 * 40000, 6, 3, 40000, false );
+
+    testErrors();
+
+    timeCompression( 16 * 1048576, 1 );
+    timeCompression( 16 * 1048576, 6 );
+
+    if( numFailed > 0 ) {
+        printf( "%d checks FAILED\n", numFailed );
+        return 1;
+        }
+
+    printf( "All checks passed\n" );
+    return 0;
+    }
@@ -1,10 +1,12 @@
 #include "Font.h"
 
 #include "minorGems/graphics/RGBAImage.h"
+#include "minorGems/graphics/SkylinePacker.h"
 
 #include <string.h>
 #include <iostream>
 #include "minorGems/util/SettingsManager.h"
+#include "minorGems/util/stringUtils.h"
 
 
 typedef union rgbaColor {
@@ -111,7 +113,218 @@ static int unicodeWide = 22;
 static double unicodeScale = 1.4;
 static int unicodeOffset = -5;
 static xCharTexture unicodeTex[65536];
-static SimpleVector<unicode> loadedUnicode; 
+
+
+
+// FreeType glyphs are packed into a few large alpha-only textures (pages)
+// so that a run of them can be drawn with one texture bind and one
+// vertex array per page, instead of one texture per glyph.
+//
+// Each page is filled with a skyline packer.  When a glyph fits on no
+// page and no more pages can be made, the least recently drawn page is 
+// emptied and refilled.
+
+#define GLYPH_PAGE_SIZE 512
+#define MAX_GLYPH_PAGES 8
+
+// empty border around each glyph, so linear filtering doesn't pick
+// up neighbors
+#define GLYPH_PADDING 1
+
+
+class GlyphPage {
+    public:
+        
+        GlyphPage() 
+                : packer( GLYPH_PAGE_SIZE, GLYPH_PAGE_SIZE ),
+                  lastUsed( 0 ) {
+            
+            unsigned char *blank = 
+                new unsigned char[ GLYPH_PAGE_SIZE * GLYPH_PAGE_SIZE ];
+            memset( blank, 0, GLYPH_PAGE_SIZE * GLYPH_PAGE_SIZE );
+            
+            tex = new SingleTextureGL( true, blank, 
+                                       GLYPH_PAGE_SIZE, GLYPH_PAGE_SIZE,
+                                       false, false );
+            delete [] blank;
+            
+            tex->enable();
+            glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, 
+                             GL_LINEAR );
+            glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, 
+                             GL_LINEAR );
+            
+            clear();
+            }
+
+        ~GlyphPage() {
+            delete tex;
+            }
+        
+
+        // forgets all glyphs on page
+        void clear() {
+            for( int i=0; i<glyphs.size(); i++ ) {
+                unicodeTex[ glyphs.getElementDirect( i ) ].mPage = -1;
+                }
+            glyphs.deleteAll();
+            
+            packer.clear();
+            }
+        
+
+        // draws and clears pending quads
+        void flush() {
+            int numVerts = verts.size() / 2;
+            
+            if( numVerts == 0 ) {
+                return;
+                }
+            
+            tex->enable();
+
+            glEnableClientState( GL_VERTEX_ARRAY );
+            glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+            
+            glVertexPointer( 2, GL_FLOAT, 0, verts.getElementFast( 0 ) );
+            glTexCoordPointer( 2, GL_FLOAT, 0, 
+                               texCoords.getElementFast( 0 ) );
+            
+            glDrawArrays( GL_QUADS, 0, numVerts );
+            
+            glDisableClientState( GL_VERTEX_ARRAY );
+            glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+
+            verts.deleteAll();
+            texCoords.deleteAll();
+            }
+        
+
+        SingleTextureGL *tex;
+        
+        SkylinePacker packer;
+        
+        // glyphs on this page
+        SimpleVector<unicode> glyphs;
+        
+        // glyphBatchStamp when page was last drawn from
+        unsigned int lastUsed;
+        
+        // quads waiting to be drawn from this page
+        SimpleVector<float> verts;
+        SimpleVector<float> texCoords;
+    };
+
+
+
+static GlyphPage *glyphPages[ MAX_GLYPH_PAGES ];
+static int numGlyphPages = 0;
+
+// bumped for each batch, for LRU page eviction
+static unsigned int glyphBatchStamp = 0;
+
+// true if current batch is drawn faded (for erased fonts)
+static char glyphBatchErased = false;
+
+
+
+// draws all pending glyph quads
+static void flushGlyphBatch() {
+    char anyPending = false;
+    for( int p=0; p<numGlyphPages; p++ ) {
+        if( glyphPages[p]->verts.size() > 0 ) {
+            anyPending = true;
+            break;
+            }
+        }
+    
+    if( !anyPending ) {
+        return;
+        }
+    
+    // sprites for ASCII characters go first, and GL state must be left
+    // the way sprite drawing expects it
+    flushSpriteBatch();
+    
+    float alpha = getDrawColor().a;
+    
+    if( glyphBatchErased ) {
+        setDrawFade( alpha * 0.1 );
+        }
+    
+    for( int p=0; p<numGlyphPages; p++ ) {
+        glyphPages[p]->flush();
+        }
+
+    if( glyphBatchErased ) {
+        setDrawFade( alpha );
+        }
+    }
+
+
+
+static void freeGlyphPages() {
+    for( int p=0; p<numGlyphPages; p++ ) {
+        glyphPages[p]->clear();
+        delete glyphPages[p];
+        glyphPages[p] = NULL;
+        }
+    numGlyphPages = 0;
+    }
+
+
+
+// finds room for a glyph in atlas, making or emptying a page if needed
+// returns page index, or -1 if glyph is too big for a page
+static int packGlyph( int inWidth, int inHeight, int *outX, int *outY ) {
+    
+    int paddedW = inWidth + 2 * GLYPH_PADDING;
+    int paddedH = inHeight + 2 * GLYPH_PADDING;
+    
+    if( paddedW > GLYPH_PAGE_SIZE || paddedH > GLYPH_PAGE_SIZE ) {
+        return -1;
+        }
+    
+    int x, y;
+    
+    for( int p=0; p<numGlyphPages; p++ ) {
+        if( glyphPages[p]->packer.pack( paddedW, paddedH, &x, &y ) ) {
+            *outX = x + GLYPH_PADDING;
+            *outY = y + GLYPH_PADDING;
+            return p;
+            }
+        }
+
+    int p;
+    
+    if( numGlyphPages < MAX_GLYPH_PAGES ) {
+        p = numGlyphPages;
+        glyphPages[p] = new GlyphPage();
+        numGlyphPages++;
+        }
+    else {
+        p = 0;
+        for( int i=1; i<numGlyphPages; i++ ) {
+            if( glyphPages[i]->lastUsed < glyphPages[p]->lastUsed ) {
+                p = i;
+                }
+            }
+        
+        // don't overwrite glyphs still waiting to be drawn
+        if( glyphPages[p]->verts.size() > 0 ) {
+            flushGlyphBatch();
+            }
+        
+        glyphPages[p]->clear();
+        }
+    
+    glyphPages[p]->packer.pack( paddedW, paddedH, &x, &y );
+    
+    *outX = x + GLYPH_PADDING;
+    *outY = y + GLYPH_PADDING;
+    return p;
+    }
+
 
  
 void xFreeTypeLib::load(const char* font_file , int _w , int _h)  
@@ -136,7 +349,7 @@ void xFreeTypeLib::load(const char* font_file , int _w , int _h)
   
 char xFreeTypeLib::loadChar(unicode ch)  
 {  
-    if(unicodeTex[ch].mTex)  
+    if(unicodeTex[ch].mPage != -1)  
         return true;  
     // load char image(will replace old char image)
     if(FT_Load_Char(mFTFace, ch, FT_LOAD_DEFAULT))
@@ -159,23 +372,40 @@ char xFreeTypeLib::loadChar(unicode ch)
     int width = bitmap.width;  
     int height = bitmap.rows;  
 
-    unsigned char* pBuf = new unsigned char[width * height * 4];  
+    int x, y;
+    int page = packGlyph( width, height, &x, &y );
+    
+    if( page == -1 ) {
+        FT_Done_Glyph(glyph);
+        return false;
+    }
+
+    // include padding border, so any stale pixels from evicted glyphs
+    // are cleared
+    int paddedW = width + 2 * GLYPH_PADDING;
+    int paddedH = height + 2 * GLYPH_PADDING;
+    
+    unsigned char* pBuf = new unsigned char[paddedW * paddedH];  
+    memset( pBuf, 0, paddedW * paddedH );
+    
     for(int j=0; j < height; j++)  
     {  
-        for(int i=0; i < width; i++)  
-        {  
-            unsigned char _vl = bitmap.buffer[i + bitmap.width*j];  
-            pBuf[(4*i + (height - j - 1) * width * 4)  ] = 0xFF;  
-            pBuf[(4*i + (height - j - 1) * width * 4)+1] = 0xFF;  
-            pBuf[(4*i + (height - j - 1) * width * 4)+2] = 0xFF;  
-            pBuf[(4*i + (height - j - 1) * width * 4)+3] = _vl;  
-        }  
+        // flip rows, so texture row 0 is bottom of glyph
+        unsigned char *row = 
+            &( pBuf[ ( height - j - 1 + GLYPH_PADDING ) * paddedW 
+                     + GLYPH_PADDING ] );
+        memcpy( row, &( bitmap.buffer[ bitmap.pitch * j ] ), width );
     }  
 
-    unicodeTex[ch].mTex = new SingleTextureGL(pBuf, width, height, false, false);
+    glyphPages[page]->tex->replaceTextureSubData( 
+        pBuf, x - GLYPH_PADDING, y - GLYPH_PADDING, paddedW, paddedH );
+    glyphPages[page]->glyphs.push_back( ch );
+    
+    unicodeTex[ch].mPage = page;
+    unicodeTex[ch].mX = x;
+    unicodeTex[ch].mY = y;
     unicodeTex[ch].mWidth = width;
     unicodeTex[ch].mHeight = height;
-    loadedUnicode.push_back(ch);
     delete[] pBuf;  
     FT_Done_Glyph(glyph);
     return true;  
@@ -190,6 +420,38 @@ xCharTexture* getTextChar(unicode ch)
     char result = g_FreeTypeLib.loadChar(ch);  
     return result ? &unicodeTex[ch] : NULL;  
 }
+
+
+// queues a glyph quad for drawing with the current batch
+// glyph must be in atlas
+static void addGlyphQuad( xCharTexture *inCharTex, doublePair inCenter ) {
+    GlyphPage *page = glyphPages[ inCharTex->mPage ];
+    
+    page->lastUsed = glyphBatchStamp;
+
+    int w = inCharTex->mWidth;
+    int h = inCharTex->mHeight;
+    int ch_x = inCenter.x - w / 2;
+    int ch_y = inCenter.y - h / 2 + unicodeOffset; // 字体显示位置修正
+    
+    float s0 = inCharTex->mX / (float)GLYPH_PAGE_SIZE;
+    float s1 = ( inCharTex->mX + w ) / (float)GLYPH_PAGE_SIZE;
+    float t0 = inCharTex->mY / (float)GLYPH_PAGE_SIZE;
+    float t1 = ( inCharTex->mY + h ) / (float)GLYPH_PAGE_SIZE;
+    
+    float quadVerts[8] = { (float)ch_x, (float)( ch_y + h ),
+                           (float)( ch_x + w ), (float)( ch_y + h ),
+                           (float)( ch_x + w ), (float)ch_y,
+                           (float)ch_x, (float)ch_y };
+    
+    float quadTexCoords[8] = { s0, t1,
+                               s1, t1,
+                               s1, t0,
+                               s0, t0 };
+    
+    page->verts.push_back( quadVerts, 8 );
+    page->texCoords.push_back( quadTexCoords, 8 );
+}
   
 void init(int size)  
 {  
@@ -210,6 +472,10 @@ Font::Font( const char *inFileName, int inCharSpacing, int inSpaceWidth,
           mFixedWidth( inFixedWidth ), mEnableKerning( true ),
           mMinimumPositionPrecision( 0 ) {
 
+    for( int i=0; i<FONT_LAYOUT_CACHE_SIZE; i++ ) {
+        mLayoutCache[i].string = NULL;
+        }
+
     if(strcmp(inFileName, "font_pencil_erased_32_32.tga") == 0)
         isErased = true;
     
@@ -556,21 +822,19 @@ Font::~Font() {
             }
     }
 
+    clearLayoutCache();
+
     fontCount--;
     if(fontCount == 0) {
-        int numTextures = loadedUnicode.size();
-        for(int i = 0; i < numTextures; ++i) {
-            unicode u = loadedUnicode.getElementDirect(i);
-            delete unicodeTex[u].mTex;
-            unicodeTex[u].mTex = NULL;
-        }
-        loadedUnicode.deleteAll();
+        freeGlyphPages();
     }
 }
 
 
 
 void Font::copySpacing( Font *inOtherFont ) {
+    clearLayoutCache();
+
     memcpy( mCharLeftEdgeOffset, inOtherFont->mCharLeftEdgeOffset,
             256 * sizeof( int ) );
 
@@ -627,29 +891,12 @@ void Font::drawChar(unicode c, doublePair inCenter) {
     xCharTexture* pCharTex = getTextChar(c);  
     if(pCharTex == NULL)
         return;
-    float alpha = getDrawColor().a;
-    if(isErased)
-        setDrawFade(alpha * 0.1);
-    
-    pCharTex->mTex->enable();
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);  
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);  
 
-    int w = pCharTex->mWidth;
-    int h = pCharTex->mHeight;
-    int ch_x = inCenter.x - w / 2;
-    int ch_y = inCenter.y - h / 2 + unicodeOffset; // 字体显示位置修正
-    glBegin ( GL_QUADS );
-    {  
-        glTexCoord2f(0.0f, 1.0f); glVertex2f(ch_x, ch_y + h);  
-        glTexCoord2f(1.0f, 1.0f); glVertex2f(ch_x + w, ch_y + h);  
-        glTexCoord2f(1.0f, 0.0f); glVertex2f(ch_x + w, ch_y);  
-        glTexCoord2f(0.0f, 0.0f); glVertex2f(ch_x, ch_y);  
-    }  
-    glEnd();  
-
-    if(isErased)
-        setDrawFade(alpha);
+    glyphBatchStamp++;
+    glyphBatchErased = isErased;
+    
+    addGlyphQuad( pCharTex, inCenter );
+    flushGlyphBatch();
 }
 
 double Font::getCharSpacing() {
@@ -662,18 +909,51 @@ double Font::getCharSpacing() {
 double Font::getCharPos( SimpleVector<doublePair> *outPositions,
                          const char *inString, doublePair inPosition,
                          TextAlignment inAlign ) {
-    unicode unicodeString[strlen(inString)];
-    utf8ToUnicode(inString, unicodeString);
-    return getCharPos(outPositions, unicodeString, inPosition, inAlign);
+    FontLayout *layout = getLayout( inString );
+    
+    doublePair start = getStringStart( layout->width, inPosition, inAlign );
+    
+    for( int i=0; i<layout->numChars; i++ ) {
+        doublePair drawPos = { start.x + layout->charOffsets[i], start.y };
+        outPositions->push_back( drawPos );
+        }
+    
+    return start.x + layout->endOffset;
 }
 double Font::getCharPos( SimpleVector<doublePair> *outPositions,
                          const unicode *inString, doublePair inPosition,
                          TextAlignment inAlign ) {
 
-    double scale = scaleFactor * mScaleFactor;
-    
     unsigned int numChars = strlen( inString );
     
+    double stringWidth = 0;
+    
+    if( inAlign != alignLeft ) {
+        stringWidth = measureString( inString );
+        }
+
+    doublePair start = getStringStart( stringWidth, inPosition, inAlign );
+    
+    double *offsets = new double[ numChars ];
+    
+    double endOffset = layoutString( inString, numChars, offsets );
+    
+    for( unsigned int i=0; i<numChars; i++ ) {
+        doublePair drawPos = { start.x + offsets[i], start.y };
+        outPositions->push_back( drawPos );
+        }
+    
+    delete [] offsets;
+
+    return start.x + endOffset;
+    }
+
+
+
+doublePair Font::getStringStart( double inStringWidth, doublePair inPosition,
+                                 TextAlignment inAlign ) {
+    double scale = scaleFactor * mScaleFactor;
+    
     double x = inPosition.x;
     
     
@@ -689,18 +969,12 @@ double Font::getCharPos( SimpleVector<doublePair> *outPositions,
     //    y -= getFontHeight() / 2;
     //}
     
-    double stringWidth = 0;
-    
-    if( inAlign != alignLeft ) {
-        stringWidth = measureString( inString );
-        }
-    
     switch( inAlign ) {
         case alignCenter:
-            x -= stringWidth / 2;
+            x -= inStringWidth / 2;
             break;
         case alignRight:
-            x -= stringWidth;
+            x -= inStringWidth;
             break;
         default:
             // left?  do nothing
@@ -720,20 +994,31 @@ double Font::getCharPos( SimpleVector<doublePair> *outPositions,
         x *= mMinimumPositionPrecision;
         }
     
+    doublePair start = { x, y };
+    return start;
+    }
 
-    for( unsigned int i=0; i<numChars; i++ ) {
-        doublePair charPos = { x, y };
+
+
+double Font::layoutString( const unicode *inString, int inNumChars,
+                           double *outOffsets ) {
+    double scale = scaleFactor * mScaleFactor;
+    
+    double x = 0;
+    
+    for( int i=0; i<inNumChars; i++ ) {
+        doublePair charPos = { x, 0 };
         
         doublePair drawPos;
         
         double charWidth = positionCharacter( inString[i], 
                                               charPos, &drawPos );
-        outPositions->push_back( drawPos );
+        outOffsets[i] = drawPos.x;
         
         x += charWidth + mCharSpacing * scale;
         
         if( !mFixedWidth && mEnableKerning 
-            && i < numChars - 1 
+            && i < inNumChars - 1 
             && inString[i] < 128
             && inString[i+1] < 128
             && mKerningTable[ inString[i] ] != NULL ) {
@@ -751,19 +1036,97 @@ double Font::getCharPos( SimpleVector<doublePair> *outPositions,
     }
 
 
+
+FontLayout *Font::getLayout( const char *inString ) {
+    // FNV-1a
+    unsigned int hash = 2166136261U;
+    
+    int numBytes = 0;
+    
+    for( const unsigned char *p = (const unsigned char *)inString; 
+         *p != '\0'; p++ ) {
+        hash ^= *p;
+        hash *= 16777619U;
+        numBytes++;
+        }
+    
+    FontLayout *layout = &( mLayoutCache[ hash % FONT_LAYOUT_CACHE_SIZE ] );
+    
+    if( layout->string != NULL ) {
+        if( layout->hash == hash && strcmp( layout->string, inString ) == 0 ) {
+            return layout;
+            }
+        
+        // evict
+        delete [] layout->string;
+        delete [] layout->chars;
+        delete [] layout->charOffsets;
+        layout->string = NULL;
+        }
+    
+    // never more code points than bytes
+    unicode *chars = new unicode[ numBytes + 1 ];
+    utf8ToUnicode( inString, chars );
+    
+    layout->string = stringDuplicate( inString );
+    layout->hash = hash;
+    layout->numChars = strlen( chars );
+    layout->chars = chars;
+    layout->charOffsets = new double[ layout->numChars ];
+    layout->endOffset = layoutString( chars, layout->numChars, 
+                                      layout->charOffsets );
+    layout->width = measureString( chars );
+    
+    return layout;
+    }
+
+
+
+void Font::clearLayoutCache() {
+    for( int i=0; i<FONT_LAYOUT_CACHE_SIZE; i++ ) {
+        FontLayout *layout = &( mLayoutCache[i] );
+        
+        if( layout->string != NULL ) {
+            delete [] layout->string;
+            delete [] layout->chars;
+            delete [] layout->charOffsets;
+            layout->string = NULL;
+            }
+        }
+    }
+
+
+
 double Font::drawString( const char *inString, doublePair inPosition,
                          TextAlignment inAlign ) {
-    unicode unicodeString[strlen(inString)];
-    utf8ToUnicode(inString, unicodeString);
-    SimpleVector<doublePair> pos( strlen( unicodeString ) );
+    FontLayout *layout = getLayout( inString );
 
-    double returnVal = getCharPos( &pos, unicodeString, inPosition, inAlign );
+    doublePair start = getStringStart( layout->width, inPosition, inAlign );
     
-    for( int i=0; i<pos.size(); i++ ) {
-        drawChar(unicodeString[i], pos.getElementDirect(i));
-    }
+    glyphBatchStamp++;
+    glyphBatchErased = isErased;
     
-    return returnVal;
+    // ASCII sprites drawn right away, other glyphs batched by atlas page
+    for( int i=0; i<layout->numChars; i++ ) {
+        unicode c = layout->chars[i];
+        
+        doublePair pos = { start.x + layout->charOffsets[i], start.y };
+        
+        if( c < 128 ) {
+            drawChar( c, pos );
+            }
+        else {
+            xCharTexture* pCharTex = getTextChar( c );
+            
+            if( pCharTex != NULL ) {
+                addGlyphQuad( pCharTex, pos );
+                }
+            }
+        }
+    
+    flushGlyphBatch();
+    
+    return start.x + layout->endOffset;
 }
 
 
@@ -815,7 +1178,11 @@ void Font::drawCharacterSprite( unicode inC, doublePair inPosition ) {
 }
 
 double Font::measureString( const char *inString, int inCharLimit ) {
-    unicode unicodeString[strlen(inString)];
+    if( inCharLimit == -1 ) {
+        return getLayout( inString )->width;
+        }
+    
+    unicode unicodeString[strlen(inString) + 1];
     utf8ToUnicode(inString, unicodeString);
     return measureString(unicodeString, inCharLimit);
 }
@@ -883,6 +1250,9 @@ double Font::getFontHeight() {
 
 
 void Font::enableKerning( char inKerningOn ) {
+    if( inKerningOn != mEnableKerning ) {
+        clearLayoutCache();
+        }
     mEnableKerning = inKerningOn;
     }
 
@@ -895,6 +1265,9 @@ void Font::setMinimumPositionPrecision( double inMinimum ) {
 
 // FOVMOD NOTE:  Change 1/1 - Take these lines during the merge process
 void Font::setScaleFactor( double newScaleFactor ) {
+    if( newScaleFactor != mScaleFactor ) {
+        clearLayoutCache();
+        }
     mScaleFactor = newScaleFactor;
 }
 
@@ -29,15 +29,22 @@ typedef struct KerningTable {
 typedef unsigned short unicode;
 
 
+// where a FreeType glyph sits in the glyph atlas
 struct xCharTexture  
 {  
-    SingleTextureGL  *mTex;  
+    // atlas page, or -1 if glyph not currently in atlas
+    int     mPage;
+    // corner of glyph in page, in pixels
+    int     mX;
+    int     mY;
     int     mWidth;  
     int     mHeight;  
 public:  
     xCharTexture()  
     {  
-        mTex  = NULL;  
+        mPage = -1;
+        mX = 0;
+        mY = 0;
         mWidth  = 0;  
         mHeight = 0;  
     }  
@@ -52,6 +59,33 @@ public:
     char loadChar(unicode ch);  
 };  
 
+
+
+// cached layout of a UTF-8 string, independent of where it is drawn
+typedef struct FontLayout {
+        // NULL for empty cache entry
+        char *string;
+        unsigned int hash;
+        
+        int numChars;
+        unicode *chars;
+        
+        // x offset of each character's draw position from string start
+        double *charOffsets;
+
+        // x offset of string end from string start
+        double endOffset;
+
+        // same as measureString
+        double width;
+    } FontLayout;
+
+
+// number of strings each font remembers
+// direct-mapped by string hash
+#define FONT_LAYOUT_CACHE_SIZE 256
+
+
 class Font {
         
     public:
@@ -134,6 +168,27 @@ class Font {
                                   doublePair *outActualPos );
 
         
+        // finds where first character of a string is positioned
+        doublePair getStringStart( double inStringWidth, 
+                                   doublePair inPosition,
+                                   TextAlignment inAlign );
+        
+        // fills outOffsets with x offset of each character from string start
+        // returns x offset of string end
+        double layoutString( const unicode *inString, int inNumChars,
+                             double *outOffsets );
+        
+
+        // gets cached layout for a string, computing it if needed
+        // result is only valid until next call
+        FontLayout *getLayout( const char *inString );
+        
+        // must be called whenever spacing, kerning, or scale changes
+        void clearLayoutCache();
+        
+        FontLayout mLayoutCache[ FONT_LAYOUT_CACHE_SIZE ];
+
+        
         double mScaleFactor;
         
         
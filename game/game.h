@@ -653,17 +653,30 @@ void closeSocket( int inHandle );
 
 // returns int handle for this file read operation
 // inFilePath is platform-dependent path to file from current directory
-int startAsyncFileRead( const char *inFilePath );
+// reads with higher inPriority start first
+// inMemoryMap maps the file instead of copying it, where supported
+//   (results must then be freed with freeAsyncFileMappedData)
+// several reads can be in progress at once
+int startAsyncFileRead( const char *inFilePath, int inPriority = 0,
+                        char inMemoryMap = false );
 
 
 char checkAsyncFileReadDone( int inHandle );
 
 
 // this clears the handle
-// return array destroyed by caller
+// return array destroyed by caller (or with freeAsyncFileMappedData
+// for memory-mapped reads)
 unsigned char *getAsyncFileData( int inHandle, int *outDataLength );
 
 
+// stops a read (or discards its result) and clears the handle
+void cancelAsyncFileRead( int inHandle );
+
+
+void freeAsyncFileMappedData( unsigned char *inData, int inDataLength );
+
+
 
 
 // relaunches the game from scratch as a new process, and triggers exit
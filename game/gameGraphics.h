@@ -150,6 +150,18 @@ typedef void * SpriteHandle;
 // toggles mipmap generation for subsequent sprite loading/filling calls
 void toggleMipMapGeneration( char inGenerateMipMaps );
 
+
+// toggles atlas packing for subsequent sprite loading/filling calls
+// (off by default)
+// if on, RGBA sprites up to 256x256 are packed together into large shared
+// textures, so that a sprite batch can draw many different sprites
+// without changing textures.
+// Sprites are not packed while mipmap generation is on.
+// Calling setSpriteWrapping on a packed sprite moves it back to its own
+// texture.  Packed sprites should not be drawn with texture coordinates
+// outside 0..1 unless wrapping has been set.
+void toggleSpriteAtlas( char inAtlasOn );
+
 // if off, entire sprite rectangle is drawn
 // if on, sprite is cropped to remove fully-transparent rows and columns
 // at the left, right, top, and bottom
@@ -243,6 +255,41 @@ void startCountingSpritesDrawn();
 // returns the number of sprites drawn since we started counting
 double endCountingSpritesDrawn();
 
+// returns the number of draw calls made for sprites since we started counting
+// (a run of batched sprites takes one draw call)
+int endCountingSpriteDrawCalls();
+
+// returns the number of texture binds, texture filter changes, and blend 
+// mode changes made since we started counting
+int endCountingSpriteStateChanges();
+
+
+
+// Between these calls, drawSprite calls are collected and drawn together,
+// with each run of sprites that share a texture, blend mode, and filters
+// taking a single draw call.
+//
+// Draw color, fades, and blend modes can still be changed between sprites.
+//
+// Other drawing functions (drawQuads, drawTriangles, scissor, stencil, 
+// etc.) draw any collected sprites first, so drawing order is kept.
+//
+// If inSortByTexture is true, sprites are reordered by blend mode and 
+// texture before drawing, which makes for fewer, longer runs.  Only use
+// this when the sprites in the batch don't overlap, or when their drawing
+// order doesn't matter.
+//
+// Batching is ignored on GLES.
+void startSpriteBatch( char inSortByTexture = false );
+
+void endSpriteBatch();
+
+
+// draws any collected sprites right away, leaving batch open, and resets
+// sprite GL state
+// Must be called before making GL calls directly while a batch is open.
+void flushSpriteBatch();
+
 
 
 // draw with current draw color
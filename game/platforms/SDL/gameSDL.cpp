@@ -46,6 +46,8 @@ int main( int inArgCount, char **inArgs ) {
 #include "minorGems/system/Time.h"
 #include "minorGems/system/Thread.h"
 
+#include "minorGems/util/development/zoneProfiler/ZoneProfiler.h"
+
 #include "minorGems/io/file/File.h"
 
 #include "minorGems/network/HostAddress.h"
@@ -72,6 +74,7 @@ int main( int inArgCount, char **inArgs ) {
 
 #include "minorGems/sound/formats/aiff.h"
 #include "minorGems/sound/audioNoClip.h"
+#include "minorGems/sound/soundMixer.h"
 
 
 
@@ -116,128 +119,18 @@ void freeWriteFailedPanel() {
 #endif
 
 
-static int nextAsyncFileHandle = 0;
-
-typedef struct AsyncFileRecord {
-        int handle;
-        char *filePath;
-        
-        int dataLength;
-        unsigned char *data;
-        
-        char doneReading;
-        
-    } AsyncFileRecord;
-
-
-
-#include "minorGems/system/StopSignalThread.h"
-#include "minorGems/system/MutexLock.h"
-#include "minorGems/system/BinarySemaphore.h"
+#include "minorGems/io/file/AsyncFileReader.h"
 
-static MutexLock asyncLock;
-static BinarySemaphore newFileToReadSem;
 
-static BinarySemaphore newFileDoneReadingSem;
-
-static SimpleVector<AsyncFileRecord> asyncFiles;
-
-
-class AsyncFileThread : public StopSignalThread {
-    
-    public:
-        
-        AsyncFileThread() {
-            start();
-            }
-
-        ~AsyncFileThread() {
-            stop();
-            newFileToReadSem.signal();
-            join();
-
-            for( int i=0; i<asyncFiles.size(); i++ ) {
-        
-                AsyncFileRecord *r = asyncFiles.getElement( i );
-                
-                if( r->filePath != NULL ) {
-                    delete [] r->filePath;
-                    }
-                
-                if( r->data != NULL ) {
-                    delete [] r->data;
-                    }
-                }
-            asyncFiles.deleteAll();
-            }
-        
+// handles come from here in the same sequence during recording and playback
+static AsyncFileReader asyncFileReader;
 
-        virtual void run() {
-            while( ! isStopped() ) {
-                
-                int handleToRead = -1;
-                char *pathToRead = NULL;
-                
-                asyncLock.lock();
-                
-                for( int i=0; i<asyncFiles.size(); i++ ) {
-                    AsyncFileRecord *r = asyncFiles.getElement( i );
-                    
-                    if( ! r->doneReading ) {
-                        // can't trust pointer to record in vector
-                        // outside of lock, because vector storage may
-                        // change
-                        handleToRead = r->handle;
-                        pathToRead = r->filePath;
-                        break;
-                        }
-                    }
 
-                asyncLock.unlock();
+#include "minorGems/util/SettingsFlushThread.h"
 
-                if( handleToRead != -1 ) {
-                    // read file data
-
-                    File f( NULL, pathToRead );
-                    
-                    int dataLength;
-                    unsigned char *data = f.readFileContents( &dataLength );
-
-                    // re-lock vector, search for handle, and add it
-                    // cannot count on vector order or pointers to records
-                    // when we don't have it locked
-
-                    asyncLock.lock();
-                    
-                    for( int i=0; i<asyncFiles.size(); i++ ) {
-                        AsyncFileRecord *r = asyncFiles.getElement( i );
-                    
-                        if( r->handle == handleToRead ) {
-                            r->dataLength = dataLength;
-                            r->data = data;
-                            r->doneReading = true;
-                            break;
-                            }
-                        }
-
-                    asyncLock.unlock();
-
-                    // let anyone waiting for a new file to finish
-                    // reading (only matters in the case of playback, where
-                    // the file-done must happen on a specific frame)
-                    newFileDoneReadingSem.signal();
-                    }
-                else {
-                    // wait on binary semaphore until something else added
-                    // for us to read
-                    newFileToReadSem.wait();
-                    }
-                }
-            };
-    };
-
-
-static AsyncFileThread fileReadThread;
+// writes changed settings in the background, so setSetting calls
+// from the frame loop don't wait on the disk
+static SettingsFlushThread *settingsFlushThread = NULL;
 
 
 
@@ -362,7 +255,9 @@ char mouseWorldCoordinates = true;
     static const char *screenShotExtension = "jpg";
 #elif defined(USE_PNG)
     #include "minorGems/graphics/converters/PNGImageConverter.h"
-    static PNGImageConverter screenShotConverter;
+    // threads compress bands of rows in parallel, which keeps
+    // startOutputAllFrames dumps from stalling the game
+    static PNGImageConverter screenShotConverter( 5, 4 );
     static const char *screenShotExtension = "png";
 #else
     static TGAImageConverter screenShotConverter;
@@ -521,16 +416,10 @@ void getScreenDimensions( int *outWidth, int *outHeight ) {
 typedef struct SoundSprite {
         int handle;
         int numSamples;
-        int samplesPlayed;
 
         // true for sound sprites that are marked to never use
         // pitch and volume variance
         char noVariance;
-
-        // floating point position of next interpolated sameple to play
-        // (for variable rate playback)
-        double samplesPlayedF;
-        
         
         Sint16 *samples;
     } SoundSprite;
@@ -543,21 +432,27 @@ typedef struct SoundSprite {
 //  without accessing this vector).
 static SimpleVector<SoundSprite*> soundSprites;
 
-// audio thread is locked every time we touch this vector
-// So, we want to avoid mallocs here
-// Can we imagine more than 100 sound sprites ever playing at the same time?
-static SimpleVector<SoundSprite> playingSoundSprites( 100 );
+// audio thread is locked every time we touch this
+// voice ids are sound sprite handles
+// Allocated once up front, so no mallocs while audio thread is locked.
+// Can we imagine more than 256 sound sprites ever playing at the same time?
+static SoundMixer playingSoundSprites = initSoundMixer( 256 );
+
+// voices are mixed in float, then handed to audioNoClip in double
+static float *soundSpriteVoiceBufferL = NULL;
+static float *soundSpriteVoiceBufferR = NULL;
 
 static double *soundSpriteMixingBufferL = NULL;
 static double *soundSpriteMixingBufferR = NULL;
 
 
-// variable rate per sprite
-// these are also touched with audio thread locked, so avoid mallocs
-// we won't see more than 100 of these simultaneously either
-static SimpleVector<double> playingSoundSpriteRates( 100 );
-static SimpleVector<double> playingSoundSpriteVolumesR( 100 );
-static SimpleVector<double> playingSoundSpriteVolumesL( 100 );
+static void allocateSoundSpriteMixingBuffers( int inNumSamples ) {
+    soundSpriteVoiceBufferL = new float[ inNumSamples ];
+    soundSpriteVoiceBufferR = new float[ inNumSamples ];
+    
+    soundSpriteMixingBufferL = new double[ inNumSamples ];
+    soundSpriteMixingBufferR = new double[ inNumSamples ];
+    }
 
 
 static SDL_Cursor *ourCursor = NULL;
@@ -592,10 +487,7 @@ void cleanUpAtExit() {
         delete s;
         }
     soundSprites.deleteAll();
-    playingSoundSprites.deleteAll();
-    playingSoundSpriteRates.deleteAll();
-    playingSoundSpriteVolumesL.deleteAll();
-    playingSoundSpriteVolumesR.deleteAll();
+    freeSoundMixer( &playingSoundSprites );
     
     if( bufferSizeHinted ) {
         freeHintedBuffers();
@@ -666,6 +558,21 @@ void cleanUpAtExit() {
     if( soundSpriteMixingBufferR != NULL ) {
         delete [] soundSpriteMixingBufferR;
         }
+
+    if( soundSpriteVoiceBufferL != NULL ) {
+        delete [] soundSpriteVoiceBufferL;
+        }
+    
+    if( soundSpriteVoiceBufferR != NULL ) {
+        delete [] soundSpriteVoiceBufferR;
+        }
+    
+    if( settingsFlushThread != NULL ) {
+        AppLog::info( "exiting: writing pending settings\n" );
+        
+        delete settingsFlushThread;
+        settingsFlushThread = NULL;
+        }
     
     
     AppLog::info( "exiting: Done.\n" );
@@ -793,9 +700,6 @@ SoundSpriteHandle setSoundSprite( int16_t *inSamples, int inNumSamples ) {
     s->numSamples = inNumSamples;
     
     s->noVariance = false;
-
-    s->samplesPlayed = 0;
-    s->samplesPlayedF = 0;
     
     s->samples = new Sint16[ s->numSamples ];
     
@@ -900,7 +804,7 @@ static void playSoundSpriteInternal(
         }
 
     if( maxSimultaneousSoundSprites != -1 &&
-        playingSoundSpriteVolumesR.size() >= maxSimultaneousSoundSprites ) {
+        playingSoundSprites.numVoices >= maxSimultaneousSoundSprites ) {
         // cap would be exceeded
         // don't play this sound sprite at all
         return;
@@ -919,9 +823,8 @@ static void playSoundSpriteInternal(
         // Don't ever play more than one instance of a longer sound
         // simultaneously.
         
-        for( int i=0; i<playingSoundSprites.size(); i++ ) {
-            if( playingSoundSprites.getElement(i)->handle ==
-                s->handle ) {
+        for( int i=0; i<playingSoundSprites.numVoices; i++ ) {
+            if( playingSoundSprites.ids[i] == s->handle ) {
                 // already playing this sound sprite
                 return;
             }
@@ -952,31 +855,23 @@ static void playSoundSpriteInternal(
     double leftVolume = volume * cos( p );
 
 
-    s->samplesPlayed = 0;
-    s->samplesPlayedF = 0;
-
+    double rate = 1.0;
 
-
-    
-    playingSoundSprites.push_back( *s );
-
-    if( s->noVariance ) {
-        playingSoundSpriteRates.push_back( 1.0 );
-        }
-    else {
+    if( ! s->noVariance ) {
         
         if( inForceRate != -1 ) {
-            playingSoundSpriteRates.push_back( inForceRate );
+            rate = inForceRate;
             }
         else { 
-            playingSoundSpriteRates.push_back(  pickRandomRate() );
+            rate = pickRandomRate();
             }
         }
     
     
-    
-    playingSoundSpriteVolumesR.push_back( rightVolume );
-    playingSoundSpriteVolumesL.push_back( leftVolume );
+    // if mixer full, sound sprite doesn't play
+    addSoundMixerVoice( &playingSoundSprites, s->handle,
+                        s->samples, s->numSamples, rate,
+                        leftVolume, rightVolume );
     }
 
 
@@ -1019,14 +914,10 @@ void freeSoundSprite( SoundSpriteHandle inHandle ) {
     SoundSprite *s = (SoundSprite*)inHandle;
 
     // find it in vector to remove it
-    for( int i=playingSoundSprites.size()-1; i>=0; i-- ) {
-        SoundSprite *s2 = playingSoundSprites.getElement( i );
-        if( s2->handle == s->handle ) {
+    for( int i=playingSoundSprites.numVoices-1; i>=0; i-- ) {
+        if( playingSoundSprites.ids[i] == s->handle ) {
             // stop it abruptly
-            playingSoundSprites.deleteElement( i );
-            playingSoundSpriteRates.deleteElement( i );
-            playingSoundSpriteVolumesL.deleteElement( i );
-            playingSoundSpriteVolumesR.deleteElement( i );
+            removeSoundMixerVoice( &playingSoundSprites, i );
             }
         }
     
@@ -1047,79 +938,31 @@ void freeSoundSprite( SoundSpriteHandle inHandle ) {
 
 
 void audioCallback( void *inUserData, Uint8 *inStream, int inLengthToFill ) {
+    if( ! recordAudio ) {
+        // else called from main thread
+        PROFILE_THREAD_NAME( "audio" );
+        }
+    PROFILE_ZONE( "audioCallback" );
+
     getSoundSamples( inStream, inLengthToFill );
     
     int numSamples = inLengthToFill / 4;
 
     
-    if( playingSoundSprites.size() > 0 ) {
+    if( playingSoundSprites.numVoices > 0 ) {
         
         for( int i=0; i<numSamples; i++ ) {
-            soundSpriteMixingBufferL[ i ] = 0.0;
-            soundSpriteMixingBufferR[ i ] = 0.0;
+            soundSpriteVoiceBufferL[ i ] = 0.0f;
+            soundSpriteVoiceBufferR[ i ] = 0.0f;
             }
 
-        for( int i=0; i<playingSoundSprites.size(); i++ ) {
-            SoundSprite *s = playingSoundSprites.getElement( i );
+        mixSoundMixer( &playingSoundSprites, 
+                       soundSpriteVoiceBufferL, soundSpriteVoiceBufferR,
+                       numSamples );
 
-            double rate = playingSoundSpriteRates.getElementDirect( i );
-            double volumeL = playingSoundSpriteVolumesL.getElementDirect( i );
-            double volumeR = playingSoundSpriteVolumesR.getElementDirect( i );
-            
-            int filled = 0;
-            
-            //int filledBytes = 0;
-
-            if( rate == 1 ) {
-                
-                int samplesPlayed = s->samplesPlayed;
-                int spriteNumSamples = s->numSamples;
-                
-                while( filled < numSamples &&
-                       samplesPlayed < spriteNumSamples  ) {
-                    
-                    Sint16 sample = s->samples[ samplesPlayed ];
-                    
-                    soundSpriteMixingBufferL[ filled ] 
-                        += volumeL * sample;
-                    
-                    soundSpriteMixingBufferR[ filled ]
-                        += volumeR * sample;
-
-                    filled ++;
-                    samplesPlayed ++;
-                    }
-                s->samplesPlayed = samplesPlayed;
-                }
-            else {
-                double samplesPlayedF = s->samplesPlayedF;
-                int spriteNumSamples = s->numSamples;
-                
-                while( filled < numSamples &&
-                       samplesPlayedF < spriteNumSamples - 1  ) {
-                    
-                    int aIndex = (int)floor( samplesPlayedF );
-                    int bIndex = (int)ceil( samplesPlayedF );
-                    
-                    Sint16 sampleA = s->samples[ aIndex ];
-                    Sint16 sampleB = s->samples[ bIndex ];
-                    
-                    double bWeight = samplesPlayedF - aIndex;
-                    double aWeight = 1 - bWeight;
-
-                    double sampleBlend = sampleA * aWeight + sampleB * bWeight;
-
-                    soundSpriteMixingBufferL[ filled ] 
-                        += volumeL * sampleBlend;
-                    
-                    soundSpriteMixingBufferR[ filled ]
-                        += volumeR * sampleBlend;
-
-                    filled ++;
-                    samplesPlayedF += rate;
-                    }
-                s->samplesPlayedF = samplesPlayedF;
-                }
+        for( int i=0; i<numSamples; i++ ) {
+            soundSpriteMixingBufferL[ i ] = soundSpriteVoiceBufferL[ i ];
+            soundSpriteMixingBufferR[ i ] = soundSpriteVoiceBufferR[ i ];
             }
 
 
@@ -1195,20 +1038,13 @@ void audioCallback( void *inUserData, Uint8 *inStream, int inLengthToFill ) {
                 (Uint8)( ( rSample >> 8 ) & 0xFF );
             }
 
-        // walk backward, removing any that are done
+        // remove any that are done
         // OR remove all if sound sprites are completely faded out
-        for( int i=playingSoundSprites.size()-1; i>=0; i-- ) {
-            SoundSprite *s = playingSoundSprites.getElement( i );
-            
-            if( soundSpriteGlobalLoudness == 0 ||
-                s->samplesPlayed >= s->numSamples ||
-                s->samplesPlayedF >= s->numSamples - 1 ) {
-                
-                playingSoundSprites.deleteElement( i );
-                playingSoundSpriteRates.deleteElement( i );
-                playingSoundSpriteVolumesL.deleteElement( i );
-                playingSoundSpriteVolumesR.deleteElement( i );
-                }
+        if( soundSpriteGlobalLoudness == 0 ) {
+            playingSoundSprites.numVoices = 0;
+            }
+        else {
+            removeDoneSoundMixerVoices( &playingSoundSprites );
             }
         }
     
@@ -2304,6 +2140,9 @@ int mainFunction( int inNumArgs, char **inArgs ) {
     atexit( cleanUpAtExit );
 
 
+    settingsFlushThread = new SettingsFlushThread();
+
+
 
 
     screen->switchTo2DMode();
@@ -2436,10 +2275,7 @@ int mainFunction( int inNumArgs, char **inArgs ) {
                 if( !recordAudioFlag ) {
                     soundSampleRate = actualFormat.freq;
                     
-                    soundSpriteMixingBufferL = 
-                        new double[ actualFormat.samples ];
-                    soundSpriteMixingBufferR = 
-                        new double[ actualFormat.samples ];
+                    allocateSoundSpriteMixingBuffers( actualFormat.samples );
                     }
                 
                 
@@ -2630,6 +2466,9 @@ static float visibleHeight = -1;
 
 
 static void redoDrawMatrix() {
+    // sprites batched so far were positioned for old matrix
+    flushSpriteBatch();
+
     // viewport square centered on screen (even if screen is rectangle)
     float hRadius = viewSize / 2;
     
@@ -2917,6 +2756,8 @@ void saveFrameRateSettings() {
 
 
 void GameSceneHandler::drawScene() {
+    PROFILE_ZONE( "drawScene" );
+
     numPixelsDrawn = 0;
     /*
     glClearColor( mBackgroundColor->r,
@@ -3240,6 +3081,9 @@ void GameSceneHandler::drawScene() {
         
         drawFrame( update );
         
+        // in case drawFrame left a batch open
+        endSpriteBatch();
+
         if( cursorMode > 0 ) {
             // draw emulated cursor
 
@@ -3328,8 +3172,7 @@ void GameSceneHandler::drawScene() {
             if( !bufferSizeHinted ) {
                 hintBufferSize( numSampleBytes );
 
-                soundSpriteMixingBufferL = new double[ samplesPerFrame ];
-                soundSpriteMixingBufferR = new double[ samplesPerFrame ];
+                allocateSoundSpriteMixingBuffers( samplesPerFrame );
 
                 bufferSizeHinted = true;
                 }
@@ -3936,6 +3779,14 @@ void GameSceneHandler::specialKeyPressed(
             break;
         }
     
+#ifdef ZONE_PROFILER
+    if( inKey == MG_KEY_F12 ) {
+        // about 10 seconds at 60 fps, for chrome://tracing
+        if( ZoneProfiler::writeChromeTrace( "zoneTrace.json", 600 ) ) {
+            AppLog::info( "Wrote last 600 frames to zoneTrace.json\n" );
+            }
+        }
+#endif
     
     specialKeyDown( inKey );
 	}
@@ -4402,6 +4253,8 @@ static Image *getScreenRegionInternal(
     int inStartX, int inStartY, int inWidth, int inHeight,
     char inForceManual = false ) {    
         
+    flushSpriteBatch();
+
     int numBytes = inWidth * inHeight * 3;
     
     unsigned char *rgbBytes = 
@@ -4510,6 +4363,8 @@ static int outputFrameCount = 0;
 
 
 void takeScreenShot() {
+    PROFILE_ZONE( "takeScreenShot" );
+
      
     
     File shotDir( NULL, "screenShots" );
@@ -4706,6 +4561,7 @@ static WebRequest *getRequestByHandle( int inHandle ) {
 
 
 int stepWebRequest( int inHandle ) {
+    PROFILE_ZONE( "stepWebRequest" );
     
     if( screen->isPlayingBack() ) {
         // don't step request, because we're only simulating the response
@@ -4961,6 +4817,8 @@ static Socket *getSocketByHandle( int inHandle ) {
 // non-blocking send
 // returns number sent (maybe 0) on success, -1 on error
 int sendToSocket( int inHandle, unsigned char *inData, int inDataLength ) {
+    PROFILE_ZONE( "sendToSocket" );
+
     if( screen->isPlayingBack() ) {
         // play back result of this send
 
@@ -5024,6 +4882,7 @@ int sendToSocket( int inHandle, unsigned char *inData, int inDataLength ) {
 // returns number of bytes read (maybe 0), -1 on error 
 int readFromSocket( int inHandle, 
                     unsigned char *inDataBuffer, int inBytesToRead ) {
+    PROFILE_ZONE( "readFromSocket" );
     
     if( screen->isPlayingBack() ) {
         // play back result of this read
@@ -5131,46 +4990,17 @@ void closeSocket( int inHandle ) {
 
 
 
-int startAsyncFileRead( const char *inFilePath ) {
-    
-    int handle = nextAsyncFileHandle;
-    nextAsyncFileHandle ++;
+int startAsyncFileRead( const char *inFilePath, int inPriority,
+                        char inMemoryMap ) {
     
-    AsyncFileRecord r = {
-        handle,
-        stringDuplicate( inFilePath ),
-        -1,
-        NULL,
-        false };
-
-    asyncLock.lock();
-    asyncFiles.push_back( r );
-    asyncLock.unlock();
-    
-    newFileToReadSem.signal();
-    
-    return handle;
+    return asyncFileReader.startRead( inFilePath, inPriority, inMemoryMap );
     }
 
 
 
 char checkAsyncFileReadDone( int inHandle ) {
 
-    char ready = false;
-
-    asyncLock.lock();
-
-    for( int i=0; i<asyncFiles.size(); i++ ) {
-        AsyncFileRecord *r = asyncFiles.getElement( i );
-                    
-        if( r->handle == inHandle &&
-            r->doneReading ) {
-            
-            ready = true;
-            break;
-            }
-        }
-    asyncLock.unlock();
+    char ready = asyncFileReader.isDone( inHandle );
 
 
     if( screen->isPlayingBack() ) {
@@ -5187,23 +5017,7 @@ char checkAsyncFileReadDone( int inHandle ) {
             // so behavior matches recording behavior
             
             // wait for read to finish, synchronously
-            while( !ready ) {                
-                newFileDoneReadingSem.wait();
-
-                asyncLock.lock();
-                
-                for( int i=0; i<asyncFiles.size(); i++ ) {
-                    AsyncFileRecord *r = asyncFiles.getElement( i );
-                    
-                    if( r->handle == inHandle &&
-                        r->doneReading ) {
-                        
-                        ready = true;
-                        break;
-                        }
-                    }
-                asyncLock.unlock();
-                }
+            asyncFileReader.waitForDone( inHandle );
             
             return true;
             }
@@ -5221,30 +5035,19 @@ char checkAsyncFileReadDone( int inHandle ) {
 
 
 unsigned char *getAsyncFileData( int inHandle, int *outDataLength ) {
+    return asyncFileReader.getData( inHandle, outDataLength );
+    }
 
-    unsigned char *data = NULL;
-    
-    asyncLock.lock();
 
-    for( int i=0; i<asyncFiles.size(); i++ ) {
-        AsyncFileRecord *r = asyncFiles.getElement( i );
-                    
-        if( r->handle == inHandle ) {
-            
-            data = r->data;
-            *outDataLength = r->dataLength;
-            
-            if( r->filePath != NULL ) {
-                delete [] r->filePath;
-                }
 
-            asyncFiles.deleteElement( i );
-            break;
-            }
-        }
-    asyncLock.unlock();
+void cancelAsyncFileRead( int inHandle ) {
+    asyncFileReader.cancelRead( inHandle );
+    }
+
+
 
-    return data;
+void freeAsyncFileMappedData( unsigned char *inData, int inDataLength ) {
+    AsyncFileReader::freeMappedData( inData, inDataLength );
     }
 
 
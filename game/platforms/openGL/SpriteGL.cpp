@@ -3,16 +3,27 @@
 
 #include "minorGems/math/geometry/Angle3D.h"
 
+#include "minorGems/graphics/RGBAImage.h"
+
 #include "minorGems/util/log/AppLog.h"
 
 
 
 char SpriteGL::sStateSet = false;
+
+SingleTextureGL *SpriteGL::sLastTexture = NULL;
+
+int SpriteGL::sDrawCalls = 0;
+int SpriteGL::sStateChanges = 0;
         
 
 
 char SpriteGL::sGenerateMipMaps = false;
 
+char SpriteGL::sUseAtlas = false;
+
+SimpleVector<SpriteAtlasPage*> SpriteGL::sAtlasPages;
+
 char SpriteGL::sCountingPixels = false;
 double SpriteGL::sPixelsDrawn = 0;
 
@@ -198,6 +209,12 @@ void SpriteGL::initTexture( Image *inImage,
     mLastSetMinFilter = -1;
     mLastSetMagFilter = -1;
     
+    mAtlasPage = NULL;
+    mTexOffsetX = 0;
+    mTexOffsetY = 0;
+    mTexScaleX = 1;
+    mTexScaleY = 1;
+    
     mColoredRadiusLeftX = 0.5;
     mColoredRadiusRightX = 0.5;
     mColoredRadiusTopY = 0.5;
@@ -251,10 +268,23 @@ void SpriteGL::initTexture( Image *inImage,
         }
     
 
-    mTexture = new SingleTextureGL( spriteImage,
-                                    // no wrap
-                                    false,
-                                    sGenerateMipMaps );
+    char packed = false;
+    
+    if( fitsInAtlas( spriteImage->getWidth(), spriteImage->getHeight() ) ) {
+        unsigned char *rgba = RGBAImage::getRGBABytes( spriteImage );
+        
+        packed = packIntoAtlas( rgba, 
+                                spriteImage->getWidth(), 
+                                spriteImage->getHeight() );
+        delete [] rgba;
+        }
+    
+    if( ! packed ) {
+        mTexture = new SingleTextureGL( spriteImage,
+                                        // no wrap
+                                        false,
+                                        sGenerateMipMaps );
+        }
 
 
     mWidth = spriteImage->getWidth();
@@ -285,6 +315,12 @@ SpriteGL::SpriteGL( unsigned char *inRGBA,
     mLastSetMinFilter = -1;
     mLastSetMagFilter = -1;
     
+    mAtlasPage = NULL;
+    mTexOffsetX = 0;
+    mTexOffsetY = 0;
+    mTexScaleX = 1;
+    mTexScaleY = 1;
+    
     mColoredRadiusLeftX = 0.5;
     mColoredRadiusRightX = 0.5;
     mColoredRadiusTopY = 0.5;
@@ -297,10 +333,12 @@ SpriteGL::SpriteGL( unsigned char *inRGBA,
         findColoredRadii( inRGBA, inWidth, inHeight );
         }
     
-    mTexture = new SingleTextureGL( inRGBA, inWidth, inHeight,
-                                    // no wrap
-                                    false,
-                                    sGenerateMipMaps );    
+    if( ! packIntoAtlas( inRGBA, inWidth, inHeight ) ) {
+        mTexture = new SingleTextureGL( inRGBA, inWidth, inHeight,
+                                        // no wrap
+                                        false,
+                                        sGenerateMipMaps );
+        }
 
     mWidth = inWidth;
     mHeight = inHeight;
@@ -328,6 +366,12 @@ SpriteGL::SpriteGL( char inAlphaOnly,
     mLastSetMinFilter = -1;
     mLastSetMagFilter = -1;
     
+    mAtlasPage = NULL;
+    mTexOffsetX = 0;
+    mTexOffsetY = 0;
+    mTexScaleX = 1;
+    mTexScaleY = 1;
+    
     mColoredRadiusLeftX = 0.5;
     mColoredRadiusRightX = 0.5;
     mColoredRadiusTopY = 0.5;
@@ -364,7 +408,12 @@ SpriteGL::SpriteGL( char inAlphaOnly,
 
 
 SpriteGL::~SpriteGL() {
-    delete mTexture;
+    if( mAtlasPage != NULL ) {
+        releaseAtlasPage();
+        }
+    else {
+        delete mTexture;
+        }
     }
 
 
@@ -372,10 +421,238 @@ SpriteGL::~SpriteGL() {
 // FOVMOD NOTE:  Change 1/4 - Take these lines during the merge process
 void SpriteGL::setWrapping( char inHorizontal,
                             char inVertical ) {
+    
+    if( mAtlasPage != NULL && ( inHorizontal || inVertical ) ) {
+        // repeats would show neighbors on atlas page
+        moveOutOfAtlas();
+        }
+    
     mTexture->setWrapping( inHorizontal, inVertical );
     }
 
 
+
+// atlas pages are this size, or the largest texture size GL supports, 
+// if smaller
+#define SPRITE_ATLAS_PAGE_SIZE 1024
+
+// larger sprites get their own texture
+#define SPRITE_ATLAS_MAX_SPRITE_SIZE 256
+
+// border around each sprite on a page, filled with copies of the sprite's
+// edge pixels, so linear filtering doesn't pick up neighbors
+#define SPRITE_ATLAS_PADDING 1
+
+
+static int atlasPageSize = -1;
+
+
+
+char SpriteGL::fitsInAtlas( unsigned int inWidth, unsigned int inHeight ) {
+#ifdef GLES
+    // GLES drawing doesn't map texture coordinates
+    return false;
+#else
+    return sUseAtlas && 
+        ! sGenerateMipMaps &&
+        inWidth <= SPRITE_ATLAS_MAX_SPRITE_SIZE &&
+        inHeight <= SPRITE_ATLAS_MAX_SPRITE_SIZE;
+#endif
+    }
+
+
+
+char SpriteGL::packIntoAtlas( unsigned char *inRGBA, 
+                              unsigned int inWidth, unsigned int inHeight ) {
+    
+    if( ! fitsInAtlas( inWidth, inHeight ) ) {
+        return false;
+        }
+    
+    if( atlasPageSize == -1 ) {
+        GLint maxSize = 0;
+        glGetIntegerv( GL_MAX_TEXTURE_SIZE, &maxSize );
+        
+        atlasPageSize = SPRITE_ATLAS_PAGE_SIZE;
+        
+        if( maxSize > 0 && maxSize < atlasPageSize ) {
+            atlasPageSize = maxSize;
+            }
+        }
+    
+    int pad = SPRITE_ATLAS_PADDING;
+    
+    int paddedW = inWidth + 2 * pad;
+    int paddedH = inHeight + 2 * pad;
+    
+    if( paddedW > atlasPageSize || paddedH > atlasPageSize ) {
+        return false;
+        }
+    
+
+    SpriteAtlasPage *page = NULL;
+    int x = 0;
+    int y = 0;
+
+    for( int i=0; i<sAtlasPages.size(); i++ ) {
+        SpriteAtlasPage *p = sAtlasPages.getElementDirect( i );
+        
+        if( p->packer->pack( paddedW, paddedH, &x, &y ) ) {
+            page = p;
+            break;
+            }
+        }
+    
+    if( page == NULL ) {
+        int numPageBytes = atlasPageSize * atlasPageSize * 4;
+        
+        unsigned char *blank = new unsigned char[ numPageBytes ];
+        memset( blank, 0, numPageBytes );
+        
+        page = new SpriteAtlasPage;
+        
+        page->texture = new SingleTextureGL( blank, 
+                                             atlasPageSize, atlasPageSize,
+                                             // no wrap
+                                             false,
+                                             // no mipmap
+                                             false,
+                                             // nothing to expand
+                                             false );
+        delete [] blank;
+        
+        page->packer = new SkylinePacker( atlasPageSize, atlasPageSize );
+        page->numSprites = 0;
+        page->lastSetMinFilter = -1;
+        page->lastSetMagFilter = -1;
+        
+        sAtlasPages.push_back( page );
+
+        page->packer->pack( paddedW, paddedH, &x, &y );
+        }
+    
+
+    // same edge treatment that a sprite's own texture would get
+    unsigned char *spriteBytes = new unsigned char[ inWidth * inHeight * 4 ];
+    memcpy( spriteBytes, inRGBA, inWidth * inHeight * 4 );
+    
+    SingleTextureGL::expandEdges( spriteBytes, inWidth, inHeight );
+    
+
+    unsigned char *padded = new unsigned char[ paddedW * paddedH * 4 ];
+    
+    int paddedRowBytes = paddedW * 4;
+    
+    for( int row=0; row<(int)inHeight; row++ ) {
+        unsigned char *dest = &( padded[ ( row + pad ) * paddedRowBytes ] );
+        
+        memcpy( &( dest[ pad * 4 ] ), 
+                &( spriteBytes[ row * inWidth * 4 ] ), inWidth * 4 );
+        
+        // repeat first and last pixels out into padding
+        for( int p=0; p<pad; p++ ) {
+            memcpy( &( dest[ p * 4 ] ), &( dest[ pad * 4 ] ), 4 );
+            memcpy( &( dest[ ( pad + inWidth + p ) * 4 ] ), 
+                    &( dest[ ( pad + inWidth - 1 ) * 4 ] ), 4 );
+            }
+        }
+
+    // repeat first and last rows
+    for( int p=0; p<pad; p++ ) {
+        memcpy( &( padded[ p * paddedRowBytes ] ), 
+                &( padded[ pad * paddedRowBytes ] ), paddedRowBytes );
+        memcpy( &( padded[ ( pad + inHeight + p ) * paddedRowBytes ] ), 
+                &( padded[ ( pad + inHeight - 1 ) * paddedRowBytes ] ), 
+                paddedRowBytes );
+        }
+    
+    page->texture->replaceTextureSubData( padded, x, y, paddedW, paddedH );
+
+    delete [] padded;
+    delete [] spriteBytes;
+    
+
+    page->numSprites ++;
+    
+    mAtlasPage = page;
+    mTexture = page->texture;
+    
+    mAtlasX = x + pad;
+    mAtlasY = y + pad;
+    
+    mTexOffsetX = mAtlasX / (float)atlasPageSize;
+    mTexOffsetY = mAtlasY / (float)atlasPageSize;
+    mTexScaleX = inWidth / (float)atlasPageSize;
+    mTexScaleY = inHeight / (float)atlasPageSize;
+    
+    return true;
+    }
+
+
+
+void SpriteGL::moveOutOfAtlas() {
+    unsigned char *rgba = 
+        mTexture->getTextureSubData( mAtlasX, mAtlasY, mWidth, mHeight );
+    
+    releaseAtlasPage();
+    
+    mTexture = new SingleTextureGL( rgba, mWidth, mHeight,
+                                    // no wrap
+                                    false,
+                                    // atlas sprites have no mipmaps
+                                    false,
+                                    // already expanded
+                                    false );
+    delete [] rgba;
+
+    mLastSetMinFilter = -1;
+    mLastSetMagFilter = -1;
+    }
+
+
+
+void SpriteGL::releaseAtlasPage() {
+    SpriteAtlasPage *page = mAtlasPage;
+    
+    mAtlasPage = NULL;
+    mTexture = NULL;
+    
+    mTexOffsetX = 0;
+    mTexOffsetY = 0;
+    mTexScaleX = 1;
+    mTexScaleY = 1;
+    
+    page->numSprites --;
+    
+    if( page->numSprites == 0 ) {
+        sAtlasPages.deleteElementEqualTo( page );
+        
+        if( sLastTexture == page->texture ) {
+            sLastTexture = NULL;
+            }
+        
+        delete page->texture;
+        delete page->packer;
+        delete page;
+        }
+    }
+
+
+
+void SpriteGL::mapTexCoords( float *ioTexCoords, int inNumCoords ) {
+    if( mAtlasPage == NULL ) {
+        return;
+        }
+    
+    for( int i=0; i<inNumCoords; i++ ) {
+        ioTexCoords[ i * 2 ] = 
+            mTexOffsetX + ioTexCoords[ i * 2 ] * mTexScaleX;
+        ioTexCoords[ i * 2 + 1 ] = 
+            mTexOffsetY + ioTexCoords[ i * 2 + 1 ] * mTexScaleY;
+        }
+    }
+
+
 // NOTE
 // the GLES version of this is experimental and broken in terms of 
 // rotations and center offsets
@@ -674,191 +951,271 @@ void SpriteGL::prepareDraw( int inFrame,
     
     
     if( inComputeCornerPos ) {
+        computeCorners( inPosition, inScale, inRotation, inFlipH );
+        }
+
+    enableTexture( inLinearMagFilter, inMipMapFilter );
+    
+    // FOVMOD NOTE:  Change 3/4 - Take these lines during the merge process
+    if ( inComputeTexCoords ) {
+        computeTexCoords( inFrame );
+        }
+    }
+
+
+
+void SpriteGL::computeCorners( Vector3D *inPosition, 
+                               double inScale,
+                               double inRotation,
+                               char inFlipH ) {
+    
+    double xLeftRadius = inScale * mBaseScaleX * mColoredRadiusLeftX;
+    double xRightRadius = inScale * mBaseScaleX * mColoredRadiusRightX;
+    
+    double yTopRadius = inScale * mBaseScaleY * mColoredRadiusTopY;
+    double yBottomRadius = inScale * mBaseScaleY * mColoredRadiusBottomY;
+    
+    doublePair centerOffset = mult( mCenterOffset, inScale );
+    
+    
+    if( sCountingPixels ) {
+        // do this pre-flip and pre-rotation
+        double increment = 
+            ( xLeftRadius + xRightRadius ) *
+            ( yTopRadius + yBottomRadius );        
+        sPixelsDrawn += increment;
+        }
+    
+    
+
+    if( !(mFlipHorizontal) != !(inFlipH) ) {
+        // make sure flips don't override eachother, xor
         
-        double xLeftRadius = inScale * mBaseScaleX * mColoredRadiusLeftX;
-        double xRightRadius = inScale * mBaseScaleX * mColoredRadiusRightX;
-        
-        double yTopRadius = inScale * mBaseScaleY * mColoredRadiusTopY;
-        double yBottomRadius = inScale * mBaseScaleY * mColoredRadiusBottomY;
+        xLeftRadius = -xLeftRadius;
+        xRightRadius = -xRightRadius;
+        centerOffset.x = - centerOffset.x;
+        }
+    
+    
+    
+    // first, set up corners relative to 0,0
+    // loop is unrolled here, with all offsets added in
+    // also, mZ ignored now, since rotation no longer done
+    
+    if( inRotation == 0 ) {
+        double posX = inPosition->mX - centerOffset.x;
+        double posY = inPosition->mY + centerOffset.y;
         
-        doublePair centerOffset = mult( mCenterOffset, inScale );
+        squareVertices[0] = posX - xLeftRadius;
+        squareVertices[1] = posY - yBottomRadius;
         
+        squareVertices[2] = posX + xRightRadius; 
+        squareVertices[3] = posY - yBottomRadius;
+    
+        squareVertices[4] = posX - xLeftRadius; 
+        squareVertices[5] = posY + yTopRadius;
         
-        if( sCountingPixels ) {
-            // do this pre-flip and pre-rotation
-            double increment = 
-                ( xLeftRadius + xRightRadius ) *
-                ( yTopRadius + yBottomRadius );        
-            sPixelsDrawn += increment;
-            }
+        squareVertices[6] = posX + xRightRadius; 
+        squareVertices[7] = posY + yTopRadius;
         
+        }
+    else {
+        double posX = inPosition->mX;
+        double posY = inPosition->mY;
         
-
-        if( !(mFlipHorizontal) != !(inFlipH) ) {
-            // make sure flips don't override eachother, xor
-            
-            xLeftRadius = -xLeftRadius;
-            xRightRadius = -xRightRadius;
-            centerOffset.x = - centerOffset.x;
-            }
+        squareVertices[0] = - xLeftRadius - centerOffset.x;
+        squareVertices[1] = - yBottomRadius + centerOffset.y;
         
+        squareVertices[2] = xRightRadius - centerOffset.x;
+        squareVertices[3] = - yBottomRadius + centerOffset.y;        
+    
+        squareVertices[4] = - xLeftRadius - centerOffset.x;
+        squareVertices[5] = yTopRadius + centerOffset.y;
         
+        squareVertices[6] = xRightRadius - centerOffset.x;
+        squareVertices[7] = yTopRadius + centerOffset.y;
         
-        // first, set up corners relative to 0,0
-        // loop is unrolled here, with all offsets added in
-        // also, mZ ignored now, since rotation no longer done
         
-        if( inRotation == 0 ) {
-            double posX = inPosition->mX - centerOffset.x;
-            double posY = inPosition->mY + centerOffset.y;
-            
-            squareVertices[0] = posX - xLeftRadius;
-            squareVertices[1] = posY - yBottomRadius;
-            
-            squareVertices[2] = posX + xRightRadius; 
-            squareVertices[3] = posY - yBottomRadius;
+        double cosAngle = cos( - 2 * M_PI * inRotation );
+        double sinAngle = sin( - 2 * M_PI * inRotation );
         
-            squareVertices[4] = posX - xLeftRadius; 
-            squareVertices[5] = posY + yTopRadius;
+        for( int i=0; i<7; i+=2 ) {
+            double x = squareVertices[i];
+            double y = squareVertices[i+1];
             
-            squareVertices[6] = posX + xRightRadius; 
-            squareVertices[7] = posY + yTopRadius;
+            squareVertices[i] = x * cosAngle - y * sinAngle;
+            squareVertices[i+1] = x * sinAngle + y * cosAngle;
             
+            squareVertices[i] += posX;
+            squareVertices[i+1] += posY;
             }
-        else {
-            double posX = inPosition->mX;
-            double posY = inPosition->mY;
-            
-            squareVertices[0] = - xLeftRadius - centerOffset.x;
-            squareVertices[1] = - yBottomRadius + centerOffset.y;
-            
-            squareVertices[2] = xRightRadius - centerOffset.x;
-            squareVertices[3] = - yBottomRadius + centerOffset.y;        
         
-            squareVertices[4] = - xLeftRadius - centerOffset.x;
-            squareVertices[5] = yTopRadius + centerOffset.y;
-            
-            squareVertices[6] = xRightRadius - centerOffset.x;
-            squareVertices[7] = yTopRadius + centerOffset.y;
-            
-            
-            double cosAngle = cos( - 2 * M_PI * inRotation );
-            double sinAngle = sin( - 2 * M_PI * inRotation );
-            
-            for( int i=0; i<7; i+=2 ) {
-                double x = squareVertices[i];
-                double y = squareVertices[i+1];
-                
-                squareVertices[i] = x * cosAngle - y * sinAngle;
-                squareVertices[i+1] = x * sinAngle + y * cosAngle;
-                
-                squareVertices[i] += posX;
-                squareVertices[i+1] += posY;
-                }
-            
-            }
         }
-    
-    // int i;
-    
+    }
 
-    // now rotate around center
-    // then add inPosition so that center is at inPosition
-    
-    // Found with profiler:  ignore rotation, since game doesn't use it anyway.
-    // Angle3D rot( 0, 0, inRotation );
-    
-    // found with profiler:
-    // unroll this loop
-    /*
-    for( i=0; i<4; i++ ) {        
-        // corners[i].rotate( &rot );
-        corners[i].add( inPosition );
-        }
-    */
 
-    /*
-    if( inColor != NULL  ) {
-        glColor4f( inColor->r, inColor->g, inColor->b, inFadeFactor );
-        }
-    else {
-        glColor4f( 1, 1, 1, inFadeFactor );
+
+void SpriteGL::enableTexture( char inLinearMagFilter, 
+                              char inMipMapFilter ) {
+
+    if( mTexture != sLastTexture ) {
+        sStateChanges++;
+        sLastTexture = mTexture;
         }
-    */          
+    
     mTexture->enable();
     
+    // filter state belongs to texture, which atlas sprites share
+    int *lastSetMinFilter = &mLastSetMinFilter;
+    int *lastSetMagFilter = &mLastSetMagFilter;
+    
+    if( mAtlasPage != NULL ) {
+        lastSetMinFilter = &( mAtlasPage->lastSetMinFilter );
+        lastSetMagFilter = &( mAtlasPage->lastSetMagFilter );
+        }
+    
 
     if( inMipMapFilter ) {
-        if( mLastSetMinFilter != 2 ) {
+        if( *lastSetMinFilter != 2 ) {
             glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, 
                              GL_LINEAR_MIPMAP_LINEAR );
-            mLastSetMinFilter = 2;
+            *lastSetMinFilter = 2;
+            sStateChanges++;
             }
         }
     else {
         
         if( inLinearMagFilter ) {
-            if( mLastSetMinFilter != 1 ) {
+            if( *lastSetMinFilter != 1 ) {
                 glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, 
                                  GL_LINEAR );
-                mLastSetMinFilter = 1;
+                *lastSetMinFilter = 1;
+                sStateChanges++;
                 }
             }
         else {
-            if( mLastSetMinFilter != 0 ) {
+            if( *lastSetMinFilter != 0 ) {
                 glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, 
                                  GL_NEAREST );
-                mLastSetMinFilter = 0;
+                *lastSetMinFilter = 0;
+                sStateChanges++;
                 }
             }
         }
     
     if( inLinearMagFilter ) {
-        if( mLastSetMagFilter != 1 ) {
+        if( *lastSetMagFilter != 1 ) {
             glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-            mLastSetMagFilter = 1;
+            *lastSetMagFilter = 1;
+            sStateChanges++;
             }
         }
     else {
-        if( mLastSetMagFilter != 0 ) {
+        if( *lastSetMagFilter != 0 ) {
             glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
-            mLastSetMagFilter = 0;
+            *lastSetMagFilter = 0;
+            sStateChanges++;
             }
         }
+    }
+
 
+
+void SpriteGL::computeTexCoords( int inFrame ) {
+    textXA = (1.0 / mNumPages) * mCurrentPage;
+    textXB = textXA + (1.0 / mNumPages );
     
+    textXA += 0.5 - mColoredRadiusLeftX;
+    textXB -= 0.5 - mColoredRadiusRightX;
     
-    // FOVMOD NOTE:  Change 3/4 - Take these lines during the merge process
-    if ( inComputeTexCoords ) {
-        textXA = (1.0 / mNumPages) * mCurrentPage;
-        textXB = textXA + (1.0 / mNumPages );
-        
-        textXA += 0.5 - mColoredRadiusLeftX;
-        textXB -= 0.5 - mColoredRadiusRightX;
-        
 
-        textYB = (1.0 / mNumFrames) * inFrame;
-        textYA = textYB + (1.0 / mNumFrames );
+    textYB = (1.0 / mNumFrames) * inFrame;
+    textYA = textYB + (1.0 / mNumFrames );
 
-        textYB += 0.5 - mColoredRadiusTopY;
-        textYA -= 0.5 - mColoredRadiusBottomY;
+    textYB += 0.5 - mColoredRadiusTopY;
+    textYA -= 0.5 - mColoredRadiusBottomY;
 
-        squareTextureCoords[0] = textXA;
-        squareTextureCoords[1] = textYA;
+    squareTextureCoords[0] = textXA;
+    squareTextureCoords[1] = textYA;
 
-        squareTextureCoords[2] = textXB;
-        squareTextureCoords[3] = textYA;
-        
-        squareTextureCoords[4] = textXA;
-        squareTextureCoords[5] = textYB;
+    squareTextureCoords[2] = textXB;
+    squareTextureCoords[3] = textYA;
+    
+    squareTextureCoords[4] = textXA;
+    squareTextureCoords[5] = textYB;
 
-        squareTextureCoords[6] = textXB;
-        squareTextureCoords[7] = textYB;
+    squareTextureCoords[6] = textXB;
+    squareTextureCoords[7] = textYB;
+
+    mapTexCoords( squareTextureCoords, 4 );
+    }
+
+
+
+void SpriteGL::getTexCoords( int inFrame, float outTexCoords[8] ) {
+    computeTexCoords( inFrame );
+    
+    // strip order to quad order
+    outTexCoords[0] = squareTextureCoords[0];
+    outTexCoords[1] = squareTextureCoords[1];
+    outTexCoords[2] = squareTextureCoords[2];
+    outTexCoords[3] = squareTextureCoords[3];
+    outTexCoords[4] = squareTextureCoords[6];
+    outTexCoords[5] = squareTextureCoords[7];
+    outTexCoords[6] = squareTextureCoords[4];
+    outTexCoords[7] = squareTextureCoords[5];
+    }
+
+
+
+void SpriteGL::getQuad( int inFrame,
+                        Vector3D *inPosition,
+                        double inScale,
+                        double inRotation,
+                        char inFlipH,
+                        float outVerts[8], float outTexCoords[8] ) {
+    
+    computeCorners( inPosition, inScale, inRotation, inFlipH );
+    
+    // strip order to quad order
+    outVerts[0] = squareVertices[0];
+    outVerts[1] = squareVertices[1];
+    outVerts[2] = squareVertices[2];
+    outVerts[3] = squareVertices[3];
+    outVerts[4] = squareVertices[6];
+    outVerts[5] = squareVertices[7];
+    outVerts[6] = squareVertices[4];
+    outVerts[7] = squareVertices[5];
+
+    getTexCoords( inFrame, outTexCoords );
+    }
+
+
+
+void SpriteGL::drawQuadBatch( int inNumQuads, 
+                              float *inVerts, float *inTexCoords,
+                              float *inColors ) {
+
+    glVertexPointer( 2, GL_FLOAT, 0, inVerts );
+    glTexCoordPointer( 2, GL_FLOAT, 0, inTexCoords );
+    
+    if( !sStateSet ) {    
+        glEnableClientState( GL_VERTEX_ARRAY );
+        glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+        sStateSet = true;
         }
+
+    glColorPointer( 4, GL_FLOAT, 0, inColors );
+    glEnableClientState( GL_COLOR_ARRAY );
+
+    glDrawArrays( GL_QUADS, 0, inNumQuads * 4 );
+    sDrawCalls++;
+    
+    glDisableClientState( GL_COLOR_ARRAY );
     }
 
 
-        
+
 extern int numPixelsDrawn;
 
 
@@ -891,6 +1248,7 @@ void SpriteGL::draw( int inFrame,
         }
     
     glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+    sDrawCalls++;
 
 
     /*
@@ -965,6 +1323,7 @@ void SpriteGL::draw( int inFrame,
 
 
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    sDrawCalls++;
 
     
     glDisableClientState( GL_COLOR_ARRAY );
@@ -1034,6 +1393,7 @@ void SpriteGL::draw( int inFrame,
 
 
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    sDrawCalls++;
 
     
     glDisableClientState( GL_COLOR_ARRAY );
@@ -1079,6 +1439,8 @@ void SpriteGL::draw( int inFrame,
     squareTextureCoords[6] = inTexCoords[2].x;
     squareTextureCoords[7] = inTexCoords[2].y;
 
+    mapTexCoords( squareTextureCoords, 4 );
+
 
     glVertexPointer( 2, GL_FLOAT, 0, squareVertices );
     glTexCoordPointer( 2, GL_FLOAT, 0, squareTextureCoords );
@@ -1090,6 +1452,7 @@ void SpriteGL::draw( int inFrame,
         }
     
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    sDrawCalls++;
     }
 
 
@@ -9,10 +9,31 @@
 
 #include "minorGems/math/geometry/Vector3D.h"
 
+#include "minorGems/graphics/SkylinePacker.h"
+#include "minorGems/util/SimpleVector.h"
+
 #include <stdlib.h>
 
 
 
+// a large texture shared by many small RGBA sprites
+typedef struct SpriteAtlasPage {
+        SingleTextureGL *texture;
+        
+        SkylinePacker *packer;
+        
+        // page is freed when its last sprite is freed
+        // (space of sprites freed before that is not reused)
+        int numSprites;
+        
+        // filters are texture state, so they are tracked per page
+        // instead of per sprite
+        int lastSetMinFilter;
+        int lastSetMagFilter;
+    } SpriteAtlasPage;
+
+
+
 class SpriteGL{
     public:
         
@@ -21,6 +42,20 @@ class SpriteGL{
             sGenerateMipMaps = inGenerateMipMaps;
             }
             
+
+        // toggles atlas packing for subsequent RGBA and Image constructor
+        // calls
+        // sprites small enough are packed into shared atlas pages 
+        // instead of getting their own texture
+        // ignored while generating mipmaps, and on GLES
+        static void toggleAtlas( char inUseAtlas ) {
+            sUseAtlas = inUseAtlas;
+            }
+        
+        static int getNumAtlasPages() {
+            return sAtlasPages.size();
+            }
+        
         
 
         // transparent color for RGB images can be taken from lower-left
@@ -169,9 +204,74 @@ class SpriteGL{
         static void setTexturingDisabled() {
             // need to renable client states later
             sStateSet = false;
+            sLastTexture = NULL;
             SingleTextureGL::disableTexturing();
             }
 
+
+        // for sprite batching (not supported on GLES)
+        
+        // gets quad corners and texture coordinates in BL, BR, TR, TL order
+        // without touching GL state
+        void getQuad( int inFrame,
+                      Vector3D *inPosition,
+                      double inScale,
+                      double inRotation,
+                      char inFlipH,
+                      float outVerts[8], float outTexCoords[8] );
+        
+        void getTexCoords( int inFrame, float outTexCoords[8] );
+        
+
+        // binds this sprite's texture and sets its filters
+        void enableTexture( char inLinearMagFilter, char inMipMapFilter );
+
+
+        SingleTextureGL *getTexture() {
+            return mTexture;
+            }
+        
+        char isInAtlas() {
+            return mAtlasPage != NULL;
+            }
+        
+
+        // maps inNumCoords texture coordinate pairs from sprite space 
+        // (0..1 over whole sprite image) into texture space
+        // only changes coordinates of sprites in an atlas
+        void mapTexCoords( float *ioTexCoords, int inNumCoords );
+        
+
+        // draws quads with the currently enabled texture
+        // vertices and texture coordinates in BL, BR, TR, TL order, 
+        // and four r,g,b,a values per vertex
+        static void drawQuadBatch( int inNumQuads, 
+                                   float *inVerts, float *inTexCoords,
+                                   float *inColors );
+        
+
+        
+        // counts of glDrawArrays calls and of texture binds and filter
+        // changes made while drawing sprites
+        static void resetDrawCounts() {
+            sDrawCalls = 0;
+            sStateChanges = 0;
+            }
+        
+        static int getDrawCalls() {
+            return sDrawCalls;
+            }
+        
+        static int getStateChanges() {
+            return sStateChanges;
+            }
+        
+        // for state changes made outside SpriteGL, like blend mode
+        static void countStateChange() {
+            sStateChanges++;
+            }
+        
+
         
         int mWidth, mHeight;
 
@@ -188,9 +288,28 @@ class SpriteGL{
         // -1 for unset, 0 for nearest, 1 for linear
         int mLastSetMagFilter;
         
+        static char sUseAtlas;
+        
+        static SimpleVector<SpriteAtlasPage*> sAtlasPages;
+        
+        // NULL if sprite has its own texture
+        SpriteAtlasPage *mAtlasPage;
+        
+        // position of sprite image on atlas page, in pixels
+        int mAtlasX, mAtlasY;
+        
+        // maps sprite texture coordinates to page texture coordinates
+        float mTexOffsetX, mTexOffsetY;
+        float mTexScaleX, mTexScaleY;
+        
         static char sWrapSet;
 
         static char sStateSet;
+
+        static SingleTextureGL *sLastTexture;
+        
+        static int sDrawCalls;
+        static int sStateChanges;
         
 
         SingleTextureGL *mTexture;
@@ -244,6 +363,34 @@ class SpriteGL{
 
 
 
+        // parts of prepareDraw
+        // corners go into squareVertices, in triangle strip order
+        void computeCorners( Vector3D *inPosition, 
+                             double inScale,
+                             double inRotation,
+                             char inFlipH );
+        
+        // texture coordinates go into squareTextureCoords
+        void computeTexCoords( int inFrame );
+        
+
+
+        // true if a sprite of this size should go in an atlas
+        static char fitsInAtlas( unsigned int inWidth, 
+                                 unsigned int inHeight );
+        
+        // sets mTexture to an atlas page holding a copy of inRGBA
+        // returns false if sprite doesn't belong in atlas
+        char packIntoAtlas( unsigned char *inRGBA, 
+                            unsigned int inWidth, unsigned int inHeight );
+
+        // copies sprite out of its atlas page onto its own texture
+        void moveOutOfAtlas();
+        
+        // drops this sprite's reference to its atlas page
+        void releaseAtlasPage();
+        
+
         void findColoredRadii( Image *inImage );
         
         void findColoredRadii( unsigned char *inRGBA, 
@@ -6,13 +6,41 @@
 
 #include "minorGems/util/SimpleVector.h"
 
+#include <stdlib.h>
+
 
 static float lastR, lastG, lastB, lastA;
 
+// color last passed to glColor4f, after fades are applied
+static float glColorR = 1, glColorG = 1, glColorB = 1, glColorA = 1;
+
 
 static char additiveTextureColorMode = false;
 
 
+// blend modes
+#define BLEND_NORMAL 0
+#define BLEND_ADDITIVE 1
+#define BLEND_MULTIPLICATIVE 2
+#define BLEND_INVERTED 3
+
+// blend mode last asked for
+static int currentBlend = BLEND_NORMAL;
+
+// blend mode last passed to GL
+// only differs from currentBlend while a sprite batch is open
+static int glBlend = BLEND_NORMAL;
+
+// same for texture coloring
+static char glAdditiveTextureColorMode = false;
+
+
+static char spriteBatchOn = false;
+static char spriteBatchSorted = false;
+
+static void flushBatch();
+
+
 
 typedef struct GlobalFade {
         int handle;
@@ -101,6 +129,11 @@ void setDrawColor( float inR, float inG, float inB, float inA ) {
         inA *= globalFadeTotal;
         }
         
+    glColorR = inR;
+    glColorG = inG;
+    glColorB = inB;
+    glColorA = inA;
+
     glColor4f( inR, inG, inB, inA );
     }
 
@@ -126,6 +159,11 @@ FloatColor getDrawColor() {
 void setDrawFade( float inA ) {    
     lastA = inA;
     
+    glColorR = lastR;
+    glColorG = lastG;
+    glColorB = lastB;
+    glColorA = inA * globalFadeTotal;
+
     glColor4f( lastR, lastG, lastB, inA * globalFadeTotal );
     }
 
@@ -155,18 +193,48 @@ FloatColor getFloatColor( const char *inHexString ) {
 
 
 
-static void setNormalBlend() {
-    glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+static void applyBlend( int inBlend ) {
+    switch( inBlend ) {
+        case BLEND_ADDITIVE:
+            glBlendFunc( GL_SRC_ALPHA, GL_ONE );
+            break;
+        case BLEND_MULTIPLICATIVE:
+            glBlendFunc( GL_DST_COLOR, GL_ZERO );
+            break;
+        case BLEND_INVERTED:
+            glBlendFunc( GL_ONE_MINUS_DST_COLOR, GL_ZERO );
+            break;
+        default:
+            glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+            break;
+        }
+    
+    if( inBlend != glBlend ) {
+        SpriteGL::countStateChange();
+        }
+    glBlend = inBlend;
+    }
+
+
+
+// inside a sprite batch, blend mode is recorded with each sprite and 
+// only passed to GL when the batch is drawn
+static void setBlend( int inBlend ) {
+    currentBlend = inBlend;
+    
+    if( !spriteBatchOn ) {
+        applyBlend( inBlend );
+        }
     }
 
 
 
 void toggleAdditiveBlend( char inAdditive ) {
     if( inAdditive ) {
-        glBlendFunc( GL_SRC_ALPHA, GL_ONE );
+        setBlend( BLEND_ADDITIVE );
         }
     else {
-        setNormalBlend();
+        setBlend( BLEND_NORMAL );
         }
     }
 
@@ -174,32 +242,45 @@ void toggleAdditiveBlend( char inAdditive ) {
 
 void toggleMultiplicativeBlend( char inMultiplicative ) {
     if( inMultiplicative ) {
-        glBlendFunc( GL_DST_COLOR, GL_ZERO );
+        setBlend( BLEND_MULTIPLICATIVE );
         }
     else {
-        setNormalBlend();
+        setBlend( BLEND_NORMAL );
         }
     }
 
 
 void toggleInvertedBlend( char inInverted ) {
     if( inInverted ) {
-        glBlendFunc( GL_ONE_MINUS_DST_COLOR, GL_ZERO );
+        setBlend( BLEND_INVERTED );
     }
     else {
-        setNormalBlend();
+        setBlend( BLEND_NORMAL );
     }
 }
 
 
 
-void toggleAdditiveTextureColoring( char inAdditive ) {
+static void applyAdditiveTextureColoring( char inAdditive ) {
     if( inAdditive ) {
         glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_ADD );
         }
     else {
         glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
         }
+
+    if( inAdditive != glAdditiveTextureColorMode ) {
+        SpriteGL::countStateChange();
+        }
+    glAdditiveTextureColorMode = inAdditive;
+    }
+
+
+
+void toggleAdditiveTextureColoring( char inAdditive ) {
+    if( !spriteBatchOn ) {
+        applyAdditiveTextureColoring( inAdditive );
+        }
     
     additiveTextureColorMode = inAdditive;
     }
@@ -227,6 +308,12 @@ void toggleMipMapGeneration( char inGenerateMipMaps ) {
 
 
 
+void toggleSpriteAtlas( char inAtlasOn ) {
+    SpriteGL::toggleAtlas( inAtlasOn );
+    }
+
+
+
 static char mipMapTextureFilterOn = false;
 
 void toggleMipMapMinFilter( char inMipMapFilterOn ) {
@@ -280,6 +367,8 @@ static double *quadVertsToTriangles( int inNumQuads, double inVertices[] ) {
 
 
 void drawQuads( int inNumQuads, double inVertices[] ) {
+    flushBatch();
+
     SpriteGL::setTexturingDisabled();
     
     double *triangleVertices = quadVertsToTriangles( inNumQuads, inVertices );
@@ -292,6 +381,8 @@ void drawQuads( int inNumQuads, double inVertices[] ) {
 
 void drawQuads( int inNumQuads, double inVertices[], 
                 float inVertexColors[] ) {
+    flushBatch();
+
 
     SpriteGL::setTexturingDisabled();
 
@@ -342,6 +433,8 @@ void drawQuads( int inNumQuads, double inVertices[],
 
 void drawTriangles( int inNumTriangles, double inVertices[], 
                     char inStrip, char inFan ) {
+    flushBatch();
+
     
     SpriteGL::setTexturingDisabled();
     
@@ -387,6 +480,8 @@ void drawTriangles( int inNumTriangles, double inVertices[],
 
 void drawTrianglesColor( int inNumTriangles, double inVertices[], 
                          float inVertexColors[], char inStrip, char inFan ) {
+    flushBatch();
+
 
     SpriteGL::setTexturingDisabled();
     
@@ -440,6 +535,8 @@ void drawTrianglesColor( int inNumTriangles, double inVertices[],
 
 
 void drawQuads( int inNumQuads, double inVertices[] ) {
+    flushBatch();
+
     SpriteGL::setTexturingDisabled();
     
     glEnableClientState( GL_VERTEX_ARRAY );
@@ -454,6 +551,8 @@ void drawQuads( int inNumQuads, double inVertices[] ) {
 
 void drawQuads( int inNumQuads, double inVertices[], 
                 float inVertexColors[] ) {
+    flushBatch();
+
 
     SpriteGL::setTexturingDisabled();
 
@@ -475,6 +574,8 @@ void drawQuads( int inNumQuads, double inVertices[],
 
 void drawTriangles( int inNumTriangles, double inVertices[], 
                     char inStrip, char inFan ) {
+    flushBatch();
+
     
     SpriteGL::setTexturingDisabled();
     
@@ -499,6 +600,8 @@ void drawTriangles( int inNumTriangles, double inVertices[],
 
 void drawTrianglesColor( int inNumTriangles, double inVertices[], 
                          float inVertexColors[], char inStrip, char inFan ) {
+    flushBatch();
+
 
     SpriteGL::setTexturingDisabled();
     
@@ -528,6 +631,8 @@ void drawTrianglesColor( int inNumTriangles, double inVertices[],
 
 
 void enableScissor( double inX, double inY, double inWidth, double inHeight ) {
+    flushBatch();
+
     
     double endX = inX + inWidth;
     double endY = inY + inHeight;
@@ -562,6 +667,8 @@ void enableScissor( double inX, double inY, double inWidth, double inHeight ) {
 
 
 void disableScissor() {
+    flushBatch();
+
     glDisable( GL_SCISSOR_TEST );
     }
 
@@ -569,6 +676,8 @@ void disableScissor() {
 
 void startAddingToStencil( char inDrawColorToo, char inAdd,
                            float inMinAlpha ) {
+    flushBatch();
+
     if( !inDrawColorToo ) {
         
         // stop updating color
@@ -601,6 +710,8 @@ void startAddingToStencil( char inDrawColorToo, char inAdd,
 
 
 void startDrawingThroughStencil( char inInvertStencil ) {
+    flushBatch();
+
     // Re-enable update of color
     glColorMask( GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE );
     glDisable( GL_ALPHA_TEST );
@@ -629,6 +740,8 @@ void stopStencil() {
 
 
 void disableStencil() {
+    flushBatch();
+
     // Re-enable update of color (just in case stencil drawing was not started)
     glColorMask( GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE );
     glDisable( GL_ALPHA_TEST );
@@ -671,6 +784,9 @@ SpriteHandle fillSpriteAlphaOnly( unsigned char *inA,
 
 
 void freeSprite( SpriteHandle inSprite ) {
+    // batch may still refer to it
+    flushBatch();
+    
     SpriteGL *s = (SpriteGL *)inSprite;
     totalLoadedTextureBytes -= s->mWidth * s->mHeight * 4;
     delete ( s );
@@ -701,6 +817,12 @@ void setSpriteCenterOffset( SpriteHandle inSprite, doublePair inOffset ) {
 
 // FOVMOD NOTE:  Change 1/2 - Take these lines during the merge process
 void setSpriteWrapping( SpriteHandle inSprite, char inHorizontal, char inVertical ) {
+    // wrapping is texture state, so sprites already batched must be
+    // drawn with the old wrapping
+    // (also, wrapping moves a sprite out of its atlas page, and sprites
+    //  already batched have texture coordinates for that page)
+    flushBatch();
+    
     SpriteGL *sprite = (SpriteGL *)inSprite;
     sprite->setWrapping( inHorizontal, inVertical );
 }
@@ -727,6 +849,7 @@ static double numSpritesDrawn = 0;
 
 void startCountingSpritesDrawn() {
     numSpritesDrawn = 0;
+    SpriteGL::resetDrawCounts();
     }
 
 
@@ -737,6 +860,218 @@ double endCountingSpritesDrawn() {
 
 
 
+int endCountingSpriteDrawCalls() {
+    return SpriteGL::getDrawCalls();
+    }
+
+
+
+int endCountingSpriteStateChanges() {
+    return SpriteGL::getStateChanges();
+    }
+
+
+
+typedef struct BatchedSprite {
+        SpriteGL *sprite;
+        
+        // blend mode, texture coloring, and filters packed together
+        int state;
+        
+        // position in batch, to keep sorting stable
+        int order;
+        
+        // BL, BR, TR, TL
+        float verts[8];
+        float texCoords[8];
+        float colors[16];
+    } BatchedSprite;
+
+
+static SimpleVector<BatchedSprite> batchedSprites;
+
+
+// scratch arrays for one run of sprites that can be drawn together
+static SimpleVector<float> runVerts;
+static SimpleVector<float> runTexCoords;
+static SimpleVector<float> runColors;
+
+
+
+static int getSpriteBatchState( char inLinearMagFilter, 
+                                char inMipMapFilter ) {
+    return 
+        currentBlend << 3 |
+        additiveTextureColorMode << 2 |
+        inLinearMagFilter << 1 |
+        inMipMapFilter;
+    }
+
+
+
+static int compareBatchedSprites( const void *inA, const void *inB ) {
+    const BatchedSprite *a = (const BatchedSprite *)inA;
+    const BatchedSprite *b = (const BatchedSprite *)inB;
+    
+    if( a->state != b->state ) {
+        return a->state - b->state;
+        }
+    
+    SingleTextureGL *texA = a->sprite->getTexture();
+    SingleTextureGL *texB = b->sprite->getTexture();
+    
+    if( texA != texB ) {
+        return texA < texB ? -1 : 1;
+        }
+    
+    return a->order - b->order;
+    }
+
+
+
+// adds sprite to batch, colored with current draw color if 
+// inCornerColors is NULL
+static void addBatchedSprite( SpriteGL *inSprite, 
+                              float inVerts[8], float inTexCoords[8],
+                              FloatColor *inCornerColors ) {
+    
+    BatchedSprite b;
+    b.sprite = inSprite;
+    b.state = getSpriteBatchState( linearTextureFilterOn, 
+                                   mipMapTextureFilterOn );
+    b.order = batchedSprites.size();
+    
+    memcpy( b.verts, inVerts, 8 * sizeof( float ) );
+    memcpy( b.texCoords, inTexCoords, 8 * sizeof( float ) );
+    
+    for( int v=0; v<4; v++ ) {
+        float *c = &( b.colors[ v * 4 ] );
+        
+        if( inCornerColors == NULL ) {
+            c[0] = glColorR;
+            c[1] = glColorG;
+            c[2] = glColorB;
+            c[3] = glColorA;
+            }
+        else {
+            c[0] = inCornerColors[v].r;
+            c[1] = inCornerColors[v].g;
+            c[2] = inCornerColors[v].b;
+            c[3] = inCornerColors[v].a;
+            }
+        }
+    
+    batchedSprites.push_back( b );
+    }
+
+
+
+// draws batched sprites, then puts GL back in the state last asked for
+static void flushBatch() {
+    int numSprites = batchedSprites.size();
+    
+    if( numSprites == 0 ) {
+        // blend mode may have changed with nothing drawn
+        if( currentBlend != glBlend ) {
+            applyBlend( currentBlend );
+            }
+        if( additiveTextureColorMode != glAdditiveTextureColorMode ) {
+            applyAdditiveTextureColoring( additiveTextureColorMode );
+            }
+        return;
+        }
+    
+    BatchedSprite *sprites = batchedSprites.getElementFast( 0 );
+    
+    if( spriteBatchSorted ) {
+        qsort( sprites, numSprites, sizeof( BatchedSprite ),
+               compareBatchedSprites );
+        }
+    
+    int runStart = 0;
+    
+    while( runStart < numSprites ) {
+        BatchedSprite *first = &( sprites[ runStart ] );
+        SingleTextureGL *tex = first->sprite->getTexture();
+        
+        int runEnd = runStart + 1;
+        
+        while( runEnd < numSprites &&
+               sprites[ runEnd ].state == first->state &&
+               sprites[ runEnd ].sprite->getTexture() == tex ) {
+            runEnd++;
+            }
+        
+        runVerts.deleteAll();
+        runTexCoords.deleteAll();
+        runColors.deleteAll();
+        
+        for( int i=runStart; i<runEnd; i++ ) {
+            runVerts.appendArray( sprites[i].verts, 8 );
+            runTexCoords.appendArray( sprites[i].texCoords, 8 );
+            runColors.appendArray( sprites[i].colors, 16 );
+            }
+        
+        int state = first->state;
+        
+        if( ( state >> 3 ) != glBlend ) {
+            applyBlend( state >> 3 );
+            }
+        if( ( ( state >> 2 ) & 1 ) != glAdditiveTextureColorMode ) {
+            applyAdditiveTextureColoring( ( state >> 2 ) & 1 );
+            }
+        
+        first->sprite->enableTexture( ( state >> 1 ) & 1, state & 1 );
+        
+        SpriteGL::drawQuadBatch( runEnd - runStart,
+                                 runVerts.getElementFast( 0 ),
+                                 runTexCoords.getElementFast( 0 ),
+                                 runColors.getElementFast( 0 ) );
+        
+        runStart = runEnd;
+        }
+    
+    batchedSprites.deleteAll();
+    
+    
+    if( currentBlend != glBlend ) {
+        applyBlend( currentBlend );
+        }
+    if( additiveTextureColorMode != glAdditiveTextureColorMode ) {
+        applyAdditiveTextureColoring( additiveTextureColorMode );
+        }
+    
+    // current color is undefined after drawing with a color array
+    glColor4f( glColorR, glColorG, glColorB, glColorA );
+    }
+
+
+
+void startSpriteBatch( char inSortByTexture ) {
+    flushBatch();
+
+#ifndef GLES
+    spriteBatchOn = true;
+    spriteBatchSorted = inSortByTexture;
+#endif
+    }
+
+
+
+void endSpriteBatch() {
+    flushBatch();
+    spriteBatchOn = false;
+    }
+
+
+
+void flushSpriteBatch() {
+    flushBatch();
+    SpriteGL::setTexturingDisabled();
+    }
+
+
+
 // profiler found constructor/deconstructor calls were using 1.8% of time
 static Vector3D spritePos( 0, 0, 0 );
 
@@ -748,13 +1083,22 @@ void drawSprite( SpriteHandle inSprite, doublePair inCenter,
     spritePos.mX = inCenter.x;
     spritePos.mY = inCenter.y;
     
+    numSpritesDrawn++;
+
+    if( spriteBatchOn ) {
+        float verts[8];
+        float texCoords[8];
+        sprite->getQuad( 0, &spritePos, inZoom, inRotation, inFlipH,
+                         verts, texCoords );
+        addBatchedSprite( sprite, verts, texCoords, NULL );
+        return;
+        }
+    
     sprite->draw( 0,
                   &spritePos,
                   inZoom,
                   linearTextureFilterOn,
                   mipMapTextureFilterOn, inRotation, inFlipH );
-    
-    numSpritesDrawn++;
     }
 
 
@@ -767,14 +1111,23 @@ void drawSprite( SpriteHandle inSprite, doublePair inCenter,
     spritePos.mX = inCenter.x;
     spritePos.mY = inCenter.y;
 
+    numSpritesDrawn++;
+
+    if( spriteBatchOn ) {
+        float verts[8];
+        float texCoords[8];
+        sprite->getQuad( 0, &spritePos, inZoom, inRotation, inFlipH,
+                         verts, texCoords );
+        addBatchedSprite( sprite, verts, texCoords, inCornerColors );
+        return;
+        }
+
     sprite->draw( 0,
                   &spritePos,
                   inCornerColors,
                   inZoom,
                   linearTextureFilterOn, mipMapTextureFilterOn,
                   inRotation, inFlipH );
-    
-    numSpritesDrawn++;
     }
 
 
@@ -783,12 +1136,24 @@ void drawSprite( SpriteHandle inSprite, doublePair inCornerPos[4],
                  FloatColor inCornerColors[4] ) {
     SpriteGL *sprite = (SpriteGL *)inSprite;
     
+    numSpritesDrawn++;
+
+    if( spriteBatchOn ) {
+        float verts[8];
+        float texCoords[8];
+        for( int i=0; i<4; i++ ) {
+            verts[ i * 2 ] = inCornerPos[i].x;
+            verts[ i * 2 + 1 ] = inCornerPos[i].y;
+            }
+        sprite->getTexCoords( 0, texCoords );
+        addBatchedSprite( sprite, verts, texCoords, inCornerColors );
+        return;
+        }
+    
     sprite->draw( 0,
                   inCornerPos,
                   inCornerColors,
                   linearTextureFilterOn, mipMapTextureFilterOn );
-    
-    numSpritesDrawn++;
     }
 
 
@@ -798,12 +1163,26 @@ void drawSprite( SpriteHandle inSprite, doublePair inCornerPos[4],
                  doublePair inTexCoords[4] ) {
     SpriteGL *sprite = (SpriteGL *)inSprite;
 
+    numSpritesDrawn++;
+
+    if( spriteBatchOn ) {
+        float verts[8];
+        float texCoords[8];
+        for( int i=0; i<4; i++ ) {
+            verts[ i * 2 ] = inCornerPos[i].x;
+            verts[ i * 2 + 1 ] = inCornerPos[i].y;
+            texCoords[ i * 2 ] = inTexCoords[i].x;
+            texCoords[ i * 2 + 1 ] = inTexCoords[i].y;
+            }
+        sprite->mapTexCoords( texCoords, 4 );
+        addBatchedSprite( sprite, verts, texCoords, NULL );
+        return;
+        }
+
     sprite->draw( 0,
                   inCornerPos,
                   inTexCoords,
                   linearTextureFilterOn, mipMapTextureFilterOn );
-
-    numSpritesDrawn++;
     }
 
 
@@ -816,6 +1195,12 @@ void drawSpriteAlphaOnly( SpriteHandle inSprite, doublePair inCenter,
     // http://stackoverflow.com/questions/2485370/
     //      use-only-alpha-channel-of-texture-in-opengl
 
+    // texture environment can't be batched, draw right away
+    flushBatch();
+    
+    char wasBatching = spriteBatchOn;
+    spriteBatchOn = false;
+
     glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_COMBINE);
     glTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_RGB, GL_REPLACE);
     glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE0_RGB, GL_PREVIOUS);
@@ -829,6 +1214,9 @@ void drawSpriteAlphaOnly( SpriteHandle inSprite, doublePair inCenter,
 
     // restore texture mode
     glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
+    glAdditiveTextureColorMode = false;
+
+    spriteBatchOn = wasBatching;
     }
 
     
@@ -0,0 +1,240 @@
+// Checks that sprite batching draws queued sprites with the texture
+// state they were queued with.
+//
+// Runs without a display:  the GL calls made by gameGraphicsGL and
+// SpriteGL are replaced below with fakes that record draws and
+// texture state changes.
+
+
+#include "minorGems/game/gameGraphics.h"
+
+#include "minorGems/graphics/openGL/glInclude.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+
+static GLuint nextTextureID = 1;
+static GLuint boundTextureID = 0;
+
+// recorded in call order
+#define MAX_EVENTS 64
+
+typedef struct GLEvent {
+        // 'D' for a draw, 'W' for a wrap change
+        char type;
+        GLuint textureID;
+    } GLEvent;
+
+static GLEvent events[ MAX_EVENTS ];
+static int numEvents = 0;
+
+
+static void recordEvent( char inType ) {
+    if( numEvents < MAX_EVENTS ) {
+        events[ numEvents ].type = inType;
+        events[ numEvents ].textureID = boundTextureID;
+        numEvents++;
+        }
+    }
+
+
+
+// fakes for the GL calls that we care about
+
+void glGenTextures( GLsizei inN, GLuint *outTextures ) {
+    for( int i=0; i<inN; i++ ) {
+        outTextures[i] = nextTextureID;
+        nextTextureID++;
+        }
+    }
+
+void glBindTexture( GLenum inTarget, GLuint inTexture ) {
+    boundTextureID = inTexture;
+    }
+
+void glTexParameteri( GLenum inTarget, GLenum inName, GLint inParam ) {
+    if( inName == GL_TEXTURE_WRAP_S ) {
+        recordEvent( 'W' );
+        }
+    }
+
+void glDrawArrays( GLenum inMode, GLint inFirst, GLsizei inCount ) {
+    recordEvent( 'D' );
+    }
+
+void glGetIntegerv( GLenum inName, GLint *outParams ) {
+    if( inName == GL_MAX_TEXTURE_SIZE ) {
+        *outParams = 4096;
+        }
+    else {
+        *outParams = 0;
+        }
+    }
+
+GLenum glGetError() {
+    return GL_NO_ERROR;
+    }
+
+const GLubyte *glGetString( GLenum inName ) {
+    return (const GLubyte *)"";
+    }
+
+void glGetDoublev( GLenum inName, GLdouble *outParams ) {
+    memset( outParams, 0, 16 * sizeof( GLdouble ) );
+    }
+
+GLint gluProject( GLdouble inObjX, GLdouble inObjY, GLdouble inObjZ,
+                  const GLdouble *inModel, const GLdouble *inProj,
+                  const GLint *inView,
+                  GLdouble *outWinX, GLdouble *outWinY,
+                  GLdouble *outWinZ ) {
+    *outWinX = 0;
+    *outWinY = 0;
+    *outWinZ = 0;
+    return GL_TRUE;
+    }
+
+
+// the rest do nothing
+
+void glAlphaFunc( GLenum, GLclampf ) {}
+void glBlendFunc( GLenum, GLenum ) {}
+void glClear( GLbitfield ) {}
+void glColor4f( GLfloat, GLfloat, GLfloat, GLfloat ) {}
+void glColorMask( GLboolean, GLboolean, GLboolean, GLboolean ) {}
+void glColorPointer( GLint, GLenum, GLsizei, const GLvoid * ) {}
+void glDeleteTextures( GLsizei, const GLuint * ) {}
+void glDisable( GLenum ) {}
+void glDisableClientState( GLenum ) {}
+void glEnable( GLenum ) {}
+void glEnableClientState( GLenum ) {}
+void glPixelStorei( GLenum, GLint ) {}
+void glScissor( GLint, GLint, GLsizei, GLsizei ) {}
+void glStencilFunc( GLenum, GLint, GLuint ) {}
+void glStencilOp( GLenum, GLenum, GLenum ) {}
+void glTexCoordPointer( GLint, GLenum, GLsizei, const GLvoid * ) {}
+void glTexEnvf( GLenum, GLenum, GLfloat ) {}
+void glTexEnvi( GLenum, GLenum, GLint ) {}
+void glTexImage2D( GLenum, GLint, GLint, GLsizei, GLsizei, GLint,
+                   GLenum, GLenum, const GLvoid * ) {}
+void glTexSubImage2D( GLenum, GLint, GLint, GLint, GLsizei, GLsizei,
+                      GLenum, GLenum, const GLvoid * ) {}
+void glVertexPointer( GLint, GLenum, GLsizei, const GLvoid * ) {}
+
+
+
+static int numFailed = 0;
+
+
+static void check( char inCondition, const char *inMessage ) {
+    if( ! inCondition ) {
+        printf( "FAILED:  %s\n", inMessage );
+        numFailed++;
+        }
+    }
+
+
+
+static SpriteHandle makeSprite() {
+    unsigned char rgba[ 16 * 16 * 4 ];
+    memset( rgba, 255, sizeof( rgba ) );
+
+    return fillSprite( rgba, 16, 16 );
+    }
+
+
+
+// index of first event of type inType, or -1
+static int findEvent( char inType ) {
+    for( int i=0; i<numEvents; i++ ) {
+        if( events[i].type == inType ) {
+            return i;
+            }
+        }
+    return -1;
+    }
+
+
+
+static void testWrapAfterQueue() {
+    toggleSpriteAtlas( false );
+
+    SpriteHandle sprite = makeSprite();
+
+    startSpriteBatch( false );
+
+    doublePair center = { 0, 0 };
+
+    numEvents = 0;
+
+    drawSprite( sprite, center );
+    setSpriteWrapping( sprite, true, true );
+
+    endSpriteBatch();
+
+    int draw = findEvent( 'D' );
+    int wrap = findEvent( 'W' );
+
+    check( draw != -1, "queued sprite drawn" );
+    check( wrap != -1, "wrapping set" );
+    check( draw < wrap, "queued sprite drawn before wrapping changed" );
+
+    freeSprite( sprite );
+    }
+
+
+
+// wrapping moves a sprite out of its atlas page, onto its own texture
+static void testAtlasWrapAfterQueue() {
+    toggleSpriteAtlas( true );
+
+    GLuint firstNewID = nextTextureID;
+
+    SpriteHandle sprite = makeSprite();
+
+    check( nextTextureID == firstNewID + 1, "sprite put on atlas page" );
+
+    GLuint pageID = firstNewID;
+
+    startSpriteBatch( false );
+
+    doublePair center = { 0, 0 };
+
+    numEvents = 0;
+
+    drawSprite( sprite, center );
+    setSpriteWrapping( sprite, true, true );
+
+    endSpriteBatch();
+
+    int draw = findEvent( 'D' );
+    int wrap = findEvent( 'W' );
+
+    check( draw != -1, "queued atlas sprite drawn" );
+    check( wrap != -1 && events[ wrap ].textureID != pageID,
+           "wrapping set on sprite's own texture" );
+    check( draw != -1 && events[ draw ].textureID == pageID,
+           "queued atlas sprite drawn from its atlas page" );
+
+    freeSprite( sprite );
+
+    toggleSpriteAtlas( false );
+    }
+
+
+
+int main() {
+
+    testWrapAfterQueue();
+    testAtlasWrapAfterQueue();
+
+    if( numFailed > 0 ) {
+        printf( "%d checks FAILED\n", numFailed );
+        return 1;
+        }
+
+    printf( "All checks passed\n" );
+    return 0;
+    }
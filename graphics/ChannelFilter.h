@@ -11,6 +11,8 @@
  
 #ifndef CHANNEL_FILTER_INCLUDED
 #define CHANNEL_FILTER_INCLUDED
+
+#include <math.h>
  
  
 /**
@@ -24,10 +26,113 @@ class ChannelFilter {
 		virtual void apply( double *inChannel, int inWidth, int inHeight ) = 0;
 
 
+        /**
+         * Filters a channel of 8-bit, 16-bit, or float samples, as stored
+         * in a PixelImage.
+         *
+         * Integer samples map [0,255] or [0,65535] to [0,1].
+         *
+         * The default implementations copy the channel into doubles,
+         * call apply, and copy the result back.  Filters that can work
+         * on samples directly should override these.
+         *
+         * @param inChannel the first sample of the channel.
+         * @param inStride the distance, in samples, between neighboring
+         *   pixels of the channel (1 for a planar channel, the number
+         *   of channels for an interleaved one).
+         * @param inWidth, inHeight the channel dimensions.
+         */
+        virtual void applyBytes( unsigned char *inChannel, int inStride,
+                                 int inWidth, int inHeight );
+        virtual void applyShorts( unsigned short *inChannel, int inStride,
+                                  int inWidth, int inHeight );
+        virtual void applyFloats( float *inChannel, int inStride,
+                                  int inWidth, int inHeight );
+
+
         // ensure proper destruction of subclasses
         virtual ~ChannelFilter() {
             }
 		
 	};
+
+
+
+inline void ChannelFilter::applyBytes( unsigned char *inChannel,
+                                       int inStride,
+                                       int inWidth, int inHeight ) {
+    int numPixels = inWidth * inHeight;
+    double *values = new double[ numPixels ];
+
+    double inv255 = 1.0 / 255.0;
+    for( int i=0; i<numPixels; i++ ) {
+        values[i] = inv255 * inChannel[ i * inStride ];
+        }
+
+    apply( values, inWidth, inHeight );
+
+    for( int i=0; i<numPixels; i++ ) {
+        long v = lrint( 255 * values[i] );
+        if( v < 0 ) {
+            v = 0;
+            }
+        else if( v > 255 ) {
+            v = 255;
+            }
+        inChannel[ i * inStride ] = (unsigned char)v;
+        }
+
+    delete [] values;
+    }
+
+
+
+inline void ChannelFilter::applyShorts( unsigned short *inChannel,
+                                        int inStride,
+                                        int inWidth, int inHeight ) {
+    int numPixels = inWidth * inHeight;
+    double *values = new double[ numPixels ];
+
+    double inv65535 = 1.0 / 65535.0;
+    for( int i=0; i<numPixels; i++ ) {
+        values[i] = inv65535 * inChannel[ i * inStride ];
+        }
+
+    apply( values, inWidth, inHeight );
+
+    for( int i=0; i<numPixels; i++ ) {
+        long v = lrint( 65535 * values[i] );
+        if( v < 0 ) {
+            v = 0;
+            }
+        else if( v > 65535 ) {
+            v = 65535;
+            }
+        inChannel[ i * inStride ] = (unsigned short)v;
+        }
+
+    delete [] values;
+    }
+
+
+
+inline void ChannelFilter::applyFloats( float *inChannel, int inStride,
+                                        int inWidth, int inHeight ) {
+    int numPixels = inWidth * inHeight;
+    double *values = new double[ numPixels ];
+
+    for( int i=0; i<numPixels; i++ ) {
+        values[i] = inChannel[ i * inStride ];
+        }
+
+    apply( values, inWidth, inHeight );
+
+    for( int i=0; i<numPixels; i++ ) {
+        inChannel[ i * inStride ] = (float)( values[i] );
+        }
+
+    delete [] values;
+    }
+
 	
 #endif
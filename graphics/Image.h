@@ -316,6 +316,8 @@ class Image : public Serializable {
 	protected:
 		long mWide, mHigh, mNumPixels, mNumChannels;
 		
+		// entries can be NULL in subclasses that fill channels in
+		// on demand, so access through getChannelData
 		double **mChannels;
 		
 		// NULL if nothing selected.
@@ -337,6 +339,35 @@ class Image : public Serializable {
 		 */
 		virtual void pasteChannel( double *inChannelData, double *inMask,
 			int inChannel );
+
+
+        /**
+         * Constructs an image without allocating channel data, for
+         * subclasses that fill channels in the first time they are used.
+         *
+         * @param inChannels an array of inNumChannels channel pointers,
+         *   any of which can be NULL.  NULL channels are filled in
+         *   by loadChannel when first accessed.
+         *   Destroyed when this image is destroyed.
+         * @param inWidth width of image in pixels.
+         * @param inHeight height of image in pixels.
+         * @param inNumChannels number of channels in image.
+         */
+        Image( double **inChannels, int inWidth, int inHeight,
+               int inNumChannels );
+
+
+        /**
+         * Called the first time a NULL channel is accessed.  Must set
+         * mChannels[ inChannel ] to an array of mNumPixels values.
+         *
+         * Default implementation allocates a channel of zeros.
+         */
+        virtual void loadChannel( int inChannel );
+
+
+        // gets a channel, loading it first if needed
+        double *getChannelData( int inChannel );
 		
 	};
 
@@ -359,6 +390,31 @@ inline Image::Image( int inWidth, int inHeight, int inNumChannels,
 		
 		
 		
+inline Image::Image( double **inChannels, int inWidth, int inHeight,
+                     int inNumChannels ) 
+	: mWide( inWidth ), mHigh( inHeight ), mNumPixels( inWidth * inHeight ),
+	mNumChannels( inNumChannels ), mChannels( inChannels ),
+	mSelection( NULL ) {
+    }
+
+
+
+inline void Image::loadChannel( int inChannel ) {
+    mChannels[ inChannel ] = new double[ mNumPixels ];
+    memset( mChannels[ inChannel ], 0, mNumPixels * sizeof( double ) );
+    }
+
+
+
+inline double *Image::getChannelData( int inChannel ) {
+    if( mChannels[ inChannel ] == NULL ) {
+        loadChannel( inChannel );
+        }
+    return mChannels[ inChannel ];
+    }
+
+
+
 inline Image::~Image() {
 	for( int i=0; i<mNumChannels; i++ ) {
 		delete [] mChannels[i];
@@ -387,7 +443,7 @@ inline long Image::getNumChannels() {
 	
 		
 inline double *Image::getChannel( int inChannel ) {
-	return mChannels[ inChannel ];
+	return getChannelData( inChannel );
 	}
 	
 
@@ -396,7 +452,7 @@ inline Color Image::getColor( int inIndex ) {
     Color c;
     
     for( int i=0; i<mNumChannels && i < 4; i++ ) {
-        c[i] = (float)( mChannels[i][inIndex] );
+        c[i] = (float)( getChannelData( i )[inIndex] );
         }
     
     return c;
@@ -406,7 +462,7 @@ inline Color Image::getColor( int inIndex ) {
 
 inline void Image::setColor( int inIndex, Color inColor ) {
     for( int i=0; i<mNumChannels && i < 4; i++ ) {
-        mChannels[i][inIndex] = (double)( inColor[i] );
+        getChannelData( i )[inIndex] = (double)( inColor[i] );
         }
     }
 
@@ -433,7 +489,7 @@ inline void Image::clearSelection() {
 inline void Image::filter( ChannelFilter *inFilter, int inChannel ) {
 
 	if( mSelection == NULL ) {
-		inFilter->apply( mChannels[ inChannel ], mWide, mHigh );
+		inFilter->apply( getChannelData( inChannel ), mWide, mHigh );
 		}
 	else { // part of image selected
 		// turn selection off and filter channel entirely
@@ -488,7 +544,7 @@ inline double *Image::copyChannel( int inChannel ) {
 	// first, copy the channel
 	double *copiedChannel = new double[mNumPixels];
 	memcpy( copiedChannel, 
-		mChannels[inChannel], sizeof( double ) * mNumPixels );
+		getChannelData( inChannel ), sizeof( double ) * mNumPixels );
 	
 	
 	if( mSelection != NULL ) {
@@ -536,7 +592,7 @@ inline void Image::pasteChannel( double *inChannelData, int inChannel ) {
 inline void Image::pasteChannel( double *inChannelData, double *inMask,
 	int inChannel ) {
 	
-	double *thisChannel = mChannels[inChannel];
+	double *thisChannel = getChannelData( inChannel );
 	if( mSelection != NULL ) {
 		// scale incoming data with this selection
 		double *selection = getChannelSelection(inChannel);
@@ -584,7 +640,7 @@ inline Image *Image::getSubImage( int inStartX, int inStartY,
 
     for( int c=0; c<mNumChannels; c++ ) {
         double *destChannel = destImage->getChannel( c );
-        double *sourceChannel = mChannels[c];
+        double *sourceChannel = getChannelData( c );
         
         int destY=0;
         for( int y=inStartY; y<endY; y++ ) {
@@ -627,7 +683,7 @@ inline void Image::setSubImage( int inStartX, int inStartY,
     int endY = inStartY + inHeight;
    
     for( int c=0; c<mNumChannels; c++ ) {
-        double *destChannel = mChannels[c];
+        double *destChannel = getChannelData( c );
         double *sourceChannel = inSourceImage->getChannel(c);
         
         int sourceY=0;
@@ -668,7 +724,7 @@ inline Image *Image::expandImage( int inExpandedWidth, int inExpandedHeight,
 
     for( int c=0; c<mNumChannels; c++ ) {
         double *destChannel = destImage->getChannel( c );
-        double *sourceChannel = mChannels[c];
+        double *sourceChannel = getChannelData( c );
         
         int destY = yOffset;
         for( int y=0; y<mHigh; y++ ) {
@@ -751,11 +807,12 @@ inline int Image::serialize( OutputStream *inOutputStream ) {
 	// now output each channel
 	for( int i=0; i<mNumChannels; i++ ) {
 		unsigned char *byteArray = new unsigned char[mNumPixels];
+		double *channel = getChannelData( i );
 		
 		// convert each 8-bit double pixel to one byte
 		for( int p=0; p<mNumPixels; p++ ) {
 			//numBytes += inOutputStream->writeDouble( mChannels[i][p] );
-			byteArray[p] = (unsigned char)( lrint( mChannels[i][p] * 255 ) );
+			byteArray[p] = (unsigned char)( lrint( channel[p] * 255 ) );
 			}
 		
 		numBytes += inOutputStream->write( byteArray, mNumPixels );
@@ -932,10 +989,14 @@ inline void Image::adjustSaturation( double inSaturation ) {
         return;
         }    
 
+    double *red = getChannelData( 0 );
+    double *green = getChannelData( 1 );
+    double *blue = getChannelData( 2 );
+
     for( int p=0; p<mNumPixels; p++ ) {
-        double r = mChannels[0][p];
-        double g = mChannels[1][p];
-        double b = mChannels[2][p];
+        double r = red[p];
+        double g = green[p];
+        double b = blue[p];
         
         double h,s,l;
         
@@ -984,9 +1045,9 @@ inline void Image::adjustSaturation( double inSaturation ) {
 
         hslToRGB( h, s, l, &r, &g, &b );
 
-        mChannels[0][p] = r;
-        mChannels[1][p] = g;
-        mChannels[2][p] = b;
+        red[p] = r;
+        green[p] = g;
+        blue[p] = b;
         }
     }
 
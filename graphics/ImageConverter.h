@@ -17,6 +17,7 @@
 
 
 #include "Image.h"
+#include "PixelImage.h"
 #include "minorGems/io/InputStream.h"
 #include "minorGems/io/OutputStream.h"
 
@@ -54,6 +55,37 @@ class ImageConverter {
 		 *   operation fails.  Must be destroyed by caller.
 		 */
 		virtual Image *deformatImage( InputStream *inStream ) = 0;		
+
+
+        /**
+         * Sends a PixelImage out to a stream as a particular format.
+         *
+         * The default implementation converts inImage to an Image
+         * and calls formatImage.  Converters that can write samples
+         * directly override this.
+         *
+         * @param inImage the image to convert.  Destroyed by caller.
+         * @param inStream the stream to write the formatted image to.
+         */
+        virtual void formatPixelImage( PixelImage *inImage, 
+                                       OutputStream *inStream );
+
+
+        /**
+         * Reads a PixelImage in from a stream as a particular format.
+         *
+         * The default implementation calls deformatImage and converts
+         * the result to 8-bit interleaved samples.  Converters that can
+         * read samples directly override this, and may return other
+         * sample types where the format stores them.
+         *
+         * @param inStream the stream to read the formatted image.
+         *
+         * @return the deformatted image, or NULL if the deformatting
+         *   operation fails.  Must be destroyed by caller.
+         */
+        virtual PixelImage *deformatPixelImage( InputStream *inStream );
+
         
 
 
@@ -64,4 +96,33 @@ class ImageConverter {
 	};
 
 
+
+inline void ImageConverter::formatPixelImage( PixelImage *inImage, 
+                                              OutputStream *inStream ) {
+    Image *image = inImage->toImage();
+
+    formatImage( image, inStream );
+
+    delete image;
+    }
+
+
+
+inline PixelImage *ImageConverter::deformatPixelImage( 
+    InputStream *inStream ) {
+
+    Image *image = deformatImage( inStream );
+
+    if( image == NULL ) {
+        return NULL;
+        }
+
+    PixelImage *result = new PixelImage( image );
+
+    delete image;
+
+    return result;
+    }
+
+
 #endif
@@ -0,0 +1,660 @@
+#ifndef PIXEL_IMAGE_INCLUDED
+#define PIXEL_IMAGE_INCLUDED
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "ChannelFilter.h"
+#include "Image.h"
+
+
+
+enum PixelSampleType {
+    PIXEL_UINT8 = 0,
+    PIXEL_UINT16,
+    PIXEL_FLOAT
+    };
+
+
+enum PixelLayout {
+    // RGBARGBARGBA...
+    PIXEL_INTERLEAVED = 0,
+    // RRR...GGG...BBB...AAA...
+    PIXEL_PLANAR
+    };
+
+
+
+/**
+ * A multi-channel image stored as 8-bit, 16-bit, or float samples, with
+ * channels interleaved or in separate planes.
+ *
+ * Image keeps a double for every sample, so an RGBA pixel costs 32 bytes.
+ * An 8-bit interleaved PixelImage costs 4, and its data can be handed
+ * to converters and textures without conversion.
+ *
+ * Integer samples map [0,255] or [0,65535] to Image's [0,1].  Float
+ * samples are [0,1] values, like Image's, stored at single precision.
+ *
+ * Rows are stored top to bottom with no padding.
+ */
+class PixelImage {
+
+    public:
+
+        /**
+         * Constructs an image.
+         *
+         * @param inWidth width of image in pixels.
+         * @param inHeight height of image in pixels.
+         * @param inNumChannels number of channels in image.
+         * @param inType the sample type.  Defaults to PIXEL_UINT8.
+         * @param inLayout the channel layout.  Defaults to
+         *   PIXEL_INTERLEAVED.
+         * @param inStartPixelsAtZero true to initialize all samples
+         *   to zero, or false to leave them to be filled in by caller.
+         *   Defaults to true.
+         */
+        PixelImage( int inWidth, int inHeight, int inNumChannels,
+                    PixelSampleType inType = PIXEL_UINT8,
+                    PixelLayout inLayout = PIXEL_INTERLEAVED,
+                    char inStartPixelsAtZero = true );
+
+
+        /**
+         * Constructs an image around existing sample data.
+         *
+         * @param inData the samples, laid out as described by the
+         *   other parameters.  Must have been allocated with
+         *   new unsigned char[].  Not copied, and destroyed when this
+         *   image is destroyed.
+         */
+        PixelImage( unsigned char *inData,
+                    int inWidth, int inHeight, int inNumChannels,
+                    PixelSampleType inType = PIXEL_UINT8,
+                    PixelLayout inLayout = PIXEL_INTERLEAVED );
+
+
+        /**
+         * Constructs an image by converting an Image.  Any selection in
+         * inImage is ignored.
+         *
+         * @param inImage the image to copy.  Destroyed by caller.
+         */
+        PixelImage( Image *inImage,
+                    PixelSampleType inType = PIXEL_UINT8,
+                    PixelLayout inLayout = PIXEL_INTERLEAVED );
+
+
+        ~PixelImage();
+
+
+        int getWidth();
+        int getHeight();
+        int getNumPixels();
+        int getNumChannels();
+
+        PixelSampleType getSampleType();
+        PixelLayout getLayout();
+
+        // 1, 2, or 4
+        int getBytesPerSample();
+
+        // size of the sample data
+        int getNumBytes();
+
+
+        /**
+         * Gets the sample data.  Not copied.
+         *
+         * getShorts and getFloats return the same data for 16-bit and
+         * float images.
+         */
+        unsigned char *getBytes();
+        unsigned short *getShorts();
+        float *getFloats();
+
+
+        /**
+         * Gets the distance, in samples, between neighboring pixels of
+         * one channel.  The number of channels for interleaved images,
+         * 1 for planar images.
+         */
+        int getSampleStride();
+
+
+        /**
+         * Gets the index, in samples, of the first sample of a channel.
+         */
+        int getChannelStart( int inChannel );
+
+
+        /**
+         * Gets or sets one sample as a [0,1] value.
+         *
+         * Slow next to working on getBytes data directly, but works for
+         * any type and layout.
+         */
+        double getSample( int inPixelIndex, int inChannel );
+        void setSample( int inPixelIndex, int inChannel, double inValue );
+
+
+        /**
+         * Copies a channel to or from an array of getNumPixels()
+         * [0,1] values, as stored by Image.
+         */
+        void readChannel( int inChannel, double *outValues );
+        void writeChannel( int inChannel, double *inValues );
+
+
+        /**
+         * Makes a copy of this image with a different sample type or
+         * layout.
+         *
+         * @return the new image.  Destroyed by caller.
+         */
+        PixelImage *convert( PixelSampleType inType, PixelLayout inLayout );
+
+
+        // copies this image without changing type or layout
+        PixelImage *copy();
+
+
+        /**
+         * Makes an Image copy of this image, for code that needs
+         * double channels.  See PixelImageView to avoid converting
+         * channels that aren't used.
+         *
+         * @return the new image.  Destroyed by caller.
+         */
+        Image *toImage();
+
+
+        /**
+         * Filters one channel, or all channels, in place, using the
+         * filter's function for this image's sample type.
+         */
+        void filter( ChannelFilter *inFilter, int inChannel );
+        void filter( ChannelFilter *inFilter );
+
+
+    protected:
+        int mWidth, mHeight, mNumPixels, mNumChannels;
+
+        PixelSampleType mType;
+        PixelLayout mLayout;
+
+        unsigned char *mData;
+
+
+        /**
+         * Copies one channel into another image's channel, converting
+         * samples.
+         */
+        void copyChannel( int inChannel, PixelImage *inDest,
+                          int inDestChannel );
+    };
+
+
+
+// sample conversions
+// integers round to nearest, and out-of-range values are clamped
+
+inline void pixelSampleConvert( unsigned char inSample,
+                                unsigned char *outSample ) {
+    *outSample = inSample;
+    }
+
+inline void pixelSampleConvert( unsigned char inSample,
+                                unsigned short *outSample ) {
+    *outSample = (unsigned short)( inSample * 257 );
+    }
+
+inline void pixelSampleConvert( unsigned char inSample,
+                                float *outSample ) {
+    *outSample = inSample * ( 1.0f / 255.0f );
+    }
+
+inline void pixelSampleConvert( unsigned short inSample,
+                                unsigned char *outSample ) {
+    *outSample = (unsigned char)( ( inSample * 255 + 32767 ) / 65535 );
+    }
+
+inline void pixelSampleConvert( unsigned short inSample,
+                                unsigned short *outSample ) {
+    *outSample = inSample;
+    }
+
+inline void pixelSampleConvert( unsigned short inSample,
+                                float *outSample ) {
+    *outSample = inSample * ( 1.0f / 65535.0f );
+    }
+
+inline void pixelSampleConvert( float inSample,
+                                unsigned char *outSample ) {
+    long v = lrintf( inSample * 255 );
+    if( v < 0 ) {
+        v = 0;
+        }
+    else if( v > 255 ) {
+        v = 255;
+        }
+    *outSample = (unsigned char)v;
+    }
+
+inline void pixelSampleConvert( float inSample,
+                                unsigned short *outSample ) {
+    long v = lrintf( inSample * 65535 );
+    if( v < 0 ) {
+        v = 0;
+        }
+    else if( v > 65535 ) {
+        v = 65535;
+        }
+    *outSample = (unsigned short)v;
+    }
+
+inline void pixelSampleConvert( float inSample,
+                                float *outSample ) {
+    *outSample = inSample;
+    }
+
+
+
+template <class SourceType, class DestType>
+inline void pixelSamplesConvert( SourceType *inSource, int inSourceStride,
+                                 DestType *inDest, int inDestStride,
+                                 int inNumSamples ) {
+    for( int i=0; i<inNumSamples; i++ ) {
+        pixelSampleConvert( *inSource, inDest );
+        inSource += inSourceStride;
+        inDest += inDestStride;
+        }
+    }
+
+
+
+template <class SourceType>
+inline void pixelSamplesConvert( SourceType *inSource, int inSourceStride,
+                                 PixelImage *inDest, int inDestChannel ) {
+    int destStart = inDest->getChannelStart( inDestChannel );
+    int destStride = inDest->getSampleStride();
+    int numPixels = inDest->getNumPixels();
+
+    switch( inDest->getSampleType() ) {
+        case PIXEL_UINT8:
+            pixelSamplesConvert( inSource, inSourceStride,
+                                 &( inDest->getBytes()[ destStart ] ),
+                                 destStride, numPixels );
+            break;
+        case PIXEL_UINT16:
+            pixelSamplesConvert( inSource, inSourceStride,
+                                 &( inDest->getShorts()[ destStart ] ),
+                                 destStride, numPixels );
+            break;
+        case PIXEL_FLOAT:
+            pixelSamplesConvert( inSource, inSourceStride,
+                                 &( inDest->getFloats()[ destStart ] ),
+                                 destStride, numPixels );
+            break;
+        }
+    }
+
+
+
+inline PixelImage::PixelImage( int inWidth, int inHeight, int inNumChannels,
+                               PixelSampleType inType,
+                               PixelLayout inLayout,
+                               char inStartPixelsAtZero )
+        : mWidth( inWidth ), mHeight( inHeight ),
+          mNumPixels( inWidth * inHeight ), mNumChannels( inNumChannels ),
+          mType( inType ), mLayout( inLayout ) {
+
+    mData = new unsigned char[ getNumBytes() ];
+
+    if( inStartPixelsAtZero ) {
+        memset( mData, 0, getNumBytes() );
+        }
+    }
+
+
+
+inline PixelImage::PixelImage( unsigned char *inData,
+                               int inWidth, int inHeight, int inNumChannels,
+                               PixelSampleType inType,
+                               PixelLayout inLayout )
+        : mWidth( inWidth ), mHeight( inHeight ),
+          mNumPixels( inWidth * inHeight ), mNumChannels( inNumChannels ),
+          mType( inType ), mLayout( inLayout ), mData( inData ) {
+    }
+
+
+
+inline PixelImage::PixelImage( Image *inImage,
+                               PixelSampleType inType,
+                               PixelLayout inLayout )
+        : mWidth( inImage->getWidth() ), mHeight( inImage->getHeight() ),
+          mNumPixels( mWidth * mHeight ),
+          mNumChannels( inImage->getNumChannels() ),
+          mType( inType ), mLayout( inLayout ) {
+
+    mData = new unsigned char[ getNumBytes() ];
+
+    for( int c=0; c<mNumChannels; c++ ) {
+        writeChannel( c, inImage->getChannel( c ) );
+        }
+    }
+
+
+
+inline PixelImage::~PixelImage() {
+    delete [] mData;
+    }
+
+
+
+inline int PixelImage::getWidth() {
+    return mWidth;
+    }
+
+
+
+inline int PixelImage::getHeight() {
+    return mHeight;
+    }
+
+
+
+inline int PixelImage::getNumPixels() {
+    return mNumPixels;
+    }
+
+
+
+inline int PixelImage::getNumChannels() {
+    return mNumChannels;
+    }
+
+
+
+inline PixelSampleType PixelImage::getSampleType() {
+    return mType;
+    }
+
+
+
+inline PixelLayout PixelImage::getLayout() {
+    return mLayout;
+    }
+
+
+
+inline int PixelImage::getBytesPerSample() {
+    switch( mType ) {
+        case PIXEL_UINT16:
+            return 2;
+        case PIXEL_FLOAT:
+            return 4;
+        default:
+            return 1;
+        }
+    }
+
+
+
+inline int PixelImage::getNumBytes() {
+    return mNumPixels * mNumChannels * getBytesPerSample();
+    }
+
+
+
+inline unsigned char *PixelImage::getBytes() {
+    return mData;
+    }
+
+
+
+// new [] returns memory aligned for any type, so these casts are safe
+
+inline unsigned short *PixelImage::getShorts() {
+    return (unsigned short *)mData;
+    }
+
+
+
+inline float *PixelImage::getFloats() {
+    return (float *)mData;
+    }
+
+
+
+inline int PixelImage::getSampleStride() {
+    if( mLayout == PIXEL_INTERLEAVED ) {
+        return mNumChannels;
+        }
+    return 1;
+    }
+
+
+
+inline int PixelImage::getChannelStart( int inChannel ) {
+    if( mLayout == PIXEL_INTERLEAVED ) {
+        return inChannel;
+        }
+    return inChannel * mNumPixels;
+    }
+
+
+
+inline double PixelImage::getSample( int inPixelIndex, int inChannel ) {
+    int i = getChannelStart( inChannel ) + inPixelIndex * getSampleStride();
+
+    switch( mType ) {
+        case PIXEL_UINT16:
+            return getShorts()[i] / 65535.0;
+        case PIXEL_FLOAT:
+            return getFloats()[i];
+        default:
+            return mData[i] / 255.0;
+        }
+    }
+
+
+
+inline void PixelImage::setSample( int inPixelIndex, int inChannel,
+                                   double inValue ) {
+    int i = getChannelStart( inChannel ) + inPixelIndex * getSampleStride();
+
+    float value = (float)inValue;
+
+    switch( mType ) {
+        case PIXEL_UINT16:
+            pixelSampleConvert( value, &( getShorts()[i] ) );
+            break;
+        case PIXEL_FLOAT:
+            getFloats()[i] = value;
+            break;
+        default:
+            pixelSampleConvert( value, &( mData[i] ) );
+            break;
+        }
+    }
+
+
+
+inline void PixelImage::readChannel( int inChannel, double *outValues ) {
+    int i = getChannelStart( inChannel );
+    int stride = getSampleStride();
+
+    switch( mType ) {
+        case PIXEL_UINT8: {
+            unsigned char *samples = &( mData[i] );
+            double inv255 = 1.0 / 255.0;
+            for( int p=0; p<mNumPixels; p++ ) {
+                outValues[p] = inv255 * *samples;
+                samples += stride;
+                }
+            }
+            break;
+        case PIXEL_UINT16: {
+            unsigned short *samples = &( getShorts()[i] );
+            double inv65535 = 1.0 / 65535.0;
+            for( int p=0; p<mNumPixels; p++ ) {
+                outValues[p] = inv65535 * *samples;
+                samples += stride;
+                }
+            }
+            break;
+        case PIXEL_FLOAT: {
+            float *samples = &( getFloats()[i] );
+            for( int p=0; p<mNumPixels; p++ ) {
+                outValues[p] = *samples;
+                samples += stride;
+                }
+            }
+            break;
+        }
+    }
+
+
+
+inline void PixelImage::writeChannel( int inChannel, double *inValues ) {
+    int i = getChannelStart( inChannel );
+    int stride = getSampleStride();
+
+    switch( mType ) {
+        case PIXEL_UINT8: {
+            unsigned char *samples = &( mData[i] );
+            for( int p=0; p<mNumPixels; p++ ) {
+                // same rounding as the converters use for Image
+                long v = lrint( 255 * inValues[p] );
+                if( v < 0 ) {
+                    v = 0;
+                    }
+                else if( v > 255 ) {
+                    v = 255;
+                    }
+                *samples = (unsigned char)v;
+                samples += stride;
+                }
+            }
+            break;
+        case PIXEL_UINT16: {
+            unsigned short *samples = &( getShorts()[i] );
+            for( int p=0; p<mNumPixels; p++ ) {
+                long v = lrint( 65535 * inValues[p] );
+                if( v < 0 ) {
+                    v = 0;
+                    }
+                else if( v > 65535 ) {
+                    v = 65535;
+                    }
+                *samples = (unsigned short)v;
+                samples += stride;
+                }
+            }
+            break;
+        case PIXEL_FLOAT: {
+            float *samples = &( getFloats()[i] );
+            for( int p=0; p<mNumPixels; p++ ) {
+                *samples = (float)( inValues[p] );
+                samples += stride;
+                }
+            }
+            break;
+        }
+    }
+
+
+
+inline void PixelImage::copyChannel( int inChannel, PixelImage *inDest,
+                                     int inDestChannel ) {
+    int i = getChannelStart( inChannel );
+    int stride = getSampleStride();
+
+    switch( mType ) {
+        case PIXEL_UINT8:
+            pixelSamplesConvert( &( mData[i] ), stride,
+                                 inDest, inDestChannel );
+            break;
+        case PIXEL_UINT16:
+            pixelSamplesConvert( &( getShorts()[i] ), stride,
+                                 inDest, inDestChannel );
+            break;
+        case PIXEL_FLOAT:
+            pixelSamplesConvert( &( getFloats()[i] ), stride,
+                                 inDest, inDestChannel );
+            break;
+        }
+    }
+
+
+
+inline PixelImage *PixelImage::convert( PixelSampleType inType,
+                                        PixelLayout inLayout ) {
+    PixelImage *result = new PixelImage( mWidth, mHeight, mNumChannels,
+                                         inType, inLayout, false );
+
+    if( inType == mType && inLayout == mLayout ) {
+        memcpy( result->mData, mData, getNumBytes() );
+        }
+    else {
+        for( int c=0; c<mNumChannels; c++ ) {
+            copyChannel( c, result, c );
+            }
+        }
+
+    return result;
+    }
+
+
+
+inline PixelImage *PixelImage::copy() {
+    return convert( mType, mLayout );
+    }
+
+
+
+inline Image *PixelImage::toImage() {
+    Image *image = new Image( mWidth, mHeight, mNumChannels, false );
+
+    for( int c=0; c<mNumChannels; c++ ) {
+        readChannel( c, image->getChannel( c ) );
+        }
+
+    return image;
+    }
+
+
+
+inline void PixelImage::filter( ChannelFilter *inFilter, int inChannel ) {
+    int i = getChannelStart( inChannel );
+    int stride = getSampleStride();
+
+    switch( mType ) {
+        case PIXEL_UINT8:
+            inFilter->applyBytes( &( mData[i] ), stride, mWidth, mHeight );
+            break;
+        case PIXEL_UINT16:
+            inFilter->applyShorts( &( getShorts()[i] ), stride,
+                                   mWidth, mHeight );
+            break;
+        case PIXEL_FLOAT:
+            inFilter->applyFloats( &( getFloats()[i] ), stride,
+                                   mWidth, mHeight );
+            break;
+        }
+    }
+
+
+
+inline void PixelImage::filter( ChannelFilter *inFilter ) {
+    for( int c=0; c<mNumChannels; c++ ) {
+        filter( inFilter, c );
+        }
+    }
+
+
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef PIXEL_IMAGE_VIEW_INCLUDED
+#define PIXEL_IMAGE_VIEW_INCLUDED
+
+#include "Image.h"
+#include "PixelImage.h"
+
+
+
+/**
+ * An Image that gets its channels from a PixelImage, for passing a
+ * PixelImage to code written for Image.
+ *
+ * Constructing a view copies nothing.  Each channel is converted to
+ * doubles the first time it is used, so code that only looks at the
+ * dimensions, or at one channel, only pays for what it uses.
+ *
+ * Changes made through the view reach the PixelImage only when
+ * commit is called.
+ */
+class PixelImageView : public Image {
+
+    public:
+
+        /**
+         * Constructs a view.
+         *
+         * @param inImage the image to view.
+         * @param inOwnImage true to destroy inImage when this view is
+         *   destroyed, or false if inImage is destroyed by caller (after
+         *   this view is destroyed).  Defaults to false.
+         */
+        PixelImageView( PixelImage *inImage, char inOwnImage = false );
+
+        virtual ~PixelImageView();
+
+
+        PixelImage *getPixelImage();
+
+
+        /**
+         * Writes channels that have been converted to doubles back into
+         * the PixelImage.
+         */
+        void commit();
+
+
+    protected:
+        PixelImage *mPixelImage;
+        char mOwnImage;
+
+
+        // converts a channel from mPixelImage
+        virtual void loadChannel( int inChannel );
+    };
+
+
+
+// all channels start NULL, and get loaded on first use
+static inline double **newEmptyChannelArray( int inNumChannels ) {
+    double **channels = new double*[ inNumChannels ];
+
+    for( int c=0; c<inNumChannels; c++ ) {
+        channels[c] = NULL;
+        }
+    return channels;
+    }
+
+
+
+inline PixelImageView::PixelImageView( PixelImage *inImage,
+                                       char inOwnImage )
+        : Image( newEmptyChannelArray( inImage->getNumChannels() ),
+                 inImage->getWidth(), inImage->getHeight(),
+                 inImage->getNumChannels() ),
+          mPixelImage( inImage ), mOwnImage( inOwnImage ) {
+    }
+
+
+
+inline PixelImageView::~PixelImageView() {
+    if( mOwnImage ) {
+        delete mPixelImage;
+        }
+    }
+
+
+
+inline PixelImage *PixelImageView::getPixelImage() {
+    return mPixelImage;
+    }
+
+
+
+inline void PixelImageView::loadChannel( int inChannel ) {
+    mChannels[ inChannel ] = new double[ mNumPixels ];
+
+    mPixelImage->readChannel( inChannel, mChannels[ inChannel ] );
+    }
+
+
+
+inline void PixelImageView::commit() {
+    for( int c=0; c<mNumChannels; c++ ) {
+        if( mChannels[c] != NULL ) {
+            mPixelImage->writeChannel( c, mChannels[c] );
+            }
+        }
+    }
+
+
+
+#endif
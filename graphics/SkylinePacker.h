@@ -0,0 +1,151 @@
+#ifndef SKYLINE_PACKER_INCLUDED
+#define SKYLINE_PACKER_INCLUDED
+
+
+#include "minorGems/util/SimpleVector.h"
+
+
+
+// top edge of filled region over one span of columns
+typedef struct SkylineSegment {
+        int x;
+        int y;
+        int width;
+    } SkylineSegment;
+
+
+
+/**
+ * Packs rectangles into a fixed-size area, like a texture page.
+ *
+ * Keeps the top edge of the filled region as a list of segments (the
+ * skyline), and places each rectangle where its top ends up lowest.
+ * Space is never reclaimed for single rectangles, only by clearing
+ * the whole area.
+ */
+class SkylinePacker {
+    public:
+
+        SkylinePacker( int inWidth, int inHeight )
+                : mWidth( inWidth ), mHeight( inHeight ) {
+            clear();
+            }
+
+
+        // forgets all packed rectangles
+        void clear() {
+            mSkyline.deleteAll();
+            SkylineSegment s = { 0, 0, mWidth };
+            mSkyline.push_back( s );
+            }
+
+
+        // packs a rectangle, bottom-left first
+        // returns false if area is too full
+        char pack( int inWidth, int inHeight, int *outX, int *outY ) {
+
+            int bestIndex = -1;
+            int bestTop = mHeight + 1;
+            int bestWidth = mWidth + 1;
+
+            for( int i=0; i<mSkyline.size(); i++ ) {
+                int y = fitHeight( i, inWidth, inHeight );
+
+                if( y != -1 ) {
+                    int top = y + inHeight;
+                    int width = mSkyline.getElementFast( i )->width;
+
+                    if( top < bestTop ||
+                        ( top == bestTop && width < bestWidth ) ) {
+                        bestIndex = i;
+                        bestTop = top;
+                        bestWidth = width;
+                        }
+                    }
+                }
+
+            if( bestIndex == -1 ) {
+                return false;
+                }
+
+            *outX = mSkyline.getElementFast( bestIndex )->x;
+            *outY = bestTop - inHeight;
+
+            SkylineSegment newSeg = { *outX, bestTop, inWidth };
+            mSkyline.push_middle( newSeg, bestIndex );
+
+            // trim segments now covered by new one
+            int i = bestIndex + 1;
+            while( i < mSkyline.size() ) {
+                SkylineSegment *s = mSkyline.getElementFast( i );
+                int overlap = newSeg.x + newSeg.width - s->x;
+
+                if( overlap <= 0 ) {
+                    break;
+                    }
+                if( overlap < s->width ) {
+                    s->x += overlap;
+                    s->width -= overlap;
+                    break;
+                    }
+                mSkyline.deleteElement( i );
+                }
+
+            // merge neighbors at same height
+            i = 0;
+            while( i < mSkyline.size() - 1 ) {
+                SkylineSegment *s = mSkyline.getElementFast( i );
+                SkylineSegment *next = mSkyline.getElementFast( i + 1 );
+
+                if( s->y == next->y ) {
+                    s->width += next->width;
+                    mSkyline.deleteElement( i + 1 );
+                    }
+                else {
+                    i++;
+                    }
+                }
+            return true;
+            }
+
+
+    protected:
+
+        int mWidth, mHeight;
+
+        SimpleVector<SkylineSegment> mSkyline;
+
+
+        // finds lowest y where a rectangle starting at skyline segment
+        // inIndex fits
+        // returns -1 if it doesn't fit
+        int fitHeight( int inIndex, int inWidth, int inHeight ) {
+            int x = mSkyline.getElementFast( inIndex )->x;
+
+            if( x + inWidth > mWidth ) {
+                return -1;
+                }
+
+            int y = 0;
+            int widthLeft = inWidth;
+            int i = inIndex;
+
+            while( widthLeft > 0 ) {
+                SkylineSegment *s = mSkyline.getElementFast( i );
+
+                if( s->y > y ) {
+                    y = s->y;
+                    }
+                if( y + inHeight > mHeight ) {
+                    return -1;
+                    }
+                widthLeft -= s->width;
+                i++;
+                }
+            return y;
+            }
+    };
+
+
+
+#endif
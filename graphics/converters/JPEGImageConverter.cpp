@@ -65,6 +65,32 @@ void JPEGImageConverter::formatImage( Image *inImage,
 		return;
 		}
 
+    PixelImage pixelImage( inImage );
+
+    formatPixelImage( &pixelImage, inStream );
+    }
+
+
+
+void JPEGImageConverter::formatPixelImage( PixelImage *inImage, 
+                                           OutputStream *inStream ) {
+	
+    int numChannels = inImage->getNumChannels();
+
+	if( numChannels != 3 && numChannels != 1 ) {
+		printf( "JPEGImageConverter only works on 1- and "
+                "3-channel images.\n" );
+		return;
+		}
+
+    PixelImage *converted = NULL;
+    
+    if( inImage->getSampleType() != PIXEL_UINT8 ||
+        inImage->getLayout() != PIXEL_INTERLEAVED ) {
+        converted = inImage->convert( PIXEL_UINT8, PIXEL_INTERLEAVED );
+        inImage = converted;
+        }
+
 	// most of this code was copied without modification from
 	// IJG's example.c
 	
@@ -117,6 +143,10 @@ void JPEGImageConverter::formatImage( Image *inImage,
 	 
 	if( ( outfile = fopen( fileName, "wb" ) ) == NULL ) {
 		printf( "can't open jpeg conversion temp file %s\n", fileName );
+        jpeg_destroy_compress( &cinfo );
+        if( converted != NULL ) {
+            delete converted;
+            }
 		return;
 		}
 	
@@ -132,8 +162,15 @@ void JPEGImageConverter::formatImage( Image *inImage,
 	// image width and height, in pixels 
 	cinfo.image_width = inImage->getWidth(); 	
 	cinfo.image_height = inImage->getHeight();
-	cinfo.input_components = 3;		// # of color components per pixel 
-	cinfo.in_color_space = JCS_RGB; 	// colorspace of input image 
+	// # of color components per pixel 
+	cinfo.input_components = numChannels;
+	// colorspace of input image 
+    if( numChannels == 3 ) {
+        cinfo.in_color_space = JCS_RGB;
+        }
+    else {
+        cinfo.in_color_space = JCS_GRAYSCALE;
+        }
 	// Now use the library's routine to set default compression parameters.
 	// (You must set at least cinfo.in_color_space before calling this,
 	// since the defaults depend on the source color space.)
@@ -162,57 +199,20 @@ void JPEGImageConverter::formatImage( Image *inImage,
 	// more if you wish, though.
 	 
 	// JSAMPLEs per row in image_buffer 
-	row_stride = cinfo.image_width * 3;
+	row_stride = cinfo.image_width * numChannels;
 
-	// channels of inImage, which we will need to pull pixel values out of
-	double *redChannel = inImage->getChannel(0);
-	double *greenChannel = inImage->getChannel(1);
-	double *blueChannel = inImage->getChannel(2);
-
-	// array that we will copy inImage pixels into
-	// one scanline at a time
-	row_pointer[0] = new JSAMPLE[ row_stride ];
-	
-	//int rowNumber = 0;
+	JSAMPLE *samples = inImage->getBytes();
 	
 	while( cinfo.next_scanline < cinfo.image_height ) {
 		// jpeg_write_scanlines expects an array of pointers to scanlines.
 		// Here the array is only one element long, but you could pass
 		// more than one scanline at a time if that's more convenient.
-		 
-
-		// make a scanline
-		
-		
- 		int yOffset = cinfo.next_scanline * cinfo.image_width;
-		
-		// for each pixel in the row
-		for( unsigned int p=0; p<cinfo.image_width; p++ ) {
-			// index into inImage
-			int pixelIndex = p + yOffset;
-
-			// index into this row
-			int startRowIndex = p * 3;
-
-			// red
-			row_pointer[0][ startRowIndex ] =
-				(JSAMPLE)( lrint( redChannel[ pixelIndex ] * 255 ) );
-			// green
-			row_pointer[0][ startRowIndex + 1 ] =
-				(JSAMPLE)( lrint( greenChannel[ pixelIndex ] * 255 ) );
-			// blue
-			row_pointer[0][ startRowIndex + 2 ] =
-				(JSAMPLE)( lrint( blueChannel[ pixelIndex ] * 255 ) );
-			}
 
+		// samples are already laid out as scanlines
+		row_pointer[0] = &( samples[ cinfo.next_scanline * row_stride ] );
 
-		// now pass the scanline into libjpeg
 		(void) jpeg_write_scanlines( &cinfo, row_pointer, 1 );
-
-		//rowNumber++;
 		}
-
-	delete [] ( row_pointer[0] );
 	
 	
 	// Step 6: Finish compression 
@@ -228,6 +228,10 @@ void JPEGImageConverter::formatImage( Image *inImage,
 	
 	jpeg_destroy_compress( &cinfo );
 
+    if( converted != NULL ) {
+        delete converted;
+        }
+
 
 	// now read the compressed data back in from file
 	File *file = new File( NULL, fileName, strlen( fileName ) );
@@ -324,6 +328,37 @@ void JPEGImageConverter::formatImage( Image *inImage,
 
 Image *JPEGImageConverter::deformatImage( InputStream *inStream ) {
 
+    PixelImage *pixelImage = deformatPixelImage( inStream );
+
+    if( pixelImage == NULL ) {
+        return NULL;
+        }
+
+    int numChannels = pixelImage->getNumChannels();
+    
+	// the return image with 3 channels
+	Image *returnImage = new Image( pixelImage->getWidth(), 
+                                    pixelImage->getHeight(), 3, false );
+
+    for( int c=0; c<3; c++ ) {
+        if( c < numChannels ) {
+            pixelImage->readChannel( c, returnImage->getChannel( c ) );
+            }
+        else {
+            // grayscale, same in all channels
+            pixelImage->readChannel( 0, returnImage->getChannel( c ) );
+            }
+        }
+
+    delete pixelImage;
+
+    return returnImage;
+    }
+
+
+
+PixelImage *JPEGImageConverter::deformatPixelImage( InputStream *inStream ) {
+
 	// use a temp file with a random name to make this more
 	// thread-safe
 	char fileName[99];
@@ -416,9 +451,14 @@ Image *JPEGImageConverter::deformatImage( InputStream *inStream ) {
 	struct my_error_mgr jerr;
 	/* More stuff */
 	FILE * infile;		/* source file */
-	JSAMPARRAY buffer;		/* Output row buffer */
+	JSAMPROW row_pointer[1];	/* pointer into returnImage's samples */
 	int row_stride;		/* physical row width in output buffer */
 
+	/* set below, volatile so it survives a longjmp to the error
+	 * handler, which destroys it
+	 */
+	PixelImage * volatile returnImage = NULL;
+
 	/* In this example we want to open the input
 	 * file before doing anything else,
 	 * so that the setjmp() error recovery below can assume the file is open.
@@ -444,6 +484,10 @@ Image *JPEGImageConverter::deformatImage( InputStream *inStream ) {
 		 */
 		jpeg_destroy_decompress( &cinfo );
 		fclose( infile );
+		remove( fileName );
+		if( returnImage != NULL ) {
+			delete returnImage;
+			}
 		printf( "error in decompressing jpeg from stream.\n" );
 		return NULL;
 		}
@@ -487,22 +531,14 @@ Image *JPEGImageConverter::deformatImage( InputStream *inStream ) {
 	int imageWidth = cinfo.output_width;
 	int imageHeight = cinfo.output_height;
 
-	// the return image with 3 channels
-	Image *returnImage = new Image( imageWidth, imageHeight, 3, false );
-
-	// channels of returnImage,
-	// which we will need to put pixel values into of
-	double *redChannel = returnImage->getChannel(0);
-	double *greenChannel = returnImage->getChannel(1);
-	double *blueChannel = returnImage->getChannel(2);
-	
+	// the return image, with one or three channels from libjpeg
+	returnImage = new PixelImage( imageWidth, imageHeight, 
+                                  cinfo.output_components,
+                                  PIXEL_UINT8, PIXEL_INTERLEAVED, false );
 	
 	row_stride = cinfo.output_width * cinfo.output_components;
-	/* Make a one-row-high sample array that
-	 * will go away when done with image
-	 */
-	buffer = ( *cinfo.mem->alloc_sarray )
-		((j_common_ptr) &cinfo, JPOOL_IMAGE, row_stride, 1 );
+
+	JSAMPLE *samples = returnImage->getBytes();
 
 	/* Step 6: while (scan lines remain to be read) */
 	/*           jpeg_read_scanlines(...); */
@@ -510,42 +546,11 @@ Image *JPEGImageConverter::deformatImage( InputStream *inStream ) {
 	/* Here we use the library's state variable cinfo.output_scanline as the
 	 * loop counter, so that we don't have to keep track ourselves.
 	 */
-	int rowNumber = 0;
-	double inv255 = 1.0 / 255.0;
-	
 	while( cinfo.output_scanline < cinfo.output_height ) {
-		/* jpeg_read_scanlines expects an array of pointers to scanlines.
-		 * Here the array is only one element long, but you could ask for
-		 * more than one scanline at a time if that's more convenient.
-		 */
-		(void) jpeg_read_scanlines( &cinfo, buffer, 1 );
+		// decode straight into returnImage's samples
+		row_pointer[0] = &( samples[ cinfo.output_scanline * row_stride ] );
 
-		// write the scanline into returnImage
-		
-		int yOffset = rowNumber * cinfo.output_width;
-		
-		// for each pixel in the row
-		// copy it into the return image channels
-		for( unsigned int p=0; p<cinfo.output_width; p++ ) {
-
-			// index into inImage
-			int pixelIndex = p + yOffset;
-
-			// index into this row
-			int startRowIndex = p * 3;
-
-			// red
-			redChannel[ pixelIndex ] =
-				buffer[0][ startRowIndex ] * inv255;
-			// green
-			greenChannel[ pixelIndex ] =
-				buffer[0][ startRowIndex + 1 ] * inv255;
-			// blue
-			blueChannel[ pixelIndex ] =
-				buffer[0][ startRowIndex + 2 ] * inv255;
-			}
-		
-		rowNumber++;
+		(void) jpeg_read_scanlines( &cinfo, row_pointer, 1 );
 		}
 	
 	/* Step 7: Finish decompression */
@@ -65,6 +65,15 @@ class JPEGImageConverter : public ImageConverter {
 			
 		virtual Image *deformatImage( InputStream *inStream );		
 
+
+        // 1-channel images are written as grayscale, 3-channel as RGB
+        // deformatted images are 8-bit interleaved, with 1 channel for
+        // grayscale JPEG files and 3 for color
+        virtual void formatPixelImage( PixelImage *inImage, 
+                                       OutputStream *inStream );
+        
+        virtual PixelImage *deformatPixelImage( InputStream *inStream );
+
 		
 	private:
 		int mQuality;
@@ -16,38 +16,68 @@
 
 #include "minorGems/util/SimpleVector.h"
 #include "minorGems/graphics/RGBAImage.h"
+#include "minorGems/system/endian.h"
+#include "minorGems/system/Thread.h"
 
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
 
-//#include "lodepng.h"
-
-//#include <zlib.h>
+// compression is done with the miniz compiled into encodingUtils
+// libpng pulls in zlib.h, so keep miniz from defining zlib's names
+#define MINIZ_NO_ZLIB_COMPATIBLE_NAMES
+#include "minorGems/formats/miniz.h"
 
+// libpng is still used for reading
 #include <png.h>
 
 
 
-PNGImageConverter::PNGImageConverter( int inCompressionLevel )
-        : mCompressionLevel( inCompressionLevel  ) {
+PNGImageConverter::PNGImageConverter( int inCompressionLevel,
+                                      int inNumThreads )
+        : mCompressionLevel( inCompressionLevel  ),
+          mNumThreads( inNumThreads ) {
+
+    if( mCompressionLevel < 0 ) {
+        mCompressionLevel = 0;
+        }
+    else if( mCompressionLevel > 9 ) {
+        mCompressionLevel = 9;
+        }
+    
+    if( mNumThreads < 1 ) {
+        mNumThreads = 1;
+        }
+    
 
     // set up the CRC table
     
     // code taken from the PNG spec:
     // http://www.w3.org/TR/2003/REC-PNG-20031110/#D-CRCAppendix
-    unsigned long c;
+    unsigned int c;
     int n, k;
    
     for( n=0; n<256; n++ ) {
-        c = (unsigned long)n;
+        c = (unsigned int)n;
         for( k=0; k<8; k++ ) {
             if( c & 1 ) {
-                c = 0xedb88320L ^ (c >> 1);
+                c = 0xedb88320U ^ (c >> 1);
                 }
             else {
                 c = c >> 1;
                 }
             }
-        mCRCTable[n] = c;
+        mCRCTable[0][n] = c;
+        }
+
+    // extra tables for processing 8 bytes at a time
+    // mCRCTable[k][n] is the CRC of byte n followed by k zero bytes
+    for( n=0; n<256; n++ ) {
+        c = mCRCTable[0][n];
+        for( k=1; k<8; k++ ) {
+            c = mCRCTable[0][ c & 0xff ] ^ ( c >> 8 );
+            mCRCTable[k][n] = c;
+            }
         }
     }
 
@@ -56,14 +86,42 @@ PNGImageConverter::PNGImageConverter( int inCompressionLevel )
 unsigned long PNGImageConverter::updateCRC(
     unsigned long inCRC, unsigned char *inData, int inLength ) {
 
+    // slicing-by-8:  8 table lookups per 8 bytes, with no dependency
+    // between them, instead of one dependent lookup per byte
+    // assembling words byte-by-byte keeps this endian-independent
+    
+    unsigned int c = (unsigned int)inCRC;
+    
+    while( inLength >= 8 ) {
+        unsigned int low = c ^ 
+            ( (unsigned int)inData[0] |
+              (unsigned int)inData[1] << 8 |
+              (unsigned int)inData[2] << 16 |
+              (unsigned int)inData[3] << 24 );
+        unsigned int high = 
+            (unsigned int)inData[4] |
+            (unsigned int)inData[5] << 8 |
+            (unsigned int)inData[6] << 16 |
+            (unsigned int)inData[7] << 24;
+        
+        c = 
+            mCRCTable[7][ low & 0xff ] ^
+            mCRCTable[6][ ( low >> 8 ) & 0xff ] ^
+            mCRCTable[5][ ( low >> 16 ) & 0xff ] ^
+            mCRCTable[4][ low >> 24 ] ^
+            mCRCTable[3][ high & 0xff ] ^
+            mCRCTable[2][ ( high >> 8 ) & 0xff ] ^
+            mCRCTable[1][ ( high >> 16 ) & 0xff ] ^
+            mCRCTable[0][ high >> 24 ];
+
+        inData += 8;
+        inLength -= 8;
+        }
+    
     // code taken from the PNG spec:
     // http://www.w3.org/TR/2003/REC-PNG-20031110/#D-CRCAppendix
-    
-    unsigned long c = inCRC;
-    int n;
-   
-    for( n=0; n<inLength; n++ ) {
-        c = mCRCTable[ (c ^ inData[n]) & 0xff ]
+    for( int n=0; n<inLength; n++ ) {
+        c = mCRCTable[0][ (c ^ inData[n]) & 0xff ]
             ^
             (c >> 8);
         }
@@ -75,28 +133,40 @@ unsigned long PNGImageConverter::updateCRC(
 #define ADLER_BASE 65521 /* largest prime smaller than 65536 */
 
 /**
- * Updates an adler32 checksum.
- * code found here  http://www.ietf.org/rfc/rfc1950.txt
+ * Combines the adler32 checksums of two pieces of data.
+ * adapted from zlib's adler32_combine
  *
- * New adlers should start with inAdler set to 1.
+ * @param inAdlerA the checksum of the first piece.
+ * @param inAdlerB the checksum of the second piece.
+ * @param inLengthB the length of the second piece in bytes.
  *
- * @param inAdler the current state of the checksum.
- * @param inData the data to add.  Destroyed by caller.
- * @param inLength the length of the data in bytes.
- *
- * @return the new checksum.
+ * @return the checksum of the two pieces, one after the other.
  */
-unsigned long updateAdler32( unsigned long inAdler,
-                             unsigned char *inData, int inLength ) {
-    unsigned long s1 = inAdler & 0xffff;
-    unsigned long s2 = (inAdler >> 16) & 0xffff;
-    int n;
-
-    for (n = 0; n < inLength; n++) {
-        s1 = (s1 + inData[n]) % ADLER_BASE;
-        s2 = (s2 + s1)     % ADLER_BASE;
+static unsigned long combineAdler32( unsigned long inAdlerA,
+                                     unsigned long inAdlerB,
+                                     unsigned long inLengthB ) {
+    unsigned long rem = inLengthB % ADLER_BASE;
+    unsigned long sum1 = inAdlerA & 0xffff;
+    unsigned long sum2 = ( rem * sum1 ) % ADLER_BASE;
+    
+    sum1 += ( inAdlerB & 0xffff ) + ADLER_BASE - 1;
+    sum2 += 
+        ( ( inAdlerA >> 16 ) & 0xffff ) + 
+        ( ( inAdlerB >> 16 ) & 0xffff ) + ADLER_BASE - rem;
+    
+    if( sum1 >= ADLER_BASE ) {
+        sum1 -= ADLER_BASE;
+        }
+    if( sum1 >= ADLER_BASE ) {
+        sum1 -= ADLER_BASE;
         }
-    return (s2 << 16) + s1;
+    if( sum2 >= ( ADLER_BASE << 1 ) ) {
+        sum2 -= ( ADLER_BASE << 1 );
+        }
+    if( sum2 >= ADLER_BASE ) {
+        sum2 -= ADLER_BASE;
+        }
+    return sum1 | ( sum2 << 16 );
     }
 
 
@@ -139,26 +209,6 @@ void PNGImageConverter::writeChunk(
 
 
 
-// callbacks for libpng io
-void libpngWriteCallback( png_structp png_ptr,
-                          png_bytep data, png_size_t length ) {
-    
-    // unpack our extra parameter
-    void *write_io_ptr = png_get_io_ptr( png_ptr );
-
-    OutputStream *inStream = (OutputStream *)write_io_ptr;    
-    
-    inStream->write( data, length );
-    }
-
-
-
-void libpngFlushCallback( png_structp png_ptr ) {
-    // do nothing?
-    }
-
-
-
 void PNGImageConverter::formatImage( Image *inImage, 
 	OutputStream *inStream ) {
 
@@ -172,173 +222,390 @@ void PNGImageConverter::formatImage( Image *inImage,
 		return;
 		}
 
-	int w = inImage->getWidth();
-	int h = inImage->getHeight();
-	
-    //RGBAImage rgbaImage( inImage );
-    
-    unsigned char *imageBytes = RGBAImage::getRGBABytes( inImage );
-
+    // 3-channel images are written as RGB, without alpha
+    PixelImage pixelImage( inImage );
     
+    formatPixelImage( &pixelImage, inStream );
+    }
 
-    // libpng implementation
-
-    // adapted from this:
-    //  http://zarb.org/~gc/html/libpng.html
 
 
-    // get pointers to rows
-    unsigned char **rows = new unsigned char *[h];
+static inline int paethPredictor( int inA, int inB, int inC ) {
+    // from the PNG spec
+    int p = inA + inB - inC;
+    int pa = abs( p - inA );
+    int pb = abs( p - inB );
+    int pc = abs( p - inC );
     
-    for( int y=0; y<h; y++ ) {
-        rows[y] = &( imageBytes[ y * (w * 4) ] );
+    if( pa <= pb && pa <= pc ) {
+        return inA;
+        }
+    if( pb <= pc ) {
+        return inB;
         }
+    return inC;
+    }
 
 
-    png_structp png_ptr;
-    png_infop info_ptr;
 
-	// initialize structures
-	png_ptr = png_create_write_struct( PNG_LIBPNG_VER_STRING, 
-                                       NULL, NULL, NULL );
-	if( !png_ptr ) {
-        delete [] imageBytes;
-        delete [] rows;
-        printf( "PNG Writing:  png_create_write_struct failed\n" );
-        return;
+// a filtered byte taken as a signed value, as libpng does it
+// smaller sums over a row usually compress better
+static inline int filterByteCost( unsigned char inByte ) {
+    if( inByte < 128 ) {
+        return inByte;
         }
-    
-    png_set_compression_level( png_ptr, mCompressionLevel );
-
+    return 256 - inByte;
+    }
 
-	info_ptr = png_create_info_struct( png_ptr );
-	
-    if( !info_ptr ) {
-        delete [] imageBytes;
-        delete [] rows;
-        png_destroy_write_struct( &png_ptr, NULL );
 
-        printf( "PNG Writing:  png_create_info_struct failed\n" );
-        return;
-        }
-    
-    // weird way that libpng handles errors with a jump
-	if( setjmp( png_jmpbuf( png_ptr ) ) ) {
-        delete [] imageBytes;
-        delete [] rows;
-        png_destroy_write_struct( &png_ptr, &info_ptr );
 
-        printf( "PNG Writing: error when setting writing funciton\n" );
-        return;
-        }
-    
+// how often to give up on a filter that is already worse than the best
+#define FILTER_COST_CHECK_BYTES 512
 
-	//png_init_io(png_ptr, fp);
 
 
-    // set our write callback (since we're not writing directly to file)
-    // pass the stream as the extra void* parameter
-    png_set_write_fn( png_ptr,
-                      (void*)inStream, 
-                      libpngWriteCallback,
-                      libpngFlushCallback );
+/**
+ * Filters one scanline, picking whichever of the five PNG filter types
+ * gives the lowest sum of filterByteCost.
+ *
+ * @param inRow the raw scanline, preceded by inBytesPerPixel zero bytes
+ *   (the pixel left of the row).
+ * @param inPreviousRow the raw scanline above, or a row of zeros,
+ *   also preceded by inBytesPerPixel zero bytes.
+ * @param inRowBytes the length of the scanline.
+ * @param inBytesPerPixel the filter distance, at least 1.
+ * @param inScratch space for inRowBytes + 1 bytes.
+ * @param outFiltered where to put the filter type byte and the
+ *   filtered scanline (inRowBytes + 1 bytes).
+ */
+static void filterRow( unsigned char *inRow, unsigned char *inPreviousRow,
+                       int inRowBytes, int inBytesPerPixel,
+                       unsigned char *inScratch,
+                       unsigned char *outFiltered ) {
     
+    int bpp = inBytesPerPixel;
+    int i;
+    
+    // type 0, none
+    outFiltered[0] = 0;
+    memcpy( &( outFiltered[1] ), inRow, inRowBytes );
 
-	// write header
-	if( setjmp( png_jmpbuf( png_ptr ) ) ) {
-        delete [] imageBytes;
-        delete [] rows;
-        png_destroy_write_struct( &png_ptr, &info_ptr );
-
-        printf( "PNG Writing: error writing header\n" );
-        return;
+    unsigned long bestCost = 0;
+    for( i=0; i<inRowBytes; i++ ) {
+        bestCost += filterByteCost( inRow[i] );
         }
+    
+    unsigned char *candidate = &( inScratch[1] );
+    
+    for( int type=1; type<=4; type++ ) {
+        unsigned long cost = 0;
+        
+        for( int start=0; 
+             start<inRowBytes && cost < bestCost; 
+             start += FILTER_COST_CHECK_BYTES ) {
+            
+            int end = start + FILTER_COST_CHECK_BYTES;
+            if( end > inRowBytes ) {
+                end = inRowBytes;
+                }
+            
+            unsigned char d;
+
+            switch( type ) {
+                case 1:
+                    // sub
+                    for( i=start; i<end; i++ ) {
+                        d = (unsigned char)( inRow[i] - inRow[i-bpp] );
+                        candidate[i] = d;
+                        cost += filterByteCost( d );
+                        }
+                    break;
+                case 2:
+                    // up
+                    for( i=start; i<end; i++ ) {
+                        d = (unsigned char)( inRow[i] - inPreviousRow[i] );
+                        candidate[i] = d;
+                        cost += filterByteCost( d );
+                        }
+                    break;
+                case 3:
+                    // average
+                    for( i=start; i<end; i++ ) {
+                        d = (unsigned char)( 
+                            inRow[i] - 
+                            ( ( inRow[i-bpp] + inPreviousRow[i] ) >> 1 ) );
+                        candidate[i] = d;
+                        cost += filterByteCost( d );
+                        }
+                    break;
+                case 4:
+                    // paeth
+                    for( i=start; i<end; i++ ) {
+                        d = (unsigned char)( 
+                            inRow[i] - 
+                            paethPredictor( inRow[i-bpp], 
+                                            inPreviousRow[i],
+                                            inPreviousRow[i-bpp] ) );
+                        candidate[i] = d;
+                        cost += filterByteCost( d );
+                        }
+                    break;
+                }
+            }
+        
+        if( cost < bestCost ) {
+            bestCost = cost;
+            inScratch[0] = (unsigned char)type;
+            
+            // best so far always kept in outFiltered
+            memcpy( outFiltered, inScratch, inRowBytes + 1 );
+            }
+        }
+    }
 
-	png_set_IHDR( png_ptr, info_ptr, w, h,
-                  8, PNG_COLOR_TYPE_RGB_ALPHA, PNG_INTERLACE_NONE,
-                  PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE );
 
-	png_write_info( png_ptr, info_ptr );
 
+static mz_bool appendToVector( const void *inBuffer, int inLength, 
+                               void *inVector ) {
+    ( (SimpleVector<unsigned char> *)inVector )->appendArray( 
+        (unsigned char *)inBuffer, inLength );
+    return MZ_TRUE;
+    }
 
-	// write bytes
-    // write header
-	if( setjmp( png_jmpbuf( png_ptr ) ) ) {
-        delete [] imageBytes;
-        delete [] rows;
-        png_destroy_write_struct( &png_ptr, &info_ptr );
 
-        printf( "PNG Writing: error writing image bytes\n" );
-        return;
-        }
 
-	png_write_image( png_ptr, rows );
+/**
+ * Filters and compresses a band of rows into a raw deflate stream.
+ *
+ * Bands are compressed independently, each ending on a byte boundary
+ * (a sync flush), so their streams can be joined end-to-end into one
+ * deflate stream.  Only the last band ends the stream.
+ */
+class PNGBandEncoder : public Thread {
+    public:
+        PNGBandEncoder( unsigned char *inSamples, int inRowBytes,
+                        int inBytesPerPixel, char inSwapBytes,
+                        int inStartRow, int inEndRow,
+                        char inLastBand, int inCompressionLevel )
+                : mAdler( 1 ), mNumRawBytes( 0 ),
+                  mSamples( inSamples ), mRowBytes( inRowBytes ),
+                  mBytesPerPixel( inBytesPerPixel ),
+                  mSwapBytes( inSwapBytes ),
+                  mStartRow( inStartRow ), mEndRow( inEndRow ),
+                  mLastBand( inLastBand ), 
+                  mCompressionLevel( inCompressionLevel ) {
+            }
+        
 
+        // can be called directly, or through start and join
+        virtual void run();
+        
+        
+        SimpleVector<unsigned char> mCompressed;
+        
+        // adler32 of this band's uncompressed (filtered) data
+        unsigned long mAdler;
+        unsigned long mNumRawBytes;
+        
+    protected:
+        unsigned char *mSamples;
+        int mRowBytes;
+        int mBytesPerPixel;
+        char mSwapBytes;
+        int mStartRow, mEndRow;
+        char mLastBand;
+        int mCompressionLevel;
 
-	// end write
-    if( setjmp( png_jmpbuf( png_ptr ) ) ) {
-        delete [] imageBytes;
-        delete [] rows;
-        png_destroy_write_struct( &png_ptr, &info_ptr );
+        
+        // gets a row in PNG byte order
+        void getRow( int inRow, unsigned char *outRow );
 
-        printf( "PNG Writing: error ending write\n" );
-        return;
-        }
+        // adds a stored (uncompressed) deflate block to mCompressed
+        void addStoredBlock( unsigned char *inData, int inLength,
+                             char inFinal );
+    };
 
-	png_write_end( png_ptr, NULL );
 
 
-    png_destroy_write_struct( &png_ptr, &info_ptr );
+void PNGBandEncoder::getRow( int inRow, unsigned char *outRow ) {
+    unsigned char *row = &( mSamples[ (long)inRow * mRowBytes ] );
     
-    delete [] imageBytes;
-    delete [] rows;
-    
-
-    if( true ) {
+    if( ! mSwapBytes ) {
+        memcpy( outRow, row, mRowBytes );
         return;
         }
     
+    for( int i=0; i<mRowBytes; i+=2 ) {
+        outRow[i] = row[i + 1];
+        outRow[i + 1] = row[i];
+        }
+    }
 
 
 
+void PNGBandEncoder::addStoredBlock( unsigned char *inData, int inLength,
+                                     char inFinal ) {
+    // block type 00, with the final bit
+    mCompressed.push_back( inFinal ? 1 : 0 );
+    
+    // length, then its complement, least significant byte first
+    mCompressed.push_back( inLength & 0xff );
+    mCompressed.push_back( ( inLength >> 8 ) & 0xff );
+    mCompressed.push_back( ~inLength & 0xff );
+    mCompressed.push_back( ( ~inLength >> 8 ) & 0xff );
 
+    mCompressed.appendArray( inData, inLength );
+    }
 
 
-    
-
 
+// the most a stored deflate block can hold
+#define MAX_STORED_BLOCK_BYTES 65535
 
 
-    /*
 
-    // LodePNG implementation
+void PNGBandEncoder::run() {
     
-    unsigned char *encodedBytes;
-    size_t encodedSize;
-
-    unsigned int error = LodePNG_encode32( &encodedBytes, &encodedSize, 
-                                           imageBytes, w, h );
+    // at level 0, skip miniz, which would still search for matches,
+    // and write stored blocks ourselves
+    char store = ( mCompressionLevel == 0 );
     
-    delete [] imageBytes;
+    tdefl_compressor *compressor = NULL;
+    unsigned char *storeBuffer = NULL;
+    int storeBytes = 0;
     
-    if( error ) {
-        delete [] encodedBytes;
+    if( store ) {
+        storeBuffer = new unsigned char[ MAX_STORED_BLOCK_BYTES ];
         
-        printf( "Error encoding PNG image\n" );
-        return;
+        long numRawBytes = (long)( mEndRow - mStartRow ) * ( mRowBytes + 1 );
+        mCompressed.reserve( mCompressed.size() + numRawBytes +
+                             ( numRawBytes / MAX_STORED_BLOCK_BYTES + 1 ) * 5 );
         }
+    else {
+        // tdefl_compressor is too big for the stack
+        compressor = new tdefl_compressor;
+        
+        // negative window bits for raw deflate, since the zlib header
+        // and checksum go around the joined bands
+        mz_uint flags = tdefl_create_comp_flags_from_zip_params( 
+            mCompressionLevel, -MZ_DEFAULT_WINDOW_BITS, MZ_DEFAULT_STRATEGY );
 
-    inStream->write( encodedBytes, encodedSize );
+        tdefl_init( compressor, appendToVector, &mCompressed, (int)flags );
+        }
+    
+    
+    // rows are preceded by one pixel of zeros for the filters
+    int bpp = mBytesPerPixel;
 
-    delete [] encodedBytes;
+    unsigned char *previousBuffer = new unsigned char[ bpp + mRowBytes ];
+    unsigned char *rowBuffer = new unsigned char[ bpp + mRowBytes ];
+    memset( previousBuffer, 0, bpp );
+    memset( rowBuffer, 0, bpp );
     
-    if( true ) {
-        return;
+    unsigned char *previousRow = &( previousBuffer[ bpp ] );
+    unsigned char *row = &( rowBuffer[ bpp ] );
+    
+    unsigned char *filtered = new unsigned char[ mRowBytes + 1 ];
+    unsigned char *scratch = new unsigned char[ mRowBytes + 1 ];
+    
+    if( mStartRow > 0 ) {
+        getRow( mStartRow - 1, previousRow );
+        }
+    else {
+        memset( previousRow, 0, mRowBytes );
+        }
+
+    for( int y=mStartRow; y<mEndRow; y++ ) {
+        getRow( y, row );
+        
+        if( ! store ) {
+            filterRow( row, previousRow, mRowBytes, bpp,
+                       scratch, filtered );
+            }
+        else {
+            // filters don't help stored data
+            filtered[0] = 0;
+            memcpy( &( filtered[1] ), row, mRowBytes );
+            }
+        
+        mAdler = mz_adler32( mAdler, filtered, mRowBytes + 1 );
+        mNumRawBytes += mRowBytes + 1;
+
+        if( store ) {
+            int used = 0;
+            while( used < mRowBytes + 1 ) {
+                int numToCopy = mRowBytes + 1 - used;
+                if( numToCopy > MAX_STORED_BLOCK_BYTES - storeBytes ) {
+                    numToCopy = MAX_STORED_BLOCK_BYTES - storeBytes;
+                    }
+                memcpy( &( storeBuffer[ storeBytes ] ), &( filtered[ used ] ),
+                        numToCopy );
+                storeBytes += numToCopy;
+                used += numToCopy;
+                
+                if( storeBytes == MAX_STORED_BLOCK_BYTES ) {
+                    addStoredBlock( storeBuffer, storeBytes, false );
+                    storeBytes = 0;
+                    }
+                }
+            }
+        else {
+            tdefl_compress_buffer( compressor, filtered, mRowBytes + 1,
+                                   TDEFL_NO_FLUSH );
+            }
+
+        unsigned char *temp = previousRow;
+        previousRow = row;
+        row = temp;
+        }
+
+    if( store ) {
+        // stored blocks end on byte boundaries already
+        // last band always ends with a final block, even if empty
+        if( storeBytes > 0 || mLastBand ) {
+            addStoredBlock( storeBuffer, storeBytes, mLastBand );
+            }
+        delete [] storeBuffer;
+        }
+    else {
+        if( mLastBand ) {
+            tdefl_compress_buffer( compressor, NULL, 0, TDEFL_FINISH );
+            }
+        else {
+            tdefl_compress_buffer( compressor, NULL, 0, TDEFL_SYNC_FLUSH );
+            }
+        delete compressor;
         }
     
-    */    
+    delete [] previousBuffer;
+    delete [] rowBuffer;
+    delete [] filtered;
+    delete [] scratch;
+    }
+
 
 
+// bands smaller than this aren't worth a thread
+#define MIN_PNG_BAND_BYTES 262144
+
+
+
+void PNGImageConverter::writeSamples( unsigned char *inSamples,
+                                      int inWidth, int inHeight,
+                                      int inNumChannels, int inBitDepth,
+                                      OutputStream *inStream ) {
+
+    int bytesPerPixel = inNumChannels * ( inBitDepth / 8 );
+    int rowBytes = inWidth * bytesPerPixel;
+
+    char swapBytes = false;
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+    if( inBitDepth == 16 ) {
+        // PNG stores 16-bit samples big-endian
+        swapBytes = true;
+        }
+#endif
+
 
     // same for all PNG images
     // used to check for basic transmission errors, such as line-end flipping
@@ -352,24 +619,40 @@ void PNGImageConverter::formatImage( Image *inImage,
     unsigned char headerData[13];
 
     // width
-    headerData[0] = (w >> 24) & 0xff;
-    headerData[1] = (w >> 16) & 0xff;
-    headerData[2] = (w >> 8) & 0xff;
-    headerData[3] = w & 0xff;
+    headerData[0] = (inWidth >> 24) & 0xff;
+    headerData[1] = (inWidth >> 16) & 0xff;
+    headerData[2] = (inWidth >> 8) & 0xff;
+    headerData[3] = inWidth & 0xff;
 
     // height
-    headerData[4] = (h >> 24) & 0xff;
-    headerData[5] = (h >> 16) & 0xff;
-    headerData[6] = (h >> 8) & 0xff;
-    headerData[7] = h & 0xff;
+    headerData[4] = (inHeight >> 24) & 0xff;
+    headerData[5] = (inHeight >> 16) & 0xff;
+    headerData[6] = (inHeight >> 8) & 0xff;
+    headerData[7] = inHeight & 0xff;
 
     // bit depth
-    headerData[8] = 8;
+    headerData[8] = (unsigned char)inBitDepth;
 
     // color type
-    // 2 = truecolor (RGB)
-    headerData[9] = 2;
-
+    switch( inNumChannels ) {
+        case 1:
+            // grayscale
+            headerData[9] = 0;
+            break;
+        case 2:
+            // grayscale with alpha
+            headerData[9] = 4;
+            break;
+        case 3:
+            // truecolor (RGB)
+            headerData[9] = 2;
+            break;
+        default:
+            // truecolor with alpha (RGBA)
+            headerData[9] = 6;
+            break;
+        }
+    
     // compression method
     // method 0  (deflate)
     headerData[10] = 0;
@@ -384,258 +667,141 @@ void PNGImageConverter::formatImage( Image *inImage,
     writeChunk( "IHDR", headerData, 13, inStream );
 
 
-    int numRawBytes = w * h * 3;
-    // extra byte per scanline for filter type
-    numRawBytes += h;
-
-    unsigned char *rawScanlineBytes = new unsigned char[ numRawBytes ];
+    // split rows into bands to compress in parallel
+    long numRawBytes = (long)inHeight * ( rowBytes + 1 );
 
-    // ignore alpha channel
-    double *channels[3];
-    int i;
-    for( i=0; i<3; i++ ) {
-        channels[i] = inImage->getChannel( i );
+    int numBands = mNumThreads;
+    
+    if( numBands > numRawBytes / MIN_PNG_BAND_BYTES ) {
+        numBands = numRawBytes / MIN_PNG_BAND_BYTES;
         }
-
-    int pixelNumber = 0;
-    for( int y=0; y<h; y++ ) {
-        // each scanline starts with filter type byte
-        // using filter type 0 (no filtering)
-
-        int index = y * ( w * 3 + 1 );
-
-        // filter type
-        rawScanlineBytes[ index ] = 0;
-
-        index++;
-
-        for( int x=0; x<w; x++ ) {
-
-            for( i=0; i<3; i++ ) {
-                rawScanlineBytes[ index ] =
-                    (unsigned char)( lrint( 255 * channels[i][pixelNumber] ) );
-
-                index ++;
-                }
-
-            pixelNumber++;
-            }        
+    if( numBands > inHeight ) {
+        numBands = inHeight;
+        }
+    if( numBands < 1 ) {
+        numBands = 1;
         }
 
+    // the zlib stream is the data of the IDAT chunks, one chunk per band
 
-    // zlib block contains
-    // zlib compression method  (1 byte)
-    // flags  (1 byte)
-    // compressed data blocks
-    // check value (4 bytes) (not CRC)
-
-    SimpleVector<unsigned char> zlibBlock;
-
+    // zlib header
     // compression method 8 (deflate)
     // with a LZ77 window size parameter of w=7
     // LZ77 window size is then 2^( w + 8 ), or in this case 32768
-    zlibBlock.push_back( 0x78 );
-
+    unsigned char cmf = 0x78;
+    
     // flags
-    // compression level 0  (2 bytes = 00b)
+    // compression level hint in top 2 bits (0 fastest to 3 best)
     // no preset dictionary (1 byte = 0b)
     // check bits for compression method (5 bits)
     //   Should be such that if the 8-bit compression method, followed
     //   by the 8-bit flags field, is viewed as a 16-bit number,
     //   it is an even multiple of 31
-    //   For our settings, check bits of 00001 works
-    //zlibBlock.push_back( 0x01 );
-    // hack:  mimic zlib here
-    zlibBlock.push_back( 0xda );
-
-    
-    // now ready for compressed data blocks
-
-    int rawDataIndex = 0;
+    int levelHint = 2;
+    if( mCompressionLevel < 2 ) {
+        levelHint = 0;
+        }
+    else if( mCompressionLevel < 6 ) {
+        levelHint = 1;
+        }
+    else if( mCompressionLevel > 6 ) {
+        levelHint = 3;
+        }
+    unsigned char flg = (unsigned char)( levelHint << 6 );
+    flg += ( 31 - ( ( cmf * 256 + flg ) % 31 ) ) % 31;
 
-    // length field is 16 bits
-    int maxUncompressedBlockLength = 65535;
+    PNGBandEncoder **bands = new PNGBandEncoder*[ numBands ];
     
-    while( rawDataIndex < numRawBytes ) {
-
-        // push another deflate block
-
-        // first bit BFINAL
-        //   only 1 for final block
-        // next two bits BTYPE
-        //   BTYPE=00 is an uncompressed block
-        // remaining 5 bits ignored
-        // Thus, we put 0x00 for uncompressed blocks that are not final
-        // and 0x80 for final uncompressed block
-
-        
-        int bytesLeft = numRawBytes - rawDataIndex;
-
-        int bytesInBlock;
+    for( int b=0; b<numBands; b++ ) {
+        int startRow = ( inHeight * (long)b ) / numBands;
+        int endRow = ( inHeight * (long)( b + 1 ) ) / numBands;
         
-        if( bytesLeft <= maxUncompressedBlockLength ) {
-            // final
-
-            // hack:  when comparing output with zlib, noticed that it doesn't
-            // set 0x80 for the final block, instead it uses 0x01
-            // For some reason, this was making the PNG unreadable
-            // zlibBlock.push_back( 0x80 );
-            zlibBlock.push_back( 0x01 );
-
-            bytesInBlock = bytesLeft;
-            }
-        else {
-            // not final
-            zlibBlock.push_back( 0x00 );
-            
-            bytesInBlock = maxUncompressedBlockLength;
-            }
-
-        // length in least-significant-byte-first order
-        unsigned char firstLengthByte = bytesInBlock & 0xff;
-        unsigned char secondLengthByte = (bytesInBlock >> 8) & 0xff;
-        zlibBlock.push_back( firstLengthByte );
-        zlibBlock.push_back( secondLengthByte );
-
-        // those same length bytes inverted
-        // (called "one's compliment" in the spec
-        zlibBlock.push_back( firstLengthByte ^ 0xff);
-        zlibBlock.push_back( secondLengthByte ^ 0xff );
-
-        // now the uncompressed data
-
-        for( int b=0; b< bytesInBlock; b++ ) {
-            zlibBlock.push_back( rawScanlineBytes[ rawDataIndex ] );
-
-            rawDataIndex++;
-            }
+        bands[b] = new PNGBandEncoder( inSamples, rowBytes, bytesPerPixel,
+                                       swapBytes,
+                                       startRow, endRow,
+                                       ( b == numBands - 1 ),
+                                       mCompressionLevel );
         }
-    
-
-    // finally, adler32 of original data
-    unsigned long adler = updateAdler32( 1L, rawScanlineBytes, numRawBytes );
-    
-    zlibBlock.push_back( (adler >> 24) & 0xff );
-    zlibBlock.push_back( (adler >> 16) & 0xff );
-    zlibBlock.push_back( (adler >> 8) & 0xff );
-    zlibBlock.push_back( adler & 0xff );
-    
-
-    // the zlib block is now complete
-
-
-
-    
-    /*
-    // check against real zlib implementation
-    z_stream zStream;
 
-    zStream.next_in = rawScanlineBytes;
-    zStream.avail_in = numRawBytes;
-    zStream.total_in = 0;
+    // zlib header goes in front of the first band
+    bands[0]->mCompressed.push_back( cmf );
+    bands[0]->mCompressed.push_back( flg );
     
-    int outSize = 2 * numRawBytes + 100;
-    unsigned char *zlibOutBuffer = new unsigned char[ outSize ]; 
-    zStream.next_out = zlibOutBuffer;
-    zStream.avail_out = outSize;
-    zStream.total_out = 0;
-
-    zStream.data_type = Z_BINARY;
-
-    zStream.zalloc = Z_NULL;
-    zStream.zfree = Z_NULL;
-
-    // init the stream
-    // no compression
-    int result;
-    //result = deflateInit( &zStream, Z_DEFAULT_COMPRESSION);
-    result = deflateInit( &zStream, Z_NO_COMPRESSION);
-
-    if( result != Z_OK ) {
-        printf( "zlib deflateInit error: %s\n", zStream.msg );
+    // first band on this thread
+    for( int b=1; b<numBands; b++ ) {
+        bands[b]->start();
         }
-
-    
-    // deflate and flush
-    result = deflate( &zStream, Z_FINISH );
-
-    if( result != Z_STREAM_END ) {
-        printf( "zlib deflate error (%d): %s\n", result, zStream.msg );
+    bands[0]->run();
+    for( int b=1; b<numBands; b++ ) {
+        bands[b]->join();
         }
-    printf( "Total in = %d, total out = %d\n",
-            zStream.total_in, zStream.total_out );
-    
     
 
+    unsigned long adler = 1;
     
-    printf( "Our raw bytes (%d):\n", numRawBytes );
-    int b;
-    for( b=0; b<numRawBytes; b++ ) {
-        printf( "%02x ", rawScanlineBytes[ b ] );
-        }
-    
-    printf( "\n\nOur zlib bytes (%d) (adler = %d) :\n",
-            zlibBlock.size(), adler );
-    
-    for( b=0; b<zlibBlock.size(); b++ ) {
-        printf( "%02x ", *( zlibBlock.getElement( b ) ) );
-        }
+    for( int b=0; b<numBands; b++ ) {
+        SimpleVector<unsigned char> *data = &( bands[b]->mCompressed );
 
-
-    printf( "\n\nTheir zlib bytes (%d) (adler = %d) :\n",
-            (int)( zStream.total_out ), zStream.adler );
-    for( b=0; b<zStream.total_out; b++ ) {
-        printf( "%02x ", zlibOutBuffer[ b ] );
-        }
-
-    int minBytes = zStream.total_out;
-    if( minBytes > zlibBlock.size() ) {
-        minBytes = zlibBlock.size();
-        }
-
-    for( b=0; b<minBytes; b++ ) {
-        if( zlibOutBuffer[b] != *( zlibBlock.getElement( b ) ) ) {
-            printf( "mismatch at byte %d\n", b );
-            printf( "Theirs: %02x, ours: %02x\n", zlibOutBuffer[b],
-                    *( zlibBlock.getElement( b ) ) );
+        adler = combineAdler32( adler, bands[b]->mAdler, 
+                                bands[b]->mNumRawBytes );
+        
+        if( b == numBands - 1 ) {
+            // adler32 of all uncompressed data, big-endian
+            data->push_back( (adler >> 24) & 0xff );
+            data->push_back( (adler >> 16) & 0xff );
+            data->push_back( (adler >> 8) & 0xff );
+            data->push_back( adler & 0xff );
             }
-        }
-
-    
-    printf( "\n\n" );
-    
+        
+        writeChunk( "IDAT", data->getElementFast( 0 ), data->size(), 
+                    inStream );
 
+        delete bands[b];
+        }
+    delete [] bands;
     
-    
-    delete [] zlibOutBuffer;
-    result = deflateEnd( &zStream );
+    // no data in end chunk
+    writeChunk( "IEND", NULL, 0, inStream );
+    }
 
-    if( result != Z_OK ) {
-        printf( "zlib deflateEnd error (%d): %s\n", result, zStream.msg );
-        }
 
-    */    
-    
 
-    
-    // the zlib block is the data of an IDAT chunk
+void PNGImageConverter::formatPixelImage( PixelImage *inImage, 
+                                          OutputStream *inStream ) {
 
-    unsigned char *zlibBytes = zlibBlock.getElementArray();
+    int numChannels = inImage->getNumChannels();
 
-    writeChunk( "IDAT", zlibBytes, zlibBlock.size(), inStream );
+    if( numChannels < 1 || numChannels > 4 ) {
+		printf( "Only 1- to 4-channel images can be converted to " );
+		printf( "the PNG format.\n" );
+		return;
+		}
     
+    // float samples are written as 16-bit to keep precision
+    PixelSampleType type = PIXEL_UINT8;
+    int bitDepth = 8;
+
+    if( inImage->getSampleType() != PIXEL_UINT8 ) {
+        type = PIXEL_UINT16;
+        bitDepth = 16;
+        }
     
-    delete [] zlibBytes;
+    PixelImage *converted = NULL;
     
-    // no data in end chunk
-    writeChunk( "IEND", NULL, 0, inStream );
-
+    if( inImage->getSampleType() != type ||
+        inImage->getLayout() != PIXEL_INTERLEAVED ) {
+        converted = inImage->convert( type, PIXEL_INTERLEAVED );
+        inImage = converted;
+        }
 
-    delete [] rawScanlineBytes;
+    writeSamples( inImage->getBytes(), 
+                  inImage->getWidth(), inImage->getHeight(),
+                  numChannels, bitDepth, inStream );
 
-    
-    // done
-	}
+    if( converted != NULL ) {
+        delete converted;
+        }
+    }
 
 
 
@@ -655,7 +821,8 @@ void libpngReadCallback( png_structp png_ptr,
 
 
 
-Image *PNGImageConverter::deformatImage( InputStream *inStream ) {
+PixelImage *PNGImageConverter::readSamples( InputStream *inStream,
+                                            char inKeep16 ) {
 
     unsigned char header[8];
     
@@ -722,11 +889,23 @@ Image *PNGImageConverter::deformatImage( InputStream *inStream ) {
     if( color_type == PNG_COLOR_TYPE_RGB || 
         color_type == PNG_COLOR_TYPE_GRAY ||
         color_type == PNG_COLOR_TYPE_PALETTE ) {
-        png_set_add_alpha( png_ptr, 0xFF, PNG_FILLER_AFTER );
+        if( bit_depth == 16 && inKeep16 ) {
+            png_set_add_alpha( png_ptr, 0xFFFF, PNG_FILLER_AFTER );
+            }
+        else {
+            png_set_add_alpha( png_ptr, 0xFF, PNG_FILLER_AFTER );
+            }
         }
     
     if( bit_depth == 16 ) {
-        png_set_strip_16( png_ptr );
+        if( inKeep16 ) {
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+            png_set_swap( png_ptr );
+#endif
+            }
+        else {
+            png_set_strip_16( png_ptr );
+            }
         }
     
     if( bit_depth < 8 ) {
@@ -740,19 +919,27 @@ Image *PNGImageConverter::deformatImage( InputStream *inStream ) {
     
     png_bytep *rowPtrs = new png_bytep[ h ];
     
-    // libpng converting it to 8-bit-per-channel RGBA
-    unsigned char *raster = new unsigned char[ w * h * 4 ];
+    // libpng converting it to 8- or 16-bit-per-channel RGBA
+    PixelSampleType type = PIXEL_UINT8;
+    int bytesPerSample = 1;
+    
+    if( bit_depth == 16 && inKeep16 ) {
+        type = PIXEL_UINT16;
+        bytesPerSample = 2;
+        }
     
-    memset( raster, 0, w * h * 4 );
+    PixelImage *image = new PixelImage( w, h, 4, type, PIXEL_INTERLEAVED );
     
+    unsigned char *raster = image->getBytes();
+
     for( int y=0; y<h; y++ ) {
         
-        rowPtrs[y] = (png_bytep) &raster[ y * w * 4 ];
+        rowPtrs[y] = (png_bytep) &raster[ y * w * 4 * bytesPerSample ];
         }
     
     
     if( setjmp( png_jmpbuf( png_ptr ) ) ) {
-        delete [] raster;
+        delete image;
         delete [] rowPtrs;
         png_destroy_read_struct( &png_ptr, &info_ptr, NULL );
 
@@ -766,6 +953,26 @@ Image *PNGImageConverter::deformatImage( InputStream *inStream ) {
     png_destroy_read_struct( &png_ptr, &info_ptr, NULL );
     
 
+    delete [] rowPtrs;
+
+    return image;
+    }
+
+
+
+Image *PNGImageConverter::deformatImage( InputStream *inStream ) {
+
+    PixelImage *pixelImage = readSamples( inStream, false );
+
+    if( pixelImage == NULL ) {
+        return NULL;
+        }
+
+    int w = pixelImage->getWidth();
+    int h = pixelImage->getHeight();
+    
+    unsigned char *raster = pixelImage->getBytes();
+
     Image *image = new Image( w, h, 4, false );
 
 	double *red = image->getChannel( 0 );
@@ -788,8 +995,13 @@ Image *PNGImageConverter::deformatImage( InputStream *inStream ) {
         alpha[i] = inv255 * raster[ rasterIndex ++ ];
         }
     
-    delete [] raster;
-    delete [] rowPtrs;
+    delete pixelImage;
 
     return image;
 	}
+
+
+
+PixelImage *PNGImageConverter::deformatPixelImage( InputStream *inStream ) {
+    return readSamples( inStream, true );
+    }
@@ -20,8 +20,8 @@
 /**
  * PNG implementation of the image conversion interface.
  *
- * Note that it only supports 32-bit PNG files
- * (3-channel Images are given a solid alpha channel).
+ * Images are written with our own encoder, using the deflate from
+ * the bundled miniz, and read with libpng.
  *
  * @author Jason Rohrer
  */
@@ -37,7 +37,12 @@ class PNGImageConverter : public BigEndianImageConverter {
         // 3 to 6 are supposed to be "nearly as good" as 7-9, but "much faster"
         //
         // Defaults to 5.
-        PNGImageConverter( int inCompressionLevel=5 );
+        //
+        // Large images can be compressed with several threads, each
+        // taking a band of rows.  Each band starts compressing with an
+        // empty dictionary, so files get slightly larger with more
+        // threads.  Defaults to 1.
+        PNGImageConverter( int inCompressionLevel=5, int inNumThreads=1 );
         
         
         
@@ -48,9 +53,19 @@ class PNGImageConverter : public BigEndianImageConverter {
 		virtual Image *deformatImage( InputStream *inStream );		
 
 
+        // 1- to 4-channel images are written as gray, gray-alpha, RGB,
+        // or RGBA, with 16-bit samples for 16-bit and float images
+        virtual void formatPixelImage( PixelImage *inImage, 
+                                       OutputStream *inStream );
+
+        // returns 8-bit interleaved RGBA, or 16-bit for 16-bit PNG files
+        virtual PixelImage *deformatPixelImage( InputStream *inStream );
+
+
     protected:
         
         int mCompressionLevel;
+        int mNumThreads;
         
 
         /**
@@ -68,8 +83,10 @@ class PNGImageConverter : public BigEndianImageConverter {
 
 
         
-        // precomputed CRCs for all 8-bit messages
-        unsigned long mCRCTable[256];
+        // precomputed CRCs for all 8-bit messages in mCRCTable[0],
+        // and for each 8-bit message followed by k zero bytes in
+        // mCRCTable[k], for updating 8 bytes at a time
+        unsigned int mCRCTable[8][256];
 
 
         const static unsigned long mStartCRC = 0xffffffffL;
@@ -93,6 +110,33 @@ class PNGImageConverter : public BigEndianImageConverter {
         unsigned long updateCRC( unsigned long inCRC, unsigned char *inData,
                                  int inLength );
 
+
+
+        /**
+         * Writes interleaved samples as a PNG file, with a row filter
+         * picked for each row.
+         *
+         * @param inSamples the samples, with 16-bit samples in native
+         *   byte order.  Destroyed by caller.
+         * @param inNumChannels 1 to 4, for gray, gray-alpha, RGB,
+         *   or RGBA.
+         * @param inBitDepth 8 or 16.
+         */
+        void writeSamples( unsigned char *inSamples,
+                           int inWidth, int inHeight, int inNumChannels,
+                           int inBitDepth, OutputStream *inStream );
+
+
+        /**
+         * Reads an image with libpng, expanded to 4-channel RGBA.
+         *
+         * @param inKeep16 true to keep 16-bit samples from 16-bit
+         *   files, or false to reduce them to 8 bits.
+         *
+         * @return the image, or NULL on failure.
+         */
+        PixelImage *readSamples( InputStream *inStream, char inKeep16 );
+
 	};
 
 
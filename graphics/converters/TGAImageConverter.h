@@ -51,6 +51,22 @@ class TGAImageConverter : public LittleEndianImageConverter {
 
 		virtual RawRGBAImage *deformatImageRaw( InputStream *inStream );
 
+
+        // reads and writes 8-bit samples without going through Image
+        // 3- and 4-channel images only
+        // deformatted images are 8-bit interleaved RGB(A)
+        virtual void formatPixelImage( PixelImage *inImage, 
+                                       OutputStream *inStream );
+        
+        virtual PixelImage *deformatPixelImage( InputStream *inStream );
+
+
+    protected:
+
+        // writes a header for an uncompressed, top-origin image
+        void writeHeader( long inWidth, long inHeight, int inNumChannels,
+                          OutputStream *inStream );
+
 	};
 
 
@@ -73,7 +89,56 @@ inline void TGAImageConverter::formatImage( Image *inImage,
 	
 	long numPixels = width * height;
 
+    writeHeader( width, height, numChannels, inStream );
+    
+
+	// now we write the pixels, in BGR(A) order
+	unsigned char *raster = new unsigned char[ numPixels * numChannels ];
+	double *red = inImage->getChannel( 0 );
+	double *green = inImage->getChannel( 1 );
+	double *blue = inImage->getChannel( 2 );
+
+	long rasterIndex = 0;
 	
+	if( numChannels == 3 ) {
+		for( int i=0; i<numPixels; i++ ) {
+			raster[rasterIndex] = 
+				(unsigned char)( lrint( 255 * blue[i] ) );
+			raster[rasterIndex + 1] = 
+				(unsigned char)( lrint( 255 * green[i] ) );
+			raster[rasterIndex + 2] = 
+				(unsigned char)( lrint( 255 * red[i] ) );
+		
+			rasterIndex += 3;
+			}
+		}
+	else {  // numChannels == 4
+		double *alpha = inImage->getChannel( 3 );
+		
+		for( int i=0; i<numPixels; i++ ) {
+			raster[rasterIndex] = 
+				(unsigned char)( lrint( 255 * blue[i] ) );
+			raster[rasterIndex + 1] = 
+				(unsigned char)( lrint( 255 * green[i] ) );
+			raster[rasterIndex + 2] = 
+				(unsigned char)( lrint( 255 * red[i] ) );
+			raster[rasterIndex + 3] = 
+				(unsigned char)( lrint( 255 * alpha[i] ) );
+		
+			rasterIndex += 4;
+			}
+		}
+
+	inStream->write( raster, numPixels * numChannels );
+	
+	delete [] raster;
+	}
+
+
+
+inline void TGAImageConverter::writeHeader( long inWidth, long inHeight,
+                                            int inNumChannels,
+                                            OutputStream *inStream ) {
 	// a buffer for writing single bytes
 	unsigned char *byteBuffer = new unsigned char[1];
 
@@ -109,11 +174,11 @@ inline void TGAImageConverter::formatImage( Image *inImage,
 	// y origin coordinate
 	writeLittleEndianShort( 0, inStream );
 	
-	writeLittleEndianShort( width, inStream );
-	writeLittleEndianShort( height, inStream );
+	writeLittleEndianShort( inWidth, inStream );
+	writeLittleEndianShort( inHeight, inStream );
 
 	// number of bits in pixels
-	if( numChannels == 3 ) {
+	if( inNumChannels == 3 ) {
 		byteBuffer[0] = 24;
 		}
 	else {
@@ -123,7 +188,7 @@ inline void TGAImageConverter::formatImage( Image *inImage,
 
 	
 	// image descriptor byte
-	if( numChannels == 3 ) {
+	if( inNumChannels == 3 ) {
 		// setting to 0 specifies:
 		// -- no attributes per pixel (for 24-bit)
 		// -- screen origin in lower left corner
@@ -149,49 +214,82 @@ inline void TGAImageConverter::formatImage( Image *inImage,
 	// We also skip the color map data,
 	// since we have none (as specified above).
 
+	delete [] byteBuffer;
+	}
 
-	// now we write the pixels, in BGR(A) order
-	unsigned char *raster = new unsigned char[ numPixels * numChannels ];
-	double *red = inImage->getChannel( 0 );
-	double *green = inImage->getChannel( 1 );
-	double *blue = inImage->getChannel( 2 );
 
-	long rasterIndex = 0;
+
+inline void TGAImageConverter::formatPixelImage( PixelImage *inImage, 
+                                                 OutputStream *inStream ) {
+
+	int numChannels = inImage->getNumChannels();
 	
-	if( numChannels == 3 ) {
-		for( int i=0; i<numPixels; i++ ) {
-			raster[rasterIndex] = 
-				(unsigned char)( lrint( 255 * blue[i] ) );
-			raster[rasterIndex + 1] = 
-				(unsigned char)( lrint( 255 * green[i] ) );
-			raster[rasterIndex + 2] = 
-				(unsigned char)( lrint( 255 * red[i] ) );
-		
-			rasterIndex += 3;
-			}
-		}
-	else {  // numChannels == 4
-		double *alpha = inImage->getChannel( 3 );
-		
-		for( int i=0; i<numPixels; i++ ) {
-			raster[rasterIndex] = 
-				(unsigned char)( lrint( 255 * blue[i] ) );
-			raster[rasterIndex + 1] = 
-				(unsigned char)( lrint( 255 * green[i] ) );
-			raster[rasterIndex + 2] = 
-				(unsigned char)( lrint( 255 * red[i] ) );
-			raster[rasterIndex + 3] = 
-				(unsigned char)( lrint( 255 * alpha[i] ) );
-		
-			rasterIndex += 4;
-			}
+	if( numChannels != 3 &&
+		numChannels != 4 ) {
+		printf( "Only 3- and 4-channel images can be converted to " );
+		printf( "the TGA format.\n" );
+		return;
 		}
 
-	inStream->write( raster, numPixels * numChannels );
-	
+    PixelImage *converted = NULL;
+    
+    if( inImage->getSampleType() != PIXEL_UINT8 ||
+        inImage->getLayout() != PIXEL_INTERLEAVED ) {
+        converted = inImage->convert( PIXEL_UINT8, PIXEL_INTERLEAVED );
+        inImage = converted;
+        }
+    
+    long width = inImage->getWidth();
+	long height = inImage->getHeight();
+
+    writeHeader( width, height, numChannels, inStream );
+
+    
+    // swap RGB(A) to BGR(A)
+    int numBytes = inImage->getNumBytes();
+    unsigned char *rgb = inImage->getBytes();
+	unsigned char *raster = new unsigned char[ numBytes ];
+    
+    for( int b=0; b<numBytes; b+=numChannels ) {
+        raster[b] = rgb[b + 2];
+        raster[b + 1] = rgb[b + 1];
+        raster[b + 2] = rgb[b];
+        if( numChannels == 4 ) {
+            raster[b + 3] = rgb[b + 3];
+            }
+        }
+
+	inStream->write( raster, numBytes );
+
 	delete [] raster;
-	delete [] byteBuffer;
-	}
+    
+    if( converted != NULL ) {
+        delete converted;
+        }
+    }
+
+
+
+inline PixelImage *TGAImageConverter::deformatPixelImage( 
+    InputStream *inStream ) {
+
+	RawRGBAImage *rawImage = deformatImageRaw( inStream );
+	
+    if( rawImage == NULL ) {
+        return NULL;
+        }
+
+    // take raw bytes, no conversion needed
+    PixelImage *image = new PixelImage( rawImage->mRGBABytes,
+                                        rawImage->mWidth,
+                                        rawImage->mHeight,
+                                        rawImage->mNumChannels );
+    rawImage->mRGBABytes = NULL;
+    
+    delete rawImage;
+
+    return image;
+    }
 
 
 
@@ -0,0 +1,296 @@
+// Times PNG encoding of a sequence of 1920x1080 frames, like the ones
+// written by screenshots and frame dumps, at several compression levels
+// and thread counts, against libpng's encoder.
+//
+// Also compares byte-at-a-time CRC against PNGImageConverter's 8-at-a-time
+// CRC, and checks that every encoded frame decodes back to the original.
+
+
+#include "PNGImageConverter.h"
+
+#include "minorGems/util/ByteBufferInputStream.h"
+#include "minorGems/util/StringBufferOutputStream.h"
+
+#include "minorGems/system/Time.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <png.h>
+
+
+
+static int width = 1920;
+static int height = 1080;
+static int numFrames = 8;
+
+static int numFailed = 0;
+
+
+
+// a game-like frame:  flat background, gradients, and some noise,
+// scrolling a little from frame to frame
+static PixelImage *makeFrame( int inFrame ) {
+    PixelImage *image = new PixelImage( width, height, 4 );
+
+    unsigned char *bytes = image->getBytes();
+
+    unsigned int seed = 1234 + inFrame;
+
+    int i = 0;
+    for( int y=0; y<height; y++ ) {
+        for( int x=0; x<width; x++ ) {
+            int sx = x + inFrame * 7;
+
+            unsigned char r, g, b;
+
+            if( y < height / 3 ) {
+                // sky gradient
+                r = (unsigned char)( 80 + y / 8 );
+                g = (unsigned char)( 120 + y / 6 );
+                b = 230;
+                }
+            else if( ( ( sx / 64 ) + ( y / 64 ) ) % 5 == 0 ) {
+                // tiles
+                r = (unsigned char)( 128 + ( sx & 63 ) );
+                g = (unsigned char)( 100 + ( y & 63 ) );
+                b = 40;
+                }
+            else {
+                // noisy ground
+                seed = seed * 1103515245 + 12345;
+                int noise = ( seed >> 16 ) & 15;
+                r = (unsigned char)( 90 + noise );
+                g = (unsigned char)( 70 + noise );
+                b = (unsigned char)( 30 + noise );
+                }
+
+            bytes[i++] = r;
+            bytes[i++] = g;
+            bytes[i++] = b;
+            bytes[i++] = 255;
+            }
+        }
+    return image;
+    }
+
+
+
+static void libpngWriteCallback( png_structp inPNG, png_bytep inData,
+                                 png_size_t inLength ) {
+    OutputStream *stream = (OutputStream *)png_get_io_ptr( inPNG );
+    stream->write( inData, inLength );
+    }
+
+
+static void libpngFlushCallback( png_structp inPNG ) {
+    }
+
+
+
+// libpng with its default row filter choice, as PNGImageConverter
+// used to write images
+static void libpngEncode( PixelImage *inImage, int inCompressionLevel,
+                          OutputStream *inStream ) {
+    png_structp png = png_create_write_struct( PNG_LIBPNG_VER_STRING,
+                                               NULL, NULL, NULL );
+    png_infop info = png_create_info_struct( png );
+
+    png_set_write_fn( png, inStream, libpngWriteCallback,
+                      libpngFlushCallback );
+    png_set_compression_level( png, inCompressionLevel );
+
+    png_set_IHDR( png, info, inImage->getWidth(), inImage->getHeight(),
+                  8, PNG_COLOR_TYPE_RGB_ALPHA, PNG_INTERLACE_NONE,
+                  PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT );
+    png_write_info( png, info );
+
+    int rowBytes = inImage->getWidth() * 4;
+    for( int y=0; y<inImage->getHeight(); y++ ) {
+        png_write_row( png, &( inImage->getBytes()[ y * rowBytes ] ) );
+        }
+    png_write_end( png, NULL );
+    png_destroy_write_struct( &png, &info );
+    }
+
+
+
+static char decodesTo( PNGImageConverter *inConverter,
+                       unsigned char *inBytes, int inLength,
+                       PixelImage *inImage ) {
+    ByteBufferInputStream in( inBytes, inLength );
+    PixelImage *decoded = inConverter->deformatPixelImage( &in );
+
+    char same =
+        decoded != NULL &&
+        decoded->getNumBytes() == inImage->getNumBytes() &&
+        memcmp( decoded->getBytes(), inImage->getBytes(),
+                inImage->getNumBytes() ) == 0;
+
+    if( decoded != NULL ) {
+        delete decoded;
+        }
+    return same;
+    }
+
+
+
+static void timeEncoder( PixelImage **inFrames, int inLevel,
+                         int inNumThreads ) {
+    PNGImageConverter converter( inLevel, inNumThreads );
+
+    long totalBytes = 0;
+    double totalTime = 0;
+
+    for( int f=0; f<numFrames; f++ ) {
+        StringBufferOutputStream out;
+
+        double t = Time::getCurrentTime();
+
+        if( inNumThreads == 0 ) {
+            libpngEncode( inFrames[f], inLevel, &out );
+            }
+        else {
+            converter.formatPixelImage( inFrames[f], &out );
+            }
+        totalTime += Time::getCurrentTime() - t;
+
+        int length;
+        unsigned char *bytes = out.getBytes( &length );
+        totalBytes += length;
+
+        if( ! decodesTo( &converter, bytes, length, inFrames[f] ) ) {
+            printf( "FAILED:  frame %d did not decode\n", f );
+            numFailed++;
+            }
+        delete [] bytes;
+        }
+
+    if( inNumThreads == 0 ) {
+        printf( "  libpng,     level %d:  ", inLevel );
+        }
+    else {
+        printf( "  %d thread%s,  level %d:  ", inNumThreads,
+                ( inNumThreads == 1 ) ? " " : "s", inLevel );
+        }
+    printf( "%.1f ms/frame, %.2f MB/frame\n",
+            1000 * totalTime / numFrames,
+            totalBytes / ( numFrames * 1048576.0 ) );
+    }
+
+
+
+// CRC one byte at a time, as PNGImageConverter used to
+class ByteCRC {
+    public:
+        ByteCRC() {
+            for( int n=0; n<256; n++ ) {
+                unsigned long c = (unsigned long)n;
+                for( int k=0; k<8; k++ ) {
+                    if( c & 1 ) {
+                        c = 0xedb88320L ^ (c >> 1);
+                        }
+                    else {
+                        c = c >> 1;
+                        }
+                    }
+                mTable[n] = c;
+                }
+            }
+
+        unsigned long update( unsigned long inCRC, unsigned char *inData,
+                              int inLength ) {
+            unsigned long c = inCRC;
+            for( int n=0; n<inLength; n++ ) {
+                c = mTable[ (c ^ inData[n]) & 0xff ] ^ (c >> 8);
+                }
+            return c;
+            }
+
+    protected:
+        unsigned long mTable[256];
+    };
+
+
+
+// exposes the converter's CRC
+class CRCConverter : public PNGImageConverter {
+    public:
+        unsigned long update( unsigned long inCRC, unsigned char *inData,
+                              int inLength ) {
+            return updateCRC( inCRC, inData, inLength );
+            }
+    };
+
+
+
+static void timeCRC( PixelImage *inFrame ) {
+    ByteCRC byteCRC;
+    CRCConverter sliceCRC;
+
+    int length = inFrame->getNumBytes();
+    unsigned char *data = inFrame->getBytes();
+
+    int reps = 10;
+
+    double t = Time::getCurrentTime();
+    unsigned long a = 0;
+    for( int r=0; r<reps; r++ ) {
+        a = byteCRC.update( 0xffffffffL, data, length );
+        }
+    double byteTime = Time::getCurrentTime() - t;
+
+    t = Time::getCurrentTime();
+    unsigned long b = 0;
+    for( int r=0; r<reps; r++ ) {
+        // odd length to cover the leftover bytes
+        b = sliceCRC.update( 0xffffffffL, data, length - 3 );
+        b = sliceCRC.update( b, &( data[ length - 3 ] ), 3 );
+        }
+    double sliceTime = Time::getCurrentTime() - t;
+
+    if( a != b ) {
+        printf( "FAILED:  CRCs differ\n" );
+        numFailed++;
+        }
+
+    double mb = reps * length / 1048576.0;
+    printf( "  byte at a time:   %.0f MB/s\n", mb / byteTime );
+    printf( "  8 at a time:      %.0f MB/s\n", mb / sliceTime );
+    }
+
+
+
+int main() {
+
+    PixelImage **frames = new PixelImage*[ numFrames ];
+    for( int f=0; f<numFrames; f++ ) {
+        frames[f] = makeFrame( f );
+        }
+
+    printf( "%d %dx%d RGBA frames:\n", numFrames, width, height );
+
+    int levels[4] = { 0, 1, 5, 9 };
+
+    for( int i=0; i<4; i++ ) {
+        timeEncoder( frames, levels[i], 0 );
+        timeEncoder( frames, levels[i], 1 );
+        timeEncoder( frames, levels[i], 2 );
+        timeEncoder( frames, levels[i], 4 );
+        }
+
+    printf( "\nCRC32 of one frame:\n" );
+    timeCRC( frames[0] );
+
+    for( int f=0; f<numFrames; f++ ) {
+        delete frames[f];
+        }
+    delete [] frames;
+
+    if( numFailed == 0 ) {
+        printf( "\nAll frames decoded\n" );
+        return 0;
+        }
+    return 1;
+    }
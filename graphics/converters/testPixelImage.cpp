@@ -0,0 +1,401 @@
+// Checks PixelImage conversions, typed filters, PixelImageView, and
+// PixelImage reading and writing in the TGA, PNG, and JPEG converters,
+// and compares time and memory against the Image paths.
+
+
+#include "TGAImageConverter.h"
+#include "PNGImageConverter.h"
+#include "JPEGImageConverter.h"
+
+#include "minorGems/graphics/Image.h"
+#include "minorGems/graphics/PixelImage.h"
+#include "minorGems/graphics/PixelImageView.h"
+#include "minorGems/graphics/filters/InvertFilter.h"
+#include "minorGems/graphics/filters/ThresholdFilter.h"
+#include "minorGems/graphics/filters/BoxBlurFilter.h"
+
+#include "minorGems/util/ByteBufferInputStream.h"
+#include "minorGems/util/StringBufferOutputStream.h"
+
+#include "minorGems/system/Time.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+
+static int numFailed = 0;
+
+static void check( char inCondition, const char *inDescription ) {
+    if( ! inCondition ) {
+        printf( "FAILED:  %s\n", inDescription );
+        numFailed++;
+        }
+    }
+
+
+
+static PixelImage *makeTestImage( int inSize, int inNumChannels ) {
+    PixelImage *image = new PixelImage( inSize, inSize, inNumChannels );
+
+    unsigned char *bytes = image->getBytes();
+
+    int i = 0;
+    for( int y=0; y<inSize; y++ ) {
+        for( int x=0; x<inSize; x++ ) {
+            for( int c=0; c<inNumChannels; c++ ) {
+                bytes[i++] = (unsigned char)( ( x * ( c + 1 ) + y ) & 0xFF );
+                }
+            }
+        }
+    return image;
+    }
+
+
+
+static char sameSamples( PixelImage *inA, PixelImage *inB ) {
+    return inA->getNumBytes() == inB->getNumBytes() &&
+        memcmp( inA->getBytes(), inB->getBytes(), inA->getNumBytes() ) == 0;
+    }
+
+
+
+static unsigned char *formatToBytes( ImageConverter *inConverter,
+                                     PixelImage *inImage, int *outLength ) {
+    StringBufferOutputStream out;
+    inConverter->formatPixelImage( inImage, &out );
+    return out.getBytes( outLength );
+    }
+
+
+
+static void testConversions() {
+    PixelImage *image = makeTestImage( 64, 4 );
+
+    // 8 -> 16 -> float -> planar 8 -> interleaved 8 is lossless
+    PixelImage *shorts = image->convert( PIXEL_UINT16, PIXEL_INTERLEAVED );
+    PixelImage *floats = shorts->convert( PIXEL_FLOAT, PIXEL_PLANAR );
+    PixelImage *planar = floats->convert( PIXEL_UINT8, PIXEL_PLANAR );
+    PixelImage *back = planar->convert( PIXEL_UINT8, PIXEL_INTERLEAVED );
+
+    check( sameSamples( image, back ), "round trip through sample types" );
+
+    check( planar->getBytes()[ 64 * 64 + 5 ] == image->getBytes()[ 5 * 4 + 1 ],
+           "planar layout" );
+
+    check( shorts->getShorts()[1] == image->getBytes()[1] * 257,
+           "8 to 16 bit scaling" );
+
+    // Image round trip matches the old converters' rounding
+    Image *legacy = image->toImage();
+    PixelImage fromLegacy( legacy );
+    check( sameSamples( image, &fromLegacy ), "round trip through Image" );
+
+    check( legacy->getChannel( 2 )[7] == image->getSample( 7, 2 ),
+           "getSample matches Image" );
+
+    delete legacy;
+    delete back;
+    delete planar;
+    delete floats;
+    delete shorts;
+    delete image;
+    }
+
+
+
+static void testFilters() {
+    PixelImage *image = makeTestImage( 64, 4 );
+    Image *legacy = image->toImage();
+
+    // typed overrides
+    InvertFilter invert;
+    image->filter( &invert, 1 );
+    legacy->filter( &invert, 1 );
+
+    ThresholdFilter threshold( 0.3 );
+    image->filter( &threshold, 2 );
+    legacy->filter( &threshold, 2 );
+
+    // default path, through doubles
+    BoxBlurFilter blur( 2 );
+    image->filter( &blur, 0 );
+    legacy->filter( &blur, 0 );
+
+    PixelImage fromLegacy( legacy );
+    check( sameSamples( image, &fromLegacy ),
+           "typed filters match Image filters" );
+
+    // planar float image
+    PixelImage *floats = image->convert( PIXEL_FLOAT, PIXEL_PLANAR );
+    floats->filter( &invert, 3 );
+    check( floats->getFloats()[ 3 * 64 * 64 ] ==
+           1.0f - image->getBytes()[3] / 255.0f,
+           "float planar invert" );
+
+    delete floats;
+    delete legacy;
+    delete image;
+    }
+
+
+
+static void testView() {
+    PixelImage *image = makeTestImage( 64, 4 );
+    PixelImage *original = image->copy();
+
+    PixelImageView view( image );
+
+    check( view.getWidth() == 64 && view.getNumChannels() == 4,
+           "view dimensions" );
+
+    double *green = view.getChannel( 1 );
+    check( green[3] == image->getBytes()[ 3 * 4 + 1 ] / 255.0,
+           "view channel values" );
+
+    // Image functions see loaded channels
+    Image *sub = view.getSubImage( 8, 8, 16, 16 );
+    check( sub->getChannel( 3 )[0] == image->getSample( 8 * 64 + 8, 3 ),
+           "view sub image" );
+    delete sub;
+
+    for( int i=0; i<64*64; i++ ) {
+        green[i] = 1.0 - green[i];
+        }
+
+    check( sameSamples( image, original ), "no change before commit" );
+
+    view.commit();
+
+    check( image->getBytes()[ 5 * 4 + 1 ] ==
+           255 - original->getBytes()[ 5 * 4 + 1 ],
+           "commit writes changes back" );
+    check( image->getBytes()[ 5 * 4 + 2 ] ==
+           original->getBytes()[ 5 * 4 + 2 ],
+           "commit leaves other channels alone" );
+
+    delete original;
+    delete image;
+    }
+
+
+
+static void testConverters() {
+    PixelImage *image = makeTestImage( 64, 4 );
+    Image *legacy = image->toImage();
+
+    TGAImageConverter tga;
+    PNGImageConverter png;
+
+    int length, legacyLength;
+
+    // TGA writes the same file either way, and reads it back
+    unsigned char *bytes = formatToBytes( &tga, image, &length );
+
+    StringBufferOutputStream legacyOut;
+    tga.formatImage( legacy, &legacyOut );
+    unsigned char *legacyBytes = legacyOut.getBytes( &legacyLength );
+
+    check( length == legacyLength &&
+           memcmp( bytes, legacyBytes, length ) == 0,
+           "TGA output matches formatImage" );
+    delete [] legacyBytes;
+
+    ByteBufferInputStream tgaIn( bytes, length );
+    PixelImage *tgaImage = tga.deformatPixelImage( &tgaIn );
+    check( tgaImage != NULL && sameSamples( image, tgaImage ),
+           "TGA round trip" );
+    delete tgaImage;
+    delete [] bytes;
+
+
+    // PNG, 8-bit
+    bytes = formatToBytes( &png, image, &length );
+    ByteBufferInputStream pngIn( bytes, length );
+    PixelImage *pngImage = png.deformatPixelImage( &pngIn );
+    check( pngImage != NULL && sameSamples( image, pngImage ),
+           "PNG round trip" );
+    delete pngImage;
+    delete [] bytes;
+
+
+    // PNG, 16-bit samples survive
+    PixelImage *shorts = image->convert( PIXEL_UINT16, PIXEL_PLANAR );
+    shorts->getShorts()[0] = 12345;
+
+    bytes = formatToBytes( &png, shorts, &length );
+    ByteBufferInputStream png16In( bytes, length );
+    pngImage = png.deformatPixelImage( &png16In );
+    check( pngImage != NULL &&
+           pngImage->getSampleType() == PIXEL_UINT16 &&
+           pngImage->getShorts()[0] == 12345 &&
+           pngImage->getShorts()[5] == image->getBytes()[5] * 257,
+           "16-bit PNG round trip" );
+    delete pngImage;
+
+    // and old reader still strips them to 8 bits
+    ByteBufferInputStream png16LegacyIn( bytes, length );
+    Image *pngLegacy = png.deformatImage( &png16LegacyIn );
+    check( pngLegacy != NULL &&
+           pngLegacy->getChannel( 0 )[5] == image->getSample( 5, 0 ),
+           "16-bit PNG through deformatImage" );
+    delete pngLegacy;
+    delete [] bytes;
+    delete shorts;
+
+
+    // PNG compressed in bands by several threads, stored and deflated,
+    // 8- and 16-bit, RGBA and gray
+    PixelImage *big = makeTestImage( 512, 4 );
+    PixelImage *bigGray = makeTestImage( 512, 1 );
+    PixelImage *bigShorts = big->convert( PIXEL_UINT16, PIXEL_INTERLEAVED );
+
+    PixelImage *bigImages[3] = { big, bigGray, bigShorts };
+
+    for( int level=0; level<=9; level+=9 ) {
+        PNGImageConverter threadedPNG( level, 3 );
+
+        for( int i=0; i<3; i++ ) {
+            bytes = formatToBytes( &threadedPNG, bigImages[i], &length );
+            ByteBufferInputStream threadedIn( bytes, length );
+            pngImage = threadedPNG.deformatPixelImage( &threadedIn );
+
+            PixelImage *expected = bigImages[i];
+            if( bigImages[i] == bigGray ) {
+                // reader expands gray to RGBA
+                Image *grayImage = bigGray->toImage();
+                Image *rgbaImage = new Image( 512, 512, 4, false );
+                for( int c=0; c<3; c++ ) {
+                    rgbaImage->pasteChannel( grayImage->getChannel( 0 ), c );
+                    }
+                for( int p=0; p<512*512; p++ ) {
+                    rgbaImage->getChannel( 3 )[p] = 1.0;
+                    }
+                expected = new PixelImage( rgbaImage );
+                delete rgbaImage;
+                delete grayImage;
+                }
+
+            check( pngImage != NULL && sameSamples( expected, pngImage ),
+                   "threaded PNG round trip" );
+
+            if( expected != bigImages[i] ) {
+                delete expected;
+                }
+            if( pngImage != NULL ) {
+                delete pngImage;
+                }
+            delete [] bytes;
+            }
+        }
+    delete bigShorts;
+    delete bigGray;
+    delete big;
+
+
+    // JPEG is lossy, check that it comes back close
+    JPEGImageConverter jpeg( 95 );
+    PixelImage *rgb = new PixelImage( 64, 64, 3 );
+    for( int p=0; p<64*64; p++ ) {
+        for( int c=0; c<3; c++ ) {
+            rgb->getBytes()[ p * 3 + c ] = image->getBytes()[ p * 4 + c ];
+            }
+        }
+    bytes = formatToBytes( &jpeg, rgb, &length );
+    ByteBufferInputStream jpegIn( bytes, length );
+    PixelImage *jpegImage = jpeg.deformatPixelImage( &jpegIn );
+
+    check( jpegImage != NULL && jpegImage->getNumChannels() == 3,
+           "JPEG round trip" );
+    if( jpegImage != NULL ) {
+        double totalError = 0;
+        for( int i=0; i<rgb->getNumBytes(); i++ ) {
+            totalError +=
+                fabs( (double)rgb->getBytes()[i] - jpegImage->getBytes()[i] );
+            }
+        check( totalError / rgb->getNumBytes() < 4, "JPEG error" );
+        delete jpegImage;
+        }
+    delete [] bytes;
+    delete rgb;
+
+    delete legacy;
+    delete image;
+    }
+
+
+
+static void timeConverter( const char *inName, ImageConverter *inConverter,
+                           PixelImage *inImage ) {
+    int length;
+    unsigned char *bytes = formatToBytes( inConverter, inImage, &length );
+
+    double t = Time::getCurrentTime();
+    ByteBufferInputStream in( bytes, length );
+    Image *image = inConverter->deformatImage( &in );
+    double imageTime = Time::getCurrentTime() - t;
+    long imageBytes = image->getWidth() * image->getHeight() *
+        image->getNumChannels() * sizeof( double );
+
+    t = Time::getCurrentTime();
+    ByteBufferInputStream pixelIn( bytes, length );
+    PixelImage *pixelImage = inConverter->deformatPixelImage( &pixelIn );
+    double pixelTime = Time::getCurrentTime() - t;
+
+    printf( "%s read:   Image %.3f s (%ld MB),  PixelImage %.3f s (%d MB)\n",
+            inName, imageTime, imageBytes >> 20,
+            pixelTime, pixelImage->getNumBytes() >> 20 );
+
+
+    StringBufferOutputStream imageOut;
+    t = Time::getCurrentTime();
+    inConverter->formatImage( image, &imageOut );
+    imageTime = Time::getCurrentTime() - t;
+
+    StringBufferOutputStream pixelOut;
+    t = Time::getCurrentTime();
+    inConverter->formatPixelImage( pixelImage, &pixelOut );
+    pixelTime = Time::getCurrentTime() - t;
+
+    printf( "%s write:  Image %.3f s,  PixelImage %.3f s\n",
+            inName, imageTime, pixelTime );
+
+    delete pixelImage;
+    delete image;
+    delete [] bytes;
+    }
+
+
+
+int main() {
+
+    testConversions();
+    testFilters();
+    testView();
+    testConverters();
+
+
+    int size = 2048;
+
+    PixelImage *rgba = makeTestImage( size, 4 );
+    PixelImage *rgb = makeTestImage( size, 3 );
+
+    TGAImageConverter tga;
+    PNGImageConverter png( 1 );
+    JPEGImageConverter jpeg( 90 );
+
+    printf( "\n%dx%d images:\n", size, size );
+    timeConverter( "TGA ", &tga, rgba );
+    timeConverter( "PNG ", &png, rgba );
+    timeConverter( "JPEG", &jpeg, rgb );
+
+    delete rgb;
+    delete rgba;
+
+
+    if( numFailed == 0 ) {
+        printf( "\nAll tests passed\n" );
+        return 0;
+        }
+    return 1;
+    }
@@ -22,6 +22,13 @@ class InvertFilter : public ChannelFilter {
 		
 		// implements the ChannelFilter interface
 		void apply( double *inChannel, int inWidth, int inHeight );
+
+        void applyBytes( unsigned char *inChannel, int inStride,
+                         int inWidth, int inHeight );
+        void applyShorts( unsigned short *inChannel, int inStride,
+                          int inWidth, int inHeight );
+        void applyFloats( float *inChannel, int inStride,
+                          int inWidth, int inHeight );
 	};
 	
 	
@@ -34,5 +41,36 @@ inline void InvertFilter::apply( double *inChannel,
 		inChannel[i] = 1.0 - inChannel[i];
 		}
 	}
+
+
+
+inline void InvertFilter::applyBytes( unsigned char *inChannel, int inStride,
+                                      int inWidth, int inHeight ) {
+    int numSamples = inWidth * inHeight * inStride;
+    for( int i=0; i<numSamples; i+=inStride ) {
+        inChannel[i] = (unsigned char)( 255 - inChannel[i] );
+        }
+    }
+
+
+
+inline void InvertFilter::applyShorts( unsigned short *inChannel, 
+                                       int inStride,
+                                       int inWidth, int inHeight ) {
+    int numSamples = inWidth * inHeight * inStride;
+    for( int i=0; i<numSamples; i+=inStride ) {
+        inChannel[i] = (unsigned short)( 65535 - inChannel[i] );
+        }
+    }
+
+
+
+inline void InvertFilter::applyFloats( float *inChannel, int inStride,
+                                       int inWidth, int inHeight ) {
+    int numSamples = inWidth * inHeight * inStride;
+    for( int i=0; i<numSamples; i+=inStride ) {
+        inChannel[i] = 1.0f - inChannel[i];
+        }
+    }
 	
 #endif
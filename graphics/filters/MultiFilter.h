@@ -50,6 +50,15 @@ class MultiFilter : public ChannelFilter {
 		
 		// implements the ChannelFilter interface
 		void apply( double *inChannel, int inWidth, int inHeight );
+
+        // passed on to each filter, so filters that handle samples
+        // directly don't go through doubles
+        void applyBytes( unsigned char *inChannel, int inStride,
+                         int inWidth, int inHeight );
+        void applyShorts( unsigned short *inChannel, int inStride,
+                          int inWidth, int inHeight );
+        void applyFloats( float *inChannel, int inStride,
+                          int inWidth, int inHeight );
 	
 	
 	private:
@@ -81,6 +90,40 @@ inline void MultiFilter::apply( double *inChannel,
 		thisFilter->apply( inChannel, inWidth, inHeight );
 		}
 	}
+
+
+
+inline void MultiFilter::applyBytes( unsigned char *inChannel, int inStride,
+                                     int inWidth, int inHeight ) {
+	int numFilters = mFilterVector->size();
+	for( int i=0; i<numFilters; i++ ) {
+		ChannelFilter *thisFilter = *( mFilterVector->getElement( i ) );
+		thisFilter->applyBytes( inChannel, inStride, inWidth, inHeight );
+		}
+	}
+
+
+
+inline void MultiFilter::applyShorts( unsigned short *inChannel, 
+                                      int inStride,
+                                      int inWidth, int inHeight ) {
+	int numFilters = mFilterVector->size();
+	for( int i=0; i<numFilters; i++ ) {
+		ChannelFilter *thisFilter = *( mFilterVector->getElement( i ) );
+		thisFilter->applyShorts( inChannel, inStride, inWidth, inHeight );
+		}
+	}
+
+
+
+inline void MultiFilter::applyFloats( float *inChannel, int inStride,
+                                      int inWidth, int inHeight ) {
+	int numFilters = mFilterVector->size();
+	for( int i=0; i<numFilters; i++ ) {
+		ChannelFilter *thisFilter = *( mFilterVector->getElement( i ) );
+		thisFilter->applyFloats( inChannel, inStride, inWidth, inHeight );
+		}
+	}
 	
 	
 	
@@ -43,6 +43,13 @@ class ThresholdFilter : public ChannelFilter {
 		// implements the ChannelFilter interface
 		void apply( double *inChannel, int inWidth, int inHeight );
 
+        void applyBytes( unsigned char *inChannel, int inStride,
+                         int inWidth, int inHeight );
+        void applyShorts( unsigned short *inChannel, int inStride,
+                          int inWidth, int inHeight );
+        void applyFloats( float *inChannel, int inStride,
+                          int inWidth, int inHeight );
+
 	private:
 		double mThreshold;
 	};
@@ -75,5 +82,61 @@ inline void ThresholdFilter::apply( double *inChannel,
 			}
 		}
 	}
+
+
+
+inline void ThresholdFilter::applyBytes( unsigned char *inChannel, 
+                                         int inStride,
+                                         int inWidth, int inHeight ) {
+    // same comparison as apply makes, once per byte value
+    unsigned char table[256];
+    double inv255 = 1.0 / 255.0;
+    for( int v=0; v<256; v++ ) {
+        if( inv255 * v >= mThreshold ) {
+            table[v] = 255;
+            }
+        else {
+            table[v] = 0;
+            }
+        }
+
+    int numSamples = inWidth * inHeight * inStride;
+    for( int i=0; i<numSamples; i+=inStride ) {
+        inChannel[i] = table[ inChannel[i] ];
+        }
+    }
+
+
+
+inline void ThresholdFilter::applyShorts( unsigned short *inChannel, 
+                                          int inStride,
+                                          int inWidth, int inHeight ) {
+    double inv65535 = 1.0 / 65535.0;
+
+    int numSamples = inWidth * inHeight * inStride;
+    for( int i=0; i<numSamples; i+=inStride ) {
+        if( inv65535 * inChannel[i] >= mThreshold ) {
+            inChannel[i] = 65535;
+            }
+        else {
+            inChannel[i] = 0;
+            }
+        }
+    }
+
+
+
+inline void ThresholdFilter::applyFloats( float *inChannel, int inStride,
+                                          int inWidth, int inHeight ) {
+    int numSamples = inWidth * inHeight * inStride;
+    for( int i=0; i<numSamples; i+=inStride ) {
+        if( inChannel[i] >= mThreshold ) {
+            inChannel[i] = 1.0f;
+            }
+        else {
+            inChannel[i] = 0.0f;
+            }
+        }
+    }
 	
 #endif
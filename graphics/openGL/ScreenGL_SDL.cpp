@@ -159,6 +159,8 @@
 #include "minorGems/system/Time.h"
 #include "minorGems/system/Thread.h"
 
+#include "minorGems/util/development/zoneProfiler/ZoneProfiler.h"
+
 #include "minorGems/crypto/hashes/sha1.h"
 #include "minorGems/formats/encodingUtils.h"
 
@@ -1674,6 +1676,8 @@ void ScreenGL::start() {
     // can be negative (add to next sleep)
     int oversleepMSec = 0;
 
+    PROFILE_THREAD_NAME( "main" );
+
 
     // FOVMOD NOTE:  Change 2/3 - Take these lines during the merge process
     timeSec_t frameStartSec;
@@ -1686,6 +1690,8 @@ void ScreenGL::start() {
     // main loop
     while( true ) {
         
+        PROFILE_FRAME_MARK();
+
         oldFrameStart = frameStartMSec;
         
         Time::getCurrentTime( &frameStartSec, &frameStartMSec );
@@ -2154,11 +2160,14 @@ void ScreenGL::start() {
             frameTime = 0;
             }
         
+        PROFILE_COUNTER( "frameMS", frameTime );
         
         if( mUseFrameSleep ) {    
             // lock down to mMaxFrameRate frames per second
             int minFrameTime = 1000 / mMaxFrameRate;
             if( ( frameTime + oversleepMSec ) < minFrameTime ) {
+                PROFILE_ZONE( "frameSleep" );
+
                 int timeToSleep = 
                     minFrameTime - ( frameTime + oversleepMSec );
                 
@@ -2898,6 +2907,8 @@ void callbackMouse( int inButton, int inState, int inX, int inY ) {
 	
 	
 void callbackPreDisplay() {
+    PROFILE_ZONE( "preDisplay" );
+
 	ScreenGL *s = currentScreenGL;
 	
 	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
@@ -2916,6 +2927,8 @@ void callbackPreDisplay() {
 
 
 void callbackDisplay() {
+    PROFILE_ZONE( "display" );
+
     ScreenGL *s = currentScreenGL;
 
 	if( ! s->m2DMode ) {    
@@ -83,11 +83,15 @@ class SingleTextureGL {
 
 		/**
 		 * Specifies texture data as rgba bytes.
+         *
+         * inExpandEdge can be set to false for bytes that have already
+         * been through expandEdges.
 		 */
 		SingleTextureGL( unsigned char *inRGBA, 
                          unsigned int inWidth, unsigned int inHeight,
                          char inRepeat = true,
-                         char inMipMap = false );
+                         char inMipMap = false,
+                         char inExpandEdge = true );
 
         
         /**
@@ -121,6 +125,32 @@ class SingleTextureGL {
                                  char inAlphaOnly,
                                  unsigned int inWidth, 
                                  unsigned int inHeight );
+
+
+        /**
+         * Replaces a rectangle of data in a texture that's already been set.
+         * Rectangle must fit inside texture.
+         *
+         * Data must have the same format (RGBA or Alpha-only) as the 
+         * texture's existing data.
+         */
+        void replaceTextureSubData( unsigned char *inBytes,
+                                    unsigned int inX, unsigned int inY,
+                                    unsigned int inWidth, 
+                                    unsigned int inHeight );
+
+
+        /**
+         * Gets a copy of a rectangle of this texture's data, taken from
+         * the backup kept in case of context changes.
+         * Rectangle must fit inside texture.
+         *
+         * @return RGBA or Alpha-only bytes, matching texture's format.
+         *   Destroyed by caller.
+         */
+        unsigned char *getTextureSubData( unsigned int inX, unsigned int inY,
+                                          unsigned int inWidth, 
+                                          unsigned int inHeight );
         
 
 		
@@ -160,6 +190,15 @@ class SingleTextureGL {
                              unsigned int inHeight,
                              char inExpandEdge = false );        
 
+
+        /**
+         * Repeats edge pixels of RGBA bytes in place, as done by 
+         * setTextureData when inExpandEdge is true.
+         */
+        static void expandEdges( unsigned char *inBytes,
+                                 unsigned int inWidth, 
+                                 unsigned int inHeight );
+
 		
         // FOVMOD NOTE:  Change 1/1 - Take these lines during the merge process
         void setWrapping ( char inHorizontal,
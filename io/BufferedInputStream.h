@@ -0,0 +1,344 @@
+#include "minorGems/common.h"
+
+
+#ifndef BUFFERED_INPUT_STREAM_CLASS_INCLUDED
+#define BUFFERED_INPUT_STREAM_CLASS_INCLUDED
+
+#include "minorGems/io/InputStream.h"
+
+#include "minorGems/util/SimpleVector.h"
+
+#include <string.h>
+
+
+
+/**
+ * An input stream that reads another stream in large chunks.
+ *
+ * Small reads (like readByte, readLong, and readShort) are served from
+ * the buffer, so parsing a stream field by field doesn't cost one
+ * underlying read (one system call, for files and sockets) per field.
+ *
+ * The buffer is refilled with readAvailable, so a socket stream is
+ * never asked to wait for more data than a caller has asked for.
+ */
+class BufferedInputStream : public InputStream {
+
+	public:
+
+		/**
+		 * Constructs a buffered stream.
+		 *
+		 * @param inStream the stream to read from.
+		 *   inStream is NOT destroyed when this stream is destroyed.
+         * @param inBufferSize the buffer size in bytes.  Defaults to 4096.
+		 */
+		BufferedInputStream( InputStream *inStream,
+                             int inBufferSize = 4096 );
+
+        ~BufferedInputStream();
+
+
+
+        // implements the InputStream interface
+        // waits for all inNumBytes, or until the underlying stream
+        // fails or ends, returning the bytes read so far (or the
+        // underlying error code if none were read)
+		virtual long read( unsigned char *inBuffer, long inNumBytes );
+
+        // overrides InputStream::readAvailable
+        // returns buffered bytes, or refills buffer once if it is empty
+        virtual long readAvailable( unsigned char *inBuffer,
+                                    long inNumBytes );
+
+
+
+        /**
+         * Looks at upcoming bytes without consuming them.
+         *
+         * @param inBuffer the buffer where bytes will be put.
+         * @param inNumBytes the number of bytes to look at.  Must not
+         *   be larger than the buffer size.
+         *
+         * @return the number of bytes put in inBuffer, which can be fewer
+         *   than inNumBytes if the stream failed or ended, or the
+         *   underlying error code if none are available.
+         */
+        long peek( unsigned char *inBuffer, long inNumBytes );
+
+
+
+        /**
+         * Reads a line of text.
+         *
+         * @param inMaxLength the maximum number of characters to read
+         *   before returning a partial line.  Defaults to 65536.
+         *
+         * @return the line, without its \n or \r\n ending,
+         *   or NULL if stream failed or ended before any characters
+         *   were read.  Destroyed by caller.
+         */
+        char *readLine( int inMaxLength = 65536 );
+
+
+
+        /**
+         * Gets the number of bytes that can be read without touching
+         * the underlying stream.
+         */
+        int getNumBuffered();
+
+
+
+    private:
+        InputStream *mStream;
+
+        unsigned char *mBuffer;
+        int mBufferSize;
+
+        // buffered bytes are mBuffer[ mStart ] through mBuffer[ mEnd - 1 ]
+        int mStart;
+        int mEnd;
+
+
+        // reads more into buffer, making room at the end first
+        // returns number of bytes added, or underlying error code
+        long fill();
+
+        // copies underlying error to this stream, if there is one
+        void takeError();
+    };
+
+
+
+inline BufferedInputStream::BufferedInputStream( InputStream *inStream,
+                                                 int inBufferSize )
+        : mStream( inStream ),
+          mBuffer( new unsigned char[ inBufferSize ] ),
+          mBufferSize( inBufferSize ),
+          mStart( 0 ),
+          mEnd( 0 ) {
+    }
+
+
+
+inline BufferedInputStream::~BufferedInputStream() {
+    delete [] mBuffer;
+    }
+
+
+
+inline void BufferedInputStream::takeError() {
+    char *error = mStream->getLastError();
+
+    if( error != NULL ) {
+        setNewLastError( error );
+        }
+    }
+
+
+
+inline long BufferedInputStream::fill() {
+    // never negative, but checking lets the compiler see that the
+    // memmove length fits
+    int numBuffered = mEnd - mStart;
+
+    if( numBuffered <= 0 ) {
+        mStart = 0;
+        mEnd = 0;
+        }
+    else if( mStart > 0 ) {
+        // slide to front, so the underlying read gets all the room
+        memmove( mBuffer, &( mBuffer[ mStart ] ), (size_t)numBuffered );
+        mEnd = numBuffered;
+        mStart = 0;
+        }
+
+    long numRead = mStream->readAvailable( &( mBuffer[ mEnd ] ),
+                                           mBufferSize - mEnd );
+
+    if( numRead > 0 ) {
+        mEnd += numRead;
+        }
+    else {
+        takeError();
+        }
+
+    return numRead;
+    }
+
+
+
+inline long BufferedInputStream::read( unsigned char *inBuffer,
+                                       long inNumBytes ) {
+    long numCopied = 0;
+
+    while( numCopied < inNumBytes ) {
+
+        int numBuffered = mEnd - mStart;
+
+        if( numBuffered > 0 ) {
+            long numToCopy = inNumBytes - numCopied;
+
+            if( numToCopy > numBuffered ) {
+                numToCopy = numBuffered;
+                }
+
+            memcpy( &( inBuffer[ numCopied ] ), &( mBuffer[ mStart ] ),
+                    numToCopy );
+
+            mStart += numToCopy;
+            numCopied += numToCopy;
+            }
+        else if( inNumBytes - numCopied >= mBufferSize ) {
+            // too big to be worth buffering, read straight into caller's
+            // buffer
+            long numWanted = inNumBytes - numCopied;
+            
+            long numRead = mStream->read( &( inBuffer[ numCopied ] ),
+                                          numWanted );
+            if( numRead <= 0 ) {
+                takeError();
+
+                if( numCopied == 0 ) {
+                    return numRead;
+                    }
+                return numCopied;
+                }
+            
+            numCopied += numRead;
+
+            if( numRead < numWanted ) {
+                // underlying stream ended or returned what it had
+                takeError();
+                return numCopied;
+                }
+            }
+        else {
+            long numRead = fill();
+
+            if( numRead <= 0 ) {
+                if( numCopied == 0 ) {
+                    return numRead;
+                    }
+                return numCopied;
+                }
+            }
+        }
+
+    return numCopied;
+    }
+
+
+
+inline long BufferedInputStream::readAvailable( unsigned char *inBuffer,
+                                                long inNumBytes ) {
+    if( mStart == mEnd ) {
+        long numRead = fill();
+
+        if( numRead <= 0 ) {
+            return numRead;
+            }
+        }
+
+    long numToCopy = mEnd - mStart;
+
+    if( numToCopy > inNumBytes ) {
+        numToCopy = inNumBytes;
+        }
+
+    memcpy( inBuffer, &( mBuffer[ mStart ] ), numToCopy );
+    mStart += numToCopy;
+
+    return numToCopy;
+    }
+
+
+
+inline long BufferedInputStream::peek( unsigned char *inBuffer,
+                                       long inNumBytes ) {
+    if( inNumBytes > mBufferSize ) {
+        inNumBytes = mBufferSize;
+        }
+
+    while( mEnd - mStart < inNumBytes ) {
+        long numRead = fill();
+
+        if( numRead <= 0 ) {
+            if( mEnd == mStart ) {
+                return numRead;
+                }
+            inNumBytes = mEnd - mStart;
+            }
+        }
+
+    memcpy( inBuffer, &( mBuffer[ mStart ] ), inNumBytes );
+
+    return inNumBytes;
+    }
+
+
+
+inline char *BufferedInputStream::readLine( int inMaxLength ) {
+    SimpleVector<char> line;
+
+    char sawAny = false;
+
+    while( line.size() < inMaxLength ) {
+
+        if( mStart == mEnd ) {
+            if( fill() <= 0 ) {
+                break;
+                }
+            }
+
+        sawAny = true;
+
+        // scan buffered bytes for end of line
+        unsigned char *start = &( mBuffer[ mStart ] );
+
+        int numToScan = mEnd - mStart;
+
+        if( numToScan > inMaxLength - line.size() ) {
+            numToScan = inMaxLength - line.size();
+            }
+
+        unsigned char *newline =
+            (unsigned char *)memchr( start, '\n', numToScan );
+
+        if( newline != NULL ) {
+            int lineLength = newline - start;
+
+            line.appendArray( (char*)start, lineLength );
+            mStart += lineLength + 1;
+
+            // drop \r from \r\n
+            int numChars = line.size();
+            if( numChars > 0 &&
+                line.getElementDirect( numChars - 1 ) == '\r' ) {
+                line.deleteElement( numChars - 1 );
+                }
+
+            return line.getElementString();
+            }
+
+        line.appendArray( (char*)start, numToScan );
+        mStart += numToScan;
+        }
+
+    if( ! sawAny ) {
+        return NULL;
+        }
+
+    return line.getElementString();
+    }
+
+
+
+inline int BufferedInputStream::getNumBuffered() {
+    return mEnd - mStart;
+    }
+
+
+
+#endif
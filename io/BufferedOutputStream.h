@@ -0,0 +1,157 @@
+#include "minorGems/common.h"
+
+
+#ifndef BUFFERED_OUTPUT_STREAM_CLASS_INCLUDED
+#define BUFFERED_OUTPUT_STREAM_CLASS_INCLUDED
+
+#include "minorGems/io/OutputStream.h"
+
+#include <string.h>
+
+
+
+/**
+ * An output stream that collects small writes and passes them to another
+ * stream in large chunks.
+ *
+ * Nothing reaches the underlying stream until the buffer fills or
+ * flush is called, so callers must flush before waiting on a reply.
+ */
+class BufferedOutputStream : public OutputStream {
+
+	public:
+
+		/**
+		 * Constructs a buffered stream.
+		 *
+		 * @param inStream the stream to write to.
+		 *   inStream is NOT destroyed when this stream is destroyed.
+         * @param inBufferSize the buffer size in bytes.  Defaults to 4096.
+		 */
+		BufferedOutputStream( OutputStream *inStream,
+                              int inBufferSize = 4096 );
+
+        // flushes buffered bytes
+        ~BufferedOutputStream();
+
+
+
+        // implements the OutputStream interface
+        // a failure to write earlier buffered bytes can show up as a
+        // failure of a later write or flush
+		virtual long write( unsigned char *inBuffer, long inNumBytes );
+
+
+
+        /**
+         * Writes all buffered bytes to the underlying stream.
+         *
+         * @return the number of bytes written, or -1 for a stream error.
+         */
+        long flush();
+
+
+
+        /**
+         * Gets the number of bytes waiting to be flushed.
+         */
+        int getNumBuffered();
+
+
+
+    private:
+        OutputStream *mStream;
+
+        unsigned char *mBuffer;
+        int mBufferSize;
+
+        int mNumBuffered;
+    };
+
+
+
+inline BufferedOutputStream::BufferedOutputStream( OutputStream *inStream,
+                                                   int inBufferSize )
+        : mStream( inStream ),
+          mBuffer( new unsigned char[ inBufferSize ] ),
+          mBufferSize( inBufferSize ),
+          mNumBuffered( 0 ) {
+    }
+
+
+
+inline BufferedOutputStream::~BufferedOutputStream() {
+    flush();
+
+    delete [] mBuffer;
+    }
+
+
+
+inline long BufferedOutputStream::flush() {
+    if( mNumBuffered == 0 ) {
+        return 0;
+        }
+
+    long numWritten = mStream->write( mBuffer, mNumBuffered );
+
+    if( numWritten != mNumBuffered ) {
+        char *error = mStream->getLastError();
+
+        if( error != NULL ) {
+            setNewLastError( error );
+            }
+        else {
+            setNewLastErrorConst( "Buffered stream failed to flush." );
+            }
+
+        // drop buffered bytes, they can't be written in order now
+        mNumBuffered = 0;
+        return -1;
+        }
+
+    mNumBuffered = 0;
+    return numWritten;
+    }
+
+
+
+inline long BufferedOutputStream::write( unsigned char *inBuffer,
+                                         long inNumBytes ) {
+
+    if( mNumBuffered + inNumBytes > mBufferSize ) {
+        if( flush() == -1 ) {
+            return -1;
+            }
+        }
+
+    if( inNumBytes >= mBufferSize ) {
+        // too big to be worth buffering, buffer is empty now,
+        // so order is kept
+        long numWritten = mStream->write( inBuffer, inNumBytes );
+
+        if( numWritten == -1 ) {
+            char *error = mStream->getLastError();
+
+            if( error != NULL ) {
+                setNewLastError( error );
+                }
+            }
+        return numWritten;
+        }
+
+    memcpy( &( mBuffer[ mNumBuffered ] ), inBuffer, inNumBytes );
+    mNumBuffered += inNumBytes;
+
+    return inNumBytes;
+    }
+
+
+
+inline int BufferedOutputStream::getNumBuffered() {
+    return mNumBuffered;
+    }
+
+
+
+#endif
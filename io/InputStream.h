@@ -64,6 +64,26 @@ class InputStream : public Stream {
 
 
 
+        /**
+         * Reads bytes that are available now, waiting only if none are.
+         *
+         * Unlike read, which may wait until all inNumBytes arrive,
+         * this returns as soon as some bytes have been read, for streams
+         * that can tell what is available.  The default implementation 
+         * calls read.
+         *
+		 * @param inBuffer the buffer where read bytes will be put.
+		 *   Must be pre-allocated memory space.
+		 * @param inNumBytes the maximum number of bytes to read.
+		 *
+		 * @return the number of bytes read successfully,
+		 *   or -1 for a stream error.
+         */
+        virtual long readAvailable( unsigned char *inBuffer, 
+                                    long inNumBytes );
+
+
+
         /**
          * Reads a byte from this stream.
          *
@@ -139,6 +159,13 @@ inline InputStream::~InputStream() {
 
 
 
+inline long InputStream::readAvailable( unsigned char *inBuffer, 
+                                       long inNumBytes ) {
+    return read( inBuffer, inNumBytes );
+    }
+
+
+
 inline long InputStream::readByte( unsigned char *outByte ) {
     int numBytes = read( mByteBuffer, 1 );
 
@@ -168,7 +195,7 @@ inline long InputStream::readLong( long *outLong ) {
 
 
 inline long InputStream::readShort( short *outShort ) {
-	int numBytes = read( mShortBuffer, 4 );
+	int numBytes = read( mShortBuffer, 2 );
 	*outShort = TypeIO::bytesToShort( mShortBuffer );
 	
 	return numBytes;
@@ -44,6 +44,16 @@
 
 
 
+/**
+ * One contiguous buffer of a vectored write.
+ */
+typedef struct OutputStreamSlice {
+        unsigned char *buffer;
+        long numBytes;
+    } OutputStreamSlice;
+
+
+
 /**
  * Interface for a byte output stream.
  *
@@ -69,6 +79,24 @@ class OutputStream : public Stream {
 		
 
 
+        /**
+         * Writes several buffers to this stream as if they were one
+         * contiguous buffer, without copying them together first.
+         *
+         * The default implementation writes them one at a time.
+         * Streams that can write them all at once override it.
+         *
+         * @param inSlices the buffers to write, in order.
+         * @param inNumSlices the number of slices.
+         *
+         * @return the total number of bytes written successfully,
+         *   or -1 for a stream error.
+         */
+        virtual long writeSlices( OutputStreamSlice *inSlices,
+                                  int inNumSlices );
+
+
+
         /**
          * Writes a string to this stream.
          *
@@ -143,6 +171,29 @@ inline OutputStream::~OutputStream() {
 
 
 
+inline long OutputStream::writeSlices( OutputStreamSlice *inSlices,
+                                       int inNumSlices ) {
+    long numTotalWritten = 0;
+
+    for( int i=0; i<inNumSlices; i++ ) {
+        long numWritten = write( inSlices[i].buffer, inSlices[i].numBytes );
+
+        if( numWritten == -1 ) {
+            return -1;
+            }
+
+        numTotalWritten += numWritten;
+
+        if( numWritten != inSlices[i].numBytes ) {
+            break;
+            }
+        }
+
+    return numTotalWritten;
+    }
+
+
+
 inline long OutputStream::writeString( const char *inString ) {
 		
 	int numBytes = write( (unsigned char *)inString, strlen( inString ) );
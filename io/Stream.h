@@ -133,8 +133,7 @@ inline void Stream::setNewLastErrorConst( const char *inString ) {
 		length++;
 		}
 	
-	// add one more to length to accommodate '\0' terminination
-	length++;
+	// length now includes '\0' termination
 	
 	if( mLastError != NULL ) {
 		delete [] mLastError;
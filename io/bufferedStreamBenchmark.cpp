@@ -0,0 +1,273 @@
+// Parses a stream of small records field by field (readLong, readShort,
+// readByte, readDouble) over a FileInputStream and over a SocketStream,
+// with and without BufferedInputStream / BufferedOutputStream, and
+// reports how many calls reached the underlying stream and the time taken.
+//
+// For SocketStream, each underlying call is one send or recv system call.
+// FileInputStream sits on stdio, which has its own buffer, so there the
+// count is of fread calls rather than system calls.
+
+
+#include "BufferedInputStream.h"
+#include "BufferedOutputStream.h"
+
+#include "minorGems/io/file/File.h"
+#include "minorGems/io/file/FileInputStream.h"
+#include "minorGems/io/file/FileOutputStream.h"
+
+#include "minorGems/network/Socket.h"
+#include "minorGems/network/SocketStream.h"
+
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/Time.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+
+
+
+// counts calls passed through to another stream
+class CountingInputStream : public InputStream {
+    public:
+        CountingInputStream( InputStream *inStream )
+                : mStream( inStream ), mNumCalls( 0 ) {
+            }
+
+        long read( unsigned char *inBuffer, long inNumBytes ) {
+            mNumCalls++;
+            return mStream->read( inBuffer, inNumBytes );
+            }
+
+        long readAvailable( unsigned char *inBuffer, long inNumBytes ) {
+            mNumCalls++;
+            return mStream->readAvailable( inBuffer, inNumBytes );
+            }
+
+        InputStream *mStream;
+        int mNumCalls;
+    };
+
+
+
+class CountingOutputStream : public OutputStream {
+    public:
+        CountingOutputStream( OutputStream *inStream )
+                : mStream( inStream ), mNumCalls( 0 ) {
+            }
+
+        long write( unsigned char *inBuffer, long inNumBytes ) {
+            mNumCalls++;
+            return mStream->write( inBuffer, inNumBytes );
+            }
+
+        OutputStream *mStream;
+        int mNumCalls;
+    };
+
+
+
+static void writeRecords( OutputStream *inStream, int inNumRecords ) {
+    for( int i=0; i<inNumRecords; i++ ) {
+        inStream->writeLong( i );
+        inStream->writeShort( (short)( i % 30000 ) );
+        unsigned char b = (unsigned char)( i % 256 );
+        inStream->write( &b, 1 );
+        inStream->writeDouble( i * 0.5 );
+        }
+    }
+
+
+
+// returns number of bad records
+static int readRecords( InputStream *inStream, int inNumRecords ) {
+    int numBad = 0;
+
+    for( int i=0; i<inNumRecords; i++ ) {
+        long l;
+        short s;
+        unsigned char b;
+        double d;
+
+        inStream->readLong( &l );
+        inStream->readShort( &s );
+        inStream->readByte( &b );
+        inStream->readDouble( &d );
+
+        if( l != i || s != i % 30000 || b != i % 256 || d != i * 0.5 ) {
+            numBad++;
+            }
+        }
+    return numBad;
+    }
+
+
+
+class WriterThread : public Thread {
+    public:
+        WriterThread( OutputStream *inStream, int inNumRecords,
+                      BufferedOutputStream *inBuffered )
+                : mStream( inStream ), mNumRecords( inNumRecords ),
+                  mBuffered( inBuffered ) {
+            start();
+            }
+
+        ~WriterThread() {
+            join();
+            }
+
+        void run() {
+            writeRecords( mStream, mNumRecords );
+
+            if( mBuffered != NULL ) {
+                mBuffered->flush();
+                }
+            }
+
+        OutputStream *mStream;
+        int mNumRecords;
+        BufferedOutputStream *mBuffered;
+    };
+
+
+
+static int numFailed = 0;
+
+
+
+static void fileTest( File *inFile, int inNumRecords, char inBuffered ) {
+    int numWriteCalls;
+    
+    double startTime = Time::getCurrentTime();
+
+    // in a block, so file is closed before we read it
+    {
+        FileOutputStream fileOut( inFile );
+        CountingOutputStream countOut( &fileOut );
+        
+        if( inBuffered ) {
+            BufferedOutputStream bufferedOut( &countOut );
+            writeRecords( &bufferedOut, inNumRecords );
+            }
+        else {
+            writeRecords( &countOut, inNumRecords );
+            }
+        
+        numWriteCalls = countOut.mNumCalls;
+        }
+
+    double writeTime = Time::getCurrentTime() - startTime;
+
+
+    FileInputStream fileIn( inFile );
+    CountingInputStream countIn( &fileIn );
+
+    startTime = Time::getCurrentTime();
+
+    int numBad;
+
+    if( inBuffered ) {
+        BufferedInputStream bufferedIn( &countIn );
+        numBad = readRecords( &bufferedIn, inNumRecords );
+        }
+    else {
+        numBad = readRecords( &countIn, inNumRecords );
+        }
+
+    double readTime = Time::getCurrentTime() - startTime;
+
+    printf( "File %s:  %d fwrite calls (%.3f s), %d fread calls (%.3f s)\n",
+            inBuffered ? "buffered  " : "unbuffered",
+            numWriteCalls, writeTime, countIn.mNumCalls, readTime );
+
+    if( numBad > 0 ) {
+        printf( "  FAILED:  %d bad records\n", numBad );
+        numFailed++;
+        }
+    }
+
+
+
+static void socketTest( int inNumRecords, char inBuffered ) {
+    int pair[2];
+
+    if( socketpair( AF_UNIX, SOCK_STREAM, 0, pair ) != 0 ) {
+        printf( "socketpair failed\n" );
+        numFailed++;
+        return;
+        }
+
+    Socket sendSocket;
+    sendSocket.mNativeSocketID = pair[0];
+
+    Socket receiveSocket;
+    receiveSocket.mNativeSocketID = pair[1];
+
+    SocketStream sendStream( &sendSocket );
+    SocketStream receiveStream( &receiveSocket );
+
+    CountingOutputStream countOut( &sendStream );
+    CountingInputStream countIn( &receiveStream );
+
+    BufferedOutputStream bufferedOut( &countOut );
+    BufferedInputStream bufferedIn( &countIn );
+
+    double startTime = Time::getCurrentTime();
+
+    int numBad;
+
+    if( inBuffered ) {
+        WriterThread writer( &bufferedOut, inNumRecords, &bufferedOut );
+        numBad = readRecords( &bufferedIn, inNumRecords );
+        }
+    else {
+        WriterThread writer( &countOut, inNumRecords, NULL );
+        numBad = readRecords( &countIn, inNumRecords );
+        }
+
+    double totalTime = Time::getCurrentTime() - startTime;
+
+    printf( "Socket %s:  %d send calls, %d recv calls (%.3f s)\n",
+            inBuffered ? "buffered  " : "unbuffered",
+            countOut.mNumCalls, countIn.mNumCalls, totalTime );
+
+    if( numBad > 0 ) {
+        printf( "  FAILED:  %d bad records\n", numBad );
+        numFailed++;
+        }
+    }
+
+
+
+// usage:
+// bufferedStreamBenchmark [numRecords]
+
+int main( int inNumArgs, char **inArgs ) {
+
+    int numRecords = 100000;
+
+    if( inNumArgs > 1 ) {
+        numRecords = atoi( inArgs[1] );
+        }
+
+    Socket::initSocketFramework();
+
+    printf( "%d records of 15 bytes, read field by field\n\n", numRecords );
+
+    File file( NULL, "bufferedStreamBenchmark.tmp" );
+
+    fileTest( &file, numRecords, false );
+    fileTest( &file, numRecords, true );
+
+    file.remove();
+
+    socketTest( numRecords, false );
+    socketTest( numRecords, true );
+
+
+    if( numFailed == 0 ) {
+        printf( "\nAll records read back correctly\n" );
+        return 0;
+        }
+    return 1;
+    }
@@ -0,0 +1,450 @@
+#include "AsyncFileReader.h"
+
+#include "minorGems/io/file/File.h"
+#include "minorGems/util/stringUtils.h"
+
+
+#if defined( __unix__ ) || defined( __APPLE__ )
+    #define ASYNC_FILE_READER_MMAP
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+
+
+AsyncFileReaderThread::AsyncFileReaderThread( AsyncFileReader *inReader )
+        : mReader( inReader ) {
+    start();
+    }
+
+
+
+AsyncFileReaderThread::~AsyncFileReaderThread() {
+    stop();
+    join();
+    }
+
+
+
+void AsyncFileReaderThread::run() {
+    while( ! isStopped() ) {
+        mReader->readNext( 100 );
+        }
+    }
+
+
+
+
+AsyncFileReader::AsyncFileReader( int inNumThreads )
+        : mNextHandle( 0 ),
+          mQueueSemaphore( 0 ),
+          mSlotMask( 63 ) {
+
+    mSlots = new AsyncFileReadRecord*[ mSlotMask + 1 ];
+
+    for( int i=0; i<=mSlotMask; i++ ) {
+        mSlots[i] = NULL;
+        }
+
+    for( int i=0; i<inNumThreads; i++ ) {
+        mThreads.push_back( new AsyncFileReaderThread( this ) );
+        }
+    }
+
+
+
+AsyncFileReader::~AsyncFileReader() {
+    for( int i=0; i<mThreads.size(); i++ ) {
+        delete mThreads.getElementDirect( i );
+        }
+
+    // no threads left, so every record is either queued or in slots
+    // (cancelled ones are only in queue)
+    while( mQueue.size() > 0 ) {
+        AsyncFileReadRecord *r = mQueue.removeMin();
+
+        if( r->cancelled ) {
+            freeRecord( r );
+            }
+        }
+
+    for( int i=0; i<=mSlotMask; i++ ) {
+        if( mSlots[i] != NULL ) {
+            freeRecord( mSlots[i] );
+            }
+        }
+
+    delete [] mSlots;
+    }
+
+
+
+void AsyncFileReader::insertRecord( AsyncFileReadRecord *inRecord ) {
+
+    while( mSlots[ inRecord->handle & mSlotMask ] != NULL ) {
+        // collision with another live handle, grow table
+
+        int oldSize = mSlotMask + 1;
+        AsyncFileReadRecord **oldSlots = mSlots;
+
+        char collision = true;
+
+        while( collision ) {
+            mSlotMask = mSlotMask * 2 + 1;
+
+            if( mSlots != oldSlots ) {
+                // previous attempt too small
+                delete [] mSlots;
+                }
+            mSlots = new AsyncFileReadRecord*[ mSlotMask + 1 ];
+
+            for( int i=0; i<=mSlotMask; i++ ) {
+                mSlots[i] = NULL;
+                }
+
+            collision = false;
+
+            for( int i=0; i<oldSize && !collision; i++ ) {
+                AsyncFileReadRecord *r = oldSlots[i];
+
+                if( r != NULL ) {
+                    int slot = r->handle & mSlotMask;
+
+                    if( mSlots[ slot ] != NULL ) {
+                        collision = true;
+                        }
+                    else {
+                        mSlots[ slot ] = r;
+                        }
+                    }
+                }
+            }
+
+        delete [] oldSlots;
+        }
+
+    mSlots[ inRecord->handle & mSlotMask ] = inRecord;
+    }
+
+
+
+AsyncFileReadRecord *AsyncFileReader::lookupRecord( int inHandle ) {
+    if( inHandle < 0 ) {
+        return NULL;
+        }
+
+    AsyncFileReadRecord *r = mSlots[ inHandle & mSlotMask ];
+
+    if( r != NULL && r->handle == inHandle ) {
+        return r;
+        }
+    return NULL;
+    }
+
+
+
+void AsyncFileReader::clearSlot( int inHandle ) {
+    int slot = inHandle & mSlotMask;
+
+    if( mSlots[ slot ] != NULL && mSlots[ slot ]->handle == inHandle ) {
+        mSlots[ slot ] = NULL;
+        }
+    }
+
+
+
+int AsyncFileReader::startRead( const char *inFilePath, int inPriority,
+                                char inMemoryMap ) {
+
+    AsyncFileReadRecord *r = new AsyncFileReadRecord;
+
+    r->filePath = stringDuplicate( inFilePath );
+    r->priority = inPriority;
+    r->memoryMap = inMemoryMap;
+    r->dataLength = -1;
+    r->data = NULL;
+    r->dataMapped = false;
+    r->started = false;
+    r->done = false;
+    r->cancelled = false;
+
+    mLock.lock();
+
+    r->handle = mNextHandle;
+    mNextHandle ++;
+
+    insertRecord( r );
+
+    // queue pops minimum, so negate priority,
+    // and break ties by handle for FIFO order
+    mQueue.insert( r, - (double)inPriority * 4294967296.0 + r->handle );
+
+    mLock.unlock();
+
+    mQueueSemaphore.signal();
+
+    return r->handle;
+    }
+
+
+
+char AsyncFileReader::isDone( int inHandle ) {
+    mLock.lock();
+
+    char done = false;
+
+    AsyncFileReadRecord *r = lookupRecord( inHandle );
+
+    if( r != NULL ) {
+        done = r->done;
+        }
+
+    mLock.unlock();
+
+    return done;
+    }
+
+
+
+void AsyncFileReader::waitForDone( int inHandle ) {
+    // our own semaphore, so a finished read wakes every waiter rather
+    // than whichever one a shared semaphore happens to pick
+    BinarySemaphore *semaphore = NULL;
+
+    while( true ) {
+        mLock.lock();
+
+        AsyncFileReadRecord *r = lookupRecord( inHandle );
+
+        char done = ( r == NULL || r->done );
+
+        if( ! done ) {
+            if( semaphore == NULL ) {
+                semaphore = new BinarySemaphore();
+                }
+            mDoneWaiters.push_back( semaphore );
+            }
+
+        mLock.unlock();
+
+        if( done ) {
+            break;
+            }
+
+        // woken when any read finishes, after which we check again
+        semaphore->wait();
+        }
+
+    if( semaphore != NULL ) {
+        delete semaphore;
+        }
+    }
+
+
+
+void AsyncFileReader::wakeDoneWaiters() {
+    for( int i=0; i<mDoneWaiters.size(); i++ ) {
+        mDoneWaiters.getElementDirect( i )->signal();
+        }
+    mDoneWaiters.deleteAll();
+    }
+
+
+
+unsigned char *AsyncFileReader::getData( int inHandle, int *outDataLength ) {
+    mLock.lock();
+
+    unsigned char *data = NULL;
+    *outDataLength = -1;
+
+    AsyncFileReadRecord *r = lookupRecord( inHandle );
+
+    if( r != NULL && r->done ) {
+        data = r->data;
+        *outDataLength = r->dataLength;
+
+        clearSlot( inHandle );
+
+        delete [] r->filePath;
+        delete r;
+        }
+
+    mLock.unlock();
+
+    return data;
+    }
+
+
+
+void AsyncFileReader::cancelRead( int inHandle ) {
+    mLock.lock();
+
+    AsyncFileReadRecord *r = lookupRecord( inHandle );
+
+    if( r != NULL ) {
+        clearSlot( inHandle );
+
+        if( r->done ) {
+            freeRecord( r );
+            }
+        else {
+            // still queued or being read
+            // thread that touches it next will free it
+            r->cancelled = true;
+            }
+
+        // waiters on this handle return now that it is gone
+        wakeDoneWaiters();
+        }
+
+    mLock.unlock();
+    }
+
+
+
+void AsyncFileReader::freeMappedData( unsigned char *inData,
+                                      int inDataLength ) {
+    if( inData == NULL ) {
+        return;
+        }
+
+#ifdef ASYNC_FILE_READER_MMAP
+    if( inDataLength == 0 ) {
+        // empty files aren't mapped
+        delete [] inData;
+        return;
+        }
+    munmap( inData, inDataLength );
+#else
+    delete [] inData;
+#endif
+    }
+
+
+
+void AsyncFileReader::freeRecord( AsyncFileReadRecord *inRecord ) {
+    if( inRecord->data != NULL ) {
+        if( inRecord->dataMapped ) {
+            freeMappedData( inRecord->data, inRecord->dataLength );
+            }
+        else {
+            delete [] inRecord->data;
+            }
+        }
+
+    delete [] inRecord->filePath;
+    delete inRecord;
+    }
+
+
+
+void AsyncFileReader::readFile( AsyncFileReadRecord *inRecord ) {
+
+#ifdef ASYNC_FILE_READER_MMAP
+
+    if( inRecord->memoryMap ) {
+        int fd = open( inRecord->filePath, O_RDONLY );
+
+        if( fd == -1 ) {
+            return;
+            }
+
+        struct stat fileStats;
+
+        if( fstat( fd, &fileStats ) != 0 ) {
+            // leave as failed
+            }
+        else if( fileStats.st_size == 0 ) {
+            // empty files can't be mapped, so give the same empty
+            // result that File::readFileContents does
+            inRecord->data = new unsigned char[ 0 ];
+            inRecord->dataLength = 0;
+            }
+        else {
+            void *mapping = mmap( NULL, fileStats.st_size, PROT_READ,
+                                  MAP_PRIVATE, fd, 0 );
+
+            if( mapping != MAP_FAILED ) {
+                unsigned char *bytes = (unsigned char *)mapping;
+                int length = (int)fileStats.st_size;
+
+                // fault every page in now, on this thread, rather than
+                // later on the thread that uses the data
+                madvise( mapping, length, MADV_WILLNEED );
+
+                volatile unsigned char touched = 0;
+                for( int i=0; i<length; i += 4096 ) {
+                    touched ^= bytes[i];
+                    }
+
+                inRecord->data = bytes;
+                inRecord->dataLength = length;
+                inRecord->dataMapped = true;
+                }
+            }
+
+        close( fd );
+        return;
+        }
+
+#endif
+
+    File f( NULL, inRecord->filePath );
+
+    inRecord->data = f.readFileContents( &( inRecord->dataLength ) );
+    }
+
+
+
+void AsyncFileReader::readNext( int inTimeoutMS ) {
+
+    if( mQueueSemaphore.wait( inTimeoutMS ) != 1 ) {
+        // timed out
+        return;
+        }
+
+    mLock.lock();
+
+    AsyncFileReadRecord *r = NULL;
+
+    while( r == NULL && mQueue.size() > 0 ) {
+        r = mQueue.removeMin();
+
+        if( r->cancelled ) {
+            // never started, nothing else refers to it
+            freeRecord( r );
+            r = NULL;
+            }
+        }
+
+    if( r != NULL ) {
+        // cancelRead won't free a started record, so we can
+        // use it outside the lock
+        r->started = true;
+        }
+
+    mLock.unlock();
+
+    if( r == NULL ) {
+        return;
+        }
+
+
+    readFile( r );
+
+
+    mLock.lock();
+
+    if( r->cancelled ) {
+        freeRecord( r );
+        }
+    else {
+        r->done = true;
+        }
+
+    wakeDoneWaiters();
+
+    mLock.unlock();
+    }
@@ -0,0 +1,233 @@
+#ifndef ASYNC_FILE_READER_INCLUDED
+#define ASYNC_FILE_READER_INCLUDED
+
+
+#include "minorGems/system/StopSignalThread.h"
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/system/Semaphore.h"
+#include "minorGems/system/BinarySemaphore.h"
+
+#include "minorGems/util/SimpleVector.h"
+#include "minorGems/util/MinPriorityQueue.h"
+
+
+
+typedef struct AsyncFileReadRecord {
+        int handle;
+        char *filePath;
+
+        int priority;
+
+        // true if caller asked for memory-mapped result
+        char memoryMap;
+
+        int dataLength;
+        unsigned char *data;
+
+        // true if data is a mapping rather than a new[] array
+        char dataMapped;
+
+        char started;
+        char done;
+
+        // cancelled records are dropped by whichever thread
+        // next touches them
+        char cancelled;
+
+    } AsyncFileReadRecord;
+
+
+
+class AsyncFileReader;
+
+
+// reads queued files for an AsyncFileReader
+class AsyncFileReaderThread : public StopSignalThread {
+
+    public:
+
+        AsyncFileReaderThread( AsyncFileReader *inReader );
+
+        // stops and joins this thread
+        ~AsyncFileReaderThread();
+
+        // implements the Thread::run() interface
+        void run();
+
+    private:
+        AsyncFileReader *mReader;
+    };
+
+
+
+/**
+ * Reads whole files in the background on a pool of threads.
+ *
+ * Reads are started in priority order (FIFO among equal priorities),
+ * and handles are looked up in constant time.
+ *
+ * Handles are handed out in sequence starting from 0, so the same
+ * sequence of startRead calls produces the same handles (which game
+ * recording/playback depends on).
+ *
+ * All functions are thread-safe.
+ */
+class AsyncFileReader {
+
+    public:
+
+
+        /**
+         * Constructs a reader and starts its threads.
+         *
+         * @param inNumThreads the number of files to read at once.
+         *   Defaults to 4.
+         */
+        AsyncFileReader( int inNumThreads = 4 );
+
+
+        /**
+         * Stops all threads and frees data that was never collected.
+         *
+         * Blocks until reads in progress finish.
+         */
+        ~AsyncFileReader();
+
+
+
+        /**
+         * Queues a file to be read.
+         *
+         * @param inFilePath the path to the file.  Destroyed by caller.
+         * @param inPriority reads with higher priority start first.
+         *   Defaults to 0.
+         * @param inMemoryMap true to map the file into memory instead of
+         *   copying it into a buffer (on platforms that support it).
+         *   Mapped pages are touched in the background, so using the
+         *   data later doesn't stall on disk.  Results must be freed with
+         *   freeMappedData.  Defaults to false.
+         *
+         * @return a handle for this read.
+         */
+        int startRead( const char *inFilePath, int inPriority = 0,
+                       char inMemoryMap = false );
+
+
+
+        /**
+         * Checks whether a read is done.
+         *
+         * @param inHandle the handle returned by startRead.
+         *
+         * @return true if done (whether or not it succeeded), or false
+         *   if still in progress or handle unknown.
+         */
+        char isDone( int inHandle );
+
+
+
+        /**
+         * Blocks until a read is done.
+         *
+         * Returns at once if handle unknown.
+         *
+         * @param inHandle the handle returned by startRead.
+         */
+        void waitForDone( int inHandle );
+
+
+
+        /**
+         * Gets the result of a read and clears its handle.
+         *
+         * @param inHandle the handle returned by startRead.
+         * @param outDataLength pointer to where data length should
+         *   be returned.
+         *
+         * @return the file contents, or NULL if read failed, is not done,
+         *   or handle unknown.  Destroyed by caller with delete [], or
+         *   with freeMappedData if read was started with inMemoryMap.
+         */
+        unsigned char *getData( int inHandle, int *outDataLength );
+
+
+
+        /**
+         * Cancels a read and clears its handle.
+         *
+         * A read that has not started yet is skipped.  The result of
+         * a read in progress or already done is discarded.
+         *
+         * @param inHandle the handle returned by startRead.
+         */
+        void cancelRead( int inHandle );
+
+
+
+        /**
+         * Frees data returned by getData for a memory-mapped read.
+         *
+         * @param inData the data.
+         * @param inDataLength the data length returned by getData.
+         */
+        static void freeMappedData( unsigned char *inData,
+                                    int inDataLength );
+
+
+
+        // used by reader threads
+        // reads next queued file, waiting up to inTimeoutMS for one
+        void readNext( int inTimeoutMS );
+
+
+
+    protected:
+
+        SimpleVector<AsyncFileReaderThread*> mThreads;
+
+        // protects everything below
+        MutexLock mLock;
+
+        int mNextHandle;
+
+        // records not yet started
+        MinPriorityQueue<AsyncFileReadRecord*> mQueue;
+
+        // counts records added to mQueue
+        Semaphore mQueueSemaphore;
+
+        // semaphores of threads blocked in waitForDone, all signaled
+        // and cleared whenever a read finishes or is cancelled
+        SimpleVector<BinarySemaphore*> mDoneWaiters;
+
+
+        // live records, indexed by handle modulo table size
+        // table size is a power of two, doubled whenever two live
+        // handles land in the same slot
+        // since handles are sequential, table only grows with the span
+        // of live handles, not with total reads
+        AsyncFileReadRecord **mSlots;
+        int mSlotMask;
+
+        // mLock must be locked by caller
+        void insertRecord( AsyncFileReadRecord *inRecord );
+
+        // mLock must be locked by caller
+        // returns NULL if handle unknown
+        AsyncFileReadRecord *lookupRecord( int inHandle );
+
+        // mLock must be locked by caller
+        void clearSlot( int inHandle );
+
+        // mLock must be locked by caller
+        void wakeDoneWaiters();
+
+
+        static void readFile( AsyncFileReadRecord *inRecord );
+
+        static void freeRecord( AsyncFileReadRecord *inRecord );
+    };
+
+
+
+#endif
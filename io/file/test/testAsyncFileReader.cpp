@@ -0,0 +1,148 @@
+/**
+ * A test program for AsyncFileReader.
+ *
+ * Reads every file in a directory, both copied and memory-mapped,
+ * checks results against synchronous reads, and exercises priorities
+ * and cancellation.
+ */
+
+
+
+#include "minorGems/io/file/AsyncFileReader.h"
+#include "minorGems/io/file/File.h"
+#include "minorGems/system/Time.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    const char *dirName = ".";
+
+    if( inNumArgs > 1 ) {
+        dirName = inArgs[1];
+        }
+
+    File dir( NULL, dirName );
+
+    int numChildren;
+    File **childFiles = dir.getChildFiles( &numChildren );
+
+    if( childFiles == NULL ) {
+        printf( "Failed to list %s\n", dirName );
+        return 1;
+        }
+
+
+    AsyncFileReader reader( 4 );
+
+    int numFailed = 0;
+
+    int *handles = new int[ numChildren ];
+    int *mappedHandles = new int[ numChildren ];
+    char **paths = new char*[ numChildren ];
+
+    double startTime = Time::getCurrentTime();
+
+    for( int i=0; i<numChildren; i++ ) {
+        paths[i] = childFiles[i]->getFullFileName();
+
+        // later files first
+        handles[i] = reader.startRead( paths[i], i );
+        mappedHandles[i] = reader.startRead( paths[i], i, true );
+        }
+
+
+    // cancel one of each right away
+    int numCancelled = 0;
+    if( numChildren > 1 ) {
+        reader.cancelRead( handles[0] );
+        reader.cancelRead( mappedHandles[0] );
+        numCancelled = 1;
+        }
+
+
+    for( int i=numCancelled; i<numChildren; i++ ) {
+        reader.waitForDone( handles[i] );
+        reader.waitForDone( mappedHandles[i] );
+        }
+
+    printf( "Read %d files twice in %.3f seconds\n", numChildren,
+            Time::getCurrentTime() - startTime );
+
+
+    for( int i=numCancelled; i<numChildren; i++ ) {
+        if( childFiles[i]->isDirectory() ) {
+            continue;
+            }
+
+        int length;
+        unsigned char *data = reader.getData( handles[i], &length );
+
+        int mappedLength;
+        unsigned char *mappedData =
+            reader.getData( mappedHandles[i], &mappedLength );
+
+        int expectedLength;
+        unsigned char *expected =
+            childFiles[i]->readFileContents( &expectedLength );
+
+        if( expected == NULL ) {
+            continue;
+            }
+
+        if( data == NULL || length != expectedLength ||
+            memcmp( data, expected, length ) != 0 ) {
+            printf( "Read mismatch for %s\n", paths[i] );
+            numFailed++;
+            }
+
+        if( mappedData == NULL || mappedLength != expectedLength ||
+            memcmp( mappedData, expected, mappedLength ) != 0 ) {
+            printf( "Mapped read mismatch for %s\n", paths[i] );
+            numFailed++;
+            }
+
+        // handle cleared
+        if( reader.isDone( handles[i] ) ||
+            reader.getData( handles[i], &length ) != NULL ) {
+            printf( "Handle not cleared for %s\n", paths[i] );
+            numFailed++;
+            }
+
+        delete [] expected;
+
+        if( data != NULL ) {
+            delete [] data;
+            }
+        AsyncFileReader::freeMappedData( mappedData, mappedLength );
+        }
+
+
+    if( numCancelled > 0 &&
+        ( reader.isDone( handles[0] ) || reader.isDone( mappedHandles[0] ) ) ) {
+        printf( "Cancelled handle still live\n" );
+        numFailed++;
+        }
+
+
+    for( int i=0; i<numChildren; i++ ) {
+        delete [] paths[i];
+        delete childFiles[i];
+        }
+    delete [] paths;
+    delete [] childFiles;
+    delete [] handles;
+    delete [] mappedHandles;
+
+
+    if( numFailed == 0 ) {
+        printf( "All tests passed\n" );
+        return 0;
+        }
+
+    printf( "%d tests failed\n", numFailed );
+    return 1;
+    }
@@ -63,7 +63,11 @@ class LoggingSocketStream : public SocketStream {
 
         long read( unsigned char *inBuffer, long inNumBytes );
 
+        long readAvailable( unsigned char *inBuffer, long inNumBytes );
+
         long write( unsigned char *inBuffer, long inNumBytes );
+
+        long writeSlices( OutputStreamSlice *inSlices, int inNumSlices );
         
         
     protected:
@@ -152,6 +156,31 @@ inline long LoggingSocketStream::read( unsigned char *inBuffer,
         
         
 
+inline long LoggingSocketStream::readAvailable( unsigned char *inBuffer,
+                                                long inNumBytes ) {
+    long returnVal = SocketStream::readAvailable( inBuffer, inNumBytes );
+
+    if( mEnableInboundLog &&
+        mInboundSizeSoFar < mLogSizeLimit &&
+        returnVal > 0 ) {
+
+        int numToLog = returnVal;
+        if( mInboundSizeSoFar + numToLog > mLogSizeLimit ) {
+            numToLog = mLogSizeLimit - mInboundSizeSoFar;
+            }
+        
+        if( mInboundLogFile != NULL ) {
+            fwrite( inBuffer, 1, numToLog, mInboundLogFile );
+            fflush( mInboundLogFile );
+            }
+        mInboundSizeSoFar += numToLog;
+        }
+    
+    return returnVal;    
+    }
+
+
+
 inline long LoggingSocketStream::write( unsigned char *inBuffer,
                                         long inNumBytes ) {
 
@@ -175,6 +204,45 @@ inline long LoggingSocketStream::write( unsigned char *inBuffer,
     
     return returnVal;    
     }
+
+
+
+inline long LoggingSocketStream::writeSlices( OutputStreamSlice *inSlices,
+                                              int inNumSlices ) {
+
+    long returnVal = SocketStream::writeSlices( inSlices, inNumSlices );
+
+    // log the bytes that were sent, in slice order
+    long numLeftToLog = returnVal;
+
+    for( int i=0; i<inNumSlices && numLeftToLog > 0; i++ ) {
+        
+        if( !mEnableOutboundLog || mOutboundSizeSoFar >= mLogSizeLimit ) {
+            break;
+            }
+
+        long numToLog = inSlices[i].numBytes;
+        if( numToLog > numLeftToLog ) {
+            numToLog = numLeftToLog;
+            }
+        numLeftToLog -= numToLog;
+
+        if( mOutboundSizeSoFar + numToLog > mLogSizeLimit ) {
+            numToLog = mLogSizeLimit - mOutboundSizeSoFar;
+            }
+
+        if( mOutboundLogFile != NULL ) {
+            fwrite( inSlices[i].buffer, 1, numToLog, mOutboundLogFile );
+            }
+        mOutboundSizeSoFar += numToLog;
+        }
+
+    if( mOutboundLogFile != NULL && returnVal > 0 ) {
+        fflush( mOutboundLogFile );
+        }
+    
+    return returnVal;    
+    }
     
     
     
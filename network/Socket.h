@@ -63,6 +63,18 @@
 #include "minorGems/network/HostAddress.h"
 #include "minorGems/system/Time.h"
 
+#include <stdio.h>
+
+
+
+/**
+ * One contiguous slice of a scatter/gather send.
+ */
+typedef struct SocketSendSlice {
+        unsigned char *buffer;
+        int numBytes;
+    } SocketSendSlice;
+
 
 
 
@@ -159,6 +171,53 @@ class Socket {
 		int send( unsigned char *inBuffer, int inNumBytes,
                   char inAllowedToBlock = true,
                   char inAllowDelay = true );
+
+
+
+        /**
+         * Sends several buffers through this socket as if they were
+         * one contiguous buffer, without copying them together first.
+         *
+         * @param inSlices the buffers to send, in order.
+         * @param inNumSlices the number of slices.
+         * @param inAllowedToBlock set to false to prevent blocking.
+         *   Defaults to true.
+         * @param inAllowDelay set to false to disable Nagle algorithm.
+         *   Defaults to true.
+         *
+         * @return the total number of bytes sent successfully (which may
+         *   end in the middle of a slice), or -1 for a socket error.
+         *   Returns -2 if not allowed to block and the operation
+         *   would block.
+         */
+        int sendv( SocketSendSlice *inSlices, int inNumSlices,
+                   char inAllowedToBlock = true,
+                   char inAllowDelay = true );
+
+
+
+        /**
+         * Sends a region of a file through this socket.
+         *
+         * On Linux, data goes straight from the page cache to the socket
+         * without passing through user space.
+         *
+         * Does not change the file's current position.
+         *
+         * @param inFile the file to send from.  Must be open for reading.
+         * @param inOffset the file offset to start sending from.
+         * @param inNumBytes the number of bytes to send.
+         * @param inAllowedToBlock set to false to prevent blocking.
+         *   If true, blocks until all bytes are sent.
+         *   Defaults to true.
+         *
+         * @return the number of bytes sent successfully,
+         *   or -1 for a socket or file error.
+         *   Returns -2 if not allowed to block and the operation
+         *   would block before any bytes are sent.
+         */
+        long sendFile( FILE *inFile, long inOffset, long inNumBytes,
+                       char inAllowedToBlock = true );
 		
 		
 		/**
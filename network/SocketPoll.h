@@ -1,3 +1,6 @@
+#ifndef SOCKET_POLL_INCLUDED
+#define SOCKET_POLL_INCLUDED
+
 
 #include "Socket.h"
 #include "SocketServer.h"
@@ -12,11 +15,51 @@ typedef struct SocketOrServer {
         SocketServer *server;
 
         void *otherData;
+
+        // set by wait and waitMany to tell caller what kind of
+        // attention is needed
+        // (servers only ever get readReady, which means a connection
+        //  is ready to be accepted)
+        char readReady;
+        char writeReady;
+        
+        // true if this socket or server has been removed from the poll
+        // after being returned in a waitMany batch
+        // Record remains valid until the next wait or waitMany call
+        // so that the rest of the batch can be safely skipped over.
+        char removed;
+        
+
+        // used internally
+        char watchWrite;
+        // false for one-shot records that have been reported but not
+        // re-armed yet
+        char armed;
+        
+        // native socket ID that this record is indexed by
+        int nativeID;
+        // position in SocketPoll's watched list, or -1 if not watched
+        int watchedIndex;
         
     } SocketOrServer;
 
 
 
+// how ready events are reported by a SocketPoll
+enum SocketPollTriggerMode {
+    // report a socket again on every wait call for as long as it 
+    // remains ready (the default)
+    socketPollLevel = 0,
+    // report a socket only when it becomes ready, caller must
+    // read (or write) until -2 (would-block) before it is reported again
+    socketPollEdge,
+    // report a socket once, then ignore it until rearmSocket is called
+    // (safe for handing sockets off to worker threads)
+    socketPollOneShot
+    };
+
+
+
 
 // watches a bunch of open sockets and socket servers for activity, and
 // returns ones that need attention
@@ -25,7 +68,10 @@ class SocketPoll {
 
     public:
         
-        SocketPoll();
+        // edge-triggered mode only supported by Linux implementation
+        // other platforms fall back to level-triggered reporting
+        // (one-shot mode is supported everywhere)
+        SocketPoll( SocketPollTriggerMode inMode = socketPollLevel );
         
         ~SocketPoll();
 
@@ -37,10 +83,13 @@ class SocketPoll {
 
 
         // watch for data ready to be read
+        // If inWatchWrite is true, also watch for space available
+        // for writing (useful when non-blocking sends return -2)
         //
         // returns true on success, false on failure
         char addSocket( Socket *inSock, 
-                        void *inOtherData = NULL );
+                        void *inOtherData = NULL,
+                        char inWatchWrite = false );
         
         // watch for incomming connections ready to be accepted
         //
@@ -49,6 +98,23 @@ class SocketPoll {
                               void *inOtherData = NULL );
 
 
+        // turns write-readiness watching on or off for a socket that 
+        // has already been added
+        // In one-shot mode, this also re-arms the socket.
+        //
+        // returns true on success, false on failure
+        char setWatchWrite( Socket *inSock, char inWatchWrite );
+
+
+        // in one-shot mode, re-enables reporting for a socket or
+        // server after it has been returned by wait or waitMany
+        // Has no effect in other modes.
+        //
+        // returns true on success, false on failure
+        char rearmSocket( Socket *inSock );
+        char rearmSocketServer( SocketServer *inServer );
+        
+
         void removeSocket( Socket *inSock );
         void removeSocketServer( SocketServer *inServer );
 
@@ -56,10 +122,42 @@ class SocketPoll {
         // waits for next event, and returns socket or server that
         // needs attention, along with its original inOtherData
         //
-        // returns NULL on timeout
+        // returns NULL on timeout or wakeUp
         //
         // -1 for no timeout
         SocketOrServer *wait( int inTimeoutMS = -1 );
+
+
+        // waits for events, and returns a batch of sockets or servers that
+        // need attention in a single call
+        //
+        // outReady must have room for inMaxReady pointers
+        //
+        // May return fewer than inMaxReady even when more are ready
+        // (the Linux implementation returns at most 256 per call), so
+        // call again to get the rest.
+        //
+        // Returned records stay valid until the next wait or waitMany 
+        // call, even if removed in the mean time.  Check their removed
+        // flag before handling them if handling one batch entry 
+        // can remove other sockets.
+        //
+        // returns number of records placed in outReady, 0 on timeout
+        //   or wakeUp, or -1 on error
+        //
+        // -1 for no timeout
+        int waitMany( SocketOrServer **outReady, int inMaxReady,
+                      int inTimeoutMS = -1 );
+
+
+        // makes a wait or waitMany call that is blocked in another
+        // thread return early (with nothing ready, if nothing else is),
+        // or, if none is blocked, makes the next call return right away
+        //
+        // Unlike the other methods, safe to call from any thread while
+        // another thread is waiting.
+        // (not supported on Windows, where waits run to their timeouts)
+        void wakeUp();
         
         
         // used by platform-specific implementations
@@ -67,6 +165,8 @@ class SocketPoll {
         
     protected:
         
+        SocketPollTriggerMode mMode;
+        
         SimpleVector<SocketOrServer*> mWatchedList;
         
 
@@ -77,7 +177,174 @@ class SocketPoll {
         
         // used by some implementations to do round-robin selects
         int mNextSocketOrServer;
+
+
+        // records removed since last wait or waitMany call
+        // recycled at the start of the next call
+        SimpleVector<SocketOrServer*> mRemovedList;
+        
+        // recycled records, ready for reuse by the next add
+        SimpleVector<SocketOrServer*> mFreeRecords;
+
+        // watched records indexed by native socket ID, NULL for
+        // IDs that aren't being watched
+        // (native socket IDs are small, densely allocated ints, so
+        //  a flat table gives constant-time lookup)
+        SimpleVector<SocketOrServer*> mIDIndex;
+        
+        
+        // these are shared by all implementations, and are all
+        // constant time (except for the first time a high ID is seen)
+        
+        // gets a record from the free pool (or makes a new one),
+        // fills it in, and indexes it
+        // any stale record that was indexed by inNativeID is retired
+        SocketOrServer *newRecord( int inNativeID,
+                                   Socket *inSock, SocketServer *inServer,
+                                   void *inOtherData, char inWatchWrite );
+        
+        // un-indexes a record and queues it for recycling
+        void retireRecord( SocketOrServer *inS );
+        
+        // moves records removed since last wait back into free pool
+        void clearRemoved();
+        
+        // finds watched record in index, or NULL
+        SocketOrServer *lookupID( int inNativeID );
+        SocketOrServer *findSocket( Socket *inSock );
+        SocketOrServer *findSocketServer( SocketServer *inServer );
+
+        // destroys all records, for destructor
+        void deleteAllRecords();
         
     };
 
 
+
+inline SocketOrServer *SocketPoll::lookupID( int inNativeID ) {
+    if( inNativeID < 0 || inNativeID >= mIDIndex.size() ) {
+        return NULL;
+        }
+    return mIDIndex.getElementDirectFast( inNativeID );
+    }
+
+
+
+inline SocketOrServer *SocketPoll::findSocket( Socket *inSock ) {
+    SocketOrServer *s = lookupID( inSock->mNativeSocketID );
+    
+    if( s != NULL && s->sock == inSock ) {
+        return s;
+        }
+    return NULL;
+    }
+
+
+
+inline SocketOrServer *SocketPoll::findSocketServer( 
+    SocketServer *inServer ) {
+    
+    SocketOrServer *s = lookupID( inServer->mNativeSocketID );
+    
+    if( s != NULL && s->server == inServer ) {
+        return s;
+        }
+    return NULL;
+    }
+
+
+
+inline SocketOrServer *SocketPoll::newRecord( int inNativeID,
+                                              Socket *inSock, 
+                                              SocketServer *inServer,
+                                              void *inOtherData, 
+                                              char inWatchWrite ) {
+    
+    SocketOrServer *stale = lookupID( inNativeID );
+    
+    if( stale != NULL ) {
+        // native ID reused by a new socket after old socket destroyed
+        // without being removed (or same socket added twice)
+        retireRecord( stale );
+        }
+    
+    
+    SocketOrServer *s;
+    
+    if( mFreeRecords.size() > 0 ) {
+        s = mFreeRecords.getLastElementDirect();
+        mFreeRecords.deleteLastElement();
+        }
+    else {
+        s = new SocketOrServer;
+        }
+    
+    s->isSocket = ( inSock != NULL );
+    s->sock = inSock;
+    s->server = inServer;
+    s->otherData = inOtherData;
+    s->readReady = false;
+    s->writeReady = false;
+    s->removed = false;
+    s->watchWrite = inWatchWrite;
+    s->armed = true;
+    s->nativeID = inNativeID;
+    
+    s->watchedIndex = mWatchedList.size();
+    mWatchedList.push_back( s );
+    
+    while( mIDIndex.size() <= inNativeID ) {
+        mIDIndex.push_back( NULL );
+        }
+    *( mIDIndex.getElementFast( inNativeID ) ) = s;
+    
+    return s;
+    }
+
+
+
+inline void SocketPoll::retireRecord( SocketOrServer *inS ) {
+    
+    // swap last watched record into our spot
+    SocketOrServer *last = mWatchedList.getLastElementDirect();
+    
+    *( mWatchedList.getElementFast( inS->watchedIndex ) ) = last;
+    last->watchedIndex = inS->watchedIndex;
+    
+    mWatchedList.deleteLastElement();
+    
+    *( mIDIndex.getElementFast( inS->nativeID ) ) = NULL;
+
+    inS->watchedIndex = -1;
+    
+    // may still be referenced by caller's waitMany batch
+    inS->removed = true;
+    mRemovedList.push_back( inS );
+    }
+
+
+
+inline void SocketPoll::clearRemoved() {
+    mFreeRecords.push_back_other( &mRemovedList );
+    mRemovedList.deleteAll();
+    }
+
+
+
+inline void SocketPoll::deleteAllRecords() {
+    clearRemoved();
+    
+    for( int i=0; i<mWatchedList.size(); i++ ) {
+        delete mWatchedList.getElementDirect( i );
+        }
+    for( int i=0; i<mFreeRecords.size(); i++ ) {
+        delete mFreeRecords.getElementDirect( i );
+        }
+    mWatchedList.deleteAll();
+    mFreeRecords.deleteAll();
+    mIDIndex.deleteAll();
+    }
+
+
+
+#endif
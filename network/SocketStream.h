@@ -87,9 +87,23 @@ class SocketStream : public InputStream, public OutputStream {
         // in addition, -2 is returned if the read times out.
 		virtual long read( unsigned char *inBuffer, long inNumBytes );
 		
+        // overrides InputStream::readAvailable
+        // with no read timeout, waits for at least one byte, 
+        // but not for all of them
+        // with a timeout, same as read
+        virtual long readAvailable( unsigned char *inBuffer, 
+                                    long inNumBytes );
+        
 		
 		// implements the OutputStream interface
 		virtual long write( unsigned char *inBuffer, long inNumBytes );
+
+
+        // overrides OutputStream::writeSlices
+        // sends all slices with one system call when the socket can
+        // take them
+        virtual long writeSlices( OutputStreamSlice *inSlices,
+                                  int inNumSlices );
 		
 		
 	protected:
@@ -138,6 +152,31 @@ inline long SocketStream::read( unsigned char *inBuffer, long inNumBytes ) {
 		
 		
 
+inline long SocketStream::readAvailable( unsigned char *inBuffer, 
+                                        long inNumBytes ) {
+    if( mReadTimeout != -1 ) {
+        // timed receive already returns only available data
+        return SocketStream::read( inBuffer, inNumBytes );
+        }
+    
+    // take what has arrived without waiting
+    int numReceived = mSocket->receive( inBuffer, inNumBytes, 0 );
+    
+    while( numReceived == -2 ) {
+        // nothing yet, wait for some
+        numReceived = mSocket->receive( inBuffer, inNumBytes, 1000 );
+        }
+    
+	if( numReceived == -1 ) {
+		// socket error
+		InputStream::setNewLastErrorConst(
+            "Network socket error on receive." );
+		}
+	return numReceived;	
+	}
+
+
+
 inline long SocketStream::write( unsigned char *inBuffer, long inNumBytes ) {
     long numTotalSent = 0;
 
@@ -162,6 +201,66 @@ inline long SocketStream::write( unsigned char *inBuffer, long inNumBytes ) {
     
 	return numTotalSent;	
 	}
+
+
+
+
+inline long SocketStream::writeSlices( OutputStreamSlice *inSlices,
+                                       int inNumSlices ) {
+
+    SocketSendSlice *slices = new SocketSendSlice[ inNumSlices ];
+
+    for( int i=0; i<inNumSlices; i++ ) {
+        slices[i].buffer = inSlices[i].buffer;
+        slices[i].numBytes = (int)( inSlices[i].numBytes );
+        }
+
+    long numTotalSent = 0;
+    int firstSlice = 0;
+
+    while( true ) {
+        while( firstSlice < inNumSlices && 
+               slices[ firstSlice ].numBytes == 0 ) {
+            firstSlice++;
+            }
+
+        if( firstSlice == inNumSlices ) {
+            break;
+            }
+
+        int numSent = mSocket->sendv( &( slices[ firstSlice ] ),
+                                      inNumSlices - firstSlice );
+
+        if( numSent == -1 || numSent == 0 ) {
+            // socket error
+            OutputStream::setNewLastErrorConst(
+                "Network socket error on send." );
+            delete [] slices;
+            return -1;
+            }
+
+        numTotalSent += numSent;
+
+        // skip what was sent, which may end in the middle of a slice
+        while( numSent > 0 ) {
+            SocketSendSlice *slice = &( slices[ firstSlice ] );
+
+            if( numSent >= slice->numBytes ) {
+                numSent -= slice->numBytes;
+                firstSlice++;
+                }
+            else {
+                slice->buffer = &( slice->buffer[ numSent ] );
+                slice->numBytes -= numSent;
+                numSent = 0;
+                }
+            }
+        }
+
+    delete [] slices;
+
+    return numTotalSent;
+    }
 	
 	
 	
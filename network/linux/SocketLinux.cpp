@@ -107,6 +107,17 @@
 #include <unistd.h>
 #include <signal.h>
 #include <errno.h>
+#include <sys/uio.h>
+#include <limits.h>
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+// some platforms don't define IOV_MAX in limits.h
+#ifndef IOV_MAX
+#define IOV_MAX 16
+#endif
 
 
 
@@ -295,6 +306,192 @@ int Socket::send( unsigned char *inBuffer, int inNumBytes,
     }
 		
 		
+int Socket::sendv( SocketSendSlice *inSlices, int inNumSlices,
+                   char inAllowedToBlock,
+                   char inAllowDelay ) {
+
+    if( ! inAllowDelay ) {
+        // turn nodelay on
+        setNoDelay( 1 );
+        }
+
+    int flags = 0;
+    
+    if( ! inAllowedToBlock ) {
+        // MSG_DONTWAIT avoids switching the whole socket into
+        // non-blocking mode and back
+        flags = MSG_DONTWAIT;
+        }
+    
+
+    struct iovec vectors[ IOV_MAX ];
+
+    int totalSent = 0;
+    int returnValue = 0;
+    
+    int sliceIndex = 0;
+    
+    // sendmsg can only take IOV_MAX slices at a time
+    while( sliceIndex < inNumSlices ) {
+        
+        int numVectors = 0;
+        int batchBytes = 0;
+        
+        while( sliceIndex < inNumSlices && numVectors < IOV_MAX ) {
+            vectors[ numVectors ].iov_base = inSlices[ sliceIndex ].buffer;
+            vectors[ numVectors ].iov_len = inSlices[ sliceIndex ].numBytes;
+            
+            batchBytes += inSlices[ sliceIndex ].numBytes;
+            
+            numVectors++;
+            sliceIndex++;
+            }
+        
+        struct msghdr message;
+        memset( &message, 0, sizeof( message ) );
+        
+        message.msg_iov = vectors;
+        message.msg_iovlen = numVectors;
+        
+        returnValue = sendmsg( mNativeSocketID, &message, flags );
+
+        if( returnValue > 0 ) {
+            totalSent += returnValue;
+            }
+
+        if( returnValue != batchBytes ) {
+            // error or partial send, stop here
+            break;
+            }
+        }
+    
+    
+    if( ! inAllowDelay ) {
+        // turn nodelay back off
+        setNoDelay( 0 );
+        }
+
+    
+    if( returnValue == -1 ) {
+        if( totalSent > 0 ) {
+            // report what made it through, error will show up again
+            // on next send
+            return totalSent;
+            }
+        
+        if( errno == EAGAIN || errno == EWOULDBLOCK ) {
+            return -2;
+            }
+        return -1;
+        }
+    
+    return totalSent;
+    }
+
+
+
+long Socket::sendFile( FILE *inFile, long inOffset, long inNumBytes,
+                       char inAllowedToBlock ) {
+
+    int fileID = fileno( inFile );
+
+    if( ! inAllowedToBlock ) {
+        // set to non-blocking mode
+        int result = fcntl( mNativeSocketID, F_SETFL, O_NONBLOCK );
+        
+        if( result < 0 ) {
+            return result;
+            }
+        }
+    
+
+    long totalSent = 0;
+    char error = false;
+    char wouldBlock = false;
+    
+#ifndef __linux__
+    // no portable zero-copy call, so stage through a buffer
+    // using positional reads, which leave file position alone
+    int bufferSize = 65536;
+    unsigned char *buffer = new unsigned char[ bufferSize ];
+#endif
+
+    while( totalSent < inNumBytes ) {
+        
+        long numToSend = inNumBytes - totalSent;
+
+#ifdef __linux__
+        off_t offset = inOffset + totalSent;
+        
+        long numSent = sendfile( mNativeSocketID, fileID, &offset, 
+                                 numToSend );
+#else
+        if( numToSend > bufferSize ) {
+            numToSend = bufferSize;
+            }
+        
+        long numRead = pread( fileID, buffer, numToSend, 
+                              inOffset + totalSent );
+        
+        if( numRead <= 0 ) {
+            // error or end of file
+            error = true;
+            break;
+            }
+        numToSend = numRead;
+        
+        long numSent = ::send( mNativeSocketID, buffer, numToSend, 0 );
+#endif
+
+        if( numSent == -1 ) {
+            if( errno == EINTR ) {
+                continue;
+                }
+            if( errno == EAGAIN || errno == EWOULDBLOCK ) {
+                wouldBlock = true;
+                }
+            else {
+                error = true;
+                }
+            break;
+            }
+        else if( numSent == 0 ) {
+            // file shorter than requested
+            error = true;
+            break;
+            }
+        
+        totalSent += numSent;
+        
+        if( ! inAllowedToBlock && numSent < numToSend ) {
+            // socket buffer full, don't spin on it
+            break;
+            }
+        }
+
+#ifndef __linux__
+    delete [] buffer;
+#endif
+
+    if( ! inAllowedToBlock ) {
+        // back into blocking mode
+        fcntl( mNativeSocketID, F_SETFL, 0 );
+        }
+    
+    if( totalSent > 0 ) {
+        return totalSent;
+        }
+    if( wouldBlock ) {
+        return -2;
+        }
+    if( error ) {
+        return -1;
+        }
+    return totalSent;
+    }
+
+
+		
 int Socket::receive( unsigned char *inBuffer, int inNumBytes,
 	long inTimeout ) {
 	
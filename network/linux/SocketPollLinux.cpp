@@ -1,17 +1,42 @@
-
 #include "minorGems/network/SocketPoll.h"
 
 #include <sys/epoll.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
 
 
 
-SocketPoll::SocketPoll() {
-    int *epollStorage = new int[1];
+// epoll handle, then read and write ends of our wakeUp pipe
+SocketPoll::SocketPoll( SocketPollTriggerMode inMode )
+        : mMode( inMode ) {
+    int *epollStorage = new int[3];
 
     // a non-zero starting size value that is ignored by newer kernels
 	epollStorage[0] = epoll_create( 10 );
 
+    epollStorage[1] = -1;
+    epollStorage[2] = -1;
+
+    int pipeEnds[2];
+    
+    if( epollStorage[0] != -1 && pipe( pipeEnds ) == 0 ) {
+        // never block on a full or empty pipe
+        fcntl( pipeEnds[0], F_SETFL, O_NONBLOCK );
+        fcntl( pipeEnds[1], F_SETFL, O_NONBLOCK );
+        
+        epollStorage[1] = pipeEnds[0];
+        epollStorage[2] = pipeEnds[1];
+
+        // level-triggered in every mode, with a NULL record to tell
+        // it apart from watched sockets
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u64 = 0;
+        ev.data.ptr = NULL;
+        
+        epoll_ctl( epollStorage[0], EPOLL_CTL_ADD, pipeEnds[0], &ev );
+        }
     
 	mNativeObjectPointer = (void *)epollStorage;
     
@@ -26,52 +51,65 @@ SocketPoll::~SocketPoll() {
     if( epollHandle != -1 ) {
         close( epollHandle );
         }
+    if( epollStorage[1] != -1 ) {
+        close( epollStorage[1] );
+        close( epollStorage[2] );
+        }
 
     delete [] epollStorage;
 
-    for( int i=0; i<mWatchedList.size(); i++ ) {
-        SocketOrServer *s = *( mWatchedList.getElement( i ) );
-        delete s;
-        }
+    deleteAllRecords();
     }
 
 
 
-
-char SocketPoll::addSocket( Socket *inSock, void *inOtherData ) {
-
-    int *epollStorage = (int *)( mNativeObjectPointer );
-	int epollHandle = epollStorage[0];
-
-    if( epollHandle == -1 ) {
-        return false;
+static unsigned int getEventMask( SocketPollTriggerMode inMode,
+                                  SocketOrServer *inS ) {
+    unsigned int events = EPOLLIN;
+    
+    if( inS->isSocket ) {
+        events |= EPOLLPRI | EPOLLERR | EPOLLHUP;
+        
+        if( inS->watchWrite ) {
+            events |= EPOLLOUT;
+            }
         }
     
-
-	int socketID = inSock->mNativeSocketID;
+    switch( inMode ) {
+        case socketPollEdge:
+            events |= EPOLLET;
+            break;
+        case socketPollOneShot:
+            events |= EPOLLONESHOT;
+            break;
+        default:
+            break;
+        }
+    
+    return events;
+    }
 
 
 
-    SocketOrServer *s = new SocketOrServer;
-    
-    s->isSocket = true;
-    s->sock = inSock;
-    s->server = NULL;
-    s->otherData = inOtherData;
-    
-    mWatchedList.push_back( s );
-    
-
+// inOp is EPOLL_CTL_ADD or EPOLL_CTL_MOD
+static char controlEvents( int inEpollHandle, int inOp, int inSocketID,
+                           SocketPollTriggerMode inMode,
+                           SocketOrServer *inS ) {
     struct epoll_event ev;
-    ev.events = EPOLLIN | EPOLLPRI | EPOLLERR | EPOLLHUP;
+    ev.events = getEventMask( inMode, inS );
     // clear entire union to suppress valgrind uninit errors on platforms
     // with 32-bit pointers
     ev.data.u64 = 0;
     
     // store our pointer
-    ev.data.ptr = s;
+    ev.data.ptr = inS;
+
+    int result = epoll_ctl( inEpollHandle, inOp, inSocketID, &ev );
 
-    int result = epoll_ctl( epollHandle, EPOLL_CTL_ADD, socketID, &ev );
+    if( result != 0 && inOp == EPOLL_CTL_ADD && errno == EEXIST ) {
+        // same socket added again, replace its record
+        result = epoll_ctl( inEpollHandle, EPOLL_CTL_MOD, inSocketID, &ev );
+        }
 
     if( result == 0 ) {
         return true;
@@ -79,6 +117,38 @@ char SocketPoll::addSocket( Socket *inSock, void *inOtherData ) {
     return false;
     }
 
+
+
+char SocketPoll::addSocket( Socket *inSock, void *inOtherData,
+                            char inWatchWrite ) {
+
+    int *epollStorage = (int *)( mNativeObjectPointer );
+	int epollHandle = epollStorage[0];
+
+    if( epollHandle == -1 ) {
+        return false;
+        }
+    
+
+	int socketID = inSock->mNativeSocketID;
+
+    SocketOrServer *s = newRecord( socketID, inSock, NULL, inOtherData,
+                                   inWatchWrite );
+    
+    if( ! controlEvents( epollHandle, EPOLL_CTL_ADD, socketID, mMode, s ) ) {
+        // don't leave epoll or our index pointing at the record
+        // (if this ID was already added, epoll may still point at
+        //  the old record that newRecord replaced)
+        struct epoll_event ev;
+        epoll_ctl( epollHandle, EPOLL_CTL_DEL, socketID, &ev );
+
+        retireRecord( s );
+        return false;
+        }
+
+    return true;
+    }
+
         
 
 
@@ -94,60 +164,107 @@ char SocketPoll::addSocketServer( SocketServer *inServer, void *inOtherData ) {
 
 	int socketID = inServer->mNativeSocketID;
 
+    SocketOrServer *s = newRecord( socketID, NULL, inServer, inOtherData,
+                                   false );
+    
+    if( ! controlEvents( epollHandle, EPOLL_CTL_ADD, socketID, mMode, s ) ) {
+        // don't leave epoll or our index pointing at the record
+        // (if this ID was already added, epoll may still point at
+        //  the old record that newRecord replaced)
+        struct epoll_event ev;
+        epoll_ctl( epollHandle, EPOLL_CTL_DEL, socketID, &ev );
+
+        retireRecord( s );
+        return false;
+        }
+
+    return true;
+    }
+
+
 
+char SocketPoll::setWatchWrite( Socket *inSock, char inWatchWrite ) {
+    int *epollStorage = (int *)( mNativeObjectPointer );
+    int epollHandle = epollStorage[0];
 
-    SocketOrServer *s = new SocketOrServer;
+    if( epollHandle == -1 ) {
+        return false;
+        }
     
-    s->isSocket = false;
-    s->sock = NULL;
-    s->server = inServer;
-    s->otherData = inOtherData;
+    SocketOrServer *s = findSocket( inSock );
     
-    mWatchedList.push_back( s );
+    if( s == NULL ) {
+        return false;
+        }
     
-
-    struct epoll_event ev;
-    ev.events = EPOLLIN;
-    // clear entire union to suppress valgrind uninit errors on platforms
-    // with 32-bit pointers
-    ev.data.u64 = 0;
+    s->watchWrite = inWatchWrite;
+    s->armed = true;
     
-    // store our pointer
-    ev.data.ptr = s;
+    return controlEvents( epollHandle, EPOLL_CTL_MOD, inSock->mNativeSocketID,
+                          mMode, s );
+    }
 
-    int result = epoll_ctl( epollHandle, EPOLL_CTL_ADD, socketID, &ev );
 
-    if( result == 0 ) {
+
+char SocketPoll::rearmSocket( Socket *inSock ) {
+    if( mMode != socketPollOneShot ) {
         return true;
         }
-    return false;    
+    
+    SocketOrServer *s = findSocket( inSock );
+    
+    if( s == NULL ) {
+        return false;
+        }
+
+    // keep existing write watching
+    return setWatchWrite( inSock, s->watchWrite );
     }
 
 
 
-void SocketPoll::removeSocket( Socket *inSock ) {
+char SocketPoll::rearmSocketServer( SocketServer *inServer ) {
+    if( mMode != socketPollOneShot ) {
+        return true;
+        }
+    
     int *epollStorage = (int *)( mNativeObjectPointer );
     int epollHandle = epollStorage[0];
 
     if( epollHandle == -1 ) {
-        return;
+        return false;
         }
 
-	int socketID = inSock->mNativeSocketID;
+    SocketOrServer *s = findSocketServer( inServer );
+    
+    if( s == NULL ) {
+        return false;
+        }
+    
+    s->armed = true;
+    
+    return controlEvents( epollHandle, EPOLL_CTL_MOD, 
+                          inServer->mNativeSocketID, mMode, s );
+    }
 
 
 
-    for( int i=0; i<mWatchedList.size(); i++ ) {
-        SocketOrServer *s = *( mWatchedList.getElement( i ) );
-        if( s->sock == inSock ) {
-            struct epoll_event ev;
-            
-            epoll_ctl( epollHandle, EPOLL_CTL_DEL, socketID, &ev );
+void SocketPoll::removeSocket( Socket *inSock ) {
+    int *epollStorage = (int *)( mNativeObjectPointer );
+    int epollHandle = epollStorage[0];
+
+    if( epollHandle == -1 ) {
+        return;
+        }
 
-            delete s;
-            mWatchedList.deleteElement( i );
-            return;
-            }
+    SocketOrServer *s = findSocket( inSock );
+    
+    if( s != NULL ) {
+        struct epoll_event ev;
+        
+        epoll_ctl( epollHandle, EPOLL_CTL_DEL, s->nativeID, &ev );
+        
+        retireRecord( s );
         }
     }
 
@@ -159,44 +276,122 @@ void SocketPoll::removeSocketServer( SocketServer *inServer ) {
         return;
         }
 
-	int socketID = inServer->mNativeSocketID;
-
+    SocketOrServer *s = findSocketServer( inServer );
+    
+    if( s != NULL ) {
+        struct epoll_event ev;
+        
+        epoll_ctl( epollHandle, EPOLL_CTL_DEL, s->nativeID, &ev );
+        
+        retireRecord( s );
+        }
+    }
 
 
-    for( int i=0; i<mWatchedList.size(); i++ ) {
-        SocketOrServer *s = *( mWatchedList.getElement( i ) );
-        if( s->server == inServer ) {
-            struct epoll_event ev;
-            
-            epoll_ctl( epollHandle, EPOLL_CTL_DEL, socketID, &ev );
 
-            delete s;
-            mWatchedList.deleteElement( i );
-            return;
-            }
+void SocketPoll::wakeUp() {
+    int *epollStorage = (int *)( mNativeObjectPointer );
+    
+    if( epollStorage[2] != -1 ) {
+        // if pipe is full, a wake-up is already pending
+        char wakeByte = 0;
+        int numWritten = write( epollStorage[2], &wakeByte, 1 );
+        (void)numWritten;
         }
     }
 
 
 
+// fills in ready flags of record attached to an event
+static SocketOrServer *processEvent( SocketPollTriggerMode inMode,
+                                     struct epoll_event *inEvent ) {
+    SocketOrServer *s = (SocketOrServer *)( inEvent->data.ptr );
+    
+    unsigned int events = inEvent->events;
+
+    // errors and hangups count as read-ready, so that the following
+    // receive call returns the error
+    s->readReady = 
+        ( events & ( EPOLLIN | EPOLLPRI | EPOLLERR | EPOLLHUP ) ) != 0;
+    s->writeReady = ( events & EPOLLOUT ) != 0;
+    
+    if( inMode == socketPollOneShot ) {
+        s->armed = false;
+        }
+    
+    return s;
+    }
+
+
 
 SocketOrServer *SocketPoll::wait( int inTimeoutMS ) {
+    SocketOrServer *result;
+    
+    int numReady = waitMany( &result, 1, inTimeoutMS );
+    
+    if( numReady <= 0 ) {
+        // timeout or error
+        return NULL;
+        }
+    
+    return result;
+    }
+
+
+
+// number of events pulled out of kernel per epoll_wait call
+// (waitMany returns at most this many per call)
+#define EPOLL_BATCH_SIZE 256
+
+
+
+int SocketPoll::waitMany( SocketOrServer **outReady, int inMaxReady,
+                          int inTimeoutMS ) {
     int *epollStorage = (int *)( mNativeObjectPointer );
     int epollHandle = epollStorage[0];
 
+    // any records removed during handling of last batch are safe
+    // to recycle now
+    clearRemoved();
+    
+    if( epollHandle == -1 ) {
+        return -1;
+        }
+    
+    if( inMaxReady > EPOLL_BATCH_SIZE ) {
+        inMaxReady = EPOLL_BATCH_SIZE;
+        }
+    
 
-    struct epoll_event returnedEvents[1];
+    struct epoll_event returnedEvents[ EPOLL_BATCH_SIZE ];
 
-    int numEvents = epoll_wait( epollHandle, returnedEvents, 1, inTimeoutMS );
+    int numEvents = epoll_wait( epollHandle, returnedEvents, inMaxReady, 
+                                inTimeoutMS );
 
-    if( numEvents <= 0 ) {
-        // timeout or error
-        return NULL;
+    if( numEvents < 0 ) {
+        // EINTR is not an error from our caller's point of view
+        if( errno == EINTR ) {
+            return 0;
+            }
+        return -1;
         }
     
+    int numReady = 0;
     
-    // else we have an event!
-    
-    return (SocketOrServer *)( returnedEvents[0].data.ptr );
+    for( int i=0; i<numEvents; i++ ) {
+        if( returnedEvents[i].data.ptr == NULL ) {
+            // woken up, empty pipe so we don't wake again for this
+            char wakeBytes[64];
+            while( read( epollStorage[1], wakeBytes, 64 ) > 0 ) {
+                }
+            }
+        else {
+            outReady[ numReady ] = 
+                processEvent( mMode, &( returnedEvents[i] ) );
+            numReady++;
+            }
+        }
+
+    return numReady;
     }
 
@@ -12,99 +12,208 @@
 
 #include "DuplicateMessageDetector.h"
 
-#include "minorGems/util/stringUtils.h"
+#include "minorGems/util/HashSlotTable.h"
 
 #include <time.h>
 #include <stdio.h>
+#include <string.h>
+
+
+
+struct DuplicateHistoryEntry {
+        char *mID;
+        // bytes allocated for mID, so evicted entries can reuse it
+        int mIDSpace;
+        unsigned int mHash;
+
+        // -1 at the ends of the list
+        int mOlder;
+        int mNewer;
+    };
+
+
+
+// matches the entry holding an ID, for HashSlotTable
+struct DuplicateIDMatcher {
+        DuplicateHistoryEntry *mEntries;
+        char *mID;
+
+        char operator()( int inIndex ) {
+            return strcmp( mEntries[ inIndex ].mID, mID ) == 0;
+            }
+    };
 
 
 
 DuplicateMessageDetector::DuplicateMessageDetector( int inMessageHistorySize )
     : mMaxHistorySize( inMessageHistorySize ),
       mLock( new MutexLock() ),
-      mSeenIDs( new SimpleVector<char *>() ),
+      mNumEntries( 0 ),
+      mOldestEntry( -1 ),
+      mNewestEntry( -1 ),
       mTotalMessageCount( 0 ),
-      mHistoryOutputFile( NULL ) {
+      mHistoryOutputFile( NULL ),
+      mLastFlushTime( 0 ) {
+
+    if( mMaxHistorySize < 1 ) {
+        mMaxHistorySize = 1;
+        }
+
+    mEntries = new DuplicateHistoryEntry[ mMaxHistorySize ];
+
+    mSlots = new HashSlotTable( mMaxHistorySize );
 
     mHistoryOutputFile = fopen( "messageHistory.log", "w" );
+
+    if( mHistoryOutputFile != NULL ) {
+        setvbuf( mHistoryOutputFile, NULL, _IOFBF, 65536 );
+        }
     }
 
 
 
 DuplicateMessageDetector::~DuplicateMessageDetector() {
-    int numIDs = mSeenIDs->size();
-
-    for( int i=0; i<numIDs; i++ ) {
-        delete [] *( mSeenIDs->getElement( i ) );
+    for( int i=0; i<mNumEntries; i++ ) {
+        delete [] mEntries[i].mID;
         }
-    delete mSeenIDs;
+    delete [] mEntries;
+    delete mSlots;
 
     delete mLock;
 
-    fclose( mHistoryOutputFile );
+    if( mHistoryOutputFile != NULL ) {
+        fclose( mHistoryOutputFile );
+        }
     }
 
 
 
-char DuplicateMessageDetector::checkIfMessageSeen( char *inMessageUniqueID ) {
-    mLock->lock();
+HashSlot *DuplicateMessageDetector::findSlot( unsigned int inHash,
+                                              char *inID ) {
+    DuplicateIDMatcher matcher = { mEntries, inID };
 
-    mTotalMessageCount++;
-    
-    int numIDs = mSeenIDs->size();
+    return mSlots->findSlot( inHash, matcher );
+    }
 
-    char matchSeen = false;
-    for( int i=0; i<numIDs && !matchSeen; i++ ) {
 
-        char *otherID = *( mSeenIDs->getElement( i ) ); 
 
-        if( strcmp( otherID, inMessageUniqueID ) == 0 ) {
-            // match
+void DuplicateMessageDetector::unlinkEntry( int inIndex ) {
+    DuplicateHistoryEntry *entry = &( mEntries[ inIndex ] );
 
-            // push the ID back to the end of the queue
-            mSeenIDs->deleteElement( i );
-            mSeenIDs->push_back( otherID );
-            matchSeen = true;
-            }
+    if( entry->mOlder != -1 ) {
+        mEntries[ entry->mOlder ].mNewer = entry->mNewer;
+        }
+    else {
+        mOldestEntry = entry->mNewer;
         }
 
-    if( mHistoryOutputFile != NULL ) {
-        fprintf( mHistoryOutputFile,
-                 "%d %d %s",
-                 mTotalMessageCount,
-                 (int)( time( NULL ) ),
-                 inMessageUniqueID );
+    if( entry->mNewer != -1 ) {
+        mEntries[ entry->mNewer ].mOlder = entry->mOlder;
         }
-    
-    
-    if( !matchSeen ) {
+    else {
+        mNewestEntry = entry->mOlder;
+        }
+    }
 
-        // add the message
-        mSeenIDs->push_back( stringDuplicate( inMessageUniqueID ) );
 
-        // make sure history not too long
-        if( mSeenIDs->size() > mMaxHistorySize ) {
-            delete [] *( mSeenIDs->getElement( 0 ) );
-            mSeenIDs->deleteElement( 0 );
-            }
 
-        if( mHistoryOutputFile != NULL ) {
-            fprintf( mHistoryOutputFile, "\n" );
+void DuplicateMessageDetector::linkNewestEntry( int inIndex ) {
+    DuplicateHistoryEntry *entry = &( mEntries[ inIndex ] );
+
+    entry->mOlder = mNewestEntry;
+    entry->mNewer = -1;
+
+    if( mNewestEntry != -1 ) {
+        mEntries[ mNewestEntry ].mNewer = inIndex;
+        }
+    else {
+        mOldestEntry = inIndex;
+        }
+    mNewestEntry = inIndex;
+    }
+
+
+
+char DuplicateMessageDetector::checkIfMessageSeen( char *inMessageUniqueID ) {
+    unsigned int hash = fnvHashString( FNV_HASH_START, inMessageUniqueID );
+
+    mLock->lock();
+
+    mTotalMessageCount++;
+
+    HashSlot *slot = findSlot( hash, inMessageUniqueID );
+
+    char matchSeen = ( slot->mIndex != -1 );
+
+    if( matchSeen ) {
+        // move the ID to the end of the queue
+        if( slot->mIndex != mNewestEntry ) {
+            unlinkEntry( slot->mIndex );
+            linkNewestEntry( slot->mIndex );
             }
         }
     else {
-        // add duplicate tag
-        if( mHistoryOutputFile != NULL ) {
-            fprintf( mHistoryOutputFile, " D\n" );
+        int index;
+
+        if( mNumEntries < mMaxHistorySize ) {
+            index = mNumEntries;
+            mNumEntries++;
+
+            mEntries[ index ].mID = NULL;
+            mEntries[ index ].mIDSpace = 0;
+            }
+        else {
+            // history full, drop the oldest ID
+            index = mOldestEntry;
+
+            DuplicateHistoryEntry *oldest = &( mEntries[ index ] );
+
+            mSlots->removeSlot( findSlot( oldest->mHash, oldest->mID ) );
+            unlinkEntry( index );
+
+            // removal may have moved the empty slot we found
+            slot = findSlot( hash, inMessageUniqueID );
+            }
+
+        DuplicateHistoryEntry *entry = &( mEntries[ index ] );
+
+        int length = strlen( inMessageUniqueID );
+
+        if( length + 1 > entry->mIDSpace ) {
+            if( entry->mID != NULL ) {
+                delete [] entry->mID;
+                }
+            entry->mID = new char[ length + 1 ];
+            entry->mIDSpace = length + 1;
             }
+        memcpy( entry->mID, inMessageUniqueID, length + 1 );
+
+        entry->mHash = hash;
+
+        linkNewestEntry( index );
+
+        slot->mHash = hash;
+        slot->mIndex = index;
         }
 
     if( mHistoryOutputFile != NULL ) {
-        fflush( mHistoryOutputFile );
+        time_t currentTime = time( NULL );
+
+        fprintf( mHistoryOutputFile,
+                 "%d %d %s%s\n",
+                 mTotalMessageCount,
+                 (int)currentTime,
+                 inMessageUniqueID,
+                 // duplicate tag
+                 matchSeen ? " D" : "" );
+
+        // buffered, but still readable as it grows
+        if( currentTime != mLastFlushTime ) {
+            fflush( mHistoryOutputFile );
+            mLastFlushTime = currentTime;
+            }
         }
     
     mLock->unlock();    
     return matchSeen;    
     }
-
-
@@ -16,11 +16,19 @@
 
 
 #include "minorGems/system/MutexLock.h"
-#include "minorGems/util/SimpleVector.h"
 
 
 
 #include <stdio.h>
+#include <time.h>
+
+
+
+// kept out of this header, see DuplicateMessageDetector.cpp
+struct DuplicateHistoryEntry;
+
+class HashSlotTable;
+struct HashSlot;
 
 
 
@@ -28,6 +36,10 @@
  * Class that detects duplicates of past messages so that they can be
  * discarded.
  *
+ * Each check takes constant time, regardless of history size:  IDs are
+ * found through a hash table, and the least recently seen ID is dropped
+ * when the history is full.
+ *
  * @author Jason Rohrer
  */
 class DuplicateMessageDetector {
@@ -67,11 +79,30 @@ class DuplicateMessageDetector {
 
         int mMaxHistorySize;
         MutexLock *mLock;
-        SimpleVector<char *> *mSeenIDs;
+
+        // seen IDs, linked from least to most recently seen
+        DuplicateHistoryEntry *mEntries;
+        int mNumEntries;
+        int mOldestEntry;
+        int mNewestEntry;
+
+        // entries by ID
+        HashSlotTable *mSlots;
         
 
         int mTotalMessageCount;
         FILE *mHistoryOutputFile;
+
+        // history is flushed at most once per second
+        time_t mLastFlushTime;
+
+
+        // returns the slot holding inID, or the empty slot where it
+        // would go
+        HashSlot *findSlot( unsigned int inHash, char *inID );
+
+        void unlinkEntry( int inIndex );
+        void linkNewestEntry( int inIndex );
         
     };
 
@@ -23,16 +23,102 @@
 
 #include "minorGems/network/p2pParts/HostCatcher.h"
 #include "minorGems/util/stringUtils.h"
+#include "minorGems/util/HashSlotTable.h"
 #include "minorGems/util/random/StdRandomSource.h"
 
+#include <string.h>
 
 
-HostCatcher::HostCatcher( int inMaxListSize )
+
+struct HostCatcherRecord {
+        // NULL if this record is unused
+        HostAddress *mHost;
+        unsigned int mHash;
+
+        // -1 at the ends of the list
+        int mOlder;
+        int mNewer;
+
+        int mSuccesses;
+        int mFailures;
+        int mFailuresInRow;
+
+        // smoothed, in seconds, or -1 if never measured
+        double mLatency;
+
+        double mWeight;
+    };
+
+
+
+// matches the record holding a host, for HashSlotTable
+struct HostCatcherMatcher {
+        HostCatcherRecord *mRecords;
+        char *mAddress;
+        int mPort;
+
+        char operator()( int inIndex ) {
+            HostAddress *host = mRecords[ inIndex ].mHost;
+
+            return host->mPort == mPort &&
+                strcmp( host->mAddressString, mAddress ) == 0;
+            }
+    };
+
+
+
+// latency assumed for hosts that have not been measured
+#define UNMEASURED_LATENCY 0.25
+
+// added to latencies so that a few very fast hosts don't crowd out
+// all of the others
+#define LATENCY_FLOOR 0.05
+
+// how far each new latency measurement moves the smoothed latency
+#define LATENCY_SMOOTHING 0.25
+
+
+
+static unsigned int hashHost( char *inAddress, int inPort ) {
+    return fnvHashInt( fnvHashString( FNV_HASH_START, inAddress ), inPort );
+    }
+
+
+
+static double computeWeight( HostCatcherRecord *inRecord ) {
+    // fraction of contacts that succeeded, starting from 1/2, squared
+    // so that failing hosts fall off quickly
+    double reliability = ( inRecord->mSuccesses + 1.0 ) /
+        ( inRecord->mSuccesses + inRecord->mFailures + 2.0 );
+
+    double latency = inRecord->mLatency;
+    if( latency < 0 ) {
+        latency = UNMEASURED_LATENCY;
+        }
+
+    return reliability * reliability / ( latency + LATENCY_FLOOR );
+    }
+
+
+
+HostCatcher::HostCatcher( int inMaxListSize, int inMaxFailures )
     : mMaxListSize( inMaxListSize ),
-      mHostVector( new SimpleVector<HostAddress *>() ),
+      mMaxFailures( inMaxFailures ),
+      mRecords( NULL ),
+      mNumRecords( 0 ),
+      mNumHosts( 0 ),
+      mOldestRecord( -1 ),
+      mNewestRecord( -1 ),
+      mFreeRecord( -1 ),
+      mSlots( NULL ),
+      mWeightTree( NULL ),
+      mWeightUpdateCount( 0 ),
       mLock( new MutexLock() ),
       mRandSource( new StdRandomSource() ) {
-    
+
+    if( mMaxFailures < 1 ) {
+        mMaxFailures = 1;
+        }
     }
 
 
@@ -40,13 +126,17 @@ HostCatcher::HostCatcher( int inMaxListSize )
 HostCatcher::~HostCatcher() {
     mLock->lock();
     
-    int numHosts = mHostVector->size();
-
-    for( int i=0; i<numHosts; i++ ) {
-        delete *( mHostVector->getElement( i ) );
+    for( int i=0; i<mNumRecords; i++ ) {
+        if( mRecords[i].mHost != NULL ) {
+            delete mRecords[i].mHost;
+            }
         }
 
-    delete mHostVector;
+    if( mRecords != NULL ) {
+        delete [] mRecords;
+        delete mSlots;
+        delete [] mWeightTree;
+        }
     
     mLock->unlock();
 
@@ -54,51 +144,233 @@ HostCatcher::~HostCatcher() {
     delete mRandSource;
     }
 
+
+
+HashSlot *HostCatcher::findSlot( unsigned int inHash,
+                                 char *inAddress, int inPort ) {
+    HostCatcherMatcher matcher = { mRecords, inAddress, inPort };
+
+    return mSlots->findSlot( inHash, matcher );
+    }
+
+
+
+int HostCatcher::findRecord( HostAddress *inHost ) {
+    if( mNumHosts == 0 ) {
+        return -1;
+        }
+
+    unsigned int hash = hashHost( inHost->mAddressString, inHost->mPort );
+
+    return findSlot( hash, inHost->mAddressString, inHost->mPort )->mIndex;
+    }
+
+
+
+void HostCatcher::unlinkRecord( int inIndex ) {
+    HostCatcherRecord *record = &( mRecords[ inIndex ] );
+
+    if( record->mOlder != -1 ) {
+        mRecords[ record->mOlder ].mNewer = record->mNewer;
+        }
+    else {
+        mOldestRecord = record->mNewer;
+        }
+
+    if( record->mNewer != -1 ) {
+        mRecords[ record->mNewer ].mOlder = record->mOlder;
+        }
+    else {
+        mNewestRecord = record->mOlder;
+        }
+    }
+
+
+
+void HostCatcher::linkNewestRecord( int inIndex ) {
+    HostCatcherRecord *record = &( mRecords[ inIndex ] );
+
+    record->mOlder = mNewestRecord;
+    record->mNewer = -1;
+
+    if( mNewestRecord != -1 ) {
+        mRecords[ mNewestRecord ].mNewer = inIndex;
+        }
+    else {
+        mOldestRecord = inIndex;
+        }
+    mNewestRecord = inIndex;
+    }
+
+
+
+void HostCatcher::removeRecord( int inIndex ) {
+    HostCatcherRecord *record = &( mRecords[ inIndex ] );
+
+    mSlots->removeSlot( findSlot( record->mHash,
+                                  record->mHost->mAddressString,
+                                  record->mHost->mPort ) );
+    unlinkRecord( inIndex );
+
+    delete record->mHost;
+    record->mHost = NULL;
+
+    setWeight( inIndex, 0 );
+
+    record->mNewer = mFreeRecord;
+    mFreeRecord = inIndex;
+
+    mNumHosts--;
+    }
+
+
+
+void HostCatcher::growRecords() {
+    int oldNumRecords = mNumRecords;
+
+    mNumRecords *= 2;
+    if( mNumRecords < 64 ) {
+        mNumRecords = 64;
+        }
+    if( mNumRecords > mMaxListSize ) {
+        mNumRecords = mMaxListSize;
+        }
+
+    HostCatcherRecord *newRecords = new HostCatcherRecord[ mNumRecords ];
+
+    if( mRecords != NULL ) {
+        memcpy( newRecords, mRecords,
+                oldNumRecords * sizeof( HostCatcherRecord ) );
+        delete [] mRecords;
+        delete mSlots;
+        delete [] mWeightTree;
+        }
+    mRecords = newRecords;
+
+    for( int i=mNumRecords - 1; i>=oldNumRecords; i-- ) {
+        mRecords[i].mHost = NULL;
+        mRecords[i].mWeight = 0;
+        mRecords[i].mNewer = mFreeRecord;
+        mFreeRecord = i;
+        }
+
+
+    mSlots = new HashSlotTable( mNumRecords );
+
+    for( int i=0; i<oldNumRecords; i++ ) {
+        HostCatcherRecord *record = &( mRecords[i] );
+
+        if( record->mHost != NULL ) {
+            HashSlot *slot =
+                findSlot( record->mHash, record->mHost->mAddressString,
+                          record->mHost->mPort );
+            slot->mHash = record->mHash;
+            slot->mIndex = i;
+            }
+        }
+
+
+    mWeightTree = new double[ mNumRecords + 1 ];
+    rebuildWeightTree();
+    }
+
+
+
+void HostCatcher::setWeight( int inIndex, double inWeight ) {
+    double change = inWeight - mRecords[ inIndex ].mWeight;
+
+    mRecords[ inIndex ].mWeight = inWeight;
+
+    for( int i=inIndex + 1; i<=mNumRecords; i += ( i & -i ) ) {
+        mWeightTree[i] += change;
+        }
+
+    mWeightUpdateCount++;
+
+    if( mWeightUpdateCount > mNumRecords ) {
+        rebuildWeightTree();
+        }
+    }
+
+
+
+void HostCatcher::rebuildWeightTree() {
+    mWeightTree[0] = 0;
+
+    for( int i=1; i<=mNumRecords; i++ ) {
+        mWeightTree[i] = mRecords[ i - 1 ].mWeight;
+        }
+
+    for( int i=1; i<=mNumRecords; i++ ) {
+        int parent = i + ( i & -i );
+
+        if( parent <= mNumRecords ) {
+            mWeightTree[ parent ] += mWeightTree[i];
+            }
+        }
+
+    mWeightUpdateCount = 0;
+    }
+
     
 
 void HostCatcher::addHost( HostAddress * inHost ) {
     
 
     // convert to numerical form once and for all here
-    // (to avoid converting over and over in equals checks below)
+    // (so that the same host always has the same key below)
     HostAddress *numericalAddress = inHost->getNumericalAddress();
 
     if( numericalAddress != NULL ) {
 
         mLock->lock();
-        
+
         // make sure this host doesn't already exist in our list
-        char exists = false;
-    
-        int numHosts = mHostVector->size();
-    
-        for( int i=0; i<numHosts; i++ ) {
-            HostAddress *otherHost =  *( mHostVector->getElement( i ) );
+        if( mMaxListSize > 0 && findRecord( numericalAddress ) == -1 ) {
 
-            if( otherHost->equals( numericalAddress ) ) {
-                exists = true;
-                // jump out of loop
-                i = numHosts;
+            if( mNumHosts >= mMaxListSize ) {
+                // remove first host from queue
+                removeRecord( mOldestRecord );
                 }
-            }
-    
-    
-    
-        if( !exists ) {
-            mHostVector->push_back( numericalAddress->copy() );
-            }
-        
-    
-        while( mHostVector->size() > mMaxListSize ) {
-            // remove first host from queue
-            HostAddress *host = *( mHostVector->getElement( 0 ) );
-            mHostVector->deleteElement( 0 );
-            delete host;
+            if( mFreeRecord == -1 ) {
+                growRecords();
+                }
+
+            int index = mFreeRecord;
+            HostCatcherRecord *record = &( mRecords[ index ] );
+
+            mFreeRecord = record->mNewer;
+
+            record->mHost = numericalAddress;
+            record->mHash = hashHost( numericalAddress->mAddressString,
+                                      numericalAddress->mPort );
+            record->mSuccesses = 0;
+            record->mFailures = 0;
+            record->mFailuresInRow = 0;
+            record->mLatency = -1;
+
+            linkNewestRecord( index );
+
+            // removal and growth may have moved the empty slot
+            HashSlot *slot =
+                findSlot( record->mHash, numericalAddress->mAddressString,
+                          numericalAddress->mPort );
+            slot->mHash = record->mHash;
+            slot->mIndex = index;
+
+            mNumHosts++;
+
+            setWeight( index, computeWeight( record ) );
+
+            // now held by the record
+            numericalAddress = NULL;
             }
     
         mLock->unlock();
 
-        delete numericalAddress;
+        if( numericalAddress != NULL ) {
+            delete numericalAddress;
+            }
         }
     }
 
@@ -108,21 +380,17 @@ HostAddress * HostCatcher::getHostOrdered(  ) {
 
     mLock->lock();
     
-    int numHosts = mHostVector->size();
-
-    if( numHosts == 0 ) {
+    if( mNumHosts == 0 ) {
         mLock->unlock();
         return NULL;
         }
 
-    // remove first host from queue
-    HostAddress *host = *( mHostVector->getElement( 0 ) );
-    mHostVector->deleteElement( 0 );
+    // move first host in queue to end of queue
+    int index = mOldestRecord;
+    unlinkRecord( index );
+    linkNewestRecord( index );
 
-    // add host to end of queue
-    mHostVector->push_back( host );
-
-    HostAddress *hostCopy = host->copy();
+    HostAddress *hostCopy = mRecords[ index ].mHost->copy();
 
     
     mLock->unlock();
@@ -136,22 +404,48 @@ HostAddress * HostCatcher::getHost(  ) {
 
     mLock->lock();
     
-    int numHosts = mHostVector->size();
-
-    if( numHosts == 0 ) {
+    if( mNumHosts == 0 ) {
         mLock->unlock();
         return NULL;
         }
 
-    // remove random host from queue
-    int index = mRandSource->getRandomBoundedInt( 0, numHosts - 1 ); 
-    HostAddress *host = *( mHostVector->getElement( index ) );
-    mHostVector->deleteElement( index );
+    // total weight
+    double remainingWeight = 0;
+    for( int i=mNumRecords; i>0; i -= ( i & -i ) ) {
+        remainingWeight += mWeightTree[i];
+        }
+
+    remainingWeight *= mRandSource->getRandomDouble();
 
-    // add host to end of queue
-    mHostVector->push_back( host );
+    // walk down the tree to the record where the running total
+    // passes remainingWeight
+    int highBit = 1;
+    while( highBit * 2 <= mNumRecords ) {
+        highBit *= 2;
+        }
 
-    HostAddress *hostCopy = host->copy();
+    int position = 0;
+    for( int step=highBit; step>0; step /= 2 ) {
+        if( position + step <= mNumRecords &&
+            mWeightTree[ position + step ] <= remainingWeight ) {
+
+            position += step;
+            remainingWeight -= mWeightTree[ position ];
+            }
+        }
+
+    int index = position;
+
+    if( index >= mNumRecords || mRecords[ index ].mHost == NULL ) {
+        // off the end by rounding
+        index = mOldestRecord;
+        }
+
+    // move host to end of queue
+    unlinkRecord( index );
+    linkNewestRecord( index );
+
+    HostAddress *hostCopy = mRecords[ index ].mHost->copy();
 
     
     mLock->unlock();
@@ -165,82 +459,50 @@ SimpleVector<HostAddress *> *HostCatcher::getHostList(
     int inMaxHostCount,
     HostAddress *inSkipHost ) {
 
-    HostAddress *hostToSkip;
+    HostAddress *hostToSkip = NULL;
 
     if( inSkipHost != NULL ) {
-        hostToSkip = inSkipHost->copy();
-        }
-    else {
-        // don't skip any host
-        // create a dummy host that won't match any other valid hosts
-        // make sure dummy is in numerical form to avoid DNS lookups
-        hostToSkip = new HostAddress( stringDuplicate( "1.1.1.1" ), 1 );
+        // numerical, like the hosts that we hold
+        hostToSkip = inSkipHost->getNumericalAddress();
+
+        if( hostToSkip == NULL ) {
+            hostToSkip = inSkipHost->copy();
+            }
         }
-             
     
     SimpleVector<HostAddress *> *collectedHosts =
         new SimpleVector<HostAddress *>();
 
-    char repeat = false;
-    int numCollected = 0;
+    mLock->lock();
 
-    // This function assumes that getHostOrdered() draws
-    // hosts in order with no repetition except when we have
-    // exhausted the host supply.
+    // walk the queue once, moving each host to the end as
+    // getHostOrdered does
+    int numHosts = mNumHosts;
 
-    // Note that this will not be true when other threads
-    // have getHostOrdered() (or getHost) calls interleaved with ours, but this
-    // should be a rare case.  It will simply result
-    // in a smaller host list being returned.
+    for( int i=0; i<numHosts &&
+             collectedHosts->size() < inMaxHostCount; i++ ) {
 
-    HostAddress *firstHost = getHostOrdered();
+        int index = mOldestRecord;
+        unlinkRecord( index );
+        linkNewestRecord( index );
 
-    if( firstHost == NULL ) {
-        // the catcher is empty
+        HostAddress *host = mRecords[ index ].mHost;
 
-        delete hostToSkip;
+        if( hostToSkip == NULL ||
+            host->mPort != hostToSkip->mPort ||
+            strcmp( host->mAddressString,
+                    hostToSkip->mAddressString ) != 0 ) {
 
-        // an empty host list
-        return collectedHosts;       
-        }
-    
-
-    if( ! hostToSkip->equals( firstHost ) ) {
-        collectedHosts->push_back( firstHost );
-        numCollected++;
-        }
-
-    
-    while( numCollected < inMaxHostCount && !repeat ) {
-
-        HostAddress *nextHost = getHostOrdered();
-
-        if( nextHost->equals( firstHost ) ) {
-            delete nextHost;
-            repeat = true;
-            }
-        else {
-            if( ! hostToSkip->equals( nextHost ) ) {
-                collectedHosts->push_back( nextHost );
-                numCollected++;
-                }
-            else {
-                delete nextHost;
-                }
+            collectedHosts->push_back( host->copy() );
             }
-        
         }
 
+    mLock->unlock();
 
-    if( hostToSkip->equals( firstHost ) ) {
-        // we didn't include firstHost in our collectedHosts, so
-        // we must delete it.
-        delete firstHost;
+    if( hostToSkip != NULL ) {
+        delete hostToSkip;
         }
 
-    
-    delete hostToSkip;
-
     return collectedHosts;
     }
 
@@ -257,40 +519,70 @@ void HostCatcher::addHostList( SimpleVector<HostAddress *> * inHostList ) {
 
 
 void HostCatcher::noteHostBad( HostAddress * inHost ) {
-    mLock->lock();
-    
-    // make sure this host already exists in our list
-    char exists = false;
+    HostAddress *numericalAddress = inHost->getNumericalAddress();
 
-    HostAddress *foundHost = NULL;
-    
-    int numHosts = mHostVector->size();
+    if( numericalAddress == NULL ) {
+        // can't be in our list
+        return;
+        }
 
-    for( int i=0; i<numHosts; i++ ) {
-        HostAddress *otherHost =  *( mHostVector->getElement( i ) );
+    mLock->lock();
+    
+    int index = findRecord( numericalAddress );
 
-        if( otherHost->equals( inHost ) ) {
-            exists = true;
+    if( index != -1 ) {
+        HostCatcherRecord *record = &( mRecords[ index ] );
 
-            // delete the host that we've found
-            mHostVector->deleteElement( i );
+        record->mFailures++;
+        record->mFailuresInRow++;
 
-            foundHost = otherHost;
-            
-            // jump out of loop
-            i = numHosts;
+        if( record->mFailuresInRow >= mMaxFailures ) {
+            removeRecord( index );
+            }
+        else {
+            setWeight( index, computeWeight( record ) );
             }
-        }
-
-    
-    if( exists ) {
-        delete foundHost;
-        //mHostVector->push_back( foundHost );
         }
 
     mLock->unlock();
+
+    delete numericalAddress;
     }
+
+
+
+void HostCatcher::noteHostGood( HostAddress * inHost,
+                                double inLatencySeconds ) {
+    HostAddress *numericalAddress = inHost->getNumericalAddress();
+
+    if( numericalAddress == NULL ) {
+        return;
+        }
+
+    mLock->lock();
     
+    int index = findRecord( numericalAddress );
 
+    if( index != -1 ) {
+        HostCatcherRecord *record = &( mRecords[ index ] );
 
+        record->mSuccesses++;
+        record->mFailuresInRow = 0;
 
+        if( inLatencySeconds >= 0 ) {
+            if( record->mLatency < 0 ) {
+                record->mLatency = inLatencySeconds;
+                }
+            else {
+                record->mLatency += LATENCY_SMOOTHING *
+                    ( inLatencySeconds - record->mLatency );
+                }
+            }
+
+        setWeight( index, computeWeight( record ) );
+        }
+
+    mLock->unlock();
+
+    delete numericalAddress;
+    }
@@ -25,9 +25,25 @@
 
 
 
+// kept out of this header, see HostCatcher.cpp
+struct HostCatcherRecord;
+
+class HashSlotTable;
+struct HashSlot;
+
+
+
 /**
  * Manages a collection of hosts.
  *
+ * Hosts are found through a hash table keyed by numerical address and
+ * port, so adding, scoring, and dropping a host take constant time no
+ * matter how many hosts are held.
+ *
+ * Each host carries a score built from the successes, failures, and
+ * latencies reported through noteHostGood and noteHostBad, and getHost
+ * favors hosts that have been fast and reliable.
+ *
  * @author Jason Rohrer
  */
 class HostCatcher {
@@ -42,8 +58,12 @@ class HostCatcher {
          * Constructs a host catcher.
          *
          * @param inMaxListSize the maximum number of hosts to hold.
+         * @param inMaxFailures the number of failures in a row (with
+         *   no success in between) after which a host is dropped.
+         *   Defaults to 1 (hosts are dropped the first time they
+         *   are noted bad).
          */
-        HostCatcher( int inMaxListSize );
+        HostCatcher( int inMaxListSize, int inMaxFailures = 1 );
 
 
         
@@ -54,6 +74,8 @@ class HostCatcher {
         /**
          * Adds a host to this catcher.
          *
+         * Hosts already in this catcher keep their scores.
+         *
          * Thread safe.
          *
          * @param inHost the host to add.
@@ -66,8 +88,10 @@ class HostCatcher {
         /**
          * Gets a "fresh" host from this catcher.
          *
-         * The returned host is "fresh" in that it has not
-         * been returned by this call in a while.
+         * Hosts are drawn at random, with fast, reliable hosts
+         * more likely to be drawn than slow or failing ones.  Hosts
+         * that have not been scored yet are drawn as if they had
+         * average latency.
          *
          * Thread safe.
          *
@@ -118,6 +142,9 @@ class HostCatcher {
          * Tells this catcher that a host is "bad"
          * (in other words, dead, dropping connections, etc.).
          *
+         * The host is dropped once it has been noted bad inMaxFailures
+         * times in a row, and is drawn less often by getHost until then.
+         *
          * Thread safe.
          *
          * @param inHost the bad host.
@@ -127,15 +154,71 @@ class HostCatcher {
 
 
 
+        /**
+         * Tells this catcher that a host is "good" (in other words,
+         * that it answered when contacted).
+         *
+         * Thread safe.
+         *
+         * @param inHost the good host.
+         *   Must be destroyed by caller.
+         * @param inLatencySeconds how long the host took to answer,
+         *   or -1 if not measured.  Defaults to -1.
+         */
+        void noteHostGood( HostAddress * inHost,
+                           double inLatencySeconds = -1 );
+
+
+
     protected:
 
         int mMaxListSize;
-        
-        SimpleVector<HostAddress *> *mHostVector;
+        int mMaxFailures;
+
+        // held hosts, linked from least to most recently returned
+        // (or added), with unused records linked through mNewer
+        HostCatcherRecord *mRecords;
+        int mNumRecords;
+        int mNumHosts;
+        int mOldestRecord;
+        int mNewestRecord;
+        int mFreeRecord;
+
+        // records by address and port
+        HashSlotTable *mSlots;
+
+        // Fenwick tree over record weights, for drawing hosts in
+        // proportion to their weights
+        double *mWeightTree;
+        // rebuilt now and then so rounding errors don't pile up
+        int mWeightUpdateCount;
 
         MutexLock *mLock;
 
         RandomSource *mRandSource;
+
+
+        // returns the slot holding the host, or the empty slot where
+        // it would go
+        HashSlot *findSlot( unsigned int inHash,
+                            char *inAddress, int inPort );
+
+        // returns the record for a host, or -1 if not held
+        // (inHost must be numerical)
+        int findRecord( HostAddress *inHost );
+
+        void unlinkRecord( int inIndex );
+        void linkNewestRecord( int inIndex );
+
+        // drops a host and frees its record
+        void removeRecord( int inIndex );
+
+        // grows the record pool up to mMaxListSize
+        void growRecords();
+
+        void setWeight( int inIndex, double inWeight );
+        void rebuildWeightTree();
+
         
         /**
          * Gets a "fresh" host from this catcher, walking through the host
@@ -15,6 +15,12 @@
 
 #include "MultiSourceDownloader.h"
 
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/system/Semaphore.h"
+#include "minorGems/system/Time.h"
+#include "minorGems/util/SimpleVector.h"
+
 
 #include <stdio.h>
 
@@ -134,3 +140,579 @@ void multiSourceGetFile( void *inFileDescriptor,
     }
 
 
+
+
+// for multiSourceGetFileParallel
+
+
+enum ChunkState {
+    CHUNK_NEEDED = 0,
+    CHUNK_IN_FLIGHT,
+    CHUNK_DONE
+    };
+
+
+// in the endgame, a chunk is requested from at most this many
+// sources at once
+#define MAX_REQUESTS_PER_CHUNK 2
+
+// how long fetchers with nothing to fetch wait before checking again
+#define ENDGAME_POLL_MILLISECONDS 5
+
+
+
+typedef struct ChunkRecord {
+        int state;
+        int numRequests;
+
+        // of the first request still in flight
+        double startTime;
+        int firstSource;
+    } ChunkRecord;
+
+
+
+typedef struct ReceivedChunk {
+        unsigned long chunkNumber;
+        unsigned char *data;
+    } ReceivedChunk;
+
+
+
+typedef struct SourceRecord {
+        void *source;
+        char dead;
+
+        // seconds per chunk request, smoothed,
+        // or -1 before the first chunk arrives
+        double chunkTime;
+    } SourceRecord;
+
+
+
+/**
+ * State shared by the calling thread and the fetcher threads.
+ *
+ * Fetchers ask for chunks, call the chunk getter with no lock held, and
+ * hand back what they got.  The calling thread writes received chunks
+ * to the file.
+ */
+class ParallelDownload {
+    public:
+
+        ParallelDownload( void *inFileDescriptor,
+                          unsigned long inFileSize,
+                          unsigned long inChunkSize,
+                          int inNumSources, void **inFileSources,
+                          unsigned char * (*inChunkGetter)(
+                              void *, void *, unsigned long, unsigned long ),
+                          unsigned char *inChunkBitmap );
+
+        ~ParallelDownload();
+
+
+        // for fetchers
+        
+        // returns false when the fetcher should stop
+        char getNextChunk( int inSourceIndex, unsigned long *outChunkNumber );
+
+        // inData is NULL if the source failed to return the chunk
+        void chunkReturned( int inSourceIndex, unsigned long inChunkNumber,
+                            unsigned char *inData, double inSeconds );
+
+        void fetcherDone();
+
+
+        unsigned long getChunkSize( unsigned long inChunkNumber );
+        
+
+        void *mFileDescriptor;
+        unsigned long mFileSize;
+        unsigned long mChunkSize;
+        unsigned long mNumChunks;
+
+        unsigned char * (*mChunkGetter)(
+            void *, void *, unsigned long, unsigned long );
+
+        
+        MutexLock mLock;
+
+        // signaled when a chunk is received or a fetcher stops
+        Semaphore mEventSemaphore;
+
+        ChunkRecord *mChunks;
+        unsigned long mNumDone;
+
+        // no chunks before this are needed
+        unsigned long mNextNeeded;
+
+        SimpleVector<unsigned long> mInFlight;
+
+        int mNumSources;
+        SourceRecord *mSources;
+
+        // waiting for the calling thread
+        SimpleVector<ReceivedChunk> mReceived;
+        
+        int mNumFetchers;
+
+        // set when the download is complete, failed, or canceled
+        char mStopping;
+    };
+
+
+
+ParallelDownload::ParallelDownload(
+    void *inFileDescriptor,
+    unsigned long inFileSize,
+    unsigned long inChunkSize,
+    int inNumSources, void **inFileSources,
+    unsigned char * (*inChunkGetter)(
+        void *, void *, unsigned long, unsigned long ),
+    unsigned char *inChunkBitmap )
+        : mFileDescriptor( inFileDescriptor ),
+          mFileSize( inFileSize ),
+          mChunkSize( inChunkSize ),
+          mChunkGetter( inChunkGetter ),
+          mNumDone( 0 ),
+          mNextNeeded( 0 ),
+          mNumSources( inNumSources ),
+          mNumFetchers( 0 ),
+          mStopping( false ) {
+
+    mNumChunks = inFileSize / inChunkSize;
+    if( inFileSize % inChunkSize != 0 ) {
+        // extra partial chunk
+        mNumChunks++;
+        }
+
+    mChunks = new ChunkRecord[ mNumChunks ];
+
+    for( unsigned long c=0; c<mNumChunks; c++ ) {
+        mChunks[c].state = CHUNK_NEEDED;
+        mChunks[c].numRequests = 0;
+
+        if( inChunkBitmap != NULL &&
+            ( inChunkBitmap[ c / 8 ] >> ( c % 8 ) ) & 1 ) {
+            mChunks[c].state = CHUNK_DONE;
+            mNumDone++;
+            }
+        }
+
+    mSources = new SourceRecord[ inNumSources ];
+
+    for( int s=0; s<inNumSources; s++ ) {
+        mSources[s].source = inFileSources[s];
+        mSources[s].dead = false;
+        mSources[s].chunkTime = -1;
+        }
+    }
+
+
+
+ParallelDownload::~ParallelDownload() {
+    for( int i=0; i<mReceived.size(); i++ ) {
+        delete [] mReceived.getElementDirect( i ).data;
+        }
+    delete [] mChunks;
+    delete [] mSources;
+    }
+
+
+
+unsigned long ParallelDownload::getChunkSize( unsigned long inChunkNumber ) {
+    if( inChunkNumber * mChunkSize + mChunkSize > mFileSize ) {
+        // partial chunk
+        return mFileSize - inChunkNumber * mChunkSize;
+        }
+    return mChunkSize;
+    }
+
+
+
+char ParallelDownload::getNextChunk( int inSourceIndex,
+                                     unsigned long *outChunkNumber ) {
+    SourceRecord *source = &( mSources[ inSourceIndex ] );
+
+    mLock.lock();
+    
+    while( ! mStopping && ! source->dead && mNumDone < mNumChunks ) {
+
+        double currentTime = Time::getPreciseTime();
+        
+        while( mNextNeeded < mNumChunks &&
+               mChunks[ mNextNeeded ].state != CHUNK_NEEDED ) {
+            mNextNeeded++;
+            }
+        
+        if( mNextNeeded < mNumChunks ) {
+            // faster sources come back for more sooner, so they
+            // end up fetching more chunks
+            unsigned long c = mNextNeeded;
+            
+            mChunks[c].state = CHUNK_IN_FLIGHT;
+            mChunks[c].numRequests = 1;
+            mChunks[c].startTime = currentTime;
+            mChunks[c].firstSource = inSourceIndex;
+
+            mInFlight.push_back( c );
+            
+            *outChunkNumber = c;
+            mLock.unlock();
+            return true;
+            }
+
+
+        // endgame:  every chunk left is in flight
+        // find the one expected to arrive last, and request it here
+        // too if this source should get it sooner
+        int best = -1;
+        double bestArrivalTime = 0;
+        
+        for( int i=0; i<mInFlight.size(); i++ ) {
+            ChunkRecord *chunk = 
+                &( mChunks[ mInFlight.getElementDirect( i ) ] );
+
+            if( chunk->numRequests >= MAX_REQUESTS_PER_CHUNK ||
+                chunk->firstSource == inSourceIndex ) {
+                continue;
+                }
+
+            double chunkTime = -1;
+            
+            if( chunk->firstSource != -1 ) {
+                chunkTime = mSources[ chunk->firstSource ].chunkTime;
+                }
+
+            // a source that hasn't returned a chunk yet is taking
+            // at least as long as it has so far
+            if( chunkTime < currentTime - chunk->startTime ) {
+                chunkTime = currentTime - chunk->startTime;
+                }
+            
+            double arrivalTime = chunk->startTime + chunkTime;
+
+            if( best == -1 || arrivalTime > bestArrivalTime ) {
+                best = i;
+                bestArrivalTime = arrivalTime;
+                }
+            }
+
+        if( best != -1 &&
+            currentTime + source->chunkTime < bestArrivalTime ) {
+
+            unsigned long c = mInFlight.getElementDirect( best );
+
+            mChunks[c].numRequests++;
+            
+            *outChunkNumber = c;
+            mLock.unlock();
+            return true;
+            }
+
+
+        // nothing worth fetching now, but a chunk in flight might fail
+        // and be needed again
+        mLock.unlock();
+        
+        Thread::staticSleep( ENDGAME_POLL_MILLISECONDS );
+
+        mLock.lock();
+        }
+
+    mLock.unlock();
+    return false;
+    }
+
+
+
+void ParallelDownload::chunkReturned( int inSourceIndex,
+                                      unsigned long inChunkNumber,
+                                      unsigned char *inData,
+                                      double inSeconds ) {
+    mLock.lock();
+
+    SourceRecord *source = &( mSources[ inSourceIndex ] );
+    ChunkRecord *chunk = &( mChunks[ inChunkNumber ] );
+
+    chunk->numRequests--;
+
+    char received = false;
+    
+    if( inData == NULL ) {
+        // as in multiSourceGetFile, a failed source isn't used again
+        source->dead = true;
+
+        if( chunk->state == CHUNK_IN_FLIGHT && chunk->numRequests == 0 ) {
+            chunk->state = CHUNK_NEEDED;
+
+            if( inChunkNumber < mNextNeeded ) {
+                mNextNeeded = inChunkNumber;
+                }
+            }
+        }
+    else {
+        if( source->chunkTime < 0 ) {
+            source->chunkTime = inSeconds;
+            }
+        else {
+            source->chunkTime = 0.7 * source->chunkTime + 0.3 * inSeconds;
+            }
+
+        if( chunk->state == CHUNK_DONE ) {
+            // another source returned it first
+            delete [] inData;
+            }
+        else {
+            chunk->state = CHUNK_DONE;
+            mNumDone++;
+            
+            ReceivedChunk receivedChunk = { inChunkNumber, inData };
+            mReceived.push_back( receivedChunk );
+            received = true;
+            }
+        }
+
+    if( chunk->state != CHUNK_IN_FLIGHT ) {
+        mInFlight.deleteElementEqualTo( inChunkNumber );
+        }
+    else if( chunk->firstSource == inSourceIndex ) {
+        // the endgame copy is still in flight
+        // we can't tell which source it's at, so keep our start time
+        chunk->firstSource = -1;
+        }
+    
+    mLock.unlock();
+
+    if( received ) {
+        mEventSemaphore.signal();
+        }
+    }
+
+
+
+void ParallelDownload::fetcherDone() {
+    mLock.lock();
+    mNumFetchers--;
+    mLock.unlock();
+
+    mEventSemaphore.signal();
+    }
+
+
+
+class ChunkFetcher : public Thread {
+    public:
+        ChunkFetcher( ParallelDownload *inDownload, int inSourceIndex )
+                : mDownload( inDownload ), mSourceIndex( inSourceIndex ) {
+            }
+
+        virtual void run();
+
+    protected:
+        ParallelDownload *mDownload;
+        int mSourceIndex;
+    };
+
+
+
+void ChunkFetcher::run() {
+    void *source = mDownload->mSources[ mSourceIndex ].source;
+    
+    unsigned long chunkNumber;
+
+    while( mDownload->getNextChunk( mSourceIndex, &chunkNumber ) ) {
+        double startTime = Time::getPreciseTime();
+        
+        unsigned char *chunkData =
+            mDownload->mChunkGetter( source, mDownload->mFileDescriptor,
+                                     chunkNumber,
+                                     mDownload->getChunkSize( chunkNumber ) );
+
+        mDownload->chunkReturned( mSourceIndex, chunkNumber, chunkData,
+                                  Time::getPreciseTime() - startTime );
+        }
+
+    mDownload->fetcherDone();
+    }
+
+
+
+void multiSourceGetFileParallel( void *inFileDescriptor,
+                                 unsigned long inFileSize,
+                                 unsigned long inChunkSize,
+                                 int inNumSources,
+                                 void **inFileSources,
+                                 unsigned char * (*inChunkGetter)(
+                                     void *, void *, 
+                                     unsigned long, unsigned long ),
+                                 char (*inDownloadProgressHandler)(
+                                     int, unsigned long, void * ),
+                                 void *inProgressHandlerExtraArgument,
+                                 char *inDestinationPath,
+                                 int inRequestsPerSource,
+                                 unsigned char *inChunkBitmap ) {
+
+    FILE *outputFile = NULL;
+
+    if( inChunkBitmap != NULL ) {
+        // keep chunks already written
+        outputFile = fopen( inDestinationPath, "r+b" );
+        }
+    if( outputFile == NULL ) {
+        outputFile = fopen( inDestinationPath, "wb" );
+        }
+
+    if( outputFile == NULL ) {
+
+        inDownloadProgressHandler( MULTISOURCE_DOWNLOAD_FAILED,
+                                   0, inProgressHandlerExtraArgument );
+        return;
+        }
+
+    char failed = false;
+    char canceled = false;
+
+    
+    // size the file up front, so chunks can be written at their offsets
+    // in any order
+    fseek( outputFile, 0, SEEK_END );
+    
+    if( inFileSize > 0 && 
+        (unsigned long)ftell( outputFile ) < inFileSize ) {
+        
+        if( fseek( outputFile, inFileSize - 1, SEEK_SET ) != 0 ||
+            fputc( 0, outputFile ) == EOF ) {
+
+            inDownloadProgressHandler( MULTISOURCE_DOWNLOAD_FAILED,
+                                       0, inProgressHandlerExtraArgument );
+            failed = true;
+            }
+        }
+
+
+    ParallelDownload download( inFileDescriptor, inFileSize, inChunkSize,
+                               inNumSources, inFileSources, inChunkGetter,
+                               inChunkBitmap );
+
+    unsigned long bytesSoFar = 0;
+    
+    for( unsigned long c=0; c<download.mNumChunks; c++ ) {
+        if( download.mChunks[c].state == CHUNK_DONE ) {
+            bytesSoFar += download.getChunkSize( c );
+            }
+        }
+
+
+    if( inRequestsPerSource < 1 ) {
+        inRequestsPerSource = 1;
+        }
+    
+    SimpleVector<ChunkFetcher *> fetchers;
+
+    if( ! failed && download.mNumDone < download.mNumChunks ) {
+        for( int s=0; s<inNumSources; s++ ) {
+            for( int r=0; r<inRequestsPerSource; r++ ) {
+                fetchers.push_back( new ChunkFetcher( &download, s ) );
+                }
+            }
+        }
+
+    download.mNumFetchers = fetchers.size();
+
+    for( int i=0; i<fetchers.size(); i++ ) {
+        fetchers.getElementDirect( i )->start();
+        }
+
+    
+    unsigned long numWritten = download.mNumDone;
+
+    int numFetchers = fetchers.size();
+    
+    while( numFetchers > 0 ) {
+        download.mEventSemaphore.wait();
+
+        download.mLock.lock();
+
+        int numReceived = download.mReceived.size();
+        ReceivedChunk *received = download.mReceived.getElementArray();
+        download.mReceived.deleteAll();
+
+        // once none are left, nothing more can be received
+        numFetchers = download.mNumFetchers;
+        
+        download.mLock.unlock();
+
+        
+        for( int i=0; i<numReceived; i++ ) {
+            unsigned long c = received[i].chunkNumber;
+            unsigned long chunkSize = download.getChunkSize( c );
+
+            if( ! failed && ! canceled ) {
+                if( fseek( outputFile, c * inChunkSize, SEEK_SET ) != 0 ||
+                    fwrite( received[i].data, 1, chunkSize, outputFile ) 
+                    != chunkSize ) {
+                    
+                    // failed to write to file, so download cannot continue
+                    inDownloadProgressHandler( 
+                        MULTISOURCE_DOWNLOAD_FAILED,
+                        bytesSoFar,
+                        inProgressHandlerExtraArgument );
+                    failed = true;
+                    }
+                else {
+                    numWritten++;
+                    bytesSoFar += chunkSize;
+                    
+                    if( inChunkBitmap != NULL ) {
+                        inChunkBitmap[ c / 8 ] |= 1 << ( c % 8 );
+                        }
+                    
+                    char shouldContinue =
+                        inDownloadProgressHandler(
+                            MULTISOURCE_DOWNLOAD_IN_PROGRESS,
+                            bytesSoFar,
+                            inProgressHandlerExtraArgument );
+
+                    if( !shouldContinue ) {
+                        canceled = true;
+                        
+                        // call handler last time
+                        inDownloadProgressHandler(
+                            MULTISOURCE_DOWNLOAD_CANCELED,
+                            bytesSoFar,
+                            inProgressHandlerExtraArgument );
+                        }
+                    }
+                }
+            delete [] received[i].data;
+            }
+        delete [] received;
+
+        
+        if( failed || canceled || numWritten == download.mNumChunks ) {
+            // fetchers stop once their requests in flight return
+            download.mLock.lock();
+            download.mStopping = true;
+            download.mLock.unlock();
+            }
+        }
+
+    for( int i=0; i<fetchers.size(); i++ ) {
+        fetchers.getElementDirect( i )->join();
+        delete fetchers.getElementDirect( i );
+        }
+
+    
+    // check if we got here because we ran out of hosts (another type of
+    // failure
+    if( !failed && !canceled &&
+        numWritten < download.mNumChunks ) {
+
+        inDownloadProgressHandler( MULTISOURCE_DOWNLOAD_FAILED,
+                                   bytesSoFar,
+                                   inProgressHandlerExtraArgument );
+        }
+    
+    fclose( outputFile );
+    }
@@ -14,6 +14,9 @@
 #define MULTISOURCE_DOWNLOADER_INCLUDED
 
 
+#include <stddef.h>
+
+
 
 /**
  * Abstract API for multi-source downloads.
@@ -78,6 +81,51 @@ void multiSourceGetFile( void *inFileDescriptor,
 
 
 
+/**
+ * Gets a file from multiple sources at once.
+ *
+ * Takes the same arguments as multiSourceGetFile, but inChunkGetter is
+ * called from several threads at once, for several chunks from each
+ * source, so it must be thread safe.
+ *
+ * Sources that return chunks faster end up fetching more of them.  Near
+ * the end, chunks that are taking long at a slow source are also
+ * requested from faster ones, and whichever copy arrives first is kept.
+ * A source is not used again after it fails to return a chunk.
+ *
+ * Chunks are written at their offsets in the destination file as they
+ * arrive, in any order.  inDownloadProgressHandler is only called from
+ * the calling thread, and a cancel takes effect once the chunk requests
+ * already in flight return.
+ *
+ * @param inRequestsPerSource how many chunk requests to keep in flight
+ *   at each source.
+ * @param inChunkBitmap one bit per chunk (chunk i is bit i % 8 of byte
+ *   i / 8), set for chunks already in the destination file, which are
+ *   not fetched again.  Bits are set as chunks are written, so the
+ *   bitmap can be saved to resume a failed or canceled download later.
+ *   NULL to fetch the whole file.
+ *   Must be destroyed by caller.
+ *
+ * Other parameters are the same as for multiSourceGetFile.
+ */
+void multiSourceGetFileParallel( void *inFileDescriptor,
+                                 unsigned long inFileSize,
+                                 unsigned long inChunkSize,
+                                 int inNumSources,
+                                 void **inFileSources,
+                                 unsigned char * (*inChunkGetter)(
+                                     void *, void *, 
+                                     unsigned long, unsigned long ),
+                                 char (*inDownloadProgressHandler)(
+                                     int, unsigned long, void * ),
+                                 void *inProgressHandlerExtraArgument,
+                                 char *inDestinationPath,
+                                 int inRequestsPerSource = 4,
+                                 unsigned char *inChunkBitmap = NULL );
+
+
+
 #endif
 
 
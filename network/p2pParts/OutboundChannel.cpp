@@ -24,20 +24,209 @@
 
 #include "minorGems/network/p2pParts/OutboundChannel.h"
 
+#include "minorGems/system/atomicOps.h"
+
+
+
+// most messages and bytes the sending thread takes per write
+#define MAX_BATCH_MESSAGES 64
+#define MAX_BATCH_BYTES 65536
+
+
+
+typedef struct OutboundMessageCell {
+        // tells senders and the sending thread whose turn the cell is
+        volatile unsigned int sequence;
+        char *message;
+        int length;
+    } OutboundMessageCell;
+
+
+
+/**
+ * A bounded queue of messages that any thread can add to and remove
+ * from without locks.  The sending thread removes messages to send
+ * them, and senders remove the oldest message when the queue is full.
+ *
+ * Each cell's sequence number says whether it is free for the thread
+ * that claimed its position to push, or holds a message for the thread
+ * that claimed it to pop (as in Dmitry Vyukov's bounded MPMC queue).
+ */
+class OutboundMessageRing {
+    public:
+
+        OutboundMessageRing( unsigned int inMinSize );
+
+        // destroys messages still queued
+        ~OutboundMessageRing();
+
+
+        // any thread
+        // returns false if full, in which case caller keeps inMessage
+        char push( char *inMessage, int inLength );
+
+        // any thread
+        // returns NULL if empty, or if the oldest message is still
+        // being pushed
+        char *pop( int *outLength );
+
+        // any thread, may count messages still being pushed
+        int getCount();
+
+
+        // bytes of messages in the queue
+        volatile long mNumBytes;
+
+    protected:
+        OutboundMessageCell *mCells;
+        unsigned int mMask;
+
+        volatile unsigned int mPushPosition;
+
+        // keep pushing and popping threads off of each
+        // other's cache lines
+        char mPadding[64];
+
+        volatile unsigned int mPopPosition;
+    };
+
+
+
+OutboundMessageRing::OutboundMessageRing( unsigned int inMinSize )
+        : mNumBytes( 0 ),
+          mPushPosition( 0 ),
+          mPopPosition( 0 ) {
+
+    unsigned int size = 2;
+    while( size < inMinSize ) {
+        size *= 2;
+        }
+    mMask = size - 1;
+
+    mCells = new OutboundMessageCell[ size ];
+
+    for( unsigned int i=0; i<size; i++ ) {
+        mCells[i].sequence = i;
+        mCells[i].message = NULL;
+        }
+    }
+
+
+
+OutboundMessageRing::~OutboundMessageRing() {
+    int length;
+    char *message = pop( &length );
+
+    while( message != NULL ) {
+        delete [] message;
+        message = pop( &length );
+        }
+
+    delete [] mCells;
+    }
+
+
+
+char OutboundMessageRing::push( char *inMessage, int inLength ) {
+    unsigned int position = atomicLoad( &mPushPosition );
+
+    OutboundMessageCell *cell;
+
+    while( true ) {
+        cell = &( mCells[ position & mMask ] );
+
+        int difference = 
+            (int)( atomicLoad( &( cell->sequence ) ) - position );
+
+        if( difference == 0 ) {
+            // cell free, claim its position
+            if( atomicCompareAndSwap( &mPushPosition, 
+                                      position, position + 1 ) ) {
+                break;
+                }
+            }
+        else if( difference < 0 ) {
+            // cell still holds a message from a lap ago
+            return false;
+            }
+
+        // another sender claimed it first
+        position = atomicLoad( &mPushPosition );
+        }
+
+    cell->message = inMessage;
+    cell->length = inLength;
+
+    // hand the cell to the sending thread
+    atomicStore( &( cell->sequence ), position + 1 );
+
+    atomicAdd( &mNumBytes, (long)inLength );
+
+    return true;
+    }
+
+
+
+char *OutboundMessageRing::pop( int *outLength ) {
+    unsigned int position = atomicLoad( &mPopPosition );
+
+    OutboundMessageCell *cell;
+
+    while( true ) {
+        cell = &( mCells[ position & mMask ] );
+
+        int difference =
+            (int)( atomicLoad( &( cell->sequence ) ) - ( position + 1 ) );
+
+        if( difference == 0 ) {
+            // cell holds a message, claim its position
+            if( atomicCompareAndSwap( &mPopPosition,
+                                      position, position + 1 ) ) {
+                break;
+                }
+            }
+        else if( difference < 0 ) {
+            // empty, or the sender that claimed it hasn't finished
+            return NULL;
+            }
+
+        // another thread popped it first
+        position = atomicLoad( &mPopPosition );
+        }
+
+    char *message = cell->message;
+    *outLength = cell->length;
+
+    // free the cell for the sender one lap ahead
+    atomicStore( &( cell->sequence ), position + mMask + 1 );
+
+    atomicAdd( &mNumBytes, (long)( - *outLength ) );
+
+    return message;
+    }
+
+
+
+int OutboundMessageRing::getCount() {
+    return (int)( atomicLoad( &mPushPosition ) - atomicLoad( &mPopPosition ) );
+    }
+
 
 
 OutboundChannel::OutboundChannel( OutputStream *inOutputStream,
                                   HostAddress *inHost,
                                   MessagePerSecondLimiter *inLimiter,
-                                  unsigned long inQueueSize )
-    : mLock( new MutexLock() ), mMessageReadySemaphore( new Semaphore() ),
+                                  unsigned long inQueueSize,
+                                  unsigned long inMaxQueuedBytes )
+    : mMessageReadySemaphore( new Semaphore() ),
+      mSenderWaiting( 0 ),
       mStream( inOutputStream ),
       mHost( inHost ),
       mLimiter( inLimiter ),
       mConnectionBroken( false ), mThreadStopped( false ),
-      mMessageQueue( new SimpleVector<char*>() ),
-      mHighPriorityMessageQueue( new SimpleVector<char*>() ),
-      mMaxQueueSize( inQueueSize ),
+      mMessageQueue( new OutboundMessageRing( inQueueSize ) ),
+      mHighPriorityMessageQueue( new OutboundMessageRing( inQueueSize ) ),
+      mMaxQueuedBytes( inMaxQueuedBytes ),
       mDroppedMessageCount( 0 ),
       mSentMessageCount( 0 ) {
     
@@ -49,11 +238,7 @@ OutboundChannel::OutboundChannel( OutputStream *inOutputStream,
 
 
 OutboundChannel::~OutboundChannel() {
-    mLock->lock();
-
-    mThreadStopped = true;
-
-    mLock->unlock();
+    atomicStore( &mThreadStopped, (int)true );
 
     // wake the thread up if it is waiting
     mMessageReadySemaphore->signal();
@@ -62,81 +247,63 @@ OutboundChannel::~OutboundChannel() {
     join();
 
 
-    mLock->lock();
-
     delete mMessageReadySemaphore;
     
-    // clear the queues
-    int numMessages = mMessageQueue->size();
-    int i;
-    for( i=0; i<numMessages; i++ ) {
-        char *message = *( mMessageQueue->getElement( i ) );
-        delete [] message;
-        }
+    // clears the queues
     delete mMessageQueue;
-
-    numMessages = mHighPriorityMessageQueue->size();
-    for( i=0; i<numMessages; i++ ) {
-        char *message = *( mHighPriorityMessageQueue->getElement( i ) );
-        delete [] message;
-        }
     delete mHighPriorityMessageQueue;
 
-    
-
     delete mHost;
-
-    mLock->unlock();
-
-    delete mLock;
     }
     
 
 
 char OutboundChannel::sendMessage( char * inMessage, int inPriority ) {
-    mLock->lock();
 
-
-    char sent;
+    if( atomicLoad( &mConnectionBroken ) ) {
+        // channel no longer working
+        return false;
+        }
     
-    if( !mConnectionBroken ) {
-        // add it to the queue
-        SimpleVector<char *> *queueToUse;
+    OutboundMessageRing *queueToUse;
 
-        if( inPriority <=0 ) {
-            queueToUse = mMessageQueue;
-            }
-        else {
-            queueToUse = mHighPriorityMessageQueue;
-            }
-
-        
-        queueToUse->push_back( stringDuplicate( inMessage ) );
-        sent = true;
+    if( inPriority <=0 ) {
+        queueToUse = mMessageQueue;
+        }
+    else {
+        queueToUse = mHighPriorityMessageQueue;
+        }
 
-        if( queueToUse->size() > mMaxQueueSize ) {
-            // the queue is over-full
-            // drop the oldest message
+    char *message = stringDuplicate( inMessage );
+    int length = strlen( message );
 
-            char *message = *( queueToUse->getElement( 0 ) );
-            queueToUse->deleteElement( 0 );
-            delete [] message;
+    while( ! queueToUse->push( message, length ) ) {
+        // the queue is full
+        // drop the oldest message to make room, since fresh messages
+        // matter more than stale ones
+        int oldLength;
+        char *oldMessage = queueToUse->pop( &oldLength );
 
-            mDroppedMessageCount++;
+        if( oldMessage != NULL ) {
+            delete [] oldMessage;
+            atomicAdd( &mDroppedMessageCount, 1 );
+            }
+        else {
+            // oldest is still being pushed by another sender
+            Thread::staticSleep( 0 );
             }
         }
-    else {
-        // channel no longer working
-        sent = false;
-        }
-        
-    mLock->unlock();
 
-    if( sent ) {
+    // the sending thread sets mSenderWaiting before checking the queues
+    // one last time, so either it sees our message or we see it waiting
+    atomicMemoryBarrier();
+    
+    if( atomicLoad( &mSenderWaiting ) &&
+        atomicCompareAndSwap( &mSenderWaiting, 1, 0 ) ) {
         mMessageReadySemaphore->signal();
         }
     
-    return sent;
+    return true;
     }
 
 
@@ -155,113 +322,129 @@ void OutboundChannel::setHost( HostAddress *inHost ) {
 
 
 int OutboundChannel::getSentMessageCount() {
-    mLock->lock();
-    int count = mSentMessageCount;
-    mLock->unlock();
-
-    return count;
+    return atomicLoad( &mSentMessageCount );
     }
 
 
 
 int OutboundChannel::getQueuedMessageCount() {
-    mLock->lock();
-    int count = mMessageQueue->size() + mHighPriorityMessageQueue->size();
-    mLock->unlock();
-
-    return count;
+    return mMessageQueue->getCount() + mHighPriorityMessageQueue->getCount();
     }
 
 
 
 int OutboundChannel::getDroppedMessageCount() {
-    mLock->lock();
-    int count = mDroppedMessageCount;
-    mLock->unlock();
+    return atomicLoad( &mDroppedMessageCount );
+    }
+
+
 
-    return count;
+void OutboundChannel::trimQueue( OutboundMessageRing *inQueue ) {
+    while( atomicLoad( &( inQueue->mNumBytes ) ) > mMaxQueuedBytes ) {
+        int length;
+        char *message = inQueue->pop( &length );
+
+        if( message == NULL ) {
+            return;
+            }
+        delete [] message;
+
+        atomicAdd( &mDroppedMessageCount, 1 );
+        }
     }
 
 
 
 void OutboundChannel::run() {
-    mLock->lock();
-    char stopped = mThreadStopped;
-    mLock->unlock();
 
-    while( !stopped ) {
+    OutputStreamSlice *slices = new OutputStreamSlice[ MAX_BATCH_MESSAGES ];
+    char **messages = new char*[ MAX_BATCH_MESSAGES ];
+    
+    while( ! atomicLoad( &mThreadStopped ) ) {
 
+        // drop what we're too far behind to send
+        trimQueue( mHighPriorityMessageQueue );
+        trimQueue( mMessageQueue );
 
-        // get a message from the queue, checking high priority queue first
-        char *message = NULL;
 
-        mLock->lock();
+        // with a rate limit, messages go one per write so that none
+        // waits on the limit for those after it
+        int maxMessages = MAX_BATCH_MESSAGES;
 
-        if( mHighPriorityMessageQueue->size() >= 1 ) {
-            message = *( mHighPriorityMessageQueue->getElement( 0 ) );
-            mHighPriorityMessageQueue->deleteElement( 0 );             
-            }        
-        else if( mMessageQueue->size() >= 1 ) {
-            message = *( mMessageQueue->getElement( 0 ) );
-            mMessageQueue->deleteElement( 0 );            
+        if( mLimiter->getLimit() >= 0 ) {
+            maxMessages = 1;
             }
-
-        mLock->unlock();
-
-        // note that we're unlocked during the send, so messages
-        // can be freely added to the queue without blocking while we send
-        // this message
         
-        if( message != NULL ) {
+        // take messages from the queues, high priority queue first
+        int numMessages = 0;
+        long numBytes = 0;
+        
+        while( numMessages < maxMessages && numBytes < MAX_BATCH_BYTES ) {
+            int length;
+            char *message = mHighPriorityMessageQueue->pop( &length );
+
+            if( message == NULL ) {
+                message = mMessageQueue->pop( &length );
+                }
+            if( message == NULL ) {
+                break;
+                }
 
             // obey the limit
             // we will block here if message rate is too high
             mLimiter->messageTransmitted();
-                        
-            int bytesSent = mStream->writeString( message );
-
-            int messageLength = strlen( message );
-    
-            delete [] message;
 
+            messages[ numMessages ] = message;
+            slices[ numMessages ].buffer = (unsigned char *)message;
+            slices[ numMessages ].numBytes = length;
 
-            char sent;
-            
-            if( bytesSent == messageLength ) {
-                sent = true;
+            numMessages++;
+            numBytes += length;
+            }
 
-                mLock->lock();
-                mSentMessageCount++;
-                mLock->unlock();
+        
+        if( numMessages == 0 ) {
+            // no messages in the queues.
+            // wait for more messages to be ready, checking once more
+            // after telling senders that we're waiting
+            atomicStore( &mSenderWaiting, 1 );
+            atomicMemoryBarrier();
+
+            if( mHighPriorityMessageQueue->getCount() == 0 &&
+                mMessageQueue->getCount() == 0 &&
+                ! atomicLoad( &mThreadStopped ) ) {
+                
+                mMessageReadySemaphore->wait();
                 }
-            else {
-                sent = false;
+            else if( ! atomicLoad( &mThreadStopped ) ) {
+                // counted messages that we couldn't pop are still
+                // being pushed, give their senders time to finish
+                sleep( 1 );
                 }
 
+            atomicStore( &mSenderWaiting, 0 );
+            continue;
+            }
 
-            if( !sent ) {
-                // connection is broken
-                // stop this thread
-                
-                mLock->lock();
+        
+        // senders never wait on this write
+        long numSent = mStream->writeSlices( slices, numMessages );
 
-                mConnectionBroken = true;
-                mThreadStopped = true;
+        for( int i=0; i<numMessages; i++ ) {
+            delete [] messages[i];
+            }
 
-                mLock->unlock();
-                }
+        if( numSent == numBytes ) {
+            atomicAdd( &mSentMessageCount, numMessages );
             }
         else {
-            // no messages in the queue.
-            // wait for more messages to be ready
-            mMessageReadySemaphore->wait();
+            // connection is broken
+            // stop this thread
+            atomicStore( &mConnectionBroken, (int)true );
+            atomicStore( &mThreadStopped, (int)true );
             }
-        
-
-        // check if we've been stopped
-        mLock->lock();
-        stopped = mThreadStopped;
-        mLock->unlock();
         }
-    
+
+    delete [] slices;
+    delete [] messages;
     }
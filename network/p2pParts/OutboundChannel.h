@@ -40,9 +40,21 @@
 
 
 
+// kept out of this header, see OutboundChannel.cpp
+class OutboundMessageRing;
+
+
+
 /**
  * A channel that can send messages to a receiving host.
  *
+ * Senders never wait on each other or on the sending thread:  each
+ * priority has a bounded ring that any thread can add to without locking.
+ * A sender that finds its ring full drops the oldest message in it.
+ * The sending thread takes every message that is waiting when it wakes
+ * and writes them together, high priority first, with one vectored
+ * write.
+ *
  * NOTE:
  * None of the member functions are safe to call if this class has been
  * destroyed.  Since the application-specific channel manager class can
@@ -67,11 +79,17 @@ class OutboundChannel : public Thread {
          *   Will be destroyed when this class is destroyed.
          * @param inLimiter the limiter for outbound messages.
          *   Must be destroyed by caller after this class is destroyed.
-         * @param inQueueSize the size of the send queue.  Defaults to 50.
+         * @param inQueueSize the most messages queued at each priority,
+         *   rounded up to a power of 2.  Beyond this, the oldest
+         *   messages are dropped.  Defaults to 50.
+         * @param inMaxQueuedBytes the most message bytes queued at each
+         *   priority.  Beyond this, the oldest messages are dropped.
+         *   Defaults to 65536.
          */
         OutboundChannel( OutputStream *inOutputStream, HostAddress *inHost,
                          MessagePerSecondLimiter *inLimiter,
-                         unsigned long inQueueSize = 50 );
+                         unsigned long inQueueSize = 50,
+                         unsigned long inMaxQueuedBytes = 65536 );
 
 
 
@@ -168,8 +186,11 @@ class OutboundChannel : public Thread {
         
     protected:
 
-        MutexLock *mLock;
         Semaphore *mMessageReadySemaphore;
+
+        // true while the sending thread is about to wait on
+        // mMessageReadySemaphore, so senders know to signal it
+        volatile int mSenderWaiting;
         
         OutputStream *mStream;
         
@@ -178,20 +199,25 @@ class OutboundChannel : public Thread {
         MessagePerSecondLimiter *mLimiter;
         
         
-        char mConnectionBroken;
+        volatile int mConnectionBroken;
 
-        char mThreadStopped;
+        volatile int mThreadStopped;
 
 
-        SimpleVector<char*> *mMessageQueue;
-        SimpleVector<char*> *mHighPriorityMessageQueue;
+        OutboundMessageRing *mMessageQueue;
+        OutboundMessageRing *mHighPriorityMessageQueue;
 
 
-        int mMaxQueueSize;
+        long mMaxQueuedBytes;
         
-        int mDroppedMessageCount;
+        volatile int mDroppedMessageCount;
+
+        volatile int mSentMessageCount;
+
 
-        int mSentMessageCount;
+        // drops the oldest messages from a queue until it is
+        // within mMaxQueuedBytes
+        void trimQueue( OutboundMessageRing *inQueue );
         
     };
 
@@ -0,0 +1,203 @@
+// Times DuplicateMessageDetector against a copy of its old linear-scan
+// code, and checks that both make the same decisions.
+//
+// IDs are drawn so that about a third repeat an ID from the recent
+// past, some of which have aged out of the history.
+//
+// Times for the new code include writing its history log.
+
+
+#include "DuplicateMessageDetector.h"
+
+#include "minorGems/util/SimpleVector.h"
+#include "minorGems/util/stringUtils.h"
+#include "minorGems/system/Time.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+
+// DuplicateMessageDetector as it was before hashing, without the
+// history file
+class OldDuplicateMessageDetector {
+    public:
+        OldDuplicateMessageDetector( int inMessageHistorySize )
+                : mMaxHistorySize( inMessageHistorySize ) {
+            }
+
+        ~OldDuplicateMessageDetector() {
+            for( int i=0; i<mSeenIDs.size(); i++ ) {
+                delete [] *( mSeenIDs.getElement( i ) );
+                }
+            }
+
+        char checkIfMessageSeen( char *inMessageUniqueID ) {
+            mLock.lock();
+
+            int numIDs = mSeenIDs.size();
+
+            char matchSeen = false;
+            for( int i=0; i<numIDs && !matchSeen; i++ ) {
+                char *otherID = *( mSeenIDs.getElement( i ) );
+
+                if( strcmp( otherID, inMessageUniqueID ) == 0 ) {
+                    mSeenIDs.deleteElement( i );
+                    mSeenIDs.push_back( otherID );
+                    matchSeen = true;
+                    }
+                }
+
+            if( !matchSeen ) {
+                mSeenIDs.push_back( stringDuplicate( inMessageUniqueID ) );
+
+                if( mSeenIDs.size() > mMaxHistorySize ) {
+                    delete [] *( mSeenIDs.getElement( 0 ) );
+                    mSeenIDs.deleteElement( 0 );
+                    }
+                }
+
+            mLock.unlock();
+            return matchSeen;
+            }
+
+    protected:
+        int mMaxHistorySize;
+        MutexLock mLock;
+        SimpleVector<char *> mSeenIDs;
+    };
+
+
+
+static unsigned int randomState = 1;
+
+static unsigned int nextRandom() {
+    randomState = randomState * 1103515245 + 12345;
+    return randomState >> 8;
+    }
+
+
+
+// fills outIDs with inNumIDs IDs, each up to 31 chars
+static void makeIDs( char *outIDs, int inNumIDs, int inHistorySize ) {
+    randomState = 1;
+
+    for( int i=0; i<inNumIDs; i++ ) {
+        int number = i;
+
+        if( i > 0 && nextRandom() % 3 == 0 ) {
+            // repeat a recent ID, reaching back past the history
+            // now and then
+            number = i - 1 - nextRandom() % ( inHistorySize +
+                                              inHistorySize / 4 );
+            if( number < 0 ) {
+                number = 0;
+                }
+            }
+
+        sprintf( &( outIDs[ i * 32 ] ), "%u_%d",
+                 (unsigned int)( number * 2654435761U ), number );
+        }
+    }
+
+
+
+template <class Detector>
+static double timeDetector( Detector *inDetector, char *inIDs,
+                            int inNumIDs, char *outSeen ) {
+    double startTime = Time::getPreciseTime();
+
+    for( int i=0; i<inNumIDs; i++ ) {
+        outSeen[i] = inDetector->checkIfMessageSeen( &( inIDs[ i * 32 ] ) );
+        }
+
+    return Time::getPreciseTime() - startTime;
+    }
+
+
+
+static int compare( int inHistorySize, int inNumIDs ) {
+    char *ids = new char[ inNumIDs * 32 ];
+    makeIDs( ids, inNumIDs, inHistorySize );
+
+    char *oldSeen = new char[ inNumIDs ];
+    char *newSeen = new char[ inNumIDs ];
+
+    OldDuplicateMessageDetector *oldDetector =
+        new OldDuplicateMessageDetector( inHistorySize );
+    double oldTime = timeDetector( oldDetector, ids, inNumIDs, oldSeen );
+    delete oldDetector;
+
+    DuplicateMessageDetector *detector =
+        new DuplicateMessageDetector( inHistorySize );
+    double newTime = timeDetector( detector, ids, inNumIDs, newSeen );
+    delete detector;
+
+    int numDifferent = 0;
+    int numSeen = 0;
+    for( int i=0; i<inNumIDs; i++ ) {
+        if( oldSeen[i] != newSeen[i] ) {
+            numDifferent++;
+            }
+        if( newSeen[i] ) {
+            numSeen++;
+            }
+        }
+
+    printf( "history %6d, %7d IDs (%d duplicates):  "
+            "old %9.0f IDs/sec, new %9.0f IDs/sec\n",
+            inHistorySize, inNumIDs, numSeen,
+            inNumIDs / oldTime, inNumIDs / newTime );
+
+    if( numDifferent > 0 ) {
+        printf( "FAILED:  %d decisions differ\n", numDifferent );
+        }
+
+    delete [] ids;
+    delete [] oldSeen;
+    delete [] newSeen;
+
+    return numDifferent;
+    }
+
+
+
+static void timeNew( int inHistorySize, int inNumIDs ) {
+    char *ids = new char[ inNumIDs * 32 ];
+    makeIDs( ids, inNumIDs, inHistorySize );
+
+    char *seen = new char[ inNumIDs ];
+
+    DuplicateMessageDetector *detector =
+        new DuplicateMessageDetector( inHistorySize );
+    double newTime = timeDetector( detector, ids, inNumIDs, seen );
+    delete detector;
+
+    printf( "history %6d, %7d IDs:  new %9.0f IDs/sec\n",
+            inHistorySize, inNumIDs, inNumIDs / newTime );
+
+    delete [] ids;
+    delete [] seen;
+    }
+
+
+
+int main() {
+    int numDifferent = 0;
+
+    numDifferent += compare( 1, 10000 );
+    numDifferent += compare( 1000, 100000 );
+    numDifferent += compare( 20000, 60000 );
+
+    // the old code takes minutes at these sizes
+    timeNew( 100000, 5000000 );
+    timeNew( 1000000, 5000000 );
+
+    // the history log is written to the current directory
+    remove( "messageHistory.log" );
+
+    if( numDifferent > 0 ) {
+        return 1;
+        }
+    return 0;
+    }
@@ -0,0 +1,331 @@
+// Times HostCatcher against a copy of its old linear-scan code, and
+// checks that hosts are kept, dropped, and drawn as expected.
+
+
+#include "HostCatcher.h"
+
+#include "minorGems/util/SimpleVector.h"
+#include "minorGems/util/stringUtils.h"
+#include "minorGems/system/Time.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+
+// HostCatcher as it was before hashing, without getHost
+class OldHostCatcher {
+    public:
+        OldHostCatcher( int inMaxListSize )
+                : mMaxListSize( inMaxListSize ) {
+            }
+
+        ~OldHostCatcher() {
+            for( int i=0; i<mHostVector.size(); i++ ) {
+                delete *( mHostVector.getElement( i ) );
+                }
+            }
+
+        void addHost( HostAddress *inHost ) {
+            HostAddress *numericalAddress = inHost->getNumericalAddress();
+
+            mLock.lock();
+
+            char exists = false;
+            int numHosts = mHostVector.size();
+
+            for( int i=0; i<numHosts && !exists; i++ ) {
+                if( ( *( mHostVector.getElement( i ) ) )->equals(
+                        numericalAddress ) ) {
+                    exists = true;
+                    }
+                }
+
+            if( !exists ) {
+                mHostVector.push_back( numericalAddress->copy() );
+                }
+
+            while( mHostVector.size() > mMaxListSize ) {
+                delete *( mHostVector.getElement( 0 ) );
+                mHostVector.deleteElement( 0 );
+                }
+
+            mLock.unlock();
+
+            delete numericalAddress;
+            }
+
+        void noteHostBad( HostAddress *inHost ) {
+            mLock.lock();
+
+            int numHosts = mHostVector.size();
+
+            for( int i=0; i<numHosts; i++ ) {
+                HostAddress *otherHost = *( mHostVector.getElement( i ) );
+
+                if( otherHost->equals( inHost ) ) {
+                    mHostVector.deleteElement( i );
+                    delete otherHost;
+                    break;
+                    }
+                }
+
+            mLock.unlock();
+            }
+
+    protected:
+        int mMaxListSize;
+        MutexLock mLock;
+        SimpleVector<HostAddress *> mHostVector;
+    };
+
+
+
+static int numFailed = 0;
+
+
+static void check( char inCondition, const char *inMessage ) {
+    if( ! inCondition ) {
+        printf( "FAILED:  %s\n", inMessage );
+        numFailed++;
+        }
+    }
+
+
+
+// host number inNumber, spread over addresses and ports
+static HostAddress *makeHost( int inNumber ) {
+    char *address = autoSprintf( "10.%d.%d.%d",
+                                 ( inNumber >> 16 ) & 0xFF,
+                                 ( inNumber >> 8 ) & 0xFF,
+                                 inNumber & 0xFF );
+
+    return new HostAddress( address, 6000 + ( inNumber >> 24 ) );
+    }
+
+
+
+static int hostNumber( HostAddress *inHost ) {
+    int a, b, c;
+    sscanf( inHost->mAddressString, "10.%d.%d.%d", &a, &b, &c );
+
+    return ( ( inHost->mPort - 6000 ) << 24 ) | ( a << 16 ) | ( b << 8 ) | c;
+    }
+
+
+
+// adds inNumHosts hosts, half of them twice, and drops a tenth
+template <class Catcher>
+static double timeCatcher( Catcher *inCatcher, int inNumHosts ) {
+    HostAddress **hosts = new HostAddress*[ inNumHosts ];
+    for( int i=0; i<inNumHosts; i++ ) {
+        hosts[i] = makeHost( i );
+        }
+
+    double startTime = Time::getPreciseTime();
+
+    for( int i=0; i<inNumHosts; i++ ) {
+        inCatcher->addHost( hosts[i] );
+
+        if( i % 2 == 0 ) {
+            inCatcher->addHost( hosts[ i / 2 ] );
+            }
+        if( i % 10 == 0 ) {
+            inCatcher->noteHostBad( hosts[ i / 3 ] );
+            }
+        }
+
+    double seconds = Time::getPreciseTime() - startTime;
+
+    for( int i=0; i<inNumHosts; i++ ) {
+        delete hosts[i];
+        }
+    delete [] hosts;
+
+    return seconds;
+    }
+
+
+
+static void compare( int inNumHosts ) {
+    OldHostCatcher *oldCatcher = new OldHostCatcher( inNumHosts );
+    double oldTime = timeCatcher( oldCatcher, inNumHosts );
+    delete oldCatcher;
+
+    HostCatcher *catcher = new HostCatcher( inNumHosts );
+    double newTime = timeCatcher( catcher, inNumHosts );
+    delete catcher;
+
+    printf( "%7d hosts:  old %9.0f ops/sec, new %9.0f ops/sec\n",
+            inNumHosts, inNumHosts * 1.6 / oldTime,
+            inNumHosts * 1.6 / newTime );
+    }
+
+
+
+static void timeNew( int inNumHosts ) {
+    HostCatcher *catcher = new HostCatcher( inNumHosts );
+    double newTime = timeCatcher( catcher, inNumHosts );
+
+    double startTime = Time::getPreciseTime();
+
+    int numDraws = 1000000;
+    for( int i=0; i<numDraws; i++ ) {
+        delete catcher->getHost();
+        }
+
+    double drawTime = Time::getPreciseTime() - startTime;
+
+    delete catcher;
+
+    printf( "%7d hosts:  new %9.0f ops/sec, getHost %9.0f calls/sec\n",
+            inNumHosts, inNumHosts * 1.6 / newTime, numDraws / drawTime );
+    }
+
+
+
+static void testBehavior() {
+    HostCatcher catcher( 1000, 3 );
+
+    check( catcher.getHost() == NULL, "empty catcher has no hosts" );
+
+    SimpleVector<HostAddress *> *list = catcher.getHostList( 10 );
+    check( list->size() == 0, "empty catcher has empty list" );
+    delete list;
+
+
+    for( int i=0; i<1500; i++ ) {
+        HostAddress *host = makeHost( i );
+        catcher.addHost( host );
+        // again, with no effect
+        catcher.addHost( host );
+        delete host;
+        }
+
+    // oldest 500 dropped
+    list = catcher.getHostList( 5000 );
+    check( list->size() == 1000, "list holds max hosts" );
+
+    char correct = true;
+    for( int i=0; i<list->size(); i++ ) {
+        HostAddress *host = *( list->getElement( i ) );
+        if( hostNumber( host ) != 500 + i ) {
+            correct = false;
+            }
+        delete host;
+        }
+    check( correct, "list in order, oldest dropped" );
+    delete list;
+
+
+    HostAddress *skip = makeHost( 700 );
+    list = catcher.getHostList( 5000, skip );
+    check( list->size() == 999, "list skips host" );
+
+    for( int i=0; i<list->size(); i++ ) {
+        HostAddress *host = *( list->getElement( i ) );
+        if( host->equals( skip ) ) {
+            check( false, "skipped host in list" );
+            }
+        delete host;
+        }
+    delete list;
+    delete skip;
+
+
+    // dropped after 3 failures in a row, and not before
+    HostAddress *bad = makeHost( 600 );
+    catcher.noteHostBad( bad );
+    catcher.noteHostBad( bad );
+    catcher.noteHostGood( bad, 0.1 );
+    catcher.noteHostBad( bad );
+    catcher.noteHostBad( bad );
+
+    list = catcher.getHostList( 5000 );
+    check( list->size() == 1000, "host kept after 2 failures in a row" );
+    for( int i=0; i<list->size(); i++ ) {
+        delete *( list->getElement( i ) );
+        }
+    delete list;
+
+    catcher.noteHostBad( bad );
+
+    list = catcher.getHostList( 5000 );
+    check( list->size() == 999, "host dropped after 3 failures in a row" );
+    for( int i=0; i<list->size(); i++ ) {
+        HostAddress *host = *( list->getElement( i ) );
+        if( host->equals( bad ) ) {
+            check( false, "dropped host in list" );
+            }
+        delete host;
+        }
+    delete list;
+    delete bad;
+
+
+    // hosts 1000 to 1009 fast, 1010 to 1019 failing, others unmeasured
+    for( int i=1000; i<1020; i++ ) {
+        HostAddress *host = makeHost( i );
+        if( i < 1010 ) {
+            catcher.noteHostGood( host, 0.01 );
+            catcher.noteHostGood( host, 0.01 );
+            }
+        else {
+            catcher.noteHostBad( host );
+            catcher.noteHostBad( host );
+            }
+        delete host;
+        }
+
+    int numFast = 0;
+    int numFailing = 0;
+    int numDraws = 100000;
+
+    for( int d=0; d<numDraws; d++ ) {
+        HostAddress *host = catcher.getHost();
+        int number = hostNumber( host );
+
+        if( number >= 1000 && number < 1010 ) {
+            numFast++;
+            }
+        else if( number >= 1010 && number < 1020 ) {
+            numFailing++;
+            }
+        delete host;
+        }
+
+    // weights:  fast hosts 9/16 over 0.06, failing hosts 1/16 over 0.3,
+    // the other 979 hosts 1/4 over 0.3, so about 10% fast and 0.2% failing
+    double fastShare = numFast / (double)numDraws;
+    double failingShare = numFailing / (double)numDraws;
+
+    printf( "fast hosts drawn %.3f, failing hosts drawn %.4f\n",
+            fastShare, failingShare );
+
+    check( fastShare > 0.09 && fastShare < 0.12,
+           "fast hosts drawn about 10% of the time" );
+    check( failingShare > 0.0015 && failingShare < 0.0032,
+           "failing hosts drawn about 0.2% of the time" );
+    }
+
+
+
+int main() {
+
+    testBehavior();
+
+    compare( 1000 );
+    compare( 5000 );
+
+    // the old code takes minutes at these sizes
+    timeNew( 50000 );
+    timeNew( 500000 );
+
+    if( numFailed > 0 ) {
+        printf( "%d checks FAILED\n", numFailed );
+        return 1;
+        }
+
+    printf( "All checks passed\n" );
+    return 0;
+    }
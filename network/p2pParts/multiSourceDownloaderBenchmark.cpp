@@ -0,0 +1,270 @@
+// Downloads a file from simulated sources with multiSourceGetFile and
+// multiSourceGetFileParallel, checks the results, and times them.
+//
+// Each source has a latency per request and a bandwidth shared by its
+// requests in flight.  One source is slow, and one fails partway.
+
+
+#include "MultiSourceDownloader.h"
+
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/system/Time.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+
+#define FILE_SIZE ( 8 * 1048576 + 1000 )
+#define CHUNK_SIZE 65536
+
+static const char *fileName = "multiSourceDownloaderBenchmark.out";
+
+
+
+static unsigned char fileByte( unsigned long inIndex ) {
+    return (unsigned char)( inIndex * 7 + inIndex / 251 );
+    }
+
+
+
+class SimulatedSource {
+    public:
+        SimulatedSource( const char *inName,
+                         double inLatency, double inBytesPerSecond,
+                         int inFailAfter )
+                : mName( inName ),
+                  mLatency( inLatency ),
+                  mBytesPerSecond( inBytesPerSecond ),
+                  mFailAfter( inFailAfter ) {
+            reset();
+            }
+
+        void reset() {
+            mLinkFreeTime = 0;
+            mNumServed = 0;
+            }
+
+
+        const char *mName;
+        double mLatency;
+        double mBytesPerSecond;
+        // -1 to never fail
+        int mFailAfter;
+
+        MutexLock mLock;
+        // when the link finishes sending what it has been asked for
+        double mLinkFreeTime;
+        int mNumServed;
+    };
+
+
+
+static unsigned char *getChunk( void *inFileSource, void *inFileDescriptor,
+                                unsigned long inChunkNumber,
+                                unsigned long inChunkSize ) {
+    SimulatedSource *source = (SimulatedSource *)inFileSource;
+
+    source->mLock.lock();
+
+    if( source->mFailAfter != -1 &&
+        source->mNumServed >= source->mFailAfter ) {
+        source->mLock.unlock();
+        return NULL;
+        }
+    source->mNumServed++;
+
+    // requests in flight share the link
+    double currentTime = Time::getPreciseTime();
+    double startTime = currentTime + source->mLatency;
+
+    if( startTime < source->mLinkFreeTime ) {
+        startTime = source->mLinkFreeTime;
+        }
+
+    double doneTime = startTime + inChunkSize / source->mBytesPerSecond;
+    source->mLinkFreeTime = doneTime;
+
+    source->mLock.unlock();
+
+    Thread::staticSleep( (unsigned long)( ( doneTime - currentTime )
+                                          * 1000 ) );
+
+    unsigned char *data = new unsigned char[ inChunkSize ];
+
+    unsigned long start = inChunkNumber * CHUNK_SIZE;
+
+    for( unsigned long i=0; i<inChunkSize; i++ ) {
+        data[i] = fileByte( start + i );
+        }
+    return data;
+    }
+
+
+
+static int lastResult;
+static unsigned long lastBytes;
+static unsigned long cancelAtBytes;
+
+
+static char progressHandler( int inResultCode,
+                             unsigned long inTotalBytesReceived,
+                             void *inExtraArgument ) {
+    lastResult = inResultCode;
+    lastBytes = inTotalBytesReceived;
+
+    if( inResultCode == MULTISOURCE_DOWNLOAD_IN_PROGRESS &&
+        inTotalBytesReceived >= cancelAtBytes ) {
+        return false;
+        }
+    return true;
+    }
+
+
+
+static char checkFile() {
+    FILE *file = fopen( fileName, "rb" );
+
+    if( file == NULL ) {
+        return false;
+        }
+
+    unsigned char *data = new unsigned char[ FILE_SIZE + 1 ];
+
+    int numRead = fread( data, 1, FILE_SIZE + 1, file );
+    fclose( file );
+
+    char correct = ( numRead == FILE_SIZE );
+
+    for( int i=0; i<numRead && correct; i++ ) {
+        if( data[i] != fileByte( i ) ) {
+            correct = false;
+            }
+        }
+
+    delete [] data;
+    return correct;
+    }
+
+
+
+#define NUM_SOURCES 4
+
+static SimulatedSource sources[ NUM_SOURCES ] = {
+    SimulatedSource( "fast", 0.020, 4000000, -1 ),
+    SimulatedSource( "medium", 0.050, 2000000, -1 ),
+    SimulatedSource( "slow", 0.200, 250000, -1 ),
+    SimulatedSource( "failing", 0.020, 4000000, 5 ) };
+
+static void *sourcePointers[ NUM_SOURCES ] = {
+    &sources[0], &sources[1], &sources[2], &sources[3] };
+
+
+
+static int numFailed = 0;
+
+
+// inRequestsPerSource of 0 for multiSourceGetFile
+static void runDownload( const char *inDescription, int inRequestsPerSource,
+                         unsigned char *inChunkBitmap,
+                         int inExpectedResult, char inCheckFile ) {
+    for( int s=0; s<NUM_SOURCES; s++ ) {
+        sources[s].reset();
+        }
+
+    double startTime = Time::getPreciseTime();
+
+    if( inRequestsPerSource == 0 ) {
+        multiSourceGetFile( NULL, FILE_SIZE, CHUNK_SIZE,
+                            NUM_SOURCES, sourcePointers, getChunk,
+                            progressHandler, NULL, (char *)fileName );
+        }
+    else {
+        multiSourceGetFileParallel( NULL, FILE_SIZE, CHUNK_SIZE,
+                                    NUM_SOURCES, sourcePointers, getChunk,
+                                    progressHandler, NULL, (char *)fileName,
+                                    inRequestsPerSource, inChunkBitmap );
+        }
+
+    double seconds = Time::getPreciseTime() - startTime;
+
+    printf( "%-34s %6.2f sec, %5.2f MB/s, chunks from",
+            inDescription, seconds, lastBytes / seconds / 1000000 );
+
+    for( int s=0; s<NUM_SOURCES; s++ ) {
+        printf( " %s %d", sources[s].mName, sources[s].mNumServed );
+        }
+    printf( "\n" );
+
+    if( lastResult != inExpectedResult ) {
+        printf( "FAILED:  result %d, expected %d\n", lastResult,
+                inExpectedResult );
+        numFailed++;
+        }
+
+    if( inCheckFile && ! checkFile() ) {
+        printf( "FAILED:  file contents wrong\n" );
+        numFailed++;
+        }
+    }
+
+
+
+int main() {
+
+    cancelAtBytes = FILE_SIZE + 1;
+
+    runDownload( "multiSourceGetFile", 0, NULL,
+                 MULTISOURCE_DOWNLOAD_IN_PROGRESS, true );
+
+    runDownload( "parallel, 1 request per source", 1, NULL,
+                 MULTISOURCE_DOWNLOAD_IN_PROGRESS, true );
+
+    runDownload( "parallel, 4 requests per source", 4, NULL,
+                 MULTISOURCE_DOWNLOAD_IN_PROGRESS, true );
+
+
+    // cancel halfway, then resume from the bitmap
+    int numChunks = ( FILE_SIZE + CHUNK_SIZE - 1 ) / CHUNK_SIZE;
+
+    unsigned char *bitmap = new unsigned char[ ( numChunks + 7 ) / 8 ];
+    memset( bitmap, 0, ( numChunks + 7 ) / 8 );
+
+    remove( fileName );
+
+    cancelAtBytes = FILE_SIZE / 2;
+
+    runDownload( "parallel, canceled halfway", 4, bitmap,
+                 MULTISOURCE_DOWNLOAD_CANCELED, false );
+
+    int numDone = 0;
+    for( int c=0; c<numChunks; c++ ) {
+        numDone += ( bitmap[ c / 8 ] >> ( c % 8 ) ) & 1;
+        }
+    printf( "%d of %d chunks done\n", numDone, numChunks );
+
+    cancelAtBytes = FILE_SIZE + 1;
+
+    runDownload( "parallel, resumed", 4, bitmap,
+                 MULTISOURCE_DOWNLOAD_IN_PROGRESS, true );
+
+    delete [] bitmap;
+
+
+    // no working sources
+    for( int s=0; s<NUM_SOURCES; s++ ) {
+        sources[s].mFailAfter = 0;
+        }
+    runDownload( "parallel, all sources failing", 4, NULL,
+                 MULTISOURCE_DOWNLOAD_FAILED, false );
+
+
+    remove( fileName );
+
+    if( numFailed > 0 ) {
+        printf( "%d checks FAILED\n", numFailed );
+        return 1;
+        }
+    return 0;
+    }
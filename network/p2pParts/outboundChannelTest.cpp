@@ -0,0 +1,307 @@
+// Checks that an OutboundChannel keeps each sender's messages in order
+// and drops the oldest messages when its queue overflows.
+//
+// Sends through a stream that records what it is given and that can be
+// held shut to simulate a receiver that has stopped reading.
+
+
+#include "OutboundChannel.h"
+
+#include "minorGems/system/atomicOps.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+
+
+// OutboundChannel only asks its limiter for the limit and reports each
+// message to it, so stand in for an unlimited limiter here
+
+MessagePerSecondLimiter::MessagePerSecondLimiter( double inLimitPerSecond )
+        : mLock( NULL ), mTransmitLock( NULL ),
+          mLimitPerSecond( inLimitPerSecond ) {
+    }
+
+MessagePerSecondLimiter::~MessagePerSecondLimiter() {
+    }
+
+void MessagePerSecondLimiter::setLimit( double inLimitPerSecond ) {
+    mLimitPerSecond = inLimitPerSecond;
+    }
+
+double MessagePerSecondLimiter::getLimit() {
+    return mLimitPerSecond;
+    }
+
+void MessagePerSecondLimiter::messageTransmitted() {
+    }
+
+
+
+/**
+ * Records everything written to it.
+ *
+ * Written to only by a channel's sending thread, and read only once
+ * that thread is done with it.
+ */
+class RecordingOutputStream : public OutputStream {
+    public:
+
+        RecordingOutputStream()
+                : mHoldShut( false ), mWriteStarted( false ) {
+            }
+
+        ~RecordingOutputStream() {
+            for( int i=0; i<mWrites.size(); i++ ) {
+                delete [] *( mWrites.getElement( i ) );
+                }
+            }
+
+
+        // makes writes wait until released
+        void holdShut() {
+            atomicStore( &mHoldShut, 1 );
+            }
+
+        void release() {
+            atomicStore( &mHoldShut, 0 );
+            }
+
+        char writeStarted() {
+            return atomicLoad( &mWriteStarted );
+            }
+
+
+        // each message as a \0-terminated string, in the order written
+        SimpleVector<char *> mWrites;
+
+
+        // implements OutputStream
+        long write( unsigned char *inBuffer, long inNumBytes ) {
+            atomicStore( &mWriteStarted, 1 );
+
+            while( atomicLoad( &mHoldShut ) ) {
+                Thread::staticSleep( 1 );
+                }
+
+            char *copy = new char[ inNumBytes + 1 ];
+            memcpy( copy, inBuffer, inNumBytes );
+            copy[ inNumBytes ] = '\0';
+
+            mWrites.push_back( copy );
+
+            return inNumBytes;
+            }
+
+
+    protected:
+        volatile int mHoldShut;
+        volatile int mWriteStarted;
+    };
+
+
+
+static int numFailed = 0;
+
+
+static void check( char inCondition, const char *inMessage ) {
+    if( ! inCondition ) {
+        printf( "FAILED:  %s\n", inMessage );
+        numFailed++;
+        }
+    }
+
+
+
+static void waitForEmptyQueue( OutboundChannel *inChannel ) {
+    while( inChannel->getQueuedMessageCount() > 0 ) {
+        Thread::staticSleep( 1 );
+        }
+    }
+
+
+
+#define NUM_SENDERS 4
+#define MESSAGES_PER_SENDER 5000
+
+
+class SenderThread : public Thread {
+    public:
+
+        SenderThread( OutboundChannel *inChannel, int inID )
+                : mChannel( inChannel ), mID( inID ) {
+            }
+
+        void run() {
+            char message[ 64 ];
+
+            for( int i=0; i<MESSAGES_PER_SENDER; i++ ) {
+                // every third message at high priority
+                int priority = 0;
+                if( i % 3 == 0 ) {
+                    priority = 1;
+                    }
+
+                sprintf( message, "%d %d %d", mID, priority, i );
+                mChannel->sendMessage( message, priority );
+                }
+            }
+
+    protected:
+        OutboundChannel *mChannel;
+        int mID;
+    };
+
+
+
+// several senders at once, with a queue small enough to overflow
+static void testSenderOrder() {
+    RecordingOutputStream *stream = new RecordingOutputStream();
+    MessagePerSecondLimiter *limiter = new MessagePerSecondLimiter();
+
+    OutboundChannel *channel =
+        new OutboundChannel( stream, NULL, limiter, 16, 1 << 20 );
+
+    SenderThread *senders[ NUM_SENDERS ];
+
+    int i;
+    for( i=0; i<NUM_SENDERS; i++ ) {
+        senders[i] = new SenderThread( channel, i );
+        senders[i]->start();
+        }
+    for( i=0; i<NUM_SENDERS; i++ ) {
+        senders[i]->join();
+        delete senders[i];
+        }
+
+    waitForEmptyQueue( channel );
+
+    int totalSent = NUM_SENDERS * MESSAGES_PER_SENDER;
+
+    check( channel->getSentMessageCount() +
+           channel->getDroppedMessageCount() == totalSent,
+           "every message either sent or dropped" );
+
+    int sentCount = channel->getSentMessageCount();
+
+    delete channel;
+
+    check( stream->mWrites.size() == sentCount,
+           "stream given every sent message" );
+
+
+    // last sequence number seen for each sender at each priority
+    int lastSeen[ NUM_SENDERS ][ 2 ];
+    for( i=0; i<NUM_SENDERS; i++ ) {
+        lastSeen[i][0] = -1;
+        lastSeen[i][1] = -1;
+        }
+
+    char inOrder = true;
+    char wellFormed = true;
+
+    for( i=0; i<stream->mWrites.size(); i++ ) {
+        int id, priority, sequence;
+
+        int numRead = sscanf( *( stream->mWrites.getElement( i ) ),
+                              "%d %d %d", &id, &priority, &sequence );
+
+        if( numRead != 3 || id < 0 || id >= NUM_SENDERS ||
+            priority < 0 || priority > 1 ) {
+            wellFormed = false;
+            continue;
+            }
+
+        if( sequence <= lastSeen[ id ][ priority ] ) {
+            inOrder = false;
+            }
+        lastSeen[ id ][ priority ] = sequence;
+        }
+
+    check( wellFormed, "messages sent whole" );
+    check( inOrder, "each sender's messages sent in order" );
+
+    delete stream;
+    delete limiter;
+    }
+
+
+
+// a receiver that has stopped reading should get the newest messages
+// once it resumes, not the oldest
+static void testOverflowDropsOldest() {
+    RecordingOutputStream *stream = new RecordingOutputStream();
+    MessagePerSecondLimiter *limiter = new MessagePerSecondLimiter();
+
+    stream->holdShut();
+
+    OutboundChannel *channel =
+        new OutboundChannel( stream, NULL, limiter, 8, 1 << 20 );
+
+    // the sending thread takes this one and then waits on the stream
+    channel->sendMessage( (char *)"first" );
+
+    while( ! stream->writeStarted() ) {
+        Thread::staticSleep( 1 );
+        }
+
+    int numToSend = 100;
+    char message[ 64 ];
+
+    int i;
+    for( i=0; i<numToSend; i++ ) {
+        sprintf( message, "%d", i );
+        channel->sendMessage( message );
+        }
+
+    check( channel->getQueuedMessageCount() == 8, "queue stays full" );
+    check( channel->getDroppedMessageCount() == numToSend - 8,
+           "overflow counted as dropped" );
+
+    stream->release();
+
+    waitForEmptyQueue( channel );
+
+    // let the last write finish
+    while( channel->getSentMessageCount() < 9 ) {
+        Thread::staticSleep( 1 );
+        }
+
+    delete channel;
+
+    check( stream->mWrites.size() == 9, "first message and full queue sent" );
+
+    if( stream->mWrites.size() == 9 ) {
+        check( strcmp( *( stream->mWrites.getElement( 0 ) ), "first" ) == 0,
+               "message being written when queue filled sent" );
+
+        char newestKept = true;
+        for( i=0; i<8; i++ ) {
+            if( atoi( *( stream->mWrites.getElement( i + 1 ) ) )
+                != numToSend - 8 + i ) {
+                newestKept = false;
+                }
+            }
+        check( newestKept, "newest messages kept, in order" );
+        }
+
+    delete stream;
+    delete limiter;
+    }
+
+
+
+int main() {
+
+    testSenderOrder();
+    testOverflowDropsOldest();
+
+    if( numFailed > 0 ) {
+        printf( "%d checks FAILED\n", numFailed );
+        return 1;
+        }
+
+    printf( "All checks passed\n" );
+    return 0;
+    }
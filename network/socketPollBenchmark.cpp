@@ -0,0 +1,107 @@
+// Times SocketPoll add/remove churn with many watched sockets.
+
+
+#include "Socket.h"
+#include "SocketPoll.h"
+
+#include "minorGems/system/Time.h"
+#include "minorGems/util/random/CustomRandomSource.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+
+
+// usage:
+// socketPollBenchmark [numSockets] [numChurnOps]
+
+int main( int inNumArgs, char **inArgs ) {
+
+    int numSockets = 10000;
+    int numChurnOps = 1000000;
+    
+    if( inNumArgs > 1 ) {
+        numSockets = atoi( inArgs[1] );
+        }
+    if( inNumArgs > 2 ) {
+        numChurnOps = atoi( inArgs[2] );
+        }
+    
+    
+    // unconnected TCP sockets are enough to exercise poll bookkeeping
+    // without needing a peer for each one
+    Socket **sockets = new Socket*[ numSockets ];
+    
+    for( int i=0; i<numSockets; i++ ) {
+        sockets[i] = new Socket();
+        sockets[i]->mNativeSocketID = socket( AF_INET, SOCK_STREAM, 0 );
+        
+        if( sockets[i]->mNativeSocketID == -1 ) {
+            printf( "Failed to open socket %d, try raising ulimit -n\n",
+                    i );
+            return 1;
+            }
+        }
+    
+    
+    SocketPoll poll;
+    
+    
+    double startTime = Time::getCurrentTime();
+
+    for( int i=0; i<numSockets; i++ ) {
+        poll.addSocket( sockets[i] );
+        }
+    
+    double addTime = Time::getCurrentTime() - startTime;
+    
+    printf( "Added %d sockets in %f sec (%.0f adds/sec)\n",
+            numSockets, addTime, numSockets / addTime );
+    
+
+    // connect/disconnect churn:  random socket leaves, then rejoins
+    CustomRandomSource randSource( 17 );
+    
+    startTime = Time::getCurrentTime();
+    
+    for( int i=0; i<numChurnOps; i++ ) {
+        Socket *s = sockets[ randSource.getRandomBoundedInt( 
+                                 0, numSockets - 1 ) ];
+        poll.removeSocket( s );
+        poll.addSocket( s );
+        
+        if( i % 1000 == 0 ) {
+            // let poll recycle removed records, as a server loop would
+            SocketOrServer *ready[64];
+            poll.waitMany( ready, 64, 0 );
+            }
+        }
+    
+    double churnTime = Time::getCurrentTime() - startTime;
+    
+    printf( "%d remove/add pairs with %d sockets in %f sec "
+            "(%.0f pairs/sec)\n",
+            numChurnOps, numSockets, churnTime, numChurnOps / churnTime );
+
+
+    startTime = Time::getCurrentTime();
+
+    for( int i=0; i<numSockets; i++ ) {
+        poll.removeSocket( sockets[i] );
+        }
+    
+    double removeTime = Time::getCurrentTime() - startTime;
+    
+    printf( "Removed %d sockets in %f sec (%.0f removes/sec)\n",
+            numSockets, removeTime, numSockets / removeTime );
+    
+
+    for( int i=0; i<numSockets; i++ ) {
+        delete sockets[i];
+        }
+    delete [] sockets;
+    
+    return 0;
+    }
@@ -50,53 +50,124 @@
 #endif
 
 
-SocketPoll::SocketPoll() {
-	mNativeObjectPointer = NULL;
+#ifndef WIN_32
+
+#include <unistd.h>
+#include <fcntl.h>
+
+#endif
+
+
+
+// native object holds the read and write ends of our wakeUp pipe,
+// or -1 if there is none
+// (winsock can only select on sockets, so no pipe on Windows)
+SocketPoll::SocketPoll( SocketPollTriggerMode inMode )
+        : mMode( inMode ) {
+    int *pipeEnds = new int[2];
+
+    pipeEnds[0] = -1;
+    pipeEnds[1] = -1;
+
+#ifndef WIN_32
+    if( pipe( pipeEnds ) == 0 ) {
+        // never block on a full or empty pipe
+        fcntl( pipeEnds[0], F_SETFL, O_NONBLOCK );
+        fcntl( pipeEnds[1], F_SETFL, O_NONBLOCK );
+        }
+    else {
+        pipeEnds[0] = -1;
+        pipeEnds[1] = -1;
+        }
+#endif
+    
+	mNativeObjectPointer = (void *)pipeEnds;
 
     mNextSocketOrServer = 0;
+    
+    // no edge-triggered reporting with select
+    if( mMode == socketPollEdge ) {
+        mMode = socketPollLevel;
+        }
     }
 
 
 
 SocketPoll::~SocketPoll() {
+    int *pipeEnds = (int *)( mNativeObjectPointer );
 
-    for( int i=0; i<mWatchedList.size(); i++ ) {
-        SocketOrServer *s = *( mWatchedList.getElement( i ) );
-        delete s;
+#ifndef WIN_32
+    if( pipeEnds[0] != -1 ) {
+        close( pipeEnds[0] );
+        close( pipeEnds[1] );
         }
+#endif
+
+    delete [] pipeEnds;
+    
+    deleteAllRecords();
     }
 
 
 
+char SocketPoll::addSocket( Socket *inSock, void *inOtherData,
+                            char inWatchWrite ) {
+
+    newRecord( inSock->mNativeSocketID, inSock, NULL, inOtherData,
+               inWatchWrite );
+    
+    return true;
+    }
+        
+
+
+
+char SocketPoll::addSocketServer( SocketServer *inServer, void *inOtherData ) {
+    
+    newRecord( inServer->mNativeSocketID, NULL, inServer, inOtherData,
+               false );
+    
+    return true;
+    }
+
 
-char SocketPoll::addSocket( Socket *inSock, void *inOtherData ) {
 
-    SocketOrServer *s = new SocketOrServer;
+char SocketPoll::setWatchWrite( Socket *inSock, char inWatchWrite ) {
+    SocketOrServer *s = findSocket( inSock );
     
-    s->isSocket = true;
-    s->sock = inSock;
-    s->server = NULL;
-    s->otherData = inOtherData;
+    if( s == NULL ) {
+        return false;
+        }
     
-    mWatchedList.push_back( s );
+    s->watchWrite = inWatchWrite;
+    s->armed = true;
     
     return true;
     }
-        
 
 
 
-char SocketPoll::addSocketServer( SocketServer *inServer, void *inOtherData ) {
+char SocketPoll::rearmSocket( Socket *inSock ) {
+    SocketOrServer *s = findSocket( inSock );
     
-    SocketOrServer *s = new SocketOrServer;
+    if( s == NULL ) {
+        return false;
+        }
     
-    s->isSocket = false;
-    s->sock = NULL;
-    s->server = inServer;
-    s->otherData = inOtherData;
+    s->armed = true;
+    return true;
+    }
+
+
+
+char SocketPoll::rearmSocketServer( SocketServer *inServer ) {
+    SocketOrServer *s = findSocketServer( inServer );
     
-    mWatchedList.push_back( s );
+    if( s == NULL ) {
+        return false;
+        }
     
+    s->armed = true;
     return true;
     }
 
@@ -105,45 +176,75 @@ char SocketPoll::addSocketServer( SocketServer *inServer, void *inOtherData ) {
 
 void SocketPoll::removeSocket( Socket *inSock ) {
 
-    for( int i=0; i<mWatchedList.size(); i++ ) {
-        SocketOrServer *s = *( mWatchedList.getElement( i ) );
-        if( s->sock == inSock ) {
-
-            delete s;
-            mWatchedList.deleteElement( i );
-            return;
-            }
+    SocketOrServer *s = findSocket( inSock );
+    
+    if( s != NULL ) {
+        // don't return it from a later wait call
+        // (ready list is short, so this scan is cheap)
+        mReadyList.deleteElementEqualTo( s );
+        
+        retireRecord( s );
         }
     }
 
 
 void SocketPoll::removeSocketServer( SocketServer *inServer ) {
 
-    for( int i=0; i<mWatchedList.size(); i++ ) {
-        SocketOrServer *s = *( mWatchedList.getElement( i ) );
-        if( s->server == inServer ) {
-            
-            delete s;
-            mWatchedList.deleteElement( i );
-            return;
-            }
+    SocketOrServer *s = findSocketServer( inServer );
+    
+    if( s != NULL ) {
+        mReadyList.deleteElementEqualTo( s );
+        
+        retireRecord( s );
         }
     }
 
 
 
 
+void SocketPoll::wakeUp() {
+#ifndef WIN_32
+    int *pipeEnds = (int *)( mNativeObjectPointer );
+    
+    if( pipeEnds[1] != -1 ) {
+        // if pipe is full, a wake-up is already pending
+        char wakeByte = 0;
+        int numWritten = write( pipeEnds[1], &wakeByte, 1 );
+        (void)numWritten;
+        }
+#endif
+    }
+
+
+
+
 SocketOrServer *SocketPoll::wait( int inTimeoutMS ) {
-    double startTime = Time::getCurrentTime();
+    SocketOrServer *result;
     
-    if( mReadyList.size() > 0 ) {
-        SocketOrServer *result = mReadyList.getElementDirect( 0 );
-        mReadyList.deleteElement( 0 );
-        
-        return result;
+    int numReady = waitMany( &result, 1, inTimeoutMS );
+    
+    if( numReady <= 0 ) {
+        return NULL;
         }
+    
+    return result;
+    }
+
+
+
+int SocketPoll::waitMany( SocketOrServer **outReady, int inMaxReady,
+                          int inTimeoutMS ) {
 
+    // any records removed during handling of last batch are safe
+    // to recycle now
+    clearRemoved();
+
+    int wakeID = ( (int *)( mNativeObjectPointer ) )[0];
+    char woken = false;
+
+    double startTime = Time::getCurrentTime();
     
+
     if( mNextSocketOrServer >= mWatchedList.size() ) {
         // start back over at beginning of queue
 
@@ -159,42 +260,59 @@ SocketOrServer *SocketPoll::wait( int inTimeoutMS ) {
 
     // select on batches of at most FD_SETSIZE, and add any that
     // are ready to our ready list
-    while( mNextSocketOrServer != endPoint ) {
+    // skip selecting entirely if we still have ready ones left
+    // over from last time
+    while( mReadyList.size() == 0 && mNextSocketOrServer != endPoint &&
+           !woken ) {
 
         SimpleVector<SocketOrServer *> checkList;
         SimpleVector<int> checkIDList;
 
         fd_set fdr;
+        fd_set fdw;
 
         FD_ZERO( &fdr );
+        FD_ZERO( &fdw );
 
         int maxSocketID = 0;
 
+        // in every batch, so that a wakeUp ends the blocking one
+        if( wakeID != -1 ) {
+            FD_SET( wakeID, &fdr );
+            maxSocketID = wakeID;
+            }
+
         for( int i=0; i<FD_SETSIZE && mNextSocketOrServer != endPoint; i++ ) {
             
             SocketOrServer *s = 
                 mWatchedList.getElementDirect( mNextSocketOrServer );
             
             
-            checkList.push_back( s );
+            if( s->armed ) {
+                checkList.push_back( s );
             
-            int socketID;
+                int socketID;
 	
-            if( s->isSocket ) {
-                socketID = s->sock->mNativeSocketID;
-                }
-            else {
-                socketID = s->server->mNativeSocketID;
-                }
+                if( s->isSocket ) {
+                    socketID = s->sock->mNativeSocketID;
+                    }
+                else {
+                    socketID = s->server->mNativeSocketID;
+                    }
 
-            checkIDList.push_back( socketID );
+                checkIDList.push_back( socketID );
 
-            FD_SET( socketID, &fdr );
-            
-            if( socketID > maxSocketID ) {
-                maxSocketID = socketID;
+                FD_SET( socketID, &fdr );
+                
+                if( s->watchWrite ) {
+                    FD_SET( socketID, &fdw );
+                    }
+                
+                if( socketID > maxSocketID ) {
+                    maxSocketID = socketID;
+                    }
                 }
-
+            
             mNextSocketOrServer++;
 
             if( mNextSocketOrServer != endPoint ) {    
@@ -253,7 +371,17 @@ SocketOrServer *SocketPoll::wait( int inTimeoutMS ) {
             }
         
 
-        int ret = select( maxSocketID + 1, &fdr, NULL, NULL, tvPointer );
+        int ret = select( maxSocketID + 1, &fdr, &fdw, NULL, tvPointer );
+
+        if( ret > 0 && wakeID != -1 && FD_ISSET( wakeID, &fdr ) ) {
+            // empty pipe so we don't wake again for this
+            // return whatever else this batch has ready
+            woken = true;
+            
+            char wakeBytes[64];
+            while( read( wakeID, wakeBytes, 64 ) > 0 ) {
+                }
+            }
 
         if( ret > 0 ) {
             
@@ -262,35 +390,50 @@ SocketOrServer *SocketPoll::wait( int inTimeoutMS ) {
             int numChecked = checkIDList.size();
             
             for( int i=0; i<numChecked; i++ ) {
+                int socketID = checkIDList.getElementDirect( i );
+                
+                char readReady = FD_ISSET( socketID, &fdr );
+                char writeReady = FD_ISSET( socketID, &fdw );
                 
-                if( FD_ISSET( checkIDList.getElementDirect( i ), &fdr ) ) {
+                if( readReady || writeReady ) {
+                    SocketOrServer *s = checkList.getElementDirect( i );
+                    
+                    s->readReady = readReady;
+                    s->writeReady = writeReady;
                     
-                    mReadyList.push_back( checkList.getElementDirect( i ) );
+                    mReadyList.push_back( s );
                     }
                 }
 
-            if( mReadyList.size() > 0 ) {
-                
-                // return first one right away
-
-                // don't bother selecting on later batches now
-
-                // we will handle them on the next call, fairly, because
-                // of mNextSocketOrServer round robin
-
-                SocketOrServer *result = mReadyList.getElementDirect( 0 );
-                mReadyList.deleteElement( 0 );
-                
-                return result;
-                }
+            // if any are ready, don't bother selecting on later 
+            // batches now
 
+            // we will handle them on the next call, fairly, because
+            // of mNextSocketOrServer round robin
             }
 
         // else no events ready, go on to next select batch
         }
     
+
+    int numReturned = mReadyList.size();
     
-    // none ready in any batch, and reached endpoint in round robin
-    return NULL;
-    }
+    if( numReturned > inMaxReady ) {
+        numReturned = inMaxReady;
+        }
+    
+    for( int i=0; i<numReturned; i++ ) {
+        SocketOrServer *s = mReadyList.getElementDirect( i );
+        
+        if( mMode == socketPollOneShot ) {
+            s->armed = false;
+            }
+        outReady[i] = s;
+        }
+    
+    mReadyList.deleteStartElements( numReturned );
 
+    // if none ready in any batch, and reached endpoint in round robin,
+    // this is 0
+    return numReturned;
+    }
@@ -41,6 +41,7 @@
 
 
 #include "WebClient.h"
+#include "WebConnectionPool.h"
 
 #include "minorGems/util/log/AppLog.h"
 #include "minorGems/util/stringUtils.h"
@@ -137,6 +138,9 @@ char *WebClient::executeWebMethod( const char *inMethod,
     // terminate the url here to extract the server name
     serverEnd[0] = '\0';
 
+    // Host: header keeps port, if any
+    char *hostHeader = stringDuplicate( serverNameCopy );
+    
     int portNumber = 80;
 
         // look for a port number
@@ -155,100 +159,128 @@ char *WebClient::executeWebMethod( const char *inMethod,
         colon[0] = '\0';
         }
 
-    HostAddress *host = new HostAddress(
-        stringDuplicate( serverNameCopy ),
-        portNumber );
 
-    // will be set to true if we time out while connecting
-    char timedOut;
+    // compose the whole request, so it goes out in one send
+    // (method and trailing space need to be sent in the same
+    //  buffer to work around a bug in certain web servers)
+    char *request;
+    
+    if( inBody != NULL ) {
+        request = autoSprintf(
+            "%s %s HTTP/1.1\r\n"
+            "Host: %s\r\n"
+            "Content-Length: %d\r\n"
+            "Content-Type: application/x-www-form-urlencoded\r\n\r\n"
+            "%s",
+            inMethod, getPath, hostHeader, strlen( inBody ), inBody );
+        }
+    else {
+        request = autoSprintf( "%s %s HTTP/1.1\r\n"
+                               "Host: %s\r\n\r\n",
+                               inMethod, getPath, hostHeader );
+        }
+    int requestLength = strlen( request );
+    
+    delete [] hostHeader;
+    
+    
+    char noBody = ( strcmp( inMethod, "HEAD" ) == 0 );
     
-    Socket *sock = SocketClient::connectToServer( host,
-                                                  inTimeoutInMilliseconds,
-                                                  &timedOut );
 
     char *finalURL = stringDuplicate( inURL );
     char *mimeType = NULL;
 
     int receivedLength = 0;
 
-    
-    if( sock != NULL ) {
-        SocketStream *stream = new SocketStream( sock );
 
-        // reuse the same timeout for read operations
-        stream->setReadTimeout( inTimeoutInMilliseconds );
+    SimpleVector<char> received;
+    HTTPResponseInfo info;
+    
+    char responseReceived = false;
+    
+    // second attempt only happens if a pooled connection
+    // turns out to be closed
+    for( int attempt=0; attempt<2 && !responseReceived; attempt++ ) {
         
-        // method and trailing space need to be sent in the same
-        // buffer to work around a bug in certain web servers
-        char *methodWithSpace = new char[ strlen( inMethod ) + 2 ];
-        sprintf( methodWithSpace, "%s ", inMethod );
+        Socket *sock = NULL;
+        char reused = false;
         
-        // send the request
-        stream->writeString( methodWithSpace );
-        stream->writeString( getPath );
-        stream->writeString( " HTTP/1.0\r\n" );
-        stream->writeString( "Host: " );
-        stream->writeString( serverNameCopy );
-        stream->writeString( "\r\n" );
+        if( attempt == 0 ) {
+            sock = WebConnectionPool::takeConnection( serverNameCopy,
+                                                      portNumber );
+            reused = ( sock != NULL );
+            }
         
-        if( inBody != NULL ) {
-            char *lengthString = autoSprintf( "Content-Length: %d\r\n",
-                                              strlen( inBody ) );
-            stream->writeString( lengthString );
-            delete [] lengthString;
-            stream->writeString(
-                "Content-Type: application/x-www-form-urlencoded\r\n\r\n" );
-            
-            stream->writeString( inBody );
+        if( sock == NULL ) {
+            sock = connectToHost( serverNameCopy, portNumber,
+                                  inTimeoutInMilliseconds );
             }
-        else {
-            stream->writeString( "\r\n" );
+
+        if( sock == NULL ) {
+            break;
             }
+
+        received.deleteAll();
+
+        int result = -1;
         
+        if( sock->send( (unsigned char *)request, requestLength ) 
+            == requestLength ) {
+            
+            result = receiveResponse( sock, noBody,
+                                      inTimeoutInMilliseconds,
+                                      &received, &info );
+            }
         
+        if( result == 1 ) {
+            responseReceived = true;
 
-        delete [] methodWithSpace;
+            if( info.keepAlive && received.size() == info.totalLength ) {
+                WebConnectionPool::returnConnection( serverNameCopy,
+                                                     portNumber, sock );
+                }
+            else {
+                delete sock;
+                }
+            }
+        else {
+            delete sock;
+            
+            if( ! reused || received.size() > 0 ) {
+                // a real failure, not a stale pooled connection
+                break;
+                }
+            }
+        }
+    
+    delete [] request;
+    
 
-        // the simplest thing to do is to read upto the
-        // socket close first, then extract the content
+    if( responseReceived ) {
+        
+        char *response = received.getElementArray();
         
-        char *received = receiveData( stream, &receivedLength );
-
         char *content = NULL;
 
         char notFound = false;
 
-        if( stringLocateIgnoreCase( received, "404 Not Found" ) != NULL ) {
+        if( info.statusCode == 404 ) {
             notFound = true;            
             }
         
         // watch for redirection headers
-        if( stringLocateIgnoreCase( received, "302 Found" ) != NULL ||
-            stringLocateIgnoreCase( received,
-                                    "301 Moved Permanently" ) != NULL ||
-            stringLocateIgnoreCase( received,
-                                    "302 Object Moved" ) != NULL ) {
+        if( info.statusCode == 301 || info.statusCode == 302 ||
+            info.statusCode == 303 || info.statusCode == 307 ) {
 
             // call ourself recursively to fetch the redirection
-            const char *locationTag = "Location: ";
-            char *locationTagStart =
-                stringLocateIgnoreCase( received, locationTag );
+            char *location = getHTTPResponseHeader( response, &info,
+                                                    "Location" );
 
-            if( locationTagStart != NULL ) {
-
-                char *locationStart =
-                    &( locationTagStart[ strlen( locationTag ) ] );
-
-                // replace next \r with \0
-                char *nextChar = locationStart;
-                while( nextChar[0] != '\r' && nextChar[0] != '\0' ) {
-                    nextChar = &( nextChar[1] );
-                    }
-                nextChar[0] = '\0';
+            if( location != NULL ) {
 
                 char *newFinalURL;
                 
-                content = getWebPage( locationStart, &receivedLength,
+                content = getWebPage( location, &receivedLength,
                                       &newFinalURL,
                                       &mimeType );
                 delete [] finalURL;
@@ -258,12 +290,11 @@ char *WebClient::executeWebMethod( const char *inMethod,
                     // not found recursively
                     notFound = true;
                     }
+                
+                delete [] location;
                 }                        
             }
 
-        const char *contentStartString = "\r\n\r\n";
-        const char *contentTypeStartString = "Content-type:";
-
         if( notFound ) {
             returnString = NULL;
             }
@@ -271,70 +302,37 @@ char *WebClient::executeWebMethod( const char *inMethod,
             if( content == NULL ) {
 
                 // scan for content type
-                char *contentTypeStartMarker =
-                    stringLocateIgnoreCase( received, contentTypeStartString );
+                char *contentType = getHTTPResponseHeader( response, &info,
+                                                           "Content-type" );
 
-                if( contentTypeStartMarker != NULL ) {
-                    // skip marker
-                    char *contentTypeStart =
-                        &( contentTypeStartMarker[
-                            strlen( contentTypeStartString ) ] );
-
-                    // extract content type
+                if( contentType != NULL ) {
                     // make sure the buffer is big enough
-                    char *contentType =
-                        new char[ strlen( contentTypeStartMarker ) ];
+                    char *firstToken = new char[ strlen( contentType ) + 1 ];
 
-                    int numRead = sscanf( contentTypeStart, "%s", contentType );
+                    int numRead = sscanf( contentType, "%s", firstToken );
 
                     if( numRead == 1 ) {
                         // trim
-                        mimeType = stringDuplicate( contentType );
+                        mimeType = stringDuplicate( firstToken );
                         }
+                    delete [] firstToken;
                     delete [] contentType;
                     }
 
                 // extract the content from what we've received
-                char *contentStart = strstr( received, contentStartString );
-            
-                if( contentStart != NULL ) {
-                    content =
-                        &( contentStart[ strlen( contentStartString ) ] );
-
-
-                    receivedLength =
-                        receivedLength
-                        - strlen( contentStartString )
-                        - ( (int)contentStart - (int)received );
-
-                    returnString = new char[ receivedLength + 1 ];
-                    returnString = (char*)memcpy( returnString,
-                                                  content, receivedLength );
-
-                    returnString[ receivedLength ] = '\0';
-                    }
+                returnString = getHTTPResponseBody( response, &info,
+                                                    &receivedLength );
                 }
             else {
                 // we already obtained our content recursively
-                returnString = new char[ receivedLength + 1 ];
-                returnString = (char*)memcpy( returnString,
-                                              content, receivedLength );
-                
-                returnString[ receivedLength ] = '\0';
-
-                delete [] content;
+                returnString = content;
                 }
             }
         
-        delete [] received;
-                               
-        delete stream;
-        delete sock;
+        delete [] response;
         }
 
-    delete host;
 
-        
     delete [] serverNameCopy;
 
     delete [] urlCopy;
@@ -363,45 +361,88 @@ char *WebClient::executeWebMethod( const char *inMethod,
 
 
 
-char *WebClient::receiveData( SocketStream *inSocketStream,
-                              int *outContentLength ) {
+Socket *WebClient::connectToHost( char *inHostName, int inPort,
+                                  long inTimeoutInMilliseconds ) {
+
+    HostAddress *numericalAddress =
+        WebConnectionPool::getCachedAddress( inHostName, inPort );
+
+    if( numericalAddress == NULL ) {
+        HostAddress host( stringDuplicate( inHostName ), inPort );
+
+        numericalAddress = host.getNumericalAddress();
+
+        if( numericalAddress == NULL ) {
+            return NULL;
+            }
+        
+        WebConnectionPool::cacheAddress( inHostName, numericalAddress );
+        }
+    
+    // will be set to true if we time out while connecting
+    char timedOut;
+    
+    Socket *sock = SocketClient::connectToServer( numericalAddress,
+                                                  inTimeoutInMilliseconds,
+                                                  &timedOut );
+    delete numericalAddress;
+
+    return sock;
+    }
+
+
 
-    SimpleVector<char> *receivedVector =
-            new SimpleVector<char>();
+int WebClient::receiveResponse( Socket *inSock, char inNoBody,
+                                long inTimeoutInMilliseconds,
+                                SimpleVector<char> *outReceived,
+                                HTTPResponseInfo *outInfo ) {
 
-    char connectionBroken = false;
     long bufferLength = 5000;
     unsigned char *buffer = new unsigned char[ bufferLength ];
 
-    while( !connectionBroken ) {
+    // a receive with no timeout waits for a full buffer, which may
+    // never come on a connection the server leaves open
+    long readTimeout = inTimeoutInMilliseconds;
+    if( readTimeout == -1 ) {
+        readTimeout = 1000;
+        }
+    
+    // so each check only looks at newly received bytes
+    HTTPResponseParseState parseState;
+    initHTTPResponseParseState( &parseState );
+
+    int result = 0;
+    
+    while( result == 0 ) {
 
-        int numRead = inSocketStream->read( buffer, bufferLength );
+        int numRead = inSock->receive( buffer, bufferLength, readTimeout );
 
-        if( numRead != bufferLength ) {
-            connectionBroken = true;
+        if( numRead == -2 ) {
+            if( inTimeoutInMilliseconds == -1 ) {
+                // wait forever
+                continue;
+                }
+            result = -1;
+            break;
             }
 
         if( numRead > 0 ) {
-            for( int i=0; i<numRead; i++ ) {
-                receivedVector->push_back( buffer[i] );
-                }
+            outReceived->push_back( (char *)buffer, numRead );
             }
-        }
 
-    delete [] buffer;
+        char connectionClosed = ( numRead == -1 );
 
-    // copy our vector into an array
-    int receivedSize = receivedVector->size();
-    char *received = new char[ receivedSize + 1 ];
+        char *received = NULL;
+        if( outReceived->size() > 0 ) {
+            received = outReceived->getElementFast( 0 );
+            }
         
-    for( int i=0; i<receivedSize; i++ ) {
-        received[i] = *( receivedVector->getElement( i ) );
+        result = checkHTTPResponse( received, outReceived->size(),
+                                    connectionClosed, inNoBody,
+                                    outInfo, &parseState );
         }
-    received[ receivedSize ] = '\0';
-                
-    delete receivedVector;
 
-    *outContentLength = receivedSize;
-    
-    return received;
+    delete [] buffer;
+
+    return result;
     }
@@ -35,6 +35,10 @@
 #include "minorGems/network/SocketClient.h"
 #include "minorGems/network/SocketStream.h"
 
+#include "minorGems/network/web/httpResponseUtils.h"
+
+#include "minorGems/util/SimpleVector.h"
+
 
 #include <string.h>
 #include <stdio.h>
@@ -43,6 +47,9 @@
 /**
  * A class that implements a basic web client.
  *
+ * Requests are made with HTTP/1.1, and connections the server leaves open
+ * are kept in WebConnectionPool for reuse by later requests.
+ *
  * @author Jason Rohrer.
  */
 class WebClient {
@@ -148,20 +155,44 @@ class WebClient {
 
         
         /**
-         * Receives data on a connection until the connection is closed.
+         * Connects to a host, using WebConnectionPool's cached lookup
+         * for the host name if there is one.
          *
-         * @param inSocketStream the stream to read from.
+         * @param inHostName the host name.
          *   Must be destroyed by caller.
-         * @param outContentLength pointer to where the length of the content,
-         *   in bytes, should be returned.
-         *   Useful for binary content which cannot be reliably terminated
-         *   by \0.
+         * @param inPort the port to connect to.
+         * @param inTimeoutInMilliseconds the connection timeout,
+         *   or -1 for no timeout.
+         *
+         * @return the connected socket, or NULL on failure.
+         *   Must be destroyed by caller if non-NULL.
+         */
+        static Socket *connectToHost( char *inHostName, int inPort,
+                                      long inTimeoutInMilliseconds );
+
+
+        
+        /**
+         * Receives data on a connection until a complete response
+         * has arrived, which may leave the connection open.
          *
-         * @return the received data as a \0-terminated string.
+         * @param inSock the connection to read from.
+         *   Must be destroyed by caller.
+         * @param inNoBody true if response has no body (response to HEAD).
+         * @param inTimeoutInMilliseconds the timeout for each read,
+         *   or -1 for no timeout.
+         * @param outReceived the vector to add received bytes to.
          *   Must be destroyed by caller.
+         * @param outInfo pointer to where response framing should be
+         *   returned.
+         *
+         * @return 1 on success, or -1 if the connection failed, timed out,
+         *   or carried a malformed response.
          */
-        static char *receiveData( SocketStream *inSocketStream,
-                                  int *outContentLength );
+        static int receiveResponse( Socket *inSock, char inNoBody,
+                                    long inTimeoutInMilliseconds,
+                                    SimpleVector<char> *outReceived,
+                                    HTTPResponseInfo *outInfo );
 
 
 
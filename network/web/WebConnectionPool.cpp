@@ -0,0 +1,242 @@
+#include "WebConnectionPool.h"
+
+#include "minorGems/util/stringUtils.h"
+#include "minorGems/system/Time.h"
+
+
+
+MutexLock WebConnectionPool::sLock;
+
+SimpleVector<PooledWebConnection> WebConnectionPool::sConnections;
+
+SimpleVector<CachedWebAddress> WebConnectionPool::sAddresses;
+
+double WebConnectionPool::sIdleTimeout = 10;
+int WebConnectionPool::sMaxIdlePerHost = 4;
+double WebConnectionPool::sAddressCacheTime = 300;
+
+
+
+void WebConnectionPool::removeConnection( int inIndex ) {
+    PooledWebConnection *c = sConnections.getElement( inIndex );
+
+    delete [] c->hostName;
+    delete c->sock;
+
+    sConnections.deleteElement( inIndex );
+    }
+
+
+
+Socket *WebConnectionPool::takeConnection( const char *inHostName,
+                                           int inPort ) {
+    sLock.lock();
+
+    double curTime = Time::getCurrentTime();
+
+    Socket *sock = NULL;
+
+    // newest at end, and most likely to still be open
+    for( int i=sConnections.size() - 1; i>=0 && sock == NULL; i-- ) {
+        PooledWebConnection *c = sConnections.getElement( i );
+
+        if( curTime - c->idleSince > sIdleTimeout ) {
+            removeConnection( i );
+            continue;
+            }
+
+        if( c->port != inPort ||
+            strcmp( c->hostName, inHostName ) != 0 ) {
+            continue;
+            }
+
+        // an idle connection should have nothing to read
+        // anything there means server closed it (or sent garbage)
+        unsigned char oneByte;
+        int numRead = c->sock->receive( &oneByte, 1, 0 );
+
+        if( numRead != -2 ) {
+            removeConnection( i );
+            continue;
+            }
+
+        sock = c->sock;
+
+        delete [] c->hostName;
+        sConnections.deleteElement( i );
+        }
+
+    sLock.unlock();
+
+    return sock;
+    }
+
+
+
+void WebConnectionPool::returnConnection( const char *inHostName, int inPort,
+                                          Socket *inSock ) {
+    sLock.lock();
+
+    int numForHost = 0;
+    int oldestForHost = -1;
+
+    for( int i=0; i<sConnections.size(); i++ ) {
+        PooledWebConnection *c = sConnections.getElement( i );
+
+        if( c->port == inPort &&
+            strcmp( c->hostName, inHostName ) == 0 ) {
+
+            if( oldestForHost == -1 ) {
+                oldestForHost = i;
+                }
+            numForHost++;
+            }
+        }
+
+    if( numForHost >= sMaxIdlePerHost && oldestForHost != -1 ) {
+        removeConnection( oldestForHost );
+        }
+
+    if( sMaxIdlePerHost > 0 ) {
+        PooledWebConnection c;
+        c.hostName = stringDuplicate( inHostName );
+        c.port = inPort;
+        c.sock = inSock;
+        c.idleSince = Time::getCurrentTime();
+
+        sConnections.push_back( c );
+        }
+    else {
+        delete inSock;
+        }
+
+    sLock.unlock();
+    }
+
+
+
+HostAddress *WebConnectionPool::getCachedAddress( const char *inHostName,
+                                                  int inPort ) {
+    sLock.lock();
+
+    double curTime = Time::getCurrentTime();
+
+    HostAddress *result = NULL;
+
+    for( int i=0; i<sAddresses.size(); i++ ) {
+        CachedWebAddress *a = sAddresses.getElement( i );
+
+        if( strcmp( a->hostName, inHostName ) == 0 ) {
+
+            if( curTime - a->lookupTime <= sAddressCacheTime ) {
+                result = new HostAddress(
+                    stringDuplicate( a->numericalAddress ), inPort );
+                }
+            else {
+                delete [] a->hostName;
+                delete [] a->numericalAddress;
+                sAddresses.deleteElement( i );
+                }
+            break;
+            }
+        }
+
+    sLock.unlock();
+
+    return result;
+    }
+
+
+
+void WebConnectionPool::cacheAddress( const char *inHostName,
+                                      HostAddress *inNumericalAddress ) {
+    sLock.lock();
+
+    if( sAddressCacheTime > 0 ) {
+
+        for( int i=0; i<sAddresses.size(); i++ ) {
+            CachedWebAddress *a = sAddresses.getElement( i );
+
+            if( strcmp( a->hostName, inHostName ) == 0 ) {
+                delete [] a->hostName;
+                delete [] a->numericalAddress;
+                sAddresses.deleteElement( i );
+                break;
+                }
+            }
+
+        CachedWebAddress a;
+        a.hostName = stringDuplicate( inHostName );
+        a.numericalAddress =
+            stringDuplicate( inNumericalAddress->mAddressString );
+        a.lookupTime = Time::getCurrentTime();
+
+        sAddresses.push_back( a );
+        }
+
+    sLock.unlock();
+    }
+
+
+
+void WebConnectionPool::setIdleTimeout( double inSeconds ) {
+    sLock.lock();
+    sIdleTimeout = inSeconds;
+    sLock.unlock();
+    }
+
+
+
+void WebConnectionPool::setMaxIdlePerHost( int inMax ) {
+    sLock.lock();
+    sMaxIdlePerHost = inMax;
+
+    // drop extras, oldest first
+    for( int i=sConnections.size() - 1; i>=0; i-- ) {
+        PooledWebConnection *c = sConnections.getElement( i );
+
+        int numSeen = 0;
+        for( int j=i+1; j<sConnections.size(); j++ ) {
+            PooledWebConnection *other = sConnections.getElement( j );
+
+            if( other->port == c->port &&
+                strcmp( other->hostName, c->hostName ) == 0 ) {
+                numSeen++;
+                }
+            }
+
+        if( numSeen >= sMaxIdlePerHost ) {
+            removeConnection( i );
+            }
+        }
+
+    sLock.unlock();
+    }
+
+
+
+void WebConnectionPool::setAddressCacheTime( double inSeconds ) {
+    sLock.lock();
+    sAddressCacheTime = inSeconds;
+    sLock.unlock();
+    }
+
+
+
+void WebConnectionPool::clear() {
+    sLock.lock();
+
+    while( sConnections.size() > 0 ) {
+        removeConnection( sConnections.size() - 1 );
+        }
+
+    for( int i=0; i<sAddresses.size(); i++ ) {
+        CachedWebAddress *a = sAddresses.getElement( i );
+
+        delete [] a->hostName;
+        delete [] a->numericalAddress;
+        }
+    sAddresses.deleteAll();
+
+    sLock.unlock();
+    }
@@ -0,0 +1,161 @@
+#ifndef WEB_CONNECTION_POOL_INCLUDED
+#define WEB_CONNECTION_POOL_INCLUDED
+
+
+#include "minorGems/network/Socket.h"
+#include "minorGems/network/HostAddress.h"
+
+#include "minorGems/system/MutexLock.h"
+
+#include "minorGems/util/SimpleVector.h"
+
+
+
+typedef struct PooledWebConnection {
+        char *hostName;
+        int port;
+        Socket *sock;
+        double idleSince;
+    } PooledWebConnection;
+
+
+
+typedef struct CachedWebAddress {
+        char *hostName;
+        char *numericalAddress;
+        double lookupTime;
+    } CachedWebAddress;
+
+
+
+/**
+ * Process-wide pool of idle keep-alive connections to web servers,
+ * plus a cache of host name lookups, shared by WebClient and WebRequest.
+ *
+ * Lets repeated requests to the same server skip connecting and DNS
+ * resolution.
+ *
+ * All functions are thread-safe.
+ */
+class WebConnectionPool {
+
+    public:
+
+
+        /**
+         * Takes an idle connection to a server out of the pool.
+         *
+         * Connections that the server has closed, or that have sat idle
+         * too long, are discarded rather than returned.  A returned
+         * connection can still fail on first use if the server closes it
+         * at the same moment, so callers should retry such requests on
+         * a fresh connection.
+         *
+         * @param inHostName the server name, as given in the URL.
+         *   Destroyed by caller.
+         * @param inPort the server port.
+         *
+         * @return a connected socket, or NULL if none is pooled.
+         *   Destroyed by caller, or handed back with returnConnection.
+         */
+        static Socket *takeConnection( const char *inHostName, int inPort );
+
+
+
+        /**
+         * Hands a connection back to the pool after a complete response,
+         * for reuse by a later request.
+         *
+         * @param inHostName the server name, as given in the URL.
+         *   Destroyed by caller.
+         * @param inPort the server port.
+         * @param inSock the connection.  Destroyed by pool.
+         */
+        static void returnConnection( const char *inHostName, int inPort,
+                                      Socket *inSock );
+
+
+
+        /**
+         * Gets the cached numerical address of a host.
+         *
+         * @param inHostName the host name.  Destroyed by caller.
+         * @param inPort the port to put in the returned address.
+         *
+         * @return the numerical address, or NULL if not cached or if
+         *   cached lookup has expired.  Destroyed by caller.
+         */
+        static HostAddress *getCachedAddress( const char *inHostName,
+                                              int inPort );
+
+
+
+        /**
+         * Caches the result of a host name lookup.
+         *
+         * @param inHostName the host name.  Destroyed by caller.
+         * @param inNumericalAddress the lookup result.  Destroyed by caller.
+         */
+        static void cacheAddress( const char *inHostName,
+                                  HostAddress *inNumericalAddress );
+
+
+
+        /**
+         * Sets how long idle connections are kept.
+         *
+         * @param inSeconds the idle time limit.  Defaults to 10.
+         */
+        static void setIdleTimeout( double inSeconds );
+
+
+
+        /**
+         * Sets how many idle connections are kept for each server.
+         *
+         * @param inMax the limit.  Defaults to 4.
+         */
+        static void setMaxIdlePerHost( int inMax );
+
+
+
+        /**
+         * Sets how long host name lookups are cached.
+         *
+         * @param inSeconds the cache lifetime, or 0 to disable caching.
+         *   Defaults to 300.
+         */
+        static void setAddressCacheTime( double inSeconds );
+
+
+
+        /**
+         * Closes all pooled connections and clears address cache.
+         *
+         * Should be called before exit to free resources.
+         */
+        static void clear();
+
+
+
+    protected:
+
+        static MutexLock sLock;
+
+        static SimpleVector<PooledWebConnection> sConnections;
+
+        static SimpleVector<CachedWebAddress> sAddresses;
+
+        static double sIdleTimeout;
+        static int sMaxIdlePerHost;
+        static double sAddressCacheTime;
+
+
+        // sLock must be locked by caller
+        static void removeConnection( int inIndex );
+
+    };
+
+
+
+#endif
@@ -1,4 +1,6 @@
 #include "WebRequest.h"
+#include "WebConnectionPool.h"
+#include "httpResponseUtils.h"
 
 #include "minorGems/util/stringUtils.h"
 #include "minorGems/util/StringBufferOutputStream.h"
@@ -12,11 +14,16 @@
 WebRequest::WebRequest( const char *inMethod, const char *inURL,
                         const char *inBody, const char *inProxy,
                         double inTimeoutSeconds )
-        : mError( false ), mURL( stringDuplicate( inURL ) ),
+        : mError( false ),
+          mNoBody( strcmp( inMethod, "HEAD" ) == 0 ),
+          mURL( stringDuplicate( inURL ) ),
           mRequest( NULL ), mRequestPosition( -1 ),
           mResultReady( false ), mResult( NULL ),
-          mSock( NULL ), mRequestStartTime( Time::getCurrentTime() ),
+          mSock( NULL ), mConnectionReused( false ),
+          mRequestStartTime( Time::getCurrentTime() ),
           mRequestTimeoutSeconds( inTimeoutSeconds ) {
+
+    initHTTPResponseParseState( &mResponseParseState );
         
     
     
@@ -111,13 +118,11 @@ WebRequest::WebRequest( const char *inMethod, const char *inURL,
     mLookupThread = NULL;
     
 
-    
-    // launch right into name lookup
-    mLookupThread = new LookupThread( mSuppliedAddress );
-    
-
     mSock = NULL;
     
+    // launch right into name lookup, unless we can skip it
+    startConnecting( true );
+    
         
     // compose the request into a buffered stream
     StringBufferOutputStream tempStream;
@@ -125,7 +130,7 @@ WebRequest::WebRequest( const char *inMethod, const char *inURL,
     tempStream.writeString( inMethod );
     tempStream.writeString( " " );
     tempStream.writeString( getPath );
-    tempStream.writeString( " HTTP/1.0\r\n" );
+    tempStream.writeString( " HTTP/1.1\r\n" );
     tempStream.writeString( "Host: " );
     tempStream.writeString( requestHostNameCopy );
     tempStream.writeString( "\r\n" );
@@ -190,11 +195,59 @@ WebRequest::~WebRequest() {
 
 
 
+void WebRequest::startConnecting( char inAllowReuse ) {
+    
+    if( inAllowReuse ) {    
+        mSock = WebConnectionPool::takeConnection(
+            mSuppliedAddress->mAddressString, mSuppliedAddress->mPort );
+        
+        if( mSock != NULL ) {
+            mConnectionReused = true;
+            return;
+            }
+        }
+    
+    mConnectionReused = false;
+    
+    if( mNumericalAddress == NULL ) {
+        mNumericalAddress = WebConnectionPool::getCachedAddress(
+            mSuppliedAddress->mAddressString, mSuppliedAddress->mPort );
+        }
+    
+    if( mNumericalAddress == NULL && mLookupThread == NULL ) {
+        mLookupThread = new LookupThread( mSuppliedAddress );
+        }
+    }
+
+
+
+char WebRequest::retryIfReuseFailed() {
+    if( ! mConnectionReused || mResponse.size() > 0 ) {
+        return false;
+        }
+    
+    delete mSock;
+    mSock = NULL;
+    
+    mRequestPosition = 0;
+    
+    startConnecting( false );
+    
+    return true;
+    }
+
+
+
 int WebRequest::step() {
     if( mError ) {
         return -1;
         }
 
+    if( mResultReady ) {
+        // connection may already be back in pool
+        return 1;
+        }
+
     if( mRequestTimeoutSeconds != -1 &&
         Time::getCurrentTime() - mRequestStartTime >= mRequestTimeoutSeconds ) {
         // timed out
@@ -211,56 +264,61 @@ int WebRequest::step() {
     if( mSock == NULL ) {
         
 
-        // we know mLookupThread is not NULL if we get here
-        if( mLookupThread->isLookupDone() ) {
-        
-
-            mError = true;
-
+        if( mNumericalAddress == NULL ) {
+            
+            // we know mLookupThread is not NULL if we get here
+            if( ! mLookupThread->isLookupDone() ) {
+                // still looking up
+                return 0;
+                }
+            
             mNumericalAddress = mLookupThread->getResult();
             
-
             if( mNumericalAddress != NULL ) {
+                WebConnectionPool::cacheAddress(
+                    mSuppliedAddress->mAddressString, mNumericalAddress );
+                }
+            }
+        
+
+        mError = true;
+
+        if( mNumericalAddress != NULL ) {
                 
 
     
-                // use timeout of 0 for non-blocking
-                // will be set to true if we time out while connecting
-                char timedOut;
+            // use timeout of 0 for non-blocking
+            // will be set to true if we time out while connecting
+            char timedOut;
                 
-                mSock = SocketClient::connectToServer( mNumericalAddress,
-                                                       0,
-                                                       &timedOut );
+            mSock = SocketClient::connectToServer( mNumericalAddress,
+                                                   0,
+                                                   &timedOut );
                 
-                if( mSock != NULL ) {
+            if( mSock != NULL ) {
                     
-                    mError = false;
-                    }
+                mError = false;
                 }
+            }
 
-            if( mError ) {
-                // lookup or socket construction failed
+        if( mError ) {
+            // lookup or socket construction failed
                 
-                if( mNumericalAddress == NULL ) {
-                    printf( "Error:  "
-                            "WebRequest failed to lookup %s\n",
-                            mSuppliedAddress->mAddressString );
-                    }
-                else {
-                    printf( "Error:  "
-                            "WebRequest failed to construct "
-                            "socket to %s:%d\n",
-                            mNumericalAddress->mAddressString,
-                            mNumericalAddress->mPort );
-                    }
+            if( mNumericalAddress == NULL ) {
+                printf( "Error:  "
+                        "WebRequest failed to lookup %s\n",
+                        mSuppliedAddress->mAddressString );
+                }
+            else {
+                printf( "Error:  "
+                        "WebRequest failed to construct "
+                        "socket to %s:%d\n",
+                        mNumericalAddress->mAddressString,
+                        mNumericalAddress->mPort );
+                }
                 
-                return -1;
-                }            
-            }
-        else {
-            // still looking up
-            return 0;
-            }
+            return -1;
+            }            
         }
     
 
@@ -293,6 +351,10 @@ int WebRequest::step() {
                                        // non-blocking
                                        false );
             if( numSent == -1 ) {
+                if( retryIfReuseFailed() ) {
+                    return 0;
+                    }
+                
                 mError = true;
                 
                 printf( "Error:  "
@@ -314,9 +376,6 @@ int WebRequest::step() {
             // in practice, it's never ready that fast
             return 0;
             }
-        else if( mResultReady ) {
-            return 1;
-            }
         else {
             
             // done sending request
@@ -335,9 +394,7 @@ int WebRequest::step() {
                 numRead = mSock->receive( buffer, bufferLength, 0 );
                 
                 if( numRead > 0 ) {
-                    for( int i=0; i<numRead; i++ ) {
-                        mResponse.push_back( buffer[i] );
-                        }
+                    mResponse.push_back( (char *)buffer, numRead );
                     }
                 }
             
@@ -345,75 +402,75 @@ int WebRequest::step() {
             delete [] buffer;
             
 
-            if( numRead == -1 ) {
-                // connection closed, done done receiving result
+            char connectionClosed = ( numRead == -1 );
+            
+            if( connectionClosed && retryIfReuseFailed() ) {
+                return 0;
+                }
+            
 
-                // process it
+            // server may keep connection open, so response framing
+            // (not connection close) tells us when we're done
+            int responseLength = mResponse.size();
+            
+            char *response = NULL;
+            if( responseLength > 0 ) {
+                response = mResponse.getElementFast( 0 );
+                }
+            
+            HTTPResponseInfo info;
+            
+            int checkResult = checkHTTPResponse( response, responseLength,
+                                                 connectionClosed,
+                                                 mNoBody,
+                                                 &info,
+                                                 &mResponseParseState );
+            
+            if( checkResult == 0 ) {
+                // still receiving response
+                return 0;
+                }
+            
+            if( checkResult == -1 ) {
+                mError = true;
                 
                 char *responseString = mResponse.getElementString();
-                int responseLength = mResponse.size();
                 
-                if( stringLocateIgnoreCase( responseString, "404 Not Found" ) 
-                    != NULL ) {
-                    
-                    mError = true;
-                    delete [] responseString;
+                printf( "Error:  "
+                        "WebRequest got badly formatted response:\n%s\n",
+                        responseString );
 
-                    printf( "Error:  "
-                            "WebRequest got 404 Not Found error for URL:  %s",
-                            mURL );
+                delete [] responseString;
                     
-                    return -1;
-                    }
-
-                const char *contentStartString = "\r\n\r\n";
-                
-                char *contentStart = strstr( responseString, 
-                                             contentStartString );
+                return -1;
+                }
             
-                if( contentStart != NULL ) {
-                    // skip start string
-                    char *content =
-                        &( contentStart[ strlen( contentStartString ) ] );
-
-
-                    // pointer arithmetic:
-                    // ugly, but we don't know that result does not contain
-                    // \0, so we can't use streln to find result length
-                    int resultLength =
-                        responseLength
-                        - strlen( contentStartString )
-                        - (int)( contentStart - responseString );
-
-                    mResultSize = resultLength;
-                    
-                    mResult = new char[ resultLength + 1 ];
-                    memcpy( mResult,
-                            content, resultLength );
-
-                    mResult[ resultLength ] = '\0';
-                    mResultReady = true;
-                    
-                    delete [] responseString;
-                    return 1;
-                    }
-                else {
-                    mError = true;
-
-                    printf( "Error:  "
-                            "WebRequest got badly formatted response:\n%s\n",
-                            responseString );
+            
+            if( info.statusCode == 404 ) {
+                mError = true;
 
-                    delete [] responseString;
+                printf( "Error:  "
+                        "WebRequest got 404 Not Found error for URL:  %s",
+                        mURL );
                     
-                    return -1;
-                    }
+                return -1;
                 }
-            else {
-                // still receiving response
-                return 0;
+            
+            mResult = getHTTPResponseBody( response, &info, &mResultSize );
+            mResultReady = true;
+
+            
+            if( info.keepAlive && ! connectionClosed &&
+                responseLength == info.totalLength ) {
+                
+                // nothing extra waiting on it, safe to reuse
+                WebConnectionPool::returnConnection(
+                    mSuppliedAddress->mAddressString, 
+                    mSuppliedAddress->mPort, mSock );
+                mSock = NULL;
                 }
             
+            return 1;
             }
         }
 
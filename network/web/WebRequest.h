@@ -6,9 +6,17 @@
 #include "minorGems/network/HostAddress.h"
 #include "minorGems/network/LookupThread.h"
 
+#include "minorGems/util/SimpleVector.h"
+
+#include "minorGems/network/web/httpResponseUtils.h"
+
 
 
 // a non-blocking web request
+//
+// Requests are made with HTTP/1.1.  Connections left open by the server
+// are handed to WebConnectionPool, and later requests to the same server
+// reuse them (and its cached host name lookup) when possible.
 class WebRequest {
         
 
@@ -57,6 +65,9 @@ class WebRequest {
 
     protected:
         char mError;
+
+        // true for HEAD requests, which get no response body
+        char mNoBody;
         
         char *mURL;
 
@@ -65,6 +76,9 @@ class WebRequest {
         int mRequestPosition;
         
         SimpleVector<char> mResponse;
+
+        // how far mResponse has been checked for completeness
+        HTTPResponseParseState mResponseParseState;
         
         char mResultReady;
         
@@ -78,8 +92,21 @@ class WebRequest {
         
         Socket *mSock;
 
+        // true if mSock came from WebConnectionPool
+        char mConnectionReused;
+
         double mRequestStartTime;
         double mRequestTimeoutSeconds;
+
+
+        // takes a pooled connection if one is available and
+        // inAllowReuse is set, or else starts looking up mSuppliedAddress
+        void startConnecting( char inAllowReuse );
+
+        // a pooled connection can be closed by the server just as we
+        // reuse it, in which case we start over on a fresh connection
+        // returns true if request restarted
+        char retryIfReuseFailed();
     };
 
 
@@ -0,0 +1,394 @@
+#include "httpResponseUtils.h"
+
+#include "minorGems/util/stringUtils.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+
+
+
+// finds the \r\n that ends the line starting at inStart
+// returns its index, or -1 if line not complete yet
+static int findLineEnd( const char *inData, int inStart, int inLength ) {
+    for( int i=inStart; i<inLength - 1; i++ ) {
+        if( inData[i] == '\r' && inData[i+1] == '\n' ) {
+            return i;
+            }
+        }
+    return -1;
+    }
+
+
+
+// gets the header block (status line and headers, without the final
+// blank line) as a \0-terminated string
+// returns NULL if header block not complete yet
+// inStart skips bytes already known not to end the block
+static char *getHeaderBlock( const char *inData, int inLength,
+                             int inStart = 0 ) {
+    for( int i=inStart; i<inLength - 3; i++ ) {
+        if( inData[i] == '\r' && inData[i+1] == '\n' &&
+            inData[i+2] == '\r' && inData[i+3] == '\n' ) {
+
+            // keep the \r\n ending the last header, so that every
+            // header line can be found by searching for \r\nName:
+            char *block = new char[ i + 3 ];
+            memcpy( block, inData, i + 2 );
+            block[ i + 2 ] = '\0';
+            return block;
+            }
+        }
+    return NULL;
+    }
+
+
+
+// finds a header in a header block
+// returns its trimmed value, or NULL if not found
+static char *findHeader( char *inHeaderBlock, const char *inName ) {
+
+    char *lowerBlock = stringToLowerCase( inHeaderBlock );
+
+    char *lowerName = stringToLowerCase( inName );
+    char *key = autoSprintf( "\r\n%s:", lowerName );
+    delete [] lowerName;
+
+    char *value = NULL;
+
+    char *keyStart = strstr( lowerBlock, key );
+
+    if( keyStart != NULL ) {
+        // same offset in original, so value keeps its case
+        char *valueStart =
+            &( inHeaderBlock[ ( keyStart - lowerBlock ) + strlen( key ) ] );
+
+        char *valueEnd = strstr( valueStart, "\r\n" );
+
+        char oldChar = valueEnd[0];
+        valueEnd[0] = '\0';
+
+        value = trimWhitespace( valueStart );
+
+        valueEnd[0] = oldChar;
+        }
+
+    delete [] key;
+    delete [] lowerBlock;
+
+    return value;
+    }
+
+
+
+void initHTTPResponseParseState( HTTPResponseParseState *outState ) {
+    outState->headerScanned = 0;
+    outState->headerParsed = false;
+    outState->chunkPosition = 0;
+    outState->inTrailers = false;
+    }
+
+
+
+// fills in framing info from a complete header block
+// returns false if malformed
+static char parseHeaderBlock( char *inHeaderBlock,
+                              HTTPResponseInfo *outInfo ) {
+    HTTPResponseInfo info;
+
+    // includes blank line
+    info.headerLength = strlen( inHeaderBlock ) + 2;
+
+    int minorVersion;
+
+    int numRead = sscanf( inHeaderBlock, "HTTP/1.%d %d",
+                          &minorVersion, &( info.statusCode ) );
+
+    if( numRead != 2 ) {
+        return false;
+        }
+
+
+    info.contentLength = -1;
+
+    char *lengthString = findHeader( inHeaderBlock, "Content-Length" );
+
+    if( lengthString != NULL ) {
+        sscanf( lengthString, "%d", &( info.contentLength ) );
+        delete [] lengthString;
+        }
+
+
+    info.chunked = false;
+
+    char *encodingString = findHeader( inHeaderBlock, "Transfer-Encoding" );
+
+    if( encodingString != NULL ) {
+        if( stringLocateIgnoreCase( encodingString, "chunked" ) != NULL ) {
+            info.chunked = true;
+            }
+        delete [] encodingString;
+        }
+
+
+    // HTTP/1.1 connections stay open unless server says otherwise,
+    // and HTTP/1.0 ones close unless server says otherwise
+    info.keepAlive = ( minorVersion >= 1 );
+
+    char *connectionString = findHeader( inHeaderBlock, "Connection" );
+
+    if( connectionString != NULL ) {
+        if( stringLocateIgnoreCase( connectionString, "close" ) != NULL ) {
+            info.keepAlive = false;
+            }
+        else if( stringLocateIgnoreCase( connectionString, "keep-alive" )
+                 != NULL ) {
+            info.keepAlive = true;
+            }
+        delete [] connectionString;
+        }
+
+    info.totalLength = 0;
+
+    *outInfo = info;
+    return true;
+    }
+
+
+
+int checkHTTPResponse( const char *inData, int inLength,
+                       char inConnectionClosed, char inNoBody,
+                       HTTPResponseInfo *outInfo,
+                       HTTPResponseParseState *inOutState ) {
+
+    HTTPResponseParseState freshState;
+
+    HTTPResponseParseState *state = inOutState;
+
+    if( state == NULL ) {
+        initHTTPResponseParseState( &freshState );
+        state = &freshState;
+        }
+
+
+    if( ! state->headerParsed ) {
+
+        // the blank line may straddle what we've scanned and new bytes
+        int scanStart = state->headerScanned - 3;
+        if( scanStart < 0 ) {
+            scanStart = 0;
+            }
+
+        char *headerBlock = getHeaderBlock( inData, inLength, scanStart );
+
+        if( headerBlock == NULL ) {
+            state->headerScanned = inLength;
+
+            if( inConnectionClosed ) {
+                return -1;
+                }
+            return 0;
+            }
+
+        char parsed = parseHeaderBlock( headerBlock, &( state->info ) );
+
+        delete [] headerBlock;
+
+        if( ! parsed ) {
+            return -1;
+            }
+
+        state->headerParsed = true;
+        state->chunkPosition = state->info.headerLength;
+        }
+
+
+    HTTPResponseInfo info = state->info;
+
+
+    if( inNoBody ||
+        ( info.statusCode >= 100 && info.statusCode < 200 ) ||
+        info.statusCode == 204 || info.statusCode == 304 ) {
+
+        info.chunked = false;
+        info.contentLength = 0;
+        info.totalLength = info.headerLength;
+
+        *outInfo = info;
+        return 1;
+        }
+
+
+    if( info.chunked ) {
+        // walk chunks to find end, starting after the last complete
+        // chunk that an earlier call walked past
+        int pos = state->chunkPosition;
+
+        while( ! state->inTrailers ) {
+            int lineEnd = findLineEnd( inData, pos, inLength );
+
+            if( lineEnd == -1 ) {
+                return inConnectionClosed ? -1 : 0;
+                }
+
+            // size line, possibly followed by ;extensions
+            char sizeLine[ 20 ];
+            int sizeLineLength = lineEnd - pos;
+            if( sizeLineLength > 19 ) {
+                sizeLineLength = 19;
+                }
+            memcpy( sizeLine, &( inData[pos] ), sizeLineLength );
+            sizeLine[ sizeLineLength ] = '\0';
+
+            int chunkSize;
+            if( sscanf( sizeLine, "%x", &chunkSize ) != 1 ||
+                chunkSize < 0 ) {
+                return -1;
+                }
+
+            pos = lineEnd + 2;
+
+            if( chunkSize == 0 ) {
+                state->inTrailers = true;
+                state->chunkPosition = pos;
+                break;
+                }
+
+            // chunk data, then \r\n
+            if( chunkSize > INT_MAX - pos - 2 ) {
+                // can never fit in our buffer
+                return -1;
+                }
+            if( chunkSize > inLength - pos - 2 ) {
+                return inConnectionClosed ? -1 : 0;
+                }
+
+            pos += chunkSize;
+
+            if( inData[pos] != '\r' || inData[pos+1] != '\n' ) {
+                return -1;
+                }
+            pos += 2;
+
+            state->chunkPosition = pos;
+            }
+
+        // skip trailer headers, up to blank line
+        while( true ) {
+            int lineEnd = findLineEnd( inData, pos, inLength );
+
+            if( lineEnd == -1 ) {
+                return inConnectionClosed ? -1 : 0;
+                }
+
+            char blankLine = ( lineEnd == pos );
+
+            pos = lineEnd + 2;
+
+            if( blankLine ) {
+                info.totalLength = pos;
+
+                *outInfo = info;
+                return 1;
+                }
+
+            state->chunkPosition = pos;
+            }
+        }
+
+
+    if( info.contentLength >= 0 ) {
+        if( info.contentLength > INT_MAX - info.headerLength ) {
+            // can never fit in our buffer
+            return -1;
+            }
+
+        info.totalLength = info.headerLength + info.contentLength;
+
+        if( inLength < info.totalLength ) {
+            return inConnectionClosed ? -1 : 0;
+            }
+
+        *outInfo = info;
+        return 1;
+        }
+
+
+    // body runs until connection closes
+    if( !inConnectionClosed ) {
+        return 0;
+        }
+
+    info.keepAlive = false;
+    info.contentLength = inLength - info.headerLength;
+    info.totalLength = inLength;
+
+    *outInfo = info;
+    return 1;
+    }
+
+
+
+char *getHTTPResponseBody( const char *inData, HTTPResponseInfo *inInfo,
+                           int *outLength ) {
+
+    if( !inInfo->chunked ) {
+        int length = inInfo->totalLength - inInfo->headerLength;
+
+        char *body = new char[ length + 1 ];
+        memcpy( body, &( inData[ inInfo->headerLength ] ), length );
+        body[ length ] = '\0';
+
+        *outLength = length;
+        return body;
+        }
+
+
+    // decoded body can't be longer than chunked one
+    char *body = new char[ inInfo->totalLength - inInfo->headerLength + 1 ];
+    int length = 0;
+
+    // already validated by checkHTTPResponse
+    int pos = inInfo->headerLength;
+
+    while( true ) {
+        int lineEnd = findLineEnd( inData, pos, inInfo->totalLength );
+
+        int chunkSize = 0;
+        sscanf( &( inData[pos] ), "%x", &chunkSize );
+
+        pos = lineEnd + 2;
+
+        if( chunkSize == 0 ) {
+            break;
+            }
+
+        memcpy( &( body[length] ), &( inData[pos] ), chunkSize );
+        length += chunkSize;
+
+        pos += chunkSize + 2;
+        }
+
+    body[ length ] = '\0';
+
+    *outLength = length;
+    return body;
+    }
+
+
+
+char *getHTTPResponseHeader( const char *inData, HTTPResponseInfo *inInfo,
+                             const char *inName ) {
+
+    char *headerBlock = getHeaderBlock( inData, inInfo->headerLength );
+
+    if( headerBlock == NULL ) {
+        return NULL;
+        }
+
+    char *value = findHeader( headerBlock, inName );
+
+    delete [] headerBlock;
+
+    return value;
+    }
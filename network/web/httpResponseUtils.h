@@ -0,0 +1,126 @@
+#ifndef HTTP_RESPONSE_UTILS_INCLUDED
+#define HTTP_RESPONSE_UTILS_INCLUDED
+
+
+#include <stddef.h>
+
+
+
+// framing information about a received HTTP response
+typedef struct HTTPResponseInfo {
+        int statusCode;
+
+        // bytes in status line and headers, including final blank line
+        int headerLength;
+
+        // -1 if response has no Content-Length header
+        int contentLength;
+
+        char chunked;
+
+        // true if server will leave connection open after this response
+        char keepAlive;
+
+        // total bytes taken by response on the wire, once complete
+        int totalLength;
+
+    } HTTPResponseInfo;
+
+
+
+// how far checkHTTPResponse has gotten through a response that is
+// still arriving, so that each call only looks at new bytes
+typedef struct HTTPResponseParseState {
+        // bytes already searched for the end of the header block
+        int headerScanned;
+
+        char headerParsed;
+
+        // filled in from header block once headerParsed is set
+        HTTPResponseInfo info;
+
+        // for chunked bodies, start of next chunk size line
+        // (or next trailer line, if inTrailers is set)
+        int chunkPosition;
+        char inTrailers;
+
+    } HTTPResponseParseState;
+
+
+
+/**
+ * Readies a parse state for a new response.
+ *
+ * @param outState the state to reset.  Destroyed by caller.
+ */
+void initHTTPResponseParseState( HTTPResponseParseState *outState );
+
+
+
+/**
+ * Checks whether a complete HTTP response has been received.
+ *
+ * Handles bodies framed by Content-Length, by chunked transfer-encoding,
+ * or by the server closing the connection.
+ *
+ * @param inData the bytes received so far.  Need not be \0-terminated.
+ *   Destroyed by caller.
+ * @param inLength the number of bytes in inData.
+ * @param inConnectionClosed true if the server has closed the connection,
+ *   so no more data is coming.
+ * @param inNoBody true if response has no body regardless of its headers
+ *   (for example, response to a HEAD request).
+ * @param outInfo pointer to where response framing should be returned.
+ *   Filled in only if response is complete.
+ * @param inOutState parse state carried between calls for the same
+ *   response, set up with initHTTPResponseParseState, so that bytes
+ *   checked by earlier calls aren't scanned again.  inData must then
+ *   start with the bytes passed to earlier calls (though it may have
+ *   moved).  NULL to check inData from the start.  Defaults to NULL.
+ *   Destroyed by caller.
+ *
+ * @return 1 if response is complete, 0 if more data is needed,
+ *   or -1 if response is malformed (or truncated by a closed connection).
+ */
+int checkHTTPResponse( const char *inData, int inLength,
+                       char inConnectionClosed, char inNoBody,
+                       HTTPResponseInfo *outInfo,
+                       HTTPResponseParseState *inOutState = NULL );
+
+
+
+/**
+ * Extracts the body from a complete HTTP response, decoding chunked
+ * transfer-encoding if needed.
+ *
+ * @param inData the response bytes.  Destroyed by caller.
+ * @param inInfo the framing info returned by checkHTTPResponse.
+ *   Destroyed by caller.
+ * @param outLength pointer to where the body length should be returned.
+ *
+ * @return the body, with an extra \0 appended past outLength bytes.
+ *   Destroyed by caller.
+ */
+char *getHTTPResponseBody( const char *inData, HTTPResponseInfo *inInfo,
+                           int *outLength );
+
+
+
+/**
+ * Gets the value of a header in a complete HTTP response.
+ *
+ * @param inData the response bytes.  Destroyed by caller.
+ * @param inInfo the framing info returned by checkHTTPResponse.
+ *   Destroyed by caller.
+ * @param inName the header name, without colon, like "Content-Type".
+ *   Matched ignoring case.  Destroyed by caller.
+ *
+ * @return the header value with surrounding whitespace trimmed, or NULL
+ *   if header not present.  Destroyed by caller if non-NULL.
+ */
+char *getHTTPResponseHeader( const char *inData, HTTPResponseInfo *inInfo,
+                             const char *inName );
+
+
+
+#endif
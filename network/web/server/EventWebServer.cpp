@@ -0,0 +1,734 @@
+#include "EventWebServer.h"
+
+
+#include "minorGems/util/log/AppLog.h"
+#include "minorGems/util/stringUtils.h"
+#include "minorGems/util/StringBufferOutputStream.h"
+#include "minorGems/system/Time.h"
+
+#include <string.h>
+#include <stdio.h>
+
+
+
+// destroys a connection and closes its socket
+static void deleteConnection( WebConnection *inConnection ) {
+    delete inConnection->sock;
+    delete [] inConnection->inputBuffer;
+
+    if( inConnection->outputBuffer != NULL ) {
+        delete [] inConnection->outputBuffer;
+        }
+
+    delete inConnection;
+    }
+
+
+
+EventWebServerWorker::EventWebServerWorker( EventWebServer *inServer )
+        : mServer( inServer ) {
+
+    start();
+    }
+
+
+
+EventWebServerWorker::~EventWebServerWorker() {
+    stop();
+    join();
+    }
+
+
+
+void EventWebServerWorker::run() {
+    while( !isStopped() ) {
+
+        // time out now and then to check for stop signal
+        WebConnection *connection = mServer->getNextJob( 100 );
+
+        if( connection != NULL ) {
+            mServer->handleConnection( connection );
+            }
+        }
+    }
+
+
+
+
+EventWebServer::EventWebServer( int inPort, PageGenerator *inGenerator,
+                                int inNumWorkers,
+                                int inKeepAliveSeconds )
+    : mPortNumber( inPort ),
+      // we accept in bursts, so a connection storm can easily
+      // overrun a short listen queue before we get to it
+      mMaxQueuedConnections( 1024 ),
+      mKeepAliveSeconds( inKeepAliveSeconds ),
+      mPageGenerator( inGenerator ),
+      mConnectionPermissionHandler( new ConnectionPermissionHandler() ),
+      mPoll( socketPollOneShot ),
+      mJobSemaphore( 0 ),
+      mNextJob( 0 ) {
+
+    mServer = new SocketServer( mPortNumber, mMaxQueuedConnections );
+
+    mPoll.addSocketServer( mServer );
+
+    for( int i=0; i<inNumWorkers; i++ ) {
+        mWorkers.push_back( new EventWebServerWorker( this ) );
+        }
+
+    this->start();
+    }
+
+
+
+EventWebServer::~EventWebServer() {
+    stop();
+    join();
+
+    for( int i=0; i<mWorkers.size(); i++ ) {
+        delete mWorkers.getElementDirect( i );
+        }
+
+
+    // no more workers, so every connection is ours now
+    for( int i=0; i<mConnections.size(); i++ ) {
+        deleteConnection( mConnections.getElementDirect( i ) );
+        }
+
+    // closed ones have already been removed from mConnections
+    for( int i=0; i<mClosedConnections.size(); i++ ) {
+        deleteConnection( mClosedConnections.getElementDirect( i ) );
+        }
+
+    mPoll.removeSocketServer( mServer );
+    delete mServer;
+
+    delete mPageGenerator;
+
+    delete mConnectionPermissionHandler;
+    }
+
+
+
+void EventWebServer::run() {
+
+    char *logMessage = autoSprintf(
+        "Listening for connections on port %d with %d worker threads\n",
+        mPortNumber, mWorkers.size() );
+
+    AppLog::info( "EventWebServer", logMessage );
+
+    delete [] logMessage;
+
+
+    SocketOrServer *ready[ 64 ];
+
+    double lastSweepTime = Time::getCurrentTime();
+
+
+    // main server loop
+    while( !isStopped() ) {
+
+        // 100 ms
+        // responsive quit without burning CPU waiting
+        // (workers wake us sooner when they hand connections back)
+        int numReady = mPoll.waitMany( ready, 64, 100 );
+
+        for( int i=0; i<numReady; i++ ) {
+            SocketOrServer *s = ready[i];
+
+            if( ! s->isSocket ) {
+                acceptConnections();
+                }
+            else {
+                WebConnection *connection = (WebConnection *)s->otherData;
+
+                mPollLock.lock();
+                connection->busy = true;
+                mPollLock.unlock();
+
+                addJob( connection );
+                }
+            }
+
+
+        mPollLock.lock();
+
+        for( int i=0; i<mRearmConnections.size(); i++ ) {
+            WebConnection *connection =
+                mRearmConnections.getElementDirect( i );
+
+            // watch for room to send waiting output, and stop
+            // watching once it has all been sent
+            char watchWrite = ( connection->outputBuffer != NULL );
+
+            if( watchWrite != connection->watchingWrite ) {
+                // re-arms too
+                mPoll.setWatchWrite( connection->sock, watchWrite );
+                connection->watchingWrite = watchWrite;
+                }
+            else {
+                mPoll.rearmSocket( connection->sock );
+                }
+            }
+        mRearmConnections.deleteAll();
+
+
+        for( int i=0; i<mClosedConnections.size(); i++ ) {
+            WebConnection *connection =
+                mClosedConnections.getElementDirect( i );
+
+            mPoll.removeSocket( connection->sock );
+
+            deleteConnection( connection );
+            }
+        mClosedConnections.deleteAll();
+
+
+        double currentTime = Time::getCurrentTime();
+
+        if( currentTime - lastSweepTime > 1 ) {
+            // close idle keep-alive connections
+            lastSweepTime = currentTime;
+
+            // walk backwards, since destroying swaps last connection
+            // into the destroyed one's place
+            for( int i=mConnections.size() - 1; i>=0; i-- ) {
+                WebConnection *connection =
+                    mConnections.getElementDirect( i );
+
+                if( ! connection->busy &&
+                    currentTime - connection->lastActivityTime >
+                    mKeepAliveSeconds ) {
+
+                    destroyConnection( connection );
+                    }
+                }
+            }
+
+        mPollLock.unlock();
+        }
+
+    AppLog::info( "EventWebServer", "Received stop signal." );
+    }
+
+
+
+void EventWebServer::acceptConnections() {
+
+    char timedOut = false;
+
+    // accept all that are waiting
+    while( !timedOut ) {
+        Socket *sock = mServer->acceptConnection( 0, &timedOut );
+
+        if( sock == NULL ) {
+            if( !timedOut ) {
+                AppLog::error( "EventWebServer",
+                               "Accepting a connection failed." );
+                }
+            break;
+            }
+
+
+        HostAddress *receivedAddress = sock->getRemoteHostAddress();
+
+        if( receivedAddress == NULL ||
+            ! mConnectionPermissionHandler->isPermitted(
+                receivedAddress ) ) {
+
+            AppLog::info( "EventWebServer", "Refusing web connection." );
+
+            if( receivedAddress != NULL ) {
+                delete receivedAddress;
+                }
+            delete sock;
+            continue;
+            }
+
+        delete receivedAddress;
+
+
+        WebConnection *connection = new WebConnection;
+
+        connection->sock = sock;
+        connection->inputBuffer = new char[ EVENT_WEB_SERVER_BUFFER_SIZE ];
+        connection->numInputBytes = 0;
+        connection->outputBuffer = NULL;
+        connection->numOutputBytes = 0;
+        connection->numOutputBytesSent = 0;
+        connection->watchingWrite = false;
+        connection->lastActivityTime = Time::getCurrentTime();
+        connection->busy = false;
+        connection->closing = false;
+        connection->closeWhenSent = false;
+
+        mPollLock.lock();
+
+        connection->listIndex = mConnections.size();
+        mConnections.push_back( connection );
+
+        mPollLock.unlock();
+
+        mPoll.addSocket( sock, connection );
+        }
+
+    mPoll.rearmSocketServer( mServer );
+    }
+
+
+
+void EventWebServer::destroyConnection( WebConnection *inConnection ) {
+
+    mPoll.removeSocket( inConnection->sock );
+
+    // swap last connection into our spot
+    WebConnection *last = mConnections.getLastElementDirect();
+
+    *( mConnections.getElementFast( inConnection->listIndex ) ) = last;
+    last->listIndex = inConnection->listIndex;
+
+    mConnections.deleteLastElement();
+
+    deleteConnection( inConnection );
+    }
+
+
+
+void EventWebServer::addJob( WebConnection *inConnection ) {
+    mJobLock.lock();
+    mJobs.push_back( inConnection );
+    mJobLock.unlock();
+
+    mJobSemaphore.signal();
+    }
+
+
+
+WebConnection *EventWebServer::getNextJob( int inTimeoutMS ) {
+    mJobSemaphore.wait( inTimeoutMS );
+
+    WebConnection *connection = NULL;
+
+    mJobLock.lock();
+
+    if( mNextJob < mJobs.size() ) {
+        connection = mJobs.getElementDirect( mNextJob );
+        mNextJob ++;
+
+        // avoid shifting whole queue on every take
+        if( mNextJob == mJobs.size() ) {
+            mJobs.deleteAll();
+            mNextJob = 0;
+            }
+        else if( mNextJob > 1024 ) {
+            mJobs.deleteStartElements( mNextJob );
+            mNextJob = 0;
+            }
+        }
+
+    mJobLock.unlock();
+
+    return connection;
+    }
+
+
+
+// finds end of a request's header block
+// returns index just past the blank line, or -1 if not all here yet
+static int findRequestEnd( char *inBuffer, int inNumBytes ) {
+    for( int i=3; i<inNumBytes; i++ ) {
+        if( inBuffer[i] == '\n' &&
+            inBuffer[i-1] == '\r' &&
+            inBuffer[i-2] == '\n' &&
+            inBuffer[i-3] == '\r' ) {
+            return i + 1;
+            }
+        }
+    return -1;
+    }
+
+
+
+// closes a connection once the response just sent on it is done
+static void closeAfterResponse( WebConnection *inConnection ) {
+    if( inConnection->outputBuffer != NULL ) {
+        inConnection->closeWhenSent = true;
+        }
+    else {
+        inConnection->closing = true;
+        }
+    }
+
+
+
+void EventWebServer::handleConnection( WebConnection *inConnection ) {
+
+    Socket *sock = inConnection->sock;
+
+    if( inConnection->outputBuffer != NULL ) {
+        // finish sending earlier response before serving any more
+        sendSavedOutput( inConnection );
+
+        if( inConnection->outputBuffer == NULL &&
+            inConnection->closeWhenSent ) {
+            inConnection->closing = true;
+            }
+        }
+
+    // only take one read's worth of requests before handing connection
+    // back, so a client that sends requests back-to-back can't hog
+    // this worker
+    // (unless read filled our buffer, meaning more might be waiting)
+    char bufferFilled = true;
+
+    while( bufferFilled && !inConnection->closing &&
+           inConnection->outputBuffer == NULL ) {
+
+        bufferFilled = false;
+
+        int roomLeft =
+            EVENT_WEB_SERVER_BUFFER_SIZE - inConnection->numInputBytes;
+
+        if( roomLeft > 0 ) {
+            // never block, only take what is already here
+            int numRead = sock->receive(
+                (unsigned char *)
+                &( inConnection->inputBuffer[ inConnection->numInputBytes ] ),
+                roomLeft, 0 );
+
+            if( numRead == -1 ) {
+                // error or closed by client
+                inConnection->closing = true;
+                break;
+                }
+            else if( numRead > 0 ) {
+                inConnection->numInputBytes += numRead;
+
+                if( numRead == roomLeft ) {
+                    bufferFilled = true;
+                    }
+                }
+            // else -2, nothing waiting
+            }
+
+
+        // serve all complete requests in buffer, in order
+        // (pipelining)
+        char servedAny = false;
+
+        int requestEnd = findRequestEnd( inConnection->inputBuffer,
+                                         inConnection->numInputBytes );
+
+        // a response still waiting to be sent holds up the rest
+        while( requestEnd != -1 && !inConnection->closing &&
+               inConnection->outputBuffer == NULL ) {
+
+            // replace final \n with \0 to terminate header block
+            inConnection->inputBuffer[ requestEnd - 1 ] = '\0';
+
+            char keepAlive = handleRequest( inConnection,
+                                            inConnection->inputBuffer );
+            servedAny = true;
+
+            int numLeft = inConnection->numInputBytes - requestEnd;
+
+            memmove( inConnection->inputBuffer,
+                     &( inConnection->inputBuffer[ requestEnd ] ),
+                     numLeft );
+            inConnection->numInputBytes = numLeft;
+
+            if( !keepAlive ) {
+                closeAfterResponse( inConnection );
+                }
+            else {
+                requestEnd = findRequestEnd( inConnection->inputBuffer,
+                                             inConnection->numInputBytes );
+                }
+            }
+
+
+        if( !inConnection->closing && !servedAny &&
+            inConnection->numInputBytes == EVENT_WEB_SERVER_BUFFER_SIZE ) {
+            // full buffer with no complete request in it
+            sendBadRequest( inConnection );
+            closeAfterResponse( inConnection );
+            }
+        }
+
+
+    mPollLock.lock();
+
+    inConnection->busy = false;
+
+    if( inConnection->closing ) {
+        // run thread will destroy it
+
+        // (swap last connection into our spot)
+        WebConnection *last = mConnections.getLastElementDirect();
+
+        *( mConnections.getElementFast( inConnection->listIndex ) ) = last;
+        last->listIndex = inConnection->listIndex;
+
+        mConnections.deleteLastElement();
+
+        mClosedConnections.push_back( inConnection );
+        }
+    else {
+        inConnection->lastActivityTime = Time::getCurrentTime();
+
+        mRearmConnections.push_back( inConnection );
+        }
+
+    mPollLock.unlock();
+
+    // don't leave it for the run thread's next timeout
+    mPoll.wakeUp();
+    }
+
+
+
+    // example HTTP/1.1 pipelined request and keep-alive response
+    /*
+      GET /a.html HTTP/1.1
+      Host: example.com
+
+      GET /b.html HTTP/1.1
+      Host: example.com
+
+      HTTP/1.1 200 OK
+      Content-Type: text/html
+      Content-Length: 7963
+      Connection: keep-alive
+
+      <html>...
+    */
+
+
+
+char EventWebServer::handleRequest( WebConnection *inConnection,
+                                    char *inRequest ) {
+
+    char method[16];
+    char path[ EVENT_WEB_SERVER_BUFFER_SIZE ];
+    char version[16];
+
+    // widths bound to array sizes above
+    int numScanned = sscanf( inRequest, "%15s %8191s %15s",
+                             method, path, version );
+
+    if( numScanned < 2 || strcmp( method, "GET" ) != 0 ) {
+        sendBadRequest( inConnection );
+        return false;
+        }
+
+
+    // HTTP/1.1 keeps connections alive unless told otherwise,
+    // and earlier versions close them unless told otherwise
+    char keepAlive = ( numScanned == 3 &&
+                       strcmp( version, "HTTP/1.1" ) == 0 );
+
+    char *connectionHeader = stringLocateIgnoreCase( inRequest,
+                                                     "\nConnection:" );
+    if( connectionHeader != NULL ) {
+        char *lineEnd = strstr( connectionHeader + 1, "\r\n" );
+
+        char *value;
+        if( lineEnd != NULL ) {
+            int length = lineEnd - connectionHeader;
+            value = new char[ length + 1 ];
+            memcpy( value, connectionHeader, length );
+            value[ length ] = '\0';
+            }
+        else {
+            value = stringDuplicate( connectionHeader );
+            }
+
+        if( stringLocateIgnoreCase( value, "close" ) != NULL ) {
+            keepAlive = false;
+            }
+        else if( stringLocateIgnoreCase( value, "keep-alive" ) != NULL ) {
+            keepAlive = true;
+            }
+        delete [] value;
+        }
+
+
+    StringBufferOutputStream pageStream;
+
+    mPageGenerator->generatePage( path, &pageStream );
+
+    int pageLength;
+    unsigned char *page = pageStream.getBytes( &pageLength );
+
+
+    char *cacheString;
+
+    int cacheSeconds = mPageGenerator->getCacheMaxAge( path );
+
+    if( cacheSeconds == 0 ) {
+        cacheString = stringDuplicate( "cache-control: no-cache\r\n" );
+        }
+    else {
+        cacheString = autoSprintf(
+            "cache-control: private, max-age=%d\r\n",
+            cacheSeconds );
+        }
+
+    char *mimeType = mPageGenerator->getMimeType( path );
+
+    const char *connectionString = "close";
+    if( keepAlive ) {
+        connectionString = "keep-alive";
+        }
+
+    char *header = autoSprintf( "HTTP/1.1 200 OK\r\n"
+                                "%s"
+                                "Content-Type: %s\r\n"
+                                "Content-Length: %d\r\n"
+                                "Connection: %s\r\n"
+                                "\r\n",
+                                cacheString, mimeType, pageLength,
+                                connectionString );
+    delete [] cacheString;
+    delete [] mimeType;
+
+
+    // header and body in one send, without copying them together
+    SocketSendSlice slices[2];
+    slices[0].buffer = (unsigned char *)header;
+    slices[0].numBytes = strlen( header );
+    slices[1].buffer = page;
+    slices[1].numBytes = pageLength;
+
+    sendResponse( inConnection, slices, 2 );
+
+    delete [] header;
+    delete [] page;
+
+    return keepAlive;
+    }
+
+
+
+void EventWebServer::sendBadRequest( WebConnection *inConnection ) {
+
+    const char *body =
+        "<HTML><BODY><H1>400 Bad Request</H1>"
+        "Your client has issued a malformed or illegal request."
+        "</BODY></HTML>\r\n";
+
+    char *response = autoSprintf( "HTTP/1.1 400 Bad Request\r\n"
+                                  "Content-Type: text/html\r\n"
+                                  "Content-Length: %d\r\n"
+                                  "Connection: close\r\n"
+                                  "\r\n"
+                                  "%s",
+                                  (int)strlen( body ), body );
+
+    SocketSendSlice slice;
+    slice.buffer = (unsigned char *)response;
+    slice.numBytes = strlen( response );
+
+    sendResponse( inConnection, &slice, 1 );
+
+    delete [] response;
+    }
+
+
+
+void EventWebServer::sendResponse( WebConnection *inConnection,
+                                   SocketSendSlice *inSlices,
+                                   int inNumSlices ) {
+
+    // nothing else may be waiting, or this would jump ahead of it
+    // (handleConnection serves no requests while output is waiting)
+
+    int totalLength = 0;
+    int i;
+    for( i=0; i<inNumSlices; i++ ) {
+        totalLength += inSlices[i].numBytes;
+        }
+
+    int numSent = inConnection->sock->sendv( inSlices, inNumSlices,
+                                             false );
+
+    if( numSent == -1 ) {
+        inConnection->closing = true;
+        return;
+        }
+    if( numSent == -2 ) {
+        numSent = 0;
+        }
+
+    if( numSent == totalLength ) {
+        return;
+        }
+
+
+    // save the rest for when socket is writable
+    int numLeft = totalLength - numSent;
+
+    unsigned char *buffer = new unsigned char[ numLeft ];
+    int numSaved = 0;
+
+    // bytes of slices that have been passed over
+    int sliceStart = 0;
+
+    for( i=0; i<inNumSlices; i++ ) {
+        int sliceEnd = sliceStart + inSlices[i].numBytes;
+
+        if( sliceEnd > numSent ) {
+            // some of this slice wasn't sent
+            int offset = 0;
+            if( numSent > sliceStart ) {
+                offset = numSent - sliceStart;
+                }
+
+            int length = inSlices[i].numBytes - offset;
+
+            memcpy( &( buffer[ numSaved ] ),
+                    &( inSlices[i].buffer[ offset ] ), length );
+            numSaved += length;
+            }
+
+        sliceStart = sliceEnd;
+        }
+
+    inConnection->outputBuffer = buffer;
+    inConnection->numOutputBytes = numLeft;
+    inConnection->numOutputBytesSent = 0;
+    }
+
+
+
+void EventWebServer::sendSavedOutput( WebConnection *inConnection ) {
+
+    int numLeft =
+        inConnection->numOutputBytes - inConnection->numOutputBytesSent;
+
+    SocketSendSlice slice;
+    slice.buffer =
+        &( inConnection->outputBuffer[ inConnection->numOutputBytesSent ] );
+    slice.numBytes = numLeft;
+
+    int numSent = inConnection->sock->sendv( &slice, 1, false );
+
+    if( numSent == -1 ) {
+        inConnection->closing = true;
+        return;
+        }
+
+    if( numSent > 0 ) {
+        inConnection->numOutputBytesSent += numSent;
+        }
+
+    if( inConnection->numOutputBytesSent == inConnection->numOutputBytes ) {
+        delete [] inConnection->outputBuffer;
+        inConnection->outputBuffer = NULL;
+        inConnection->numOutputBytes = 0;
+        inConnection->numOutputBytesSent = 0;
+        }
+    }
+
@@ -0,0 +1,226 @@
+#ifndef EVENT_WEB_SERVER_INCLUDED
+#define EVENT_WEB_SERVER_INCLUDED
+
+
+#include "PageGenerator.h"
+#include "ConnectionPermissionHandler.h"
+
+#include "minorGems/network/Socket.h"
+#include "minorGems/network/SocketServer.h"
+#include "minorGems/network/SocketPoll.h"
+
+#include "minorGems/system/StopSignalThread.h"
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/system/Semaphore.h"
+
+#include "minorGems/util/SimpleVector.h"
+
+
+
+// largest request header block we accept
+// (also enough room for several small pipelined requests)
+#define EVENT_WEB_SERVER_BUFFER_SIZE 8192
+
+
+
+typedef struct WebConnection {
+        Socket *sock;
+
+        // received bytes that haven't been handled as requests yet
+        char *inputBuffer;
+        int numInputBytes;
+
+        // response bytes that couldn't be sent without blocking,
+        // or NULL if none are waiting
+        // Sent once the socket is writable, before any more requests
+        // are served.
+        unsigned char *outputBuffer;
+        int numOutputBytes;
+        // bytes of outputBuffer already sent
+        int numOutputBytesSent;
+
+        // true if poll is watching this connection for writability
+        // (only touched by server's run thread)
+        char watchingWrite;
+
+        double lastActivityTime;
+
+        // true while a worker owns this connection
+        char busy;
+
+        // set by worker when connection should be closed
+        char closing;
+
+        // set by worker when connection should be closed once
+        // outputBuffer has been sent
+        char closeWhenSent;
+
+        // position in server's connection list
+        int listIndex;
+
+    } WebConnection;
+
+
+
+class EventWebServer;
+
+
+// pulls ready connections from an EventWebServer and serves
+// the requests waiting on them
+class EventWebServerWorker : public StopSignalThread {
+
+    public:
+
+        EventWebServerWorker( EventWebServer *inServer );
+
+        // stops and joins this worker
+        ~EventWebServerWorker();
+
+        // implements the Thread::run() interface
+        void run();
+
+    private:
+        EventWebServer *mServer;
+    };
+
+
+
+/**
+ * A web server that multiplexes all of its connections with a SocketPoll
+ * and serves requests from a fixed pool of worker threads.
+ *
+ * Unlike WebServer, which spawns a thread for each connection, this
+ * server supports HTTP/1.1 keep-alive and pipelined requests, and holds
+ * idle connections without tying up threads.
+ *
+ * Pages are generated into a buffer before being sent, so that
+ * responses can carry a Content-Length header.  Responses are sent
+ * without blocking, so a client that reads slowly doesn't tie up a
+ * worker:  whatever can't be sent right away waits on the connection
+ * until the poll reports it writable.
+ */
+class EventWebServer : public StopSignalThread {
+
+    public:
+
+
+
+        /**
+         * Constructs and starts this server.
+         *
+         * @param inPort the port to listen on.
+         * @param inGenerator the class to use for generating pages.
+         *   Must be safe to call from several threads at once.
+         *   Will be destroyed when this class is destroyed.
+         * @param inNumWorkers the number of threads generating pages.
+         *   Defaults to 4.
+         * @param inKeepAliveSeconds how long to hold an idle connection
+         *   open between requests.  Defaults to 15.
+         */
+        EventWebServer( int inPort, PageGenerator *inGenerator,
+                        int inNumWorkers = 4,
+                        int inKeepAliveSeconds = 15 );
+
+
+
+        /**
+         * Stops and destroys this server.
+         */
+        ~EventWebServer();
+
+
+
+        // implements the Thread::run() interface
+        void run();
+
+
+
+        // used by worker threads
+
+        // waits for next connection that needs handling
+        // returns NULL on timeout
+        WebConnection *getNextJob( int inTimeoutMS );
+
+        // serves all complete requests that have arrived on
+        // a connection, then hands it back to our run thread
+        void handleConnection( WebConnection *inConnection );
+
+
+
+    private:
+
+        int mPortNumber;
+        int mMaxQueuedConnections;
+        int mKeepAliveSeconds;
+
+        SocketServer *mServer;
+
+        PageGenerator *mPageGenerator;
+        ConnectionPermissionHandler *mConnectionPermissionHandler;
+
+        SimpleVector<EventWebServerWorker*> mWorkers;
+
+
+        // one-shot, so each ready connection is handed to exactly
+        // one worker until it is re-armed
+        // Only used by our run thread (workers only call wakeUp), so
+        // that nothing changes the poll while it is waiting.
+        SocketPoll mPoll;
+
+        // protects mConnections, mRearmConnections, mClosedConnections,
+        // and busy flags
+        MutexLock mPollLock;
+
+        SimpleVector<WebConnection*> mConnections;
+
+        // handled by workers, waiting for run thread to re-arm them
+        // in poll (watching for writability if they have output
+        // waiting)
+        SimpleVector<WebConnection*> mRearmConnections;
+
+        // closed by workers, waiting for run thread to remove them
+        // from poll and destroy them
+        SimpleVector<WebConnection*> mClosedConnections;
+
+
+        // connections waiting for a worker
+        MutexLock mJobLock;
+        Semaphore mJobSemaphore;
+        SimpleVector<WebConnection*> mJobs;
+        // jobs before this index have been taken already
+        int mNextJob;
+
+
+        void acceptConnections();
+
+        void addJob( WebConnection *inConnection );
+
+        // removes from poll and list, and destroys
+        // mPollLock must be locked by caller
+        void destroyConnection( WebConnection *inConnection );
+
+
+        // handles one request, given its \0-terminated header block
+        // returns true if connection should be kept alive
+        char handleRequest( WebConnection *inConnection, char *inRequest );
+
+        void sendBadRequest( WebConnection *inConnection );
+
+
+        // sends as much of a response as can go without blocking and
+        // saves the rest in the connection's outputBuffer
+        // Sets closing on a socket error.
+        void sendResponse( WebConnection *inConnection,
+                           SocketSendSlice *inSlices, int inNumSlices );
+
+        // sends as much of the connection's outputBuffer as can go
+        // without blocking
+        // Sets closing on a socket error.
+        void sendSavedOutput( WebConnection *inConnection );
+
+    };
+
+
+
+
+#endif
@@ -0,0 +1,283 @@
+// Compares request throughput and latency of the thread-per-connection
+// WebServer against the SocketPoll-based EventWebServer, using
+// client threads on the loopback interface.
+//
+// WebServer clients open a new connection for each request (it always
+// closes).  EventWebServer is measured both that way and with clients
+// that reuse one keep-alive connection.
+
+
+#include "WebServer.h"
+#include "EventWebServer.h"
+
+#include "minorGems/network/SocketClient.h"
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/Time.h"
+#include "minorGems/util/log/AppLog.h"
+#include "minorGems/util/stringUtils.h"
+#include "minorGems/util/SettingsManager.h"
+#include "minorGems/io/file/File.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+class BenchmarkPageGenerator : public PageGenerator {
+    public:
+
+        void generatePage( char *inGetRequestPath,
+                           OutputStream *inOutputStream ) {
+            inOutputStream->writeString(
+                "<HTML><BODY>Hello from the benchmark page generator."
+                "</BODY></HTML>" );
+            }
+
+        char *getMimeType( char *inGetRequestPath ) {
+            return stringDuplicate( "text/html" );
+            }
+    };
+
+
+
+// reads a response with a header block, returns true on success
+static char readResponse( Socket *inSock, char inHasLength ) {
+    char buffer[ 4096 ];
+    int numBytes = 0;
+
+    char *headerEnd = NULL;
+
+    while( headerEnd == NULL ) {
+        int numRead = inSock->receive( (unsigned char *)&( buffer[numBytes] ),
+                                       4095 - numBytes, 5000 );
+        if( numRead <= 0 ) {
+            // closed
+            return ( numBytes > 0 && !inHasLength );
+            }
+        numBytes += numRead;
+        buffer[ numBytes ] = '\0';
+
+        headerEnd = strstr( buffer, "\r\n\r\n" );
+        }
+
+    if( !inHasLength ) {
+        // read until close
+        while( inSock->receive( (unsigned char *)buffer, 4095, 5000 ) > 0 ) {
+            }
+        return true;
+        }
+
+    char *lengthString = stringLocateIgnoreCase( buffer, "Content-Length:" );
+    if( lengthString == NULL ) {
+        return false;
+        }
+
+    int contentLength = 0;
+    sscanf( lengthString, "%*s %d", &contentLength );
+
+    int bodyBytes = numBytes - ( ( headerEnd + 4 ) - buffer );
+
+    while( bodyBytes < contentLength ) {
+        int numRead = inSock->receive( (unsigned char *)buffer,
+                                       contentLength - bodyBytes, -1 );
+        if( numRead <= 0 ) {
+            return false;
+            }
+        bodyBytes += numRead;
+        }
+    return true;
+    }
+
+
+
+class BenchmarkClient : public Thread {
+    public:
+
+        BenchmarkClient( int inPort, int inNumRequests, char inKeepAlive )
+                : mPort( inPort ), mNumRequests( inNumRequests ),
+                  mKeepAlive( inKeepAlive ), mNumFailed( 0 ),
+                  mLatencies( new double[ inNumRequests ] ) {
+            }
+
+        ~BenchmarkClient() {
+            delete [] mLatencies;
+            }
+
+        void run() {
+            Socket *sock = NULL;
+
+            for( int i=0; i<mNumRequests; i++ ) {
+                double startTime = Time::getPreciseTime();
+
+                if( sock == NULL ) {
+                    HostAddress address( stringDuplicate( "127.0.0.1" ),
+                                         mPort );
+                    sock = SocketClient::connectToServer( &address );
+                    }
+
+                char success = false;
+
+                if( sock != NULL ) {
+                    const char *request = "GET /index.html HTTP/1.0\r\n\r\n";
+                    if( mKeepAlive ) {
+                        request = "GET /index.html HTTP/1.1\r\n\r\n";
+                        }
+
+                    int length = strlen( request );
+
+                    if( sock->send( (unsigned char *)request, length )
+                        == length ) {
+                        success = readResponse( sock, mKeepAlive );
+                        }
+                    }
+
+                if( !success || !mKeepAlive ) {
+                    if( sock != NULL ) {
+                        delete sock;
+                        sock = NULL;
+                        }
+                    }
+                if( !success ) {
+                    mNumFailed++;
+                    }
+
+                mLatencies[i] = Time::getPreciseTime() - startTime;
+                }
+
+            if( sock != NULL ) {
+                delete sock;
+                }
+            }
+
+        int mPort;
+        int mNumRequests;
+        char mKeepAlive;
+        int mNumFailed;
+        double *mLatencies;
+    };
+
+
+
+static int compareDoubles( const void *inA, const void *inB ) {
+    double a = *( (double *)inA );
+    double b = *( (double *)inB );
+
+    if( a < b ) {
+        return -1;
+        }
+    if( a > b ) {
+        return 1;
+        }
+    return 0;
+    }
+
+
+
+static void runClients( const char *inLabel, int inPort,
+                        int inNumClients, int inNumRequests,
+                        char inKeepAlive ) {
+
+    BenchmarkClient **clients = new BenchmarkClient*[ inNumClients ];
+
+    double startTime = Time::getPreciseTime();
+
+    for( int i=0; i<inNumClients; i++ ) {
+        clients[i] = new BenchmarkClient( inPort, inNumRequests,
+                                          inKeepAlive );
+        clients[i]->start();
+        }
+
+    int totalRequests = inNumClients * inNumRequests;
+    double *allLatencies = new double[ totalRequests ];
+    int numFailed = 0;
+
+    for( int i=0; i<inNumClients; i++ ) {
+        clients[i]->join();
+
+        memcpy( &( allLatencies[ i * inNumRequests ] ),
+                clients[i]->mLatencies, inNumRequests * sizeof( double ) );
+        numFailed += clients[i]->mNumFailed;
+
+        delete clients[i];
+        }
+
+    double totalTime = Time::getPreciseTime() - startTime;
+
+    qsort( allLatencies, totalRequests, sizeof( double ), compareDoubles );
+
+    printf( "%s:  %d clients, %d requests, %d failed, "
+            "%.0f requests/sec, p50 %.3f ms, p99 %.3f ms\n",
+            inLabel, inNumClients, totalRequests, numFailed,
+            totalRequests / totalTime,
+            1000 * allLatencies[ totalRequests / 2 ],
+            1000 * allLatencies[ ( totalRequests * 99 ) / 100 ] );
+
+    delete [] allLatencies;
+    delete [] clients;
+    }
+
+
+
+// usage:
+// webServerBenchmark [numClients] [requestsPerClient]
+
+int main( int inNumArgs, char **inArgs ) {
+
+    int numClients = 20;
+    int numRequests = 100;
+
+    if( inNumArgs > 1 ) {
+        numClients = atoi( inArgs[1] );
+        }
+    if( inNumArgs > 2 ) {
+        numRequests = atoi( inArgs[2] );
+        }
+
+    AppLog::setLoggingLevel( Log::ERROR_LEVEL );
+
+    // both servers refuse hosts that aren't listed in this setting
+    // keep it in a directory of our own, removed when we're done, so
+    // we don't touch the working directory's settings
+    File settingsDir( NULL, "webServerBenchmarkSettings" );
+
+    char madeSettingsDir = false;
+    if( ! settingsDir.exists() ) {
+        madeSettingsDir = settingsDir.makeDirectory();
+        }
+
+    SettingsManager::setDirectoryName( "webServerBenchmarkSettings" );
+    SettingsManager::setSetting( "allowedWebHosts", "127.0.0.*" );
+
+
+    WebServer *threadedServer =
+        new WebServer( 8091, new BenchmarkPageGenerator() );
+
+    runClients( "WebServer (threaded)", 8091, numClients, numRequests,
+                false );
+
+    delete threadedServer;
+
+
+    EventWebServer *eventServer =
+        new EventWebServer( 8092, new BenchmarkPageGenerator() );
+
+    runClients( "EventWebServer (connection per request)", 8092,
+                numClients, numRequests, false );
+
+    runClients( "EventWebServer (keep-alive)", 8092, numClients, numRequests,
+                true );
+
+    delete eventServer;
+
+
+    File *settingsFile = settingsDir.getChildFile( "allowedWebHosts.ini" );
+    settingsFile->remove();
+    delete settingsFile;
+
+    if( madeSettingsDir ) {
+        settingsDir.remove();
+        }
+
+    return 0;
+    }
@@ -278,6 +278,94 @@ int Socket::send( unsigned char *inBuffer, int inNumBytes,
 		
 		
 		
+// we only link against winsock 1.1, which has no WSASend, so
+// gather slices into one buffer and do a single send
+int Socket::sendv( SocketSendSlice *inSlices, int inNumSlices,
+                   char inAllowedToBlock,
+                   char inAllowDelay ) {
+
+    int totalBytes = 0;
+    
+    for( int i=0; i<inNumSlices; i++ ) {
+        totalBytes += inSlices[i].numBytes;
+        }
+    
+    unsigned char *buffer = new unsigned char[ totalBytes ];
+    
+    int pos = 0;
+    for( int i=0; i<inNumSlices; i++ ) {
+        memcpy( &( buffer[pos] ), inSlices[i].buffer, inSlices[i].numBytes );
+        pos += inSlices[i].numBytes;
+        }
+    
+    int result = send( buffer, totalBytes, inAllowedToBlock, inAllowDelay );
+    
+    delete [] buffer;
+    
+    return result;
+    }
+
+
+
+long Socket::sendFile( FILE *inFile, long inOffset, long inNumBytes,
+                       char inAllowedToBlock ) {
+    
+    // no zero-copy path, stage through a buffer
+    
+    // leave file position where we found it
+    long oldPosition = ftell( inFile );
+    
+    if( fseek( inFile, inOffset, SEEK_SET ) != 0 ) {
+        return -1;
+        }
+    
+    int bufferSize = 65536;
+    unsigned char *buffer = new unsigned char[ bufferSize ];
+    
+    long totalSent = 0;
+    int lastResult = 0;
+    
+    while( totalSent < inNumBytes ) {
+        long numToSend = inNumBytes - totalSent;
+        
+        if( numToSend > bufferSize ) {
+            numToSend = bufferSize;
+            }
+        
+        int numRead = fread( buffer, 1, numToSend, inFile );
+        
+        if( numRead <= 0 ) {
+            lastResult = -1;
+            break;
+            }
+        
+        lastResult = send( buffer, numRead, inAllowedToBlock );
+        
+        if( lastResult > 0 ) {
+            totalSent += lastResult;
+            }
+        
+        if( lastResult != numRead ) {
+            // error, would-block, or partial send
+            break;
+            }
+        }
+    
+    delete [] buffer;
+    
+    fseek( inFile, oldPosition, SEEK_SET );
+    
+    if( totalSent > 0 ) {
+        return totalSent;
+        }
+    if( lastResult < 0 ) {
+        return lastResult;
+        }
+    return totalSent;
+    }
+
+
+		
 int Socket::receive( unsigned char *inBuffer, int inNumBytes,
 	long inTimeout ) {
 	
@@ -0,0 +1,432 @@
+#include "soundMixer.h"
+
+#include <math.h>
+#include <stddef.h>
+
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || \
+    ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+    #define SOUND_MIXER_SSE2
+    #include <emmintrin.h>
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+    #define SOUND_MIXER_NEON
+    #include <arm_neon.h>
+#endif
+
+
+// Note that the vector paths multiply and add in separate steps, so
+// they match the scalar path only if the compiler doesn't fuse the
+// scalar path into FMA instructions (use -ffp-contract=off when
+// targeting FMA-capable CPUs and exact matching matters).
+
+
+
+#define ONE_STEP ( (int64_t)1 << SOUND_MIXER_FRACTION_BITS )
+
+#define FRACTION_MASK ( ONE_STEP - 1 )
+
+static const float fractionScale = 1.0f / ONE_STEP;
+
+
+
+SoundMixer initSoundMixer( int inMaxVoices ) {
+    SoundMixer m;
+
+    m.numVoices = 0;
+    m.maxVoices = inMaxVoices;
+
+    m.ids = new int[ inMaxVoices ];
+    m.samples = new int16_t*[ inMaxVoices ];
+    m.numSamples = new int[ inMaxVoices ];
+    m.positions = new int64_t[ inMaxVoices ];
+    m.steps = new int64_t[ inMaxVoices ];
+    m.volumesL = new float[ inMaxVoices ];
+    m.volumesR = new float[ inMaxVoices ];
+
+    return m;
+    }
+
+
+
+void freeSoundMixer( SoundMixer *inM ) {
+    delete [] inM->ids;
+    delete [] inM->samples;
+    delete [] inM->numSamples;
+    delete [] inM->positions;
+    delete [] inM->steps;
+    delete [] inM->volumesL;
+    delete [] inM->volumesR;
+
+    inM->numVoices = 0;
+    inM->maxVoices = 0;
+    }
+
+
+
+char addSoundMixerVoice( SoundMixer *inM, int inID,
+                         int16_t *inSamples, int inNumSamples,
+                         double inRate,
+                         float inVolumeL, float inVolumeR ) {
+
+    if( inM->numVoices >= inM->maxVoices ) {
+        return false;
+        }
+
+    int64_t step = (int64_t)llrint( inRate * ONE_STEP );
+
+    if( step < 1 ) {
+        step = 1;
+        }
+
+    int i = inM->numVoices;
+
+    inM->ids[i] = inID;
+    inM->samples[i] = inSamples;
+    inM->numSamples[i] = inNumSamples;
+    inM->positions[i] = 0;
+    inM->steps[i] = step;
+    inM->volumesL[i] = inVolumeL;
+    inM->volumesR[i] = inVolumeR;
+
+    inM->numVoices ++;
+
+    return true;
+    }
+
+
+
+void removeSoundMixerVoice( SoundMixer *inM, int inIndex ) {
+    int last = inM->numVoices - 1;
+
+    inM->ids[ inIndex ] = inM->ids[ last ];
+    inM->samples[ inIndex ] = inM->samples[ last ];
+    inM->numSamples[ inIndex ] = inM->numSamples[ last ];
+    inM->positions[ inIndex ] = inM->positions[ last ];
+    inM->steps[ inIndex ] = inM->steps[ last ];
+    inM->volumesL[ inIndex ] = inM->volumesL[ last ];
+    inM->volumesR[ inIndex ] = inM->volumesR[ last ];
+
+    inM->numVoices --;
+    }
+
+
+
+// number of samples a voice can read from, given its step
+// interpolated voices need a following sample for each one they read
+static inline int64_t getPlayableEnd( SoundMixer *inM, int inIndex ) {
+    int64_t numSamples = inM->numSamples[ inIndex ];
+
+    if( inM->steps[ inIndex ] != ONE_STEP ) {
+        numSamples -= 1;
+        }
+    return numSamples << SOUND_MIXER_FRACTION_BITS;
+    }
+
+
+
+char isSoundMixerVoiceDone( SoundMixer *inM, int inIndex ) {
+    return inM->positions[ inIndex ] >= getPlayableEnd( inM, inIndex );
+    }
+
+
+
+void removeDoneSoundMixerVoices( SoundMixer *inM ) {
+    for( int i=inM->numVoices - 1; i>=0; i-- ) {
+        if( isSoundMixerVoiceDone( inM, i ) ) {
+            removeSoundMixerVoice( inM, i );
+            }
+        }
+    }
+
+
+
+// how many output samples a voice fills before running out
+static inline int getMixCount( SoundMixer *inM, int inIndex,
+                               int inNumSamples ) {
+    int64_t remaining =
+        getPlayableEnd( inM, inIndex ) - inM->positions[ inIndex ];
+
+    if( remaining <= 0 ) {
+        return 0;
+        }
+
+    int64_t step = inM->steps[ inIndex ];
+
+    int64_t count = ( remaining + step - 1 ) / step;
+
+    if( count > inNumSamples ) {
+        return inNumSamples;
+        }
+    return (int)count;
+    }
+
+
+
+static inline void mixUnitScalar( int16_t *inSamples,
+                                  float inVolumeL, float inVolumeR,
+                                  float *outL, float *outR,
+                                  int inStart, int inEnd ) {
+    for( int i=inStart; i<inEnd; i++ ) {
+        float s = inSamples[i];
+
+        outL[i] += inVolumeL * s;
+        outR[i] += inVolumeR * s;
+        }
+    }
+
+
+
+static inline void mixResampledScalar( int16_t *inSamples,
+                                       int64_t inPosition, int64_t inStep,
+                                       float inVolumeL, float inVolumeR,
+                                       float *outL, float *outR,
+                                       int inStart, int inEnd ) {
+    for( int i=inStart; i<inEnd; i++ ) {
+        int64_t p = inPosition + i * inStep;
+
+        int index = (int)( p >> SOUND_MIXER_FRACTION_BITS );
+        float bWeight = (float)( p & FRACTION_MASK ) * fractionScale;
+
+        float a = inSamples[ index ];
+        float b = inSamples[ index + 1 ];
+
+        float s = a + ( b - a ) * bWeight;
+
+        outL[i] += inVolumeL * s;
+        outR[i] += inVolumeR * s;
+        }
+    }
+
+
+
+void mixSoundMixerScalar( SoundMixer *inM,
+                          float *outL, float *outR, int inNumSamples ) {
+
+    for( int v=0; v<inM->numVoices; v++ ) {
+        int count = getMixCount( inM, v, inNumSamples );
+
+        int64_t position = inM->positions[v];
+        int64_t step = inM->steps[v];
+
+        if( step == ONE_STEP ) {
+            mixUnitScalar(
+                &( inM->samples[v][ position >> SOUND_MIXER_FRACTION_BITS ] ),
+                inM->volumesL[v], inM->volumesR[v],
+                outL, outR, 0, count );
+            }
+        else {
+            mixResampledScalar( inM->samples[v], position, step,
+                                inM->volumesL[v], inM->volumesR[v],
+                                outL, outR, 0, count );
+            }
+
+        inM->positions[v] = position + count * step;
+        }
+    }
+
+
+
+#if defined( SOUND_MIXER_SSE2 )
+
+
+static void mixVoiceVector( int16_t *inSamples,
+                            int64_t inPosition, int64_t inStep,
+                            float inVolumeL, float inVolumeR,
+                            float *outL, float *outR, int inCount ) {
+
+    __m128 volL = _mm_set1_ps( inVolumeL );
+    __m128 volR = _mm_set1_ps( inVolumeR );
+
+    int i = 0;
+
+    if( inStep == ONE_STEP ) {
+        int16_t *samples =
+            &( inSamples[ inPosition >> SOUND_MIXER_FRACTION_BITS ] );
+
+        for( ; i + 4 <= inCount; i += 4 ) {
+            __m128i raw = _mm_loadl_epi64( (__m128i *)&( samples[i] ) );
+
+            // sign-extend to 32 bits
+            __m128i wide = _mm_srai_epi32( _mm_unpacklo_epi16( raw, raw ),
+                                           16 );
+            __m128 s = _mm_cvtepi32_ps( wide );
+
+            _mm_storeu_ps( &( outL[i] ),
+                           _mm_add_ps( _mm_loadu_ps( &( outL[i] ) ),
+                                       _mm_mul_ps( volL, s ) ) );
+            _mm_storeu_ps( &( outR[i] ),
+                           _mm_add_ps( _mm_loadu_ps( &( outR[i] ) ),
+                                       _mm_mul_ps( volR, s ) ) );
+            }
+
+        mixUnitScalar( samples, inVolumeL, inVolumeR, outL, outR,
+                       i, inCount );
+        return;
+        }
+
+
+    __m128 scale = _mm_set1_ps( fractionScale );
+
+    // fractions only depend on low bits of position, so they can
+    // advance in 32-bit lanes (wrapping harmlessly)
+    unsigned int stepLow = (unsigned int)inStep;
+    unsigned int positionLow = (unsigned int)inPosition;
+
+    __m128i lanePositions = 
+        _mm_setr_epi32( (int)positionLow,
+                        (int)( positionLow + stepLow ),
+                        (int)( positionLow + 2 * stepLow ),
+                        (int)( positionLow + 3 * stepLow ) );
+    __m128i laneAdvance = _mm_set1_epi32( (int)( 4 * stepLow ) );
+    __m128i fractionMask = _mm_set1_epi32( (int)FRACTION_MASK );
+
+    int64_t p = inPosition;
+
+    for( ; i + 4 <= inCount; i += 4 ) {
+        // no gather instruction in SSE2, so fetch sample pairs one by one
+        int16_t *s0 = &( inSamples[ p >> SOUND_MIXER_FRACTION_BITS ] );
+        p += inStep;
+        int16_t *s1 = &( inSamples[ p >> SOUND_MIXER_FRACTION_BITS ] );
+        p += inStep;
+        int16_t *s2 = &( inSamples[ p >> SOUND_MIXER_FRACTION_BITS ] );
+        p += inStep;
+        int16_t *s3 = &( inSamples[ p >> SOUND_MIXER_FRACTION_BITS ] );
+        p += inStep;
+
+        __m128 va = _mm_cvtepi32_ps(
+            _mm_setr_epi32( s0[0], s1[0], s2[0], s3[0] ) );
+        __m128 vb = _mm_cvtepi32_ps(
+            _mm_setr_epi32( s0[1], s1[1], s2[1], s3[1] ) );
+
+        __m128 vw = _mm_mul_ps(
+            _mm_cvtepi32_ps( _mm_and_si128( lanePositions, fractionMask ) ),
+            scale );
+
+        lanePositions = _mm_add_epi32( lanePositions, laneAdvance );
+
+        __m128 s = _mm_add_ps( va, _mm_mul_ps( _mm_sub_ps( vb, va ), vw ) );
+
+        _mm_storeu_ps( &( outL[i] ),
+                       _mm_add_ps( _mm_loadu_ps( &( outL[i] ) ),
+                                   _mm_mul_ps( volL, s ) ) );
+        _mm_storeu_ps( &( outR[i] ),
+                       _mm_add_ps( _mm_loadu_ps( &( outR[i] ) ),
+                                   _mm_mul_ps( volR, s ) ) );
+        }
+
+    mixResampledScalar( inSamples, inPosition, inStep,
+                        inVolumeL, inVolumeR, outL, outR, i, inCount );
+    }
+
+
+#elif defined( SOUND_MIXER_NEON )
+
+
+// sample pairs and unscaled weights for four interpolated samples
+// starting at output inI
+static inline void gatherResampled( int16_t *inSamples,
+                                    int64_t inPosition, int64_t inStep,
+                                    int inI,
+                                    float *outA, float *outB,
+                                    float *outWeights ) {
+    int64_t p = inPosition + inI * inStep;
+
+    for( int k=0; k<4; k++ ) {
+        int16_t *pair = &( inSamples[ p >> SOUND_MIXER_FRACTION_BITS ] );
+
+        outA[k] = pair[0];
+        outB[k] = pair[1];
+        outWeights[k] = (float)(int)( p & FRACTION_MASK );
+
+        p += inStep;
+        }
+    }
+
+
+static void mixVoiceVector( int16_t *inSamples,
+                            int64_t inPosition, int64_t inStep,
+                            float inVolumeL, float inVolumeR,
+                            float *outL, float *outR, int inCount ) {
+
+    float32x4_t volL = vdupq_n_f32( inVolumeL );
+    float32x4_t volR = vdupq_n_f32( inVolumeR );
+
+    int i = 0;
+
+    if( inStep == ONE_STEP ) {
+        int16_t *samples =
+            &( inSamples[ inPosition >> SOUND_MIXER_FRACTION_BITS ] );
+
+        for( ; i + 4 <= inCount; i += 4 ) {
+            float32x4_t s =
+                vcvtq_f32_s32( vmovl_s16( vld1_s16( &( samples[i] ) ) ) );
+
+            // separate multiply and add (not fused) to match scalar path
+            vst1q_f32( &( outL[i] ),
+                       vaddq_f32( vld1q_f32( &( outL[i] ) ),
+                                  vmulq_f32( volL, s ) ) );
+            vst1q_f32( &( outR[i] ),
+                       vaddq_f32( vld1q_f32( &( outR[i] ) ),
+                                  vmulq_f32( volR, s ) ) );
+            }
+
+        mixUnitScalar( samples, inVolumeL, inVolumeR, outL, outR,
+                       i, inCount );
+        return;
+        }
+
+
+    float32x4_t scale = vdupq_n_f32( fractionScale );
+
+    float a[4], b[4], weights[4];
+
+    for( ; i + 4 <= inCount; i += 4 ) {
+        gatherResampled( inSamples, inPosition, inStep, i, a, b, weights );
+
+        float32x4_t va = vld1q_f32( a );
+        float32x4_t vb = vld1q_f32( b );
+        float32x4_t vw = vmulq_f32( vld1q_f32( weights ), scale );
+
+        float32x4_t s = vaddq_f32( va, vmulq_f32( vsubq_f32( vb, va ), vw ) );
+
+        vst1q_f32( &( outL[i] ),
+                   vaddq_f32( vld1q_f32( &( outL[i] ) ),
+                              vmulq_f32( volL, s ) ) );
+        vst1q_f32( &( outR[i] ),
+                   vaddq_f32( vld1q_f32( &( outR[i] ) ),
+                              vmulq_f32( volR, s ) ) );
+        }
+
+    mixResampledScalar( inSamples, inPosition, inStep,
+                        inVolumeL, inVolumeR, outL, outR, i, inCount );
+    }
+
+
+#endif
+
+
+
+void mixSoundMixer( SoundMixer *inM,
+                    float *outL, float *outR, int inNumSamples ) {
+
+#if defined( SOUND_MIXER_SSE2 ) || defined( SOUND_MIXER_NEON )
+
+    for( int v=0; v<inM->numVoices; v++ ) {
+        int count = getMixCount( inM, v, inNumSamples );
+
+        int64_t position = inM->positions[v];
+        int64_t step = inM->steps[v];
+
+        mixVoiceVector( inM->samples[v], position, step,
+                        inM->volumesL[v], inM->volumesR[v],
+                        outL, outR, count );
+
+        inM->positions[v] = position + count * step;
+        }
+
+#else
+
+    mixSoundMixerScalar( inM, outL, outR, inNumSamples );
+
+#endif
+    }
@@ -0,0 +1,90 @@
+#ifndef SOUND_MIXER_INCLUDED
+#define SOUND_MIXER_INCLUDED
+
+
+#include <stdint.h>
+
+
+
+// sample positions are fixed-point, with this many fractional bits
+#define SOUND_MIXER_FRACTION_BITS 16
+
+
+
+// a bank of playing voices, each a 16-bit mono sample buffer mixed into
+// a stereo output at its own rate and left/right volume
+//
+// state is kept as parallel arrays (one entry per voice), so the mixing
+// loops stream through it without chasing per-voice records
+typedef struct SoundMixer {
+        int numVoices;
+        int maxVoices;
+
+        // caller-supplied ID for each voice, for finding it again
+        int *ids;
+
+        // not copied, must stay valid while voice plays
+        int16_t **samples;
+        int *numSamples;
+
+        // position of next sample to play, fixed-point
+        int64_t *positions;
+
+        // position increment per output sample, fixed-point
+        // (1 << SOUND_MIXER_FRACTION_BITS for unit rate)
+        int64_t *steps;
+
+        float *volumesL;
+        float *volumesR;
+
+    } SoundMixer;
+
+
+
+// must be called once to init
+// voice arrays are allocated once here, so adding voices never
+// allocates (safe from audio thread)
+SoundMixer initSoundMixer( int inMaxVoices );
+
+
+void freeSoundMixer( SoundMixer *inM );
+
+
+
+// adds a voice that starts playing from its first sample
+// returns false if mixer is full
+char addSoundMixerVoice( SoundMixer *inM, int inID,
+                         int16_t *inSamples, int inNumSamples,
+                         double inRate,
+                         float inVolumeL, float inVolumeR );
+
+
+// removes voice at index, moving last voice into its place
+void removeSoundMixerVoice( SoundMixer *inM, int inIndex );
+
+
+// true if voice at index has played all of its samples
+char isSoundMixerVoiceDone( SoundMixer *inM, int inIndex );
+
+
+// removes all voices that are done
+void removeDoneSoundMixerVoices( SoundMixer *inM );
+
+
+
+// mixes all voices, advancing their positions
+// mixed samples are added to existing values in outL and outR
+//
+// uses SSE2 or NEON when compiled for them, with results identical
+// to mixSoundMixerScalar
+void mixSoundMixer( SoundMixer *inM,
+                    float *outL, float *outR, int inNumSamples );
+
+
+// plain C reference version of mixSoundMixer
+void mixSoundMixerScalar( SoundMixer *inM,
+                          float *outL, float *outR, int inNumSamples );
+
+
+
+#endif
@@ -0,0 +1,218 @@
+// Mixes a bank of voices offline with the vector mixSoundMixer and the
+// scalar reference, checks that their output matches exactly, and
+// reports time per buffer for each, along with the old per-sample
+// double mixing loop that mixSoundMixer replaced in gameSDL.
+
+
+#include "soundMixer.h"
+
+#include "minorGems/util/random/CustomRandomSource.h"
+#include "minorGems/system/Time.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+
+
+typedef struct OldVoice {
+        int16_t *samples;
+        int numSamples;
+        int samplesPlayed;
+        double samplesPlayedF;
+        double rate;
+        double volumeL;
+        double volumeR;
+    } OldVoice;
+
+
+
+// the loop gameSDL's audioCallback used before
+static void oldMix( OldVoice *inVoices, int inNumVoices,
+                    double *outL, double *outR, int numSamples ) {
+
+    for( int i=0; i<inNumVoices; i++ ) {
+        OldVoice *s = &( inVoices[i] );
+
+        int filled = 0;
+
+        if( s->rate == 1 ) {
+            while( filled < numSamples &&
+                   s->samplesPlayed < s->numSamples ) {
+                int16_t sample = s->samples[ s->samplesPlayed ];
+
+                outL[ filled ] += s->volumeL * sample;
+                outR[ filled ] += s->volumeR * sample;
+
+                filled ++;
+                s->samplesPlayed ++;
+                }
+            }
+        else {
+            while( filled < numSamples &&
+                   s->samplesPlayedF < s->numSamples - 1 ) {
+
+                int aIndex = (int)floor( s->samplesPlayedF );
+                int bIndex = (int)ceil( s->samplesPlayedF );
+
+                double bWeight = s->samplesPlayedF - aIndex;
+                double aWeight = 1 - bWeight;
+
+                double sampleBlend = s->samples[ aIndex ] * aWeight +
+                    s->samples[ bIndex ] * bWeight;
+
+                outL[ filled ] += s->volumeL * sampleBlend;
+                outR[ filled ] += s->volumeR * sampleBlend;
+
+                filled ++;
+                s->samplesPlayedF += s->rate;
+                }
+            }
+        }
+    }
+
+
+
+// usage:
+// soundMixerBenchmark [numVoices] [numBuffers]
+
+int main( int inNumArgs, char **inArgs ) {
+
+    int numVoices = 64;
+    int numBuffers = 2000;
+    int bufferLength = 512;
+
+    if( inNumArgs > 1 ) {
+        numVoices = atoi( inArgs[1] );
+        }
+    if( inNumArgs > 2 ) {
+        numBuffers = atoi( inArgs[2] );
+        }
+
+    CustomRandomSource randSource( 2314 );
+
+    // long enough that no voice finishes during the run
+    int numSamples = bufferLength * numBuffers * 2 + 1;
+
+    SoundMixer vectorMixer = initSoundMixer( numVoices );
+    SoundMixer scalarMixer = initSoundMixer( numVoices );
+
+    OldVoice *oldVoices = new OldVoice[ numVoices ];
+
+    int16_t **voiceSamples = new int16_t*[ numVoices ];
+
+    for( int v=0; v<numVoices; v++ ) {
+        voiceSamples[v] = new int16_t[ numSamples ];
+
+        for( int i=0; i<numSamples; i++ ) {
+            voiceSamples[v][i] =
+                (int16_t)randSource.getRandomBoundedInt( -32768, 32767 );
+            }
+
+        // half at unit rate, half resampled
+        double rate = 1.0;
+        if( v % 2 == 1 ) {
+            rate = randSource.getRandomBoundedDouble( 0.8, 1.2 );
+            }
+
+        float volumeL = (float)randSource.getRandomBoundedDouble( 0, 1 );
+        float volumeR = (float)randSource.getRandomBoundedDouble( 0, 1 );
+
+        addSoundMixerVoice( &vectorMixer, v, voiceSamples[v], numSamples,
+                            rate, volumeL, volumeR );
+        addSoundMixerVoice( &scalarMixer, v, voiceSamples[v], numSamples,
+                            rate, volumeL, volumeR );
+
+        OldVoice *o = &( oldVoices[v] );
+        o->samples = voiceSamples[v];
+        o->numSamples = numSamples;
+        o->samplesPlayed = 0;
+        o->samplesPlayedF = 0;
+        o->rate = rate;
+        o->volumeL = volumeL;
+        o->volumeR = volumeR;
+        }
+
+
+    float *vectorL = new float[ bufferLength ];
+    float *vectorR = new float[ bufferLength ];
+    float *scalarL = new float[ bufferLength ];
+    float *scalarR = new float[ bufferLength ];
+
+    double *oldL = new double[ bufferLength ];
+    double *oldR = new double[ bufferLength ];
+
+    double vectorTime = 0;
+    double scalarTime = 0;
+    double oldTime = 0;
+
+    int numMismatched = 0;
+
+    for( int b=0; b<numBuffers; b++ ) {
+        memset( vectorL, 0, bufferLength * sizeof( float ) );
+        memset( vectorR, 0, bufferLength * sizeof( float ) );
+        memset( scalarL, 0, bufferLength * sizeof( float ) );
+        memset( scalarR, 0, bufferLength * sizeof( float ) );
+        memset( oldL, 0, bufferLength * sizeof( double ) );
+        memset( oldR, 0, bufferLength * sizeof( double ) );
+
+        double startTime = Time::getCurrentTime();
+        mixSoundMixer( &vectorMixer, vectorL, vectorR, bufferLength );
+        vectorTime += Time::getCurrentTime() - startTime;
+
+        startTime = Time::getCurrentTime();
+        mixSoundMixerScalar( &scalarMixer, scalarL, scalarR, bufferLength );
+        scalarTime += Time::getCurrentTime() - startTime;
+
+        startTime = Time::getCurrentTime();
+        oldMix( oldVoices, numVoices, oldL, oldR, bufferLength );
+        oldTime += Time::getCurrentTime() - startTime;
+
+        if( memcmp( vectorL, scalarL, bufferLength * sizeof( float ) ) != 0 ||
+            memcmp( vectorR, scalarR, bufferLength * sizeof( float ) ) != 0 ) {
+            numMismatched ++;
+            }
+        }
+
+
+    printf( "%d voices, %d buffers of %d samples\n",
+            numVoices, numBuffers, bufferLength );
+
+    printf( "old double loop:  %.3f us per buffer\n",
+            1000000 * oldTime / numBuffers );
+    printf( "scalar mixer:     %.3f us per buffer\n",
+            1000000 * scalarTime / numBuffers );
+    printf( "vector mixer:     %.3f us per buffer\n",
+            1000000 * vectorTime / numBuffers );
+
+    if( numMismatched == 0 ) {
+        printf( "vector output matches scalar reference exactly\n" );
+        }
+    else {
+        printf( "FAILED:  vector output differs from scalar reference "
+                "in %d buffers\n", numMismatched );
+        }
+
+
+    for( int v=0; v<numVoices; v++ ) {
+        delete [] voiceSamples[v];
+        }
+    delete [] voiceSamples;
+    delete [] oldVoices;
+
+    delete [] vectorL;
+    delete [] vectorR;
+    delete [] scalarL;
+    delete [] scalarR;
+    delete [] oldL;
+    delete [] oldR;
+
+    freeSoundMixer( &vectorMixer );
+    freeSoundMixer( &scalarMixer );
+
+    if( numMismatched == 0 ) {
+        return 0;
+        }
+    return 1;
+    }
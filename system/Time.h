@@ -125,6 +125,21 @@ class Time {
          */
         static double getCurrentTime();
 
+
+
+        /**
+         * Gets a time in fractional seconds for measuring short intervals,
+         * with the best resolution the platform offers (usually better
+         * than a microsecond).
+         *
+         * Counts from an arbitrary starting point and is not affected
+         * by changes to the system clock, so it can only be compared
+         * with other values returned by this function.
+         *
+         * @return the current time in seconds.
+         */
+        static double getPreciseTime();
+
         
 
 		/**
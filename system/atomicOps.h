@@ -0,0 +1,97 @@
+#include "minorGems/common.h"
+
+
+
+#ifndef ATOMIC_OPS_INCLUDED
+#define ATOMIC_OPS_INCLUDED
+
+
+
+/**
+ * Atomic operations on ints, longs, and pointers shared between threads,
+ * for lock-free code.
+ *
+ * Built on gcc's atomic builtins, which clang and MinGW also support.
+ */
+
+
+
+// loads a value written by another thread with atomicStore, seeing
+// everything that thread wrote before storing it
+template <class Type>
+inline Type atomicLoad( volatile Type *inSource ) {
+#ifdef __ATOMIC_ACQUIRE
+    return __atomic_load_n( inSource, __ATOMIC_ACQUIRE );
+#else
+    Type value = *inSource;
+    __sync_synchronize();
+    return value;
+#endif
+    }
+
+
+
+// stores a value, making everything written before it visible to
+// a thread that sees the value through atomicLoad
+template <class Type>
+inline void atomicStore( volatile Type *inTarget, Type inValue ) {
+#ifdef __ATOMIC_RELEASE
+    __atomic_store_n( inTarget, inValue, __ATOMIC_RELEASE );
+#else
+    __sync_synchronize();
+    *inTarget = inValue;
+#endif
+    }
+
+
+
+// returns the new value
+template <class Type>
+inline Type atomicAdd( volatile Type *inTarget, Type inDelta ) {
+    return __sync_add_and_fetch( inTarget, inDelta );
+    }
+
+
+
+// sets inTarget to inNewValue if it still holds inOldValue
+// returns true if it was set
+template <class Type>
+inline char atomicCompareAndSwap( volatile Type *inTarget,
+                                  Type inOldValue, Type inNewValue ) {
+    return __sync_bool_compare_and_swap( inTarget, inOldValue, inNewValue );
+    }
+
+
+
+// full barrier
+inline void atomicMemoryBarrier() {
+    __sync_synchronize();
+    }
+
+
+
+// keeps loads before the fence from happening after loads and stores
+// after it
+inline void atomicLoadFence() {
+#ifdef __ATOMIC_ACQUIRE
+    __atomic_thread_fence( __ATOMIC_ACQUIRE );
+#else
+    __sync_synchronize();
+#endif
+    }
+
+
+
+// keeps loads and stores before the fence from happening after stores
+// after it
+inline void atomicStoreFence() {
+#ifdef __ATOMIC_RELEASE
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+#else
+    __sync_synchronize();
+#endif
+    }
+
+
+
+#endif
@@ -44,3 +44,19 @@ void Time::getCurrentTime( timeSec_t *outSeconds,
 	}
 
 
+
+double Time::getPreciseTime() {
+#ifdef CLOCK_MONOTONIC
+    struct timespec currentTime;
+    
+    clock_gettime( CLOCK_MONOTONIC, &currentTime );
+
+    return currentTime.tv_sec + currentTime.tv_nsec / 1000000000.0;
+#else
+    struct timeval currentTime;
+
+    gettimeofday( &currentTime, NULL );
+
+    return currentTime.tv_sec + currentTime.tv_usec / 1000000.0;
+#endif
+    }
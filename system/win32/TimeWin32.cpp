@@ -81,3 +81,20 @@ void Time::getCurrentTime( timeSec_t *outSeconds,
 	}
 
 
+
+double Time::getPreciseTime() {
+    static double secondsPerCount = -1;
+
+    LARGE_INTEGER count;
+
+    if( secondsPerCount < 0 ) {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency( &frequency );
+
+        secondsPerCount = 1.0 / (double)( frequency.QuadPart );
+        }
+
+    QueryPerformanceCounter( &count );
+
+    return (double)( count.QuadPart ) * secondsPerCount;
+    }
@@ -0,0 +1,155 @@
+#ifndef HASH_SLOT_TABLE_INCLUDED
+#define HASH_SLOT_TABLE_INCLUDED
+
+
+
+// FNV-1a, for hashing keys for a HashSlotTable
+
+#define FNV_HASH_START 2166136261U
+
+
+// adds a \0-terminated string to a hash
+// start with inHash = FNV_HASH_START
+inline unsigned int fnvHashString( unsigned int inHash,
+                                   const char *inString ) {
+    for( int i=0; inString[i] != '\0'; i++ ) {
+        inHash ^= (unsigned char)( inString[i] );
+        inHash *= 16777619U;
+        }
+    return inHash;
+    }
+
+
+// adds the 4 low bytes of an int to a hash
+inline unsigned int fnvHashInt( unsigned int inHash, int inValue ) {
+    for( int i=0; i<4; i++ ) {
+        inHash ^= (unsigned char)( inValue >> ( i * 8 ) );
+        inHash *= 16777619U;
+        }
+    return inHash;
+    }
+
+
+
+typedef struct HashSlot {
+        // checked before comparing keys, so most probes never
+        // touch the items
+        unsigned int mHash;
+        // index of caller's item, or -1 if empty
+        int mIndex;
+    } HashSlot;
+
+
+
+// Open-addressed hash table of indices into an array of items that the
+// caller keeps, for finding items by key in constant time.
+
+// The table never holds keys, only each item's hash and index, so the
+// caller supplies a matcher when looking up:  any type with
+//   char operator()( int inIndex )
+// that returns true if the item at inIndex has the key being looked up.
+
+// Slots are probed linearly, and removal moves later slots in a probe
+// run back instead of leaving tombstones, so lookups never slow down
+// as items come and go.
+class HashSlotTable {
+    public:
+
+        // sized so that holding inMaxItems leaves it at most half full
+        HashSlotTable( int inMaxItems ) {
+            unsigned int numSlots = 2;
+            while( numSlots < (unsigned int)inMaxItems * 2 ) {
+                numSlots *= 2;
+                }
+            mSlotMask = numSlots - 1;
+
+            mSlots = new HashSlot[ numSlots ];
+            for( unsigned int i=0; i<numSlots; i++ ) {
+                mSlots[i].mIndex = -1;
+                }
+            }
+
+
+        ~HashSlotTable() {
+            delete [] mSlots;
+            }
+
+
+        // returns the slot holding the item that inMatcher matches,
+        // or the empty slot where that item would go
+        //
+        // To add an item, set the mHash and mIndex of the returned
+        // empty slot.  Adding or removing any other item may move
+        // the empty slot, so look it up again after doing so.
+        template <class Matcher>
+        HashSlot *findSlot( unsigned int inHash, Matcher &inMatcher );
+
+
+        // empties a slot returned by findSlot
+        void removeSlot( HashSlot *inSlot );
+
+
+    protected:
+        HashSlot *mSlots;
+        unsigned int mSlotMask;
+    };
+
+
+
+template <class Matcher>
+inline HashSlot *HashSlotTable::findSlot( unsigned int inHash,
+                                          Matcher &inMatcher ) {
+    unsigned int i = inHash & mSlotMask;
+
+    while( true ) {
+        HashSlot *slot = &( mSlots[i] );
+
+        if( slot->mIndex == -1 ) {
+            return slot;
+            }
+        if( slot->mHash == inHash && inMatcher( slot->mIndex ) ) {
+            return slot;
+            }
+        i = ( i + 1 ) & mSlotMask;
+        }
+    }
+
+
+
+inline void HashSlotTable::removeSlot( HashSlot *inSlot ) {
+    unsigned int hole = inSlot - mSlots;
+    unsigned int i = hole;
+
+    while( true ) {
+        i = ( i + 1 ) & mSlotMask;
+
+        HashSlot *slot = &( mSlots[i] );
+
+        if( slot->mIndex == -1 ) {
+            break;
+            }
+
+        unsigned int home = slot->mHash & mSlotMask;
+
+        // can move back into the hole if its home slot is not
+        // between the hole and where it is now
+        char canMove;
+        if( hole <= i ) {
+            canMove = ( home <= hole || home > i );
+            }
+        else {
+            canMove = ( home <= hole && home > i );
+            }
+
+        if( canMove ) {
+            mSlots[ hole ] = *slot;
+            hole = i;
+            }
+        }
+
+    mSlots[ hole ].mIndex = -1;
+    }
+
+
+
+#endif
@@ -0,0 +1,33 @@
+#include "SettingsFlushThread.h"
+
+#include "minorGems/util/SettingsManager.h"
+
+
+
+SettingsFlushThread::SettingsFlushThread( unsigned long inIntervalMS )
+        : mIntervalMS( inIntervalMS ) {
+
+    SettingsManager::setWriteBehind( true );
+    
+    start();
+    }
+
+
+
+SettingsFlushThread::~SettingsFlushThread() {
+    stop();
+    join();
+
+    SettingsManager::setWriteBehind( false );
+    }
+
+
+
+void SettingsFlushThread::run() {
+    while( ! isStopped() ) {
+        // wakes up early when stopped
+        sleep( mIntervalMS );
+
+        SettingsManager::flushSettings();
+        }
+    }
@@ -0,0 +1,43 @@
+#include "minorGems/common.h"
+
+
+#ifndef SETTINGS_FLUSH_THREAD_INCLUDED
+#define SETTINGS_FLUSH_THREAD_INCLUDED
+
+
+#include "minorGems/system/StopSignalThread.h"
+
+
+
+/**
+ * Turns on SettingsManager write-behind and writes changed settings to
+ * disk in the background, so setSetting calls don't wait on the disk.
+ *
+ * Should be destroyed before the program exits, while SettingsManager
+ * is still usable.
+ */
+class SettingsFlushThread : public StopSignalThread {
+
+    public:
+
+        /**
+         * Constructs and starts a flush thread.
+         *
+         * @param inIntervalMS how often to flush.  Defaults to 1000.
+         */
+        SettingsFlushThread( unsigned long inIntervalMS = 1000 );
+
+        // stops and joins this thread, then turns write-behind off,
+        // which writes anything still pending
+        ~SettingsFlushThread();
+
+        // implements the Thread::run() interface
+        void run();
+
+    private:
+        unsigned long mIntervalMS;
+    };
+
+
+
+#endif
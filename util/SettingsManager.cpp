@@ -58,6 +58,9 @@
 
 #include "minorGems/crypto/hashes/sha1.h"
 
+#include <sys/stat.h>
+#include <time.h>
+
 
 
 // will be destroyed automatically at program termination
@@ -65,9 +68,17 @@ SettingsManagerStaticMembers SettingsManager::mStaticMembers;
 
 char SettingsManager::mHashingOn = false;
 
+char SettingsManager::mCachingOn = true;
+char SettingsManager::mWriteBehind = false;
+
+double SettingsManager::mFileCheckInterval = 1.0;
+
 
 
 void SettingsManager::setDirectoryName( const char *inName ) {
+    // cached file names are in old directory
+    clearCache();
+    
     delete [] mStaticMembers.mDirectoryName;
     mStaticMembers.mDirectoryName = stringDuplicate( inName );
     }
@@ -81,6 +92,9 @@ char *SettingsManager::getDirectoryName() {
 
 
 void SettingsManager::setHashSalt( const char *inSalt ) {
+    // cached settings were checked against old salt
+    clearCache();
+    
     delete [] mStaticMembers.mHashSalt;
     mStaticMembers.mHashSalt = stringDuplicate( inSalt );
     }
@@ -94,11 +108,310 @@ char *SettingsManager::getHashSalt() {
 
 
 void SettingsManager::setHashingOn( char inOn ) {
+    clearCache();
+    
     mHashingOn = inOn;
     }
 
 
 
+void SettingsManager::setCachingOn( char inOn ) {
+    clearCache();
+
+    mCachingOn = inOn;
+    }
+
+
+
+void SettingsManager::setFileCheckInterval( double inSeconds ) {
+    mFileCheckInterval = inSeconds;
+    }
+
+
+
+void SettingsManager::setWriteBehind( char inOn ) {
+    mWriteBehind = inOn;
+
+    if( ! inOn ) {
+        flushSettings();
+        }
+    }
+
+
+
+unsigned long SettingsManager::getCacheHitCount() {
+    mStaticMembers.mLock.lock();
+    unsigned long count = mStaticMembers.mCacheHitCount;
+    mStaticMembers.mLock.unlock();
+    return count;
+    }
+
+
+
+unsigned long SettingsManager::getDiskReadCount() {
+    mStaticMembers.mLock.lock();
+    unsigned long count = mStaticMembers.mDiskReadCount;
+    mStaticMembers.mLock.unlock();
+    return count;
+    }
+
+
+
+unsigned long SettingsManager::getDiskWriteCount() {
+    mStaticMembers.mLock.lock();
+    unsigned long count = mStaticMembers.mDiskWriteCount;
+    mStaticMembers.mLock.unlock();
+    return count;
+    }
+
+
+
+// FNV-1a, to skip most string compares when searching cache
+static unsigned int hashSettingName( const char *inSettingName ) {
+    unsigned int hash = 2166136261U;
+    
+    for( const char *c = inSettingName; *c != '\0'; c++ ) {
+        hash ^= (unsigned char)( *c );
+        hash *= 16777619U;
+        }
+    return hash;
+    }
+
+
+
+// size is -1 if file is missing
+static void statSettingsFile( const char *inFileName,
+                              long *outModTime, long *outSize ) {
+    struct stat fileInfo;
+    
+    if( stat( inFileName, &fileInfo ) == 0 ) {
+        *outModTime = (long)( fileInfo.st_mtime );
+        *outSize = (long)( fileInfo.st_size );
+        }
+    else {
+        *outModTime = 0;
+        *outSize = -1;
+        }
+    }
+
+
+
+static void freeCacheEntry( SettingsCacheEntry *inEntry ) {
+    delete [] inEntry->name;
+    delete [] inEntry->fileName;
+    delete [] inEntry->hashFileName;
+    
+    if( inEntry->contents != NULL ) {
+        delete [] inEntry->contents;
+        }
+    }
+
+
+
+SettingsCacheEntry *SettingsManager::findCacheEntry( 
+    const char *inSettingName ) {
+
+    unsigned int hash = hashSettingName( inSettingName );
+    
+    int numEntries = mStaticMembers.mCache.size();
+    
+    for( int i=0; i<numEntries; i++ ) {
+        SettingsCacheEntry *e = mStaticMembers.mCache.getElementFast( i );
+        
+        if( e->nameHash == hash && strcmp( e->name, inSettingName ) == 0 ) {
+            return e;
+            }
+        }
+    return NULL;
+    }
+
+
+
+SettingsCacheEntry *SettingsManager::addCacheEntry( 
+    const char *inSettingName ) {
+    
+    SettingsCacheEntry e;
+    
+    e.name = stringDuplicate( inSettingName );
+    e.nameHash = hashSettingName( inSettingName );
+    e.fileName = getSettingsFileName( inSettingName );
+    e.hashFileName = getSettingsFileName( inSettingName, "hash" );
+    e.contents = NULL;
+    e.dirty = false;
+    e.modTime = 0;
+    e.fileSize = -1;
+    e.hashModTime = 0;
+    e.hashFileSize = -1;
+    e.racy = false;
+    e.lastCheckTime = Time::getCurrentTime();
+    
+    mStaticMembers.mCache.push_back( e );
+    
+    return mStaticMembers.mCache.getElementFast( 
+        mStaticMembers.mCache.size() - 1 );
+    }
+
+
+
+void SettingsManager::stampCacheEntry( SettingsCacheEntry *inEntry ) {
+    statSettingsFile( inEntry->fileName, 
+                      &( inEntry->modTime ), &( inEntry->fileSize ) );
+    
+    if( mHashingOn ) {
+        statSettingsFile( inEntry->hashFileName, 
+                          &( inEntry->hashModTime ), 
+                          &( inEntry->hashFileSize ) );
+        }
+    
+    // modification times only have 1-second resolution, so another
+    // change this second could leave them the same
+    long now = (long)time( NULL );
+    
+    inEntry->racy = 
+        ( inEntry->modTime >= now || inEntry->hashModTime >= now );
+    }
+
+
+
+SettingsCacheEntry *SettingsManager::getCacheEntry( 
+    const char *inSettingName ) {
+    
+    SettingsCacheEntry *e = findCacheEntry( inSettingName );
+    
+    double curTime = Time::getCurrentTime();
+    
+    char load = false;
+    
+    if( e == NULL ) {
+        e = addCacheEntry( inSettingName );
+        stampCacheEntry( e );
+        load = true;
+        }
+    else if( ! e->dirty && 
+             curTime - e->lastCheckTime >= mFileCheckInterval ) {
+        
+        e->lastCheckTime = curTime;
+        
+        long oldModTime = e->modTime;
+        long oldFileSize = e->fileSize;
+        long oldHashModTime = e->hashModTime;
+        long oldHashFileSize = e->hashFileSize;
+        char wasRacy = e->racy;
+        
+        // stamp before reading, so a change during the read shows up
+        // at the next check
+        stampCacheEntry( e );
+
+        if( wasRacy ||
+            e->modTime != oldModTime ||
+            e->fileSize != oldFileSize ||
+            e->hashModTime != oldHashModTime ||
+            e->hashFileSize != oldHashFileSize ) {
+            load = true;
+            }
+        }
+    
+    if( load ) {
+        if( e->contents != NULL ) {
+            delete [] e->contents;
+            }
+        e->contents = readSettingContents( inSettingName, e->fileName,
+                                           e->hashFileName );
+        mStaticMembers.mDiskReadCount++;
+        }
+    else {
+        mStaticMembers.mCacheHitCount++;
+        }
+    
+    return e;
+    }
+
+
+
+void SettingsManager::flushSettings() {
+    mStaticMembers.mFlushLock.lock();
+    
+    SimpleVector<char *> names;
+    SimpleVector<char *> fileNames;
+    SimpleVector<char *> hashFileNames;
+    SimpleVector<char *> values;
+    
+
+    mStaticMembers.mLock.lock();
+    
+    for( int i=0; i<mStaticMembers.mCache.size(); i++ ) {
+        SettingsCacheEntry *e = mStaticMembers.mCache.getElementFast( i );
+        
+        if( e->dirty ) {
+            names.push_back( stringDuplicate( e->name ) );
+            fileNames.push_back( stringDuplicate( e->fileName ) );
+            hashFileNames.push_back( stringDuplicate( e->hashFileName ) );
+            values.push_back( stringDuplicate( e->contents ) );
+            
+            e->dirty = false;
+            }
+        }
+
+    mStaticMembers.mLock.unlock();
+    
+
+    // write without holding cache lock, so gets aren't held up by disk
+    for( int i=0; i<values.size(); i++ ) {
+        writeSettingContents( fileNames.getElementDirect( i ),
+                              hashFileNames.getElementDirect( i ),
+                              values.getElementDirect( i ) );
+        }
+    
+
+    mStaticMembers.mLock.lock();
+
+    mStaticMembers.mDiskWriteCount += values.size();
+    
+    for( int i=0; i<names.size(); i++ ) {
+        SettingsCacheEntry *e = findCacheEntry( names.getElementDirect( i ) );
+        
+        if( e != NULL && ! e->dirty ) {
+            // don't reload our own write at next check
+            stampCacheEntry( e );
+            e->lastCheckTime = Time::getCurrentTime();
+            }
+        }
+    
+    mStaticMembers.mLock.unlock();
+    
+    mStaticMembers.mFlushLock.unlock();
+
+    
+    names.deallocateStringElements();
+    fileNames.deallocateStringElements();
+    hashFileNames.deallocateStringElements();
+    values.deallocateStringElements();
+    }
+
+
+
+void SettingsManager::clearCache() {
+    mStaticMembers.mFlushLock.lock();
+    mStaticMembers.mLock.lock();
+
+    for( int i=0; i<mStaticMembers.mCache.size(); i++ ) {
+        SettingsCacheEntry *e = mStaticMembers.mCache.getElementFast( i );
+        
+        if( e->dirty ) {
+            writeSettingContents( e->fileName, e->hashFileName, 
+                                  e->contents );
+            mStaticMembers.mDiskWriteCount++;
+            }
+        freeCacheEntry( e );
+        }
+    mStaticMembers.mCache.deleteAll();
+    
+    mStaticMembers.mLock.unlock();
+    mStaticMembers.mFlushLock.unlock();
+    }
+
+
+
 
 SimpleVector<char *> *SettingsManager::getSetting( 
     const char *inSettingName ) {
@@ -215,11 +528,46 @@ SimpleVector<double> *SettingsManager::getDoubleSettingMulti(
 
 char *SettingsManager::getSettingContents( const char *inSettingName ) {
 
-    char *fileName = getSettingsFileName( inSettingName );
-    File *settingsFile = new File( NULL, fileName );
+    if( ! mCachingOn ) {
+        char *fileName = getSettingsFileName( inSettingName );
+        char *hashFileName = getSettingsFileName( inSettingName, "hash" );
 
-    delete [] fileName;
+        char *contents = readSettingContents( inSettingName, fileName,
+                                              hashFileName );
+        delete [] fileName;
+        delete [] hashFileName;
+
+        mStaticMembers.mLock.lock();
+        mStaticMembers.mDiskReadCount++;
+        mStaticMembers.mLock.unlock();
+        
+        return contents;
+        }
+    
+
+    mStaticMembers.mLock.lock();
+    
+    SettingsCacheEntry *e = getCacheEntry( inSettingName );
     
+    char *contents = NULL;
+    
+    if( e->contents != NULL ) {
+        contents = stringDuplicate( e->contents );
+        }
+    
+    mStaticMembers.mLock.unlock();
+    
+    return contents;
+    }
+
+
+
+char *SettingsManager::readSettingContents( const char *inSettingName,
+                                            const char *inFileName,
+                                            const char *inHashFileName ) {
+
+    File *settingsFile = new File( NULL, inFileName );
+
     char *fileContents = settingsFile->readFileContents();
 
     delete settingsFile;
@@ -231,11 +579,7 @@ char *SettingsManager::getSettingContents( const char *inSettingName ) {
     
     if( mHashingOn ) {
         
-        char *hashFileName = getSettingsFileName( inSettingName, "hash" );
-        
-        File *hashFile = new File( NULL, hashFileName );
-        
-        delete [] hashFileName;
+        File *hashFile = new File( NULL, inHashFileName );
         
         char *savedHash = hashFile->readFileContents();
         
@@ -496,6 +840,75 @@ void SettingsManager::setSetting( const char *inSettingName,
 void SettingsManager::setSetting( const char *inSettingName,
                                   const char *inSettingValue ) {
 
+    if( ! mCachingOn ) {
+        char *fileName = getSettingsFileName( inSettingName );
+        char *hashFileName = getSettingsFileName( inSettingName, "hash" );
+
+        writeSettingContents( fileName, hashFileName, inSettingValue );
+
+        delete [] fileName;
+        delete [] hashFileName;
+
+        mStaticMembers.mLock.lock();
+        mStaticMembers.mDiskWriteCount++;
+        mStaticMembers.mLock.unlock();
+        
+        return;
+        }
+
+    
+    mStaticMembers.mLock.lock();
+    
+    SettingsCacheEntry *e = findCacheEntry( inSettingName );
+    
+    if( e == NULL ) {
+        e = addCacheEntry( inSettingName );
+        }
+    
+    if( e->contents != NULL ) {
+        delete [] e->contents;
+        }
+    e->contents = stringDuplicate( inSettingValue );
+    
+    if( mWriteBehind ) {
+        e->dirty = true;
+        
+        mStaticMembers.mLock.unlock();
+        return;
+        }
+
+    char *fileName = stringDuplicate( e->fileName );
+    char *hashFileName = stringDuplicate( e->hashFileName );
+
+    mStaticMembers.mLock.unlock();
+    
+
+    writeSettingContents( fileName, hashFileName, inSettingValue );
+
+    delete [] fileName;
+    delete [] hashFileName;
+    
+
+    mStaticMembers.mLock.lock();
+
+    mStaticMembers.mDiskWriteCount++;
+    
+    e = findCacheEntry( inSettingName );
+    
+    if( e != NULL && ! e->dirty ) {
+        // don't reload our own write at next check
+        stampCacheEntry( e );
+        e->lastCheckTime = Time::getCurrentTime();
+        }
+    
+    mStaticMembers.mLock.unlock();
+    }
+
+
+
+void SettingsManager::writeSettingContents( const char *inFileName,
+                                            const char *inHashFileName,
+                                            const char *inSettingValue ) {
     if( mHashingOn ) {
         
         // compute hash
@@ -507,11 +920,7 @@ void SettingsManager::setSetting( const char *inSettingName,
 
         delete [] stringToHash;
         
-        char *hashFileName = getSettingsFileName( inSettingName, "hash" );
-    
-        FILE *file = fopen( hashFileName, "w" );
-
-        delete [] hashFileName;
+        FILE *file = fopen( inHashFileName, "w" );
 
         if( file != NULL ) {
             fprintf( file, "%s", hash );
@@ -524,8 +933,7 @@ void SettingsManager::setSetting( const char *inSettingName,
     
 
 
-
-    FILE *file = getSettingsFile( inSettingName, "w" );
+    FILE *file = fopen( inFileName, "w" );
     
     if( file != NULL ) {
         
@@ -639,13 +1047,23 @@ char *SettingsManager::getSettingsFileName( const char *inSettingName,
 
 SettingsManagerStaticMembers::SettingsManagerStaticMembers()
     : mDirectoryName( stringDuplicate( "settings" ) ),
-      mHashSalt( stringDuplicate( "default_salt" ) ) {
+      mHashSalt( stringDuplicate( "default_salt" ) ),
+      mCacheHitCount( 0 ),
+      mDiskReadCount( 0 ),
+      mDiskWriteCount( 0 ) {
     
     }
 
 
 
 SettingsManagerStaticMembers::~SettingsManagerStaticMembers() {
+    // write anything still pending from write-behind
+    SettingsManager::flushSettings();
+    
+    for( int i=0; i<mCache.size(); i++ ) {
+        freeCacheEntry( mCache.getElementFast( i ) );
+        }
+    
     delete [] mDirectoryName;
     delete [] mHashSalt;
     }
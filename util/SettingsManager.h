@@ -69,6 +69,36 @@ class SettingsManagerStaticMembers;
 
 
 
+// one setting held in memory by SettingsManager
+typedef struct SettingsCacheEntry {
+        char *name;
+        unsigned int nameHash;
+
+        char *fileName;
+        char *hashFileName;
+
+        // NULL if setting file was missing or had a bad hash
+        char *contents;
+
+        // changed since last flush
+        char dirty;
+
+        // state of files on disk when last loaded or checked
+        // size is -1 if file was missing
+        long modTime;
+        long fileSize;
+        long hashModTime;
+        long hashFileSize;
+
+        // file was modified in the same second it was loaded, so a later
+        // change might not show up in its modification time
+        char racy;
+
+        double lastCheckTime;
+    } SettingsCacheEntry;
+
+
+
 /**
  * Class that manages program settings.
  *
@@ -133,7 +163,71 @@ class SettingsManager {
         static void setHashingOn( char inOn );
 
 
-        
+
+        /**
+         * Turns the in-memory settings cache on or off.  On by default.
+         *
+         * With the cache on, each setting is read from disk (and its hash
+         * checked) only once, and served from memory after that, until
+         * it is set again or its file changes on disk.
+         *
+         * Turning the cache off flushes any pending writes.
+         *
+         * @param inOn true to turn caching on.
+         */
+        static void setCachingOn( char inOn );
+
+
+
+        /**
+         * Sets how often a cached setting's file is checked for changes
+         * made outside of this manager.  Defaults to 1 second.
+         *
+         * @param inSeconds the minimum time between checks for one
+         *   setting, or 0 to check on every get.
+         */
+        static void setFileCheckInterval( double inSeconds );
+
+
+
+        /**
+         * Turns write-behind on or off.  Off by default.
+         *
+         * With write-behind on (and caching on), setSetting only updates
+         * the cache, and changed settings are written to disk by the next
+         * flushSettings call.  See SettingsFlushThread for calling it
+         * periodically.
+         *
+         * Turning write-behind off flushes any pending writes.
+         *
+         * @param inOn true to turn write-behind on.
+         */
+        static void setWriteBehind( char inOn );
+
+
+
+        /**
+         * Writes settings changed since the last flush to disk.
+         *
+         * Thread safe.  Also called at program termination.
+         */
+        static void flushSettings();
+
+
+
+        /**
+         * Gets counters for cache activity since program start.
+         *
+         * getCacheHitCount counts gets served from memory.
+         * getDiskReadCount counts settings files read from disk.
+         * getDiskWriteCount counts settings files written to disk.
+         */
+        static unsigned long getCacheHitCount();
+        static unsigned long getDiskReadCount();
+        static unsigned long getDiskWriteCount();
+
+
+
         /**
          * Gets a setting, tokenized by whitespace into separate strings.
          *
@@ -375,7 +469,55 @@ class SettingsManager {
         static SettingsManagerStaticMembers mStaticMembers;
 
         static char mHashingOn;
+
+        static char mCachingOn;
+        static char mWriteBehind;
+
+        static double mFileCheckInterval;
+
+
+        /**
+         * Reads a setting's file and checks its hash.
+         *
+         * @param inSettingName the name of the setting, for messages.
+         * @param inFileName the setting's file.
+         * @param inHashFileName the setting's hash file.
+         *
+         * @return the file contents, or NULL if the file is missing
+         *   or its hash is bad.
+         *   Must be destroyed by caller if non-NULL.
+         */
+        static char *readSettingContents( const char *inSettingName,
+                                          const char *inFileName,
+                                          const char *inHashFileName );
+
+
+        // writes a setting's file (and hash file, if hashing is on)
+        static void writeSettingContents( const char *inFileName,
+                                          const char *inHashFileName,
+                                          const char *inSettingValue );
+
+
+        // cache functions below must be called with mStaticMembers.mLock
+        // locked
+        // returned pointers are only good until the cache changes
         
+        // returns NULL if setting not in cache
+        static SettingsCacheEntry *findCacheEntry( const char *inSettingName );
+
+        // adds an empty entry, without loading it
+        static SettingsCacheEntry *addCacheEntry( const char *inSettingName );
+        
+        // finds an entry, loading it or reloading it from disk if needed
+        static SettingsCacheEntry *getCacheEntry( const char *inSettingName );
+
+        // records current state of an entry's files on disk
+        static void stampCacheEntry( SettingsCacheEntry *inEntry );
+
+
+        // writes pending changes and empties the cache
+        static void clearCache();
+
 
         /**
          * Gets the file name for a setting with the default ini extension.
@@ -429,7 +571,19 @@ class SettingsManagerStaticMembers {
         
         char *mDirectoryName;
         char *mHashSalt;
-        
+
+        // protects cache and counters
+        MutexLock mLock;
+
+        // only one flush writes files at a time
+        MutexLock mFlushLock;
+
+        SimpleVector<SettingsCacheEntry> mCache;
+
+        unsigned long mCacheHitCount;
+        unsigned long mDiskReadCount;
+        unsigned long mDiskWriteCount;
+
 
 
     };
@@ -50,17 +50,78 @@
 *		Jason Rohrer	1-4-2018	deleteStartElements for efficiency.
 *		Jason Rohrer	7-12-2018	push_middle function.
 *		Jason Rohrer	5-10-2019	getElementDirectFast function.
+*		Jason Rohrer	10-18-2026	Raw storage that only constructs filled
+*									elements, and moves elements (C++11)
+*									instead of copying them when growing
+*									or deleting.  Added reserve,
+*									shrink_to_fit, capacity, emplace_back,
+*									and SimpleSmallVector.
 */
 
 #include "minorGems/common.h"
 
 
 
+
 #ifndef SIMPLEVECTOR_INCLUDED
 #define SIMPLEVECTOR_INCLUDED
 
 #include <string.h>		// for memory moving functions
 #include <stdio.h>
+#include <stdlib.h>		// for malloc and realloc
+#include <new>			// for placement new
+
+
+#if __cplusplus >= 201103L
+    #include <utility>
+    #define SIMPLE_VECTOR_MOVE( x )  std::move( x )
+
+    // libstdc++ before gcc 5 is missing is_trivially_copyable, and
+    // _GLIBCXX_USE_CXX11_ABI first appeared in gcc 5
+    #if ! defined( __GLIBCXX__ ) || defined( _GLIBCXX_USE_CXX11_ABI )
+        #include <type_traits>
+        #define SIMPLE_VECTOR_TYPE_TRAITS
+    #endif
+#else
+    #define SIMPLE_VECTOR_MOVE( x )  ( x )
+#endif
+
+
+
+// Whether a type can be moved around with memcpy and realloc, without
+// calling its constructors, destructor, or assignment operator.
+// Without C++11 type traits, only built-in types and pointers are
+// known to be plain.
+template <class Type>
+struct SimpleVectorPlainType {
+#ifdef SIMPLE_VECTOR_TYPE_TRAITS
+        enum { value = std::is_trivially_copyable<Type>::value };
+#else
+        enum { value = false };
+#endif
+    };
+
+template <class Type>
+struct SimpleVectorPlainType<Type*> {
+        enum { value = true };
+    };
+
+#define SIMPLE_VECTOR_PLAIN_TYPE( t ) \
+    template <> struct SimpleVectorPlainType<t> { enum { value = true }; };
+
+SIMPLE_VECTOR_PLAIN_TYPE( char )
+SIMPLE_VECTOR_PLAIN_TYPE( signed char )
+SIMPLE_VECTOR_PLAIN_TYPE( unsigned char )
+SIMPLE_VECTOR_PLAIN_TYPE( short )
+SIMPLE_VECTOR_PLAIN_TYPE( unsigned short )
+SIMPLE_VECTOR_PLAIN_TYPE( int )
+SIMPLE_VECTOR_PLAIN_TYPE( unsigned int )
+SIMPLE_VECTOR_PLAIN_TYPE( long )
+SIMPLE_VECTOR_PLAIN_TYPE( unsigned long )
+SIMPLE_VECTOR_PLAIN_TYPE( float )
+SIMPLE_VECTOR_PLAIN_TYPE( double )
+SIMPLE_VECTOR_PLAIN_TYPE( bool )
+
 
 
 const int defaultStartSize = 2;
@@ -81,10 +142,27 @@ class SimpleVector {
         // assignment operator
         SimpleVector & operator = (const SimpleVector &inOther );
         
+#if __cplusplus >= 201103L
+        // move constructor and assignment operator
+        // take other vector's storage instead of copying its elements,
+        // leaving other vector empty
+        SimpleVector( SimpleVector &&inOther );
+        
+        SimpleVector & operator = ( SimpleVector &&inOther );
+#endif
 
 
 		
-		void push_back(Type x);		// add x to the end of the vector
+		void push_back(const Type &x);		// add x to the end of the vector
+
+#if __cplusplus >= 201103L
+        void push_back( Type &&x );  // move x to the end of the vector
+        
+        // construct a new element at the end of the vector, passing
+        // inArgs to its constructor
+        template <class... Args>
+        void emplace_back( Args&&... inArgs );
+#endif
 
         // add array of elements to the end of the vector
 		void push_back(Type *inArray, int inLength);		
@@ -172,6 +250,29 @@ class SimpleVector {
 		void deleteAll();		// delete all elements from vector
 
 
+
+        /**
+         * Makes room for at least inNumElements, so that the vector won't
+         * reallocate as it is filled up to that size.
+         *
+         * @param inNumElements the number of elements to make room for.
+         */
+        void reserve( int inNumElements );
+
+
+
+        /**
+         * Frees any room allocated beyond the current elements.
+         */
+        void shrink_to_fit();
+
+
+
+        // number of elements there is room for before the vector must
+        // reallocate
+        int capacity();
+
+
         
 		/**
 		 * Gets the elements as an array.
@@ -273,70 +374,181 @@ class SimpleVector {
 
 
 	protected:
+        // raw storage, only the first numFilledElements are constructed
 		Type *elements;
 		int numFilledElements;
 		int maxSize;
 		int minSize;	// number of allocated elements when vector is empty
 
+        // storage inside a SimpleSmallVector, or NULL
+        // it holds minSize elements
+        Type *inlineElements;
 
         char printExpansionMessage;
         const char *vectorName;
+
+
+        // for SimpleSmallVector, starts out using inInlineElements
+        SimpleVector( Type *inInlineElements, int inInlineSize );
+        
+
+        // moves elements into new storage with room for inNewMaxSize
+        // elements (at least numFilledElements)
+        void reallocate( int inNewMaxSize );
+        
+        // gets the next size up that has room for inNumElements
+        int getGrowthSize( int inNumElements );
+
+        // frees storage, unless it is inline
+        void freeElements();
 		};
 		
 		
 template <class Type>		
 inline SimpleVector<Type>::SimpleVector()
-		: vectorName( "" ) {
-	elements = new Type[defaultStartSize];
-	numFilledElements = 0;
-	maxSize = defaultStartSize;
-	minSize = defaultStartSize;
-
-    printExpansionMessage = false;
+		: elements( NULL ), numFilledElements( 0 ), 
+          maxSize( 0 ), minSize( defaultStartSize ),
+          inlineElements( NULL ),
+          printExpansionMessage( false ),
+          vectorName( "" ) {
+    // nothing allocated until first element added
     }
 
 template <class Type>
 inline SimpleVector<Type>::SimpleVector(int sizeEstimate)
-		: vectorName( "" ) {
+		: inlineElements( NULL ), vectorName( "" ) {
             if( sizeEstimate <= 0 ) {
         // can't double 0 when vector needs to grow, so min size has to
         // be 1
         sizeEstimate = 1;
         }
     
-	elements = new Type[sizeEstimate];
+	elements = (Type *)malloc( sizeof( Type ) * sizeEstimate );
 	numFilledElements = 0;
 	maxSize = sizeEstimate;
 	minSize = sizeEstimate;
     
     printExpansionMessage = false;
     }
+
+
+template <class Type>
+inline SimpleVector<Type>::SimpleVector( Type *inInlineElements,
+                                         int inInlineSize )
+		: elements( inInlineElements ), numFilledElements( 0 ), 
+          maxSize( inInlineSize ), minSize( inInlineSize ),
+          inlineElements( inInlineElements ),
+          printExpansionMessage( false ),
+          vectorName( "" ) {
+    }
+
 	
 template <class Type>	
 inline SimpleVector<Type>::~SimpleVector() {
-	delete [] elements;
+    shrink( 0 );
+    freeElements();
 	}	
 
 
 
+template <class Type>
+inline void SimpleVector<Type>::freeElements() {
+    if( elements != inlineElements ) {
+        free( (void *)elements );
+        }
+    }
+
+
+
+template <class Type>
+inline int SimpleVector<Type>::getGrowthSize( int inNumElements ) {
+    int newMaxSize = maxSize;
+    
+    if( newMaxSize < minSize ) {
+        newMaxSize = minSize;
+        }
+    
+    while( newMaxSize < inNumElements ) {
+        newMaxSize = newMaxSize << 1;		// double size
+        }
+    
+    if( printExpansionMessage ) {
+        printf( "SimpleVector \"%s\" is expanding itself from %d to %d"
+                " max elements\n", vectorName, maxSize, newMaxSize );
+        }
+    
+    return newMaxSize;
+    }
+
+
+
+template <class Type>
+inline void SimpleVector<Type>::reallocate( int inNewMaxSize ) {
+    
+    Type *newElements;
+    
+    if( inlineElements != NULL && inNewMaxSize <= minSize ) {
+        // fits in inline storage
+        if( elements == inlineElements ) {
+            return;
+            }
+        newElements = inlineElements;
+        inNewMaxSize = minSize;
+        }
+    else if( SimpleVectorPlainType<Type>::value && 
+             elements != inlineElements ) {
+        // realloc can often grow in place, and plain elements
+        // don't care where they live
+        elements = (Type *)realloc( (void *)elements, 
+                                    sizeof( Type ) * inNewMaxSize );
+        maxSize = inNewMaxSize;
+        return;
+        }
+    else {
+        newElements = (Type *)malloc( sizeof( Type ) * inNewMaxSize );
+        }
+    
+    if( SimpleVectorPlainType<Type>::value ) {
+        if( numFilledElements > 0 ) {
+            memcpy( (void *)newElements, (void *)elements, 
+                    sizeof( Type ) * numFilledElements );
+            }
+        }
+    else {
+        // memcpy does not work here, because elements might point
+        // into themselves or be pointed to by others, so
+        // move each one with its constructor, and destroy the old one
+        for( int i=0; i<numFilledElements; i++ ) {
+            ::new( &( newElements[i] ) ) 
+                Type( SIMPLE_VECTOR_MOVE( elements[i] ) );
+            elements[i].~Type();
+            }
+        }
+    
+    freeElements();
+    
+    elements = newElements;
+    maxSize = inNewMaxSize;
+    }
+
+
+
 // copy constructor
 template <class Type>
 inline SimpleVector<Type>::SimpleVector( const SimpleVector<Type> &inCopy )
-        : elements( new Type[ inCopy.maxSize ] ),
-          numFilledElements( inCopy.numFilledElements ),
-          maxSize( inCopy.maxSize ), minSize( inCopy.minSize ),
+        : elements( NULL ),
+          numFilledElements( 0 ),
+          maxSize( 0 ), minSize( inCopy.minSize ),
+          inlineElements( NULL ),
           printExpansionMessage( inCopy.printExpansionMessage ),
           vectorName( inCopy.vectorName ) {
     
-    // if these objects contain pointers to stack, etc, this is not 
-    // going to work (not a deep copy)
-    // because it won't invoke the copy constructors of the objects!
-    //memcpy( elements, inCopy.elements, sizeof( Type ) * numFilledElements );
-    
-    for( int i=0; i<inCopy.numFilledElements; i++ ) {
-        elements[i] = inCopy.elements[i];
+    if( inCopy.maxSize > 0 ) {
+        reallocate( inCopy.maxSize );
         }
-
+    
+    // copy constructors are invoked on non-plain elements
+    appendArray( inCopy.elements, inCopy.numFilledElements );
     }
 
 
@@ -346,32 +558,20 @@ template <class Type>
 inline SimpleVector<Type> & SimpleVector<Type>::operator = (
     const SimpleVector<Type> &inOther ) {
     
-    // pattern found on wikipedia:
-
     // avoid self-assignment
     if( this != &inOther )  {
         
-        // 1: allocate new memory and copy the elements
-        Type *newElements = new Type[ inOther.maxSize ];
-
-        // again, memcpy doesn't work here, because it doesn't invoke
-        // copy constructor on contained object
-        /*memcpy( newElements, inOther.elements, 
-                sizeof( Type ) * inOther.numFilledElements );
-        */
-        for( int i=0; i<inOther.numFilledElements; i++ ) {
-            newElements[i] = inOther.elements[i];
+        shrink( 0 );
+        
+        if( inlineElements == NULL ) {
+            minSize = inOther.minSize;
             }
-
-
-        // 2: deallocate old memory
-        delete [] elements;
- 
-        // 3: assign the new memory to the object
-        elements = newElements;
-        numFilledElements = inOther.numFilledElements;
-        maxSize = inOther.maxSize;
-        minSize = inOther.minSize;
+        
+        if( maxSize < inOther.numFilledElements ) {
+            reallocate( inOther.maxSize );
+            }
+        
+        appendArray( inOther.elements, inOther.numFilledElements );
         }
 
     // by convention, always return *this
@@ -380,6 +580,75 @@ inline SimpleVector<Type> & SimpleVector<Type>::operator = (
 
 
 
+#if __cplusplus >= 201103L
+
+template <class Type>
+inline SimpleVector<Type>::SimpleVector( SimpleVector<Type> &&inOther )
+        : elements( NULL ),
+          numFilledElements( 0 ),
+          maxSize( 0 ), minSize( inOther.minSize ),
+          inlineElements( NULL ),
+          printExpansionMessage( inOther.printExpansionMessage ),
+          vectorName( inOther.vectorName ) {
+    
+    *this = std::move( inOther );
+    }
+
+
+
+template <class Type>
+inline SimpleVector<Type> & SimpleVector<Type>::operator = (
+    SimpleVector<Type> &&inOther ) {
+    
+    if( this != &inOther )  {
+        
+        shrink( 0 );
+        
+        if( inOther.inlineElements != NULL &&
+            inOther.elements == inOther.inlineElements ) {
+            // can't take other vector's inline storage,
+            // so move elements over one by one
+            if( maxSize < inOther.numFilledElements ) {
+                reallocate( inOther.numFilledElements );
+                }
+            
+            for( int i=0; i<inOther.numFilledElements; i++ ) {
+                ::new( &( elements[i] ) ) 
+                    Type( std::move( inOther.elements[i] ) );
+                }
+            numFilledElements = inOther.numFilledElements;
+            
+            inOther.shrink( 0 );
+            }
+        else {
+            freeElements();
+            
+            elements = inOther.elements;
+            numFilledElements = inOther.numFilledElements;
+            maxSize = inOther.maxSize;
+            
+            if( inlineElements == NULL ) {
+                minSize = inOther.minSize;
+                }
+            
+            // other vector left empty, with only its inline storage
+            inOther.elements = inOther.inlineElements;
+            inOther.numFilledElements = 0;
+            
+            if( inOther.inlineElements != NULL ) {
+                inOther.maxSize = inOther.minSize;
+                }
+            else {
+                inOther.maxSize = 0;
+                }
+            }
+        }
+    
+    return *this;
+    }
+
+#endif
+
 
 
 
@@ -426,37 +695,30 @@ inline Type SimpleVector<Type>::getElementDirectFast(int index) {
 
 template <class Type>
 inline bool SimpleVector<Type>::deleteElement(int index) {
-	if( index < numFilledElements) {	// if index valid for this vector
+	if( index < numFilledElements && index >= 0 ) {
 		
 		if( index != numFilledElements - 1)  {	
             // this spot somewhere in middle
 		
-            
-
-            // memmove NOT okay here, because it leaves shallow copies
-            // behind that cause errors when the whole element array is 
-            // destroyed.
-
-            /*
-			// move memory towards front by one spot
-			int sizeOfElement = sizeof(Type);
-		
-			int numBytesToMove = sizeOfElement*(numFilledElements - (index+1));
-		
-			Type *destPtr = &(elements[index]);
-			Type *srcPtr = &(elements[index+1]);
-		
-			memmove( (void *)destPtr, (void *)srcPtr, 
-                    (unsigned int)numBytesToMove);
-            */
-
-
-            for( int i=index+1; i<numFilledElements; i++ ) {
-                elements[i - 1] = elements[i];
+            if( SimpleVectorPlainType<Type>::value ) {
+                // move memory towards front by one spot
+                memmove( (void *)&( elements[index] ), 
+                         (void *)&( elements[index + 1] ),
+                         sizeof( Type ) * ( numFilledElements - 
+                                            ( index + 1 ) ) );
+                }
+            else {
+                // memmove NOT okay here, because it leaves shallow copies
+                // behind that cause errors when the elements are
+                // destroyed.
+                for( int i=index+1; i<numFilledElements; i++ ) {
+                    elements[i - 1] = SIMPLE_VECTOR_MOVE( elements[i] );
+                    }
                 }
 			}
 			
-		numFilledElements--;	// one less element in vector
+        // destroy what's left in last spot
+        shrink( numFilledElements - 1 );
 		return true;
 		}
 	else {				// index not valid for this vector
@@ -471,18 +733,27 @@ inline bool SimpleVector<Type>::deleteStartElements( int inNumToDelete ) {
 	if( inNumToDelete <= numFilledElements) {
 		
 		if( inNumToDelete != numFilledElements)  {	
-            
 
-            // memmove NOT okay here, because it leaves shallow copies
-            // behind that cause errors when the whole element array is 
-            // destroyed.
-
-            for( int i=inNumToDelete; i<numFilledElements; i++ ) {
-                elements[i - inNumToDelete] = elements[i];
+            if( SimpleVectorPlainType<Type>::value ) {
+                // we do this A LOT for char vectors, 
+                // and memmove is much faster for them
+                memmove( (void *)elements, 
+                         (void *)&( elements[inNumToDelete] ),
+                         sizeof( Type ) * 
+                         ( numFilledElements - inNumToDelete ) );
+                }
+            else {
+                // memmove NOT okay here, because it leaves shallow copies
+                // behind that cause errors when the elements are
+                // destroyed.
+                for( int i=inNumToDelete; i<numFilledElements; i++ ) {
+                    elements[i - inNumToDelete] = 
+                        SIMPLE_VECTOR_MOVE( elements[i] );
+                    }
                 }
 			}
 			
-		numFilledElements -= inNumToDelete;
+		shrink( numFilledElements - inNumToDelete );
 		return true;
 		}
 	else {				// not enough eleements in vector
@@ -492,53 +763,6 @@ inline bool SimpleVector<Type>::deleteStartElements( int inNumToDelete ) {
 
 
 
-// special case implementation
-// we do this A LOT for unsigned char vectors
-// and we can use the more efficient memmove for unsigned chars
-template <>
-inline bool SimpleVector<unsigned char>::deleteStartElements( 
-    int inNumToDelete ) {
-	
-    if( inNumToDelete <= numFilledElements) {
-		
-		if( inNumToDelete != numFilledElements)  {
-
-            memmove( elements, &( elements[inNumToDelete] ),
-                     numFilledElements - inNumToDelete );
-            }
-			
-		numFilledElements -= inNumToDelete;
-		return true;
-		}
-	else {				// not enough elements in vector
-		return false;
-		}
-	}
-
-
-// same for signed char vectors
-template <>
-inline bool SimpleVector<char>::deleteStartElements( 
-    int inNumToDelete ) {
-	
-    if( inNumToDelete <= numFilledElements) {
-		
-		if( inNumToDelete != numFilledElements)  {
-
-            memmove( elements, &( elements[inNumToDelete] ),
-                     numFilledElements - inNumToDelete );
-            }
-			
-		numFilledElements -= inNumToDelete;
-		return true;
-		}
-	else {				// not enough elements in vector
-		return false;
-		}
-	}
-
-
-
 
 template <class Type>
 inline bool SimpleVector<Type>::deleteElementEqualTo( Type inElement ) {
@@ -555,6 +779,15 @@ inline bool SimpleVector<Type>::deleteElementEqualTo( Type inElement ) {
 
 template <class Type>
 inline void SimpleVector<Type>::shrink( int inNewSize ) {
+    if( inNewSize < 0 || inNewSize >= numFilledElements ) {
+        return;
+        }
+    
+    if( ! SimpleVectorPlainType<Type>::value ) {
+        for( int i=inNewSize; i<numFilledElements; i++ ) {
+            elements[i].~Type();
+            }
+        }
     numFilledElements = inNewSize;
     }
 
@@ -567,9 +800,9 @@ inline void SimpleVector<Type>::swap( int inA, int inB ) {
     
     if( inA < numFilledElements && inA >= 0 &&
         inB < numFilledElements && inB >= 0 ) {
-        Type temp = elements[ inA ];
-        elements[ inA ] = elements[ inB ];
-        elements[ inB ] = temp;
+        Type temp( SIMPLE_VECTOR_MOVE( elements[ inA ] ) );
+        elements[ inA ] = SIMPLE_VECTOR_MOVE( elements[ inB ] );
+        elements[ inB ] = SIMPLE_VECTOR_MOVE( temp );
         }
     }
 
@@ -593,67 +826,151 @@ inline int SimpleVector<Type>::getElementIndex( Type inElement ) {
 
 template <class Type>
 inline void SimpleVector<Type>::deleteAll() {
-	numFilledElements = 0;
+	shrink( 0 );
 	if( maxSize > minSize ) {		// free memory if vector has grown
-		delete [] elements;
-		elements = new Type[minSize];	// reallocate an empty vector
-		maxSize = minSize;
+		reallocate( minSize );
 		}
 	}
 
 
+
+template <class Type>
+inline void SimpleVector<Type>::reserve( int inNumElements ) {
+    if( inNumElements > maxSize ) {
+        reallocate( inNumElements );
+        }
+    }
+
+
+
+template <class Type>
+inline void SimpleVector<Type>::shrink_to_fit() {
+    if( numFilledElements == maxSize ) {
+        return;
+        }
+    
+    if( numFilledElements == 0 && inlineElements == NULL ) {
+        freeElements();
+        elements = NULL;
+        maxSize = 0;
+        }
+    else {
+        reallocate( numFilledElements );
+        }
+    }
+
+
+
 template <class Type>
-inline void SimpleVector<Type>::push_back(Type x)	{
+inline int SimpleVector<Type>::capacity() {
+    return maxSize;
+    }
+
+
+
+template <class Type>
+inline void SimpleVector<Type>::push_back(const Type &x)	{
 	if( numFilledElements < maxSize) {	// still room in vector
-		elements[numFilledElements] = x;
+		new( &( elements[numFilledElements] ) ) Type( x );
 		numFilledElements++;
 		}
 	else {					// need to allocate more space for vector
+        
+        // x might be in our own storage, so copy it before
+        // old storage is freed
 
-		int newMaxSize = maxSize << 1;		// double size
-		
-        if( printExpansionMessage ) {
-            printf( "SimpleVector \"%s\" is expanding itself from %d to %d"
-                    " max elements\n", vectorName, maxSize, newMaxSize );
+        if( SimpleVectorPlainType<Type>::value ) {
+            Type copy( x );
+            
+            reallocate( getGrowthSize( numFilledElements + 1 ) );
+            
+            ::new( &( elements[numFilledElements] ) ) Type( copy );
             }
+        else {
+            // copy it straight into new storage, then move the rest over
+            int newMaxSize = getGrowthSize( numFilledElements + 1 );
+            
+            Type *newElements = 
+                (Type *)malloc( sizeof( Type ) * newMaxSize );
+            
+            ::new( &( newElements[numFilledElements] ) ) Type( x );
+            
+            for( int i=0; i<numFilledElements; i++ ) {
+                ::new( &( newElements[i] ) ) 
+                    Type( SIMPLE_VECTOR_MOVE( elements[i] ) );
+                elements[i].~Type();
+                }
+            
+            freeElements();
+            
+            elements = newElements;
+            maxSize = newMaxSize;
+            }
+        
+		numFilledElements++;	
+		}
+	}
 
 
-        // NOTE:  memcpy does not work here, because it does not invoke
-        // copy constructors on elements.
-        // And then "delete []" below causes destructors to be invoked
-        //  on old elements, which are shallow copies of new objects.
 
-        Type *newAlloc = new Type[newMaxSize];
-        /*
-		unsigned int sizeOfElement = sizeof(Type);
-		unsigned int numBytesToMove = sizeOfElement*(numFilledElements);
-		
+#if __cplusplus >= 201103L
 
-		// move into new space
-		memcpy((void *)newAlloc, (void *) elements, numBytesToMove);
-		*/
+template <class Type>
+inline void SimpleVector<Type>::push_back( Type &&x ) {
+    emplace_back( std::move( x ) );
+    }
 
-        // must use element-by-element assignment to invoke constructors
-        for( int i=0; i<numFilledElements; i++ ) {
-            newAlloc[i] = elements[i];
+
+
+template <class Type>
+template <class... Args>
+inline void SimpleVector<Type>::emplace_back( Args&&... inArgs ) {
+	if( numFilledElements < maxSize ) {
+		new( &( elements[numFilledElements] ) ) 
+            Type( std::forward<Args>( inArgs )... );
+		numFilledElements++;
+		}
+	else {
+        // same as push_back, arguments might refer to our own elements
+
+        if( SimpleVectorPlainType<Type>::value ) {
+            Type copy( std::forward<Args>( inArgs )... );
+            
+            reallocate( getGrowthSize( numFilledElements + 1 ) );
+            
+            ::new( &( elements[numFilledElements] ) ) Type( copy );
+            }
+        else {
+            int newMaxSize = getGrowthSize( numFilledElements + 1 );
+            
+            Type *newElements = 
+                (Type *)malloc( sizeof( Type ) * newMaxSize );
+            
+            ::new( &( newElements[numFilledElements] ) ) 
+                Type( std::forward<Args>( inArgs )... );
+            
+            for( int i=0; i<numFilledElements; i++ ) {
+                ::new( &( newElements[i] ) ) Type( std::move( elements[i] ) );
+                elements[i].~Type();
+                }
+            
+            freeElements();
+            
+            elements = newElements;
+            maxSize = newMaxSize;
             }
         
-
-		// delete old space
-		delete [] elements;
-		
-		elements = newAlloc;
-		maxSize = newMaxSize;	
-		
-		elements[numFilledElements] = x;
 		numFilledElements++;	
 		}
 	}
 
+#endif
+
+
 
 template <class Type>
 inline void SimpleVector<Type>::push_front(Type x)	{
-    push_middle( x, 0 );
+    push_middle( SIMPLE_VECTOR_MOVE( x ), 0 );
     }
 
 
@@ -661,26 +978,47 @@ inline void SimpleVector<Type>::push_front(Type x)	{
 template <class Type>
 inline void SimpleVector<Type>::push_middle( Type x, int inNumBefore )	{
 
-    // first push_back to reuse expansion code
-    push_back( x );
+    if( inNumBefore >= numFilledElements ) {
+        push_back( SIMPLE_VECTOR_MOVE( x ) );
+        return;
+        }
     
-    // now shift all of the "after" elements forward
-    for( int i=numFilledElements-2; i>=inNumBefore; i-- ) {
-        elements[i+1] = elements[i];
+    if( inNumBefore < 0 ) {
+        inNumBefore = 0;
         }
     
-    // finally, re-insert in middle spot
-    elements[inNumBefore] = x;
+    if( SimpleVectorPlainType<Type>::value ) {
+        if( numFilledElements == maxSize ) {
+            reallocate( getGrowthSize( numFilledElements + 1 ) );
+            }
+
+        memmove( (void *)&( elements[inNumBefore + 1] ), 
+                 (void *)&( elements[inNumBefore] ),
+                 sizeof( Type ) * ( numFilledElements - inNumBefore ) );
+        
+        ::new( &( elements[inNumBefore] ) ) Type( x );
+        numFilledElements++;
+        }
+    else {
+        // last element moves into new spot at end, which reuses
+        // expansion code
+        push_back( SIMPLE_VECTOR_MOVE( elements[numFilledElements - 1] ) );
+    
+        // now shift the rest of the "after" elements back
+        for( int i=numFilledElements-2; i>inNumBefore; i-- ) {
+            elements[i] = SIMPLE_VECTOR_MOVE( elements[i - 1] );
+            }
+    
+        // finally, re-insert in middle spot
+        elements[inNumBefore] = SIMPLE_VECTOR_MOVE( x );
+        }
     }
 
 
 
 template <class Type>
 inline void SimpleVector<Type>::push_back(Type *inArray, int inLength)	{
-    
-    for( int i=0; i<inLength; i++ ) {
-        push_back( inArray[i] );
-        }
+    appendArray( inArray, inLength );
     }
 
 
@@ -688,9 +1026,7 @@ template <class Type>
 inline void SimpleVector<Type>::push_back_other(
     SimpleVector<Type> *inOtherVector ) {
     
-    for( int i=0; i<inOtherVector->size(); i++ ) {
-        push_back( inOtherVector->getElementDirect( i ) );
-        }
+    appendArray( inOtherVector->elements, inOtherVector->numFilledElements );
     }
 
 
@@ -699,15 +1035,6 @@ template <class Type>
 inline Type *SimpleVector<Type>::getElementArray() {
     Type *newAlloc = new Type[ numFilledElements ];
 
-    // shallow copy not good enough!
-    /*
-    unsigned int sizeOfElement = sizeof( Type );
-    unsigned int numBytesToCopy = sizeOfElement * numFilledElements;
-    
-    // copy into new space
-    //memcpy( (void *)newAlloc, (void *)elements, numBytesToCopy );
-    */
-
     // use assignment to ensure that constructors are invoked on element copies
     for( int i=0; i<numFilledElements; i++ ) {
         newAlloc[i] = elements[i];
@@ -726,7 +1053,9 @@ inline char *SimpleVector<char>::getElementString() {
 		
     // memcpy fine here, since shallow copy good enough for chars
     // copy into new space
-    memcpy( (void *)newAlloc, (void *)elements, numBytesToCopy );
+    if( numBytesToCopy > 0 ) {
+        memcpy( (void *)newAlloc, (void *)elements, numBytesToCopy );
+        }
 
     newAlloc[ numFilledElements ] = '\0';
     
@@ -754,11 +1083,37 @@ inline void SimpleVector<char>::setElementString( const char *inString ) {
 
 template <class Type>
 inline void SimpleVector<Type>::appendArray( Type *inArray, int inSize ) {
-    // slow but correct
+    if( inSize <= 0 ) {
+        return;
+        }
     
-    for( int i=0; i<inSize; i++ ) {
-        push_back( inArray[i] );
+    if( numFilledElements + inSize > maxSize ) {
+        // inArray might be in our own storage
+        int ownOffset = -1;
+        
+        if( elements != NULL && 
+            inArray >= elements && inArray < elements + maxSize ) {
+            ownOffset = inArray - elements;
+            }
+        
+        reallocate( getGrowthSize( numFilledElements + inSize ) );
+        
+        if( ownOffset != -1 ) {
+            inArray = &( elements[ ownOffset ] );
+            }
+        }
+    
+    if( SimpleVectorPlainType<Type>::value ) {
+        memcpy( (void *)&( elements[numFilledElements] ), (void *)inArray,
+                sizeof( Type ) * inSize );
+        }
+    else {
+        for( int i=0; i<inSize; i++ ) {
+            ::new( &( elements[numFilledElements + i] ) ) Type( inArray[i] );
+            }
         }
+    
+    numFilledElements += inSize;
     }
 
 
@@ -811,6 +1166,70 @@ inline int SimpleVector<char*>::getMatchingStringIndex( char *inString ) {
 
 
 
+/**
+ * A SimpleVector that holds up to inlineSize elements inside itself,
+ * and only allocates once it grows beyond that.
+ *
+ * Good for many short vectors, like per-object lists that usually hold
+ * just a few elements.
+ */
+template <class Type, int inlineSize>
+class SimpleSmallVector : public SimpleVector<Type> {
+    public:
+        
+        SimpleSmallVector()
+                : SimpleVector<Type>( (Type *)( mInlineStorage.bytes ),
+                                      inlineSize ) {
+            }
+        
+
+        SimpleSmallVector( const SimpleSmallVector &inCopy )
+                : SimpleVector<Type>( (Type *)( mInlineStorage.bytes ),
+                                      inlineSize ) {
+            this->appendArray( inCopy.elements, inCopy.numFilledElements );
+            }
+
+
+        // destroys elements while inline storage is still around
+        ~SimpleSmallVector() {
+            this->shrink( 0 );
+            }
+        
+
+        SimpleSmallVector & operator = ( const SimpleSmallVector &inOther ) {
+            SimpleVector<Type>::operator = ( inOther );
+            return *this;
+            }
+
+
+#if __cplusplus >= 201103L
+        SimpleSmallVector( SimpleSmallVector &&inOther )
+                : SimpleVector<Type>( (Type *)( mInlineStorage.bytes ),
+                                      inlineSize ) {
+            SimpleVector<Type>::operator = ( std::move( inOther ) );
+            }
+        
+
+        SimpleSmallVector & operator = ( SimpleSmallVector &&inOther ) {
+            SimpleVector<Type>::operator = ( std::move( inOther ) );
+            return *this;
+            }
+#endif
+        
+
+    protected:
+
+        // other members only there to align storage
+        union {
+                unsigned char bytes[ inlineSize * sizeof( Type ) ];
+                double alignDouble;
+                long alignLong;
+                void *alignPointer;
+            } mInlineStorage;
+    };
+
+
+
 
 
 #endif
@@ -33,76 +33,383 @@
 #ifdef DEBUG_MEMORY
 
 
+// before debugMemory.h redefines new
+#include <new>
+
 #include "minorGems/util/development/memory/MemoryTrack.h"
 
+#include "minorGems/system/atomicOps.h"
+
 #include <stdio.h>
 #include <stdlib.h>
-#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+
+
+// placement new for our locks, not tracked new
+#undef new
 
 
 
 int MemoryTrackStaticInitCounter::mCount = 0;
 
-MutexLock *MemoryTrack::mLock;
+AllocationShard *MemoryTrack::mShards = NULL;
+
+volatile char MemoryTrack::mTracking = false;
+
+
+
+// power of 2
+#define NUM_SHARDS 64
+
+#define INITIAL_SHARD_SIZE 1024
+
+// fixed, since sites are never removed
+// sites past 3/4 full are counted under one overflow site
+#define NUM_SITE_SLOTS 65536
+
+
+
+typedef struct {
+        void *mPointer;
+        size_t mAllocationSize;
+        AllocationSite *mSite;
+        int mAllocationType;
+    } AllocationRecord;
+
+
+
+// an open-addressed table of allocations, with linear probing
+struct AllocationShard {
+        MutexLock *mLock;
+
+        // power of 2, at most half full
+        unsigned int mSize;
+        unsigned int mNumRecords;
+        AllocationRecord *mRecords;
+        
+        unsigned long mNumberOfAllocations;
+        unsigned long mTotalAllocationSize;
+        unsigned long mTotalDeallocationSize;
+
+        // for checking on snapshot dumps every so often
+        unsigned int mAllocationsSinceDumpCheck;
+
+        // keep shards off each other's cache lines
+        char mPadding[64];
+    };
+
+
+
+static AllocationSite * volatile *sSiteSlots = NULL;
+static volatile int sNumSites = 0;
+
+static AllocationSite sOverflowSite = 
+    { "(too many allocation sites)", 0, 0, 0, 0, 0, 0 };
+
+
+static MutexLock *sDumpLock = NULL;
+static const char *sDumpFileName = NULL;
+static volatile long sNextDumpTime = 0;
+static int sDumpIntervalSeconds = 0;
+static MemorySnapshot *sLastDumpedSnapshot = NULL;
+
+
+
+// locks are made and destroyed without new and delete,
+// which we are tracking
+static MutexLock *newLock() {
+    void *memory = malloc( sizeof( MutexLock ) );
+    return new( memory ) MutexLock();
+    }
+
+
+static void deleteLock( MutexLock *inLock ) {
+    inLock->~MutexLock();
+    free( inLock );
+    }
+
+
+
+static inline unsigned int hashPointer( const void *inPointer ) {
+    // long is only 32 bits on Win64
+    uintptr_t value = (uintptr_t)inPointer;
+    
+    // allocations are aligned, so low bits carry little
+    value ^= value >> 16;
+    value *= 0x9E3779B1UL;
+    return (unsigned int)( value ^ ( value >> 15 ) );
+    }
+
+
+
+static inline AllocationShard *getShard( AllocationShard *inShards,
+                                         const void *inPointer ) {
+    // high hash bits for the shard, low bits for the slot
+    return &( inShards[ ( hashPointer( inPointer ) >> 26 ) & 
+                        ( NUM_SHARDS - 1 ) ] );
+    }
+
+
+
+// returns the slot holding inPointer, or the empty slot where it would go
+static AllocationRecord *findRecord( AllocationShard *inShard,
+                                     const void *inPointer ) {
+    unsigned int mask = inShard->mSize - 1;
+    unsigned int i = hashPointer( inPointer ) & mask;
+
+    while( true ) {
+        AllocationRecord *record = &( inShard->mRecords[i] );
+        
+        if( record->mPointer == inPointer || record->mPointer == NULL ) {
+            return record;
+            }
+        i = ( i + 1 ) & mask;
+        }
+    }
+
+
+
+static void growShard( AllocationShard *inShard ) {
+    AllocationRecord *oldRecords = inShard->mRecords;
+    unsigned int oldSize = inShard->mSize;
+    
+    inShard->mSize = oldSize * 2;
+    inShard->mRecords = 
+        (AllocationRecord *)calloc( inShard->mSize, 
+                                    sizeof( AllocationRecord ) );
+
+    for( unsigned int i=0; i<oldSize; i++ ) {
+        if( oldRecords[i].mPointer != NULL ) {
+            *( findRecord( inShard, oldRecords[i].mPointer ) ) = 
+                oldRecords[i];
+            }
+        }
+    free( oldRecords );
+    }
+
+
+
+// removes a record, moving later records in its probe run back
+// so that no tombstones are needed
+static void removeRecord( AllocationShard *inShard,
+                          AllocationRecord *inRecord ) {
+    unsigned int mask = inShard->mSize - 1;
+    unsigned int hole = inRecord - inShard->mRecords;
+    unsigned int i = hole;
+
+    while( true ) {
+        i = ( i + 1 ) & mask;
+
+        AllocationRecord *record = &( inShard->mRecords[i] );
+        
+        if( record->mPointer == NULL ) {
+            break;
+            }
+
+        unsigned int home = hashPointer( record->mPointer ) & mask;
+        
+        // can move back into the hole if its home slot is not
+        // between the hole and where it is now
+        char canMove;
+        if( hole <= i ) {
+            canMove = ( home <= hole || home > i );
+            }
+        else {
+            canMove = ( home <= hole && home > i );
+            }
+        
+        if( canMove ) {
+            inShard->mRecords[ hole ] = *record;
+            hole = i;
+            }
+        }
+    
+    inShard->mRecords[ hole ].mPointer = NULL;
+    inShard->mNumRecords--;
+    }
+
+
 
-AllocationList *MemoryTrack::mListHead;
+void MemoryTrack::startTracking() {
+    AllocationShard *shards = 
+        (AllocationShard *)calloc( NUM_SHARDS, sizeof( AllocationShard ) );
+    
+    for( int s=0; s<NUM_SHARDS; s++ ) {
+        shards[s].mLock = newLock();
+        shards[s].mSize = INITIAL_SHARD_SIZE;
+        shards[s].mRecords = 
+            (AllocationRecord *)calloc( INITIAL_SHARD_SIZE,
+                                        sizeof( AllocationRecord ) );
+        }
+
+    sSiteSlots = (AllocationSite * volatile *)
+        calloc( NUM_SITE_SLOTS, sizeof( AllocationSite * ) );
+    sNumSites = 0;
+
+    sDumpLock = newLock();
+
+    mShards = shards;
+    mTracking = true;
+    }
+
+
+
+void MemoryTrack::stopTracking() {
+    mTracking = false;
+
+    AllocationShard *shards = mShards;
+    mShards = NULL;
+    
+    for( int s=0; s<NUM_SHARDS; s++ ) {
+        deleteLock( shards[s].mLock );
+        free( shards[s].mRecords );
+        }
+    free( shards );
+
+    for( int i=0; i<NUM_SITE_SLOTS; i++ ) {
+        if( sSiteSlots[i] != NULL ) {
+            free( sSiteSlots[i] );
+            }
+        }
+    free( (void *)sSiteSlots );
+    sSiteSlots = NULL;
+
+    deleteLock( sDumpLock );
+    sDumpLock = NULL;
+
+    if( sLastDumpedSnapshot != NULL ) {
+        freeSnapshot( sLastDumpedSnapshot );
+        sLastDumpedSnapshot = NULL;
+        }
+    }
 
-char MemoryTrack::mTracking = false;
 
-int MemoryTrack::mTotalAllocationSize = 0;
-int MemoryTrack::mTotalDeallocationSize = 0;
-int MemoryTrack::mNumberOfAllocations = 0;
+
+AllocationSite *MemoryTrack::getSite( const char *inFileName,
+                                      int inLineNumber ) {
+    unsigned int i = 
+        ( hashPointer( inFileName ) ^ 
+          ( (unsigned int)inLineNumber * 0x9E3779B1U ) ) & 
+        ( NUM_SITE_SLOTS - 1 );
+
+    AllocationSite *newSite = NULL;
+    
+    while( true ) {
+        AllocationSite *site = atomicLoad( &( sSiteSlots[i] ) );
+
+        if( site == NULL ) {
+            // add it here, unless another thread beats us to it
+            
+            if( atomicLoad( &sNumSites ) >= NUM_SITE_SLOTS * 3 / 4 ) {
+                if( newSite != NULL ) {
+                    free( newSite );
+                    }
+                return &sOverflowSite;
+                }
+            
+            if( newSite == NULL ) {
+                newSite = 
+                    (AllocationSite *)calloc( 1, sizeof( AllocationSite ) );
+                newSite->mFileName = inFileName;
+                newSite->mLineNumber = inLineNumber;
+                }
+            
+            if( atomicCompareAndSwap( &( sSiteSlots[i] ),
+                                      (AllocationSite *)NULL, newSite ) ) {
+                atomicAdd( &sNumSites, 1 );
+                return newSite;
+                }
+
+            // slot taken, look at what took it
+            site = atomicLoad( &( sSiteSlots[i] ) );
+            }
+
+        if( site->mFileName == inFileName && 
+            site->mLineNumber == inLineNumber ) {
+            
+            if( newSite != NULL ) {
+                free( newSite );
+                }
+            return site;
+            }
+        
+        i = ( i + 1 ) & ( NUM_SITE_SLOTS - 1 );
+        }
+    }
 
 
 
 void MemoryTrack::addAllocation( void *inPointer,
-                                 unsigned int inAllocationSize,
+                                 size_t inAllocationSize,
                                  int inAllocationType,
                                  const char *inFileName,
                                  int inLineNumber ) {
 
-    mLock->lock();
-
     if( !mTracking ) {
-        printf( "Tracking off on allocation (0x%x) [%d bytes] %s:%d.\n",
-                (unsigned int)inPointer,
-                inAllocationSize,
+        printf( "Tracking off on allocation (%p) [%lu bytes] %s:%d.\n",
+                inPointer,
+                (unsigned long)inAllocationSize,
                 inFileName, inLineNumber );
-
-        mLock->unlock();
         return;
         }
     
 
-    // insert after head of list
-    AllocationList *element =
-        (AllocationList *)malloc( sizeof( AllocationList ) );
-    element->mPrevious = (void *)mListHead;
-    element->mNext = mListHead->mNext;
-
-    mListHead->mNext = (void *)element;
+    AllocationSite *site = getSite( inFileName, inLineNumber );
 
+    unsigned long live = 
+        atomicAdd( &( site->mLiveBytes ), 
+                   (unsigned long)inAllocationSize );
+    atomicAdd( &( site->mLiveCount ), 1UL );
+    atomicAdd( &( site->mTotalBytes ), (unsigned long)inAllocationSize );
+    atomicAdd( &( site->mTotalCount ), 1UL );
 
-    AllocationList *nextElement = (AllocationList *)( element->mNext );
-    if( nextElement != NULL ) {
-        nextElement->mPrevious = (void *)element;
+    unsigned long peak = site->mPeakBytes;
+    while( live > peak &&
+           ! atomicCompareAndSwap( &( site->mPeakBytes ), peak, live ) ) {
+        peak = site->mPeakBytes;
         }
     
-    element->mPointer = inPointer;
-    element->mAllocationSize = inAllocationSize;
-    element->mAllocationType = inAllocationType;
-    element->mFileName = inFileName;
-    element->mLineNumber = inLineNumber;
 
+    AllocationShard *shard = getShard( mShards, inPointer );
+    
+    shard->mLock->lock();
+
+    if( ( shard->mNumRecords + 1 ) * 2 > shard->mSize ) {
+        growShard( shard );
+        }
 
-    mTotalAllocationSize += inAllocationSize;
+    AllocationRecord *record = findRecord( shard, inPointer );
 
-    mNumberOfAllocations ++;
+    if( record->mPointer == NULL ) {
+        shard->mNumRecords++;
+        }
     
+    record->mPointer = inPointer;
+    record->mAllocationSize = inAllocationSize;
+    record->mAllocationType = inAllocationType;
+    record->mSite = site;
+
+    shard->mTotalAllocationSize += inAllocationSize;
+
+    shard->mNumberOfAllocations ++;
+
+    shard->mAllocationsSinceDumpCheck ++;
+
+    char checkDump = false;
+    if( shard->mAllocationsSinceDumpCheck >= 4096 ) {
+        shard->mAllocationsSinceDumpCheck = 0;
+        checkDump = true;
+        }
+
+    shard->mLock->unlock();
+
     // wipe this block of memory
     clearMemory( inPointer, inAllocationSize );
-    
-    mLock->unlock();
+
+    if( checkDump && sDumpFileName != NULL ) {
+        checkSnapshotDump();
+        }
     }
 
 
@@ -110,168 +417,467 @@ void MemoryTrack::addAllocation( void *inPointer,
 int MemoryTrack::addDeallocation( void *inPointer,
                                   int inDeallocationType ) {
 
-    mLock->lock();
-
     if( inPointer == NULL ) {
-        printf( "NULL pointer (0x%x) deallocated\n",
-                (unsigned int)inPointer );
+        printf( "NULL pointer (%p) deallocated\n", inPointer );
+        return 1;
         }
-
     
-    if( inPointer == (void *)mLock ) {
-        // we're seeing the deallocation of our own static lock as
-        // the system exits
-        // ignore it
-        mLock->unlock();
+    if( !mTracking ) {
+        printf( "Tracking off on deallocation (%p)\n", inPointer );
         return 0;
         }
+
     
-    if( !mTracking ) {
-        printf( "Tracking off on deallocation (0x%x)\n",
-                (unsigned int)inPointer );
-        mLock->unlock();
+    AllocationShard *shard = getShard( mShards, inPointer );
+    
+    shard->mLock->lock();
+
+    AllocationRecord *record = findRecord( shard, inPointer );
+
+    if( record->mPointer == NULL ) {
+        shard->mLock->unlock();
+
+        // not found (delete of unallocated memory)
+        printf( "Attempt to deallocate (%p) unallocated memory\n",
+                inPointer );
+        return 1;
+        }
+
+    size_t allocationSize = record->mAllocationSize;
+    int allocationType = record->mAllocationType;
+    AllocationSite *site = record->mSite;
+
+    // remove, whether or not types match
+    removeRecord( shard, record );
+            
+    shard->mTotalDeallocationSize += allocationSize;
+
+    shard->mLock->unlock();
+
+    atomicAdd( &( site->mLiveBytes ), - (unsigned long)allocationSize );
+    atomicAdd( &( site->mLiveCount ), - 1UL );
+    
+    
+    if( allocationType == inDeallocationType ) {
+        // found and types match
+
+        // wipe this block of memory
+        clearMemory( inPointer, allocationSize );
         return 0;
         }
+    else {
+        // allocation types don't match
+        
+        printf( "Attempt to deallocate (%p) [%lu bytes] with wrong"
+                " delete form\n"
+                "    %s:%d (location of original allocation)\n",
+                inPointer,
+                (unsigned long)allocationSize,
+                site->mFileName, site->mLineNumber );
+        
+        return 2;
+        }
+    }
+
+
+
+static int compareSiteLocations( const void *inA, const void *inB ) {
+    const AllocationSite *a = (const AllocationSite *)inA;
+    const AllocationSite *b = (const AllocationSite *)inB;
+
+    int result = strcmp( a->mFileName, b->mFileName );
+    if( result != 0 ) {
+        return result;
+        }
+    return a->mLineNumber - b->mLineNumber;
+    }
+
+
+
+static int compareSiteLiveBytes( const void *inA, const void *inB ) {
+    const AllocationSite *a = (const AllocationSite *)inA;
+    const AllocationSite *b = (const AllocationSite *)inB;
+
+    if( a->mLiveBytes != b->mLiveBytes ) {
+        return ( a->mLiveBytes > b->mLiveBytes ) ? -1 : 1;
+        }
+    return compareSiteLocations( inA, inB );
+    }
+
+
+
+MemorySnapshot *MemoryTrack::takeSnapshot() {
+    MemorySnapshot *snapshot = 
+        (MemorySnapshot *)malloc( sizeof( MemorySnapshot ) );
 
+    snapshot->mTime = time( NULL );
+    snapshot->mLiveCount = 0;
+    snapshot->mLiveBytes = 0;
+
+    int numSlotSites = atomicLoad( &sNumSites );
+    
+    // room for overflow site too
+    AllocationSite *sites = 
+        (AllocationSite *)malloc( ( numSlotSites + 2 ) * 
+                                  sizeof( AllocationSite ) );
+    int numSites = 0;
     
+    for( int i=0; i<NUM_SITE_SLOTS && numSites < numSlotSites; i++ ) {
+        AllocationSite *site = atomicLoad( &( sSiteSlots[i] ) );
+        if( site != NULL ) {
+            sites[ numSites++ ] = *site;
+            }
+        }
+    if( sOverflowSite.mTotalCount > 0 ) {
+        sites[ numSites++ ] = sOverflowSite;
+        }
 
-    AllocationList *element = (AllocationList *)( mListHead->mNext );
+    qsort( sites, numSites, sizeof( AllocationSite ), compareSiteLocations );
+
+    // a file name used in more than one source file (a header) can
+    // have a different string constant in each one, so merge these
+    // peaks of merged sites may not have been at the same time,
+    // so their sum is an upper bound
+    int numMerged = 0;
+    for( int i=0; i<numSites; i++ ) {
+        if( numMerged > 0 && 
+            compareSiteLocations( &( sites[ numMerged - 1 ] ),
+                                  &( sites[i] ) ) == 0 ) {
+            AllocationSite *merged = &( sites[ numMerged - 1 ] );
+            merged->mLiveCount += sites[i].mLiveCount;
+            merged->mLiveBytes += sites[i].mLiveBytes;
+            merged->mPeakBytes += sites[i].mPeakBytes;
+            merged->mTotalCount += sites[i].mTotalCount;
+            merged->mTotalBytes += sites[i].mTotalBytes;
+            }
+        else {
+            sites[ numMerged++ ] = sites[i];
+            }
+        }
 
-    while( element != NULL ) {
-        
-        void *pointer = element->mPointer;
+    for( int i=0; i<numMerged; i++ ) {
+        snapshot->mLiveCount += sites[i].mLiveCount;
+        snapshot->mLiveBytes += sites[i].mLiveBytes;
+        }
+
+    snapshot->mNumSites = numMerged;
+    snapshot->mSites = sites;
+
+    return snapshot;
+    }
+
+
+
+void MemoryTrack::freeSnapshot( MemorySnapshot *inSnapshot ) {
+    free( inSnapshot->mSites );
+    free( inSnapshot );
+    }
+
+
+
+void MemoryTrack::printSnapshot( MemorySnapshot *inSnapshot, FILE *inFile,
+                                 int inMaxSites ) {
+
+    fprintf( inFile, "%lu bytes live in %lu allocations from %d sites\n",
+             inSnapshot->mLiveBytes, inSnapshot->mLiveCount,
+             inSnapshot->mNumSites );
+
+    int numSites = inSnapshot->mNumSites;
+    
+    AllocationSite *sites = 
+        (AllocationSite *)malloc( ( numSites + 1 ) * 
+                                  sizeof( AllocationSite ) );
+    memcpy( sites, inSnapshot->mSites, numSites * sizeof( AllocationSite ) );
+
+    qsort( sites, numSites, sizeof( AllocationSite ), compareSiteLiveBytes );
+
+    int numPrinted = 0;
+    
+    for( int i=0; i<numSites && numPrinted < inMaxSites; i++ ) {
+        if( sites[i].mLiveCount == 0 ) {
+            continue;
+            }
+        numPrinted++;
         
-        if( pointer == inPointer ) {
+        fprintf( inFile, 
+                 "  %10lu bytes in %7lu live (peak %lu bytes, "
+                 "%lu ever)  %s:%d\n",
+                 sites[i].mLiveBytes, sites[i].mLiveCount,
+                 sites[i].mPeakBytes, sites[i].mTotalCount,
+                 sites[i].mFileName, sites[i].mLineNumber );
+        }
+    
+    free( sites );
+    }
 
-            unsigned int allocationSize = element->mAllocationSize;
-            int allocationType = element->mAllocationType;
-            const char *allocFileName = element->mFileName;            
-            int allocLineNumber = element->mLineNumber;
-            
-            // remove from list, whether or not types match
-            AllocationList *previousElement =
-                (AllocationList *)( element->mPrevious );
-            AllocationList *nextElement =
-                (AllocationList *)( element->mNext );
-            
-            // patch list
-            previousElement->mNext = (void *)( nextElement );
 
-            if( nextElement != NULL ) {
-                nextElement->mPrevious = (void *)( previousElement );
-                }
-            
-            free( element );
-            
-            mTotalDeallocationSize += allocationSize;
-            
-            
-            if( allocationType == inDeallocationType ) {
-                // found and types match
-                mLock->unlock();
 
-                // wipe this block of memory
-                clearMemory( inPointer, allocationSize );
-                return 0;
-                }
-            else {
-                // allocation types don't match
-                
-                printf( "Attempt to deallocate (0x%x) [%d bytes] with wrong"
-                        " delete form\n"
-                        "    %s:%d (location of original allocation)\n",
-                        (unsigned int)inPointer,
-                        allocationSize,
-                        allocFileName, allocLineNumber );
+typedef struct {
+        const AllocationSite *mSite;
+        long mByteChange;
+        long mCountChange;
+    } SiteChange;
 
-                mLock->unlock();
-                
-                return 2;
-                }
-            
+
+
+static int compareSiteChanges( const void *inA, const void *inB ) {
+    const SiteChange *a = (const SiteChange *)inA;
+    const SiteChange *b = (const SiteChange *)inB;
+
+    long sizeA = labs( a->mByteChange );
+    long sizeB = labs( b->mByteChange );
+
+    if( sizeA != sizeB ) {
+        return ( sizeA > sizeB ) ? -1 : 1;
+        }
+    return compareSiteLocations( a->mSite, b->mSite );
+    }
+
+
+
+void MemoryTrack::printSnapshotDiff( MemorySnapshot *inOld,
+                                     MemorySnapshot *inNew,
+                                     FILE *inFile,
+                                     int inMaxSites ) {
+
+    fprintf( inFile, "%+ld bytes, %+ld allocations live over %ld seconds\n",
+             (long)( inNew->mLiveBytes - inOld->mLiveBytes ),
+             (long)( inNew->mLiveCount - inOld->mLiveCount ),
+             (long)( inNew->mTime - inOld->mTime ) );
+
+    SiteChange *changes = 
+        (SiteChange *)malloc( ( inOld->mNumSites + inNew->mNumSites + 1 ) *
+                              sizeof( SiteChange ) );
+    int numChanges = 0;
+
+    // both sorted by location, so walk them together
+    int o = 0;
+    int n = 0;
+
+    while( o < inOld->mNumSites || n < inNew->mNumSites ) {
+        int compare;
+        if( o == inOld->mNumSites ) {
+            compare = 1;
+            }
+        else if( n == inNew->mNumSites ) {
+            compare = -1;
+            }
+        else {
+            compare = compareSiteLocations( &( inOld->mSites[o] ),
+                                            &( inNew->mSites[n] ) );
+            }
+        
+        SiteChange change;
+        
+        if( compare < 0 ) {
+            // gone from new snapshot (can't happen, sites are kept)
+            change.mSite = &( inOld->mSites[o] );
+            change.mByteChange = - (long)inOld->mSites[o].mLiveBytes;
+            change.mCountChange = - (long)inOld->mSites[o].mLiveCount;
+            o++;
+            }
+        else if( compare > 0 ) {
+            change.mSite = &( inNew->mSites[n] );
+            change.mByteChange = (long)inNew->mSites[n].mLiveBytes;
+            change.mCountChange = (long)inNew->mSites[n].mLiveCount;
+            n++;
+            }
+        else {
+            change.mSite = &( inNew->mSites[n] );
+            change.mByteChange = 
+                (long)( inNew->mSites[n].mLiveBytes - 
+                        inOld->mSites[o].mLiveBytes );
+            change.mCountChange = 
+                (long)( inNew->mSites[n].mLiveCount - 
+                        inOld->mSites[o].mLiveCount );
+            o++;
+            n++;
             }
 
-        element = (AllocationList *)( element->mNext );
+        if( change.mByteChange != 0 || change.mCountChange != 0 ) {
+            changes[ numChanges++ ] = change;
+            }
         }
 
-    // not found (delete of unallocated memory)
-    printf( "Attempt to deallocate (0x%x) unallocated memory\n",
-            (unsigned int)inPointer );
+    qsort( changes, numChanges, sizeof( SiteChange ), compareSiteChanges );
+
+    for( int i=0; i<numChanges && i<inMaxSites; i++ ) {
+        fprintf( inFile, "  %+11ld bytes %+8ld live  %s:%d\n",
+                 changes[i].mByteChange, changes[i].mCountChange,
+                 changes[i].mSite->mFileName,
+                 changes[i].mSite->mLineNumber );
+        }
+
+    free( changes );
+    }
+
+
+
+void MemoryTrack::dumpSnapshot( const char *inFileName ) {
+    if( !mTracking ) {
+        return;
+        }
+    
+    MemorySnapshot *snapshot = takeSnapshot();
+
+    sDumpLock->lock();
+    
+    FILE *file = fopen( inFileName, "a" );
+
+    if( file != NULL ) {
+        fprintf( file, "---- debugMemory snapshot %s", 
+                 ctime( &( snapshot->mTime ) ) );
+
+        printSnapshot( snapshot, file );
+
+        if( sLastDumpedSnapshot != NULL ) {
+            fprintf( file, "Changes since last snapshot:\n" );
+            printSnapshotDiff( sLastDumpedSnapshot, snapshot, file );
+            }
+        fprintf( file, "\n" );
+        
+        fclose( file );
+        }
+    else {
+        printf( "Failed to open memory snapshot file %s\n", inFileName );
+        }
+    
+    if( sLastDumpedSnapshot != NULL ) {
+        freeSnapshot( sLastDumpedSnapshot );
+        }
+    sLastDumpedSnapshot = snapshot;
+
+    sDumpLock->unlock();
+    }
+
+
+
+void MemoryTrack::setSnapshotDumps( const char *inFileName,
+                                    int inIntervalSeconds ) {
+    sDumpLock->lock();
+    
+    sDumpIntervalSeconds = inIntervalSeconds;
+    atomicStore( &sNextDumpTime, (long)time( NULL ) + inIntervalSeconds );
+    sDumpFileName = inFileName;
+
+    sDumpLock->unlock();
+    }
+
+
+
+void MemoryTrack::checkSnapshotDump() {
+    long now = (long)time( NULL );
+    long due = atomicLoad( &sNextDumpTime );
 
-    mLock->unlock();
+    if( now < due ) {
+        return;
+        }
     
-    return 1;
+    // only one thread gets to dump
+    if( ! atomicCompareAndSwap( &sNextDumpTime, due, 
+                                now + sDumpIntervalSeconds ) ) {
+        return;
+        }
+
+    const char *fileName = sDumpFileName;
+    if( fileName != NULL ) {
+        dumpSnapshot( fileName );
+        }
     }
 
 
 
 void MemoryTrack::printLeaks() {
-    mLock->lock();
+
+    unsigned long numberOfAllocations = 0;
+    unsigned long totalAllocationSize = 0;
+    unsigned long totalDeallocationSize = 0;
+    
+    for( int s=0; s<NUM_SHARDS; s++ ) {
+        mShards[s].mLock->lock();
+        numberOfAllocations += mShards[s].mNumberOfAllocations;
+        totalAllocationSize += mShards[s].mTotalAllocationSize;
+        totalDeallocationSize += mShards[s].mTotalDeallocationSize;
+        mShards[s].mLock->unlock();
+        }
 
     printf( "\n\n---- debugMemory report ----\n" );
     
-    printf( "Number of Allocations:  %d\n", mNumberOfAllocations );
-    printf( "Total allocations:      %d bytes\n", mTotalAllocationSize );
-    printf( "Total deallocations:    %d bytes\n", mTotalDeallocationSize );
+    printf( "Number of Allocations:  %lu\n", numberOfAllocations );
+    printf( "Total allocations:      %lu bytes\n", totalAllocationSize );
+    printf( "Total deallocations:    %lu bytes\n", totalDeallocationSize );
     
-    int leakEstimate = mTotalAllocationSize - mTotalDeallocationSize;
+    unsigned long leakEstimate = totalAllocationSize - totalDeallocationSize;
 
 
+    MemorySnapshot *snapshot = takeSnapshot();
     
-    AllocationList *element = (AllocationList *)( mListHead->mNext );
-
-    if( element == NULL ) {
+    if( snapshot->mLiveCount == 0 ) {
         printf( "No leaks detected.\n" );
         }
     else {
         printf( "Leaks detected:\n" );
+
+        // every site, totaled
+        printSnapshot( snapshot, stdout, snapshot->mNumSites );
         }
 
-    int leakSum = 0;
-    while( element != NULL ) {
     
-        printf( "Not deallocated (0x%x) [%d bytes]\n"
-                "    %s:%d (location of original allocation)\n",
-                (unsigned int)( element->mPointer ),
-                element->mAllocationSize,
-                element->mFileName,
-                element->mLineNumber );
+    // each leak, unless there are too many to read
+    unsigned long leakSum = 0;
+    unsigned long numLeaks = 0;
+    
+    for( int s=0; s<NUM_SHARDS; s++ ) {
+        AllocationShard *shard = &( mShards[s] );
+        
+        shard->mLock->lock();
 
-        leakSum += element->mAllocationSize;
+        for( unsigned int i=0; i<shard->mSize; i++ ) {
+            AllocationRecord *record = &( shard->mRecords[i] );
+
+            if( record->mPointer == NULL ) {
+                continue;
+                }
+
+            if( snapshot->mLiveCount <= 1000 ) {
+                printf( "Not deallocated (%p) [%lu bytes]\n"
+                        "    %s:%d (location of original allocation)\n",
+                        record->mPointer,
+                        (unsigned long)record->mAllocationSize,
+                        record->mSite->mFileName,
+                        record->mSite->mLineNumber );
+                }
+            
+            leakSum += record->mAllocationSize;
+            numLeaks++;
+            }
         
-        element = (AllocationList *)( element->mNext );
+        shard->mLock->unlock();
         }
 
+    if( numLeaks > 1000 ) {
+        printf( "(%lu leaks not listed individually)\n", numLeaks );
+        }
+
+    freeSnapshot( snapshot );
+
     
     if( leakSum != leakEstimate ) {
         printf( "Warning:  Leak sum does not equal leak estimate.\n" );
         }
 
     
-    printf( "Leaked memory:          %d bytes\n", leakSum );
+    printf( "Leaked memory:          %lu bytes\n", leakSum );
     
     printf( "---- END debugMemory report ----\n\n" );
-
-    
-    mLock->unlock();
     }
 
 
 
-void MemoryTrack::clearMemory( void *inPointer, unsigned int inSize ) {
-
-    unsigned char *charArray = (unsigned char *)inPointer;
-
-    for( unsigned int i=0; i<inSize; i++ ) {
-        charArray[i] = (unsigned char)0xAA;
-        }
-
+void MemoryTrack::clearMemory( void *inPointer, size_t inSize ) {
+    memset( inPointer, 0xAA, inSize );
     }
 
 
 
 #endif
-
-
-
-
@@ -30,6 +30,7 @@
 #include "minorGems/system/MutexLock.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 
 
 #define SINGLE_ALLOCATION  0
@@ -38,28 +39,62 @@
 
 
 /**
- * Linked list of memory allocations.
+ * Totals for the allocations made at one place in the source.
  *
  * @author Jason Rohrer
  */
 typedef struct {
         
-        void *mPrevious;
-        void *mNext;
-
-        void *mPointer;
-        unsigned int mAllocationSize;
-        int mAllocationType;
         const char *mFileName;
         int mLineNumber;
+
+        // allocations not yet deallocated
+        unsigned long mLiveCount;
+        unsigned long mLiveBytes;
+
+        // most live bytes at any one time
+        unsigned long mPeakBytes;
+
+        // all allocations ever made here
+        unsigned long mTotalCount;
+        unsigned long mTotalBytes;
+        
+    } AllocationSite;
+
+
+
+/**
+ * Allocation sites at one moment, sorted by file name and line.
+ *
+ * @author Jason Rohrer
+ */
+typedef struct {
+
+        time_t mTime;
+
+        unsigned long mLiveCount;
+        unsigned long mLiveBytes;
+
+        int mNumSites;
+        AllocationSite *mSites;
         
-    } AllocationList;
+    } MemorySnapshot;
+
+
+
+// internally used
+typedef struct AllocationShard AllocationShard;
 
 
 
 /**
  * Class that tracks memory allocations and deallocations.
  *
+ * Allocations are kept in hash tables, split into shards by pointer,
+ * each with its own lock, so tracking costs about the same no matter
+ * how many allocations are live, and threads rarely wait on each other.
+ * Totals for each allocation site are updated without locks.
+ *
  * @author Jason Rohrer
  */
 class MemoryTrack {
@@ -79,12 +114,13 @@ class MemoryTrack {
          *   either SINGLE_ALLOCATION or ARRAY_ALLOCATION.
          * @param inAllocationSize the size of the allocation in bytes.
          * @param inFileName the name of the source file in which the
-         *   allocation took place.
+         *   allocation took place.  Must be a string constant, like
+         *   __FILE__.
          * @param inLineNumber the line number in the source file
          *   on which the allocation took place.
          */
         static void addAllocation( void *inPointer,
-                                   unsigned int inAllocationSize,
+                                   size_t inAllocationSize,
                                    int inAllocationType,
                                    const char *inFileName,
                                    int inLineNumber );
@@ -112,31 +148,87 @@ class MemoryTrack {
 
         /**
          * Prints a list of all memory leaks (allocations that have never
-         * been deallocated).
+         * been deallocated), totaled by allocation site.
          */
         static void printLeaks();
+
+
+
+        /**
+         * Gets the current totals for each allocation site.
+         *
+         * @return the snapshot.  Must be destroyed with freeSnapshot.
+         */
+        static MemorySnapshot *takeSnapshot();
+
+        static void freeSnapshot( MemorySnapshot *inSnapshot );
+
+
+
+        /**
+         * Prints the sites with the most live bytes.
+         *
+         * @param inSnapshot the snapshot to print.  Destroyed by caller.
+         * @param inFile the file to print to, like stdout.
+         * @param inMaxSites how many sites to print.
+         */
+        static void printSnapshot( MemorySnapshot *inSnapshot, FILE *inFile,
+                                   int inMaxSites = 20 );
+
         
 
+        /**
+         * Prints the sites whose live bytes changed the most between
+         * two snapshots.
+         *
+         * @param inOld, inNew the snapshots to compare.  Destroyed by
+         *   caller.
+         * @param inFile the file to print to, like stdout.
+         * @param inMaxSites how many sites to print.
+         */
+        static void printSnapshotDiff( MemorySnapshot *inOld,
+                                       MemorySnapshot *inNew,
+                                       FILE *inFile,
+                                       int inMaxSites = 20 );
+
+
         
-        // these are public so initializer can get to them
+        /**
+         * Appends a snapshot, and how it differs from the last one
+         * dumped, to a file.
+         *
+         * @param inFileName the file to append to.  Destroyed by caller.
+         */
+        static void dumpSnapshot( const char *inFileName );
 
-        static MutexLock *mLock;
 
-        // dummy place holder for list head
-        static AllocationList *mListHead;
+        
+        /**
+         * Dumps a snapshot every so often, checked as allocations happen.
+         *
+         * @param inFileName the file to append to, or NULL to stop
+         *   dumping.  Must be a string constant.
+         * @param inIntervalSeconds how often to dump.
+         */
+        static void setSnapshotDumps( const char *inFileName,
+                                      int inIntervalSeconds );
+        
 
-        // true if we're tracking
-        static char mTracking;
         
-        static int mTotalAllocationSize;
+        // these are public so initializer can get to them
 
-        static int mTotalDeallocationSize;
+        static void startTracking();
 
-        static int mNumberOfAllocations;
+        static void stopTracking();
         
     protected:
 
 
+        static AllocationShard *mShards;
+        
+        // true if we're tracking
+        static volatile char mTracking;
+
         
         /**
          * Clears memory so that reading from it will not produce
@@ -146,9 +238,15 @@ class MemoryTrack {
          * @param inPointer pointer to the memory to clear.
          * @Param inSize the number of bytes to clear starting at inPointer.
          */
-        static void clearMemory( void *inPointer, unsigned int inSize );
+        static void clearMemory( void *inPointer, size_t inSize );
 
 
+        // finds or adds the site for a file and line
+        static AllocationSite *getSite( const char *inFileName,
+                                        int inLineNumber );
+
+        // dumps a snapshot if one is due
+        static void checkSnapshotDump();
         
     };
 
@@ -176,20 +274,7 @@ class MemoryTrackStaticInitCounter {
         
         MemoryTrackStaticInitCounter() {
             if( mCount == 0 ) {
-                // allocate static members
-                MemoryTrack::mLock = new MutexLock();
-
-                MemoryTrack::mListHead =
-                    (AllocationList *)
-                        malloc( sizeof( AllocationList ) );
-                MemoryTrack::mListHead->mPrevious = NULL;
-                MemoryTrack::mListHead->mNext = NULL;
-
-                MemoryTrack::mTotalAllocationSize = 0;
-                MemoryTrack::mTotalDeallocationSize = 0;
-                MemoryTrack::mNumberOfAllocations = 0;
-                
-                MemoryTrack::mTracking = true;
+                MemoryTrack::startTracking();
                 }
             mCount++;
             }
@@ -204,10 +289,7 @@ class MemoryTrackStaticInitCounter {
                 // have been destroyed.
                 MemoryTrack::printLeaks();
 
-                MemoryTrack::mTracking = false;
-                // deallocate static members
-                free( MemoryTrack::mListHead );
-                delete MemoryTrack::mLock;
+                MemoryTrack::stopTracking();
                 }
             }
 
@@ -226,5 +308,3 @@ static MemoryTrackStaticInitCounter memoryTrackInitializer;
 
 
 #endif
-
-
@@ -32,7 +32,7 @@
 
 
 
-void *debugMemoryNew( unsigned int inSize,
+void *debugMemoryNew( size_t inSize,
                       const char *inFileName, int inLine ) {
 
     
@@ -47,10 +47,10 @@ void *debugMemoryNew( unsigned int inSize,
 
 
 
-void *debugMemoryNewArray( unsigned int inSize,
+void *debugMemoryNewArray( size_t inSize,
                            const char *inFileName, int inLine ) {
 
-    unsigned int mallocSize = inSize;
+    size_t mallocSize = inSize;
     if( inSize == 0 ) {
         // always allocate at least one byte to circumvent differences
         // between malloc and new[] on some platforms
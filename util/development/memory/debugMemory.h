@@ -22,13 +22,15 @@
 
 #include "minorGems/util/development/memory/MemoryTrack.h"
 
+#include <stddef.h>
+
 
 
 // internal function prototypes
-void *debugMemoryNew( unsigned int inSize,
+void *debugMemoryNew( size_t inSize,
                       const char *inFileName, int inLine );
 
-void *debugMemoryNewArray( unsigned int inSize,
+void *debugMemoryNewArray( size_t inSize,
                            const char *inFileName, int inLine );
 
 void debugMemoryDelete( void *inPointer );
@@ -49,7 +51,7 @@ void debugMemoryDeleteArray( void *inPointer );
  *   occurred.
  * @param inLine the line in the source file where the allocation occurred.
  */
-inline void *operator new( unsigned int inSize,
+inline void *operator new( size_t inSize,
                            const char *inFileName, int inLine ) {
     return debugMemoryNew( inSize, inFileName, inLine );
     }
@@ -64,7 +66,7 @@ inline void *operator new( unsigned int inSize,
  *   occurred.
  * @param inLine the line in the source file where the allocation occurred.
  */
-inline void * operator new [] ( unsigned int inSize,
+inline void * operator new [] ( size_t inSize,
                                 const char *inFileName, int inLine ) {
 
     return debugMemoryNewArray( inSize, inFileName, inLine );
@@ -95,6 +97,23 @@ inline void operator delete [] ( void *inPointer ) {
 
 
 
+#ifdef __cpp_sized_deallocation
+
+// C++14 compilers call these instead when the size is known
+
+inline void operator delete( void *inPointer, size_t inSize ) {
+    debugMemoryDelete( inPointer );
+    }
+
+
+inline void operator delete [] ( void *inPointer, size_t inSize ) {
+    debugMemoryDeleteArray( inPointer );
+    }
+
+#endif
+
+
+
 #endif
 
 
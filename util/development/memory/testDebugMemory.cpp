@@ -18,6 +18,7 @@
 
 
 #include <stdio.h>
+#include <time.h>
 
 
 class TestClass {
@@ -77,6 +78,69 @@ int main() {
 
     int *badPointer2 = NULL;
     delete [] badPointer2;
+
+
+#ifdef DEBUG_MEMORY
+
+    // many live allocations, freed in scattered order
+    int numBlocks = 200000;
+    
+    char **blocks = (char **)malloc( numBlocks * sizeof( char * ) );
+
+    MemorySnapshot *before = MemoryTrack::takeSnapshot();
+
+    clock_t startTime = clock();
+    
+    for( int i=0; i<numBlocks; i++ ) {
+        if( i % 2 == 0 ) {
+            blocks[i] = new char[ 16 ];
+            }
+        else {
+            blocks[i] = new char[ 100 ];
+            }
+        }
+
+    MemorySnapshot *peak = MemoryTrack::takeSnapshot();
+    
+    for( int i=0; i<numBlocks; i++ ) {
+        int j = (int)( ( i * 7919L ) % numBlocks );
+        
+        // keep one in 1000 of the big ones
+        if( j % 2 == 1 && j % 1000 == 1 ) {
+            continue;
+            }
+        delete [] blocks[j];
+        }
+
+    double seconds = (double)( clock() - startTime ) / CLOCKS_PER_SEC;
+    
+    printf( "\n%d allocations and deallocations in %.3f s\n\n",
+            numBlocks, seconds );
+
+    MemorySnapshot *after = MemoryTrack::takeSnapshot();
+
+    printf( "At peak:\n" );
+    MemoryTrack::printSnapshot( peak, stdout );
+    
+    printf( "\nAfter freeing:\n" );
+    MemoryTrack::printSnapshot( after, stdout );
+
+    printf( "\nChanges:\n" );
+    MemoryTrack::printSnapshotDiff( before, after, stdout );
+
+    MemoryTrack::freeSnapshot( before );
+    MemoryTrack::freeSnapshot( peak );
+    MemoryTrack::freeSnapshot( after );
+
+    for( int j=1; j<numBlocks; j+=1000 ) {
+        delete [] blocks[j];
+        }
+    free( blocks );
+
+    MemoryTrack::dumpSnapshot( "testDebugMemorySnapshots.txt" );
+    printf( "\nSnapshot appended to testDebugMemorySnapshots.txt\n" );
+
+#endif
     
     return 0;
     }
@@ -4,6 +4,7 @@
 #include <signal.h>
 #include <fcntl.h>
 #include <sys/prctl.h>
+#include <sys/wait.h>
 
 #include <time.h>
 
@@ -20,6 +21,16 @@ static void usage() {
             "[detatch_sec]\n\n" );
     printf( "detatch_sec is the (optional) number of seconds before detatching and\n"
             "ending profiling (or -1 to stay attached forever, default)\n\n" );
+    printf( "In-process sampling, without gdb:\n\n"
+            "    wallClockProfiler -wall samples_per_sec ./myProgram [args]\n"
+            "    wallClockProfiler -cpu samples_per_sec ./myProgram [args]\n\n" );
+    printf( "-wall samples the main thread whether it is running or blocked,\n"
+            "-cpu samples whichever thread is using the CPU.  Both load\n"
+            "libwallClockSampler.so from wallClockProfiler's directory into\n"
+            "the program, and can take thousands of samples per second.\n"
+            "The program should be built with -g.\n\n" );
+    printf( "All modes also write stacks to wcFolded.txt in the folded format\n"
+            "read by flamegraph.pl\n\n" );
     
     exit( 1 );
     }
@@ -304,8 +315,680 @@ static void logGDBStackResponse() {
 
 
 
+static int compareStackCounts( const void *inA, const void *inB ) {
+    Stack *a = *( (Stack **)inA );
+    Stack *b = *( (Stack **)inB );
+    
+    // most sampled first
+    return b->sampleCount - a->sampleCount;
+    }
+
+
+
+// writes stacks as "outer;...;inner count" lines for flamegraph.pl
+static void writeFoldedStack( FILE *inFile, Stack *inStack ) {
+    for( int j=inStack->frames.size() - 1; j>=0; j-- ) {
+        const char *name = inStack->frames.getElement( j )->funcName;
+        
+        if( name[0] == '\0' ) {
+            name = "??";
+            }
+        
+        for( int c=0; name[c] != '\0'; c++ ) {
+            // separators can't appear in names
+            if( name[c] == ';' || name[c] == '\n' ) {
+                fputc( ':', inFile );
+                }
+            else {
+                fputc( name[c], inFile );
+                }
+            }
+        
+        if( j > 0 ) {
+            fputc( ';', inFile );
+            }
+        }
+    fprintf( inFile, " %d\n", inStack->sampleCount );
+    }
+
+
+
+// prints report of stacks in stackLog, most sampled first, and
+// writes them to wcFolded.txt, clearing stackLog
+static void printReport( int inNumSamples ) {
+    
+    int numStacks = stackLog.size();
+    
+    Stack **sortedStacks = new Stack*[ numStacks ];
+    
+    for( int i=0; i<numStacks; i++ ) {
+        sortedStacks[i] = stackLog.getElement( i );
+        }
+    
+    qsort( sortedStacks, numStacks, sizeof( Stack * ), compareStackCounts );
+    
+    
+    FILE *foldedFile = fopen( "wcFolded.txt", "w" );
+    
+    printf( "\n\n\nReport:\n\n" );
+    
+    for( int i=0; i<numStacks; i++ ) {
+        Stack *s = sortedStacks[i];
+
+        if( s->frames.size() == 0 ) {
+            continue;
+            }
+        
+        printf( "%6.3f%% =====================================\n"
+                "      %3d: %s   (at %s:%d)\n", 
+                100 * s->sampleCount / (float )inNumSamples,
+                1,
+                s->frames.getElement( 0 )->funcName, 
+                s->frames.getElement( 0 )->fileName, 
+                s->frames.getElement( 0 )->lineNum );
+        // print stack for context below
+        for( int j=1; j<s->frames.size(); j++ ) {
+            StackFrame f = s->frames.getElementDirect( j );
+            printf( "      %3d: %s   (at %s:%d)\n", 
+                    j + 1,
+                    f.funcName, 
+                    f.fileName, 
+                    f.lineNum );
+            }
+        printf( "\n\n" );
+
+        if( foldedFile != NULL ) {
+            writeFoldedStack( foldedFile, s );
+            }
+        }
+    
+    if( foldedFile != NULL ) {
+        fclose( foldedFile );
+        printf( "Folded stacks for flamegraph.pl written to wcFolded.txt\n" );
+        }
+    
+    delete [] sortedStacks;
+    
+    for( int i=0; i<numStacks; i++ ) {
+        freeStack( stackLog.getElement( i ) );
+        }
+    stackLog.deleteAll();
+    }
+
+
+
+
+
+// In-process sampling
+
+// an executable mapping from the target's /proc/self/maps
+typedef struct CodeMapping {
+        unsigned long start;
+        unsigned long end;
+        unsigned long offset;
+        char *path;
+    } CodeMapping;
+
+
+
+// a sampled address and where it is in the source
+typedef struct AddressInfo {
+        unsigned long address;
+        char *funcName;
+        char *fileName;
+        int lineNum;
+        // same for all addresses at the same source location
+        int locationID;
+        // in libwallClockSampler.so's wrappers, left out of stacks
+        char inSampler;
+    } AddressInfo;
+
+
+
+static int compareAddresses( const void *inA, const void *inB ) {
+    unsigned long a = *( (unsigned long *)inA );
+    unsigned long b = *( (unsigned long *)inB );
+    
+    if( a < b ) {
+        return -1;
+        }
+    if( a > b ) {
+        return 1;
+        }
+    return 0;
+    }
+
+
+
+static int compareLocations( const void *inA, const void *inB ) {
+    AddressInfo *a = *( (AddressInfo **)inA );
+    AddressInfo *b = *( (AddressInfo **)inB );
+    
+    int c = strcmp( a->funcName, b->funcName );
+    if( c != 0 ) {
+        return c;
+        }
+    c = strcmp( a->fileName, b->fileName );
+    if( c != 0 ) {
+        return c;
+        }
+    return a->lineNum - b->lineNum;
+    }
+
+
+
+// samples as lists of location IDs, used by compareSamples
+static int *sampleLocations;
+static int *sampleStarts;
+static int *sampleDepths;
+
+
+static int compareSamples( const void *inA, const void *inB ) {
+    int a = *( (int *)inA );
+    int b = *( (int *)inB );
+    
+    if( sampleDepths[a] != sampleDepths[b] ) {
+        return sampleDepths[a] - sampleDepths[b];
+        }
+    for( int i=0; i<sampleDepths[a]; i++ ) {
+        int locA = sampleLocations[ sampleStarts[a] + i ];
+        int locB = sampleLocations[ sampleStarts[b] + i ];
+        
+        if( locA != locB ) {
+            return locA - locB;
+            }
+        }
+    return 0;
+    }
+
+
+
+static AddressInfo *findAddress( AddressInfo *inInfo, int inNumInfo,
+                                 unsigned long inAddress ) {
+    int low = 0;
+    int high = inNumInfo - 1;
+    
+    while( low <= high ) {
+        int mid = ( low + high ) / 2;
+        
+        if( inInfo[mid].address < inAddress ) {
+            low = mid + 1;
+            }
+        else if( inInfo[mid].address > inAddress ) {
+            high = mid - 1;
+            }
+        else {
+            return &( inInfo[mid] );
+            }
+        }
+    return NULL;
+    }
+
+
+
+// address that addr2line expects for a run-time address in a mapping
+static unsigned long getFileAddress( CodeMapping *inMapping,
+                                     SimpleVector<CodeMapping> *inAllMappings,
+                                     unsigned long inAddress ) {
+    
+    // executables that aren't position-independent load where they say
+    FILE *file = fopen( inMapping->path, "rb" );
+    
+    if( file != NULL ) {
+        unsigned char header[18];
+        int numRead = fread( header, 1, 18, file );
+        fclose( file );
+        
+        // e_type of ET_EXEC
+        if( numRead == 18 && header[16] == 2 && header[17] == 0 ) {
+            return inAddress;
+            }
+        }
+    
+    // others relative to where the start of the file is mapped
+    for( int i=0; i<inAllMappings->size(); i++ ) {
+        CodeMapping *m = inAllMappings->getElement( i );
+        
+        if( m->offset == 0 && strcmp( m->path, inMapping->path ) == 0 ) {
+            return inAddress - m->start;
+            }
+        }
+    
+    return inAddress - inMapping->start + inMapping->offset;
+    }
+
+
+
+// fills in names for addresses in one mapping with addr2line
+static void symbolizeMapping( CodeMapping *inMapping,
+                              SimpleVector<CodeMapping> *inAllMappings,
+                              AddressInfo *inInfo, int inNumInfo ) {
+    
+    char addressFileName[] = "/tmp/wcAddressesXXXXXX";
+    
+    int addressFD = mkstemp( addressFileName );
+    
+    if( addressFD == -1 ) {
+        return;
+        }
+    
+    FILE *addressFile = fdopen( addressFD, "w" );
+    
+    SimpleVector<AddressInfo *> mappedInfo;
+    
+    const char *samplerName = "/libwallClockSampler.so";
+    int nameStart = strlen( inMapping->path ) - strlen( samplerName );
+    
+    char isSampler = 
+        nameStart >= 0 && 
+        strcmp( &( inMapping->path[ nameStart ] ), samplerName ) == 0;
+    
+    for( int i=0; i<inNumInfo; i++ ) {
+        if( inInfo[i].address >= inMapping->start &&
+            inInfo[i].address < inMapping->end ) {
+            
+            inInfo[i].inSampler = isSampler;
+            
+            fprintf( addressFile, "%lx\n",
+                     getFileAddress( inMapping, inAllMappings,
+                                     inInfo[i].address ) );
+            mappedInfo.push_back( &( inInfo[i] ) );
+            }
+        }
+    fclose( addressFile );
+    
+    
+    if( mappedInfo.size() > 0 ) {
+        char *command = autoSprintf( "addr2line -f -C -e '%s' < %s",
+                                     inMapping->path, addressFileName );
+        
+        FILE *namePipe = popen( command, "r" );
+        
+        delete [] command;
+        
+        if( namePipe != NULL ) {
+            char funcLine[2048];
+            char fileLine[2048];
+            
+            for( int i=0; i<mappedInfo.size(); i++ ) {
+                if( fgets( funcLine, sizeof( funcLine ), namePipe ) == NULL ||
+                    fgets( fileLine, sizeof( fileLine ), namePipe ) == NULL ) {
+                    break;
+                    }
+                
+                AddressInfo *info = mappedInfo.getElementDirect( i );
+                
+                char *end = strchr( funcLine, '\n' );
+                if( end != NULL ) {
+                    end[0] = '\0';
+                    }
+                
+                // fileName:lineNum, maybe followed by (discriminator N)
+                end = strstr( fileLine, " (" );
+                if( end == NULL ) {
+                    end = strchr( fileLine, '\n' );
+                    }
+                if( end != NULL ) {
+                    end[0] = '\0';
+                    }
+                
+                char *colon = strrchr( fileLine, ':' );
+                if( colon != NULL ) {
+                    colon[0] = '\0';
+                    sscanf( &( colon[1] ), "%d", &( info->lineNum ) );
+                    }
+                
+                if( strcmp( funcLine, "??" ) != 0 ) {
+                    delete [] info->funcName;
+                    info->funcName = stringDuplicate( funcLine );
+                    }
+                if( strcmp( fileLine, "??" ) != 0 ) {
+                    delete [] info->fileName;
+                    info->fileName = stringDuplicate( fileLine );
+                    }
+                }
+            pclose( namePipe );
+            }
+        }
+    
+    remove( addressFileName );
+    }
+
+
+
+// reads samples written by libwallClockSampler.so into stackLog
+// returns number of samples
+static int readSampleFile( const char *inFileName ) {
+    FILE *file = fopen( inFileName, "r" );
+    
+    if( file == NULL ) {
+        printf( "Failed to open sample file %s\n", inFileName );
+        return 0;
+        }
+    
+    // frames of all samples, one after another
+    SimpleVector<unsigned long> frames;
+    SimpleVector<int> starts;
+    SimpleVector<int> depths;
+    
+    SimpleVector<CodeMapping> mappings;
+    
+    unsigned long numDropped = 0;
+    
+    char line[4096];
+    
+    while( fgets( line, sizeof( line ), file ) != NULL ) {
+        
+        if( line[0] == 'S' && line[1] == ' ' ) {
+            char *next = &( line[2] );
+            int depth = (int)strtol( next, &next, 10 );
+            
+            starts.push_back( frames.size() );
+            
+            int numRead = 0;
+            for( int i=0; i<depth; i++ ) {
+                unsigned long address = strtoul( next, &next, 16 );
+                
+                // return addresses point after the call, so look up
+                // the call itself
+                if( i > 0 ) {
+                    address--;
+                    }
+                frames.push_back( address );
+                numRead++;
+                }
+            depths.push_back( numRead );
+            }
+        else if( strcmp( line, "maps\n" ) == 0 ) {
+            // later maps replace earlier ones
+            for( int i=0; i<mappings.size(); i++ ) {
+                delete [] mappings.getElementDirect( i ).path;
+                }
+            mappings.deleteAll();
+            }
+        else if( line[0] == 'M' && line[1] == ' ' ) {
+            CodeMapping m;
+            char perms[5];
+            char path[2048];
+            
+            int numRead = sscanf( &( line[2] ), "%lx-%lx %4s %lx %*s %*s %2047s",
+                                  &m.start, &m.end, perms, &m.offset, path );
+            
+            if( numRead == 5 && perms[2] == 'x' && path[0] == '/' ) {
+                m.path = stringDuplicate( path );
+                mappings.push_back( m );
+                }
+            }
+        else {
+            sscanf( line, "dropped %lu", &numDropped );
+            }
+        }
+    fclose( file );
+    
+    
+    int numSamples = depths.size();
+    
+    printf( "%d stack samples taken\n", numSamples );
+    
+    if( numDropped > 0 ) {
+        printf( "%lu samples dropped by sampler\n", numDropped );
+        }
+    
+    
+    // look up each address only once
+    int numFrames = frames.size();
+    
+    unsigned long *sortedFrames = new unsigned long[ numFrames ];
+    for( int i=0; i<numFrames; i++ ) {
+        sortedFrames[i] = frames.getElementDirect( i );
+        }
+    qsort( sortedFrames, numFrames, sizeof( unsigned long ),
+           compareAddresses );
+    
+    int numInfo = 0;
+    for( int i=0; i<numFrames; i++ ) {
+        if( i == 0 || sortedFrames[i] != sortedFrames[i-1] ) {
+            sortedFrames[ numInfo ] = sortedFrames[i];
+            numInfo++;
+            }
+        }
+    
+    AddressInfo *info = new AddressInfo[ numInfo ];
+    
+    for( int i=0; i<numInfo; i++ ) {
+        info[i].address = sortedFrames[i];
+        info[i].funcName = autoSprintf( "0x%lx", sortedFrames[i] );
+        info[i].fileName = stringDuplicate( "" );
+        info[i].lineNum = -1;
+        info[i].inSampler = false;
+        }
+    delete [] sortedFrames;
+    
+    printf( "Looking up %d unique addresses with addr2line\n", numInfo );
+    
+    for( int i=0; i<mappings.size(); i++ ) {
+        symbolizeMapping( mappings.getElement( i ), &mappings, 
+                          info, numInfo );
+        }
+    
+    
+    // give addresses with the same func/file/line the same location,
+    // so that stacks through them are counted together
+    AddressInfo **byLocation = new AddressInfo*[ numInfo ];
+    for( int i=0; i<numInfo; i++ ) {
+        byLocation[i] = &( info[i] );
+        }
+    qsort( byLocation, numInfo, sizeof( AddressInfo * ), compareLocations );
+    
+    int locationID = 0;
+    for( int i=0; i<numInfo; i++ ) {
+        if( i > 0 && compareLocations( &( byLocation[i] ),
+                                       &( byLocation[i-1] ) ) != 0 ) {
+            locationID++;
+            }
+        byLocation[i]->locationID = locationID;
+        }
+    delete [] byLocation;
+    
+    
+    // group samples that have the same stack of locations
+    sampleLocations = new int[ numFrames ];
+    sampleStarts = new int[ numSamples ];
+    sampleDepths = new int[ numSamples ];
+    
+    // frames kept, with those in the sampler left out
+    unsigned long *keptFrames = new unsigned long[ numFrames ];
+    int numKept = 0;
+    
+    for( int s=0; s<numSamples; s++ ) {
+        sampleStarts[s] = numKept;
+        
+        int start = starts.getElementDirect( s );
+        int depth = depths.getElementDirect( s );
+        
+        for( int j=0; j<depth; j++ ) {
+            AddressInfo *a = 
+                findAddress( info, numInfo, 
+                             frames.getElementDirect( start + j ) );
+            
+            if( ! a->inSampler ) {
+                sampleLocations[ numKept ] = a->locationID;
+                keptFrames[ numKept ] = a->address;
+                numKept++;
+                }
+            }
+        sampleDepths[s] = numKept - sampleStarts[s];
+        }
+    
+    int *sortedSamples = new int[ numSamples ];
+    for( int i=0; i<numSamples; i++ ) {
+        sortedSamples[i] = i;
+        }
+    qsort( sortedSamples, numSamples, sizeof( int ), compareSamples );
+    
+    for( int i=0; i<numSamples; i++ ) {
+        int s = sortedSamples[i];
+        
+        if( i > 0 && compareSamples( &s, &( sortedSamples[i-1] ) ) == 0 ) {
+            stackLog.getElement( stackLog.size() - 1 )->sampleCount++;
+            continue;
+            }
+        
+        Stack thisStack;
+        thisStack.sampleCount = 1;
+        
+        stackLog.push_back( thisStack );
+        
+        Stack *newStack = stackLog.getElement( stackLog.size() - 1 );
+        
+        for( int j=0; j<sampleDepths[s]; j++ ) {
+            AddressInfo *a = 
+                findAddress( info, numInfo,
+                             keptFrames[ sampleStarts[s] + j ] );
+            
+            StackFrame f;
+            f.address = (void *)( a->address );
+            f.funcName = stringDuplicate( a->funcName );
+            f.fileName = stringDuplicate( a->fileName );
+            f.lineNum = a->lineNum;
+            
+            newStack->frames.push_back( f );
+            }
+        }
+    
+    delete [] sortedSamples;
+    delete [] keptFrames;
+    delete [] sampleLocations;
+    delete [] sampleStarts;
+    delete [] sampleDepths;
+    
+    for( int i=0; i<numInfo; i++ ) {
+        delete [] info[i].funcName;
+        delete [] info[i].fileName;
+        }
+    delete [] info;
+    
+    for( int i=0; i<mappings.size(); i++ ) {
+        delete [] mappings.getElementDirect( i ).path;
+        }
+    
+    return numSamples;
+    }
+
+
+
+// runs program with libwallClockSampler.so loaded and reports on
+// the samples it takes
+static int profileInProcess( const char *inMode, int inSamplesPerSecond,
+                             char **inProgramArgs ) {
+    
+    // sampler library is next to us
+    char ourPath[2048];
+    int pathLength = readlink( "/proc/self/exe", ourPath, 
+                               sizeof( ourPath ) - 1 );
+    if( pathLength <= 0 ) {
+        printf( "Failed to find wallClockProfiler's own path\n" );
+        return 1;
+        }
+    ourPath[ pathLength ] = '\0';
+    
+    char *endOfPath = strrchr( ourPath, '/' );
+    endOfPath[0] = '\0';
+    
+    char *libPath = autoSprintf( "%s/libwallClockSampler.so", ourPath );
+    
+    if( access( libPath, R_OK ) != 0 ) {
+        printf( "Sampler library %s not found, "
+                "build it with makeWallClockSampler\n", libPath );
+        delete [] libPath;
+        return 1;
+        }
+    
+    const char *sampleFileName = "wcSamples.txt";
+    
+    char *rateString = autoSprintf( "%d", inSamplesPerSecond );
+    
+    
+    printf( "Running program '%s' with in-process %s sampling, "
+            "redirecting program output to wcOut.txt\n",
+            inProgramArgs[0], inMode );
+    printf( "Sampling %d times per second\n", inSamplesPerSecond );
+    
+    int childPID = fork();
+    
+    if( childPID == -1 ) {
+        printf( "Failed to fork\n" );
+        return 1;
+        }
+    else if( childPID == 0 ) {
+        // child
+        int outFD = open( "wcOut.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+        if( outFD != -1 ) {
+            dup2( outFD, STDOUT_FILENO );
+            close( outFD );
+            }
+        
+        setenv( "LD_PRELOAD", libPath, true );
+        setenv( "WCP_SAMPLE_FILE", sampleFileName, true );
+        setenv( "WCP_SAMPLE_RATE", rateString, true );
+        setenv( "WCP_SAMPLE_MODE", inMode, true );
+        
+        execvp( inProgramArgs[0], inProgramArgs );
+        
+        printf( "Failed to run %s\n", inProgramArgs[0] );
+        exit( 1 );
+        }
+    
+    delete [] libPath;
+    delete [] rateString;
+    
+    int status;
+    waitpid( childPID, &status, 0 );
+    
+    if( WIFEXITED( status ) && WEXITSTATUS( status ) == 0 ) {
+        printf( "Program exited normally\n" );
+        }
+    else if( WIFEXITED( status ) ) {
+        printf( "Program exited with status %d\n", WEXITSTATUS( status ) );
+        }
+    else if( WIFSIGNALED( status ) ) {
+        printf( "Program killed by signal %d\n", WTERMSIG( status ) );
+        }
+    
+    
+    int numSamples = readSampleFile( sampleFileName );
+    
+    printf( "%d unique stacks sampled\n", stackLog.size() );
+    
+    if( numSamples == 0 ) {
+        return 1;
+        }
+    
+    printReport( numSamples );
+    
+    return 0;
+    }
+
+
+
+
 int main( int inNumArgs, char **inArgs ) {
     
+    if( inNumArgs >= 4 && 
+        ( strcmp( inArgs[1], "-wall" ) == 0 ||
+          strcmp( inArgs[1], "-cpu" ) == 0 ) ) {
+        
+        int samplesPerSecond = 1000;
+        sscanf( inArgs[2], "%d", &samplesPerSecond );
+        
+        if( samplesPerSecond < 1 ) {
+            usage();
+            }
+        
+        return profileInProcess( &( inArgs[1][1] ), samplesPerSecond,
+                                 &( inArgs[3] ) );
+        }
+    
     if( inNumArgs != 3 && inNumArgs != 4 && inNumArgs != 5 ) {
         usage();
         }
@@ -488,50 +1171,7 @@ int main( int inNumArgs, char **inArgs ) {
     printf( "%d unique stacks sampled\n", stackLog.size() );
     
     
-    // simple insertion sort
-    SimpleVector<Stack> sortedStacks;
-    
-    while( stackLog.size() > 0 ) {
-        int max = 0;
-        Stack maxStack;
-        int maxInd = -1;
-        for( int i=0; i<stackLog.size(); i++ ) {
-            Stack s = stackLog.getElementDirect( i );
-            
-            if( s.sampleCount > max ) {
-                maxStack = s;
-                max = s.sampleCount;
-                maxInd = i;
-                }
-            }  
-        sortedStacks.push_back( maxStack );
-        stackLog.deleteElement( maxInd );
-        }
-    
-    printf( "\n\n\nReport:\n\n" );
-    
-    for( int i=0; i<sortedStacks.size(); i++ ) {
-        Stack s = sortedStacks.getElementDirect( i );
-        printf( "%6.3f%% =====================================\n"
-                "      %3d: %s   (at %s:%d)\n", 
-                100 * s.sampleCount / (float )numSamples,
-                1,
-                s.frames.getElement( 0 )->funcName, 
-                s.frames.getElement( 0 )->fileName, 
-                s.frames.getElement( 0 )->lineNum );
-        // print stack for context below
-        for( int j=1; j<s.frames.size(); j++ ) {
-            StackFrame f = s.frames.getElementDirect( j );
-            printf( "      %3d: %s   (at %s:%d)\n", 
-                    j + 1,
-                    f.funcName, 
-                    f.fileName, 
-                    f.lineNum );
-            }
-        printf( "\n\n" );
-
-        freeStack( &s );
-        }
+    printReport( numSamples );
     
 
 
@@ -0,0 +1,680 @@
+// In-process stack sampler, loaded into a program with LD_PRELOAD by
+// wallClockProfiler's -wall and -cpu modes.
+//
+// A timer signal interrupts the program, and the handler unwinds the
+// interrupted stack into a free slot of a fixed table, without locks or
+// allocation.  A writer thread empties the table into a sample file every
+// 100ms, as raw addresses.  A copy of /proc/self/maps goes at the end of
+// the file so that wallClockProfiler can symbolize the addresses after
+// the program exits.
+//
+// Settings come from the environment:
+//     WCP_SAMPLE_FILE    where to write samples (sampling is off if unset)
+//     WCP_SAMPLE_RATE    samples per second (default 1000)
+//     WCP_SAMPLE_MODE    wall (default) or cpu
+//
+// wall mode samples the main thread at a fixed rate, whether it is running
+// or blocked.  cpu mode samples each thread per second of CPU time it uses,
+// with a perf_event task clock for each thread.  Where perf_event_open is
+// not allowed (perf_event_paranoid above 2), cpu mode falls back to
+// ITIMER_PROF, which only fires on scheduler ticks (100 to 1000 per
+// second, depending on the kernel).
+//
+// Unwinding uses glibc's backtrace, which follows DWARF unwind tables, so
+// the program does not need to be built with frame pointers.
+//
+// A signal handler cuts short sleep, poll, and select calls, which return
+// EINTR even with SA_RESTART.  To keep the program's timing unchanged, we
+// wrap those calls and resume them when our signal was the cause.  Other
+// blocking calls that return EINTR (epoll_wait, sigtimedwait, ...) may
+// still return early in wall mode.
+
+
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/atomicOps.h"
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <execinfo.h>
+#include <ucontext.h>
+#include <sys/time.h>
+#include <sys/syscall.h>
+#include <sys/select.h>
+#include <poll.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+
+
+#define MAX_SAMPLE_DEPTH 64
+
+// frames used by the handler itself and the signal trampoline,
+// beyond the frames we keep
+#define EXTRA_UNWIND_DEPTH 8
+
+// enough for 8 seconds at 1000 samples per second between drains
+#define NUM_SAMPLE_SLOTS 8192
+
+#define DRAIN_INTERVAL_MS 100
+
+
+enum SlotState {
+    SLOT_EMPTY = 0,
+    SLOT_WRITING,
+    SLOT_FULL
+    };
+
+
+typedef struct SampleSlot {
+        volatile int state;
+        int depth;
+        void *frames[ MAX_SAMPLE_DEPTH ];
+    } SampleSlot;
+
+
+
+static SampleSlot *slots = NULL;
+
+// where the handler starts looking for a free slot
+static volatile unsigned int nextSlotHint = 0;
+
+static volatile unsigned long numDropped = 0;
+
+static FILE *sampleFile = NULL;
+
+static pid_t samplingPID = -1;
+
+static char cpuMode = false;
+
+static timer_t wallTimer;
+
+static long intervalNS = 1000000;
+
+// true if cpu mode samples with perf_event task clocks
+static char usingPerfEvents = false;
+
+// closes a thread's task clock when it exits
+static pthread_key_t perfEventKey;
+
+// set while starting our writer thread, which should not be sampled
+static char startingWriterThread = false;
+
+// set when a sample interrupts this thread, so that wrapped calls
+// can tell our EINTRs from the program's own
+static __thread volatile char sampledThisThread = false;
+
+
+
+static void *getInterruptedPC( void *inContext ) {
+    ucontext_t *context = (ucontext_t *)inContext;
+
+#if defined( __x86_64__ ) && defined( REG_RIP )
+    return (void *)( context->uc_mcontext.gregs[ REG_RIP ] );
+#elif defined( __i386__ ) && defined( REG_EIP )
+    return (void *)( context->uc_mcontext.gregs[ REG_EIP ] );
+#elif defined( __aarch64__ )
+    return (void *)( context->uc_mcontext.pc );
+#else
+    return NULL;
+#endif
+    }
+
+
+
+static void sampleHandler( int inSignal, siginfo_t *inInfo,
+                           void *inContext ) {
+    int savedErrno = errno;
+
+    sampledThisThread = true;
+
+    void *frames[ MAX_SAMPLE_DEPTH + EXTRA_UNWIND_DEPTH ];
+
+    int depth = backtrace( frames,
+                           MAX_SAMPLE_DEPTH + EXTRA_UNWIND_DEPTH );
+
+    // skip past our own frames to the interrupted one
+    void *pc = getInterruptedPC( inContext );
+
+    int skip = 2;
+    for( int i=0; i<depth && i < EXTRA_UNWIND_DEPTH; i++ ) {
+        if( frames[i] == pc ) {
+            skip = i;
+            break;
+            }
+        }
+
+    depth -= skip;
+    if( depth > MAX_SAMPLE_DEPTH ) {
+        depth = MAX_SAMPLE_DEPTH;
+        }
+
+
+    // claim a free slot, giving up if the writer has fallen far behind
+    unsigned int start = atomicAdd( &nextSlotHint, 1u );
+
+    SampleSlot *slot = NULL;
+
+    for( int i=0; i<16; i++ ) {
+        SampleSlot *s = &( slots[ ( start + i ) % NUM_SAMPLE_SLOTS ] );
+
+        if( atomicCompareAndSwap( &( s->state ),
+                                  (int)SLOT_EMPTY, (int)SLOT_WRITING ) ) {
+            slot = s;
+            break;
+            }
+        }
+
+    if( slot == NULL ) {
+        atomicAdd( &numDropped, 1ul );
+        }
+    else if( depth > 0 ) {
+        memcpy( slot->frames, &( frames[ skip ] ),
+                depth * sizeof( void * ) );
+        slot->depth = depth;
+
+        atomicStore( &( slot->state ), (int)SLOT_FULL );
+        }
+    else {
+        atomicStore( &( slot->state ), (int)SLOT_EMPTY );
+        }
+
+    errno = savedErrno;
+    }
+
+
+
+// writes all full slots to the sample file
+static void drainSlots() {
+    for( int i=0; i<NUM_SAMPLE_SLOTS; i++ ) {
+        SampleSlot *s = &( slots[i] );
+
+        if( atomicLoad( &( s->state ) ) == SLOT_FULL ) {
+
+            fprintf( sampleFile, "S %d", s->depth );
+
+            for( int f=0; f<s->depth; f++ ) {
+                fprintf( sampleFile, " %p", s->frames[f] );
+                }
+            fprintf( sampleFile, "\n" );
+
+            atomicStore( &( s->state ), (int)SLOT_EMPTY );
+            }
+        }
+    }
+
+
+
+static void writeMaps() {
+    FILE *mapsFile = fopen( "/proc/self/maps", "r" );
+
+    if( mapsFile == NULL ) {
+        return;
+        }
+
+    fprintf( sampleFile, "maps\n" );
+
+    char line[1024];
+
+    while( fgets( line, sizeof( line ), mapsFile ) != NULL ) {
+        fprintf( sampleFile, "M %s", line );
+        }
+    fclose( mapsFile );
+    }
+
+
+
+// starts a task clock that signals the calling thread each time it uses
+// intervalNS of CPU time
+// returns false on failure
+static char startThreadPerfEvent() {
+    struct perf_event_attr attr;
+    memset( &attr, 0, sizeof( attr ) );
+    attr.size = sizeof( attr );
+    attr.type = PERF_TYPE_SOFTWARE;
+    attr.config = PERF_COUNT_SW_TASK_CLOCK;
+    attr.sample_period = intervalNS;
+    attr.wakeup_events = 1;
+    attr.disabled = 1;
+
+    int fd = (int)syscall( SYS_perf_event_open, &attr, 0, -1, -1, 
+                           PERF_FLAG_FD_CLOEXEC );
+    if( fd == -1 ) {
+        return false;
+        }
+
+    // overflows signal this thread, not the process
+    struct f_owner_ex owner;
+    owner.type = F_OWNER_TID;
+    owner.pid = (pid_t)syscall( SYS_gettid );
+
+    if( fcntl( fd, F_SETOWN_EX, &owner ) == -1 ||
+        fcntl( fd, F_SETSIG, SIGPROF ) == -1 ||
+        fcntl( fd, F_SETFL, fcntl( fd, F_GETFL ) | O_ASYNC ) == -1 ) {
+        close( fd );
+        return false;
+        }
+
+    pthread_setspecific( perfEventKey, (void *)(long)( fd + 1 ) );
+
+    ioctl( fd, PERF_EVENT_IOC_RESET, 0 );
+    ioctl( fd, PERF_EVENT_IOC_ENABLE, 0 );
+
+    return true;
+    }
+
+
+
+static void stopThreadPerfEvent( void *inFDPlusOne ) {
+    int fd = (int)(long)inFDPlusOne - 1;
+
+    ioctl( fd, PERF_EVENT_IOC_DISABLE, 0 );
+    close( fd );
+    }
+
+
+
+class SampleWriterThread : public Thread {
+    public:
+
+        SampleWriterThread()
+                : mStop( false ) {
+            }
+
+        ~SampleWriterThread() {
+            atomicStore( &mStop, (char)true );
+            join();
+            }
+
+        virtual void run() {
+            // keep timer signals off of this thread
+            sigset_t blocked;
+            sigemptyset( &blocked );
+            sigaddset( &blocked, SIGPROF );
+            pthread_sigmask( SIG_BLOCK, &blocked, NULL );
+
+            while( ! atomicLoad( &mStop ) ) {
+                staticSleep( DRAIN_INTERVAL_MS );
+                drainSlots();
+                fflush( sampleFile );
+                }
+            }
+
+    protected:
+        volatile char mStop;
+    };
+
+
+static SampleWriterThread *writerThread = NULL;
+
+
+
+__attribute__(( constructor ))
+static void startSampling() {
+    const char *fileName = getenv( "WCP_SAMPLE_FILE" );
+
+    if( fileName == NULL ) {
+        return;
+        }
+
+    int rate = 1000;
+    const char *rateString = getenv( "WCP_SAMPLE_RATE" );
+    if( rateString != NULL ) {
+        sscanf( rateString, "%d", &rate );
+        }
+    if( rate < 1 ) {
+        rate = 1;
+        }
+
+    const char *modeString = getenv( "WCP_SAMPLE_MODE" );
+    cpuMode = ( modeString != NULL && strcmp( modeString, "cpu" ) == 0 );
+
+
+    sampleFile = fopen( fileName, "w" );
+
+    // don't sample programs that this one runs
+    unsetenv( "WCP_SAMPLE_FILE" );
+    unsetenv( "LD_PRELOAD" );
+
+    if( sampleFile == NULL ) {
+        fprintf( stderr, "wallClockSampler:  failed to open %s\n",
+                 fileName );
+        return;
+        }
+
+    fprintf( sampleFile, "wallClockSamples %s %d\n",
+             cpuMode ? "cpu" : "wall", rate );
+
+    // maps as of startup, in case we never get to write them at exit
+    writeMaps();
+
+
+    slots = (SampleSlot *)calloc( NUM_SAMPLE_SLOTS, sizeof( SampleSlot ) );
+
+    // backtrace loads libgcc the first time, which can't happen in
+    // a signal handler
+    void *primeFrames[ 4 ];
+    backtrace( primeFrames, 4 );
+
+    samplingPID = getpid();
+
+    startingWriterThread = true;
+    writerThread = new SampleWriterThread();
+    writerThread->start();
+    startingWriterThread = false;
+
+
+    struct sigaction action;
+    memset( &action, 0, sizeof( action ) );
+    action.sa_sigaction = sampleHandler;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset( &action.sa_mask );
+
+    sigaction( SIGPROF, &action, NULL );
+
+
+    intervalNS = 1000000000L / rate;
+
+    if( cpuMode ) {
+        pthread_key_create( &perfEventKey, stopThreadPerfEvent );
+
+        // other threads start theirs in our pthread_create
+        usingPerfEvents = startThreadPerfEvent();
+        }
+
+    if( cpuMode && ! usingPerfEvents ) {
+        fprintf( stderr, "wallClockSampler:  perf_event_open failed, "
+                 "sampling on scheduler ticks with ITIMER_PROF\n" );
+
+        // process CPU time, delivered to whichever thread is running
+        struct itimerval interval;
+        interval.it_interval.tv_sec = intervalNS / 1000000000L;
+        interval.it_interval.tv_usec = ( intervalNS % 1000000000L ) / 1000;
+        interval.it_value = interval.it_interval;
+
+        setitimer( ITIMER_PROF, &interval, NULL );
+        }
+    else if( ! cpuMode ) {
+        // real time, always delivered to the main thread
+        struct sigevent event;
+        memset( &event, 0, sizeof( event ) );
+        event.sigev_notify = SIGEV_THREAD_ID;
+        event.sigev_signo = SIGPROF;
+        event.sigev_notify_thread_id = syscall( SYS_gettid );
+
+        if( timer_create( CLOCK_MONOTONIC, &event, &wallTimer ) != 0 ) {
+            fprintf( stderr, "wallClockSampler:  failed to create timer\n" );
+            return;
+            }
+
+        struct itimerspec interval;
+        interval.it_interval.tv_sec = intervalNS / 1000000000L;
+        interval.it_interval.tv_nsec = intervalNS % 1000000000L;
+        interval.it_value = interval.it_interval;
+
+        timer_settime( wallTimer, 0, &interval, NULL );
+        }
+    }
+
+
+
+__attribute__(( destructor ))
+static void stopSampling() {
+    // forked children inherit our state but not our thread or timer
+    if( sampleFile == NULL || getpid() != samplingPID ) {
+        return;
+        }
+
+    if( usingPerfEvents ) {
+        // only ours, other threads' stop when they exit
+        void *fdPlusOne = pthread_getspecific( perfEventKey );
+        pthread_setspecific( perfEventKey, NULL );
+
+        if( fdPlusOne != NULL ) {
+            stopThreadPerfEvent( fdPlusOne );
+            }
+        }
+    else if( cpuMode ) {
+        struct itimerval off;
+        memset( &off, 0, sizeof( off ) );
+        setitimer( ITIMER_PROF, &off, NULL );
+        }
+    else {
+        timer_delete( wallTimer );
+        }
+
+    // a signal already on its way is ignored rather than killing us
+    signal( SIGPROF, SIG_IGN );
+
+    delete writerThread;
+    writerThread = NULL;
+
+    drainSlots();
+
+    fprintf( sampleFile, "dropped %lu\n", atomicLoad( &numDropped ) );
+
+    // libraries loaded since startup are in these
+    writeMaps();
+
+    fclose( sampleFile );
+    sampleFile = NULL;
+    }
+
+
+
+
+// Wrapped calls, resumed for the rest of their time when a sample
+// interrupts them
+
+static void *getNext( const char *inName ) {
+    return dlsym( RTLD_NEXT, inName );
+    }
+
+
+
+typedef struct ThreadStart {
+        void *(*function)( void * );
+        void *arg;
+    } ThreadStart;
+
+
+
+static void *startSampledThread( void *inThreadStart ) {
+    ThreadStart start = *( (ThreadStart *)inThreadStart );
+    free( inThreadStart );
+
+    startThreadPerfEvent();
+
+    return start.function( start.arg );
+    }
+
+
+
+// gives each new thread its own task clock in cpu mode
+extern "C" int pthread_create( pthread_t *outThread,
+                               const pthread_attr_t *inAttr,
+                               void *(*inFunction)( void * ), void *inArg ) {
+    typedef int (*CreateFunction)( pthread_t *, const pthread_attr_t *,
+                                   void *(*)( void * ), void * );
+    static CreateFunction next = 
+        (CreateFunction)getNext( "pthread_create" );
+
+    if( ! usingPerfEvents || startingWriterThread ) {
+        return next( outThread, inAttr, inFunction, inArg );
+        }
+
+    ThreadStart *start = (ThreadStart *)malloc( sizeof( ThreadStart ) );
+    start->function = inFunction;
+    start->arg = inArg;
+
+    int result = next( outThread, inAttr, startSampledThread, start );
+
+    if( result != 0 ) {
+        free( start );
+        }
+    return result;
+    }
+
+
+
+static double getMonotonicMS() {
+    struct timespec t;
+    clock_gettime( CLOCK_MONOTONIC, &t );
+    return t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0;
+    }
+
+
+
+extern "C" int clock_nanosleep( clockid_t inClock, int inFlags,
+                                const struct timespec *inRequest,
+                                struct timespec *outRemain ) {
+    typedef int (*SleepFunction)( clockid_t, int, const struct timespec *,
+                                  struct timespec * );
+    static SleepFunction next = 
+        (SleepFunction)getNext( "clock_nanosleep" );
+    
+    struct timespec request = *inRequest;
+    struct timespec remain;
+    
+    while( true ) {
+        sampledThisThread = false;
+        
+        // returns error number rather than setting errno
+        int result = next( inClock, inFlags, &request, &remain );
+        
+        if( result != EINTR || ! sampledThisThread ) {
+            if( result == EINTR && outRemain != NULL &&
+                ! ( inFlags & TIMER_ABSTIME ) ) {
+                *outRemain = remain;
+                }
+            return result;
+            }
+        
+        // absolute times stay the same
+        if( ! ( inFlags & TIMER_ABSTIME ) ) {
+            request = remain;
+            }
+        }
+    }
+
+
+
+extern "C" int nanosleep( const struct timespec *inRequest,
+                          struct timespec *outRemain ) {
+    int result = clock_nanosleep( CLOCK_REALTIME, 0, inRequest, outRemain );
+    
+    if( result != 0 ) {
+        errno = result;
+        return -1;
+        }
+    return 0;
+    }
+
+
+
+extern "C" int usleep( useconds_t inMicroseconds ) {
+    struct timespec request;
+    request.tv_sec = inMicroseconds / 1000000;
+    request.tv_nsec = ( inMicroseconds % 1000000 ) * 1000;
+    
+    return nanosleep( &request, NULL );
+    }
+
+
+
+extern "C" unsigned int sleep( unsigned int inSeconds ) {
+    struct timespec request;
+    request.tv_sec = inSeconds;
+    request.tv_nsec = 0;
+    
+    struct timespec remain;
+    
+    if( nanosleep( &request, &remain ) != 0 ) {
+        return remain.tv_sec + ( remain.tv_nsec > 0 ? 1 : 0 );
+        }
+    return 0;
+    }
+
+
+
+extern "C" int poll( struct pollfd *inFDs, nfds_t inNumFDs, 
+                     int inTimeoutMS ) {
+    typedef int (*PollFunction)( struct pollfd *, nfds_t, int );
+    static PollFunction next = (PollFunction)getNext( "poll" );
+    
+    double endTime = getMonotonicMS() + inTimeoutMS;
+    
+    int timeout = inTimeoutMS;
+    
+    while( true ) {
+        sampledThisThread = false;
+        
+        int result = next( inFDs, inNumFDs, timeout );
+        
+        if( result != -1 || errno != EINTR || ! sampledThisThread ) {
+            return result;
+            }
+        
+        if( inTimeoutMS >= 0 ) {
+            timeout = (int)( endTime - getMonotonicMS() );
+            if( timeout < 0 ) {
+                timeout = 0;
+                }
+            }
+        }
+    }
+
+
+
+extern "C" int select( int inNumFDs, fd_set *inRead, fd_set *inWrite,
+                       fd_set *inExcept, struct timeval *inTimeout ) {
+    typedef int (*SelectFunction)( int, fd_set *, fd_set *, fd_set *,
+                                   struct timeval * );
+    static SelectFunction next = (SelectFunction)getNext( "select" );
+    
+    // sets are undefined after an error, so restore them before resuming
+    fd_set read, write, except;
+    if( inRead != NULL ) {
+        read = *inRead;
+        }
+    if( inWrite != NULL ) {
+        write = *inWrite;
+        }
+    if( inExcept != NULL ) {
+        except = *inExcept;
+        }
+    
+    while( true ) {
+        sampledThisThread = false;
+        
+        // Linux counts down the timeout, leaving the time remaining
+        int result = next( inNumFDs, inRead, inWrite, inExcept, inTimeout );
+        
+        if( result != -1 || errno != EINTR || ! sampledThisThread ) {
+            return result;
+            }
+        
+        if( inRead != NULL ) {
+            *inRead = read;
+            }
+        if( inWrite != NULL ) {
+            *inWrite = write;
+            }
+        if( inExcept != NULL ) {
+            *inExcept = except;
+            }
+        }
+    }
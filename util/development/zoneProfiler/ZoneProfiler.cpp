@@ -0,0 +1,371 @@
+#include "ZoneProfiler.h"
+
+
+#ifdef ZONE_PROFILER
+
+
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/system/atomicOps.h"
+#include "minorGems/util/SimpleVector.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+
+enum ZoneEventType {
+    ZONE_EVENT = 0,
+    COUNTER_EVENT,
+    FRAME_EVENT
+    };
+
+
+typedef struct ZoneEvent {
+        const char *name;
+        // start time for zones
+        double time;
+        // end time for zones, value for counters, number for frames
+        double value;
+        int type;
+        int threadIndex;
+    } ZoneEvent;
+
+
+
+// events recorded by one thread, read by writeChromeTrace
+class ZoneThreadRing {
+    public:
+
+        ZoneThreadRing( int inNumEvents, int inThreadIndex )
+                : mThreadIndex( inThreadIndex ),
+                  mName( NULL ),
+                  mNumWritten( 0 ) {
+
+            mNumEvents = 1;
+            while( mNumEvents < inNumEvents ) {
+                mNumEvents *= 2;
+                }
+            mEvents = new ZoneEvent[ mNumEvents ];
+            }
+
+
+        // only called by the owning thread
+        inline void add( int inType, const char *inName,
+                         double inTime, double inValue ) {
+            unsigned int index = mNumWritten;
+
+            ZoneEvent *e = &( mEvents[ index & ( mNumEvents - 1 ) ] );
+
+            e->type = inType;
+            e->name = inName;
+            e->time = inTime;
+            e->value = inValue;
+            e->threadIndex = mThreadIndex;
+
+            // a reader that sees this event also sees it counted
+            atomicStore( &mNumWritten, index + 1 );
+
+            // and doesn't see the next one's writes before its count
+            atomicStoreFence();
+            }
+
+
+        // copies all events still in the ring that weren't overwritten
+        // during the copy
+        void copyEvents( SimpleVector<ZoneEvent> *inEvents ) {
+            unsigned int end = atomicLoad( &mNumWritten );
+
+            unsigned int start = 0;
+            if( end > (unsigned int)mNumEvents ) {
+                start = end - mNumEvents;
+                }
+
+            int numCopied = end - start;
+
+            ZoneEvent *copied = new ZoneEvent[ numCopied ];
+
+            for( int i=0; i<numCopied; i++ ) {
+                copied[i] = mEvents[ ( start + i ) & ( mNumEvents - 1 ) ];
+                }
+
+            atomicLoadFence();
+
+            // the owner may have written over the oldest events while we
+            // copied them, including the one it is writing now
+            unsigned int nowWritten = atomicLoad( &mNumWritten );
+
+            int numUnsafe = 0;
+            if( nowWritten + 1 > start + mNumEvents ) {
+                numUnsafe = nowWritten + 1 - ( start + mNumEvents );
+                }
+            if( numUnsafe > numCopied ) {
+                numUnsafe = numCopied;
+                }
+
+            inEvents->appendArray( &( copied[ numUnsafe ] ),
+                                   numCopied - numUnsafe );
+
+            delete [] copied;
+            }
+
+
+        int mThreadIndex;
+
+        volatile const char *mName;
+
+    protected:
+        ZoneEvent *mEvents;
+        int mNumEvents;
+
+        volatile unsigned int mNumWritten;
+    };
+
+
+
+static MutexLock ringLock;
+static SimpleVector<ZoneThreadRing *> rings;
+
+static int eventsPerThread = 65536;
+
+static volatile int numFrames = 0;
+
+static __thread ZoneThreadRing *threadRing = NULL;
+
+
+
+static ZoneThreadRing *getThreadRing() {
+    if( threadRing == NULL ) {
+        ringLock.lock();
+
+        threadRing = new ZoneThreadRing( eventsPerThread, rings.size() );
+        rings.push_back( threadRing );
+
+        ringLock.unlock();
+        }
+    return threadRing;
+    }
+
+
+
+void ZoneProfiler::zone( const char *inName,
+                         double inStartTime, double inEndTime ) {
+    getThreadRing()->add( ZONE_EVENT, inName, inStartTime, inEndTime );
+    }
+
+
+
+void ZoneProfiler::counter( const char *inName, double inValue ) {
+    getThreadRing()->add( COUNTER_EVENT, inName, getTime(), inValue );
+    }
+
+
+
+void ZoneProfiler::frameMark() {
+    int frame = atomicAdd( &numFrames, 1 );
+
+    getThreadRing()->add( FRAME_EVENT, "frame", getTime(), frame );
+    }
+
+
+
+void ZoneProfiler::setThreadName( const char *inName ) {
+    getThreadRing()->mName = inName;
+    }
+
+
+
+void ZoneProfiler::setEventsPerThread( int inNumEvents ) {
+    eventsPerThread = inNumEvents;
+    }
+
+
+
+static int compareDoublesDescending( const void *inA, const void *inB ) {
+    double a = *( (double *)inA );
+    double b = *( (double *)inB );
+
+    if( a > b ) {
+        return -1;
+        }
+    if( a < b ) {
+        return 1;
+        }
+    return 0;
+    }
+
+
+
+// zones still running at a cutoff time are kept
+static double getLastTime( ZoneEvent *inEvent ) {
+    if( inEvent->type == ZONE_EVENT ) {
+        return inEvent->value;
+        }
+    return inEvent->time;
+    }
+
+
+
+// names are usually literals, but keep the JSON valid regardless
+static void writeJSONString( FILE *inFile, const char *inString ) {
+    fputc( '"', inFile );
+
+    for( int i=0; inString[i] != '\0'; i++ ) {
+        char c = inString[i];
+
+        if( c == '"' || c == '\\' ) {
+            fputc( '\\', inFile );
+            fputc( c, inFile );
+            }
+        else if( (unsigned char)c < 0x20 ) {
+            fprintf( inFile, "\\u%04x", c );
+            }
+        else {
+            fputc( c, inFile );
+            }
+        }
+    fputc( '"', inFile );
+    }
+
+
+
+char ZoneProfiler::writeChromeTrace( const char *inFileName,
+                                     int inNumFrames ) {
+
+    SimpleVector<ZoneEvent> events;
+
+    ringLock.lock();
+
+    int numThreads = rings.size();
+    ZoneThreadRing **threadRings = rings.getElementArray();
+
+    ringLock.unlock();
+
+
+    for( int i=0; i<numThreads; i++ ) {
+        threadRings[i]->copyEvents( &events );
+        }
+
+    int numEvents = events.size();
+
+
+    // events from before the oldest frame we want are left out
+    double cutoffTime = -1;
+
+    if( inNumFrames > 0 ) {
+        SimpleVector<double> frameTimes;
+
+        for( int i=0; i<numEvents; i++ ) {
+            ZoneEvent *e = events.getElement( i );
+            if( e->type == FRAME_EVENT ) {
+                frameTimes.push_back( e->time );
+                }
+            }
+
+        if( frameTimes.size() > inNumFrames ) {
+            double *times = frameTimes.getElementArray();
+
+            qsort( times, frameTimes.size(), sizeof( double ),
+                   compareDoublesDescending );
+
+            cutoffTime = times[ inNumFrames - 1 ];
+            delete [] times;
+            }
+        }
+
+
+    FILE *file = fopen( inFileName, "w" );
+
+    if( file == NULL ) {
+        delete [] threadRings;
+        return false;
+        }
+
+
+    // times are written relative to the earliest event written
+    double baseTime = -1;
+
+    for( int i=0; i<numEvents; i++ ) {
+        ZoneEvent *e = events.getElement( i );
+
+        if( getLastTime( e ) >= cutoffTime &&
+            ( baseTime == -1 || e->time < baseTime ) ) {
+            baseTime = e->time;
+            }
+        }
+
+
+    fprintf( file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" );
+
+    // JSON allows no comma after the last entry
+    const char *separator = "";
+
+    for( int i=0; i<numThreads; i++ ) {
+        fprintf( file,
+                 "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,"
+                 "\"tid\":%d,\"args\":{\"name\":",
+                 separator, threadRings[i]->mThreadIndex );
+        separator = ",\n";
+
+        const char *name = (const char *)( threadRings[i]->mName );
+
+        if( name != NULL ) {
+            writeJSONString( file, name );
+            }
+        else {
+            fprintf( file, "\"thread %d\"", threadRings[i]->mThreadIndex );
+            }
+
+        fprintf( file, "}}" );
+        }
+
+    delete [] threadRings;
+
+
+    for( int i=0; i<numEvents; i++ ) {
+        ZoneEvent *e = events.getElement( i );
+
+        if( getLastTime( e ) < cutoffTime ) {
+            continue;
+            }
+
+        fprintf( file, "%s", separator );
+        separator = ",\n";
+
+        // microseconds
+        double ts = ( e->time - baseTime ) * 1000000;
+
+        switch( e->type ) {
+            case ZONE_EVENT:
+                fprintf( file, "{\"ph\":\"X\",\"name\":" );
+                writeJSONString( file, e->name );
+                fprintf( file, ",\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+                         "\"dur\":%.3f}",
+                         e->threadIndex, ts,
+                         ( e->value - e->time ) * 1000000 );
+                break;
+            case COUNTER_EVENT:
+                fprintf( file, "{\"ph\":\"C\",\"name\":" );
+                writeJSONString( file, e->name );
+                fprintf( file, ",\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+                         "\"args\":{\"value\":%g}}",
+                         e->threadIndex, ts, e->value );
+                break;
+            case FRAME_EVENT:
+                fprintf( file, "{\"ph\":\"i\",\"s\":\"g\",\"name\":\"frame\","
+                         "\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+                         "\"args\":{\"frame\":%d}}",
+                         e->threadIndex, ts, (int)( e->value ) );
+                break;
+            }
+        }
+
+    fprintf( file, "\n]}\n" );
+
+    fclose( file );
+
+    return true;
+    }
+
+
+
+#endif
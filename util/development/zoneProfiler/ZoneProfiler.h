@@ -0,0 +1,164 @@
+#include "minorGems/common.h"
+
+
+
+#ifndef ZONE_PROFILER_INCLUDED
+#define ZONE_PROFILER_INCLUDED
+
+
+
+/**
+ * Marks timed zones, counters, and frame boundaries in hot code, and
+ * writes the most recent frames as a Chrome trace (viewable in
+ * chrome://tracing or ui.perfetto.dev).
+ *
+ * Use the PROFILE_ macros below rather than calling ZoneProfiler directly.
+ * They compile to nothing unless ZONE_PROFILER is defined, so they can be
+ * left in release code:
+ *
+ *     void drawScene() {
+ *         PROFILE_ZONE( "drawScene" );
+ *         ...
+ *         PROFILE_COUNTER( "spritesDrawn", numSprites );
+ *         }
+ *
+ * Each thread records into a ring buffer of its own without locks, so a
+ * zone costs two clock reads and one ring write.  Rings keep the most
+ * recent events, overwriting older ones, and are allocated on a thread's
+ * first event and kept until exit.
+ *
+ * Names must be string constants (or otherwise outlive the profiler),
+ * because only their pointers are recorded.
+ */
+
+
+
+#ifdef ZONE_PROFILER
+
+
+#define PROFILE_CONCAT_INNER( inA, inB ) inA##inB
+#define PROFILE_CONCAT( inA, inB ) PROFILE_CONCAT_INNER( inA, inB )
+
+
+// times from here to the end of the enclosing scope
+#define PROFILE_ZONE( inName ) \
+    ScopedZone PROFILE_CONCAT( profileZone, __LINE__ )( inName )
+
+// records a value, drawn as a graph over time
+#define PROFILE_COUNTER( inName, inValue ) \
+    ZoneProfiler::counter( inName, inValue )
+
+// marks the start of a frame, called once per frame on one thread
+#define PROFILE_FRAME_MARK() ZoneProfiler::frameMark()
+
+// names the calling thread in traces
+#define PROFILE_THREAD_NAME( inName ) ZoneProfiler::setThreadName( inName )
+
+// writes the most recent inNumFrames frames as a Chrome trace
+#define PROFILE_WRITE_TRACE( inFileName, inNumFrames ) \
+    ZoneProfiler::writeChromeTrace( inFileName, inNumFrames )
+
+
+#else
+
+
+#define PROFILE_ZONE( inName )
+#define PROFILE_COUNTER( inName, inValue )
+#define PROFILE_FRAME_MARK()
+#define PROFILE_THREAD_NAME( inName )
+#define PROFILE_WRITE_TRACE( inFileName, inNumFrames )
+
+
+#endif
+
+
+
+#ifdef ZONE_PROFILER
+
+
+
+#include "minorGems/system/Time.h"
+
+
+
+class ZoneProfiler {
+
+    public:
+
+
+        // current time in seconds, as used for all events
+        static double getTime() {
+            return Time::getPreciseTime();
+            }
+
+
+        // records a zone that ran from inStartTime to inEndTime
+        static void zone( const char *inName,
+                          double inStartTime, double inEndTime );
+
+
+        static void counter( const char *inName, double inValue );
+
+
+        static void frameMark();
+
+
+        static void setThreadName( const char *inName );
+
+
+
+        /**
+         * Writes events from the most recent frames to a file as a
+         * Chrome trace.  Threads can keep recording while this runs.
+         *
+         * @param inFileName the file to write.
+         *   Must be destroyed by caller.
+         * @param inNumFrames how many of the most recent frames to write,
+         *   or -1 to write all recorded events.
+         *
+         * @return true on success.
+         */
+        static char writeChromeTrace( const char *inFileName,
+                                      int inNumFrames );
+
+
+
+        /**
+         * Sets how many events each thread's ring holds.  Only affects
+         * rings allocated after the call, so should be called at startup.
+         *
+         * Defaults to 65536 (2 MiB per thread).
+         */
+        static void setEventsPerThread( int inNumEvents );
+
+    };
+
+
+
+// times a zone from construction to destruction
+class ScopedZone {
+
+    public:
+
+        ScopedZone( const char *inName )
+                : mName( inName ), mStartTime( ZoneProfiler::getTime() ) {
+            }
+
+
+        ~ScopedZone() {
+            ZoneProfiler::zone( mName, mStartTime, ZoneProfiler::getTime() );
+            }
+
+
+    protected:
+        const char *mName;
+        double mStartTime;
+    };
+
+
+
+#endif
+
+
+
+#endif
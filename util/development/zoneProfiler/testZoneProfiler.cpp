@@ -0,0 +1,163 @@
+// Records zones from several threads, some while a trace is being written,
+// checks the trace, and times the cost of a zone.
+
+
+#include "ZoneProfiler.h"
+
+#include "minorGems/system/Thread.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+
+static int numFailed = 0;
+
+
+class ZoneThread : public Thread {
+    public:
+        ZoneThread( int inNumZones )
+                : mNumZones( inNumZones ) {
+            }
+
+        virtual void run() {
+            PROFILE_THREAD_NAME( "worker" );
+
+            for( int i=0; i<mNumZones; i++ ) {
+                PROFILE_ZONE( "outer" );
+                    {
+                    PROFILE_ZONE( "inner" );
+                    PROFILE_COUNTER( "workerCount", i );
+                    }
+                }
+            }
+
+    protected:
+        int mNumZones;
+    };
+
+
+
+static int countInFile( const char *inFileName, const char *inTarget ) {
+    FILE *file = fopen( inFileName, "r" );
+    if( file == NULL ) {
+        return -1;
+        }
+    int count = 0;
+    char line[1024];
+    while( fgets( line, sizeof( line ), file ) != NULL ) {
+        if( strstr( line, inTarget ) != NULL ) {
+            count++;
+            }
+        }
+    fclose( file );
+    return count;
+    }
+
+
+
+static void check( char inCondition, const char *inDescription ) {
+    if( ! inCondition ) {
+        printf( "FAILED:  %s\n", inDescription );
+        numFailed++;
+        }
+    }
+
+
+
+int main() {
+
+    ZoneProfiler::setEventsPerThread( 4096 );
+
+    PROFILE_THREAD_NAME( "main" );
+
+
+    // 10 frames with 3 zones each on the main thread
+    for( int f=0; f<10; f++ ) {
+        PROFILE_FRAME_MARK();
+        PROFILE_ZONE( "frame work" );
+
+        for( int z=0; z<2; z++ ) {
+            PROFILE_ZONE( "step \"quoted\"" );
+            Thread::staticSleep( 1 );
+            }
+        PROFILE_COUNTER( "frameNumber", f );
+        }
+
+    check( ZoneProfiler::writeChromeTrace( "testTraceAll.json", -1 ),
+           "writing trace" );
+
+    check( countInFile( "testTraceAll.json", "\"name\":\"frame work\"" )
+           == 10, "10 frame zones" );
+    check( countInFile( "testTraceAll.json", "step \\\"quoted\\\"" ) == 20,
+           "20 escaped step zones" );
+    check( countInFile( "testTraceAll.json", "\"ph\":\"i\"" ) == 10,
+           "10 frame marks" );
+    check( countInFile( "testTraceAll.json", "\"frameNumber\"" ) == 10,
+           "10 counter values" );
+    check( countInFile( "testTraceAll.json", "\"name\":\"main\"" ) == 1,
+           "main thread named" );
+
+
+    // only the last 3 frames
+    check( ZoneProfiler::writeChromeTrace( "testTraceLast.json", 3 ),
+           "writing trace of last frames" );
+    check( countInFile( "testTraceLast.json", "\"ph\":\"i\"" ) == 3,
+           "3 frame marks" );
+    check( countInFile( "testTraceLast.json", "\"name\":\"frame work\"" )
+           == 3, "3 frame zones" );
+
+
+    // workers overflow their rings while traces are written
+    int numThreads = 4;
+    int zonesPerThread = 200000;
+
+    ZoneThread **threads = new ZoneThread*[ numThreads ];
+
+    for( int i=0; i<numThreads; i++ ) {
+        threads[i] = new ZoneThread( zonesPerThread );
+        threads[i]->start();
+        }
+
+    for( int i=0; i<20; i++ ) {
+        check( ZoneProfiler::writeChromeTrace( "testTraceLive.json", -1 ),
+               "writing trace while recording" );
+        }
+
+    for( int i=0; i<numThreads; i++ ) {
+        threads[i]->join();
+        delete threads[i];
+        }
+    delete [] threads;
+
+    ZoneProfiler::writeChromeTrace( "testTraceLive.json", -1 );
+
+    // each worker ring holds its last 4096 events, but the oldest is
+    // left out, since it could have been in the middle of being replaced
+    check( countInFile( "testTraceLive.json", "\"name\":\"worker\"" )
+           == numThreads, "worker threads named" );
+    check( countInFile( "testTraceLive.json", "\"inner\"" ) +
+           countInFile( "testTraceLive.json", "\"outer\"" ) +
+           countInFile( "testTraceLive.json", "\"workerCount\"" )
+           == numThreads * 4095, "worker rings full" );
+
+
+    // cost of a zone
+    int numZones = 2000000;
+    double startTime = Time::getCurrentTime();
+
+    for( int i=0; i<numZones; i++ ) {
+        PROFILE_ZONE( "timed" );
+        }
+
+    double zoneTime = Time::getCurrentTime() - startTime;
+
+    printf( "%.1f ns per zone\n", 1000000000 * zoneTime / numZones );
+
+
+    if( numFailed == 0 ) {
+        printf( "All tests passed\n" );
+        return 0;
+        }
+    return 1;
+    }
@@ -0,0 +1,574 @@
+#include "AsyncFileLog.h"
+
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/BinarySemaphore.h"
+#include "minorGems/system/Time.h"
+#include "minorGems/system/atomicOps.h"
+
+#include "minorGems/util/stringUtils.h"
+
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <pthread.h>
+
+
+
+#ifndef va_copy
+    #define va_copy( dest, src ) ( dest = src )
+#endif
+
+
+
+typedef struct AsyncLogRecord {
+        int level;
+
+        // for sorting
+        timeSec_t seconds;
+        unsigned long milliseconds;
+        int order;
+
+        // for printing the date
+        time_t wallTime;
+
+        // logger name and message
+        char *text;
+    } AsyncLogRecord;
+
+
+
+/**
+ * Stands for one logging thread, so that its rings can tell when it
+ * has ended.
+ *
+ * Shared by the thread and its rings, and destroyed when the last of
+ * them lets go.
+ */
+typedef struct AsyncLogThreadToken {
+        volatile char exited;
+        volatile int refCount;
+    } AsyncLogThreadToken;
+
+
+
+static void releaseToken( AsyncLogThreadToken *inToken ) {
+    if( atomicAdd( &( inToken->refCount ), -1 ) == 0 ) {
+        delete inToken;
+        }
+    }
+
+
+
+/**
+ * Messages from one logging thread, waiting for the writer.
+ *
+ * Only the owning thread adds messages (moving mHead), and only one
+ * drainer at a time removes them (moving mTail), so no locks are needed.
+ */
+class AsyncLogRing {
+    public:
+        AsyncLogRing( int inSize, AsyncLogThreadToken *inOwner )
+                : mRecords( new AsyncLogRecord[ inSize ] ),
+                  mMask( (unsigned int)( inSize - 1 ) ),
+                  mOwner( inOwner ),
+                  mHead( 0 ), mNumDropped( 0 ),
+                  mTail( 0 ) {
+            atomicAdd( &( mOwner->refCount ), 1 );
+            }
+
+        ~AsyncLogRing() {
+            for( unsigned int i=mTail; i != mHead; i++ ) {
+                delete [] mRecords[ i & mMask ].text;
+                }
+            delete [] mRecords;
+
+            releaseToken( mOwner );
+            }
+
+        AsyncLogRecord *mRecords;
+        unsigned int mMask;
+
+        // the owning thread
+        AsyncLogThreadToken *mOwner;
+
+        // written by owning thread
+        volatile unsigned int mHead;
+        volatile unsigned long mNumDropped;
+
+        // keep the writer's index off the owner's cache line
+        char mPadding[64];
+
+        // written by drainer
+        volatile unsigned int mTail;
+    };
+
+
+
+class AsyncLogWriterThread : public Thread {
+    public:
+        AsyncLogWriterThread( AsyncFileLog *inLog,
+                              unsigned long inIntervalMS )
+                : mLog( inLog ), mIntervalMS( inIntervalMS ),
+                  mStopped( false ),
+                  mWakeSemaphore( new BinarySemaphore() ) {
+            start();
+            }
+
+        // stops and joins
+        ~AsyncLogWriterThread() {
+            atomicStore( &mStopped, (char)true );
+            mWakeSemaphore->signal();
+            join();
+
+            delete mWakeSemaphore;
+            }
+
+        // wakes up early to write
+        void wake() {
+            mWakeSemaphore->signal();
+            }
+
+        void run() {
+            while( ! atomicLoad( &mStopped ) ) {
+                mWakeSemaphore->wait( (int)mIntervalMS );
+
+                mLog->flush();
+                }
+            }
+
+    protected:
+        AsyncFileLog *mLog;
+        unsigned long mIntervalMS;
+        volatile char mStopped;
+        BinarySemaphore *mWakeSemaphore;
+    };
+
+
+
+// this thread's token, created when it first logs
+static __thread AsyncLogThreadToken *tThreadToken = NULL;
+
+// ring used last by this thread, to skip the lookup
+static __thread AsyncLogRing *tRing = NULL;
+static __thread unsigned int tRingLogID = 0;
+
+
+// runs threadEnded when a thread with a token ends
+static pthread_key_t sThreadTokenKey;
+static pthread_once_t sThreadTokenKeyOnce = PTHREAD_ONCE_INIT;
+
+
+static void threadEnded( void *inToken ) {
+    AsyncLogThreadToken *token = (AsyncLogThreadToken *)inToken;
+
+    // if this thread logs again while ending (from another key's
+    // destructor), it starts over with a new token and ring
+    tThreadToken = NULL;
+    tRing = NULL;
+    tRingLogID = 0;
+
+    // writer frees this thread's rings once they are drained
+    atomicStore( &( token->exited ), (char)true );
+
+    releaseToken( token );
+    }
+
+
+static void makeThreadTokenKey() {
+    pthread_key_create( &sThreadTokenKey, threadEnded );
+    }
+
+
+static AsyncLogThreadToken *getThreadToken() {
+    if( tThreadToken == NULL ) {
+        pthread_once( &sThreadTokenKeyOnce, makeThreadTokenKey );
+
+        AsyncLogThreadToken *token = new AsyncLogThreadToken;
+        token->exited = false;
+        // held by this thread until it ends
+        token->refCount = 1;
+
+        pthread_setspecific( sThreadTokenKey, token );
+
+        tThreadToken = token;
+        }
+
+    return tThreadToken;
+    }
+
+
+static volatile unsigned int sNextLogID = 0;
+
+
+
+AsyncFileLog::AsyncFileLog( const char *inFileName,
+                            unsigned long inSecondsBetweenBackups,
+                            int inRingSize,
+                            unsigned long inWriteIntervalMS )
+        : FileLog( inFileName, inSecondsBetweenBackups ),
+          mRingSize( 2 ),
+          mLogID( atomicAdd( &sNextLogID, 1u ) ),
+          mRingLock( new MutexLock() ),
+          mEndedDroppedCount( 0 ),
+          mDrainLock( new MutexLock() ),
+          mDroppedWritten( 0 ) {
+
+    while( mRingSize < inRingSize ) {
+        mRingSize *= 2;
+        }
+
+    mWriterThread = new AsyncLogWriterThread( this, inWriteIntervalMS );
+    }
+
+
+
+AsyncFileLog::~AsyncFileLog() {
+    // writes anything left after stopping
+    delete mWriterThread;
+
+    flush();
+
+    for( int i=0; i<mRings.size(); i++ ) {
+        delete mRings.getElementDirect( i );
+        }
+
+    delete mRingLock;
+    delete mDrainLock;
+    }
+
+
+
+void AsyncFileLog::flush() {
+    mDrainLock->lock();
+    drainRings();
+    mDrainLock->unlock();
+    }
+
+
+
+unsigned long AsyncFileLog::getDroppedCount() {
+    mRingLock->lock();
+
+    unsigned long count = mEndedDroppedCount;
+    for( int i=0; i<mRings.size(); i++ ) {
+        count += atomicLoad( &( mRings.getElementDirect( i )->mNumDropped ) );
+        }
+
+    mRingLock->unlock();
+
+    return count;
+    }
+
+
+
+AsyncLogRing *AsyncFileLog::getThreadRing() {
+    if( tRingLogID == mLogID ) {
+        return tRing;
+        }
+
+    AsyncLogThreadToken *token = getThreadToken();
+
+    mRingLock->lock();
+
+    AsyncLogRing *ring = NULL;
+
+    for( int i=0; i<mRings.size(); i++ ) {
+        if( mRings.getElementDirect( i )->mOwner == token ) {
+            // made before we last logged to another log
+            ring = mRings.getElementDirect( i );
+            break;
+            }
+        }
+    if( ring == NULL ) {
+        ring = new AsyncLogRing( mRingSize, token );
+        mRings.push_back( ring );
+        }
+
+    mRingLock->unlock();
+
+    tRing = ring;
+    tRingLogID = mLogID;
+
+    return ring;
+    }
+
+
+
+// formats "logger name | message" with one allocation in the usual case
+static char *formatText( const char *inLoggerName,
+                         const char *inFormatString,
+                         va_list inArgList ) {
+    char buffer[512];
+
+    int nameLength = strlen( inLoggerName );
+
+    if( nameLength + 3 < (int)sizeof( buffer ) ) {
+        memcpy( buffer, inLoggerName, nameLength );
+        memcpy( &( buffer[ nameLength ] ), " | ", 3 );
+
+        int prefixLength = nameLength + 3;
+
+        va_list listCopy;
+        va_copy( listCopy, inArgList );
+
+        int messageLength =
+            vsnprintf( &( buffer[ prefixLength ] ),
+                       sizeof( buffer ) - prefixLength,
+                       inFormatString, listCopy );
+
+        va_end( listCopy );
+
+        if( messageLength >= 0 &&
+            prefixLength + messageLength < (int)sizeof( buffer ) ) {
+
+            int length = prefixLength + messageLength;
+
+            char *text = new char[ length + 1 ];
+            memcpy( text, buffer, length + 1 );
+            return text;
+            }
+        }
+
+    // too long for buffer
+    va_list listCopy;
+    va_copy( listCopy, inArgList );
+
+    int messageLength = vsnprintf( NULL, 0, inFormatString, listCopy );
+
+    va_end( listCopy );
+
+    if( messageLength < 0 ) {
+        messageLength = 0;
+        }
+
+    char *text = new char[ nameLength + 3 + messageLength + 1 ];
+    memcpy( text, inLoggerName, nameLength );
+    memcpy( &( text[ nameLength ] ), " | ", 3 );
+
+    va_copy( listCopy, inArgList );
+    vsnprintf( &( text[ nameLength + 3 ] ), messageLength + 1,
+               inFormatString, listCopy );
+    va_end( listCopy );
+
+    text[ nameLength + 3 + messageLength ] = '\0';
+
+    return text;
+    }
+
+
+
+void AsyncFileLog::logStringV( const char *inLoggerName,
+                               int inLevel,
+                               const char *inFormatString,
+                               va_list inArgList ) {
+
+    if( mLogFile == NULL || inLevel > mLoggingLevel ) {
+        return;
+        }
+
+    AsyncLogRing *ring = getThreadRing();
+
+    unsigned int head = ring->mHead;
+    unsigned int tail = atomicLoad( &( ring->mTail ) );
+
+    char critical = ( inLevel <= Log::CRITICAL_ERROR_LEVEL );
+
+    if( head - tail > ring->mMask ) {
+        // full
+        if( ! critical ) {
+            atomicStore( &( ring->mNumDropped ), ring->mNumDropped + 1 );
+            return;
+            }
+
+        // make room
+        flush();
+        }
+
+
+    AsyncLogRecord *record = &( ring->mRecords[ head & ring->mMask ] );
+
+    record->level = inLevel;
+    Time::getCurrentTime( &( record->seconds ), &( record->milliseconds ) );
+    record->wallTime = time( NULL );
+    record->text = formatText( inLoggerName, inFormatString, inArgList );
+
+    // publishes the record to the writer
+    atomicStore( &( ring->mHead ), head + 1 );
+
+    if( critical ) {
+        flush();
+        }
+    else if( head - tail + 1 == ( ring->mMask + 1 ) / 2 ) {
+        mWriterThread->wake();
+        }
+
+
+    if( mPrintOutNextMessage || mPrintAllMessages ) {
+        char *message = PrintLog::generateLogMessage( inLoggerName,
+                                                      inLevel,
+                                                      inFormatString,
+                                                      inArgList );
+        char *plainMessage =
+            PrintLog::generatePlainMessage( inFormatString, inArgList );
+
+        mLock->lock();
+
+        if( mPrintOutNextMessage ) {
+            printf( "%s\n", message );
+            mPrintOutNextMessage = false;
+            }
+        else if( mPrintAllMessages ) {
+            printf( "%s\n", plainMessage );
+            }
+
+        mLock->unlock();
+
+        delete [] message;
+        delete [] plainMessage;
+        }
+    }
+
+
+
+static int compareRecords( const void *inA, const void *inB ) {
+    const AsyncLogRecord *a = (const AsyncLogRecord *)inA;
+    const AsyncLogRecord *b = (const AsyncLogRecord *)inB;
+
+    if( a->seconds != b->seconds ) {
+        return ( a->seconds < b->seconds ) ? -1 : 1;
+        }
+    if( a->milliseconds != b->milliseconds ) {
+        return ( a->milliseconds < b->milliseconds ) ? -1 : 1;
+        }
+    return a->order - b->order;
+    }
+
+
+
+void AsyncFileLog::drainRings() {
+
+    SimpleVector<AsyncLogRecord> records;
+
+    mRingLock->lock();
+
+    unsigned long numDropped = mEndedDroppedCount;
+
+    for( int i=0; i<mRings.size(); i++ ) {
+        AsyncLogRing *ring = mRings.getElementDirect( i );
+
+        // checked before taking messages, so that if the owner has
+        // ended, we see all that it added
+        char ownerEnded = atomicLoad( &( ring->mOwner->exited ) );
+
+        unsigned int head = atomicLoad( &( ring->mHead ) );
+
+        for( unsigned int t = ring->mTail; t != head; t++ ) {
+            AsyncLogRecord record = ring->mRecords[ t & ring->mMask ];
+            record.order = records.size();
+            records.push_back( record );
+            }
+
+        // hands the slots back to the owning thread
+        atomicStore( &( ring->mTail ), head );
+
+        numDropped += atomicLoad( &( ring->mNumDropped ) );
+
+        if( ownerEnded ) {
+            // nothing more will be added, and we've taken everything
+            mEndedDroppedCount += ring->mNumDropped;
+
+            delete ring;
+            mRings.deleteElement( i );
+            i--;
+            }
+        }
+
+    mRingLock->unlock();
+
+
+    if( numDropped != mDroppedWritten ) {
+        AsyncLogRecord note;
+        note.level = Log::WARNING_LEVEL;
+        Time::getCurrentTime( &( note.seconds ), &( note.milliseconds ) );
+        note.order = records.size();
+        note.wallTime = time( NULL );
+        note.text = autoSprintf(
+            "asyncLog | %lu log messages dropped because the log could "
+            "not keep up", numDropped - mDroppedWritten );
+
+        records.push_back( note );
+
+        mDroppedWritten = numDropped;
+        }
+
+    if( records.size() == 0 ) {
+        return;
+        }
+
+    // each ring is in order already, but rings are interleaved in time
+    qsort( records.getElementFast( 0 ), records.size(),
+           sizeof( AsyncLogRecord ), compareRecords );
+
+
+    SimpleVector<char> output;
+    output.reserve( records.size() * 128 );
+
+    time_t lastWallTime = 0;
+    char dateString[64] = "";
+
+    for( int i=0; i<records.size(); i++ ) {
+        AsyncLogRecord *record = records.getElementFast( i );
+
+        if( i == 0 || record->wallTime != lastWallTime ) {
+            lastWallTime = record->wallTime;
+
+            // lock around ctime call, since it returns a static buffer
+            mLock->lock();
+
+            char *date = ctime( &lastWallTime );
+            int dateLength = strlen( date );
+
+            if( dateLength >= (int)sizeof( dateString ) ) {
+                dateLength = sizeof( dateString ) - 1;
+                }
+            memcpy( dateString, date, dateLength );
+
+            mLock->unlock();
+
+            // this date string ends with a newline...
+            // get rid of it
+            if( dateLength > 0 && dateString[ dateLength - 1 ] == '\n' ) {
+                dateLength--;
+                }
+            dateString[ dateLength ] = '\0';
+            }
+
+        // same format as PrintLog::generateLogMessage
+        char prefix[128];
+        snprintf( prefix, sizeof( prefix ), "L%d | %s (%ld ms) | ",
+                  record->level, dateString, record->milliseconds );
+
+        output.appendElementString( prefix );
+        output.appendElementString( record->text );
+        output.push_back( '\n' );
+
+        delete [] record->text;
+        }
+
+
+    mLock->lock();
+
+    if( mLogFile != NULL ) {
+        fwrite( output.getElementFast( 0 ), 1, output.size(), mLogFile );
+        fflush( mLogFile );
+
+        if( Time::timeSec() - mTimeOfLastBackup > mSecondsBetweenBackups ) {
+            makeBackup();
+            }
+        }
+
+    mLock->unlock();
+    }
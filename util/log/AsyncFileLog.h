@@ -0,0 +1,131 @@
+#include "minorGems/common.h"
+
+
+
+#ifndef ASYNC_FILE_LOG_INCLUDED
+#define ASYNC_FILE_LOG_INCLUDED
+
+
+
+#include "FileLog.h"
+
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/util/SimpleVector.h"
+
+
+
+// internally used classes
+class AsyncLogRing;
+class AsyncLogWriterThread;
+
+
+
+/**
+ * A FileLog that writes to disk on a background thread.
+ *
+ * Logging threads only format their message and drop it into a ring
+ * buffer of their own, without taking any locks.  A single writer
+ * thread gathers messages from all rings, puts them in time order,
+ * and writes each batch with one write and one flush.  Backups happen
+ * on the writer thread, as in FileLog.
+ *
+ * If a thread logs faster than the writer can keep up and its ring
+ * fills, its new messages are dropped and counted, and the writer notes
+ * the number dropped in the log.  Critical errors are never dropped, and
+ * are on disk before logging them returns.
+ *
+ * Each logging thread gets a ring of its own, which the writer frees
+ * once the thread has ended and its messages are written.
+ */
+class AsyncFileLog : public FileLog {
+
+    public:
+
+
+        /**
+         * Constructs a log and starts its writer thread.
+         *
+         * @param inFileName the name of the file to write log messages to.
+         *   Must be destroyed by caller.
+         * @param inSecondsBetweenBackups the number of seconds between
+         *   backups, as in FileLog.  Defaults to 3600 seconds.
+         * @param inRingSize how many messages each logging thread
+         *   can have waiting before messages are dropped.  Rounded up
+         *   to a power of 2.  Defaults to 4096.
+         * @param inWriteIntervalMS how often the writer thread writes
+         *   waiting messages.  It also wakes up when a ring is half full.
+         *   Defaults to 100.
+         */
+        AsyncFileLog( const char *inFileName,
+                      unsigned long inSecondsBetweenBackups = 3600,
+                      int inRingSize = 4096,
+                      unsigned long inWriteIntervalMS = 100 );
+
+
+        // writes all waiting messages and stops the writer thread
+        virtual ~AsyncFileLog();
+
+
+
+        /**
+         * Writes all waiting messages to disk before returning.
+         *
+         * Thread safe.
+         */
+        void flush();
+
+
+
+        /**
+         * Gets the number of messages dropped because a ring was full.
+         *
+         * Thread safe.
+         */
+        unsigned long getDroppedCount();
+
+
+
+        // overrides FileLog::logStringV
+        virtual void logStringV( const char *inLoggerName,
+                                 int inLevel, const char* inFormatString,
+                                 va_list inArgList );
+
+
+    protected:
+
+        int mRingSize;
+
+        // unique to this log, used by threads to find their cached rings
+        unsigned int mLogID;
+
+        // protects mRings and mEndedDroppedCount
+        MutexLock *mRingLock;
+        SimpleVector<AsyncLogRing *> mRings;
+
+        // messages dropped from rings of ended threads that have
+        // been freed
+        unsigned long mEndedDroppedCount;
+
+        // held by whoever is taking messages out of rings
+        MutexLock *mDrainLock;
+
+        unsigned long mDroppedWritten;
+
+        AsyncLogWriterThread *mWriterThread;
+
+
+        // gets the calling thread's ring, adding one if needed
+        AsyncLogRing *getThreadRing();
+
+
+        // takes all waiting messages out of rings and writes them
+        // mDrainLock must be held by caller
+        void drainRings();
+
+
+        friend class AsyncLogWriterThread;
+    };
+
+
+
+#endif
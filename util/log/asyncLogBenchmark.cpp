@@ -0,0 +1,159 @@
+// Times 8 threads logging at once through FileLog and AsyncFileLog,
+// and checks that every message AsyncFileLog didn't drop reached the file.
+//
+// Run from a scratch directory, since it writes logs into the current one.
+
+
+#include "FileLog.h"
+#include "AsyncFileLog.h"
+
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/Time.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+
+static int numThreads = 8;
+static int numMessages = 100000;
+
+
+
+class LoggingThread : public Thread {
+    public:
+        LoggingThread( Log *inLog, int inID )
+                : mLog( inLog ), mID( inID ) {
+            }
+
+        void run() {
+            double startTime = Time::getCurrentTime();
+
+            for( int i=0; i<numMessages; i++ ) {
+                mLog->logString( "bench", Log::INFO_LEVEL,
+                                 "thread %d message %d value %f",
+                                 mID, i, i * 0.5 );
+                }
+
+            mTime = Time::getCurrentTime() - startTime;
+            }
+
+        double mTime;
+
+    protected:
+        Log *mLog;
+        int mID;
+    };
+
+
+
+static int countLines( const char *inFileName ) {
+    FILE *f = fopen( inFileName, "r" );
+    if( f == NULL ) {
+        return 0;
+        }
+
+    int count = 0;
+    int c;
+    while( ( c = fgetc( f ) ) != EOF ) {
+        if( c == '\n' ) {
+            count++;
+            }
+        }
+    fclose( f );
+    return count;
+    }
+
+
+
+// returns time until all messages are on disk
+static double timeLog( const char *inName, Log *inLog,
+                       AsyncFileLog *inAsyncLog ) {
+
+    LoggingThread **threads = new LoggingThread*[ numThreads ];
+
+    double startTime = Time::getCurrentTime();
+
+    for( int i=0; i<numThreads; i++ ) {
+        threads[i] = new LoggingThread( inLog, i );
+        threads[i]->start();
+        }
+
+    double maxCallerTime = 0;
+
+    for( int i=0; i<numThreads; i++ ) {
+        threads[i]->join();
+        if( threads[i]->mTime > maxCallerTime ) {
+            maxCallerTime = threads[i]->mTime;
+            }
+        delete threads[i];
+        }
+    delete [] threads;
+
+    if( inAsyncLog != NULL ) {
+        inAsyncLog->flush();
+        }
+
+    double totalTime = Time::getCurrentTime() - startTime;
+
+    printf( "  %s  %.3f s in logging threads, %.3f s until on disk "
+            "(%.0f messages/s)\n",
+            inName, maxCallerTime, totalTime,
+            numThreads * numMessages / totalTime );
+
+    return totalTime;
+    }
+
+
+
+int main() {
+
+    remove( "benchFileLog.log" );
+    remove( "benchAsyncLog.log" );
+    remove( "benchAsyncSmallLog.log" );
+
+    printf( "%d threads logging %d messages each:\n",
+            numThreads, numMessages );
+
+    int numFailed = 0;
+
+
+    FileLog *fileLog = new FileLog( "benchFileLog.log" );
+    timeLog( "FileLog:                 ", fileLog, NULL );
+    delete fileLog;
+
+
+    AsyncFileLog *asyncLog = new AsyncFileLog( "benchAsyncLog.log", 3600,
+                                               65536 );
+    timeLog( "AsyncFileLog:            ", asyncLog, asyncLog );
+
+    unsigned long dropped = asyncLog->getDroppedCount();
+    delete asyncLog;
+
+    // one extra line for each note about dropped messages
+    int lines = countLines( "benchAsyncLog.log" );
+    printf( "    %lu dropped, %d lines written\n", dropped, lines );
+
+    if( lines < numThreads * numMessages - (int)dropped ) {
+        printf( "FAILED:  messages missing\n" );
+        numFailed++;
+        }
+
+
+    // small rings drop under load instead of blocking
+    asyncLog = new AsyncFileLog( "benchAsyncSmallLog.log", 3600, 256 );
+    timeLog( "AsyncFileLog, 256 ring:  ", asyncLog, asyncLog );
+
+    dropped = asyncLog->getDroppedCount();
+    delete asyncLog;
+
+    lines = countLines( "benchAsyncSmallLog.log" );
+    printf( "    %lu dropped, %d lines written\n", dropped, lines );
+
+    if( lines < numThreads * numMessages - (int)dropped ) {
+        printf( "FAILED:  messages missing\n" );
+        numFailed++;
+        }
+
+    return numFailed;
+    }
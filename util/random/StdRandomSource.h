@@ -32,7 +32,9 @@
 
 #include <stdlib.h>
 #include <limits.h>
+#include <math.h>
 #include "RandomSource.h"
+#include "minorGems/system/Time.h"
 
 class StdRandomSource : public RandomSource {
 
@@ -0,0 +1,223 @@
+// Compares SimpleVector against std::vector, and against a copy of
+// SimpleVector's old growth code (new [] and element-by-element
+// assignment on every doubling).
+//
+// Elements are ints (plain, moved with realloc), nested vectors of ints
+// (each copy allocates, so moves matter), and many short vectors (where
+// SimpleSmallVector avoids allocating at all).
+
+
+#include "SimpleVector.h"
+
+#include "minorGems/system/Time.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+
+
+// SimpleVector as it was before move-aware growth
+template <class Type>
+class OldSimpleVector {
+    public:
+        OldSimpleVector()
+                : elements( new Type[2] ), numFilledElements( 0 ),
+                  maxSize( 2 ) {
+            }
+
+        OldSimpleVector( const OldSimpleVector &inCopy )
+                : elements( new Type[ inCopy.maxSize ] ),
+                  numFilledElements( inCopy.numFilledElements ),
+                  maxSize( inCopy.maxSize ) {
+            for( int i=0; i<numFilledElements; i++ ) {
+                elements[i] = inCopy.elements[i];
+                }
+            }
+
+        OldSimpleVector & operator = ( const OldSimpleVector &inOther ) {
+            if( this != &inOther ) {
+                Type *newElements = new Type[ inOther.maxSize ];
+                for( int i=0; i<inOther.numFilledElements; i++ ) {
+                    newElements[i] = inOther.elements[i];
+                    }
+                delete [] elements;
+                elements = newElements;
+                numFilledElements = inOther.numFilledElements;
+                maxSize = inOther.maxSize;
+                }
+            return *this;
+            }
+
+        ~OldSimpleVector() {
+            delete [] elements;
+            }
+
+        void push_back( Type x ) {
+            if( numFilledElements == maxSize ) {
+                int newMaxSize = maxSize << 1;
+                Type *newAlloc = new Type[ newMaxSize ];
+                for( int i=0; i<numFilledElements; i++ ) {
+                    newAlloc[i] = elements[i];
+                    }
+                delete [] elements;
+                elements = newAlloc;
+                maxSize = newMaxSize;
+                }
+            elements[ numFilledElements ] = x;
+            numFilledElements++;
+            }
+
+        int size() {
+            return numFilledElements;
+            }
+
+        Type *getElementFast( int inIndex ) {
+            return &( elements[ inIndex ] );
+            }
+
+    protected:
+        Type *elements;
+        int numFilledElements;
+        int maxSize;
+    };
+
+
+
+static int numInts = 4000000;
+static int numNested = 200000;
+static int nestedSize = 16;
+static int numShort = 1000000;
+
+
+// keeps results alive so loops aren't optimized away
+static long checksum = 0;
+
+
+
+template <class Vector>
+static void fillInts( Vector *inV ) {
+    for( int i=0; i<numInts; i++ ) {
+        inV->push_back( i );
+        }
+    checksum += inV->size();
+    }
+
+
+
+template <class Vector>
+static double pushInts() {
+    double startTime = Time::getCurrentTime();
+
+    Vector v;
+    fillInts( &v );
+
+    return Time::getCurrentTime() - startTime;
+    }
+
+
+
+template <class Vector>
+static double pushIntsReserved() {
+    double startTime = Time::getCurrentTime();
+
+    Vector v;
+    v.reserve( numInts );
+    fillInts( &v );
+
+    return Time::getCurrentTime() - startTime;
+    }
+
+
+
+template <class Vector, class Inner>
+static double pushNested() {
+    double startTime = Time::getCurrentTime();
+
+    Vector v;
+
+    for( int i=0; i<numNested; i++ ) {
+        Inner inner;
+        for( int j=0; j<nestedSize; j++ ) {
+            inner.push_back( j );
+            }
+        v.push_back( inner );
+        }
+
+    checksum += v.size();
+
+    return Time::getCurrentTime() - startTime;
+    }
+
+
+
+template <class Vector>
+static double makeShort() {
+    double startTime = Time::getCurrentTime();
+
+    for( int i=0; i<numShort; i++ ) {
+        Vector v;
+        v.push_back( i );
+        v.push_back( i );
+        v.push_back( i );
+        checksum += v.size();
+        }
+
+    return Time::getCurrentTime() - startTime;
+    }
+
+
+
+// std::vector doesn't match SimpleVector's function names
+template <class Type>
+class StdVector : public std::vector<Type> {
+    public:
+        int size() {
+            return (int)( std::vector<Type>::size() );
+            }
+    };
+
+
+
+int main() {
+
+    printf( "push_back %d ints:\n", numInts );
+    printf( "  old SimpleVector:              %.3f s\n",
+            pushInts< OldSimpleVector<int> >() );
+    printf( "  SimpleVector:                  %.3f s\n",
+            pushInts< SimpleVector<int> >() );
+    printf( "  SimpleVector with reserve:     %.3f s\n",
+            pushIntsReserved< SimpleVector<int> >() );
+    printf( "  std::vector:                   %.3f s\n",
+            pushInts< StdVector<int> >() );
+    printf( "  std::vector with reserve:      %.3f s\n",
+            pushIntsReserved< StdVector<int> >() );
+
+
+    printf( "\npush_back %d vectors of %d ints:\n", numNested, nestedSize );
+    printf( "  old SimpleVector:              %.3f s\n",
+            pushNested< OldSimpleVector< OldSimpleVector<int> >,
+                        OldSimpleVector<int> >() );
+    printf( "  SimpleVector:                  %.3f s\n",
+            pushNested< SimpleVector< SimpleVector<int> >,
+                        SimpleVector<int> >() );
+    printf( "  std::vector:                   %.3f s\n",
+            pushNested< StdVector< StdVector<int> >,
+                        StdVector<int> >() );
+
+
+    printf( "\ncreate %d vectors of 3 ints:\n", numShort );
+    printf( "  old SimpleVector:              %.3f s\n",
+            makeShort< OldSimpleVector<int> >() );
+    printf( "  SimpleVector:                  %.3f s\n",
+            makeShort< SimpleVector<int> >() );
+    printf( "  SimpleSmallVector<int,4>:      %.3f s\n",
+            makeShort< SimpleSmallVector<int,4> >() );
+    printf( "  std::vector:                   %.3f s\n",
+            makeShort< StdVector<int> >() );
+
+    printf( "\n(checksum %ld)\n", checksum );
+
+    return 0;
+    }
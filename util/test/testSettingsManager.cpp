@@ -0,0 +1,167 @@
+/**
+ * A test program for SettingsManager caching.
+ *
+ * Polls settings in a loop, changes them behind the manager's back,
+ * and checks write-behind, reporting cache hits and disk reads.
+ *
+ * Run from a scratch directory, since it writes into ./testSettings
+ */
+
+
+
+#include "minorGems/util/SettingsManager.h"
+#include "minorGems/util/SettingsFlushThread.h"
+#include "minorGems/util/stringUtils.h"
+#include "minorGems/io/file/File.h"
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/Time.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+
+static int numFailed = 0;
+
+static void check( char inCondition, const char *inDescription ) {
+    if( ! inCondition ) {
+        printf( "FAILED:  %s\n", inDescription );
+        numFailed++;
+        }
+    }
+
+
+
+// writes a settings file directly, like a user editing it
+static void writeFile( const char *inName, const char *inValue ) {
+    char *fileName = autoSprintf( "testSettings/%s.ini", inName );
+    File f( NULL, fileName );
+    f.writeToFile( inValue );
+    delete [] fileName;
+    }
+
+
+
+static char *readFile( const char *inName ) {
+    char *fileName = autoSprintf( "testSettings/%s.ini", inName );
+    File f( NULL, fileName );
+    char *contents = f.readFileContents();
+    delete [] fileName;
+    return contents;
+    }
+
+
+
+int main() {
+
+    File dir( NULL, "testSettings" );
+    if( ! dir.exists() ) {
+        dir.makeDirectory();
+        }
+
+    SettingsManager::setDirectoryName( "testSettings" );
+    SettingsManager::setFileCheckInterval( 0.25 );
+
+    writeFile( "pollMe", "17" );
+
+
+    int numPolls = 100000;
+
+    unsigned long startReads = SettingsManager::getDiskReadCount();
+
+    double startTime = Time::getCurrentTime();
+
+    for( int i=0; i<numPolls; i++ ) {
+        check( SettingsManager::getIntSetting( "pollMe", 0 ) == 17,
+               "polled value" );
+        // missing settings are cached too
+        check( SettingsManager::getIntSetting( "missing", 5 ) == 5,
+               "missing value" );
+        }
+
+    double pollTime = Time::getCurrentTime() - startTime;
+
+    printf( "%d polls of two settings in %.3f s, %lu disk reads, "
+            "%lu cache hits\n", numPolls, pollTime,
+            SettingsManager::getDiskReadCount() - startReads,
+            SettingsManager::getCacheHitCount() );
+
+
+    // a change behind the manager's back shows up after the check
+    // interval, even within the same second
+    writeFile( "pollMe", "18" );
+    Thread::staticSleep( 300 );
+    check( SettingsManager::getIntSetting( "pollMe", 0 ) == 18,
+           "external change" );
+
+    writeFile( "missing", "6" );
+    Thread::staticSleep( 300 );
+    check( SettingsManager::getIntSetting( "missing", 5 ) == 6,
+           "external create" );
+
+
+    // write-through by default
+    SettingsManager::setSetting( "written", 3 );
+    char *contents = readFile( "written" );
+    check( contents != NULL && strcmp( contents, "3" ) == 0,
+           "write-through" );
+    if( contents != NULL ) {
+        delete [] contents;
+        }
+
+
+    // batched writes
+    SettingsFlushThread *flushThread = new SettingsFlushThread( 200 );
+
+    unsigned long startWrites = SettingsManager::getDiskWriteCount();
+
+    for( int i=0; i<1000; i++ ) {
+        SettingsManager::setSetting( "batched", i );
+        check( SettingsManager::getIntSetting( "batched", -1 ) == i,
+               "read own pending write" );
+        }
+
+    Thread::staticSleep( 500 );
+
+    contents = readFile( "batched" );
+    check( contents != NULL && strcmp( contents, "999" ) == 0,
+           "background flush" );
+    if( contents != NULL ) {
+        delete [] contents;
+        }
+
+    printf( "1000 sets written with %lu disk writes\n",
+            SettingsManager::getDiskWriteCount() - startWrites );
+
+    SettingsManager::setSetting( "batched", 1000 );
+
+    // flushes
+    delete flushThread;
+
+    contents = readFile( "batched" );
+    check( contents != NULL && strcmp( contents, "1000" ) == 0,
+           "flush when thread destroyed" );
+    if( contents != NULL ) {
+        delete [] contents;
+        }
+
+
+    // hashes are checked at load
+    SettingsManager::setHashingOn( true );
+
+    SettingsManager::setSetting( "hashed", 7 );
+    check( SettingsManager::getIntSetting( "hashed", 0 ) == 7,
+           "hashed value" );
+
+    writeFile( "hashed", "8" );
+    Thread::staticSleep( 300 );
+    check( SettingsManager::getIntSetting( "hashed", 0 ) == 0,
+           "tampered value rejected" );
+
+
+    if( numFailed == 0 ) {
+        printf( "All tests passed\n" );
+        return 0;
+        }
+    return 1;
+    }